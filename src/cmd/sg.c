@@ -119,6 +119,7 @@ DECLARE_CMD_FUNC(whoami);
 DECLARE_CMD_FUNC(linehistory);
 DECLARE_CMD_FUNC(zingmerge);
 DECLARE_CMD_FUNC(blobcount);
+DECLARE_CMD_FUNC(blobdict);
 DECLARE_CMD_FUNC(dump_json);
 DECLARE_CMD_FUNC(graph_history);
 DECLARE_CMD_FUNC(dump_lca);
@@ -216,6 +217,8 @@ struct sg_getopt_option sg_cl_options[] =
 	{"allow-lost",   opt_allow_lost, 0, "Allow commit to try to cope with lost items"},
 	{"no-allow-after",  opt_no_allow_after_the_fact, 0, "Disallow after-the-fact moves/renames"},
 	{"allow-dirty",  opt_allow_dirty, 0, "<<generic status message not defined>>"},
+	{"timings",      opt_timings,  0, "Print the time spent in SQLite, blob fetches, hashing, scanning and the network when the command finishes"},
+	{"trace-json",   opt_trace_json, 1, "Write a Chrome trace (chrome://tracing) of the command to the given file"},
 
 #if defined(DEBUG)
 	{"dagnum",       opt_dagnum,   1, "Request a specific DAG (debug)"},
@@ -283,6 +286,14 @@ struct cmdinfo commands[] =
 		{ {0, ""} }
 	},
 
+	{
+		"blobdict", NULL, NULL, NULL, cmd_blobdict,
+		"Retrain the compression dictionaries for small blobs in a repo", "repo_name", NULL,
+		SG_TRUE, 
+		{ {0,0,0} }, 
+		{ {0, ""} }
+	},
+
 	{
 		"branch", "branches", NULL, NULL, cmd_branch,
 		"Create, delete, manipulate or list named branches", 
@@ -2195,6 +2206,10 @@ static void _inspect_all_options(SG_context * pCtx,
 
 	SG_VARRAY__ALLOC__PARAMS(pCtx, &pvaHandled, 10, NULL, NULL);
 
+	/* These apply to every command. */
+	SG_ERR_CHECK(  SG_varray__append__int64(pCtx, pvaHandled, opt_timings)  );
+	SG_ERR_CHECK(  SG_varray__append__int64(pCtx, pvaHandled, opt_trace_json)  );
+
 	/* Handle OPT_REV_SPEC, if this command takes one. */
 	for (k=0; k < SG_CMDINFO_OPTION_LIMIT; k++) /* Looping over all options this command supports. */
 	{
@@ -4031,6 +4046,12 @@ void do_cmd_blobcount(SG_context * pCtx, const char* psz_descriptor_name)
     SG_uint64 max_len_encoded__zlib = 0;
     SG_uint64 max_len_full__zlib = 0;
 
+    SG_uint32 count_blobs__zlibdict = 0;
+    SG_uint64 len_encoded__zlibdict = 0;
+    SG_uint64 len_full__zlibdict = 0;
+    SG_uint64 max_len_encoded__zlibdict = 0;
+    SG_uint64 max_len_full__zlibdict = 0;
+
     SG_uint32 count_blobs__vcdiff = 0;
     SG_uint64 len_encoded__vcdiff = 0;
     SG_uint64 len_full__vcdiff = 0;
@@ -4088,6 +4109,17 @@ void do_cmd_blobcount(SG_context * pCtx, const char* psz_descriptor_name)
                 &max_len_full__zlib
                 )  );
 
+    SG_ERR_CHECK(  SG_blobset__get_stats(
+                pCtx,
+                pbs,
+                SG_BLOBENCODING__ZLIBDICT,
+                &count_blobs__zlibdict,
+                &len_encoded__zlibdict,
+                &len_full__zlibdict,
+                &max_len_encoded__zlibdict,
+                &max_len_full__zlibdict
+                )  );
+
     SG_ERR_CHECK(  SG_blobset__get_stats(
                 pCtx,
                 pbs,
@@ -4118,6 +4150,15 @@ void do_cmd_blobcount(SG_context * pCtx, const char* psz_descriptor_name)
       SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%12s  %d%%\n", "saved", (int) ((len_full__zlib - len_encoded__zlib) / (double) len_full__zlib * 100.0))  );
     }
 
+    if (count_blobs__zlibdict)
+    {
+        SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "zlibdict\n")  );
+        SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%12s  %d\n", "count", count_blobs__zlibdict)  );
+        SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%12s  %12s\n", "full", SG_int64_to_sz(len_full__zlibdict,buf))  );
+        SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%12s  %12s\n", "encoded", SG_int64_to_sz(len_encoded__zlibdict,buf))  );
+        SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%12s  %d%%\n", "saved", (int) ((len_full__zlibdict - len_encoded__zlibdict) / (double) len_full__zlibdict * 100.0))  );
+    }
+
     SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "vcdiff\n")  );
     SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%12s  %d\n", "count", count_blobs__vcdiff)  );
     SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%12s  %12s\n", "full", SG_int64_to_sz(len_full__vcdiff,buf))  );
@@ -4139,6 +4180,66 @@ fail:
     SG_REPO_NULLFREE(pCtx, pRepo);
 }
 
+void do_cmd_blobdict(SG_context * pCtx, const char* psz_descriptor_name)
+{
+    SG_repo* pRepo = NULL;
+    SG_vhash* pvh_stats = NULL;
+    SG_uint32 count = 0;
+    SG_uint32 i;
+    SG_int_to_string_buffer buf;
+
+	SG_ERR_CHECK(  SG_REPO__OPEN_REPO_INSTANCE(pCtx, psz_descriptor_name, &pRepo)  );
+
+    SG_ERR_CHECK(  SG_repo__train_blob_dictionaries(pCtx, pRepo, &pvh_stats)  );
+
+    SG_ERR_CHECK(  SG_vhash__count(pCtx, pvh_stats, &count)  );
+    if (0 == count)
+    {
+        SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "This repo does not use compression dictionaries.\n")  );
+    }
+    for (i=0; i<count; i++)
+    {
+        const char* psz_kind = NULL;
+        SG_vhash* pvh_kind = NULL;
+        SG_int64 samples = 0;
+        SG_bool b_used = SG_FALSE;
+        SG_bool b_has = SG_FALSE;
+
+        SG_ERR_CHECK(  SG_vhash__get_nth_pair__vhash(pCtx, pvh_stats, i, &psz_kind, &pvh_kind)  );
+        SG_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvh_kind, "samples", &samples)  );
+        SG_ERR_CHECK(  SG_vhash__get__bool(pCtx, pvh_kind, "used", &b_used)  );
+
+        SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%s\n", psz_kind)  );
+        SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%12s  %12s\n", "samples", SG_int64_to_sz(samples, buf))  );
+
+        SG_ERR_CHECK(  SG_vhash__has(pCtx, pvh_kind, "id", &b_has)  );
+        if (b_has)
+        {
+            const char* psz_id = NULL;
+            SG_int64 len = 0;
+            SG_int64 len_zlib = 0;
+            SG_int64 len_zlibdict = 0;
+
+            SG_ERR_CHECK(  SG_vhash__get__sz(pCtx, pvh_kind, "id", &psz_id)  );
+            SG_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvh_kind, "length", &len)  );
+            SG_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvh_kind, "zlib", &len_zlib)  );
+            SG_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvh_kind, "zlibdict", &len_zlibdict)  );
+
+            SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%12s  %12s\n", "dictionary", psz_id)  );
+            SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%12s  %12s\n", "length", SG_int64_to_sz(len, buf))  );
+            SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%12s  %12s\n", "zlib", SG_int64_to_sz(len_zlib, buf))  );
+            SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%12s  %12s\n", "zlibdict", SG_int64_to_sz(len_zlibdict, buf))  );
+        }
+        SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDOUT, "%12s  %12s\n", "used", b_used ? "yes" : "no")  );
+    }
+
+    /* fall through */
+
+fail:
+    SG_VHASH_NULLFREE(pCtx, pvh_stats);
+    SG_REPO_NULLFREE(pCtx, pRepo);
+}
+
 void do_cmd_zip(SG_context * pCtx, SG_option_state* pOptSt, const char* psz_path)
 {
 	SG_repo* pRepo = NULL;
@@ -6370,6 +6471,23 @@ fail:
 	SG_NULLFREE(pCtx, paszArgs);
 }
 
+DECLARE_CMD_FUNC(blobdict)
+{
+	const char** paszArgs = NULL;
+
+	SG_UNUSED(pOptSt);
+	SG_UNUSED(pszCommandName);
+	SG_UNUSED(pszAppName);
+	SG_UNUSED(pExitStatus);
+
+	SG_ERR_CHECK(  _parse_and_count_args(pCtx, pGetopt, &paszArgs, 1, pbUsageError)  );
+
+    INVOKE(  do_cmd_blobdict(pCtx, paszArgs[0])  );
+
+fail:
+	SG_NULLFREE(pCtx, paszArgs);
+}
+
 #if 0
 DECLARE_CMD_FUNC(group)
 {
@@ -8578,6 +8696,19 @@ static void _parse_options(SG_context * pCtx, SG_getopt ** ppGetopt, SG_option_s
 			}
 			break;
 
+		case opt_timings:
+			{
+				pOptSt->bTimings = SG_TRUE;
+			}
+			break;
+
+		case opt_trace_json:
+			{
+				if (!pOptSt->psz_trace_json)
+					SG_ERR_CHECK(  SG_STRDUP(pCtx, pszOptArg, &pOptSt->psz_trace_json)  );
+			}
+			break;
+
 		case opt_sparse:
 			{
 				if (!pOptSt->pvaSparse)
@@ -8926,6 +9057,72 @@ static void _print_error_message_for_global_init_failed(SG_context * pCtx, int *
 
 //////////////////////////////////////////////////////////////////
 
+/**
+ * Print one table of SG_perf totals.
+ */
+static void _report_perf__totals(SG_context * pCtx, const char * pszTitle, SG_vhash * pvhTotals)
+{
+	SG_uint32 count = 0;
+	SG_uint32 k;
+
+	if (pvhTotals)
+		SG_ERR_CHECK(  SG_vhash__count(pCtx, pvhTotals, &count)  );
+
+	SG_ERR_CHECK(  SG_console(pCtx, SG_CS_STDERR, "\n%-16s %10s %12s %14s\n", pszTitle, "Calls", "ms", "Units")  );
+	for (k=0; k<count; k++)
+	{
+		const char * pszName = NULL;
+		const SG_variant * pv = NULL;
+		SG_vhash * pvhName = NULL;
+		SG_int64 calls = 0;
+		SG_int64 us = 0;
+		SG_int64 units = 0;
+		SG_int_to_string_buffer bufCalls;
+		SG_int_to_string_buffer bufUnits;
+
+		SG_ERR_CHECK(  SG_vhash__get_nth_pair(pCtx, pvhTotals, k, &pszName, &pv)  );
+		SG_ERR_CHECK(  SG_variant__get__vhash(pCtx, pv, &pvhName)  );
+		SG_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvhName, "calls", &calls)  );
+		SG_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvhName, "us", &us)  );
+		SG_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvhName, "units", &units)  );
+
+		SG_ERR_CHECK(  SG_console(pCtx, SG_CS_STDERR, "%-16s %10s %12.3f %14s\n",
+								  pszName, SG_int64_to_sz(calls, bufCalls), (double)us / 1000.0, SG_int64_to_sz(units, bufUnits))  );
+	}
+
+fail:
+	return;
+}
+
+/**
+ * Write what SG_perf collected for --trace-json and/or --timings.
+ */
+static void _report_perf(SG_context * pCtx, const SG_option_state * pOptSt)
+{
+	SG_pathname * pPathTrace = NULL;
+	SG_vhash * pvhTotals = NULL;
+
+	if (pOptSt->psz_trace_json)
+	{
+		SG_ERR_CHECK(  SG_PATHNAME__ALLOC__SZ(pCtx, &pPathTrace, pOptSt->psz_trace_json)  );
+		SG_ERR_CHECK(  SG_perf__write_trace(pCtx, pPathTrace)  );
+	}
+
+	if (pOptSt->bTimings)
+	{
+		SG_ERR_CHECK(  SG_perf__get_totals(pCtx, &pvhTotals)  );
+		SG_ERR_CHECK(  _report_perf__totals(pCtx, "Timings", pvhTotals)  );
+		SG_VHASH_NULLFREE(pCtx, pvhTotals);
+
+		SG_ERR_CHECK(  SG_perf__get_named_totals(pCtx, &pvhTotals)  );
+		SG_ERR_CHECK(  _report_perf__totals(pCtx, "Named", pvhTotals)  );
+	}
+
+fail:
+	SG_PATHNAME_NULLFREE(pCtx, pPathTrace);
+	SG_VHASH_NULLFREE(pCtx, pvhTotals);
+}
+
 static int _my_main(SG_context * pCtx, SG_getopt * pGetopt, SG_option_state* pOptSt, SG_bool bUsageError)
 {
 	int exitStatus = 0;
@@ -8943,6 +9140,7 @@ static int _my_main(SG_context * pCtx, SG_getopt * pGetopt, SG_option_state* pOp
 	SG_bool bIsServer = SG_FALSE;
 	SG_string * pLogFileHeader = NULL;
 	char * szSetting = NULL;
+	SG_int64 tPerf = 0;
 
 	SG_zero(cLogStdData);
 	SG_zero(cLogFileData);
@@ -9026,7 +9224,19 @@ static int _my_main(SG_context * pCtx, SG_getopt * pGetopt, SG_option_state* pOp
 			SG_LOCALSETTING__SERVER_SCHEME,
 			SG_LOCALSETTING__SERVER_DEBUG_DELAY,
 			SG_LOCALSETTING__SERVER_ENABLE_DIAGNOSTICS,
-			SG_LOCALSETTING__SERVER_SSJS_MUTABLE};
+			SG_LOCALSETTING__SERVER_SSJS_MUTABLE,
+			SG_LOCALSETTING__SERVER_CLONE_CACHE_SIZE,
+			SG_LOCALSETTING__SERVER_CLONE_CACHE_TOPUP_SECONDS,
+			SG_LOCALSETTING__SERVER_CLONE_CACHE_LOCK_WAIT_SECONDS,
+			SG_LOCALSETTING__SERVER_CLONE_CACHE_STALE_LOCK_SECONDS,
+			SG_LOCALSETTING__SERVER_KEEPALIVE_TIMEOUT,
+			SG_LOCALSETTING__SERVER_KEEPALIVE_MAX_REQUESTS,
+			SG_LOCALSETTING__SERVER_KEEPALIVE_MAX_IDLE,
+			SG_LOCALSETTING__SERVER_COMPRESSION_MIN_BYTES,
+			SG_LOCALSETTING__SERVER_COMPRESSION_CACHE,
+			SG_LOCALSETTING__SERVER_RESPONSE_CACHE_SIZE,
+			SG_LOCALSETTING__SERVER_RESPONSE_CACHE_VALIDATE_SECONDS,
+			SG_LOCALSETTING__SERVER_RESPONSE_CACHE_SPILL};
 		SG_uint32 i;
 
 		cLogFileWriterData.szFilenameFormat = "vv-serve-%d-%02d-%02d.log";
@@ -9051,11 +9261,22 @@ static int _my_main(SG_context * pCtx, SG_getopt * pGetopt, SG_option_state* pOp
 
 	SG_ERR_CHECK(  SG_log_text__register(pCtx, &cLogFileData, NULL, logFileFlags)  );
 
+	// --timings and --trace-json are accepted by every command.
+	if (pOptSt && (pOptSt->bTimings || pOptSt->psz_trace_json))
+	{
+		SG_ERR_CHECK(  SG_perf__global_init(pCtx, (pOptSt->psz_trace_json != NULL))  );
+		tPerf = SG_perf__start();
+	}
+
 	// dispatch the command
 	SG_ERR_CHECK(  _dispatch(pCtx, szCmd, szAppName, pCmdInfo, pGetopt, pOptSt, bUsageError, &exitStatus)  );
 
 fail:
+	if (tPerf)
+		SG_perf__stop__named(SG_PERF_CATEGORY__COMMAND, ((pCmdInfo) ? pCmdInfo->name : WHATSMYNAME), tPerf, 0);
 	_compute_exit_status_and_print_error_message(pCtx, pGetopt, &exitStatus); // DO NOT WRAP THIS WITH SG_ERR_IGNORE
+	if (tPerf)
+		SG_ERR_IGNORE(  _report_perf(pCtx, pOptSt)  );
 	SG_ERR_IGNORE(  SG_log_text__unregister(pCtx, &cLogFileData)  );
 	SG_ERR_IGNORE(  SG_log_console__unregister(pCtx, &cLogStdData)  );
 	SG_NULLFREE(pCtx, szLogLevel);
@@ -9073,6 +9294,7 @@ static void _sg_option_state__free(SG_context* pCtx, SG_option_state* pThis)
 
 	SG_NULLFREE(pCtx, pThis->psz_restore_backup);
 	SG_NULLFREE(pCtx, pThis->psz_path);
+	SG_NULLFREE(pCtx, pThis->psz_trace_json);
 	SG_NULLFREE(pCtx, pThis->psz_repo);
 	SG_NULLFREE(pCtx, pThis->psz_cert);
 	SG_NULLFREE(pCtx, pThis->psz_comment);
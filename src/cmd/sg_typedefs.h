@@ -101,6 +101,8 @@ typedef enum
 	opt_no_allow_after_the_fact,
 	opt_no_fallback,
 	opt_allow_dirty,
+	opt_timings,		// accepted by every command
+	opt_trace_json,		// accepted by every command
 
 #if defined(DEBUG)
 	opt_dagnum,			// debug
@@ -166,6 +168,7 @@ struct _sg_option_state
 	char* psz_shared_users;
 	char* psz_label;
 	char* psz_path;
+	char* psz_trace_json;
 
 	SG_stringarray* psa_branch_names;
 	SG_stringarray* psa_revs;
@@ -200,6 +203,7 @@ struct _sg_option_state
 	SG_bool bPack;
 	SG_bool bTest;
 	SG_bool bTrace;
+	SG_bool bTimings;
 	SG_bool bUpdate;
 	SG_bool bVerbose;
 	SG_bool bQuiet;
@@ -0,0 +1,126 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+load("../js_test_lib/vscript_test_lib.js");
+
+//////////////////////////////////////////////////////////////////
+// Verify that sg.vv2.status_range() gives the same answer for
+// each cset in a line of history as sg.vv2.status() does for
+// that cset and its parent.
+//////////////////////////////////////////////////////////////////
+
+function st_vv2_status_range()
+{
+    load("update_helpers.js");          // load the helper functions
+    initialize_update_helpers(this);    // initialize helper functions
+
+    //////////////////////////////////////////////////////////////////
+
+    this.setUp = function()
+    {
+        this.workdir_root = sg.fs.getcwd();     // save this for later
+        this.generate_test_changesets();
+    }
+
+    this.compare_status_items1 = function( s0, s1 )
+    {
+	if (s0.status.flags != s1.status.flags)
+	    return false;
+	if (s0.gid != s1.gid)
+	    return false;
+	if (s0.path != s1.path)
+	    return false;
+	if ((s0.A == undefined) != (s1.A == undefined))
+	    return false;
+	if ((s0.B == undefined) != (s1.B == undefined))
+	    return false;
+	if ((s0.A != undefined) && ((s0.A.path != s1.A.path) || (s0.A.gid_parent != s1.A.gid_parent)))
+	    return false;
+	if ((s0.B != undefined) && ((s0.B.path != s1.B.path) || (s0.B.gid_parent != s1.B.gid_parent)))
+	    return false;
+
+	return true;
+    }
+
+    this.compare_status = function( range_k, pair_k, msg )
+    {
+	testlib.ok( (range_k.length == pair_k.length),
+		    msg + ": range has " + range_k.length + " items; pair has " + pair_k.length );
+	if (range_k.length != pair_k.length)
+	    return;
+
+	for (var j=0; j<pair_k.length; j++)
+	{
+	    var eq = this.compare_status_items1(range_k[j], pair_k[j]);
+	    testlib.ok( (eq), msg + ": item " + j );
+	    if (!eq)
+	    {
+		print("range item is:");
+		print(sg.to_json__pretty_print(range_k[j]));
+		print("pair item is:");
+		print(sg.to_json__pretty_print(pair_k[j]));
+	    }
+	}
+    }
+
+    this.test_whole_line = function()
+    {
+	var n = this.csets.length;
+	var range = sg.vv2.status_range( { "revs" : [ {"rev" : this.csets[0]},
+						      {"rev" : this.csets[n-1]} ] } );
+
+	testlib.ok( (range.length == n-1), "Expect " + (n-1) + " rows; got " + range.length );
+
+	for (var k=0; k<range.length; k++)
+	{
+	    var msg = "[" + this.names[k] + "] ==> [" + this.names[k+1] + "]";
+
+	    testlib.ok( (range[k].cset0 == this.csets[k]),   msg + ": cset0" );
+	    testlib.ok( (range[k].cset1 == this.csets[k+1]), msg + ": cset1" );
+
+	    var pair = sg.vv2.status( { "revs" : [ {"rev" : this.csets[k]},
+						   {"rev" : this.csets[k+1]} ] } );
+	    this.compare_status( range[k].changes, pair, msg );
+	}
+    }
+
+    this.test_reversed_revs = function()
+    {
+	// the order of the revs doesn't matter; the rows are always oldest first.
+
+	var range = sg.vv2.status_range( { "revs" : [ {"rev" : this.csets[3]},
+						      {"rev" : this.csets[1]} ] } );
+
+	testlib.ok( (range.length == 2), "Expect 2 rows; got " + range.length );
+	testlib.ok( (range[0].cset0 == this.csets[1]), "Row 0 starts at csets[1]" );
+	testlib.ok( (range[1].cset1 == this.csets[3]), "Row 1 ends at csets[3]" );
+    }
+
+    this.test_same_cset = function()
+    {
+	try
+	{
+	    sg.vv2.status_range( { "revs" : [ {"rev" : this.csets[1]},
+					      {"rev" : this.csets[1]} ] } );
+	    testlib.ok( (0), "Expected an error for a range of 1 cset." );
+	}
+	catch (e)
+	{
+	    testlib.ok( (1), "Got expected error: " + e.toString() );
+	}
+    }
+
+}
@@ -0,0 +1,171 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+load("../js_test_lib/vscript_test_lib.js");
+
+//////////////////////////////////////////////////////////////////
+// CHECKOUT and UPDATE of enough files that the blobs are fetched
+// by the thread pool in sg_wc_fetch_blobs.c rather than one at a
+// time.  (It starts extra threads once there are 16 files per
+// thread, so a few hundred files is plenty.)  Verify that every
+// file in the new WD has the right contents.
+//////////////////////////////////////////////////////////////////
+
+function st_wc_checkout_many_files()
+{
+    var my_group = "st_wc_checkout_many_files";	// this variable must match the above group name.
+
+    this.no_setup = true;		// do not create an initial REPO and WD.
+
+    //////////////////////////////////////////////////////////////////
+
+    load("update_helpers.js");          // load the helper functions
+    initialize_update_helpers(this);    // initialize helper functions
+
+    //////////////////////////////////////////////////////////////////
+
+    var nrDirs = 8;
+    var nrFilesPerDir = 40;
+
+    var my_path = function(d, f)
+    {
+	return "dir_" + d + "/file_" + f + ".txt";
+    }
+
+    var my_content = function(d, f, version)
+    {
+	// every 5th file has the same content as all the others
+	// like it, so some jobs in the pool share a blob.
+
+	if ((f % 5) == 0)
+	    return "shared content " + version + "\n";
+
+	var s = "";
+	var nrLines = 1 + ((d * nrFilesPerDir + f) % 50) * 20;
+	for (var k=0; k<nrLines; k++)
+	    s += "dir " + d + " file " + f + " version " + version + " line " + k + "\n";
+	return s;
+    }
+
+    var my_verify_wd = function(wd, expected, label)
+    {
+	var nrBad = 0;
+
+	for (var p in expected)
+	{
+	    var pathname = pathCombine(wd, p);
+	    if (!sg.fs.exists(pathname))
+	    {
+		testlib.ok( (0), label + ": missing " + p );
+		nrBad++;
+	    }
+	    else if (sg.file.read(pathname) != expected[p])
+	    {
+		testlib.ok( (0), label + ": wrong content in " + p );
+		nrBad++;
+	    }
+	}
+	testlib.ok( (nrBad == 0), label + ": all files match" );
+    }
+
+    this.test_it = function()
+    {
+	var unique = my_group + "_" + new Date().getTime();
+
+	var repoName = unique;
+	var rootDir = pathCombine(tempDir, unique);
+	var wd_0 = pathCombine(rootDir, "wd_0");
+	var wd_1 = pathCombine(rootDir, "wd_1");
+	var wd_2 = pathCombine(rootDir, "wd_2");
+	var expected_A = {};
+	var expected_B = {};
+	var csets = {};
+
+	//////////////////////////////////////////////////////////////////
+	// Create the first WD and initialize the REPO.
+
+	this.do_fsobj_mkdir_recursive( wd_0 );
+	this.do_fsobj_cd( wd_0 );
+	sg.vv2.init_new_repo( { "repo" : repoName,
+				"hash" : "SHA1/160",
+				"path" : "."
+			      } );
+	whoami_testing(repoName);
+
+	for (var d=0; d<nrDirs; d++)
+	{
+	    this.do_fsobj_mkdir("dir_" + d);
+	    for (var f=0; f<nrFilesPerDir; f++)
+	    {
+		var p = my_path(d, f);
+		expected_A[p] = my_content(d, f, "A");
+		sg.file.write(p, expected_A[p]);
+	    }
+	}
+	vscript_test_wc__addremove();
+	csets.A = vscript_test_wc__commit("A");
+
+	// Change most (but not all) of the files for B.
+
+	for (var d=0; d<nrDirs; d++)
+	{
+	    for (var f=0; f<nrFilesPerDir; f++)
+	    {
+		var p = my_path(d, f);
+		if ((f % 3) == 0)
+		    expected_B[p] = expected_A[p];
+		else
+		{
+		    expected_B[p] = my_content(d, f, "B");
+		    sg.file.write(p, expected_B[p]);
+		}
+	    }
+	}
+	csets.B = vscript_test_wc__commit("B");
+
+	//////////////////////////////////////////////////////////////////
+	// CHECKOUT each cset into a fresh WD.
+
+	this.do_fsobj_mkdir_recursive( wd_1 );
+	this.do_fsobj_cd( wd_1 );
+	vscript_test_wc__checkout_np( { "repo"   : repoName,
+					"attach" : "master",
+					"rev"    : csets.A } );
+	my_verify_wd(wd_1, expected_A, "Checkout A");
+
+	this.do_fsobj_mkdir_recursive( wd_2 );
+	this.do_fsobj_cd( wd_2 );
+	vscript_test_wc__checkout_np( { "repo"   : repoName,
+					"attach" : "master",
+					"rev"    : csets.B } );
+	my_verify_wd(wd_2, expected_B, "Checkout B");
+
+	//////////////////////////////////////////////////////////////////
+	// UPDATE goes through the same pool when it prefetches the
+	// new contents of the modified files.
+
+	this.do_fsobj_cd( wd_1 );
+	vscript_test_wc__update( csets.B );
+	my_verify_wd(wd_1, expected_B, "Update A to B");
+
+	vscript_test_wc__update( csets.A );
+	my_verify_wd(wd_1, expected_A, "Update B to A");
+
+	var status = sg.wc.status();
+	testlib.ok( (status.length == 0), "WD should be clean after UPDATE." );
+    }
+
+}
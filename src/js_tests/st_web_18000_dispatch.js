@@ -22,12 +22,15 @@ function st_web_dispatch() {
 
     suite.setUp = function () {
         this.suite_setUp();
+        // Short enough for testKeepAliveIdleTimeout to wait out.
+        sg.set_local_setting("server/keepalive/timeout_seconds", "2");
         this.server_process = new vv_serve_process(18000, { runFromWorkingCopy: false });
         this.rootUrl = this.server_process.url;
     }
 
     suite.tearDown = function () {
         this.server_process.stop();
+        sg.local_settings(["reset"], "server/keepalive/timeout_seconds");
     }
 
     return suite;
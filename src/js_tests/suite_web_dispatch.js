@@ -676,4 +676,118 @@ function suite_web_dispatch() {
 		}
 		
 	};
+
+	/* Send the text of one or more requests on a single connection (curl's
+	 * telnet mode sends a file as is), and split what comes back into
+	 * responses.  curl returns once the server closes the connection. */
+	this.rawRequests = function(text)
+	{
+		var path = pathCombine(tempDir, "raw-requests");
+		var o;
+
+		sg.file.write(path, text);
+		o = sg.exec("curl", "-s", "-m", "30", "-T", path, this.rootUrl.replace(/^http:/, "telnet:"));
+		o.responses = o.stdout.length ? o.stdout.split(/(?=^HTTP\/1\.1 \d\d\d )/m) : [];
+		return o;
+	};
+
+	this.rawStatus = function(response)
+	{
+		return this.firstLineOf(response).replace(/^HTTP\/1\.1 /, "");
+	};
+
+	this.rawBody = function(response)
+	{
+		return response.substring(response.indexOf("\r\n\r\n") + 4);
+	};
+
+	this.testKeepAliveReusesConnection = function()
+	{
+		var url = this.rootUrl + "/version.txt";
+		var o = sg.exec("curl", "-s", "-v", url, url);
+
+		testlib.equal(0, o.exit_status, "curl");
+		testlib.ok(/^< Connection: keep-alive/m.test(o.stderr), "server keeps the connection");
+		testlib.ok(/Re-using existing connection/.test(o.stderr), "second request uses the same connection");
+	};
+
+	this.testKeepAlivePipelined = function()
+	{
+		var version = curl(this.rootUrl + "/version.txt").body;
+		var o = this.rawRequests(
+			"GET /version.txt HTTP/1.1\r\nHost: localhost\r\n\r\n" +
+			"GET /test/responses/ok HTTP/1.1\r\nHost: localhost\r\n\r\n" +
+			"GET /version.txt HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+
+		testlib.equal(0, o.exit_status, "server closed the connection");
+		if (!testlib.equal(3, o.responses.length, "responses"))
+			return;
+
+		this.checkStatus("200 OK", this.rawStatus(o.responses[0]), "first");
+		this.checkHeader("Connection", "keep-alive", o.responses[0], "first");
+		testlib.equal(version, this.rawBody(o.responses[0]), "first");
+
+		this.checkStatus("200 OK", this.rawStatus(o.responses[1]), "second");
+		this.checkHeader("Connection", "keep-alive", o.responses[1], "second");
+		this.checkHeader("Content-Length", "0", o.responses[1], "second");
+
+		this.checkStatus("200 OK", this.rawStatus(o.responses[2]), "third");
+		this.checkHeader("Connection", "close", o.responses[2], "third");
+		testlib.equal(version, this.rawBody(o.responses[2]), "third");
+	};
+
+	this.testKeepAliveUnreadBodyCloses = function()
+	{
+		// Neither of these reads the body, and the server can't tell
+		// where the next request would start, so the connection is closed.
+		var paths = [ "/test/responses/ok", "/ui/sg.css" ];
+
+		for (var i in paths)
+		{
+			var o = this.rawRequests(
+				"GET " + paths[i] + " HTTP/1.1\r\nHost: localhost\r\nContent-Length: 1000\r\n\r\n" +
+				"only part of the body\r\n" +
+				"GET /version.txt HTTP/1.1\r\nHost: localhost\r\n\r\n");
+
+			testlib.equal(0, o.exit_status, paths[i] + ": server closed the connection");
+			if (testlib.equal(1, o.responses.length, paths[i] + ": responses"))
+			{
+				this.checkStatus("200 OK", this.rawStatus(o.responses[0]), paths[i]);
+				this.checkHeader("Connection", "close", o.responses[0], paths[i]);
+			}
+		}
+	};
+
+	this.testKeepAliveIdleTimeout = function()
+	{
+		// st_web_dispatch sets server/keepalive/timeout_seconds to 2.
+		var o = this.rawRequests("GET /test/responses/ok HTTP/1.1\r\nHost: localhost\r\n\r\n");
+
+		testlib.equal(0, o.exit_status, "server closed the idle connection");
+		if (testlib.equal(1, o.responses.length, "responses"))
+			this.checkHeader("Connection", "keep-alive", o.responses[0]);
+		testlib.ok(o.duration >= 1500, "connection was kept for a while (" + o.duration + "ms)");
+		testlib.ok(o.duration < 15000, "and then closed (" + o.duration + "ms)");
+	};
+
+	this.testKeepAliveHead = function()
+	{
+		var version = curl(this.rootUrl + "/version.txt").body;
+		var o = this.rawRequests(
+			"HEAD /version.txt HTTP/1.1\r\nHost: localhost\r\n\r\n" +
+			"GET /version.txt HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+
+		testlib.equal(0, o.exit_status, "server closed the connection");
+		if (!testlib.equal(2, o.responses.length, "responses"))
+			return;
+
+		// The HEAD response has the length of the body it doesn't send.
+		this.checkStatus("200 OK", this.rawStatus(o.responses[0]), "HEAD");
+		this.checkHeader("Connection", "keep-alive", o.responses[0], "HEAD");
+		this.checkHeader("Content-Length", String(version.length), o.responses[0], "HEAD");
+		testlib.equal("", this.rawBody(o.responses[0]), "HEAD");
+
+		this.checkStatus("200 OK", this.rawStatus(o.responses[1]), "GET");
+		testlib.equal(version, this.rawBody(o.responses[1]), "GET");
+	};
 }
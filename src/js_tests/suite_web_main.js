@@ -1899,6 +1899,201 @@ function suite_web_main(hasWorkingCopy) {
 		sg.fs.remove(blobfile.path);
     };
 
+    // Clone the repo with every blob stored one way, so we know which
+    // way the server is going to send them.
+    this.cloneBlobsAs = function(cloneFn) {
+        var name = sg.gid();
+
+        sg[cloneFn]({ "existing_repo": repInfo.repoName, "new_repo": name, "override_alwaysfull": true });
+        return name;
+    };
+
+    this.testGetBlobRanges = function testGetBlobRanges() {
+        var name = this.cloneBlobsAs("clone__all_full");
+        var bloburl = this.rootUrl + "/repos/" + encodeURI(name) + "/blobs/" + this.changesetId;
+        var etag = '"' + this.changesetId + '"';
+        var repo = sg.open_repo(name);
+        var range = repo.blob_file_range(this.changesetId);
+        repo.close();
+
+        if (!testlib.ok(!!range, "full blob is sent from its file"))
+            return;
+
+        var o = curl(bloburl);
+        if (!this.checkStatus("200 OK", o.status, "whole blob"))
+            return;
+        var full = o.body;
+        var len = full.length;
+        this.checkHeader("Accept-Ranges", "bytes", o.headers);
+        this.checkHeader("ETag", etag, o.headers);
+        this.checkHeader("Content-Length", String(len), o.headers);
+
+        o = curl("-H", "Range: bytes=2-9", bloburl);
+        this.checkStatus("206 Partial Content", o.status, "a-b");
+        this.checkHeader("Content-Range", "bytes 2-9/" + len, o.headers, "a-b");
+        this.checkHeader("Content-Length", "8", o.headers, "a-b");
+        testlib.equal(full.substring(2, 10), o.body, "a-b");
+
+        o = curl("-H", "Range: bytes=10-", bloburl);
+        this.checkStatus("206 Partial Content", o.status, "a-");
+        this.checkHeader("Content-Range", "bytes 10-" + (len - 1) + "/" + len, o.headers, "a-");
+        testlib.equal(full.substring(10), o.body, "a-");
+
+        o = curl("-H", "Range: bytes=-5", bloburl);
+        this.checkStatus("206 Partial Content", o.status, "-n");
+        this.checkHeader("Content-Range", "bytes " + (len - 5) + "-" + (len - 1) + "/" + len, o.headers, "-n");
+        testlib.equal(full.substring(len - 5), o.body, "-n");
+
+        o = curl("-H", "Range: bytes=" + len + "-", bloburl);
+        this.checkStatus("416 Requested Range Not Satisfiable", o.status, "past the end");
+        this.checkHeader("Content-Range", "bytes */" + len, o.headers, "past the end");
+        testlib.equal("", o.body, "past the end");
+
+        o = curl("-H", "Range: bytes=10-", "-H", "If-Range: " + etag, bloburl);
+        this.checkStatus("206 Partial Content", o.status, "matching If-Range");
+        testlib.equal(full.substring(10), o.body, "matching If-Range");
+
+        o = curl("-H", "Range: bytes=10-", "-H", 'If-Range: "0123"', bloburl);
+        this.checkStatus("200 OK", o.status, "stale If-Range");
+        this.checkHeader("Content-Range", undefined, o.headers, "stale If-Range");
+        testlib.equal(full, o.body, "stale If-Range");
+
+        o = curl("-H", "If-None-Match: " + etag, bloburl);
+        this.checkStatus("304 Not Modified", o.status, "If-None-Match");
+        this.checkHeader("ETag", etag, o.headers, "If-None-Match");
+        testlib.equal("", o.body, "If-None-Match");
+    };
+
+    this.testGetBlobNotInFile = function testGetBlobNotInFile() {
+        var name = this.cloneBlobsAs("clone__all_zlib");
+        var bloburl = this.rootUrl + "/repos/" + encodeURI(name) + "/blobs/" + this.changesetId;
+        var etag = '"' + this.changesetId + '"';
+        var repo = sg.open_repo(name);
+        var range = repo.blob_file_range(this.changesetId);
+        var blobfile = repo.fetch_blob_into_tempfile(this.changesetId, true);
+        repo.close();
+
+        testlib.equal(null, range, "compressed blob has no file range");
+
+        // The blob is sent the slow way, and all of it, whatever the Range.
+        var o = curl("-H", "Range: bytes=10-", bloburl);
+        if (this.checkStatus("200 OK", o.status, "compressed blob")) {
+            this.checkHeader("Content-Range", undefined, o.headers, "compressed blob");
+            this.checkHeader("ETag", etag, o.headers, "compressed blob");
+            sg.file.write("temp.txt", o.body);
+            testlib.testResult(compareFiles(blobfile.path, "temp.txt"), "compressed blob");
+            sg.fs.remove("temp.txt");
+        }
+
+        o = curl("-H", "If-None-Match: " + etag, bloburl);
+        this.checkStatus("304 Not Modified", o.status, "compressed blob, If-None-Match");
+
+        sg.fs.remove(blobfile.path);
+    };
+
+    this.headerValue = function(headerName, headerBlock) {
+        var match = new RegExp("^" + headerName + ":[ \t]*(.*?)[ \t]*$", "im").exec(headerBlock);
+        return (match ? match[1] : undefined);
+    };
+
+    // A wiki page big enough for the server to gzip, served with an ETag.
+    this.gzipPageUrl = function() {
+        var title = "gzip_" + sg.gid();
+        var text = "";
+        var repo = sg.open_repo(repInfo.repoName);
+
+        for (var i = 0; i < 200; i++)
+            text += "Line " + i + " of a wiki page long enough to be worth compressing.\n";
+
+        try {
+            var db = new zingdb(repo, sg.dagnum.WIKI);
+            var ztx = db.begin_tx(null, this.userId);
+            var rec = ztx.new_record("page");
+            rec.title = title;
+            rec.text = text;
+            ztx.commit();
+        }
+        finally {
+            repo.close();
+        }
+
+        return this.repoUrl + "/wiki/page.json?title=" + title;
+    };
+
+    this.testGzipDynamic = function testGzipDynamic() {
+        var url = this.gzipPageUrl();
+
+        var plain = curl(url);
+        if (!this.checkStatus("200 OK", plain.status, "without Accept-Encoding"))
+            return;
+        var etag = this.headerValue("ETag", plain.headers);
+        testlib.ok(!!etag, "ETag");
+        testlib.ok(plain.body.length >= 1024, "big enough to gzip");
+        this.checkHeader("Content-Encoding", undefined, plain.headers, "without Accept-Encoding");
+        // Caches have to know the answer depends on Accept-Encoding either way.
+        this.checkHeader("Vary", "Accept-Encoding", plain.headers, "without Accept-Encoding");
+
+        // --compressed asks for gzip and decodes it.
+        var gz = curl("--compressed", url);
+        if (this.checkStatus("200 OK", gz.status, "gzipped")) {
+            this.checkHeader("Content-Encoding", "gzip", gz.headers, "gzipped");
+            this.checkHeader("Transfer-Encoding", "chunked", gz.headers, "gzipped");
+            this.checkHeader("Vary", "Accept-Encoding", gz.headers, "gzipped");
+            testlib.equal(plain.body, gz.body, "gzipped body decodes to the same bytes");
+        }
+        var gzEtag = this.headerValue("ETag", gz.headers);
+        testlib.equal(etag.replace(/"$/, '-gzip"'), gzEtag, "gzipped ETag");
+
+        var o = curl("--compressed", "-H", "If-None-Match: " + gzEtag, url);
+        this.checkStatus("304 Not Modified", o.status, "gzipped ETag");
+        o = curl("-H", "If-None-Match: " + etag, url);
+        this.checkStatus("304 Not Modified", o.status, "plain ETag");
+        o = curl("--compressed", "-H", 'If-None-Match: "0123-gzip"', url);
+        this.checkStatus("200 OK", o.status, "stale gzipped ETag");
+
+        o = curl("-H", "Accept-Encoding: gzip;q=0", url);
+        this.checkStatus("200 OK", o.status, "q=0");
+        this.checkHeader("Content-Encoding", undefined, o.headers, "q=0");
+        testlib.equal(plain.body, o.body, "q=0");
+
+        // Without chunking there's no way to send it gzipped.
+        o = curl("-0", "-H", "Accept-Encoding: gzip", url);
+        this.checkStatus("200 OK", o.status, "HTTP/1.0");
+        this.checkHeader("Content-Encoding", undefined, o.headers, "HTTP/1.0");
+        testlib.equal(plain.body, o.body, "HTTP/1.0");
+    };
+
+    this.testGzipStatic = function testGzipStatic() {
+        var url = this.rootUrl + "/ui/sg.css";
+
+        var plain = curl(url);
+        if (!this.checkStatus("200 OK", plain.status, "without Accept-Encoding"))
+            return;
+        var etag = this.headerValue("ETag", plain.headers);
+        this.checkHeader("Content-Encoding", undefined, plain.headers, "without Accept-Encoding");
+        this.checkHeader("Vary", "Accept-Encoding", plain.headers, "without Accept-Encoding");
+
+        var gz = curl("--compressed", url);
+        if (this.checkStatus("200 OK", gz.status, "gzipped")) {
+            this.checkHeader("Content-Encoding", "gzip", gz.headers, "gzipped");
+            this.checkHeader("Vary", "Accept-Encoding", gz.headers, "gzipped");
+            testlib.equal(plain.body, gz.body, "gzipped body decodes to the same bytes");
+        }
+        var gzEtag = this.headerValue("ETag", gz.headers);
+        testlib.equal(etag.replace(/"$/, '-gzip"'), gzEtag, "gzipped ETag");
+
+        var o = curl("--compressed", "-H", "If-None-Match: " + gzEtag, url);
+        this.checkStatus("304 Not Modified", o.status, "gzipped ETag");
+        o = curl("-H", "If-None-Match: " + etag, url);
+        this.checkStatus("304 Not Modified", o.status, "plain ETag");
+
+        // A range is of the file itself, so it isn't gzipped.
+        o = curl("--compressed", "-H", "Range: bytes=0-99", url);
+        this.checkStatus("206 Partial Content", o.status, "range");
+        this.checkHeader("Content-Encoding", undefined, o.headers, "range");
+        testlib.equal(plain.body.substring(0, 100), o.body, "range");
+    };
+
     this.testWorkItemRoundTrip = function() {
 		var url = this.repoUrl + "/workitems.json";
         var username = this.userId;
@@ -141,6 +141,251 @@ function suite_web_sync()
 		repo.close();
 	};
 
+	/* The server keeps clone fragballs in its temp directory (see sync.js). */
+	var cloneFragballDir = function()
+	{
+		return sg.fs.tmpdir();
+	};
+
+	var listCloneFragballs = function()
+	{
+		var names = {};
+		var entries = sg.fs.readdir(cloneFragballDir());
+
+		for (var i = 0; i < entries.length; i++)
+		{
+			var name = entries[i].name;
+			if ((name.indexOf("clone-") == 0) && !/\.(lock|lease)$/.test(name))
+				names[name] = true;
+		}
+		return names;
+	};
+
+	/* Clone sourceRepo over HTTP and return the names of any clone fragballs the
+	 * server added to its cache while doing it. */
+	var cloneAndListNewFragballs = function(destName)
+	{
+		var before = listCloneFragballs();
+		var after;
+		var added = [];
+
+		sg.clone__exact(sourceRepoHttpPath, destName);
+
+		after = listCloneFragballs();
+		for (var name in after)
+			if (!before[name])
+				added.push(name);
+		return added;
+	};
+
+	var commitToSource = function(fileName)
+	{
+		repInfo = sourceRepo;
+		createFileOnDisk(fileName, 1);
+		addRemoveAndCommit();
+	};
+
+	var verifyCloneOfSource = function(destName, msg)
+	{
+		var repo = sg.open_repo(sourceRepo.repoName);
+		try
+		{
+			testlib.testResult(repo.compare(destName), msg);
+		}
+		finally
+		{
+			repo.close();
+		}
+	};
+
+	var requestCloneFragball = function(body)
+	{
+		return curl("-d", body, sourceRepoHttpPath + "/sync.fragball");
+	};
+
+	var resetCloneCacheSettings = function()
+	{
+		sg.set_local_setting("server/clone_cache/max_mb", "");
+		sg.set_local_setting("server/clone_cache/topup_seconds", "");
+		sg.set_local_setting("server/clone_cache/lock_wait_seconds", "");
+		sg.set_local_setting("server/clone_cache/stale_lock_seconds", "");
+	};
+
+	this.testCloneTopUp = function()
+	{
+		var destName = "topup_" + sg.gid();
+		var o;
+
+		try
+		{
+			sg.set_local_setting("server/clone_cache/topup_seconds", "600");
+
+			// Make sure there's a cached fragball, then move the repo past it.
+			sg.clone__exact(sourceRepoHttpPath, "topup_first_" + sg.gid());
+			commitToSource("topup.txt");
+
+			o = requestCloneFragball('{"clone":null,"clone_request":{"topup":true}}');
+			testlib.equal("200 OK", o.status);
+			testlib.ok(o.headers.indexOf("X-Veracity-Clone-Stale: 1") >= 0, "cached fragball is marked stale");
+
+			// The clone gets the cached fragball and tops up with the new changeset.
+			sg.clone__exact(sourceRepoHttpPath, destName);
+			verifyCloneOfSource(destName, "After topped-up HTTP clone, repos are identical");
+
+			o = requestCloneFragball('{"clone":null}');
+			testlib.equal("200 OK", o.status);
+			testlib.ok(o.headers.indexOf("X-Veracity-Clone-Stale") < 0, "exact fragball isn't marked stale");
+		}
+		finally
+		{
+			resetCloneCacheSettings();
+		}
+	};
+
+	var responseHeader = function(o, name)
+	{
+		var match = new RegExp("^" + name + ":[ \t]*(.*?)[ \t]*$", "im").exec(o.headers);
+		return match ? match[1] : null;
+	};
+
+	this.testCloneFragballResume = function()
+	{
+		var url = sourceRepoHttpPath + "/sync.fragball";
+		var o, etag, len;
+
+		o = requestCloneFragball('{"clone":null}');
+		testlib.equal("200 OK", o.status);
+		testlib.equal("bytes", responseHeader(o, "Accept-Ranges"), "clone fragball accepts ranges");
+		etag = responseHeader(o, "ETag");
+		len = Number(responseHeader(o, "Content-Length"));
+		testlib.ok(!!etag, "clone fragball has an ETag");
+		testlib.ok(len > 10, "clone fragball has a body");
+
+		o = requestCloneFragball('{"clone":null}');
+		testlib.equal(etag, responseHeader(o, "ETag"), "ETag is the same for the same fragball");
+
+		// Pick up where an interrupted download left off.
+		o = curl("-d", '{"clone":null}', "-H", "Range: bytes=10-", "-H", "If-Range: " + etag, url);
+		testlib.equal("206 Partial Content", o.status);
+		testlib.equal("bytes 10-" + (len - 1) + "/" + len, responseHeader(o, "Content-Range"));
+		testlib.equal(String(len - 10), responseHeader(o, "Content-Length"));
+
+		// A partial download of some other fragball gets the whole thing.
+		o = curl("-d", '{"clone":null}', "-H", "Range: bytes=10-", "-H", 'If-Range: "nope"', url);
+		testlib.equal("200 OK", o.status);
+		testlib.equal(String(len), responseHeader(o, "Content-Length"));
+		testlib.equal(null, responseHeader(o, "Content-Range"));
+
+		// Asking for more than there is gets a 416, which the client starts over on.
+		o = curl("-d", '{"clone":null}', "-H", "Range: bytes=" + len + "-", "-H", "If-Range: " + etag, url);
+		testlib.equal("416 Requested Range Not Satisfiable", o.status);
+		testlib.equal("bytes */" + len, responseHeader(o, "Content-Range"));
+	};
+
+	this.testCloneLeaseKeepsFragball = function()
+	{
+		var added;
+		var leased;
+
+		try
+		{
+			// Every trim wants everything gone.
+			sg.set_local_setting("server/clone_cache/max_mb", "0");
+			sg.set_local_setting("server/clone_cache/topup_seconds", "0");
+
+			commitToSource("lease1.txt");
+			added = cloneAndListNewFragballs("lease_a_" + sg.gid());
+			testlib.equal(1, added.length, "first clone built a fragball");
+			leased = added[0];
+
+			// Building the next one trims the cache, but the first is still leased.
+			commitToSource("lease2.txt");
+			added = cloneAndListNewFragballs("lease_b_" + sg.gid());
+			testlib.equal(1, added.length, "second clone built a fragball");
+			testlib.ok(sg.fs.exists(pathCombine(cloneFragballDir(), leased)), "leased fragball survives a trim");
+
+			// Once its lease is gone, the next trim takes it.
+			sg.fs.remove(pathCombine(cloneFragballDir(), leased + ".lease"));
+			commitToSource("lease3.txt");
+			cloneAndListNewFragballs("lease_c_" + sg.gid());
+			testlib.ok(!sg.fs.exists(pathCombine(cloneFragballDir(), leased)), "unleased fragball is trimmed");
+		}
+		finally
+		{
+			resetCloneCacheSettings();
+		}
+	};
+
+	/* Build a fragball for the current state of sourceRepo, then take it out of
+	 * the cache and leave a lock in its place, as if another server were still
+	 * building it.  Returns the fragball's path. */
+	var lockUncachedFragball = function(fileName)
+	{
+		var added;
+		var path;
+
+		commitToSource(fileName);
+		added = cloneAndListNewFragballs("lock_setup_" + sg.gid());
+		testlib.equal(1, added.length, "clone built a fragball");
+		path = pathCombine(cloneFragballDir(), added[0]);
+
+		sg.fs.remove(path);
+		sg.fs.remove(path + ".lease");
+		sg.file.write(path + ".lock", "");
+		return path;
+	};
+
+	this.testCloneLockWaitIsBounded = function()
+	{
+		var destName = "lockwait_" + sg.gid();
+		var path;
+		var added;
+
+		try
+		{
+			sg.set_local_setting("server/clone_cache/topup_seconds", "0");
+			path = lockUncachedFragball("lockwait.txt");
+
+			sg.set_local_setting("server/clone_cache/lock_wait_seconds", "1");
+			added = cloneAndListNewFragballs(destName);
+			verifyCloneOfSource(destName, "Clone that gave up waiting for the lock is complete");
+			testlib.equal(1, added.length, "clone built its own fragball");
+			testlib.ok(added[0] != getFileNameFromPath(path), "under a name of its own");
+			testlib.ok(sg.fs.exists(path + ".lock"), "the other builder's lock is left alone");
+
+			sg.fs.remove(path + ".lock");
+		}
+		finally
+		{
+			resetCloneCacheSettings();
+		}
+	};
+
+	this.testCloneStaleLockTakenOver = function()
+	{
+		var destName = "stalelock_" + sg.gid();
+		var path;
+
+		try
+		{
+			sg.set_local_setting("server/clone_cache/topup_seconds", "0");
+			path = lockUncachedFragball("stalelock.txt");
+
+			// A builder that hasn't touched its lock in this long is presumed dead.
+			sg.set_local_setting("server/clone_cache/stale_lock_seconds", "1");
+			sg.sleep_ms(2000);
+
+			sg.clone__exact(sourceRepoHttpPath, destName);
+			verifyCloneOfSource(destName, "Clone after a stale lock is complete");
+			testlib.ok(sg.fs.exists(path), "fragball was built under the stale lock's name");
+			testlib.ok(!sg.fs.exists(path + ".lock"), "stale lock was taken over and released");
+		}
+		finally
+		{
+			resetCloneCacheSettings();
+		}
+	};
+
 	this.testHeartbeat = function()
 	{
 		var url = sourceRepoHttpPath + "/heartbeat.json";
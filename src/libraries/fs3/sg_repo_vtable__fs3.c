@@ -95,6 +95,7 @@ struct _my_tx_data
     SG_rbtree* prb_frags;
     sqlite3* psql_new_audits;
     sqlite3_stmt* pStmt_audits;
+    sqlite3_stmt* pStmt_inline;
     SG_blobset* pbs_new_blobs;
 	sg_blob_fs3_handle_store* pBlobStoreHandle;
 
@@ -107,6 +108,16 @@ struct _my_tx_data
 };
 typedef struct _my_tx_data my_tx_data;
 
+/* The kinds of small JSON blobs which get their own trained zlib
+ * dictionary.  See sg_fs3__zdict__classify(). */
+#define sg_FS3_ZDICT__CHANGESET		0
+#define sg_FS3_ZDICT__TREENODE		1
+#define sg_FS3_ZDICT__DBRECORD		2
+#define sg_FS3_ZDICT__TEMPLATE		3
+#define sg_FS3_ZDICT__COUNT			4
+
+#define sg_FS3_ZDICT_ID_BUFFER_LENGTH	16
+
 /**
  * we get one pointer in the SG_repo for our instance data.  in SG_repo
  * this is an opaque "sg_repo__vtable__instance_data *".  we cast it
@@ -132,6 +143,14 @@ struct _my_instance_data
     SG_rbtree*                  prb_sql;
 
     SG_bool b_new_audits;
+    SG_bool b_inline_blobs;
+
+    /* zlib dictionaries from the props table, loaded on first use.
+     * prb_zdicts maps a dictionary id to its sg_fs3_zdict.  The current
+     * dictionary for each kind is "" if it has none. */
+    SG_bool b_zdicts_loaded;
+    SG_rbtree* prb_zdicts;
+    char aa_zdict_current[sg_FS3_ZDICT__COUNT][sg_FS3_ZDICT_ID_BUFFER_LENGTH];
 
     my_tx_data* ptx;
 };
@@ -139,6 +158,24 @@ typedef struct _my_instance_data my_instance_data;
 
 #define MY_CHUNK_SIZE			(16*1024)
 
+/* In a repo with an inline_blobs table, a blob that needs no more space
+ * than this is stored in that table rather than in a blob file.  Its row
+ * in blobs has a NULL filename, which reads back as filenumber 0.  (Blob
+ * files are numbered from 1.) */
+#define sg_FS3_MAX_INLINE_LENGTH	(2*1024)
+#define sg_FS3_INLINE_FILENUMBER	0
+
+/* The "format" prop says which layout the repo uses.  A repo without one
+ * is format 1.  Format 2 adds the inline_blobs table, and with it the
+ * zlib dictionaries and SG_BLOBENCODING__ZLIBDICT.  Builds from before format 2 don't know to look at
+ * the prop and would read an inline blob from blob file 0, so a new repo
+ * only gets format 2 when the new_repo/inline_blobs setting is "true".
+ * We refuse to open a format newer than we know. */
+#define sg_FS3_FORMAT_PROP			"format"
+#define sg_FS3_FORMAT__ORIGINAL		1
+#define sg_FS3_FORMAT__INLINE_BLOBS	2
+#define sg_FS3_FORMAT__CURRENT		sg_FS3_FORMAT__INLINE_BLOBS
+
 struct _sg_blob_fs3_handle_fetch
 {
 	my_instance_data *			pData;
@@ -152,6 +189,7 @@ struct _sg_blob_fs3_handle_fetch
     SG_blob_encoding            blob_encoding_returning;
     char*                       psz_hid_vcdiff_reference_stored_freeme;
 	SG_file *					m_pFileBlob;
+	SG_byte *					p_inline;				// the encoded blob, if it is stored inline
 	SG_repo_hash_handle *		pRHH_VerifyOnFetch;
     SG_uint32                   filenumber;
     SG_uint64                   offset;
@@ -192,6 +230,12 @@ struct _sg_blob_fs3_handle_store
     const char* psz_hid_blob_final;
 	SG_repo_hash_handle * pRHH_ComputeOnStore;
 
+    /* inline stuff */
+    SG_bool b_inline;
+    SG_byte* p_inline;
+    SG_uint32 len_inline;
+    SG_uint32 space_inline;
+
     /* zlib stuff */
     SG_bool b_compressing;
 	z_stream zStream;
@@ -453,7 +497,7 @@ static void do_fetch_info(
                         )  );
             if (b_found)
             {
-                *p_filenumber = (SG_uint32) atoi(psz_filename); // TODO atoi?
+                *p_filenumber = psz_filename ? (SG_uint32) atoi(psz_filename) : sg_FS3_INLINE_FILENUMBER; // TODO atoi?
                 SG_NULLFREE(pCtx, psz_filename);
             }
         }
@@ -482,6 +526,478 @@ fail:
     SG_NULLFREE(pCtx, psz_filename);
 }
 
+static void my_fetch_inline(
+        SG_context * pCtx,
+        sqlite3* psql,
+        const char * szHidBlob,
+        SG_uint64 len_encoded,
+        SG_bool* pb_found,
+        SG_byte** pp
+        )
+{
+	sqlite3_stmt * pStmt = NULL;
+    SG_byte* p = NULL;
+    int rc;
+
+	SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, psql, &pStmt,
+									  "SELECT \"data\" FROM \"inline_blobs\" WHERE \"hid\" = ?")  );
+	SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pStmt,1,szHidBlob)  );
+
+    rc = sqlite3_step(pStmt);
+    if (SQLITE_ROW == rc)
+    {
+        SG_uint32 len = (SG_uint32) sqlite3_column_bytes(pStmt, 0);
+
+        if (len != len_encoded)
+        {
+            SG_ERR_THROW2(  SG_ERR_BLOB_NOT_VERIFIED_INCOMPLETE, (pCtx, "%s", szHidBlob)  );
+        }
+
+        SG_ERR_CHECK(  SG_allocN(pCtx, len + 1, p)  );
+        if (len)
+        {
+            memcpy(p, sqlite3_column_blob(pStmt, 0), len);
+        }
+
+        *pp = p;
+        p = NULL;
+        *pb_found = SG_TRUE;
+    }
+    else if (SQLITE_DONE == rc)
+    {
+        *pb_found = SG_FALSE;
+    }
+    else
+    {
+        SG_ERR_THROW(  SG_ERR_SQLITE(rc)  );
+    }
+
+fail:
+    SG_NULLFREE(pCtx, p);
+	SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmt)  );
+}
+
+/* Get the encoded bytes of a blob stored inline.  Like do_fetch_info,
+ * this looks in the current tx before the repo db. */
+static void sg_fs3__fetch_inline(
+        SG_context * pCtx,
+        my_instance_data* pData,
+        const char * szHidBlob,
+        SG_uint64 len_encoded,
+        SG_byte** pp
+        )
+{
+    SG_bool b_found = SG_FALSE;
+
+    if (pData->ptx && pData->ptx->psql_new_audits)
+    {
+        SG_ERR_CHECK(  my_fetch_inline(pCtx, pData->ptx->psql_new_audits, szHidBlob, len_encoded, &b_found, pp)  );
+    }
+
+    if (!b_found)
+    {
+        if (!pData->b_in_sqlite_transaction)
+        {
+            SG_RETRY_THINGIE(
+            SG_ERR_CHECK(  my_fetch_inline(pCtx, pData->psql, szHidBlob, len_encoded, &b_found, pp)  );
+                );
+        }
+        else
+        {
+            SG_ERR_CHECK(  my_fetch_inline(pCtx, pData->psql, szHidBlob, len_encoded, &b_found, pp)  );
+        }
+    }
+
+    if (!b_found)
+    {
+        SG_ERR_THROW2(SG_ERR_BLOB_NOT_FOUND, (pCtx, "%s", szHidBlob));
+    }
+
+fail:
+    ;
+}
+
+//////////////////////////////////////////////////////////////////
+
+/* Changesets, treenodes, dbrecords and templates are small JSON blobs
+ * which repeat the same keys over and over.  Compressed one at a time,
+ * zlib has almost nothing to work with.  So for each kind, the repo can
+ * have a dictionary trained from its own blobs (see
+ * sg_repo__fs3__train_blob_dictionaries), which deflate gets as a preset
+ * dictionary.  Those blobs are stored as SG_BLOBENCODING__ZLIBDICT.
+ *
+ * The dictionaries live in the props table.  "zdict/<kind>" has the id
+ * of the current dictionary for that kind, and "zdict/<id>" has the
+ * dictionary itself, in base64.  The id is the adler32 of the
+ * dictionary, which is also what zlib puts in the stream header, so a
+ * blob always says which dictionary it needs.  Old dictionaries are
+ * never removed.
+ *
+ * Only inline blobs use a dictionary, so only a format 2 repo (see
+ * sg_FS3_FORMAT__INLINE_BLOBS) ever has one.  A ZLIBDICT blob is decoded
+ * when it is opened for reading, so it leaves this file as FULL. */
+
+#define sg_FS3_ZDICT_PROP_PREFIX	"zdict/"
+
+/* The dictionary gets hashed again for every blob compressed with it, so
+ * it is kept well below the 32 KB zlib window. */
+#define sg_FS3_ZDICT_MAX_LENGTH		(8*1024)
+
+#define sg_FS3_ZDICT_MAX_SAMPLES	1000
+#define sg_FS3_ZDICT_MAX_SCAN		10000
+#define sg_FS3_ZDICT_MAX_SEGMENT	64
+
+static const char* sg_fs3__zdict__names[sg_FS3_ZDICT__COUNT] =
+{
+    "changeset",
+    "treenode",
+    "dbrecord",
+    "template",
+};
+
+typedef struct
+{
+    SG_uint32 len;
+    SG_byte* p;
+} sg_fs3_zdict;
+
+static void sg_fs3__zdict__free(SG_context* pCtx, void* pVoid)
+{
+    sg_fs3_zdict* pzd = (sg_fs3_zdict*) pVoid;
+
+    if (pzd)
+    {
+        SG_NULLFREE(pCtx, pzd->p);
+        SG_NULLFREE(pCtx, pzd);
+    }
+}
+
+static SG_bool sg_fs3__zdict__contains(
+    const SG_byte* p,
+    SG_uint32 len,
+    const char* psz
+    )
+{
+    SG_uint32 len_sz = (SG_uint32) strlen(psz);
+    SG_uint32 i;
+
+    for (i=0; i + len_sz <= len; i++)
+    {
+        if (
+                (p[i] == (SG_byte) psz[0])
+                && (0 == memcmp(p + i, psz, len_sz))
+           )
+        {
+            return SG_TRUE;
+        }
+    }
+
+    return SG_FALSE;
+}
+
+/* Guess the kind of a blob from its first bytes.  A wrong guess only
+ * costs compression. */
+static SG_bool sg_fs3__zdict__classify(
+    const SG_byte* p,
+    SG_uint32 len,
+    SG_uint32* p_kind
+    )
+{
+    if (
+            (len < 2)
+            || ('{' != p[0])
+       )
+    {
+        return SG_FALSE;
+    }
+
+    if (
+            sg_fs3__zdict__contains(p, len, "\"generation\"")
+            && sg_fs3__zdict__contains(p, len, "\"parents\"")
+       )
+    {
+        *p_kind = sg_FS3_ZDICT__CHANGESET;
+    }
+    else if (sg_fs3__zdict__contains(p, len, "\"rectypes\""))
+    {
+        *p_kind = sg_FS3_ZDICT__TEMPLATE;
+    }
+    else if (sg_fs3__zdict__contains(p, len, "\"rectype\""))
+    {
+        *p_kind = sg_FS3_ZDICT__DBRECORD;
+    }
+    else if (sg_fs3__zdict__contains(p, len, "\"tne\""))
+    {
+        *p_kind = sg_FS3_ZDICT__TREENODE;
+    }
+    else
+    {
+        return SG_FALSE;
+    }
+
+    return SG_TRUE;
+}
+
+static void my_load_zdicts(
+    SG_context * pCtx,
+    my_instance_data* pData,
+    SG_rbtree* prb
+    )
+{
+	sqlite3_stmt * pStmt = NULL;
+    sg_fs3_zdict* pzd = NULL;
+    SG_uint32 k;
+    int rc;
+
+    for (k=0; k<sg_FS3_ZDICT__COUNT; k++)
+    {
+        pData->aa_zdict_current[k][0] = 0;
+    }
+
+	SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pData->psql, &pStmt,
+									  "SELECT \"name\", \"value\" FROM \"props\" WHERE \"name\" LIKE '" sg_FS3_ZDICT_PROP_PREFIX "%%'")  );
+
+    while ((rc=sqlite3_step(pStmt)) == SQLITE_ROW)
+    {
+        const char* psz_name = (const char*) sqlite3_column_text(pStmt, 0) + sizeof(sg_FS3_ZDICT_PROP_PREFIX) - 1;
+        const char* psz_value = (const char*) sqlite3_column_text(pStmt, 1);
+        SG_bool b_kind = SG_FALSE;
+
+        for (k=0; k<sg_FS3_ZDICT__COUNT; k++)
+        {
+            if (0 == strcmp(psz_name, sg_fs3__zdict__names[k]))
+            {
+                SG_ERR_CHECK(  SG_strcpy(pCtx, pData->aa_zdict_current[k], sizeof(pData->aa_zdict_current[k]), psz_value)  );
+                b_kind = SG_TRUE;
+                break;
+            }
+        }
+
+        if (!b_kind)
+        {
+            SG_uint32 space = 0;
+
+            SG_ERR_CHECK(  SG_alloc1(pCtx, pzd)  );
+            SG_ERR_CHECK(  SG_base64__space_needed_for_decode(pCtx, psz_value, &space)  );
+            SG_ERR_CHECK(  SG_allocN(pCtx, space + 1, pzd->p)  );
+            SG_ERR_CHECK(  SG_base64__decode(pCtx, psz_value, pzd->p, space + 1, &pzd->len)  );
+            SG_ERR_CHECK(  SG_rbtree__add__with_assoc(pCtx, prb, psz_name, pzd)  );
+            pzd = NULL;
+        }
+    }
+    if (rc != SQLITE_DONE)
+    {
+        SG_ERR_THROW(  SG_ERR_SQLITE(rc)  );
+    }
+
+fail:
+    SG_ERR_IGNORE(  sg_fs3__zdict__free(pCtx, pzd)  );
+	SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmt)  );
+}
+
+/* (Re)load all of the dictionaries from the props table. */
+static void sg_fs3__zdict__load(
+    SG_context * pCtx,
+    my_instance_data* pData
+    )
+{
+    SG_rbtree* prb = NULL;
+
+    SG_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &prb)  );
+
+    if (!pData->b_in_sqlite_transaction)
+    {
+        SG_RETRY_THINGIE(
+        SG_ERR_CHECK(  my_load_zdicts(pCtx, pData, prb)  );
+            );
+    }
+    else
+    {
+        SG_ERR_CHECK(  my_load_zdicts(pCtx, pData, prb)  );
+    }
+
+    SG_RBTREE_NULLFREE_WITH_ASSOC(pCtx, pData->prb_zdicts, sg_fs3__zdict__free);
+    pData->prb_zdicts = prb;
+    prb = NULL;
+    pData->b_zdicts_loaded = SG_TRUE;
+
+fail:
+    SG_RBTREE_NULLFREE_WITH_ASSOC(pCtx, prb, sg_fs3__zdict__free);
+}
+
+static void sg_fs3__zdict__find(
+    SG_context * pCtx,
+    my_instance_data* pData,
+    const char* psz_id,
+    sg_fs3_zdict** ppzd
+    )
+{
+    SG_bool b_found = SG_FALSE;
+
+    *ppzd = NULL;
+
+    if (!pData->b_zdicts_loaded)
+    {
+        SG_ERR_CHECK_RETURN(  sg_fs3__zdict__load(pCtx, pData)  );
+    }
+
+    SG_ERR_CHECK_RETURN(  SG_rbtree__find(pCtx, pData->prb_zdicts, psz_id, &b_found, (void**) ppzd)  );
+    if (!b_found)
+    {
+        // maybe another process trained a new one
+        SG_ERR_CHECK_RETURN(  sg_fs3__zdict__load(pCtx, pData)  );
+        SG_ERR_CHECK_RETURN(  SG_rbtree__find(pCtx, pData->prb_zdicts, psz_id, &b_found, (void**) ppzd)  );
+    }
+}
+
+static void sg_fs3__zdict__format_id(
+    SG_context * pCtx,
+    uLong adler,
+    char* buf,
+    SG_uint32 len_buf
+    )
+{
+    SG_ERR_CHECK_RETURN(  SG_sprintf(pCtx, buf, len_buf, "%08x", (SG_uint32) adler)  );
+}
+
+/* Give a deflate stream which has not been used yet the current
+ * dictionary for this blob's kind, if there is one. */
+static void sg_fs3__zdict__set_for_deflate(
+    SG_context * pCtx,
+    my_instance_data* pData,
+    z_stream* pzStream,
+    const SG_byte* p,
+    SG_uint32 len,
+    SG_bool* pb_set
+    )
+{
+    SG_uint32 kind = 0;
+    sg_fs3_zdict* pzd = NULL;
+    int zError;
+
+    *pb_set = SG_FALSE;
+
+    if (!pData->b_inline_blobs)
+    {
+        return;
+    }
+
+    if (!sg_fs3__zdict__classify(p, len, &kind))
+    {
+        return;
+    }
+
+    if (!pData->b_zdicts_loaded)
+    {
+        SG_ERR_CHECK_RETURN(  sg_fs3__zdict__load(pCtx, pData)  );
+    }
+
+    if (!pData->aa_zdict_current[kind][0])
+    {
+        return;
+    }
+
+    SG_ERR_CHECK_RETURN(  sg_fs3__zdict__find(pCtx, pData, pData->aa_zdict_current[kind], &pzd)  );
+    if (!pzd)
+    {
+        return;
+    }
+
+    zError = deflateSetDictionary(pzStream, pzd->p, pzd->len);
+    if (zError != Z_OK)
+    {
+        SG_ERR_THROW_RETURN(  SG_ERR_ZLIB(zError)  );
+    }
+
+    *pb_set = SG_TRUE;
+}
+
+/* Decode a ZLIBDICT blob, all at once. */
+static void sg_fs3__zdict__inflate(
+    SG_context * pCtx,
+    my_instance_data* pData,
+    const char* psz_hid,
+    const SG_byte* p_encoded,
+    SG_uint64 len_encoded,
+    SG_uint64 len_full,
+    SG_byte** pp_full
+    )
+{
+	z_stream zStream;
+    SG_bool b_init = SG_FALSE;
+    SG_byte* p_full = NULL;
+    int zError;
+
+	memset(&zStream,0,sizeof(zStream));
+
+    if (!pData->b_inline_blobs)
+    {
+        SG_ERR_THROW2(  SG_ERR_REPO_FEATURE_NOT_SUPPORTED,
+                        (pCtx, "blob %s is ZLIBDICT, which this repo's format does not have", psz_hid)  );
+    }
+
+    if (len_full > sg_FS3_MAX_INLINE_LENGTH)
+    {
+        SG_ERR_THROW2(  SG_ERR_BLOB_NOT_VERIFIED_INCOMPLETE, (pCtx, "%s", psz_hid)  );
+    }
+
+    zError = inflateInit(&zStream);
+    if (zError != Z_OK)
+    {
+        SG_ERR_THROW(  SG_ERR_ZLIB(zError)  );
+    }
+    b_init = SG_TRUE;
+
+    SG_ERR_CHECK(  SG_allocN(pCtx, (SG_uint32) len_full + 1, p_full)  );
+
+    zStream.next_in = (SG_byte*) p_encoded;
+    zStream.avail_in = (SG_uint32) len_encoded;
+    zStream.next_out = p_full;
+    zStream.avail_out = (SG_uint32) len_full + 1;
+
+    zError = inflate(&zStream,Z_FINISH);
+    if (Z_NEED_DICT == zError)
+    {
+        char buf_id[sg_FS3_ZDICT_ID_BUFFER_LENGTH];
+        sg_fs3_zdict* pzd = NULL;
+
+        SG_ERR_CHECK(  sg_fs3__zdict__format_id(pCtx, zStream.adler, buf_id, sizeof(buf_id))  );
+        SG_ERR_CHECK(  sg_fs3__zdict__find(pCtx, pData, buf_id, &pzd)  );
+        if (!pzd)
+        {
+            SG_ERR_THROW2(  SG_ERR_ZLIB(Z_NEED_DICT),
+                            (pCtx, "blob %s needs compression dictionary %s", psz_hid, buf_id)  );
+        }
+
+        zError = inflateSetDictionary(&zStream, pzd->p, pzd->len);
+        if (zError != Z_OK)
+        {
+            SG_ERR_THROW(  SG_ERR_ZLIB(zError)  );
+        }
+
+        zError = inflate(&zStream,Z_FINISH);
+    }
+    if (zError != Z_STREAM_END)
+    {
+        SG_ERR_THROW(  SG_ERR_ZLIB(zError)  );
+    }
+
+    if (zStream.total_out != len_full)
+    {
+        SG_ERR_THROW2(  SG_ERR_BLOB_NOT_VERIFIED_INCOMPLETE, (pCtx, "%s", psz_hid)  );
+    }
+
+    *pp_full = p_full;
+    p_full = NULL;
+
+fail:
+    if (b_init)
+    {
+        inflateEnd(&zStream);
+    }
+    SG_NULLFREE(pCtx, p_full);
+}
+
 void sg_blob_fs3_handle_store__free(SG_context* pCtx, sg_blob_fs3_handle_store* pbh)
 {
     if (!pbh)
@@ -502,6 +1018,7 @@ void sg_blob_fs3_handle_store__free(SG_context* pCtx, sg_blob_fs3_handle_store*
 #if 0 // write handles are now closed elsewhere
     SG_FILE_NULLCLOSE(pCtx, pbh->pFileBlob);
 #endif
+    SG_NULLFREE(pCtx, pbh->p_inline);
     SG_NULLFREE(pCtx, pbh->psz_hid_blob_final);
     SG_NULLFREE(pCtx, pbh);
 }
@@ -807,10 +1324,12 @@ fail:
     return;
 }
 
-static void sg_fs3__open_file_for_writing(
+static void sg_fs3__open_filenumber_for_writing(
     SG_context * pCtx,
     my_instance_data* pData,
-    sg_blob_fs3_handle_store* pbh
+    SG_uint32 filenumber,
+    SG_file** ppFile,
+    SG_uint64* poffset
     )
 {
     SG_bool b_already = SG_FALSE;
@@ -818,26 +1337,156 @@ static void sg_fs3__open_file_for_writing(
     char buf[sg_FILENUMBER_BUFFER_LENGTH];
     SG_pathname* pPathnameFile = NULL;
 
-    SG_ERR_CHECK(  sg_fs3__filenumber_to_filename(pCtx, buf, sizeof(buf), pbh->filenumber)  );
+    SG_ERR_CHECK(  sg_fs3__filenumber_to_filename(pCtx, buf, sizeof(buf), filenumber)  );
 
     SG_ERR_CHECK(  SG_rbtree__find(pCtx, pData->ptx->prb_file_handles, buf, &b_already, (void**) &pFile)  );
-    if (pFile)
+    if (!pFile)
     {
-        pbh->pFileBlob = pFile;
+        SG_ERR_CHECK(  sg_fs3__get_filenumber_path__sz(pCtx, pData, buf, &pPathnameFile)  );
+        SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPathnameFile ,SG_FILE_WRONLY|SG_FILE_OPEN_EXISTING,0644,&pFile)  );
+        SG_ERR_CHECK(  SG_rbtree__add__with_assoc(pCtx, pData->ptx->prb_file_handles, buf, pFile)  );
+    }
+
+    SG_ERR_CHECK(  SG_file__seek_end(pCtx, pFile, poffset)  );
+
+    *ppFile = pFile;
+
+fail:
+    ;
+}
+
+static void sg_fs3__open_file_for_writing(
+    SG_context * pCtx,
+    my_instance_data* pData,
+    sg_blob_fs3_handle_store* pbh
+    )
+{
+    SG_ERR_CHECK_RETURN(  sg_fs3__open_filenumber_for_writing(pCtx, pData, pbh->filenumber, &pbh->pFileBlob, &pbh->offset)  );
+}
+
+/**
+ * Record where a blob we just wrote lives.  Normally the row goes into
+ * the tx's blobset, which is copied into the blobs table when the tx
+ * commits.  A clone inserts straight into the table.
+ */
+static void sg_fs3__add_blob_row(
+    SG_context * pCtx,
+    my_instance_data* pData,
+    const char* psz_hid,
+    const char* psz_filenumber,
+    SG_uint64 offset,
+    SG_blob_encoding encoding,
+    SG_uint64 len_encoded,
+    SG_uint64 len_full,
+    const char* psz_hid_vcdiff_reference
+    )
+{
+    if (pData->ptx->flags & SG_REPO_TX_FLAG__CLONING)
+    {
+        sqlite3_stmt* pStmt = pData->ptx->cloning.pStmt_insert;
+
+        SG_ERR_CHECK(  sg_sqlite__reset(pCtx, pStmt)  );
+        SG_ERR_CHECK(  sg_sqlite__clear_bindings(pCtx, pStmt)  );
+
+        SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pStmt,1,psz_hid)  );
+        SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pStmt,2,psz_filenumber)  );
+        SG_ERR_CHECK(  sg_sqlite__bind_int64(pCtx, pStmt,3,offset)  );
+        SG_ERR_CHECK(  sg_sqlite__bind_int(pCtx, pStmt,4,encoding)  );
+        SG_ERR_CHECK(  sg_sqlite__bind_int64(pCtx, pStmt,5,len_encoded)  );
+        SG_ERR_CHECK(  sg_sqlite__bind_int64(pCtx, pStmt,6,len_full)  );
+        if (psz_hid_vcdiff_reference)
+        {
+            SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pStmt,7,psz_hid_vcdiff_reference)  );
+        }
+        else
+        {
+            SG_ERR_CHECK(  sg_sqlite__bind_null(pCtx, pStmt,7)  );
+        }
+        SG_ERR_CHECK(  sg_sqlite__step(pCtx,pStmt,SQLITE_DONE)  );
     }
     else
     {
-        SG_ERR_CHECK(  sg_fs3__get_filenumber_path__sz(pCtx, pData, buf, &pPathnameFile)  );
-        SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPathnameFile ,SG_FILE_WRONLY|SG_FILE_OPEN_EXISTING,0644,&pbh->pFileBlob)  );
-        SG_ERR_CHECK(  SG_rbtree__add__with_assoc(pCtx, pData->ptx->prb_file_handles, buf, pbh->pFileBlob)  );
+        SG_ERR_CHECK(  SG_blobset__insert(
+                    pCtx,
+                    pData->ptx->pbs_new_blobs,
+                    psz_hid,
+                    psz_filenumber,
+                    offset,
+                    encoding,
+                    len_encoded,
+                    len_full,
+                    psz_hid_vcdiff_reference
+                    )  );
     }
 
-    SG_ERR_CHECK(  SG_file__seek_end(pCtx, pbh->pFileBlob, &pbh->offset)  );
+fail:
+    ;
+}
+
+/**
+ * Put the encoded bytes of an inline blob into the inline_blobs table.
+ * Like the audits, these go into the tx's temp db and are copied into
+ * the repo db when the tx commits.  A clone inserts straight into the
+ * repo db.  The blob's row in blobs is added by sg_fs3__add_blob_row,
+ * with a NULL filename.
+ */
+static void sg_fs3__add_inline_row(
+    SG_context * pCtx,
+    my_instance_data* pData,
+    const char* psz_hid,
+    const SG_byte* p,
+    SG_uint32 len
+    )
+{
+    sqlite3_stmt* pStmt = pData->ptx->pStmt_inline;
+
+    SG_ERR_CHECK(  sg_sqlite__reset(pCtx, pStmt)  );
+    SG_ERR_CHECK(  sg_sqlite__clear_bindings(pCtx, pStmt)  );
+    SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pStmt, 1, psz_hid)  );
+    SG_ERR_CHECK(  sg_sqlite__bind_blob(pCtx, pStmt, 2, p, len)  );
+    SG_ERR_CHECK(  sg_sqlite__step(pCtx, pStmt, SQLITE_DONE)  );
 
 fail:
     ;
 }
 
+static void sg_blob_fs3__write(
+    SG_context * pCtx,
+    sg_blob_fs3_handle_store* pbh,
+    SG_uint32 len,
+    const SG_byte* p
+    )
+{
+    if (pbh->b_inline)
+    {
+        if (pbh->len_inline + len > pbh->space_inline)
+        {
+            SG_uint32 space = pbh->space_inline ? pbh->space_inline : sg_FS3_MAX_INLINE_LENGTH;
+            SG_byte* p_new = NULL;
+
+            while (space < pbh->len_inline + len)
+            {
+                space *= 2;
+            }
+            SG_ERR_CHECK_RETURN(  SG_allocN(pCtx, space, p_new)  );
+            if (pbh->len_inline)
+            {
+                memcpy(p_new, pbh->p_inline, pbh->len_inline);
+            }
+            SG_NULLFREE(pCtx, pbh->p_inline);
+            pbh->p_inline = p_new;
+            pbh->space_inline = space;
+        }
+
+        memcpy(pbh->p_inline + pbh->len_inline, p, len);
+        pbh->len_inline += len;
+    }
+    else
+    {
+        SG_ERR_CHECK_RETURN(  SG_file__write(pCtx, pbh->pFileBlob, len, p, NULL)  );
+    }
+}
+
 static void my_sg_blob_fs3__store_blob__begin(
     SG_context * pCtx,
     my_instance_data* pData,
@@ -927,9 +1576,22 @@ static void my_sg_blob_fs3__store_blob__begin(
         }
     }
 
-    SG_ERR_CHECK(  sg_fs3__find_a_place(pCtx, pData, space_needed, &pbh->filenumber)  );
+    if (
+            pData->b_inline_blobs
+            && (space_needed <= sg_FS3_MAX_INLINE_LENGTH)
+       )
+    {
+        // The zlib output can be a little bigger than the input, so the
+        // buffer grows if it needs to.
+        pbh->b_inline = SG_TRUE;
+        pbh->filenumber = sg_FS3_INLINE_FILENUMBER;
+    }
+    else
+    {
+        SG_ERR_CHECK(  sg_fs3__find_a_place(pCtx, pData, space_needed, &pbh->filenumber)  );
 
-    SG_ERR_CHECK(  sg_fs3__open_file_for_writing(pCtx, pData, pbh)  );
+        SG_ERR_CHECK(  sg_fs3__open_file_for_writing(pCtx, pData, pbh)  );
+    }
 
     *ppHandle = pbh;
     pbh = NULL;
@@ -1007,6 +1669,22 @@ void sg_blob_fs3__store_blob__chunk(
 		SG_ERR_CHECK(  sg_repo__fs3__hash__chunk(pCtx, pbh->pData->pRepo, pbh->pRHH_ComputeOnStore, len_chunk, p_chunk)  );
     }
 
+    if (
+            pbh->b_compressing
+            && pbh->b_inline
+            && (0 == pbh->len_full_observed)
+       )
+    {
+        SG_bool b_dict = SG_FALSE;
+
+        // the first chunk decides whether there is a dictionary for it
+        SG_ERR_CHECK(  sg_fs3__zdict__set_for_deflate(pCtx, pbh->pData, &pbh->zStream, p_chunk, len_chunk, &b_dict)  );
+        if (b_dict)
+        {
+            pbh->blob_encoding_storing = SG_BLOBENCODING__ZLIBDICT;
+        }
+    }
+
     if (pbh->b_compressing)
     {
         // give this chunk to compressor (it will update next_in and avail_in as
@@ -1044,7 +1722,7 @@ void sg_blob_fs3__store_blob__chunk(
                 SG_uint32 nOut = MY_CHUNK_SIZE - pbh->zStream.avail_out;
                 SG_ASSERT ( (nOut == (SG_uint32)(pbh->zStream.next_out - pbh->bufOut)) );
 
-                SG_ERR_CHECK(  SG_file__write(pCtx, pbh->pFileBlob,nOut,pbh->bufOut,NULL)  );
+                SG_ERR_CHECK(  sg_blob_fs3__write(pCtx, pbh, nOut, pbh->bufOut)  );
                 pbh->len_encoded_observed += nOut;
             }
 
@@ -1057,7 +1735,7 @@ void sg_blob_fs3__store_blob__chunk(
     }
     else
     {
-        SG_ERR_CHECK(  SG_file__write(pCtx, pbh->pFileBlob,len_chunk,p_chunk,NULL)  );
+        SG_ERR_CHECK(  sg_blob_fs3__write(pCtx, pbh, len_chunk, p_chunk)  );
         if (SG_IS_BLOBENCODING_FULL(pbh->blob_encoding_given))
         {
             pbh->len_full_observed += len_chunk;
@@ -1110,7 +1788,7 @@ void sg_blob_fs3__store_blob__end(
                 SG_uint32 nOut = MY_CHUNK_SIZE - pbh->zStream.avail_out;
                 SG_ASSERT ( (nOut == (SG_uint32)(pbh->zStream.next_out - pbh->bufOut)) );
 
-                SG_ERR_CHECK(  SG_file__write(pCtx, pbh->pFileBlob,nOut,pbh->bufOut,NULL)  );
+                SG_ERR_CHECK(  sg_blob_fs3__write(pCtx, pbh, nOut, pbh->bufOut)  );
 
                 pbh->len_encoded_observed += nOut;
             }
@@ -1161,44 +1839,27 @@ void sg_blob_fs3__store_blob__end(
         SG_ASSERT(pbh->psz_hid_vcdiff_reference);
     }
 
-    SG_ERR_CHECK(  sg_fs3__filenumber_to_filename(pCtx, buf_filenumber, sizeof(buf_filenumber), pbh->filenumber)  );
-
-    if (pbh->pData->ptx->flags & SG_REPO_TX_FLAG__CLONING)
+    if (pbh->b_inline)
     {
-        SG_ERR_CHECK(  sg_sqlite__reset(pCtx, pbh->pData->ptx->cloning.pStmt_insert)  );
-        SG_ERR_CHECK(  sg_sqlite__clear_bindings(pCtx, pbh->pData->ptx->cloning.pStmt_insert)  );
-
-        SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pbh->pData->ptx->cloning.pStmt_insert,1,pbh->psz_hid_blob_final)  );
-        SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pbh->pData->ptx->cloning.pStmt_insert,2,buf_filenumber)  );
-        SG_ERR_CHECK(  sg_sqlite__bind_int64(pCtx, pbh->pData->ptx->cloning.pStmt_insert,3,pbh->offset)  );
-        SG_ERR_CHECK(  sg_sqlite__bind_int(pCtx, pbh->pData->ptx->cloning.pStmt_insert,4,pbh->blob_encoding_storing)  );
-        SG_ERR_CHECK(  sg_sqlite__bind_int64(pCtx, pbh->pData->ptx->cloning.pStmt_insert,5,pbh->len_encoded_observed)  );
-        SG_ERR_CHECK(  sg_sqlite__bind_int64(pCtx, pbh->pData->ptx->cloning.pStmt_insert,6,pbh->len_full_given)  );
-        if (pbh->psz_hid_vcdiff_reference)
-        {
-            SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pbh->pData->ptx->cloning.pStmt_insert,7,pbh->psz_hid_vcdiff_reference)  );
-        }
-        else
-        {
-            SG_ERR_CHECK(  sg_sqlite__bind_null(pCtx, pbh->pData->ptx->cloning.pStmt_insert,7)  );
-        }
-        sg_sqlite__step(pCtx,pbh->pData->ptx->cloning.pStmt_insert,SQLITE_DONE);
+        SG_ERR_CHECK(  sg_fs3__add_inline_row(pCtx, pbh->pData, pbh->psz_hid_blob_final, pbh->p_inline, pbh->len_inline)  );
     }
     else
     {
-        SG_ERR_CHECK(  SG_blobset__insert(
-                    pCtx,
-                    pbh->pData->ptx->pbs_new_blobs,
-                    pbh->psz_hid_blob_final,
-                    buf_filenumber,
-                    pbh->offset,
-                    pbh->blob_encoding_storing,
-                    pbh->len_encoded_observed,
-                    pbh->len_full_given,
-                    pbh->psz_hid_vcdiff_reference
-                    )  );
+        SG_ERR_CHECK(  sg_fs3__filenumber_to_filename(pCtx, buf_filenumber, sizeof(buf_filenumber), pbh->filenumber)  );
     }
 
+    SG_ERR_CHECK(  sg_fs3__add_blob_row(
+                pCtx,
+                pbh->pData,
+                pbh->psz_hid_blob_final,
+                pbh->b_inline ? NULL : buf_filenumber,
+                pbh->offset,
+                pbh->blob_encoding_storing,
+                pbh->len_encoded_observed,
+                pbh->len_full_given,
+                pbh->psz_hid_vcdiff_reference
+                )  );
+
 	if (ppsz_hid_returned)
     {
         SG_ERR_CHECK(  SG_STRDUP(pCtx, pbh->psz_hid_blob_final, ppsz_hid_returned)  );
@@ -1414,10 +2075,31 @@ static void sg_fs3__open_blob_for_reading__already_got_info(
         SG_ERR_CHECK(  sg_fs3__fetch_blob_into_tempfile(pCtx, pData, pbh->psz_hid_vcdiff_reference_stored_freeme, &pbh->pPath_tempfile_vcdiff_reference)  );
     }
 
-	pbh->b_we_own_file = b_open_file;
-	if (b_open_file)
+	if (sg_FS3_INLINE_FILENUMBER == filenumber)
+	{
+		// there is no file, so we always load these
+		SG_ERR_CHECK(  sg_fs3__fetch_inline(pCtx, pData, szHidBlob, len_encoded_stored, &pbh->p_inline)  );
+
+		if (SG_BLOBENCODING__ZLIBDICT == pbh->blob_encoding_stored)
+		{
+			// nobody else has the dictionary, so from here on, this
+			// is a FULL blob
+			SG_byte* p_full = NULL;
+
+			SG_ERR_CHECK(  sg_fs3__zdict__inflate(pCtx, pData, szHidBlob, pbh->p_inline, len_encoded_stored, len_full_stored, &p_full)  );
+			SG_NULLFREE(pCtx, pbh->p_inline);
+			pbh->p_inline = p_full;
+			pbh->blob_encoding_stored = SG_BLOBENCODING__FULL;
+			pbh->len_encoded_stored = len_full_stored;
+		}
+	}
+	else
 	{
-		SG_ERR_CHECK(  _open_blobfile_for_reading(pCtx, pData, pbh)  );
+		pbh->b_we_own_file = b_open_file;
+		if (b_open_file)
+		{
+			SG_ERR_CHECK(  _open_blobfile_for_reading(pCtx, pData, pbh)  );
+		}
 	}
 
     if (
@@ -1514,6 +2196,7 @@ static void _sg_blob_handle__close(SG_context * pCtx, sg_blob_fs3_handle_fetch *
 	if (pbh->b_we_own_file)
 		SG_FILE_NULLCLOSE(pCtx, pbh->m_pFileBlob);
 
+    SG_NULLFREE(pCtx, pbh->p_inline);
     SG_NULLFREE(pCtx, pbh->psz_hid_vcdiff_reference_stored_freeme);
 
 	SG_NULLFREE(pCtx, pbh);
@@ -1670,6 +2353,33 @@ fail:
     return;
 }
 
+/* The caller never asks for more than the rest of the encoded blob.
+ * Like SG_file__read(), an inline blob throws SG_ERR_EOF once there is
+ * nothing left; the vcdiff readstream depends on that to stop. */
+static void sg_blob_fs3__read(
+    SG_context * pCtx,
+    sg_blob_fs3_handle_fetch* pbh,
+    SG_uint32 want,
+    SG_byte* p_buf,
+    SG_uint32* p_got
+    )
+{
+    if (pbh->p_inline)
+    {
+        if (0 == want)
+        {
+            *p_got = 0;
+            SG_ERR_THROW_RETURN(  SG_ERR_EOF  );
+        }
+        memcpy(p_buf, pbh->p_inline + pbh->len_encoded_observed, want);
+        *p_got = want;
+    }
+    else
+    {
+        SG_file__read(pCtx, pbh->m_pFileBlob, want, p_buf, p_got);
+    }
+}
+
 void sg_blob_fs3__fetch_blob__chunk(
     SG_context * pCtx,
     sg_blob_fs3_handle_fetch* pbh,
@@ -1685,6 +2395,7 @@ void sg_blob_fs3__fetch_blob__chunk(
     if (pbh->b_uncompressing)
     {
         int zError;
+        SG_int64 tPerf;
 
         if (0 == pbh->zStream.avail_in)
         {
@@ -1694,7 +2405,7 @@ void sg_blob_fs3__fetch_blob__chunk(
                 want = (SG_uint32)(pbh->len_encoded_stored - pbh->len_encoded_observed);
             }
 
-            SG_file__read(pCtx,pbh->m_pFileBlob,want,pbh->bufCompressed,&nbr);
+            sg_blob_fs3__read(pCtx,pbh,want,pbh->bufCompressed,&nbr);
 			if(SG_CONTEXT__HAS_ERR(pCtx) && !SG_context__err_equals(pCtx, SG_ERR_EOF))
 				SG_ERR_RETHROW_RETURN;
 
@@ -1707,6 +2418,7 @@ void sg_blob_fs3__fetch_blob__chunk(
         pbh->zStream.next_out = p_buf;
         pbh->zStream.avail_out = len_buf;
 
+        tPerf = SG_perf__start();
 		while (1)
 		{
 			// let decompressor decompress what it can of our input.  it may or
@@ -1754,6 +2466,7 @@ void sg_blob_fs3__fetch_blob__chunk(
         {
             nbr = 0;
         }
+        SG_perf__stop(SG_PERF_CATEGORY__BLOB_INFLATE, tPerf, nbr);
     }
     else if (pbh->b_undeltifying)
     {
@@ -1793,7 +2506,7 @@ void sg_blob_fs3__fetch_blob__chunk(
             want = (SG_uint32)(pbh->len_encoded_stored - pbh->len_encoded_observed);
         }
 
-        SG_file__read(pCtx, pbh->m_pFileBlob, want, p_buf, &nbr);
+        sg_blob_fs3__read(pCtx, pbh, want, p_buf, &nbr);
         if(SG_CONTEXT__HAS_ERR(pCtx) && !SG_context__err_equals(pCtx, SG_ERR_EOF))
         {
 			SG_ERR_RETHROW_RETURN;
@@ -2059,6 +2772,7 @@ void sg_repo__fs3__open_repo_instance(SG_context * pCtx, SG_repo * pRepo)
 	SG_bool bEqual_TrivialHash;
     void* instance_data = NULL;
     SG_vhash* pvh_descriptor = NULL;
+    SG_int32 format = 0;
 
 	SG_NULLARGCHECK_RETURN(pRepo);
 
@@ -2101,6 +2815,16 @@ void sg_repo__fs3__open_repo_instance(SG_context * pCtx, SG_repo * pRepo)
 
     SG_ERR_CHECK(  SG_sqlite__table_exists(pCtx, psql, "audits", &pData->b_new_audits)  );
 
+	SG_ERR_CHECK(  sg_sqlite__exec__va__int32(pCtx, psql, &format,
+				"SELECT COALESCE(MAX(CAST(\"value\" AS INTEGER)), %d) FROM \"props\" WHERE \"name\"='%s'",
+				sg_FS3_FORMAT__ORIGINAL, sg_FS3_FORMAT_PROP)  );
+	if (format > sg_FS3_FORMAT__CURRENT)
+	{
+		SG_ERR_THROW2(  SG_ERR_REPO_FEATURE_NOT_SUPPORTED,
+						(pCtx, "repo format %d is newer than this version of fs3 can read", format)  );
+	}
+	pData->b_inline_blobs = (format >= sg_FS3_FORMAT__INLINE_BLOBS);
+
     // TODO fetch b_indexes
 
 	// Get repo and admin ids
@@ -2295,6 +3019,8 @@ void sg_repo__fs3__create_repo_instance(
 	char buf_subdir_name[sg_MY_CLOSET_DIR_BUFFER_LENGTH];
     SG_pathname* pPath_maybe = NULL;
     SG_vhash* pvh_descriptor = NULL;
+    char* psz_inline_setting = NULL;
+    SG_int32 format = sg_FS3_FORMAT__ORIGINAL;
 
 	SG_UNUSED(b_indexes);
 
@@ -2321,6 +3047,12 @@ void sg_repo__fs3__create_repo_instance(
 
 	SG_ERR_CHECK(  sg_repo_utils__one_step_hash__from_sghash(pCtx, psz_hash_method, 0, NULL, &pszTrivialHash)  );
 
+	SG_ERR_CHECK(  SG_localsettings__get__sz(pCtx, SG_LOCALSETTING__NEWREPO_INLINE_BLOBS, NULL, &psz_inline_setting, NULL)  );
+	if (psz_inline_setting && (0 == strcmp(psz_inline_setting, "true")))
+	{
+		format = sg_FS3_FORMAT__INLINE_BLOBS;
+	}
+
 	// allocate and install pData
 	SG_ERR_CHECK(  SG_alloc1(pCtx, pData)  );
     pData->pRepo = pRepo;
@@ -2370,6 +3102,13 @@ void sg_repo__fs3__create_repo_instance(
 
     pData->b_new_audits = SG_TRUE;
 
+    if (format >= sg_FS3_FORMAT__INLINE_BLOBS)
+    {
+        SG_ERR_CHECK(  sg_sqlite__exec(pCtx, pData->psql, "CREATE TABLE inline_blobs (hid VARCHAR NOT NULL UNIQUE, data BLOB NOT NULL)")  );
+
+        pData->b_inline_blobs = SG_TRUE;
+    }
+
     // We could put a UNIQUE constraint on (filenumber, offset, len_encoded)
     // but it slows things down a lot.
     //
@@ -2392,6 +3131,7 @@ void sg_repo__fs3__create_repo_instance(
 	SG_ERR_CHECK(  sg_sqlite__exec__va(pCtx, pData->psql, "INSERT INTO \"props\" (\"name\", \"value\") VALUES ('%s', '%s')", "repoid", psz_repo_id)  );
 	SG_ERR_CHECK(  sg_sqlite__exec__va(pCtx, pData->psql, "INSERT INTO \"props\" (\"name\", \"value\") VALUES ('%s', '%s')", "adminid", psz_admin_id)  );
 	SG_ERR_CHECK(  sg_sqlite__exec__va(pCtx, pData->psql, "INSERT INTO \"props\" (\"name\", \"value\") VALUES ('%s', '%s')", "trivialhash", pszTrivialHash)  );
+	SG_ERR_CHECK(  sg_sqlite__exec__va(pCtx, pData->psql, "INSERT INTO \"props\" (\"name\", \"value\") VALUES ('%s', '%d')", sg_FS3_FORMAT_PROP, format)  );
 
 	SG_ERR_CHECK(  SG_strcpy(pCtx, pData->buf_hash_method, sizeof(pData->buf_hash_method), psz_hash_method)  );
 	SG_ERR_CHECK(  SG_strcpy(pCtx, pData->buf_repo_id, sizeof(pData->buf_repo_id), psz_repo_id)  );
@@ -2404,6 +3144,7 @@ void sg_repo__fs3__create_repo_instance(
 
 	SG_PATHNAME_NULLFREE(pCtx, pPathnameSqlDb);
 	SG_NULLFREE(pCtx, pszTrivialHash);
+	SG_NULLFREE(pCtx, psz_inline_setting);
 
     SG_ERR_CHECK(  SG_repo__set_instance_data(pCtx, pRepo, pData)  );
 
@@ -2418,6 +3159,7 @@ fail:
     }
 	SG_NULLFREE(pCtx, pData);
 	SG_NULLFREE(pCtx, pszTrivialHash);
+	SG_NULLFREE(pCtx, psz_inline_setting);
     SG_PATHNAME_NULLFREE(pCtx, pPath_maybe);
 }
 
@@ -2466,6 +3208,7 @@ static void sg_fs3__nullfree_tx_data(SG_context* pCtx, my_instance_data* pData)
     SG_VHASH_NULLFREE(pCtx, pData->ptx->cloning.pvh_templates);
     SG_ERR_CHECK_RETURN(  sg_sqlite__nullfinalize(pCtx, &pData->ptx->cloning.pStmt_insert)  );
     SG_ERR_CHECK_RETURN(  sg_sqlite__nullfinalize(pCtx, &pData->ptx->pStmt_audits)  );
+    SG_ERR_CHECK_RETURN(  sg_sqlite__nullfinalize(pCtx, &pData->ptx->pStmt_inline)  );
     if (pData->ptx->psql_new_audits)
     {
         SG_ERR_CHECK_RETURN(  sg_sqlite__close(pCtx, pData->ptx->psql_new_audits)  );
@@ -2523,6 +3266,7 @@ void sg_repo__fs3__close_repo_instance(SG_context * pCtx, SG_repo * pRepo)
 
     SG_RBTREE_NULLFREE_WITH_ASSOC(pCtx, pData->prb_paths, (SG_free_callback *)SG_pathname__free);
     SG_RBTREE_NULLFREE_WITH_ASSOC(pCtx, pData->prb_sql, (SG_free_callback *)sg_sqlite__close);
+    SG_RBTREE_NULLFREE_WITH_ASSOC(pCtx, pData->prb_zdicts, sg_fs3__zdict__free);
 
 	SG_NULLFREE(pCtx, pData);
 
@@ -2989,6 +3733,231 @@ fail:
     return;
 }
 
+void sg_repo__fs3__store_blobs__batch(
+    SG_context * pCtx,
+    SG_repo * pRepo,
+	SG_repo_tx_handle* pTx,
+    SG_bool b_dont_bother,
+    SG_uint32 count,
+    const SG_byte* const* ap_buf,
+    const SG_uint32* a_len,
+    char** apsz_hid_returned
+    )
+{
+	my_instance_data * pData = NULL;
+    SG_repo_hash_handle* pRHH = NULL;
+	z_stream zStream;
+    SG_bool b_zlib = SG_FALSE;
+    SG_blob_encoding encoding = b_dont_bother ? SG_BLOBENCODING__ALWAYSFULL : SG_BLOBENCODING__ZLIB;
+    SG_uint64 len_bound = 0;
+    SG_uint32 len_out = 0;
+    SG_byte* p_out = NULL;
+    SG_uint32* a_offset = NULL;
+    SG_uint32* a_len_encoded = NULL;
+    SG_bool* a_inline = NULL;
+    SG_blob_encoding* a_encoding = NULL;
+    SG_uint32 count_inline = 0;
+    SG_uint32 filenumber = 0;
+    SG_file* pFile = NULL;
+    SG_uint64 offset_file = 0;
+    char buf_filenumber[sg_FILENUMBER_BUFFER_LENGTH];
+    SG_uint32 count_hashed = 0;
+    SG_uint32 i;
+
+	memset(&zStream,0,sizeof(zStream));
+
+	SG_NULLARGCHECK_RETURN(pRepo);
+	SG_NULLARGCHECK_RETURN(pTx);
+	SG_NULLARGCHECK_RETURN(apsz_hid_returned);
+
+	SG_ERR_CHECK(  SG_repo__get_instance_data(pCtx, pRepo, (void**) &pData)  );
+
+	if (!pData->ptx)
+	{
+		SG_ERR_THROW(  SG_ERR_NO_REPO_TX  );
+	}
+
+    if (pTx != (SG_repo_tx_handle*) pData->ptx)
+    {
+		SG_ERR_THROW(  SG_ERR_BAD_REPO_TX_HANDLE  );
+    }
+
+	if (pData->ptx->pBlobStoreHandle)
+    {
+		SG_ERR_THROW(  SG_ERR_INCOMPLETE_BLOB_IN_REPO_TX  );
+    }
+
+    if (0 == count)
+    {
+        return;
+    }
+
+    SG_NULLARGCHECK(ap_buf);
+    SG_NULLARGCHECK(a_len);
+
+    if (!b_dont_bother)
+    {
+        int zError = deflateInit(&zStream,Z_DEFAULT_COMPRESSION);
+        if (zError != Z_OK)
+        {
+            SG_ERR_THROW(  SG_ERR_ZLIB(zError)  );
+        }
+        b_zlib = SG_TRUE;
+    }
+
+    /* Everything goes into one buffer, so that the whole batch can be
+     * appended to one blob file with one write.  The caller is expected
+     * to keep batches to a few MB. */
+
+    for (i=0; i<count; i++)
+    {
+        SG_NULLARGCHECK(ap_buf[i]);
+        // plus room for the dictionary id, which deflateBound() only
+        // counts once a dictionary has been set
+        len_bound += b_zlib ? (deflateBound(&zStream, a_len[i]) + 4) : a_len[i];
+    }
+    if (len_bound > sg_FS3_MAX_FILE_LENGTH)
+    {
+        SG_ERR_THROW2(  SG_ERR_LIMIT_EXCEEDED,
+                        (pCtx, "blob batch of %d blobs is too large", count)  );
+    }
+
+    SG_ERR_CHECK(  SG_allocN(pCtx, (SG_uint32) len_bound + 1, p_out)  );
+    SG_ERR_CHECK(  SG_allocN(pCtx, count, a_offset)  );
+    SG_ERR_CHECK(  SG_allocN(pCtx, count, a_len_encoded)  );
+    SG_ERR_CHECK(  SG_allocN(pCtx, count, a_inline)  );
+    SG_ERR_CHECK(  SG_allocN(pCtx, count, a_encoding)  );
+
+    for (i=0; i<count; i++)
+    {
+        SG_ERR_CHECK(  sg_repo_utils__hash_begin__from_sghash(pCtx, pData->buf_hash_method, &pRHH)  );
+        SG_ERR_CHECK(  sg_repo_utils__hash_chunk__from_sghash(pCtx, pRHH, a_len[i], ap_buf[i])  );
+        SG_ERR_CHECK(  sg_repo_utils__hash_end__from_sghash(pCtx, &pRHH, &apsz_hid_returned[i])  );
+        count_hashed++;
+
+        a_offset[i] = len_out;
+        a_inline[i] = (
+                pData->b_inline_blobs
+                && (a_len[i] <= sg_FS3_MAX_INLINE_LENGTH)
+                );
+        a_encoding[i] = encoding;
+
+        if (b_zlib)
+        {
+            int zError;
+
+            if (a_inline[i])
+            {
+                SG_bool b_dict = SG_FALSE;
+
+                SG_ERR_CHECK(  sg_fs3__zdict__set_for_deflate(pCtx, pData, &zStream, ap_buf[i], a_len[i], &b_dict)  );
+                if (b_dict)
+                {
+                    a_encoding[i] = SG_BLOBENCODING__ZLIBDICT;
+                }
+            }
+
+            zStream.next_in = (SG_byte*) ap_buf[i];
+            zStream.avail_in = a_len[i];
+            zStream.next_out = p_out + len_out;
+            zStream.avail_out = (SG_uint32) (len_bound - len_out);
+
+            // the output space was sized with deflateBound(), so one
+            // call always finishes the stream.
+            zError = deflate(&zStream,Z_FINISH);
+            if (zError != Z_STREAM_END)
+            {
+                SG_ERR_THROW(  SG_ERR_ZLIB(zError)  );
+            }
+
+            a_len_encoded[i] = (SG_uint32) (zStream.next_out - (p_out + len_out));
+
+            zError = deflateReset(&zStream);
+            if (zError != Z_OK)
+            {
+                SG_ERR_THROW(  SG_ERR_ZLIB(zError)  );
+            }
+        }
+        else
+        {
+            memcpy(p_out + len_out, ap_buf[i], a_len[i]);
+            a_len_encoded[i] = a_len[i];
+        }
+
+        if (a_inline[i])
+        {
+            // same rule as a single store.  the space in p_out gets reused.
+            SG_ERR_CHECK(  sg_fs3__add_inline_row(pCtx, pData, apsz_hid_returned[i], p_out + len_out, a_len_encoded[i])  );
+            SG_ERR_CHECK(  sg_fs3__add_blob_row(
+                        pCtx,
+                        pData,
+                        apsz_hid_returned[i],
+                        NULL,
+                        0,
+                        a_encoding[i],
+                        a_len_encoded[i],
+                        a_len[i],
+                        NULL
+                        )  );
+            count_inline++;
+        }
+        else
+        {
+            len_out += a_len_encoded[i];
+        }
+    }
+
+    if (count_inline < count)
+    {
+        SG_ERR_CHECK(  sg_fs3__find_a_place(pCtx, pData, len_out, &filenumber)  );
+        SG_ERR_CHECK(  sg_fs3__open_filenumber_for_writing(pCtx, pData, filenumber, &pFile, &offset_file)  );
+        if (len_out)
+        {
+            SG_ERR_CHECK(  SG_file__write(pCtx, pFile, len_out, p_out, NULL)  );
+        }
+
+        SG_ERR_CHECK(  sg_fs3__filenumber_to_filename(pCtx, buf_filenumber, sizeof(buf_filenumber), filenumber)  );
+        for (i=0; i<count; i++)
+        {
+            if (a_inline[i])
+            {
+                continue;
+            }
+
+            SG_ERR_CHECK(  sg_fs3__add_blob_row(
+                        pCtx,
+                        pData,
+                        apsz_hid_returned[i],
+                        buf_filenumber,
+                        offset_file + a_offset[i],
+                        encoding,
+                        a_len_encoded[i],
+                        a_len[i],
+                        NULL
+                        )  );
+        }
+    }
+
+fail:
+    if (SG_CONTEXT__HAS_ERR(pCtx))
+    {
+        for (i=0; i<count_hashed; i++)
+        {
+            SG_NULLFREE(pCtx, apsz_hid_returned[i]);
+        }
+    }
+    if (b_zlib)
+    {
+        deflateEnd(&zStream);
+    }
+    SG_ERR_IGNORE(  sg_repo_utils__hash_abort__from_sghash(pCtx, &pRHH)  );
+    SG_NULLFREE(pCtx, p_out);
+    SG_NULLFREE(pCtx, a_offset);
+    SG_NULLFREE(pCtx, a_len_encoded);
+    SG_NULLFREE(pCtx, a_inline);
+    SG_NULLFREE(pCtx, a_encoding);
+}
+
 void sg_repo__fs3__fetch_blob__begin(
     SG_context * pCtx,
     SG_repo * pRepo,
@@ -3055,6 +4024,56 @@ fail:
     return;
 }
 
+void sg_repo__fs3__fetch_blob__file_range(
+    SG_context * pCtx,
+    SG_repo * pRepo,
+    const char* psz_hid_blob,
+    SG_pathname** ppPath,
+    SG_uint64* pOffset,
+    SG_uint64* pLen
+    )
+{
+	my_instance_data * pData = NULL;
+    SG_uint32 filenumber = 0;
+    SG_uint64 offset = 0;
+    SG_blob_encoding blob_encoding_stored = 0;
+    SG_uint64 len_encoded_stored = 0;
+    SG_uint64 len_full_stored = 0;
+    char* psz_hid_vcdiff_reference_stored = NULL;
+    SG_pathname* pPath = NULL;
+
+	SG_NULLARGCHECK_RETURN(pRepo);
+
+	SG_ERR_CHECK(  SG_repo__get_instance_data(pCtx, pRepo, (void**) &pData)  );
+
+    *ppPath = NULL;
+
+    // A blob written in an open transaction can still be rolled back (and
+    // its file truncated), so that one has to be fetched the usual way.
+    if (pData->ptx)
+    {
+        return;
+    }
+
+    SG_ERR_CHECK(  do_fetch_info(pCtx, pData, psz_hid_blob, &filenumber, &offset, &blob_encoding_stored, &len_encoded_stored, &len_full_stored, &psz_hid_vcdiff_reference_stored)  );
+
+    // An inline blob has no file to point at.
+    if (
+            SG_IS_BLOBENCODING_FULL(blob_encoding_stored)
+            && (sg_FS3_INLINE_FILENUMBER != filenumber)
+       )
+    {
+        // The path is cached in pData, so the caller gets a copy.
+        SG_ERR_CHECK(  sg_fs3__get_filenumber_path__uint32(pCtx, pData, filenumber, &pPath)  );
+        SG_ERR_CHECK(  SG_PATHNAME__ALLOC__COPY(pCtx, ppPath, pPath)  );
+        *pOffset = offset;
+        *pLen = len_full_stored;
+    }
+
+fail:
+    SG_NULLFREE(pCtx, psz_hid_vcdiff_reference_stored);
+}
+
 void sg_repo__fs3__fetch_blob__abort(
     SG_context * pCtx,
     SG_repo * pRepo,
@@ -3151,6 +4170,114 @@ fail:
     ;
 }
 
+/**
+ * Inline blobs have no blob file to copy, so we gather them into a
+ * temporary one, send that as another bfile, and point their bindex rows
+ * into it.  This must run before any other rows go into the bindex,
+ * since it moves every row there by the bfile's offset.
+ */
+static void _build_bindex__inline(
+	SG_context* pCtx,
+	my_instance_data* pData,
+    SG_pathname* pPath_dir,
+	SG_fragball_writer* pFragballWriter,
+    const char* psz_tid
+    )
+{
+    char buf_tid[SG_TID_MAX_BUFFER_LENGTH];
+    SG_pathname* pPath = NULL;
+    SG_file* pFile = NULL;
+    sqlite3_stmt* pStmt_read = NULL;
+    sqlite3_stmt* pStmt_write = NULL;
+    SG_uint64 len = 0;
+    SG_uint64 offset = 0;
+    SG_int_to_string_buffer sz_offset;
+    SG_byte* p_full = NULL;
+    int rc = -1;
+
+	SG_ERR_CHECK(  SG_tid__generate(pCtx, buf_tid, sizeof(buf_tid))  );
+    SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPath, pPath_dir, buf_tid)  );
+    SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_WRONLY|SG_FILE_CREATE_NEW, 0644, &pFile)  );
+
+    SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pData->psql, &pStmt_read,
+                "SELECT b.hid, b.encoding, b.len_encoded, b.len_full, b.hid_vcdiff, i.data "
+                "FROM blobs b INNER JOIN inline_blobs i ON i.hid = b.hid "
+                "WHERE b.filename IS NULL")  );
+    SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pData->psql, &pStmt_write,
+                "INSERT INTO %s.blobs (\"hid\", \"offset\", \"encoding\", \"len_encoded\", \"len_full\", \"hid_vcdiff\") VALUES (?, ?, ?, ?, ?, ?)",
+                psz_tid)  );
+
+    while ((rc=sqlite3_step(pStmt_read)) == SQLITE_ROW)
+    {
+        const char* psz_hid = (const char*) sqlite3_column_text(pStmt_read, 0);
+        SG_blob_encoding encoding = (SG_blob_encoding) sqlite3_column_int(pStmt_read, 1);
+        SG_uint64 len_encoded = sqlite3_column_int64(pStmt_read, 2);
+        SG_uint64 len_full = sqlite3_column_int64(pStmt_read, 3);
+        const char* psz_hid_vcdiff = (const char*) sqlite3_column_text(pStmt_read, 4);
+        const SG_byte* p_data = (const SG_byte*) sqlite3_column_blob(pStmt_read, 5);
+        SG_uint32 len_data = (SG_uint32) sqlite3_column_bytes(pStmt_read, 5);
+
+        if (SG_BLOBENCODING__ZLIBDICT == encoding)
+        {
+            // the other side has no dictionary
+            SG_NULLFREE(pCtx, p_full);
+            SG_ERR_CHECK(  sg_fs3__zdict__inflate(pCtx, pData, psz_hid, p_data, len_data, len_full, &p_full)  );
+            encoding = SG_BLOBENCODING__FULL;
+            len_encoded = len_full;
+            p_data = p_full;
+            len_data = (SG_uint32) len_full;
+        }
+
+        SG_ERR_CHECK(  sg_sqlite__reset(pCtx, pStmt_write)  );
+        SG_ERR_CHECK(  sg_sqlite__clear_bindings(pCtx, pStmt_write)  );
+        SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pStmt_write, 1, psz_hid)  );
+        SG_ERR_CHECK(  sg_sqlite__bind_int64(pCtx, pStmt_write, 2, len)  );
+        SG_ERR_CHECK(  sg_sqlite__bind_int64(pCtx, pStmt_write, 3, encoding)  );
+        SG_ERR_CHECK(  sg_sqlite__bind_int64(pCtx, pStmt_write, 4, len_encoded)  );
+        SG_ERR_CHECK(  sg_sqlite__bind_int64(pCtx, pStmt_write, 5, len_full)  );
+        if (psz_hid_vcdiff)
+        {
+            SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pStmt_write, 6, psz_hid_vcdiff)  );
+        }
+        else
+        {
+            SG_ERR_CHECK(  sg_sqlite__bind_null(pCtx, pStmt_write, 6)  );
+        }
+        SG_ERR_CHECK(  sg_sqlite__step(pCtx, pStmt_write, SQLITE_DONE)  );
+
+        if (len_data)
+        {
+            SG_ERR_CHECK(  SG_file__write(pCtx, pFile, len_data, p_data, NULL)  );
+        }
+        len += len_data;
+    }
+    if (rc != SQLITE_DONE)
+    {
+        SG_ERR_THROW(  SG_ERR_SQLITE(rc)  );
+    }
+    SG_ERR_CHECK(  sg_sqlite__nullfinalize(pCtx, &pStmt_read)  );
+    SG_ERR_CHECK(  sg_sqlite__nullfinalize(pCtx, &pStmt_write)  );
+    SG_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+
+    if (len)
+    {
+        SG_ERR_CHECK(  SG_fragball__write__bfile(pCtx, pFragballWriter, pPath, "inline", len, &offset)  );
+        SG_int64_to_sz(offset, sz_offset);
+        SG_ERR_CHECK(  sg_sqlite__exec__va(pCtx, pData->psql, "UPDATE %s.blobs SET \"offset\" = \"offset\" + %s", psz_tid, sz_offset)  );
+    }
+
+fail:
+    SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmt_read)  );
+    SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmt_write)  );
+    SG_FILE_NULLCLOSE(pCtx, pFile);
+    if (pPath)
+    {
+        SG_ERR_IGNORE(  SG_fsobj__remove__pathname(pCtx, pPath)  );
+    }
+    SG_PATHNAME_NULLFREE(pCtx, pPath);
+    SG_NULLFREE(pCtx, p_full);
+}
+
 static void _build_bindex(
 	SG_context* pCtx,
 	my_instance_data* pData,
@@ -3280,6 +4407,11 @@ static void _build_bindex(
 	SG_ERR_CHECK(  sg_sqlite__exec__retry(pCtx, pData->psql, "BEGIN TRANSACTION", MY_SLEEP_MS, MY_TIMEOUT_MS)  );
 	pData->b_in_sqlite_transaction = SG_TRUE;
 
+	if (pData->b_inline_blobs)
+	{
+		SG_ERR_CHECK(  _build_bindex__inline(pCtx, pData, pPath_dir, pFragballWriter, buf_tid)  );
+	}
+
 	for (i=0; i<count_files; i++)
 	{
 		const char* psz_filename = NULL;
@@ -3518,7 +4650,11 @@ static void _build_fragball__blobs(
 #endif
 
         /* open blob file and/or seek only when necessary */
-        if ( !pBlobFile || (currentFilenum != pbh->filenumber) )
+        if (pbh->p_inline)
+        {
+            // already loaded, no file involved
+        }
+        else if ( !pBlobFile || (currentFilenum != pbh->filenumber) )
         {
             if (pBlobFile)
                 SG_FILE_NULLCLOSE(pCtx, pBlobFile);
@@ -3537,7 +4673,14 @@ static void _build_fragball__blobs(
 
             pbh->m_pFileBlob = pBlobFile;
         }
-        next_offset = pbh->offset + len_encoded;
+        if (!pbh->p_inline)
+        {
+            next_offset = pbh->offset + len_encoded;
+        }
+
+        // a ZLIBDICT blob was decoded when it was opened
+        blob_encoding = pbh->blob_encoding_stored;
+        len_encoded = pbh->len_encoded_stored;
 
         SG_ERR_CHECK(  SG_fragball__write_blob__from_handle(pCtx, pFragballWriter,
             (SG_repo_fetch_blob_handle**)&pbh, psz_hid_blob, blob_encoding, psz_hid_vcdiff_reference, len_encoded, len_full)  );
@@ -3700,6 +4843,11 @@ void sg_fs3__begin_tx(
                                           "INSERT INTO \"audits\" (\"csid\", \"dagnum\", \"userid\", \"timestamp\") VALUES (?, ?, ?, ?)")  );
         SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pData->psql,&pData->ptx->cloning.pStmt_insert,
                                           "INSERT OR IGNORE INTO \"blobs\" (\"hid\", \"filename\", \"offset\", \"encoding\", \"len_encoded\", \"len_full\", \"hid_vcdiff\") VALUES (?, ?, ?, ?, ?, ?, ?)")  );
+        if (pData->b_inline_blobs)
+        {
+            SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pData->psql, &pData->ptx->pStmt_inline,
+                                              "INSERT OR IGNORE INTO \"inline_blobs\" (\"hid\", \"data\") VALUES (?, ?)")  );
+        }
 
         SG_ERR_CHECK(  sg_sqlite__exec__retry(pCtx, pData->psql, "BEGIN IMMEDIATE TRANSACTION", MY_SLEEP_MS, MY_TIMEOUT_MS)  );
         pData->b_in_sqlite_transaction = SG_TRUE;
@@ -3712,6 +4860,12 @@ void sg_fs3__begin_tx(
         SG_ERR_CHECK(  sg_sqlite__exec(pCtx, pData->ptx->psql_new_audits, "CREATE TABLE audits (csid VARCHAR NOT NULL, dagnum INTEGER NOT NULL, userid VARCHAR NOT NULL, timestamp INTEGER NOT NULL)")  );
         SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pData->ptx->psql_new_audits,&pData->ptx->pStmt_audits,
                                           "INSERT INTO \"audits\" (\"csid\", \"dagnum\", \"userid\", \"timestamp\") VALUES (?, ?, ?, ?)")  );
+        if (pData->b_inline_blobs)
+        {
+            SG_ERR_CHECK(  sg_sqlite__exec(pCtx, pData->ptx->psql_new_audits, "CREATE TABLE inline_blobs (hid VARCHAR NOT NULL UNIQUE, data BLOB NOT NULL)")  );
+            SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pData->ptx->psql_new_audits, &pData->ptx->pStmt_inline,
+                                              "INSERT OR IGNORE INTO \"inline_blobs\" (\"hid\", \"data\") VALUES (?, ?)")  );
+        }
         SG_ERR_CHECK(  sg_sqlite__exec(pCtx, pData->ptx->psql_new_audits, ("BEGIN TRANSACTION"))  );
 
         SG_ERR_CHECK(  SG_blobset__create(pCtx, &pData->ptx->pbs_new_blobs)  );
@@ -4112,6 +5266,43 @@ fail:
     SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmt_write)  );
 }
 
+static void sg_fs3__store_the_inline_blobs(
+	SG_context * pCtx,
+    my_instance_data* pData
+    )
+{
+    sqlite3_stmt* pStmt_read = NULL;
+    sqlite3_stmt* pStmt_write = NULL;
+    int rc = -1;
+
+    SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, 
+                pData->psql,
+                &pStmt_write,
+                "INSERT OR IGNORE INTO \"inline_blobs\" (\"hid\", \"data\") VALUES (?, ?)")  );
+
+	SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, 
+                pData->ptx->psql_new_audits,
+                &pStmt_read,
+                "SELECT hid, data FROM inline_blobs")  );
+
+    while ((rc=sqlite3_step(pStmt_read)) == SQLITE_ROW)
+    {
+        SG_ERR_CHECK(  sg_sqlite__reset(pCtx, pStmt_write)  );
+        SG_ERR_CHECK(  sg_sqlite__clear_bindings(pCtx, pStmt_write)  );
+        SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pStmt_write, 1, (char*) sqlite3_column_text(pStmt_read, 0))  );
+        SG_ERR_CHECK(  sg_sqlite__bind_blob(pCtx, pStmt_write, 2, (const SG_byte*) sqlite3_column_blob(pStmt_read, 1), (SG_uint32) sqlite3_column_bytes(pStmt_read, 1))  );
+        SG_ERR_CHECK(  sg_sqlite__step(pCtx, pStmt_write, SQLITE_DONE)  );
+    }
+    if (rc != SQLITE_DONE)
+    {
+        SG_ERR_THROW(  SG_ERR_SQLITE(rc)  );
+    }
+
+fail:
+    SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmt_read)  );
+    SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmt_write)  );
+}
+
 static void sg_fs3__store_the_frags(
 	SG_context * pCtx,
 	my_instance_data* pData,
@@ -4228,11 +5419,16 @@ void sg_fs3__commit_tx(
 
         SG_ERR_CHECK(  sg_sqlite__exec(pCtx, pData->ptx->psql_new_audits, ("COMMIT TRANSACTION"))  );
         SG_ERR_CHECK(  sg_sqlite__nullfinalize(pCtx, &pData->ptx->pStmt_audits)  );
+        SG_ERR_CHECK(  sg_sqlite__nullfinalize(pCtx, &pData->ptx->pStmt_inline)  );
 
         SG_ERR_CHECK(  sg_sqlite__exec__retry(pCtx, pData->psql, "BEGIN IMMEDIATE TRANSACTION", MY_SLEEP_MS, MY_TIMEOUT_MS)  );
         pData->b_in_sqlite_transaction = SG_TRUE;
 
         SG_ERR_CHECK(  SG_blobset__copy_into_fs3(pCtx, pData->ptx->pbs_new_blobs, pData->psql)  );
+        if (pData->b_inline_blobs)
+        {
+            SG_ERR_CHECK(  sg_fs3__store_the_inline_blobs(pCtx, pData)  );
+        }
 
         SG_BLOBSET_NULLFREE(pCtx, pData->ptx->pbs_new_blobs);
 
@@ -4383,6 +5579,458 @@ fail:
     SG_PATHNAME_NULLFREE(pCtx, pPath);
 }
 
+typedef struct
+{
+    SG_uint32 count;
+    SG_blob* apb[sg_FS3_ZDICT_MAX_SAMPLES];
+} sg_fs3_zdict_samples;
+
+typedef struct
+{
+    const char* psz;
+    SG_uint32 len;
+    SG_int64 score;
+} sg_fs3_zdict_segment;
+
+static SG_qsort_compare_function sg_fs3__zdict__compare_segments;
+
+static int sg_fs3__zdict__compare_segments(
+    SG_context * pCtx,
+    const void * pVoid1,
+    const void * pVoid2,
+    void * pVoidData
+    )
+{
+    const sg_fs3_zdict_segment* p1 = (const sg_fs3_zdict_segment*) pVoid1;
+    const sg_fs3_zdict_segment* p2 = (const sg_fs3_zdict_segment*) pVoid2;
+
+    SG_UNUSED(pCtx);
+    SG_UNUSED(pVoidData);
+
+    // most valuable first
+    if (p1->score > p2->score)
+    {
+        return -1;
+    }
+    if (p1->score < p2->score)
+    {
+        return 1;
+    }
+    return strcmp(p1->psz, p2->psz);
+}
+
+/* Split a JSON blob into pieces ending with , : { or [ and count, for
+ * each piece, the blobs it appears in. */
+static void sg_fs3__zdict__count_segments(
+    SG_context * pCtx,
+    const SG_blob* pb,
+    SG_vhash* pvh_counts
+    )
+{
+    SG_vhash* pvh_seen = NULL;
+    char buf[sg_FS3_ZDICT_MAX_SEGMENT + 1];
+    SG_uint32 start = 0;
+    SG_uint32 i;
+
+    SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvh_seen)  );
+
+    for (i=0; i<pb->length; i++)
+    {
+        SG_byte c = pb->data[i];
+
+        if (c < 0x20)
+        {
+            start = i + 1;
+        }
+        else if (
+                (',' == c)
+                || (':' == c)
+                || ('{' == c)
+                || ('[' == c)
+                )
+        {
+            SG_uint32 len = i + 1 - start;
+
+            if ((len >= 3) && (len <= sg_FS3_ZDICT_MAX_SEGMENT))
+            {
+                SG_bool b_seen = SG_FALSE;
+
+                memcpy(buf, pb->data + start, len);
+                buf[len] = 0;
+
+                SG_ERR_CHECK(  SG_vhash__has(pCtx, pvh_seen, buf, &b_seen)  );
+                if (!b_seen)
+                {
+                    SG_ERR_CHECK(  SG_vhash__add__null(pCtx, pvh_seen, buf)  );
+                    SG_ERR_CHECK(  SG_vhash__addtoval__int64(pCtx, pvh_counts, buf, 1)  );
+                }
+            }
+
+            start = i + 1;
+        }
+    }
+
+fail:
+    SG_VHASH_NULLFREE(pCtx, pvh_seen);
+}
+
+/* Build a dictionary from the pieces which show up in more than one
+ * blob, keeping the ones which save the most.  The most valuable go
+ * last, nearest to the data. */
+static void sg_fs3__zdict__build(
+    SG_context * pCtx,
+    SG_vhash* pvh_counts,
+    sg_fs3_zdict** ppzd
+    )
+{
+    sg_fs3_zdict_segment* a = NULL;
+    sg_fs3_zdict* pzd = NULL;
+    SG_uint32 count_pairs = 0;
+    SG_uint32 count = 0;
+    SG_uint32 count_chosen = 0;
+    SG_uint32 len_total = 0;
+    SG_uint32 i;
+
+    SG_ERR_CHECK(  SG_vhash__count(pCtx, pvh_counts, &count_pairs)  );
+    if (0 == count_pairs)
+    {
+        *ppzd = NULL;
+        return;
+    }
+
+    SG_ERR_CHECK(  SG_allocN(pCtx, count_pairs, a)  );
+    for (i=0; i<count_pairs; i++)
+    {
+        const char* psz = NULL;
+        const SG_variant* pv = NULL;
+        SG_int64 n = 0;
+
+        SG_ERR_CHECK(  SG_vhash__get_nth_pair(pCtx, pvh_counts, i, &psz, &pv)  );
+        SG_ERR_CHECK(  SG_variant__get__int64(pCtx, pv, &n)  );
+        if (n < 2)
+        {
+            continue;
+        }
+
+        a[count].psz = psz;
+        a[count].len = (SG_uint32) strlen(psz);
+        a[count].score = n * a[count].len;
+        count++;
+    }
+
+    SG_ERR_CHECK(  SG_qsort(pCtx, a, count, sizeof(sg_fs3_zdict_segment), sg_fs3__zdict__compare_segments, NULL)  );
+
+    for (i=0; i<count; i++)
+    {
+        if (len_total + a[i].len <= sg_FS3_ZDICT_MAX_LENGTH)
+        {
+            a[count_chosen++] = a[i];
+            len_total += a[i].len;
+        }
+    }
+
+    if (len_total)
+    {
+        SG_ERR_CHECK(  SG_alloc1(pCtx, pzd)  );
+        SG_ERR_CHECK(  SG_allocN(pCtx, len_total + 1, pzd->p)  );
+        for (i=count_chosen; i>0; i--)
+        {
+            memcpy(pzd->p + pzd->len, a[i-1].psz, a[i-1].len);
+            pzd->len += a[i-1].len;
+        }
+    }
+
+    *ppzd = pzd;
+    pzd = NULL;
+
+fail:
+    SG_ERR_IGNORE(  sg_fs3__zdict__free(pCtx, pzd)  );
+    SG_NULLFREE(pCtx, a);
+}
+
+static void sg_fs3__zdict__add_deflated_length(
+    SG_context * pCtx,
+    z_stream* pzStream,
+    const sg_fs3_zdict* pzd,
+    const SG_blob* pb,
+    SG_byte* p_out,
+    SG_uint32 len_out,
+    SG_uint64* p_total
+    )
+{
+    int zError;
+
+    zError = deflateReset(pzStream);
+    if (zError != Z_OK)
+    {
+        SG_ERR_THROW_RETURN(  SG_ERR_ZLIB(zError)  );
+    }
+
+    if (pzd)
+    {
+        zError = deflateSetDictionary(pzStream, pzd->p, pzd->len);
+        if (zError != Z_OK)
+        {
+            SG_ERR_THROW_RETURN(  SG_ERR_ZLIB(zError)  );
+        }
+    }
+
+    pzStream->next_in = pb->data;
+    pzStream->avail_in = (SG_uint32) pb->length;
+    pzStream->next_out = p_out;
+    pzStream->avail_out = len_out;
+
+    zError = deflate(pzStream,Z_FINISH);
+    if (zError != Z_STREAM_END)
+    {
+        SG_ERR_THROW_RETURN(  SG_ERR_ZLIB(zError)  );
+    }
+
+    *p_total += pzStream->total_out;
+}
+
+static void sg_fs3__zdict__save(
+    SG_context * pCtx,
+    my_instance_data* pData,
+    SG_uint32 kind,
+    const char* psz_id,
+    const sg_fs3_zdict* pzd
+    )
+{
+	sqlite3_stmt * pStmt = NULL;
+    char* psz_base64 = NULL;
+    SG_uint32 space = 0;
+    char buf_name_kind[64];
+    char buf_name_id[64];
+
+    SG_ERR_CHECK(  SG_base64__space_needed_for_encode(pCtx, pzd->len, &space)  );
+    SG_ERR_CHECK(  SG_allocN(pCtx, space, psz_base64)  );
+    SG_ERR_CHECK(  SG_base64__encode(pCtx, pzd->p, pzd->len, psz_base64, space)  );
+
+    SG_ERR_CHECK(  SG_sprintf(pCtx, buf_name_kind, sizeof(buf_name_kind), "%s%s", sg_FS3_ZDICT_PROP_PREFIX, sg_fs3__zdict__names[kind])  );
+    SG_ERR_CHECK(  SG_sprintf(pCtx, buf_name_id, sizeof(buf_name_id), "%s%s", sg_FS3_ZDICT_PROP_PREFIX, psz_id)  );
+
+	SG_ERR_CHECK(  sg_sqlite__exec__retry(pCtx, pData->psql, "BEGIN IMMEDIATE TRANSACTION", MY_SLEEP_MS, MY_TIMEOUT_MS)  );
+	pData->b_in_sqlite_transaction = SG_TRUE;
+
+	SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pData->psql, &pStmt,
+									  "INSERT INTO \"props\" (\"name\", \"value\") SELECT ?, ? WHERE NOT EXISTS (SELECT \"name\" FROM \"props\" WHERE \"name\" = ?)")  );
+	SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pStmt, 1, buf_name_id)  );
+	SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pStmt, 2, psz_base64)  );
+	SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pStmt, 3, buf_name_id)  );
+	SG_ERR_CHECK(  sg_sqlite__step(pCtx, pStmt, SQLITE_DONE)  );
+	SG_ERR_CHECK(  sg_sqlite__nullfinalize(pCtx, &pStmt)  );
+
+	SG_ERR_CHECK(  sg_sqlite__exec__va(pCtx, pData->psql, "DELETE FROM \"props\" WHERE \"name\" = '%s'", buf_name_kind)  );
+	SG_ERR_CHECK(  sg_sqlite__exec__va(pCtx, pData->psql, "INSERT INTO \"props\" (\"name\", \"value\") VALUES ('%s', '%s')", buf_name_kind, psz_id)  );
+
+	SG_ERR_CHECK(  sg_sqlite__exec(pCtx, pData->psql, "COMMIT TRANSACTION")  );
+	pData->b_in_sqlite_transaction = SG_FALSE;
+
+fail:
+	SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmt)  );
+    if (pData->b_in_sqlite_transaction)
+    {
+        SG_ERR_IGNORE(  sg_sqlite__exec(pCtx, pData->psql, "ROLLBACK TRANSACTION")  );
+		pData->b_in_sqlite_transaction = SG_FALSE;
+    }
+    SG_NULLFREE(pCtx, psz_base64);
+}
+
+void sg_repo__fs3__train_blob_dictionaries(
+	SG_context* pCtx,
+    SG_repo* pRepo,
+    SG_vhash** ppvh_stats
+    )
+{
+	my_instance_data * pData = NULL;
+	sqlite3_stmt * pStmt = NULL;
+    SG_varray* pva_hids = NULL;
+    sg_fs3_zdict_samples* a_samples = NULL;
+    SG_vhash* pvh_counts = NULL;
+    SG_vhash* pvh_stats = NULL;
+    SG_vhash* pvh_kind = NULL;
+    sg_fs3_zdict* pzd = NULL;
+    SG_blob* pb = NULL;
+	z_stream zStream;
+    SG_bool b_zlib = SG_FALSE;
+    SG_byte* p_out = NULL;
+    SG_uint32 len_out = 2 * sg_FS3_MAX_INLINE_LENGTH;
+    SG_uint32 count_hids = 0;
+    SG_uint32 i;
+    SG_uint32 k;
+    int rc;
+
+	memset(&zStream,0,sizeof(zStream));
+
+	SG_NULLARGCHECK_RETURN(pRepo);
+
+	SG_ERR_CHECK(  SG_repo__get_instance_data(pCtx, pRepo, (void**) &pData)  );
+
+    SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvh_stats)  );
+
+    // only inline blobs use a dictionary, so an older format has no use
+    // for one
+    if (!pData->b_inline_blobs)
+    {
+        goto done;
+    }
+
+    // the newest blobs are the best guide to the next ones.  there is
+    // nothing to learn from an empty one.
+
+    SG_ERR_CHECK(  SG_VARRAY__ALLOC(pCtx, &pva_hids)  );
+	SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pData->psql, &pStmt,
+									  "SELECT \"hid\" FROM \"blobs\" WHERE \"filename\" IS NULL AND \"len_full\" > 0 AND \"len_full\" <= %d ORDER BY rowid DESC LIMIT %d",
+									  sg_FS3_MAX_INLINE_LENGTH, sg_FS3_ZDICT_MAX_SCAN)  );
+    while ((rc=sqlite3_step(pStmt)) == SQLITE_ROW)
+    {
+        SG_ERR_CHECK(  SG_varray__append__string__sz(pCtx, pva_hids, (const char*) sqlite3_column_text(pStmt, 0))  );
+    }
+    if (rc != SQLITE_DONE)
+    {
+        SG_ERR_THROW(  SG_ERR_SQLITE(rc)  );
+    }
+	SG_ERR_CHECK(  sg_sqlite__nullfinalize(pCtx, &pStmt)  );
+
+    SG_ERR_CHECK(  SG_allocN(pCtx, sg_FS3_ZDICT__COUNT, a_samples)  );
+
+    SG_ERR_CHECK(  SG_varray__count(pCtx, pva_hids, &count_hids)  );
+    for (i=0; i<count_hids; i++)
+    {
+        const char* psz_hid = NULL;
+
+        SG_ERR_CHECK(  SG_varray__get__sz(pCtx, pva_hids, i, &psz_hid)  );
+        SG_ERR_CHECK(  sg_repo__fs3__get_blob(pCtx, pRepo, psz_hid, &pb)  );
+
+        if (
+                sg_fs3__zdict__classify(pb->data, (SG_uint32) pb->length, &k)
+                && (a_samples[k].count < sg_FS3_ZDICT_MAX_SAMPLES)
+           )
+        {
+            a_samples[k].apb[a_samples[k].count++] = pb;
+            pb = NULL;
+        }
+        else
+        {
+            SG_ERR_CHECK(  sg_repo__fs3__release_blob(pCtx, pRepo, &pb)  );
+        }
+    }
+
+    {
+        int zError = deflateInit(&zStream,Z_DEFAULT_COMPRESSION);
+        if (zError != Z_OK)
+        {
+            SG_ERR_THROW(  SG_ERR_ZLIB(zError)  );
+        }
+        b_zlib = SG_TRUE;
+    }
+    SG_ERR_CHECK(  SG_allocN(pCtx, len_out, p_out)  );
+
+    for (k=0; k<sg_FS3_ZDICT__COUNT; k++)
+    {
+        SG_uint64 len_full = 0;
+        SG_uint64 len_zlib = 0;
+        SG_uint64 len_zlibdict = 0;
+        SG_bool b_used = SG_FALSE;
+
+        SG_ERR_CHECK(  SG_vhash__addnew__vhash(pCtx, pvh_stats, sg_fs3__zdict__names[k], &pvh_kind)  );
+        SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvh_kind, "samples", a_samples[k].count)  );
+
+        // with one or two blobs to go on, there is nothing to learn
+        if (a_samples[k].count >= 3)
+        {
+            SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvh_counts)  );
+            for (i=0; i<a_samples[k].count; i++)
+            {
+                SG_ERR_CHECK(  sg_fs3__zdict__count_segments(pCtx, a_samples[k].apb[i], pvh_counts)  );
+            }
+            SG_ERR_CHECK(  sg_fs3__zdict__build(pCtx, pvh_counts, &pzd)  );
+            SG_VHASH_NULLFREE(pCtx, pvh_counts);
+        }
+
+        if (pzd)
+        {
+            char buf_id[sg_FS3_ZDICT_ID_BUFFER_LENGTH];
+            sg_fs3_zdict* pzd_existing = NULL;
+
+            for (i=0; i<a_samples[k].count; i++)
+            {
+                len_full += a_samples[k].apb[i]->length;
+                SG_ERR_CHECK(  sg_fs3__zdict__add_deflated_length(pCtx, &zStream, NULL, a_samples[k].apb[i], p_out, len_out, &len_zlib)  );
+                SG_ERR_CHECK(  sg_fs3__zdict__add_deflated_length(pCtx, &zStream, pzd, a_samples[k].apb[i], p_out, len_out, &len_zlibdict)  );
+            }
+
+            SG_ERR_CHECK(  sg_fs3__zdict__format_id(pCtx, adler32(adler32(0L, Z_NULL, 0), pzd->p, pzd->len), buf_id, sizeof(buf_id))  );
+            SG_ERR_CHECK(  sg_fs3__zdict__find(pCtx, pData, buf_id, &pzd_existing)  );
+
+            // the id is only 32 bits, so never reuse one for different contents
+            if (
+                    (len_zlibdict < len_zlib)
+                    && (
+                        !pzd_existing
+                        || (
+                            (pzd_existing->len == pzd->len)
+                            && (0 == memcmp(pzd_existing->p, pzd->p, pzd->len))
+                           )
+                       )
+               )
+            {
+                SG_ERR_CHECK(  sg_fs3__zdict__save(pCtx, pData, k, buf_id, pzd)  );
+                b_used = SG_TRUE;
+            }
+
+            SG_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pvh_kind, "id", buf_id)  );
+            SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvh_kind, "length", pzd->len)  );
+            SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvh_kind, "full", len_full)  );
+            SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvh_kind, "zlib", len_zlib)  );
+            SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvh_kind, "zlibdict", len_zlibdict)  );
+
+            SG_ERR_IGNORE(  sg_fs3__zdict__free(pCtx, pzd)  );
+            pzd = NULL;
+        }
+
+        SG_ERR_CHECK(  SG_vhash__add__bool(pCtx, pvh_kind, "used", b_used)  );
+    }
+
+    // pick up the new current ones
+    SG_ERR_CHECK(  sg_fs3__zdict__load(pCtx, pData)  );
+
+done:
+    if (ppvh_stats)
+    {
+        *ppvh_stats = pvh_stats;
+        pvh_stats = NULL;
+    }
+
+fail:
+	SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmt)  );
+    if (a_samples)
+    {
+        for (k=0; k<sg_FS3_ZDICT__COUNT; k++)
+        {
+            for (i=0; i<a_samples[k].count; i++)
+            {
+                SG_ERR_IGNORE(  sg_repo__fs3__release_blob(pCtx, pRepo, &a_samples[k].apb[i])  );
+            }
+        }
+        SG_NULLFREE(pCtx, a_samples);
+    }
+    if (pb)
+    {
+        SG_ERR_IGNORE(  sg_repo__fs3__release_blob(pCtx, pRepo, &pb)  );
+    }
+    if (b_zlib)
+    {
+        deflateEnd(&zStream);
+    }
+    SG_ERR_IGNORE(  sg_fs3__zdict__free(pCtx, pzd)  );
+    SG_NULLFREE(pCtx, p_out);
+    SG_VARRAY_NULLFREE(pCtx, pva_hids);
+    SG_VHASH_NULLFREE(pCtx, pvh_counts);
+    SG_VHASH_NULLFREE(pCtx, pvh_stats);
+}
+
 void sg_repo__fs3__query_audits(
         SG_context* pCtx,
         SG_repo* pRepo,
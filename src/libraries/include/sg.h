@@ -130,6 +130,7 @@ typedef struct _SG_pathname		SG_pathname;
 
 typedef struct _SG_strpool      SG_strpool;
 typedef struct _SG_varpool      SG_varpool;
+typedef struct _SG_arena        SG_arena;
 typedef struct _SG_vhash        SG_vhash;
 typedef struct _SG_ihash        SG_ihash;
 typedef struct _SG_varray       SG_varray;
@@ -205,6 +206,7 @@ typedef struct _SG_jsonparser   SG_jsonparser;
 #include <sg_mutex_typedefs.h>
 #include <sg_history.h>
 #include <sg_httprequestprofiler_typedefs.h>
+#include <sg_perf_typedefs.h>
 #include <sg_rbtreedb.h>
 #include <sg_timestamp_cache.h>
 #include <sg_version.h>
@@ -254,6 +256,8 @@ typedef void (SG_ut__prompt_for_comment__callback)(SG_context * pCtx,
 #include <sg_tncache_prototypes.h>
 #include <sg_hdb_prototypes.h>
 #include <sg_httprequestprofiler_prototypes.h>
+#include <sg_perf_prototypes.h>
+#include <sg_responsecache_prototypes.h>
 #include <sg_cert_prototypes.h>
 #include <sg_mutex_prototypes.h>
 #include <sg_error_prototypes.h>
@@ -344,6 +348,7 @@ typedef void (SG_ut__prompt_for_comment__callback)(SG_context * pCtx,
 #include <sg_ihash.h>
 #include <sg_varpool.h>
 #include <sg_strpool.h>
+#include <sg_arena.h>
 #include <sg_jsonwriter.h>
 #include <sg_jsonparser.h>
 #include <sg_vcdiff.h>
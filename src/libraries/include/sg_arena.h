@@ -0,0 +1,115 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file sg_arena.h
+ *
+ * @details SG_arena is a bump allocator for request-scoped data.
+ * Memory handed out by the arena is never freed individually;
+ * everything is released at once when the arena is freed.
+ *
+ * The arena also owns a string pool and a variant pool, so an
+ * entire graph of vhashes and varrays (see SG_vhash__alloc__arena()
+ * and SG_varray__alloc__arena()) can be built from it and torn down
+ * without visiting each node.
+ *
+ * Objects which were NOT allocated from the arena but which get
+ * attached to an arena-backed vhash or varray are "adopted": the
+ * arena remembers them and frees them when it is freed.
+ *
+ * An arena is not thread-safe.
+ *
+ */
+
+#ifndef H_SG_ARENA_H
+#define H_SG_ARENA_H
+
+BEGIN_EXTERN_C
+
+void SG_arena__alloc(
+	SG_context* pCtx,
+	SG_arena** ppNew,
+	SG_uint32 chunk_space      /**< Size of each block of memory
+								* requested from the system.  Pass
+								* 0 for the default. */
+	);
+
+#if defined(DEBUG)
+#define SG_ARENA__ALLOC(pCtx,ppNew,chunk_space)		SG_STATEMENT(	SG_arena * _p = NULL;											\
+																	SG_arena__alloc(pCtx,&_p,chunk_space);							\
+																	_sg_mem__set_caller_data(_p,__FILE__,__LINE__,"SG_arena");		\
+																	*(ppNew) = _p;													)
+#else
+#define SG_ARENA__ALLOC(pCtx,ppNew,chunk_space)		SG_arena__alloc(pCtx,ppNew,chunk_space)
+#endif
+
+//////////////////////////////////////////////////////////////////
+
+/**
+ * Free the arena, everything allocated from it, and everything it adopted.
+ */
+void SG_arena__free(SG_context * pCtx, SG_arena* pArena);
+
+/**
+ * Get zeroed, pointer-aligned space for count*size bytes.
+ * The memory belongs to the arena.  Do not free it.
+ */
+void SG_arena__alloc_space(
+	SG_context* pCtx,
+	SG_arena* pArena,
+	SG_uint32 count,
+	SG_uint32 size,
+	void** ppOut
+	);
+
+/**
+ * Hand ownership of an object which was not allocated from
+ * the arena over to the arena.  The given callback will be
+ * used to free it when the arena is freed.
+ */
+void SG_arena__adopt(
+	SG_context* pCtx,
+	SG_arena* pArena,
+	void* p,
+	SG_free_callback* pfnFree
+	);
+
+/**
+ * Get the string and variant pools owned by the arena.
+ * Either result pointer may be NULL.
+ */
+void SG_arena__get_pools(
+	SG_context* pCtx,
+	SG_arena* pArena,
+	SG_strpool** ppStrPool,
+	SG_varpool** ppVarPool
+	);
+
+/**
+ * How many bytes have been handed out and how many
+ * chunks were requested from the system.
+ */
+void SG_arena__get_stats(
+	SG_context* pCtx,
+	const SG_arena* pArena,
+	SG_uint64* pcbUsed,
+	SG_uint32* pcChunks
+	);
+
+END_EXTERN_C
+
+#endif
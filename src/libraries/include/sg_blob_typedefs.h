@@ -50,6 +50,15 @@ typedef SG_byte SG_blob_encoding;
 #define SG_BLOBENCODING__ZLIB		        ((SG_blob_encoding)'z')
 #define SG_BLOBENCODING__VCDIFF			    ((SG_blob_encoding)'v')
 
+/**
+ * zlib with a preset dictionary from the repo's props.  This is only
+ * found in a repo's own storage, and only in a repo created with
+ * new_repo/inline_blobs, whose format says it may be there.  A blob fetched from the repo in this
+ * encoding always comes back FULL, so it never gets into a fragball and
+ * the rest of the code never sees it.
+ */
+#define SG_BLOBENCODING__ZLIBDICT	        ((SG_blob_encoding)'d')
+
 #define SG_IS_BLOBENCODING_FULL(e) ((SG_BLOBENCODING__FULL == (e)) || (SG_BLOBENCODING__KEEPFULLFORNOW == (e)) || (SG_BLOBENCODING__ALWAYSFULL == (e)))
 
 #define SG_IS_BLOBENCODING_ZLIB(e) ((SG_BLOBENCODING__ZLIB == (e)) )
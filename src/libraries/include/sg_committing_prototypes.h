@@ -303,6 +303,14 @@ void SG_committing__db__add_record(SG_context * pCtx,
 								 SG_committing * pCommitting,
 								 SG_dbrecord * pRecord);
 
+/**
+ * Like SG_committing__db__add_record(), but stores the records in batches.
+ * */
+void SG_committing__db__add_records(SG_context * pCtx,
+								 SG_committing * pCommitting,
+								 SG_dbrecord ** apRecords,
+								 SG_uint32 count);
+
 //////////////////////////////////////////////////////////////////
 
 END_EXTERN_C;
@@ -57,6 +57,16 @@ void SG_dbrecord__save_to_repo(SG_context*,
 	SG_uint64* iBlobFullLength
 	);
 
+/**
+ * Save (and freeze) many records at once, using SG_repo__store_blobs__batch().
+ */
+void SG_dbrecord__save_to_repo__batch(SG_context*,
+	SG_dbrecord** aprec,
+	SG_uint32 count,
+	SG_repo * pRepo,
+	SG_repo_tx_handle* pRepoTx
+	);
+
 void SG_dbrecord__load_from_repo(SG_context*,
 	SG_repo * pRepo,
 	const char* pszidHidBlob,
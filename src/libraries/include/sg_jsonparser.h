@@ -103,6 +103,20 @@ void SG_veither__parse_json__buflen__utf8_fix(
         SG_varray** ppva
         );
 
+/**
+ * Like SG_veither__parse_json__buflen(), but the resulting
+ * vhash/varray (and everything in it) is allocated from the
+ * given arena.  See SG_vhash__alloc__arena().
+ */
+void SG_veither__parse_json__buflen__arena(
+        SG_context* pCtx, 
+        SG_arena* pArena,
+        const char* pszJson,
+        SG_uint32 len,
+        SG_vhash** ppvh, 
+        SG_varray** ppva
+        );
+
 END_EXTERN_C
 
 #endif
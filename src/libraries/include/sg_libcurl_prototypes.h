@@ -65,6 +65,19 @@ void SG_curl__set__read_file(SG_context* pCtx, SG_curl* pCurl, SG_file* pFile, S
  */
 void SG_curl__set__write_file(SG_context* pCtx, SG_curl* pCurl, SG_file* pFile);
 
+/**
+ * Like SG_curl__set__write_file, for a download which continues one that was interrupted.
+ * The file should be open for writing and positioned at its end, and the request should
+ * carry Range and If-Range headers asking for the rest.  If the server answers 206, the
+ * response is appended.  If it answers 200, the file is truncated and the whole response
+ * is written to it.
+ *
+ * If pPathETag is provided, the response's ETag is written there as soon as the response
+ * starts (or the file is removed if the response has none), so that the download can be
+ * resumed even if this process doesn't get to finish it.
+ */
+void SG_curl__set__resume_file(SG_context* pCtx, SG_curl* pCurl, SG_file* pFile, const SG_pathname* pPathETag);
+
 /**
  * Use the provided write callback for this request/response.
  * The caller retains ownership of pState and should free it after SG_curl__perform.
@@ -94,10 +107,24 @@ void SG_curl__record_headers(SG_context * pCtx, SG_curl* pCurl);
  */
 void SG_curl__get_response_headers(SG_context * pCtx, SG_curl * pCurl, SG_string ** ppHeaders);
 
+/**
+ * Get the value of one recorded response header, or NULL if the response didn't have it.
+ * The name is matched case-insensitively.  Headers must be recorded (see above).
+ */
+void SG_curl__get_response_header(SG_context * pCtx, SG_curl * pCurl, const char * pszName, char ** ppszValue);
+
 void SG_curl__throw_on_non200(SG_context* pCtx, SG_curl* pCurl);
 
 void SG_curl__perform(SG_context* pCtx, SG_curl* pCurl);
 
+/**
+ * Get the number of requests performed by this process and the bytes
+ * sent and received for them, headers included.  Any result pointer
+ * may be NULL.  These only ever grow, so callers measure a span of
+ * work by taking the difference.
+ */
+void SG_curl__get_transfer_totals(SG_context* pCtx, SG_uint64* pCountRequests, SG_uint64* pBytesSent, SG_uint64* pBytesReceived);
+
 #define SG_CURL_NULLFREE(pCtx,p)				SG_STATEMENT(	SG_context__push_level(pCtx); \
 																SG_curl__free(pCtx, p); \
 																SG_ASSERT(!SG_CONTEXT__HAS_ERR(pCtx)); \
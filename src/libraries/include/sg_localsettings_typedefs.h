@@ -40,10 +40,13 @@ BEGIN_EXTERN_C;
  * #defines for client-specific settings elsewhere, or else just use
  * plain old strings without #defines.
  */
+#define SG_LOCALSETTING__FAST_EXPORT_THREADS       "fast_export/threads"
+#define SG_LOCALSETTING__FAST_IMPORT_THREADS       "fast_import/threads"
 #define SG_LOCALSETTING__IGNORES                   "ignores"
 #define SG_LOCALSETTING__NEWREPO_DRIVER            "new_repo/driver"
 #define SG_LOCALSETTING__NEWREPO_CONNECTSTRING     "new_repo/connect_string"
 #define SG_LOCALSETTING__NEWREPO_HASHMETHOD        "new_repo/hash_method"
+#define SG_LOCALSETTING__NEWREPO_INLINE_BLOBS      "new_repo/inline_blobs"
 #define SG_LOCALSETTING__PATHS                     "paths"
 #define SG_LOCALSETTING__PATHS_DEFAULT             "paths/default"
 #define SG_LOCALSETTING__SYNC_TARGETS			   "sync_targets"
@@ -60,6 +63,18 @@ BEGIN_EXTERN_C;
 #define SG_LOCALSETTING__SERVER_REMOTE_AJAX_LIBS      "server/remote_ajax_libs"
 #define SG_LOCALSETTING__SERVER_READONLY           "server/readonly"
 #define SG_LOCALSETTING__SERVER_CLONE_ALLOWED      "server/clone_allowed"
+#define SG_LOCALSETTING__SERVER_CLONE_CACHE_SIZE   "server/clone_cache/max_mb"
+#define SG_LOCALSETTING__SERVER_CLONE_CACHE_TOPUP_SECONDS "server/clone_cache/topup_seconds"
+#define SG_LOCALSETTING__SERVER_CLONE_CACHE_LOCK_WAIT_SECONDS "server/clone_cache/lock_wait_seconds"
+#define SG_LOCALSETTING__SERVER_CLONE_CACHE_STALE_LOCK_SECONDS "server/clone_cache/stale_lock_seconds"
+#define SG_LOCALSETTING__SERVER_KEEPALIVE_TIMEOUT  "server/keepalive/timeout_seconds"
+#define SG_LOCALSETTING__SERVER_KEEPALIVE_MAX_REQUESTS "server/keepalive/max_requests"
+#define SG_LOCALSETTING__SERVER_KEEPALIVE_MAX_IDLE "server/keepalive/max_idle"
+#define SG_LOCALSETTING__SERVER_COMPRESSION_MIN_BYTES "server/compression/min_bytes"
+#define SG_LOCALSETTING__SERVER_COMPRESSION_CACHE "server/compression/cache_dir"
+#define SG_LOCALSETTING__SERVER_RESPONSE_CACHE_SIZE "server/response_cache/max_mb"
+#define SG_LOCALSETTING__SERVER_RESPONSE_CACHE_VALIDATE_SECONDS "server/response_cache/validate_seconds"
+#define SG_LOCALSETTING__SERVER_RESPONSE_CACHE_SPILL "server/response_cache/spill"
 #define SG_LOCALSETTING__USERID                    "whoami/userid"
 #define SG_LOCALSETTING__USERNAME                  "whoami/username"
 #define SG_LOCALSETTING__VERIFY_SSL_CERTS          "network/verify_ssl_certs"
@@ -23,6 +23,7 @@ BEGIN_EXTERN_C
 
 #define SG_FSOBJ_STAT_NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,SG_fsobj_stat__free)
 #define SG_IHASH_NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,SG_ihash__free)
+#define SG_ARENA_NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,SG_arena__free)
 #define SG_BLOBSET_NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,SG_blobset__free)
 #define SG_CHANGESET_NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,SG_changeset__free)
 #define SG_DAGFRAG_NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,SG_dagfrag__free)
@@ -54,6 +55,7 @@ BEGIN_EXTERN_C
 #define SG_SYNC_CLIENT_NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,SG_sync_client__close_free)
 #define SG_TEXTFILEDIFF_NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,SG_textfilediff__free)
 #define SG_TEXTFILEDIFF_ITERATOR_NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,SG_textfilediff__iterator__free)
+#define SG_THREAD_POOL_NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,SG_thread_pool__free)
 #define SG_TIMESTAMP_CACHE_NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,SG_timestamp_cache__free)
 #define SG_TREENODE_NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,SG_treenode__free)
 #define SG_TREENODE_ENTRY_NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,SG_treenode_entry__free)
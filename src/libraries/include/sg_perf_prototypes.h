@@ -0,0 +1,101 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file sg_perf_prototypes.h
+ *
+ * @details Named timers and counters for the library's hot paths.
+ *
+ * The calls are always compiled in.  Until SG_perf__global_init() is
+ * called, SG_perf__start() returns 0 and SG_perf__stop() ignores it,
+ * so the cost is a pointer test.
+ *
+ * Usage:
+ *
+ *     SG_int64 t = SG_perf__start();
+ *     ...
+ *     SG_perf__stop(SG_PERF_CATEGORY__SQLITE, t, 0);
+ *
+ * Besides the fixed categories, a timer can have a name of its own
+ * (SG_perf__stop__named()), and SG_perf__count() keeps a named
+ * counter.  Each name gets its own totals.
+ *
+ */
+
+//////////////////////////////////////////////////////////////////
+
+#ifndef H_SG_PERF_PROTOTYPES_H
+#define H_SG_PERF_PROTOTYPES_H
+
+BEGIN_EXTERN_C;
+
+/**
+ * Start collecting.  When bTrace is set, individual calls are also
+ * remembered (up to a limit) so SG_perf__write_trace() can write them.
+ */
+void SG_perf__global_init(SG_context * pCtx, SG_bool bTrace);
+void SG_perf__global_cleanup(void);
+
+/**
+ * A timestamp in microseconds, or 0 when we aren't collecting.
+ */
+SG_int64 SG_perf__start(void);
+
+/**
+ * Charge the time since tStart (from SG_perf__start()) and the given
+ * number of units to a category.
+ */
+void SG_perf__stop(SG_perf_category category, SG_int64 tStart, SG_uint64 units);
+
+/**
+ * Like SG_perf__stop(), with a name.  The call is charged to the
+ * category and also to the name's own totals, and the name is used
+ * for the trace event.  The name must outlive the collection (a string
+ * literal, or a command table).
+ */
+void SG_perf__stop__named(SG_perf_category category, const char * pszName, SG_int64 tStart, SG_uint64 units);
+
+/**
+ * Add one call and the given number of units to a named counter.  No
+ * time is charged.  The trace gets a counter event with the running
+ * total of units.  The same rule applies to the name.
+ */
+void SG_perf__count(const char * pszName, SG_uint64 units);
+
+/**
+ * Returns NULL when we aren't collecting.  Otherwise a vhash with a
+ * member for each category that was used:
+ *
+ *     { "sqlite" : { "calls" : 1234, "us" : 56789, "units" : 0 }, ... }
+ */
+void SG_perf__get_totals(SG_context * pCtx, SG_vhash ** ppvhTotals);
+
+/**
+ * Like SG_perf__get_totals(), for the named timers and counters.  The
+ * members are the names, in order.  A counter's "us" is 0.
+ */
+void SG_perf__get_named_totals(SG_context * pCtx, SG_vhash ** ppvhTotals);
+
+/**
+ * Write the remembered calls as a Chrome trace (the JSON Object
+ * Format understood by chrome://tracing and Perfetto).
+ */
+void SG_perf__write_trace(SG_context * pCtx, const SG_pathname * pPath);
+
+END_EXTERN_C;
+
+#endif //H_SG_PERF_PROTOTYPES_H
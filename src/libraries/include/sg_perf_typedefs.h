@@ -0,0 +1,52 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file sg_perf_typedefs.h
+ *
+ */
+
+#ifndef H_SG_PERF_TYPEDEFS_H
+#define H_SG_PERF_TYPEDEFS_H
+
+BEGIN_EXTERN_C;
+
+////////////////////////////////////////////////////////////////////////////////
+
+// The hot paths we keep timers and counters for.  These can nest (a blob
+// fetch includes any inflate or undeltify it does, and the command
+// includes everything), so the totals are inclusive and don't add up to the
+// elapsed time.
+typedef enum
+{
+	SG_PERF_CATEGORY__COMMAND,			// the whole vv command
+	SG_PERF_CATEGORY__SQLITE,			// the sg_sqlite__step and sg_sqlite__exec wrappers
+	SG_PERF_CATEGORY__BLOB_FETCH,		// SG_repo__fetch_blob__ begin and chunk; units are bytes returned
+	SG_PERF_CATEGORY__BLOB_INFLATE,		// zlib inflate of stored blobs; units are bytes inflated
+	SG_PERF_CATEGORY__BLOB_UNDELTIFY,	// vcdiff windows applied; units are bytes produced
+	SG_PERF_CATEGORY__HASH,				// hash chunks; units are bytes hashed
+	SG_PERF_CATEGORY__FS_SCAN,			// SG_dir open and read; units are entries
+	SG_PERF_CATEGORY__NETWORK,			// SG_curl__perform; units are bytes sent and received
+
+	SG_PERF_CATEGORY__COUNT
+} SG_perf_category;
+
+////////////////////////////////////////////////////////////////////////////////
+
+END_EXTERN_C;
+
+#endif//H_SG_PERF_TYPEDEFS_H
@@ -247,6 +247,17 @@ typedef void FN__sg_repo__store_blob__abort(
     SG_repo_store_blob_handle** pHandle
     );
 
+typedef void FN__sg_repo__store_blobs__batch(
+    SG_context* pCtx,
+	SG_repo * pRepo,
+	SG_repo_tx_handle* pTx,
+    SG_bool b_dont_bother,
+    SG_uint32 count,
+    const SG_byte* const* ap_buf,
+    const SG_uint32* a_len,
+    char** apsz_hid_returned
+    );
+
 typedef void FN__sg_repo__get_blob(
     SG_context* pCtx,
 	SG_repo * pRepo,
@@ -294,6 +305,15 @@ typedef void FN__sg_repo__fetch_blob__abort(
     SG_repo_fetch_blob_handle** ppHandle
     );
 
+typedef void FN__sg_repo__fetch_blob__file_range(
+    SG_context* pCtx,
+	SG_repo * pRepo,
+    const char* psz_hid_blob,
+    SG_pathname** ppPath,
+    SG_uint64* pOffset,
+    SG_uint64* pLen
+    );
+
 typedef void FN__sg_repo__fetch_repo__fragball(
 	SG_context* pCtx,
 	SG_repo* pRepo,
@@ -551,6 +571,12 @@ typedef void FN__sg_repo__rebuild_indexes(
     SG_repo* pRepo
     );
 
+typedef void FN__sg_repo__train_blob_dictionaries(
+	SG_context* pCtx,
+    SG_repo* pRepo,
+    SG_vhash** ppvh_stats
+    );
+
 typedef void FN__sg_repo__query_audits(
         SG_context* pCtx,
         SG_repo* pRepo,
@@ -773,6 +799,7 @@ struct _sg_repo__vtable
 	FN__sg_repo__store_blob__chunk              * const		store_blob__chunk;
 	FN__sg_repo__store_blob__end                * const		store_blob__end;
 	FN__sg_repo__store_blob__abort              * const		store_blob__abort;
+	FN__sg_repo__store_blobs__batch             * const		store_blobs__batch;
 
 	FN__sg_repo__store_audit		            * const		store_audit;
 
@@ -786,6 +813,7 @@ struct _sg_repo__vtable
 	FN__sg_repo__fetch_blob__chunk              * const		fetch_blob__chunk;
 	FN__sg_repo__fetch_blob__end                * const		fetch_blob__end;
 	FN__sg_repo__fetch_blob__abort              * const		fetch_blob__abort;
+	FN__sg_repo__fetch_blob__file_range         * const		fetch_blob__file_range;
 
 	FN__sg_repo__fetch_repo__fragball           * const		fetch_repo__fragball;
 
@@ -817,6 +845,7 @@ struct _sg_repo__vtable
 	FN__sg_repo__query_blob_existence			* const		query_blob_existence;
     
 	FN__sg_repo__rebuild_indexes                 * const		rebuild_indexes;
+	FN__sg_repo__train_blob_dictionaries         * const		train_blob_dictionaries;
 
 	FN__sg_repo__dbndx__make_delta_from_path                  * const		dbndx__make_delta_from_path;
 	FN__sg_repo__dbndx__query                  * const		dbndx__query;
@@ -866,6 +895,7 @@ typedef struct _sg_repo__vtable sg_repo__vtable;
 	FN__sg_repo__store_blob__chunk              sg_repo__##name##__store_blob__chunk;               \
 	FN__sg_repo__store_blob__end                sg_repo__##name##__store_blob__end;                 \
 	FN__sg_repo__store_blob__abort              sg_repo__##name##__store_blob__abort;               \
+	FN__sg_repo__store_blobs__batch             sg_repo__##name##__store_blobs__batch;              \
 	FN__sg_repo__store_audit			        sg_repo__##name##__store_audit;		            \
 	FN__sg_repo__store_dagfrag			        sg_repo__##name##__store_dagfrag;		            \
 	FN__sg_repo__done_with_dag			        sg_repo__##name##__done_with_dag;		            \
@@ -875,6 +905,7 @@ typedef struct _sg_repo__vtable sg_repo__vtable;
 	FN__sg_repo__fetch_blob__chunk              sg_repo__##name##__fetch_blob__chunk;               \
 	FN__sg_repo__fetch_blob__end                sg_repo__##name##__fetch_blob__end;                 \
 	FN__sg_repo__fetch_blob__abort              sg_repo__##name##__fetch_blob__abort;               \
+	FN__sg_repo__fetch_blob__file_range         sg_repo__##name##__fetch_blob__file_range;          \
 	FN__sg_repo__fetch_repo__fragball           sg_repo__##name##__fetch_repo__fragball;            \
 	FN__sg_repo__check_dagfrag			        sg_repo__##name##__check_dagfrag;		            \
 	FN__sg_repo__fetch_dagnode			        sg_repo__##name##__fetch_dagnode;		            \
@@ -898,6 +929,7 @@ typedef struct _sg_repo__vtable sg_repo__vtable;
 	FN__sg_repo__query_implementation           sg_repo__##name##__query_implementation;            \
 	FN__sg_repo__query_blob_existence           sg_repo__##name##__query_blob_existence;            \
 	FN__sg_repo__rebuild_indexes                sg_repo__##name##__rebuild_indexes;					\
+	FN__sg_repo__train_blob_dictionaries        sg_repo__##name##__train_blob_dictionaries;			\
 	FN__sg_repo__dbndx__make_delta_from_path					sg_repo__##name##__dbndx__make_delta_from_path;                    \
 	FN__sg_repo__dbndx__query					sg_repo__##name##__dbndx__query;                    \
 	FN__sg_repo__dbndx__query__prep				sg_repo__##name##__dbndx__query__prep;               \
@@ -941,6 +973,7 @@ typedef struct _sg_repo__vtable sg_repo__vtable;
 		sg_repo__##name##__store_blob__chunk,               \
 		sg_repo__##name##__store_blob__end,                 \
 		sg_repo__##name##__store_blob__abort,               \
+		sg_repo__##name##__store_blobs__batch,              \
 		sg_repo__##name##__store_audit, 					\
 		sg_repo__##name##__store_dagfrag,					\
 		sg_repo__##name##__done_with_dag,					\
@@ -950,6 +983,7 @@ typedef struct _sg_repo__vtable sg_repo__vtable;
 		sg_repo__##name##__fetch_blob__chunk,               \
 		sg_repo__##name##__fetch_blob__end,                 \
 		sg_repo__##name##__fetch_blob__abort,               \
+		sg_repo__##name##__fetch_blob__file_range,          \
 		sg_repo__##name##__fetch_repo__fragball,            \
 		sg_repo__##name##__check_dagfrag,					\
 		sg_repo__##name##__fetch_dagnode,				    \
@@ -973,6 +1007,7 @@ typedef struct _sg_repo__vtable sg_repo__vtable;
         sg_repo__##name##__query_implementation,            \
         sg_repo__##name##__query_blob_existence,            \
         sg_repo__##name##__rebuild_indexes,                 \
+        sg_repo__##name##__train_blob_dictionaries,         \
         sg_repo__##name##__dbndx__make_delta_from_path,                   \
         sg_repo__##name##__dbndx__query,                   \
         sg_repo__##name##__dbndx__query__prep,              \
@@ -348,6 +348,18 @@ void SG_repo__get_descriptor_name(
 	const char** ppszDescriptorName  /**< Caller must NOT free this */
 	);
 
+/**
+ * Returns a string which identifies this repo instance: its repo id
+ * plus its descriptor.  Clones of a repo share the repo id but not
+ * the descriptor, so process-wide caches use this to keep what they
+ * learned from one instance away from the others.
+ */
+void SG_repo__get_instance_key(
+	SG_context* pCtx,
+	SG_repo* pRepo,
+	const char** ppszKey  /**< Caller must NOT free this */
+	);
+
 //////////////////////////////////////////////////////////////////
 
 /**
@@ -520,6 +532,25 @@ void SG_repo__store_blob_from_memory(SG_context* pCtx,
 										 SG_uint32 lenRawData,
 										 char** ppszidHidReturned);
 
+/**
+ * Store many small blobs (dbrecords, treenodes and the like) at once.
+ * They are written back-to-back into one blob file with one write, and
+ * their index rows go into the tx with the others.  This is much cheaper
+ * than storing them one at a time, but the whole batch is held in memory,
+ * so keep batches to a few MB.
+ *
+ * apsz_hid_returned must have room for count HIDs.  The caller must free
+ * each of them.
+ */
+void SG_repo__store_blobs__batch(SG_context* pCtx,
+								 SG_repo * pRepo,
+								 SG_repo_tx_handle* pTx,
+								 SG_bool b_dont_bother,
+								 SG_uint32 count,
+								 const SG_byte* const* ap_buf,
+								 const SG_uint32* a_len,
+								 char** apsz_hid_returned);
+
 //////////////////////////////////////////////////////////////////
 
 #if 0
@@ -863,6 +894,23 @@ void SG_repo__rebuild_indexes(
     SG_repo* pRepo
     );
 
+/**
+ * Rebuild the compression dictionaries the repo uses for small JSON
+ * blobs (changesets, treenodes, dbrecords and templates), from the blobs
+ * already in the repo.  Blobs stored from then on use the new ones.
+ * Blobs stored with an older dictionary can still be read.  Only repos
+ * created with the new_repo/inline_blobs setting use dictionaries; in
+ * any other repo this does nothing and the stats are empty.
+ *
+ * If ppvh_stats is not NULL, it returns a vhash with one entry per
+ * object type describing what was trained.  The caller must free it.
+ */
+void SG_repo__train_blob_dictionaries(
+	SG_context*,
+    SG_repo* pRepo,
+    SG_vhash** ppvh_stats
+    );
+
 void SG_repo__dbndx__query_record_history(
 	SG_context*,
     SG_repo* pRepo,
@@ -1142,6 +1190,22 @@ void SG_repo__fetch_blob__abort(
     SG_repo_fetch_blob_handle** ppHandle
     );
 
+/**
+ * Where a blob's full contents can be read directly: *pLen bytes starting
+ * at *pOffset in the file *ppPath.  This is for handing the bytes to
+ * sendfile() and the like.  *ppPath is NULL if the blob isn't stored that
+ * way (it's compressed or deltified, or the repo doesn't keep blobs in
+ * files), in which case use SG_repo__fetch_blob__begin.
+ */
+void SG_repo__fetch_blob__file_range(
+	SG_context* pCtx,
+    SG_repo * pRepo,
+    const char* psz_hid_blob,
+    SG_pathname** ppPath,
+    SG_uint64* pOffset,
+    SG_uint64* pLen
+    );
+
 void SG_repo__fetch_repo__fragball(
 	SG_context* pCtx,
 	SG_repo* pRepo,
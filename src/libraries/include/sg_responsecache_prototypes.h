@@ -0,0 +1,89 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file sg_responsecache_prototypes.h
+ *
+ * @details The server's cache of rendered responses (wiki pages, burndown
+ * data, and the like), shared by all the requests in the process.
+ *
+ * An entry is identified by its ETag, which combines a hash of the repo and
+ * the request's key with the state of the dags the response was built from.
+ * We keep a change counter per repo instance and dag which SG_repo__commit_tx
+ * bumps, and by default we also hash each dag's leaves on every request, so
+ * a commit made by another process (a command-line push to the same repo,
+ * say) changes the ETag as soon as it lands.
+ *
+ * Setting server/response_cache/validate_seconds to N skips the leaf query
+ * if we made it less than N seconds ago.  Commits made in this process still
+ * show up right away, but ones made by other processes can then take up to
+ * N seconds to, and until then a browser can get a 304 for a stale page.
+ *
+ * Recently used entries stay in memory, up to server/response_cache/max_mb.
+ * Entries pushed out of memory are written to the server cache directory,
+ * unless server/response_cache/spill is 0.
+ *
+ * Until SG_responsecache__global_init() is called, SG_responsecache__dag_changed()
+ * does nothing and the rest throw.  Only the server initializes it.
+ *
+ */
+
+//////////////////////////////////////////////////////////////////
+
+#ifndef H_SG_RESPONSECACHE_PROTOTYPES_H
+#define H_SG_RESPONSECACHE_PROTOTYPES_H
+
+BEGIN_EXTERN_C;
+
+void SG_responsecache__global_init(SG_context * pCtx);
+void SG_responsecache__global_cleanup(void);
+
+/**
+ * Note that a dag has new nodes.  Cheap, and a no-op outside the server.
+ */
+void SG_responsecache__dag_changed(SG_context * pCtx, SG_repo * pRepo, SG_uint64 iDagNum);
+
+/**
+ * The ETag for a response built from the given dags of pRepo.  pszKey
+ * identifies the response within the repo (typically its normalized URL).
+ */
+void SG_responsecache__get_etag(
+	SG_context * pCtx,
+	SG_repo * pRepo,
+	const SG_uint64 * paDagNums,
+	SG_uint32 countDagNums,
+	const char * pszKey,
+	char ** ppszEtag);
+
+/**
+ * *ppstrText is NULL if nothing is cached for this ETag and key.
+ */
+void SG_responsecache__get(
+	SG_context * pCtx,
+	const char * pszEtag,
+	const char * pszKey,
+	SG_string ** ppstrText);
+
+void SG_responsecache__put(
+	SG_context * pCtx,
+	const char * pszEtag,
+	const char * pszKey,
+	const char * pszText);
+
+END_EXTERN_C;
+
+#endif //H_SG_RESPONSECACHE_PROTOTYPES_H
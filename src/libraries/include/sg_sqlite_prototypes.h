@@ -114,6 +114,7 @@ void sg_sqlite__bind_text(SG_context * pCtx, sqlite3_stmt* pStmt, SG_uint32 ndx,
 void sg_sqlite__bind_text__transient(SG_context * pCtx, sqlite3_stmt* pStmt, SG_uint32 ndx, const char* psz);
 
 void sg_sqlite__bind_blob__string(SG_context * pCtx, sqlite3_stmt* pStmt, SG_uint32 ndx, SG_string* pStr);
+void sg_sqlite__bind_blob(SG_context * pCtx, sqlite3_stmt* pStmt, SG_uint32 ndx, const SG_byte* p, SG_uint32 len);
 void sg_sqlite__bind_blob__stream(SG_context * pCtx, sqlite3_stmt* pStmt, SG_uint32 ndx, SG_uint32 lenFull);
 
 void sg_sqlite__clear_bindings(SG_context * pCtx, sqlite3_stmt* pStmt);
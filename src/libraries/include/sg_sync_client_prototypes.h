@@ -44,6 +44,18 @@ void SG_sync_client__open__local(
 	SG_sync_client** ppNew	/* < [out] Required. */
 	);
 
+/**
+ * Open a second, independent connection to the same remote that pClient
+ * talks to.  Each client has its own transport (and, for a local client,
+ * its own repo instance), so the copy can have a request in flight while
+ * the original is busy with another one.
+ */
+void SG_sync_client__open__copy(
+	SG_context* pCtx,
+	const SG_sync_client* pClient,	/* < [in]  Required. */
+	SG_sync_client** ppNew			/* < [out] Required. */
+	);
+
 void SG_sync_client__close_free(SG_context * pCtx, SG_sync_client * pClient);
 
 void SG_sync_client__push_begin(
@@ -117,12 +129,18 @@ void SG_sync_client__pull_request_fragball(
 		char** ppszFragballName
         );
 
+/**
+ * Get a clone fragball from the repo specified in pClient.  *pbStale is set if
+ * the other side says the fragball may be behind the repo (see the "topup" key
+ * of the clone request in SG_sync_remote__request_clone_fragball).
+ */
 void SG_sync_client__pull_clone(
 	SG_context* pCtx,
 	SG_sync_client* pClient,
     SG_vhash* pvh_partial,
 	const SG_pathname* pStagingPathname,
-	char** ppszFragballName);
+	char** ppszFragballName,
+	SG_bool* pbStale);
 
 void SG_sync_client__get_repo_info(
 		SG_context* pCtx,
@@ -62,6 +62,31 @@ void SG_sync__build_best_guess_dagfrag(
 	SG_vhash* pvhConnectToHidsAndGens,
 	SG_dagfrag** ppFrag);
 
+/**
+ * Summarize the recent dagnodes this repo has in a dag as a compact
+ * Bloom filter, for SG_SYNC_STATUS_KEY__HAVE.  *ppvhHaveSet is NULL
+ * if the dag is empty.
+ */
+void SG_sync__build_have_set(
+	SG_context* pCtx,
+	SG_repo* pRepo,
+	SG_uint64 iDagNum,
+	SG_vhash** ppvhHaveSet);
+
+/**
+ * Build a frag of everything reachable from prbStartFromHids that the
+ * other repo, as described by its have-set, doesn't already have.
+ * Below the have-set's floor it goes back as far as a best-guess frag
+ * would, since the filter can't say what the other repo has there.
+ */
+void SG_sync__build_dagfrag_from_have_set(
+	SG_context* pCtx,
+	SG_repo* pRepo,
+	SG_uint64 iDagNum,
+	SG_rbtree* prbStartFromHids,
+	const SG_vhash* pvhHaveSet,
+	SG_dagfrag** ppFrag);
+
 void SG_sync__add_blobs_to_fragball(SG_context* pCtx, SG_fragball_writer* pfb, SG_vhash* pvh_missing_blobs);
 
 
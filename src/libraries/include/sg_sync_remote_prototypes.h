@@ -109,6 +109,23 @@ void SG_sync_remote__request_fragball(
 	char** ppszFragballName					 /* The name of the fragball file. Caller must free. */
 	);
 
+/**
+ * Gets a clone fragball, as SG_sync_remote__request_fragball does for a clone
+ * request, from the server's cache of them if possible.  pvhCloneRequest is the
+ * request's "clone_request" vhash and can be NULL.
+ *
+ * *pbStale is set if the fragball may be behind the repo, which only happens
+ * when the request said the client will top up.  Can be NULL.
+ */
+void SG_sync_remote__request_clone_fragball(
+	SG_context* pCtx,
+	SG_repo* pRepo,
+	const SG_pathname* pFragballDirPathname,
+	const SG_vhash* pvhCloneRequest,
+	char** ppszFragballName,
+	SG_bool* pbStale
+	);
+
 void SG_sync_remote__get_repo_info(
 	SG_context* pCtx,
 	SG_repo* pRepo,
@@ -42,7 +42,12 @@ BEGIN_EXTERN_C;
 #define SG_SYNC_STATUS_KEY__BLOBS				"blobs"
 #define SG_SYNC_STATUS_KEY__NEW_NODES			"new-nodes"
 #define SG_SYNC_STATUS_KEY__LEAVES				"leaves"
+#define SG_SYNC_STATUS_KEY__HAVE				"have"
 #define SG_SYNC_STATUS_KEY__CLONE_REQUEST		"clone_request"
+#define SG_SYNC_CLONE_REQUEST_KEY__TOPUP		"topup"
+
+/* Sent with a clone fragball that may be behind the repo, so the client knows to top up. */
+#define SG_SYNC_CLONE_HEADER__STALE				"X-Veracity-Clone-Stale"
 
 #define SG_SYNC_STATUS_KEY__COUNTS				"counts"
 #define SG_SYNC_STATUS_KEY__BLOBS_REFERENCED	"blobs-referenced"
@@ -82,6 +82,150 @@ const char* SG_thread__sz(
 	char*        pBuffer  //< [in] [out] Buffer to store the converted string in.
 	);
 
+/**
+ * Start a new thread running pfnMain(pVoidData).
+ */
+void SG_thread__create(
+	SG_context*      pCtx,      //< [in] [out] Error and context info.
+	SG_thread__main* pfnMain,   //< [in] The body of the thread.
+	void*            pVoidData, //< [in] Passed to pfnMain.
+	SG_thread**      ppThread   //< [out] The new thread.  Must be given to SG_thread__join().
+	);
+
+/**
+ * Wait for a thread started with SG_thread__create() to finish
+ * and free the handle.  *ppThread is set to NULL.
+ */
+void SG_thread__join(
+	SG_context* pCtx,    //< [in] [out] Error and context info.
+	SG_thread** ppThread //< [in] [out] The thread to wait for.
+	);
+
+/**
+ * Get the number of processors that are online.
+ * This is always at least 1.
+ */
+void SG_thread__get_processor_count(
+	SG_context* pCtx,   //< [in] [out] Error and context info.
+	SG_uint32*  pCount  //< [out] The number of processors.
+	);
+
+/**
+ * Initialize a new SG_thread_cond.
+ */
+void SG_thread_cond__init(
+	SG_context*     pCtx, //< [in] [out] Error and context info.
+	SG_thread_cond* pCond //< [in] [out] The condition variable.
+	);
+
+/**
+ * Clean up an SG_thread_cond.  Nobody may be waiting on it.
+ */
+void SG_thread_cond__destroy(
+	SG_thread_cond* pCond //< [in] [out] The condition variable.
+	);
+
+/**
+ * Release pm, sleep until pCond is broadcast, and take pm again.
+ * The caller must hold pm exactly once (SG_mutex is recursive, but
+ * only one level is released while we sleep).  Wakeups can be
+ * spurious, so always wait in a loop that re-checks the condition.
+ */
+void SG_thread_cond__wait(
+	SG_context*     pCtx,  //< [in] [out] Error and context info.
+	SG_thread_cond* pCond, //< [in] The condition variable.
+	SG_mutex*       pm     //< [in] The mutex protecting the condition.
+	);
+
+/**
+ * Wake every thread waiting on pCond.  Call it after changing the
+ * condition, preferably while still holding the mutex.
+ */
+void SG_thread_cond__broadcast(
+	SG_context*     pCtx, //< [in] [out] Error and context info.
+	SG_thread_cond* pCond //< [in] The condition variable.
+	);
+
+/**
+ * Like SG_thread_cond__broadcast, for cleanup code that has no
+ * usable SG_context.  A non-zero return code is an error.
+ */
+int SG_thread_cond__broadcast__bare(
+	SG_thread_cond* pCond //< [in] The condition variable.
+	);
+
+/**
+ * The body of each worker in an SG_thread_pool.  Each worker has its
+ * own context and, if the pool was given a repo, its own instance of
+ * that repo, because neither can be shared between threads.  pRepo is
+ * NULL otherwise.  pVoidData is shared by all of the workers.
+ *
+ * Anything the workers share must be protected by the caller.  When a
+ * worker fails it should tell the others to stop; the pool only keeps
+ * track of which one failed first.
+ */
+typedef void (SG_thread_pool__work)(
+	SG_context* pCtx,
+	SG_repo*    pRepo,
+	void*       pVoidData
+	);
+
+/**
+ * Decide how many workers to start for nrJobs independent jobs when
+ * the calling thread will take its share too.  A worker isn't worth
+ * starting unless it gets at least nrMinJobsPerWorker jobs, and no more
+ * than nrMaxThreads threads (counting the caller) are used.  This is the
+ * number of *additional* threads, so it may be zero.
+ */
+void SG_thread_pool__size_for_jobs(
+	SG_context* pCtx,
+	SG_uint32   nrJobs,
+	SG_uint32   nrMinJobsPerWorker,
+	SG_uint32   nrMaxThreads,
+	SG_uint32*  pNrWorkers
+	);
+
+/**
+ * Allocate a pool of nrWorkers workers which will each run
+ * pfnWork(pCtx, pRepo, pVoidData).  Nothing runs until
+ * SG_thread_pool__start().  pRepo may be NULL.
+ */
+void SG_thread_pool__alloc(
+	SG_context*           pCtx,
+	SG_uint32             nrWorkers,
+	SG_repo*              pRepo,
+	SG_thread_pool__work* pfnWork,
+	void*                 pVoidData,
+	SG_thread_pool**      ppPool
+	);
+
+/**
+ * Start the workers.  If this fails some of them may be running; the
+ * caller should tell them to stop and then free the pool.
+ */
+void SG_thread_pool__start(
+	SG_context*     pCtx,
+	SG_thread_pool* pPool
+	);
+
+/**
+ * Wait for every worker to return.  Throws the first error that any
+ * of them hit.
+ */
+void SG_thread_pool__join(
+	SG_context*     pCtx,
+	SG_thread_pool* pPool
+	);
+
+/**
+ * Wait for any workers that are still running, ignoring their errors,
+ * and free the pool.  The caller must already have told them to stop.
+ */
+void SG_thread_pool__free(
+	SG_context*     pCtx,
+	SG_thread_pool* pPool
+	);
+
 END_EXTERN_C;
 
 #endif
@@ -52,6 +52,48 @@ SG_STATIC_ASSERT(SG_THREAD_TO_STRING_BUFFER_LENGTH >= ((sizeof(SG_thread_id) * 2
  */
 typedef char SG_thread_to_string_buffer[SG_THREAD_TO_STRING_BUFFER_LENGTH];
 
+/**
+ * A thread that we started with SG_thread__create().
+ * It must be waited for with SG_thread__join().
+ */
+typedef struct _sg_thread SG_thread;
+
+/**
+ * The body of a thread started with SG_thread__create().
+ * The thread is not given an SG_context; it should allocate
+ * its own and hand any error back to its creator in pVoidData.
+ */
+typedef void (SG_thread__main)(void * pVoidData);
+
+/**
+ * A fixed set of worker threads started by SG_thread_pool__alloc()
+ * and SG_thread_pool__start().  See the prototypes header.
+ */
+typedef struct _sg_thread_pool SG_thread_pool;
+
+/**
+ * A condition variable, used together with an SG_mutex to let a
+ * thread sleep until another one changes something it is waiting on.
+ * Like SG_mutex, it is meant to be embedded in the structure that
+ * holds the data it protects.
+ */
+typedef struct SG_thread_cond SG_thread_cond;
+
+#if defined(MAC) || defined(LINUX)
+#include <pthread.h>
+struct SG_thread_cond
+{
+	pthread_cond_t cond;
+};
+#endif
+
+#if defined(WINDOWS)
+struct SG_thread_cond
+{
+	CONDITION_VARIABLE cv;
+};
+#endif
+
 END_EXTERN_C;
 
 #endif
@@ -37,6 +37,88 @@ void SG_tncache__load(
     SG_treenode** pptn
     );
 
+//////////////////////////////////////////////////////////////////
+
+/**
+ * The process-wide treenode cache.
+ *
+ * Treenode blobs never change and they are named by their HID, so
+ * once one has been parsed, the SG_treenode can be handed to anyone
+ * else who asks the same repo instance for that HID.  That works
+ * across requests and threads.  Entries are keyed by the repo's
+ * instance key (SG_repo__get_instance_key()) as well as the HID, so
+ * a repo which doesn't have the blob never gets a hit for it.
+ * SG_treenode__load_from_repo() looks here first, so callers get
+ * this for free.  Comparing two nearby changesets, for example,
+ * only parses the directories that differ.
+ *
+ * A treenode handed out by the cache is shared.  It stays frozen
+ * (SG_treenode__unfreeze() refuses), and SG_treenode__free() only
+ * drops the caller's reference.
+ *
+ * The cache is bounded by the size of the treenode JSON it holds.
+ * The least recently used treenodes go first.  A treenode which is
+ * dropped from the cache while someone still has it lives until
+ * they free it.
+ */
+void SG_tncache__global_initialize(SG_context* pCtx);
+void SG_tncache__global_cleanup(SG_context* pCtx);
+
+/**
+ * Change the size limit, in bytes of treenode JSON.  0 turns
+ * the cache off and empties it.
+ */
+void SG_tncache__shared__set_limit(
+    SG_context* pCtx,
+    SG_uint64 cb_limit
+    );
+
+/**
+ * Look up a treenode.  *pptn is NULL on a miss.  On a hit the
+ * caller gets its own reference and must free it.
+ */
+void SG_tncache__shared__find(
+    SG_context* pCtx,
+    SG_repo* pRepo,
+    const char* psz_hid_treenode,
+    SG_treenode** pptn
+    );
+
+/**
+ * Offer a freshly loaded (frozen) treenode to the cache.  If
+ * another thread got there first, the caller's treenode is freed
+ * and *pptn is replaced with the one already in the cache.  If the
+ * cache is off or the treenode is too big, *pptn is unchanged and
+ * stays private to the caller.
+ */
+void SG_tncache__shared__add(
+    SG_context* pCtx,
+    SG_repo* pRepo,
+    const char* psz_hid_treenode,
+    SG_uint32 cb,
+    SG_treenode** pptn
+    );
+
+/**
+ * Drop a reference.  Only SG_treenode__free() should call this.
+ * *pbLast is set when nobody (including the cache) holds the
+ * treenode any more, which means the caller must really free it.
+ */
+void SG_tncache__shared__release(
+    SG_context* pCtx,
+    SG_tncache_entry* pEntry,
+    SG_bool* pbLast
+    );
+
+void SG_tncache__shared__get_stats(
+    SG_context* pCtx,
+    SG_uint32* pCount,      /**< treenodes in the cache */
+    SG_uint64* pcb,         /**< bytes of JSON they came from */
+    SG_uint64* pHits,
+    SG_uint64* pMisses,
+    SG_uint64* pEvictions
+    );
+
 END_EXTERN_C
 
 #endif
@@ -21,6 +21,12 @@ BEGIN_EXTERN_C;
 
 typedef struct _sg_tncache SG_tncache;
 
+/**
+ * A treenode's slot in the process-wide treenode cache.
+ * See SG_tncache__shared__find().
+ */
+typedef struct _sg_tncache_entry SG_tncache_entry;
+
 END_EXTERN_C;
 
 #endif//H_SG_TNCACHE_TYPEDEFS_H
@@ -179,6 +179,12 @@ void SG_treenode__is_frozen(SG_context *, const SG_treenode * pTreenode, SG_bool
  */
 void SG_treenode__unfreeze(SG_context *, SG_treenode * pTreenode);
 
+/**
+ * Mark a Treenode as shared by the process-wide treenode cache.
+ * Only sg_tncache.c should call this.
+ */
+void SG_treenode__set_cache_entry(SG_treenode * pTreenode, SG_tncache_entry * pEntry);
+
 /**
  * A frozen Treenode memory-object knows its HID.
  *
@@ -110,6 +110,26 @@ void SG_uridispatch__chunk_response_body(
 	);
 
 
+// Call this after getting the response's headers, instead of chunking out the body, to see whether
+// the body is Content-Length bytes of a file (the SSJS response's sendFile). If so, the caller may
+// send them straight from the file (ranges of it, even), then call SG_uridispatch__response_file_sent().
+// Returns SG_FALSE if the body has to be chunked out as usual.
+SG_bool SG_uridispatch__get_response_file(
+	SG_uridispatchcontext * pDispatchContext,
+
+	const char ** ppszPath, //< Caller does not own the result. Valid until the dispatch context is freed.
+	SG_uint64 * pOffset //< Where the body starts in the file.
+	);
+
+
+// Call this once a response's body has been sent from its file. Pass SG_FALSE if it couldn't all be sent.
+// Frees the dispatch context and sets it to NULL.
+void SG_uridispatch__response_file_sent(
+	SG_uridispatchcontext ** ppDispatchContext,
+	SG_bool bComplete
+	);
+
+
 // For the indecisive. A way to say "nevermind".
 void SG_uridispatch__abort(
 	SG_uridispatchcontext ** ppDispatchContext
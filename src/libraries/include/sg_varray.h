@@ -50,6 +50,25 @@ void SG_varray__alloc__shared(
         SG_varray* pva_other
         );
 
+/**
+ * Allocate a varray from an arena.  Same rules as
+ * SG_vhash__alloc__arena(): it (and anything nested in it)
+ * is released by SG_arena__free(), SG_varray__free() does
+ * nothing, and non-arena children are adopted by the arena.
+ */
+void SG_varray__alloc__arena(
+        SG_context* pCtx,
+        SG_varray** ppNew,
+        SG_uint32 initial_size,
+        SG_arena* pArena
+        );
+
+void SG_varray__get_arena(
+        SG_context* pCtx,
+        const SG_varray* pva,
+        SG_arena** ppArena
+        );
+
 void SG_varray__alloc__copy(
 	SG_context*      pCtx,
 	SG_varray**      ppNew,
@@ -66,6 +66,34 @@ void SG_vhash__alloc__params(
 					          * it. */
 	);
 
+/**
+ * Allocate a new vhash from an arena.  The vhash, its pools and
+ * anything later nested inside it (see SG_vhash__addnew__vhash()
+ * and friends) come from the arena and are released all at once by
+ * SG_arena__free().  Calling SG_vhash__free() on it does nothing.
+ *
+ * A vhash or varray which did not come from the arena but is added
+ * to this one (SG_vhash__add__vhash(), etc.) is adopted by the
+ * arena and freed when the arena is.
+ *
+ * The arena must outlive every container that references this vhash.
+ */
+void SG_vhash__alloc__arena(
+    SG_context* pCtx,
+	SG_vhash** ppNew,
+	SG_uint32 guess,
+	SG_arena* pArena
+	);
+
+/**
+ * Returns the arena a vhash was allocated from, or NULL.
+ */
+void SG_vhash__get_arena(
+    SG_context* pCtx,
+	const SG_vhash* pvh,
+	SG_arena** ppArena
+	);
+
 /**
  * Allocate a new vhash, sharing pools with the given one.
  */
@@ -33,12 +33,19 @@ void SG_zip__begin_file(SG_context* pCtx,  SG_zip* zi, const char* filename);
 void SG_zip__write(SG_context* pCtx, SG_zip* zi, const SG_byte* buf, SG_uint32 len);
 void SG_zip__end_file(SG_context* pCtx, SG_zip* file);
 
+// Raw mode: the caller deflates the data itself (raw deflate, no zlib
+// header or trailer) and tells us the CRC-32 and length of what went in.
+void SG_zip__begin_file__raw(SG_context* pCtx,  SG_zip* zi, const char* filename);
+void SG_zip__write__raw(SG_context* pCtx, SG_zip* zi, const SG_byte* buf, SG_uint32 len);
+void SG_zip__end_file__raw(SG_context* pCtx, SG_zip* file, SG_uint32 uncompressed_size, SG_uint32 crc32);
+
 //adds an empty folder to the archive
 void SG_zip__add_folder(SG_context* pCtx,  SG_zip* zi, const char* foldername);
 
 void SG_zip__nullclose (SG_context* pCtx, SG_zip** pzi);
 
 void SG_zip__store__bytes(SG_context* pCtx, SG_zip* pz, const char* filename, const SG_byte* buf, SG_uint32 len);
+void SG_zip__store__raw(SG_context* pCtx, SG_zip* pz, const char* filename, const SG_byte* buf, SG_uint32 len, SG_uint32 uncompressed_size, SG_uint32 crc32);
 void SG_zip__store__file(SG_context* pCtx, SG_zip* pz, const char* filename, const SG_pathname* pPath);
 
 END_EXTERN_C;
@@ -169,6 +169,13 @@ static int pthread_mutex_unlock(pthread_mutex_t *);
 #include <unistd.h>
 #include <dlfcn.h>
 #include <pthread.h>
+#if defined(LINUX)
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#endif
+#if defined(MAC)
+#include <sys/uio.h>
+#endif
 #define	DIRSEP			'/'
 #define	IS_DIRSEP_CHAR(c)	((c) == '/')
 #define	O_BINARY		0
@@ -183,6 +190,8 @@ typedef int SOCKET;
 
 #include "sg_mongoose.h"
 
+#include <zlib.h>
+
 #define	MAX_REQUEST_HEADERS_SIZE    8192
 #define MAX_MG_PRINTF_SIZE          8192
 #define	MAX_LISTENING_SOCKETS       10
@@ -262,7 +271,20 @@ struct socket {
 	SOCKET		sock;		/* Listening socket		*/
 	struct usa	lsa;		/* Local socket address		*/
 	struct usa	rsa;		/* Remote socket address	*/
+	int		num_requests;	/* Requests served so far	*/
+};
+
+#if defined(LINUX)
+/*
+ * An idle keep-alive connection, waiting in the master thread's epoll set
+ * for its next request so that it doesn't tie up a worker thread.
+ */
+struct parked_socket {
+	struct socket	s;
+	time_t		since;		/* When it went idle		*/
+	bool_t		in_use;
 };
+#endif
 
 /*
  * Mongoose context
@@ -286,10 +308,30 @@ struct mg_context {
 	pthread_cond_t	full_cond;	/* Socket queue full condvar	*/
 
 	SG_pathname	*static_root;	/* Location of /ui on disk. 	*/
+
+	int		keepalive_timeout;	/* Seconds, 0 disables keep-alive */
+	int		keepalive_max_requests;	/* Per connection, 0 is no limit */
+	int		keepalive_max_idle;	/* Idle connections we'll hold	*/
+
+	int		gzip_min_bytes;	/* Smallest body we gzip, 0 = never */
+	SG_pathname	*gzip_cache;	/* Gzipped copies of static files */
+
+#if defined(LINUX)
+	int		epoll_fd;	/* Listener and parked sockets	*/
+	struct parked_socket *parked;	/* keepalive_max_idle slots	*/
+#endif
 };
 #define MAX_THREADS 100
 #define IDLE_TIME    10
 
+#define KEEPALIVE_TIMEOUT       15
+#define KEEPALIVE_MAX_REQUESTS  100
+#define KEEPALIVE_MAX_IDLE      256
+
+#define GZIP_MIN_BYTES          1024
+#define GZIP_CACHE_DIR          "vv-serve-gzip"
+#define GZIP_CACHE_MAX_AGE_MS   ((SG_int64) 30 * 24 * 60 * 60 * 1000)
+
 /*
  * Client connection.
  */
@@ -301,6 +343,10 @@ struct mg_connection {
 
 	UINT64_T	num_bytes_sent;	/* Total bytes sent to client	*/
 
+	char		buf[MAX_REQUEST_HEADERS_SIZE];	/* Request(s) read so far */
+	int		nread;		/* Bytes in buf			*/
+	bool_t		keep_alive;	/* Keep the connection after this request */
+
 	SG_context* pCtx;
 };
 
@@ -350,6 +396,19 @@ mg_strcasecmp(const char *s1, const char *s2)
 	return (diff);
 }
 
+static int
+mg_strncasecmp(const char *s1, const char *s2, size_t len)
+{
+	int	diff = 0;
+
+	if (len > 0)
+		do {
+			diff = lowercase(s1++) - lowercase(s2++);
+		} while (diff == 0 && s1[-1] != '\0' && --len > 0);
+
+	return (diff);
+}
+
 /*
  * Like snprintf(), but never returns negative value, or the value
  * that is larger than a supplied buffer.
@@ -433,6 +492,91 @@ mg_get_header(const struct mg_connection *conn, const char *name)
 	return (get_header(conn->pCtx, &conn->request_info, name));
 }
 
+/*
+ * Decide whether the connection can carry another request once this one
+ * has been answered.  HTTP/1.1 connections persist unless the client says
+ * otherwise; HTTP/1.0 ones only when the client asks.
+ */
+static bool_t
+should_keep_alive(const struct mg_connection *conn)
+{
+	const struct mg_context *ctx = conn->ctx;
+	const struct mg_request_info *ri = &conn->request_info;
+	const char *hdr = mg_get_header(conn, "Connection");
+
+	if (ctx->stop_flag != 0 || ctx->keepalive_timeout <= 0)
+		return (FALSE);
+	if (ctx->keepalive_max_requests > 0 &&
+	    conn->client.num_requests >= ctx->keepalive_max_requests)
+		return (FALSE);
+	if (hdr != NULL && !mg_strcasecmp(hdr, "close"))
+		return (FALSE);
+	if (ri->http_version_major == 1 && ri->http_version_minor >= 1)
+		return (TRUE);
+	return (hdr != NULL && !mg_strcasecmp(hdr, "keep-alive"));
+}
+
+static const char *
+connection_header(const struct mg_connection *conn)
+{
+	return (conn->keep_alive ? "keep-alive" : "close");
+}
+
+/*
+ * Return True if the client's Accept-Encoding takes gzip, and it isn't
+ * turned down with "q=0".
+ */
+static bool_t
+accepts_gzip(const struct mg_connection *conn)
+{
+	const char	*hdr = mg_get_header(conn, "Accept-Encoding");
+	const char	*p, *end, *q;
+	size_t		n;
+
+	if (hdr == NULL)
+		return (FALSE);
+
+	for (p = hdr; *p != '\0'; p = (*end != '\0' ? end + 1 : end)) {
+		while (*p == ' ' || *p == '\t')
+			p++;
+		end = p + strcspn(p, ",");
+		n = strcspn(p, ";, \t");
+		if ((n == 4 && !mg_strncasecmp(p, "gzip", 4)) ||
+		    (n == 1 && *p == '*')) {
+			q = strstr(p, "q=");
+			return (q == NULL || q > end || atof(q + 2) > 0);
+		}
+	}
+
+	return (FALSE);
+}
+
+/*
+ * Return True for the content types worth compressing: text, and the
+ * structured formats we send (JSON, JavaScript, XML, SVG).
+ */
+static bool_t
+is_compressible_type(const char *type, size_t len)
+{
+	static const char * const prefixes[] = {
+		"text/",
+		"application/json",
+		"application/javascript",
+		"application/x-javascript",
+		"application/xml",
+		"image/svg+xml",
+	};
+	size_t	i, n;
+
+	for (i = 0; i < ARRAY_SIZE(prefixes); i++) {
+		n = strlen(prefixes[i]);
+		if (len >= n && !mg_strncasecmp(type, prefixes[i], n))
+			return (TRUE);
+	}
+
+	return (FALSE);
+}
+
 /*
  * Send error message back to the client.
  */
@@ -467,8 +611,9 @@ send_error(struct mg_connection *conn, int status, const char *reason,
 		    "HTTP/1.1 %d %s\r\n"
 		    "Content-Type: text/plain\r\n"
 		    "Content-Length: %d\r\n"
-		    "Connection: close\r\n"
-		    "\r\n%s", status, reason, len, buf);
+		    "Connection: %s\r\n"
+		    "\r\n%s", status, reason, len,
+		    connection_header(conn), buf);
 	}
 }
 
@@ -1128,6 +1273,314 @@ send_opened_file_stream(struct mg_connection *conn, FILE *fp, SG_uint64 len)
 	}
 }
 
+/*
+ * Send len bytes of the file, starting at offset.  Where the platform has
+ * sendfile(), the kernel copies straight from the page cache to the socket.
+ * The headers have to be out already, which they are: mg_printf() doesn't
+ * buffer.
+ */
+static void
+send_file_range(struct mg_connection *conn, FILE *fp, UINT64_T offset,
+		UINT64_T len)
+{
+#if defined(LINUX)
+	off_t	off = (off_t) offset;
+	ssize_t	n;
+
+	while (len > 0) {
+		n = sendfile(conn->client.sock, fileno(fp), &off,
+		    len > INT_MAX ? INT_MAX : (size_t) len);
+		if (n < 0 && ERRNO == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		conn->num_bytes_sent += n;
+		len -= n;
+	}
+
+	/* Some filesystems can't do it; fall back to copying */
+	if (len > 0 && off == (off_t) offset &&
+	    (ERRNO == EINVAL || ERRNO == ENOSYS)) {
+		(void) fseeko(fp, off, SEEK_SET);
+		send_opened_file_stream(conn, fp, len);
+	}
+#elif defined(MAC)
+	off_t	n;
+	int	rc;
+
+	while (len > 0) {
+		n = len > INT_MAX ? INT_MAX : (off_t) len;
+		rc = sendfile(fileno(fp), conn->client.sock, (off_t) offset,
+		    &n, NULL, 0);
+		/* Even when interrupted, n says how much went out */
+		conn->num_bytes_sent += n;
+		offset += n;
+		len -= n;
+		if (rc != 0 ? ERRNO != EINTR && ERRNO != EAGAIN : n == 0)
+			break;
+	}
+#else
+	(void) fseeko(fp, (off_t) offset, SEEK_SET);
+	send_opened_file_stream(conn, fp, len);
+#endif
+}
+
+/*
+ * Make the Etag for a file.  The gzipped copy is a different entity, so it
+ * gets its own.
+ */
+static void
+make_etag(struct mg_connection *conn, char *buf, size_t buf_len,
+		const struct mgstat *stp, bool_t gzipped)
+{
+	(void) mg_snprintf(conn, buf, buf_len, "%lx.%lx%s",
+	    (unsigned long) stp->mtime, (unsigned long) stp->size,
+	    gzipped ? "-gzip" : "");
+}
+
+static bool_t
+parse_uint64(const char **pp, UINT64_T *v)
+{
+	const char	*p = *pp;
+
+	for (*v = 0; isdigit(* (unsigned char *) p); p++) {
+		if (*v > (((UINT64_T) -1) - 9) / 10)
+			return (FALSE);
+		*v = *v * 10 + (*p - '0');
+	}
+
+	if (p == *pp)
+		return (FALSE);
+	*pp = p;
+	return (TRUE);
+}
+
+/*
+ * Work out which part of an entity of the given size the Range header asks
+ * for.  Returns 1 and sets *offset and *len for a single satisfiable range,
+ * -1 if the range can't be satisfied (the caller answers 416), and 0 if the
+ * whole entity should be sent: no Range, one we don't understand, several
+ * ranges (allowed to be ignored, and nobody we serve sends them), or an
+ * If-Range that doesn't match the current etag.  The etag is quoted.
+ */
+static int
+get_request_range(struct mg_connection *conn, const char *etag,
+		UINT64_T size, UINT64_T *offset, UINT64_T *len)
+{
+	const char	*hdr = mg_get_header(conn, "Range");
+	const char	*if_range = mg_get_header(conn, "If-Range");
+	UINT64_T	first, last;
+
+	if (hdr == NULL || strncmp(hdr, "bytes=", 6) != 0 ||
+	    strchr(hdr, ',') != NULL)
+		return (0);
+
+	/* An If-Range date never matches; a weak etag can't be used */
+	if (if_range != NULL && (etag == NULL || strcmp(if_range, etag) != 0))
+		return (0);
+
+	hdr += 6;
+	while (*hdr == ' ')
+		hdr++;
+
+	if (*hdr == '-') {
+		/* The last n bytes */
+		hdr++;
+		if (!parse_uint64(&hdr, &last))
+			return (0);
+		if (last == 0 || size == 0)
+			return (-1);
+		*len = last < size ? last : size;
+		*offset = size - *len;
+		return (1);
+	}
+
+	if (!parse_uint64(&hdr, &first) || *hdr++ != '-')
+		return (0);
+	if (*hdr == '\0' || *hdr == ' ')
+		last = size - 1;
+	else if (!parse_uint64(&hdr, &last) || last < first)
+		return (0);
+
+	if (first >= size)
+		return (-1);
+	if (last >= size)
+		last = size - 1;
+
+	*offset = first;
+	*len = last - first + 1;
+	return (1);
+}
+
+/*
+ * Gzip a static file into the cache.  We write a temporary file and
+ * rename it, so another thread never serves half of one.
+ */
+static bool_t
+compress_file(struct mg_connection *conn, const char *src, const char *dst)
+{
+	char		tmp[FILENAME_MAX];
+	unsigned char	ibuf[BUFSIZ], obuf[BUFSIZ];
+	FILE		*in = NULL, *out = NULL;
+	z_stream	zs;
+	size_t		n, have;
+	int		flush, zerr = Z_OK;
+	bool_t		zinit = FALSE, ok = FALSE;
+
+	(void) memset(&zs, 0, sizeof(zs));
+	(void) mg_snprintf(conn, tmp, sizeof(tmp), "%s.%p.tmp", dst, (void *) &zs);
+
+	if ((in = mg_fopen(src, "rb")) == NULL ||
+	    (out = mg_fopen(tmp, "wb")) == NULL)
+		goto done;
+	if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+	    Z_DEFAULT_STRATEGY) != Z_OK)
+		goto done;
+	zinit = TRUE;
+
+	do {
+		n = fread(ibuf, 1, sizeof(ibuf), in);
+		if (ferror(in))
+			goto done;
+		flush = feof(in) ? Z_FINISH : Z_NO_FLUSH;
+		zs.next_in = ibuf;
+		zs.avail_in = (uInt) n;
+		do {
+			zs.next_out = obuf;
+			zs.avail_out = sizeof(obuf);
+			if ((zerr = deflate(&zs, flush)) == Z_STREAM_ERROR)
+				goto done;
+			have = sizeof(obuf) - zs.avail_out;
+			if (fwrite(obuf, 1, have, out) != have)
+				goto done;
+		} while (zs.avail_out == 0);
+	} while (flush != Z_FINISH);
+
+	ok = (zerr == Z_STREAM_END);
+
+done:
+	if (zinit)
+		(void) deflateEnd(&zs);
+	if (in != NULL)
+		(void) fclose(in);
+	if (out != NULL && fclose(out) != 0)
+		ok = FALSE;
+
+	/* If the rename fails, a racing thread probably got there first */
+	if (!ok || rename(tmp, dst) != 0)
+		(void) remove(tmp);
+	if (!ok)
+		cry(conn->pCtx, "%s(%s): could not write %s", __func__, src, dst);
+
+	return (ok);
+}
+
+/*
+ * What sweep_gzip_cache() removes: with a prefix, the other copies of one
+ * file (made before it was edited); without one, leftover temp files and
+ * copies made before the cutoff, which covers files that have since been
+ * deleted.  A copy that's still wanted is just made again.
+ */
+struct gzip_sweep {
+	const SG_pathname	*dir;
+	const char		*prefix;
+	const char		*keep;
+	SG_int64		cutoff_ms;
+};
+
+static void
+sweep_gzip_cache_cb(SG_context *pCtx, const SG_string *pStringEntryName,
+		SG_fsobj_stat *pfsStat, void *pVoidData)
+{
+	const struct gzip_sweep	*sw = (const struct gzip_sweep *) pVoidData;
+	const char		*name = SG_string__sz(pStringEntryName);
+	size_t			len = strlen(name);
+	SG_pathname		*pPath = NULL;
+	bool_t			doomed;
+
+	if (pfsStat->type != SG_FSOBJ_TYPE__REGULAR)
+		return;
+
+	if (sw->prefix != NULL)
+		doomed = !strncmp(name, sw->prefix, strlen(sw->prefix)) &&
+		    strcmp(name, sw->keep) != 0 &&
+		    len > 3 && !strcmp(name + len - 3, ".gz");
+	else
+		doomed = (len > 4 && !strcmp(name + len - 4, ".tmp")) ||
+		    pfsStat->mtime_ms < sw->cutoff_ms;
+
+	if (!doomed)
+		return;
+
+	/* Another thread may have it open; it'll be fine, or we'll get it next time */
+	SG_ERR_IGNORE(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPath, sw->dir, name)  );
+	if (pPath != NULL)
+		SG_ERR_IGNORE(  SG_fsobj__remove__pathname(pCtx, pPath)  );
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+}
+
+static void
+sweep_gzip_cache(SG_context *pCtx, const struct gzip_sweep *sw)
+{
+	SG_ERR_IGNORE(  SG_dir__foreach(pCtx, sw->dir,
+	    SG_DIR__FOREACH__STAT | SG_DIR__FOREACH__SKIP_OS,
+	    sweep_gzip_cache_cb, (void *) sw)  );
+}
+
+/*
+ * Find a gzipped copy of a static file, if the client takes gzip and the
+ * file is big enough to bother: either a ".gz" file shipped next to it,
+ * or one in the cache directory, which we make the first time it's asked
+ * for.  The cached copy's name includes the original's Etag, so an
+ * edited file gets a fresh one, and the stale one is thrown away.
+ */
+static bool_t
+find_gzip_variant(struct mg_connection *conn, const char *path,
+		const struct mgstat *stp, char *gz_path, size_t gz_path_len,
+		struct mgstat *gz_st)
+{
+	struct mg_context	*ctx = conn->ctx;
+	struct gzip_sweep	sw;
+	char			etag[64], prefix[32];
+	UINT64_T		hash = 5381;
+	const char		*p;
+
+	if (stp->size < (UINT64_T) ctx->gzip_min_bytes ||
+	    mg_get_header(conn, "Range") != NULL || !accepts_gzip(conn))
+		return (FALSE);
+
+	(void) mg_snprintf(conn, gz_path, gz_path_len, "%s.gz", path);
+	if (mg_stat(gz_path, gz_st) == 0 && !gz_st->is_directory &&
+	    gz_st->mtime >= stp->mtime)
+		return (TRUE);
+
+	if (ctx->gzip_cache == NULL)
+		return (FALSE);
+
+	/* djb2 of the path, to keep the cache directory flat */
+	for (p = path; *p != '\0'; p++)
+		hash = hash * 33 + (unsigned char) *p;
+	make_etag(conn, etag, sizeof(etag), stp, FALSE);
+	(void) mg_snprintf(conn, prefix, sizeof(prefix),
+	    "%" UINT64_FMT "x-", hash);
+	(void) mg_snprintf(conn, gz_path, gz_path_len, "%s%c%s%s.gz",
+	    SG_pathname__sz(ctx->gzip_cache), DIRSEP, prefix, etag);
+
+	if (mg_stat(gz_path, gz_st) != 0) {
+		if (!compress_file(conn, path, gz_path) ||
+		    mg_stat(gz_path, gz_st) != 0)
+			return (FALSE);
+
+		sw.dir = ctx->gzip_cache;
+		sw.prefix = prefix;
+		sw.keep = strrchr(gz_path, DIRSEP) + 1;
+		sw.cutoff_ms = 0;
+		sweep_gzip_cache(conn->pCtx, &sw);
+	}
+
+	return (gz_st->size < stp->size);
+}
+
 /*
  * Send regular file contents.
  */
@@ -1135,63 +1588,90 @@ send_opened_file_stream(struct mg_connection *conn, FILE *fp, SG_uint64 len)
 static void
 send_file(struct mg_connection *conn, const char *path, struct mgstat *stp)
 {
-	char		date[64], lm[64], etag[64], range[64];
-	const char	*fmt = "%a, %d %b %Y %H:%M:%S %Z", *msg = "OK", *hdr;
+	char		date[64], lm[64], etag[64], quoted[68], range[96];
+	char		gz_path[FILENAME_MAX];
+	const char	*fmt = "%a, %d %b %Y %H:%M:%S %Z", *msg = "OK";
 	time_t		curtime = time(NULL);
-	UINT64_T	cl, r1, r2;
+	UINT64_T	cl, offset;
 	struct vec	mime_vec;
+	struct mgstat	gz_st;
+	bool_t		compressible, gzipped;
 	FILE		*fp;
 	int		n;
 
 	get_mime_type(path, &mime_vec);
-	cl = stp->size;
+	compressible = conn->ctx->gzip_min_bytes > 0 &&
+	    is_compressible_type(mime_vec.ptr, mime_vec.len);
+	gzipped = compressible && find_gzip_variant(conn, path, stp,
+	    gz_path, sizeof(gz_path), &gz_st);
+	cl = gzipped ? gz_st.size : stp->size;
 	conn->request_info.status_code = 200;
 	range[0] = '\0';
 
-	if ((fp = mg_fopen(path, "rb")) == NULL) {
+	/* Another thread may have swept the cached copy since we found it */
+	if (gzipped && (fp = mg_fopen(gz_path, "rb")) == NULL) {
+		gzipped = FALSE;
+		cl = stp->size;
+	}
+	if (!gzipped && (fp = mg_fopen(path, "rb")) == NULL) {
 		send_error(conn, 500, http_500_error,
 		    "fopen(%s): %s", path, strerror(ERRNO));
 		return;
 	}
 	set_close_on_exec(fileno(fp));
 
+	/* Prepare Etag, Date, Last-Modified headers */
+	(void) strftime(date, sizeof(date), fmt, localtime(&curtime));
+	(void) strftime(lm, sizeof(lm), fmt, localtime(&stp->mtime));
+	make_etag(conn, etag, sizeof(etag), stp, gzipped);
+	(void) mg_snprintf(conn, quoted, sizeof(quoted), "\"%s\"", etag);
+
 	/* If Range: header specified, act accordingly */
-	r1 = r2 = 0;
-	hdr = mg_get_header(conn, "Range");
-	if (hdr != NULL && (n = sscanf(hdr,
-	    "bytes=%" UINT64_FMT "u-%" UINT64_FMT "u", &r1, &r2)) > 0) {
+	offset = 0;
+	n = gzipped ? 0 : get_request_range(conn, quoted, cl, &offset, &cl);
+	if (n < 0) {
+		(void) fclose(fp);
+		conn->request_info.status_code = 416;
+		(void) mg_printf(conn,
+		    "HTTP/1.1 416 Requested Range Not Satisfiable\r\n"
+		    "Content-Range: bytes */%" UINT64_FMT "u\r\n"
+		    "Content-Length: 0\r\n"
+		    "Connection: %s\r\n\r\n",
+		    stp->size, connection_header(conn));
+		return;
+	} else if (n > 0) {
 		conn->request_info.status_code = 206;
-		(void) fseeko(fp, (off_t) r1, SEEK_SET);
-		cl = n == 2 ? r2 - r1 + 1: cl - r1;
 		(void) mg_snprintf(conn, range, sizeof(range),
 		    "Content-Range: bytes "
 		    "%" UINT64_FMT "u-%"
 		    UINT64_FMT "u/%" UINT64_FMT "u\r\n",
-		    r1, r1 + cl - 1, stp->size);
+		    offset, offset + cl - 1, stp->size);
 		msg = "Partial Content";
 	}
 
-	/* Prepare Etag, Date, Last-Modified headers */
-	(void) strftime(date, sizeof(date), fmt, localtime(&curtime));
-	(void) strftime(lm, sizeof(lm), fmt, localtime(&stp->mtime));
-	(void) mg_snprintf(conn, etag, sizeof(etag), "%lx.%lx",
-	    (unsigned long) stp->mtime, (unsigned long) stp->size);
-
 	(void) mg_printf(conn,
 	    "HTTP/1.1 %d %s\r\n"
 	    "Date: %s\r\n"
 	    "Last-Modified: %s\r\n"
-	    "Etag: \"%s\"\r\n"
+	    "Etag: %s\r\n"
 	    "Content-Type: %.*s\r\n"
 	    "Content-Length: %" UINT64_FMT "u\r\n"
-	    "Connection: close\r\n"
+	    "%s%s"
+	    "Connection: %s\r\n"
 	    "Accept-Ranges: bytes\r\n"
 	    "%s\r\n",
-	    conn->request_info.status_code, msg, date, lm, etag,
-	    mime_vec.len, mime_vec.ptr, cl, range);
-
-	if (strcmp(conn->request_info.request_method, "HEAD") != 0)
-		send_opened_file_stream(conn, fp, cl);
+	    conn->request_info.status_code, msg, date, lm, quoted,
+	    mime_vec.len, mime_vec.ptr, cl,
+	    gzipped ? "Content-Encoding: gzip\r\n" : "",
+	    compressible ? "Vary: Accept-Encoding\r\n" : "",
+	    connection_header(conn), range);
+
+	if (strcmp(conn->request_info.request_method, "HEAD") != 0) {
+		send_file_range(conn, fp, offset, cl);
+		/* A short body leaves the client waiting for the rest */
+		if (conn->num_bytes_sent < cl)
+			conn->keep_alive = FALSE;
+	}
 	(void) fclose(fp);
 }
 
@@ -1279,20 +1759,171 @@ read_request(FILE *fp, SOCKET sock, char *buf, int bufsiz, int *nread)
 }
 
 /*
- * Return True if we should reply 304 Not Modified.
+ * Return True if we should reply 304 Not Modified.  If-None-Match wins
+ * over If-Modified-Since; either of the file's Etags will do.
  */
 static bool_t
-is_not_modified(const struct mg_connection *conn, const struct mgstat *stp)
+is_not_modified(struct mg_connection *conn, const struct mgstat *stp)
 {
+	const char *inm = mg_get_header(conn, "If-None-Match");
 	const char *ims = mg_get_header(conn, "If-Modified-Since");
 	time_t calcTime = 0;
 
+	if (inm != NULL) {
+		char etag[64], quoted[68];
+
+		if (strchr(inm, '*') != NULL)
+			return (TRUE);
+		make_etag(conn, etag, sizeof(etag), stp, FALSE);
+		(void) mg_snprintf(conn, quoted, sizeof(quoted), "\"%s\"", etag);
+		if (strstr(inm, quoted) != NULL)
+			return (TRUE);
+		make_etag(conn, etag, sizeof(etag), stp, TRUE);
+		(void) mg_snprintf(conn, quoted, sizeof(quoted), "\"%s\"", etag);
+		return (strstr(inm, quoted) != NULL);
+	}
+
 	if (ims != NULL)
 		calcTime = date_to_epoch(ims);
 
 	return (ims != NULL && stp->mtime <= calcTime);
 }
 
+/*
+ * Decide whether a dynamic response is one we'd gzip for a client that
+ * takes it.  If so, the response varies by Accept-Encoding whether or not
+ * this client gets it gzipped.
+ */
+static bool_t
+is_compressible_response(struct mg_connection *conn, const char *szStatusCode,
+		SG_uint64 contentLength, const SG_vhash *pResponseHeaders)
+{
+	SG_context *pCtx = conn->pCtx;
+	const char *szContentType = "text/plain";
+	const char *szContentEncoding = NULL;
+
+	if (conn->ctx->gzip_min_bytes <= 0 ||
+	    contentLength < (SG_uint64) conn->ctx->gzip_min_bytes)
+		return (FALSE);
+	if (szStatusCode[0] == '1' || !strncmp(szStatusCode, "204", 3) ||
+	    !strncmp(szStatusCode, "304", 3))
+		return (FALSE);
+
+	if (pResponseHeaders != NULL) {
+		szContentType = NULL;
+		SG_ERR_IGNORE(  SG_vhash__check__sz(pCtx, pResponseHeaders, "Content-Type", &szContentType)  );
+		SG_ERR_IGNORE(  SG_vhash__check__sz(pCtx, pResponseHeaders, "Content-Encoding", &szContentEncoding)  );
+	}
+
+	return (szContentType != NULL && szContentEncoding == NULL &&
+	    is_compressible_type(szContentType, strlen(szContentType)));
+}
+
+/*
+ * Decide whether to gzip a compressible dynamic response.  Only for
+ * HTTP/1.1 clients, because we don't know the compressed length up front
+ * and have to send the body chunked.
+ */
+static bool_t
+should_gzip_response(struct mg_connection *conn)
+{
+	const struct mg_request_info *ri = &conn->request_info;
+
+	return (ri->http_version_major == 1 && ri->http_version_minor >= 1 &&
+	    strcmp(ri->request_method, "HEAD") != 0 && accepts_gzip(conn));
+}
+
+/*
+ * Send a dynamic response's ETag.  The gzipped body is a different entity
+ * from the one the handler tagged, so it gets the same "-gzip" suffix that
+ * make_etag() gives static files.
+ */
+static void
+print_etag_header(struct mg_connection *conn, const char *name,
+		const char *value, bool_t gzipped)
+{
+	size_t len = strlen(value);
+
+	if (gzipped && len > 0 && value[len - 1] == '"')
+		(void) mg_printf(conn, "%s: %.*s-gzip\"\r\n", name, (int) (len - 1), value);
+	else
+		(void) mg_printf(conn, "%s: %s\r\n", name, value);
+}
+
+/*
+ * Handlers compare If-None-Match against the ETag they'd send, which never
+ * has the "-gzip" suffix, so take it off before they see the header.
+ */
+static void
+strip_gzip_etags(SG_context *pCtx, SG_vhash *pHeaders)
+{
+	const char	*inm = NULL;
+	char		*buf = NULL;
+	const char	*p;
+	char		*q;
+
+	if (pHeaders == NULL)
+		return;
+	SG_ERR_IGNORE(  SG_vhash__check__sz(pCtx, pHeaders, "If-None-Match", &inm)  );
+	if (inm == NULL || strstr(inm, "-gzip\"") == NULL)
+		return;
+
+	SG_ERR_IGNORE(  SG_allocN(pCtx, (SG_uint32) strlen(inm) + 1, buf)  );
+	if (buf == NULL)
+		return;
+	for (p = inm, q = buf; *p != '\0'; ) {
+		if (!strncmp(p, "-gzip\"", 6))
+			p += 5;
+		else
+			*q++ = *p++;
+	}
+	*q = '\0';
+
+	SG_ERR_IGNORE(  SG_vhash__update__string__sz(pCtx, pHeaders, "If-None-Match", buf)  );
+	SG_NULLFREE(pCtx, buf);
+}
+
+/*
+ * Send one chunk of a chunked response body.
+ */
+static int
+write_chunk(struct mg_connection *conn, const void *buf, int len)
+{
+	int	n;
+
+	(void) mg_printf(conn, "%x\r\n", len);
+	n = mg_write(conn, buf, len);
+	(void) mg_write(conn, "\r\n", 2);
+
+	return (n);
+}
+
+/*
+ * Compress part of a response body and send whatever zlib has ready.
+ * With Z_FINISH this ends the gzip stream.
+ */
+static bool_t
+gzip_chunk(struct mg_connection *conn, z_stream *zs,
+		const SG_byte *buf, SG_uint32 len, int flush)
+{
+	unsigned char	out[16 * 1024];
+	int		have;
+
+	zs->next_in = (Bytef *) buf;
+	zs->avail_in = len;
+	do {
+		zs->next_out = out;
+		zs->avail_out = sizeof(out);
+		if (deflate(zs, flush) == Z_STREAM_ERROR)
+			return (FALSE);
+		have = (int) (sizeof(out) - zs->avail_out);
+		if (have > 0 && write_chunk(conn, out, have) != have)
+			return (FALSE);
+	} while (zs->avail_out == 0);
+
+	return (TRUE);
+}
+
 static void
 mg_dispatch(struct mg_connection *conn)
 {
@@ -1302,10 +1933,22 @@ mg_dispatch(struct mg_connection *conn)
 
 	const char * szResponseStatusCode = "500 Internal Server Error";
 	SG_uint64 responseContentLength = 0;
+	SG_uint64 responseBytesSent = 0;
 	SG_vhash * pResponseHeaders = NULL;
+	bool_t bVary = FALSE;
+	bool_t bGzip = FALSE;
+	bool_t bGzipOk = TRUE;
+	z_stream zs;
+	const char * szResponseFile = NULL;
+	SG_uint64 responseFileOffset = 0;
+	FILE * fp = NULL;
+	char range[96];
+	int rangeResult = 0;
 
 	SG_httprequestprofiler__start_request();
 
+	strip_gzip_etags(pCtx, ri->headers);
+
 	pDispatchContext = SG_uridispatch__begin_request(conn->pCtx,
 		ri->request_method,
 		ri->uri,
@@ -1333,6 +1976,7 @@ mg_dispatch(struct mg_connection *conn)
 			SG_httprequestprofiler__stop();
 
 			if (nread<=0) {
+				conn->keep_alive = FALSE;
 				send_error(conn, 577, http_500_error, "%s", "Error handling body data");
 				SG_uridispatch__abort(&pDispatchContext);
 				SG_ERR_IGNORE(  SG_log__report_warning(pCtx, "Failed to fetch data from the client. Perhaps they closed the connection.")  );
@@ -1345,6 +1989,57 @@ mg_dispatch(struct mg_connection *conn)
 		}
 	}
 
+	// A response that doesn't wait for the whole body leaves the rest of it
+	// in the way of the next request.
+	if (ri->num_bytes_received < ri->post_data_len)
+		conn->keep_alive = FALSE;
+
+	// A body that's just part of a file goes out with sendfile(), so it
+	// isn't gzipped, but it can be asked for a range at a time.
+	range[0] = '\0';
+	if (SG_uridispatch__get_response_file(pDispatchContext, &szResponseFile, &responseFileOffset)) {
+		if ((fp = mg_fopen(szResponseFile, "rb")) == NULL) {
+			send_error(conn, 500, http_500_error, "fopen(%s): %s", szResponseFile, strerror(ERRNO));
+			SG_VHASH_NULLFREE(pCtx, pResponseHeaders);
+			SG_uridispatch__response_file_sent(&pDispatchContext, SG_FALSE);
+			SG_httprequestprofiler__stop_request();
+			return;
+		}
+		set_close_on_exec(fileno(fp));
+
+		if (strncmp(szResponseStatusCode, "200", 3) == 0) {
+			const char * szEtag = NULL;
+			UINT64_T rangeOffset = 0, rangeLength = 0;
+
+			if (pResponseHeaders != NULL) {
+				SG_ERR_IGNORE(  SG_vhash__check__sz(pCtx, pResponseHeaders, "ETag", &szEtag)  );
+				if (szEtag != NULL && strncmp(szEtag, "W/", 2) == 0)
+					szEtag = NULL;
+			}
+
+			rangeResult = get_request_range(conn, szEtag, responseContentLength, &rangeOffset, &rangeLength);
+			if (rangeResult < 0) {
+				szResponseStatusCode = "416 Requested Range Not Satisfiable";
+				(void) mg_snprintf(conn, range, sizeof(range), "Content-Range: bytes */%" UINT64_FMT "u\r\n", responseContentLength);
+				responseContentLength = 0;
+			} else if (rangeResult > 0) {
+				szResponseStatusCode = "206 Partial Content";
+				(void) mg_snprintf(conn, range, sizeof(range),
+				    "Content-Range: bytes %" UINT64_FMT "u-%" UINT64_FMT "u/%" UINT64_FMT "u\r\n",
+				    rangeOffset, rangeOffset + rangeLength - 1, responseContentLength);
+				responseFileOffset += rangeOffset;
+				responseContentLength = rangeLength;
+			}
+		}
+	}
+
+	bVary = (fp == NULL) && is_compressible_response(conn, szResponseStatusCode, responseContentLength, pResponseHeaders);
+	bGzip = bVary && should_gzip_response(conn);
+	if (bGzip) {
+		(void) memset(&zs, 0, sizeof(zs));
+		bGzip = (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+	}
+
 	// Send the response's headers.
 	{
 		SG_int_to_string_buffer tmp;
@@ -1352,7 +2047,15 @@ mg_dispatch(struct mg_connection *conn)
 		SG_httprequestprofiler__start(SG_HTTPREQUESTPROFILER_CATEGORY__TRANSFER);
 
 		mg_printf(conn, "HTTP/1.1 %s\r\n", szResponseStatusCode);
-		mg_printf(conn, "Content-Length: %s\r\n", SG_uint64_to_sz(responseContentLength, tmp));
+		if (bGzip)
+			mg_printf(conn, "Transfer-Encoding: chunked\r\nContent-Encoding: gzip\r\n");
+		else
+			mg_printf(conn, "Content-Length: %s\r\n", SG_uint64_to_sz(responseContentLength, tmp));
+		if (bVary)
+			mg_printf(conn, "Vary: Accept-Encoding\r\n");
+		mg_printf(conn, "Connection: %s\r\n", connection_header(conn));
+		if (fp != NULL)
+			mg_printf(conn, "Accept-Ranges: bytes\r\n%s", range);
 
 		if (pResponseHeaders!=NULL)
 		{
@@ -1393,6 +2096,8 @@ mg_dispatch(struct mg_connection *conn)
 							SG_ERR_IGNORE(  SG_log__report_warning(pCtx, "Skipped a value for HTTP header \"%s\". Unsupported variant type.", szName)  );
 					}
 				}
+				else if (pValue->type == SG_VARIANT_TYPE_SZ && !mg_strcasecmp(szName, "ETag"))
+					print_etag_header(conn, szName, pValue->v.val_sz, bGzip);
 				else if (pValue->type == SG_VARIANT_TYPE_SZ)
 					mg_printf(conn, "%s: %s\r\n", szName, pValue->v.val_sz);
 				else if (pValue->type == SG_VARIANT_TYPE_INT64)
@@ -1415,6 +2120,21 @@ mg_dispatch(struct mg_connection *conn)
 	}
 
 	// Send the response's message body (if applicable).
+	if (fp != NULL) {
+		UINT64_T before = conn->num_bytes_sent;
+
+		if (strcmp(ri->request_method, "HEAD") != 0 && responseContentLength > 0) {
+			SG_httprequestprofiler__start(SG_HTTPREQUESTPROFILER_CATEGORY__TRANSFER);
+			send_file_range(conn, fp, responseFileOffset, responseContentLength);
+			SG_httprequestprofiler__stop();
+		}
+		responseBytesSent = conn->num_bytes_sent - before;
+		(void) fclose(fp);
+
+		SG_uridispatch__response_file_sent(&pDispatchContext,
+			responseBytesSent >= responseContentLength || strcmp(ri->request_method, "HEAD") == 0);
+	}
+	else
 	{
 		const SG_byte * pResponseBuffer = NULL;
 		SG_uint32 responseBufferLength = 0;
@@ -1427,11 +2147,31 @@ mg_dispatch(struct mg_connection *conn)
 				&responseBufferLength);
 			if (responseBufferLength>0) {
 				SG_httprequestprofiler__start(SG_HTTPREQUESTPROFILER_CATEGORY__TRANSFER);
-				mg_write(conn, pResponseBuffer, responseBufferLength);
+				if (!bGzip)
+					mg_write(conn, pResponseBuffer, responseBufferLength);
+				else if (bGzipOk)
+					bGzipOk = gzip_chunk(conn, &zs, pResponseBuffer, responseBufferLength, Z_NO_FLUSH);
+				responseBytesSent += responseBufferLength;
 				SG_httprequestprofiler__stop();
 			}
 		}
 	}
+
+	// If the response came up short, the client can only tell once we
+	// close the connection.  A gzipped one is left without its final chunk.
+	if (responseBytesSent < responseContentLength && strcmp(ri->request_method, "HEAD") != 0)
+		conn->keep_alive = FALSE;
+
+	if (bGzip) {
+		SG_httprequestprofiler__start(SG_HTTPREQUESTPROFILER_CATEGORY__TRANSFER);
+		if (bGzipOk && responseBytesSent >= responseContentLength &&
+		    gzip_chunk(conn, &zs, NULL, 0, Z_FINISH))
+			mg_write(conn, "0\r\n\r\n", 5);
+		else
+			conn->keep_alive = FALSE;
+		SG_httprequestprofiler__stop();
+		(void) deflateEnd(&zs);
+	}
 	
 	SG_httprequestprofiler__stop_request();
 }
@@ -1457,6 +2197,10 @@ analyze_request(struct mg_connection *conn)
 	remove_double_dots_and_double_slashes(uri);
 	is_static = convert_uri_to_file_name(conn, uri, path, sizeof(path));
 
+	/* Static files ignore any body; we can't skip what we haven't read */
+	if (is_static && ri->num_bytes_received < ri->post_data_len)
+		conn->keep_alive = FALSE;
+
 	if (!is_static) {
 		SG_bool content_length_specified = SG_FALSE;
 		const char * expect = NULL;
@@ -1467,9 +2211,11 @@ analyze_request(struct mg_connection *conn)
 
 		if (strcmp(ri->request_method,"POST")==0 || strcmp(ri->request_method,"PUT")==0) {
 			if (!content_length_specified) {
+				conn->keep_alive = FALSE;
 				send_error(conn, 411, "Length Required", "");
 				errorSent = TRUE;
 			} else if (expect != NULL && mg_strcasecmp(expect, "100-continue")) {
+				conn->keep_alive = FALSE;
 				send_error(conn, 417, "Expectation Failed", "");
 				errorSent = TRUE;
 			}
@@ -1487,9 +2233,12 @@ analyze_request(struct mg_connection *conn)
 	} else if (mg_stat(path, &st) != 0) {
 		send_error(conn, 404, "Not Found", "%s", "File not found");
 	} else if (st.is_directory && uri[strlen(uri) - 1] != '/') {
+		conn->request_info.status_code = 301;
 		(void) mg_printf(conn,
 		    "HTTP/1.1 301 Moved Permanently\r\n"
-		    "Location: %s/\r\n\r\n", uri);
+		    "Location: %s/\r\n"
+		    "Content-Length: 0\r\n"
+		    "Connection: %s\r\n\r\n", uri, connection_header(conn));
 	} else if (st.is_directory) {
 		send_error(conn, 403, "Forbidden", "Directory listing denied");
 	} else if (is_not_modified(conn, &st)) {
@@ -1558,6 +2307,91 @@ add_to_set(SOCKET fd, fd_set *set, int *max_fd)
 		*max_fd = (int) fd;
 }
 
+#if defined(LINUX)
+/*
+ * Hand an idle keep-alive connection to the master thread, which watches
+ * it with epoll and queues it again when the next request arrives.
+ * Returns FALSE when there's no room, in which case the caller closes it.
+ */
+static bool_t
+park_socket(struct mg_context *ctx, const struct socket *sp)
+{
+	struct epoll_event	ev;
+	int			i;
+	bool_t			parked = FALSE;
+
+	(void) pthread_mutex_lock(&ctx->thr_mutex);
+	if (ctx->stop_flag == 0) {
+		for (i = 0; i < ctx->keepalive_max_idle; i++) {
+			if (!ctx->parked[i].in_use)
+				break;
+		}
+
+		if (i < ctx->keepalive_max_idle) {
+			ctx->parked[i].s = *sp;
+			ctx->parked[i].since = time(NULL);
+
+			/* Slot numbers are offset by one; 0 is the listener */
+			(void) memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+			ev.data.u32 = (SG_uint32) i + 1;
+			if (epoll_ctl(ctx->epoll_fd, EPOLL_CTL_ADD, sp->sock, &ev) == 0) {
+				ctx->parked[i].in_use = TRUE;
+				parked = TRUE;
+			}
+		}
+	}
+	(void) pthread_mutex_unlock(&ctx->thr_mutex);
+
+	return (parked);
+}
+
+/*
+ * Take a parked connection back out of the epoll set.  Returns FALSE if
+ * it has already been expired.
+ */
+static bool_t
+unpark_socket(struct mg_context *ctx, int slot, struct socket *sp)
+{
+	bool_t	found = FALSE;
+
+	(void) pthread_mutex_lock(&ctx->thr_mutex);
+	if (slot >= 0 && slot < ctx->keepalive_max_idle && ctx->parked[slot].in_use) {
+		*sp = ctx->parked[slot].s;
+		(void) epoll_ctl(ctx->epoll_fd, EPOLL_CTL_DEL, sp->sock, NULL);
+		ctx->parked[slot].in_use = FALSE;
+		found = TRUE;
+	}
+	(void) pthread_mutex_unlock(&ctx->thr_mutex);
+
+	return (found);
+}
+
+/*
+ * Close parked connections that have been idle too long, or all of them
+ * when bAll is set.
+ */
+static void
+expire_parked_sockets(struct mg_context *ctx, bool_t bAll)
+{
+	time_t	now = time(NULL);
+	int	i;
+
+	(void) pthread_mutex_lock(&ctx->thr_mutex);
+	for (i = 0; i < ctx->keepalive_max_idle; i++) {
+		struct parked_socket *ps = &ctx->parked[i];
+
+		if (ps->in_use &&
+		    (bAll || now - ps->since >= ctx->keepalive_timeout)) {
+			(void) epoll_ctl(ctx->epoll_fd, EPOLL_CTL_DEL, ps->s.sock, NULL);
+			(void) closesocket(ps->s.sock);
+			ps->in_use = FALSE;
+		}
+	}
+	(void) pthread_mutex_unlock(&ctx->thr_mutex);
+}
+#endif
+
 /*
  * Deallocate mongoose context, free up the resources
  */
@@ -1582,6 +2416,15 @@ mg_fini(struct mg_context *ctx)
 #endif
 	(void) pthread_mutex_unlock(&ctx->thr_mutex);
 
+#if defined(LINUX)
+	/* The workers are gone, so nothing else can park a connection */
+	if (ctx->parked != NULL)
+		expire_parked_sockets(ctx, TRUE);
+	if (ctx->epoll_fd != -1)
+		(void) close(ctx->epoll_fd);
+	ctx->epoll_fd = -1;
+#endif
+
 	/* Close log files */
 	if (ctx->access_log)
 		(void) fclose(ctx->access_log);
@@ -1684,27 +2527,33 @@ shift_to_next(struct mg_connection *conn, char *buf, int req_len, int *nread)
 	(void) memmove(buf, buf + req_len + body_len, *nread);
 }
 
+/*
+ * Read, answer and log one request.  Anything the client pipelined behind
+ * it is left in conn->buf for the next call.
+ */
 static void
 process_new_connection(struct mg_connection *conn)
 {
 	struct mg_request_info *ri = &conn->request_info;
-	char	buf[MAX_REQUEST_HEADERS_SIZE];
-	int	request_len, nread;
+	char	*buf = conn->buf;
+	int	request_len;
+	SG_bool	cl_specified = SG_FALSE;
 
-	nread = 0;
 	reset_connection_attributes(conn);
+	conn->keep_alive = FALSE;
 
 	/* If next request is not pipelined, read it in */
-	if ((request_len = get_request_len(buf, (size_t) nread)) == 0)
+	if ((request_len = get_request_len(buf, (size_t) conn->nread)) == 0)
 		request_len = read_request(NULL, conn->client.sock,
-		    buf, sizeof(buf), &nread);
-	assert(nread >= request_len);
+		    buf, sizeof(conn->buf), &conn->nread);
+	assert(conn->nread >= request_len);
 
 	if (request_len <= 0)
 		return;	/* Remote end closed the connection */
 
 	/* 0-terminate the request: parse_request uses sscanf */
 	buf[request_len - 1] = '\0';
+	conn->client.num_requests++;
 
 	if (parse_http_request(conn->pCtx, buf, ri, &conn->client.rsa)) {
 		if (ri->http_version_major != 1 ||
@@ -1716,25 +2565,85 @@ process_new_connection(struct mg_connection *conn)
 			    "%s", "Weird HTTP version");
 			log_access(conn);
 		} else {
-			ri->num_bytes_received = nread - request_len;
+			/* Only the body's own bytes; the rest is the next request */
+			get_content_length(conn, &ri->post_data_len, &cl_specified);
+			ri->num_bytes_received = SG_MIN((SG_uint64)(conn->nread - request_len), ri->post_data_len);
 			if(ri->num_bytes_received>0)
 				ri->post_data = buf + request_len;
 			else
 				ri->post_data = NULL;
+			conn->keep_alive = should_keep_alive(conn);
 			conn->birth_time = time(NULL);
 			analyze_request(conn);
+			if (ri->num_bytes_received < ri->post_data_len)
+				conn->keep_alive = FALSE;
 			log_access(conn);
-			shift_to_next(conn, buf, request_len, &nread);
+			shift_to_next(conn, buf, request_len, &conn->nread);
 		}
 	} else {
 		/* Do not put garbage in the access log */
 		send_error(conn, 400, "Bad Request",
-		    "Can not parse request: [%.*s]", nread, buf);
+		    "Can not parse request: [%.*s]", conn->nread, buf);
 	}
 	
 	SG_VHASH_NULLFREE(conn->pCtx, ri->headers);
 }
 
+/*
+ * Called between requests on a keep-alive connection.  Returns TRUE if
+ * this thread should go on to read the next request now.  Otherwise the
+ * connection has either been parked (and conn->client.sock cleared) or
+ * should be closed.
+ */
+static bool_t
+wait_for_next_request(struct mg_connection *conn)
+{
+	struct mg_context *ctx = conn->ctx;
+
+	/* The next request is already here */
+	if (conn->nread > 0)
+		return (TRUE);
+
+#if defined(LINUX)
+	if (park_socket(ctx, &conn->client))
+		conn->client.sock = INVALID_SOCKET;
+	return (FALSE);
+#else
+	{
+		/*
+		 * Without epoll the connection stays with this thread, but we
+		 * give it up if new connections are waiting for a thread.
+		 */
+		time_t	deadline = time(NULL) + ctx->keepalive_timeout;
+		fd_set	read_set;
+		struct timeval	tv;
+		int	max_fd;
+		bool_t	busy;
+
+		while (ctx->stop_flag == 0 && time(NULL) < deadline) {
+			(void) pthread_mutex_lock(&ctx->thr_mutex);
+			busy = (ctx->sq_head != ctx->sq_tail &&
+			    ctx->num_idle == 0 && ctx->num_threads >= MAX_THREADS);
+			(void) pthread_mutex_unlock(&ctx->thr_mutex);
+			if (busy)
+				break;
+
+			FD_ZERO(&read_set);
+			max_fd = -1;
+			add_to_set(conn->client.sock, &read_set, &max_fd);
+			tv.tv_sec = 1;
+			tv.tv_usec = 0;
+
+			if (select(max_fd + 1, &read_set, NULL, NULL, &tv) < 0)
+				break;
+			if (FD_ISSET(conn->client.sock, &read_set))
+				return (TRUE);
+		}
+		return (FALSE);
+	}
+#endif
+}
+
 /*
  * Worker threads take accepted socket from the queue
  */
@@ -1805,8 +2714,11 @@ worker_thread(struct mg_context *ctx)
 		while (get_socket(ctx, &conn.client) == TRUE) {
 			conn.birth_time = time(NULL);
 			conn.ctx = ctx;
+			conn.nread = 0;
 	
-			process_new_connection(&conn);
+			do {
+				process_new_connection(&conn);
+			} while (conn.keep_alive && wait_for_next_request(&conn));
 	
 			close_connection(&conn);
 		}
@@ -1867,6 +2779,7 @@ accept_new_connection(SG_context *pCtx, const struct socket *listener, struct mg
 
 	accepted.rsa.len = sizeof(accepted.rsa.u.sin);
 	accepted.lsa = listener->lsa;
+	accepted.num_requests = 0;
 	if ((accepted.sock = accept(listener->sock,
 	    &accepted.rsa.u.sa, &accepted.rsa.len)) == INVALID_SOCKET)
 		return;
@@ -1881,12 +2794,39 @@ static void
 master_thread(struct mg_context *ctx)
 {
 	SG_context * pCtx;
+#if defined(LINUX)
+	struct epoll_event	events[64];
+	struct socket		parked;
+	time_t			last_sweep = time(NULL);
+	int			i, n;
+#else
 	fd_set		read_set;
 	struct timeval	tv;
 	int		max_fd;
+#endif
 
 	(void)SG_context__alloc(&pCtx);
 
+#if defined(LINUX)
+	while (ctx->stop_flag == 0) {
+		n = epoll_wait(ctx->epoll_fd, events, (int) ARRAY_SIZE(events), 1000);
+		for (i = 0; i < n; i++) {
+			if (events[i].data.u32 == 0) {
+				accept_new_connection(pCtx, &ctx->listener, ctx);
+			} else if (unpark_socket(ctx, (int) events[i].data.u32 - 1, &parked)) {
+				if (events[i].events & (EPOLLERR | EPOLLHUP))
+					(void) closesocket(parked.sock);
+				else
+					put_socket(pCtx, ctx, &parked);
+			}
+		}
+
+		if (time(NULL) != last_sweep) {
+			last_sweep = time(NULL);
+			expire_parked_sockets(ctx, FALSE);
+		}
+	}
+#else
 	while (ctx->stop_flag == 0) {
 		FD_ZERO(&read_set);
 		max_fd = -1;
@@ -1912,6 +2852,7 @@ master_thread(struct mg_context *ctx)
 				accept_new_connection(pCtx, &ctx->listener, ctx);
 		}
 	}
+#endif
 
 	/* Stop signal received: somebody called mg_stop. Quit. */
 	mg_fini(ctx);
@@ -1937,6 +2878,10 @@ mg_stop(SG_context * pCtx, struct mg_context *ctx)
 	assert(ctx->num_threads == 0);
 
 	SG_PATHNAME_NULLFREE(pCtx, ctx->static_root);
+	SG_PATHNAME_NULLFREE(pCtx, ctx->gzip_cache);
+#if defined(LINUX)
+	SG_NULLFREE(pCtx, ctx->parked);
+#endif
 
 	SG_NULLFREE(pCtx, ctx);
 
@@ -1970,6 +2915,66 @@ fail:
 	;
 }
 
+static void
+_get_int_setting(SG_context *pCtx, const char *pszSetting, int valDefault, int *pVal)
+{
+	char * pszValue = NULL;
+	SG_uint32 val = (SG_uint32) valDefault;
+
+	SG_localsettings__get__sz(pCtx, pszSetting, NULL, &pszValue, NULL);
+	if (!SG_context__has_err(pCtx) && pszValue != NULL)
+		SG_uint32__parse__strict(pCtx, &val, pszValue);
+	if (SG_context__has_err(pCtx) || val > INT_MAX)
+	{
+		SG_log__report_error__current_error(pCtx);
+		SG_context__err_reset(pCtx);
+		val = (SG_uint32) valDefault;
+	}
+
+	SG_NULLFREE(pCtx, pszValue);
+	*pVal = (int) val;
+}
+
+/*
+ * Set up the directory for gzipped copies of static files, and clear out
+ * what earlier runs left behind.  Without one we still serve shipped ".gz"
+ * files, and compress dynamic responses.
+ */
+static void
+_init_gzip_cache(SG_context *pCtx, struct mg_context *ctx)
+{
+	char * pszDir = NULL;
+	struct gzip_sweep sw;
+	SG_int64 now = 0;
+
+	SG_ERR_CHECK(  SG_localsettings__get__sz(pCtx, SG_LOCALSETTING__SERVER_COMPRESSION_CACHE, NULL, &pszDir, NULL)  );
+	if (pszDir != NULL && pszDir[0] != '\0')
+		SG_ERR_CHECK(  SG_PATHNAME__ALLOC__SZ(pCtx, &ctx->gzip_cache, pszDir)  );
+	else
+	{
+		SG_ERR_CHECK(  SG_PATHNAME__ALLOC__USER_TEMP_DIRECTORY(pCtx, &ctx->gzip_cache)  );
+		SG_ERR_CHECK(  SG_pathname__append__from_sz(pCtx, ctx->gzip_cache, GZIP_CACHE_DIR)  );
+	}
+	SG_fsobj__mkdir_recursive__pathname(pCtx, ctx->gzip_cache);
+	SG_ERR_CHECK_CURRENT_DISREGARD(SG_ERR_DIR_ALREADY_EXISTS);
+	SG_ERR_CHECK(  SG_pathname__remove_final_slash(pCtx, ctx->gzip_cache, NULL)  );
+
+	SG_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &now)  );
+	sw.dir = ctx->gzip_cache;
+	sw.prefix = NULL;
+	sw.keep = NULL;
+	sw.cutoff_ms = now - GZIP_CACHE_MAX_AGE_MS;
+	sweep_gzip_cache(pCtx, &sw);
+
+	SG_NULLFREE(pCtx, pszDir);
+	return;
+fail:
+	SG_log__report_error__current_error(pCtx);
+	SG_context__err_reset(pCtx);
+	SG_PATHNAME_NULLFREE(pCtx, ctx->gzip_cache);
+	SG_NULLFREE(pCtx, pszDir);
+}
+
 static void
 mg_init(SG_context *pCtx, struct mg_context *ctx, SG_bool public, int port)
 {
@@ -2019,6 +3024,34 @@ mg_init(SG_context *pCtx, struct mg_context *ctx, SG_bool public, int port)
 		SG_NULLFREE(pCtx, sz_access_log);
 	}
 
+	_get_int_setting(pCtx, SG_LOCALSETTING__SERVER_KEEPALIVE_TIMEOUT, KEEPALIVE_TIMEOUT, &ctx->keepalive_timeout);
+	_get_int_setting(pCtx, SG_LOCALSETTING__SERVER_KEEPALIVE_MAX_REQUESTS, KEEPALIVE_MAX_REQUESTS, &ctx->keepalive_max_requests);
+	_get_int_setting(pCtx, SG_LOCALSETTING__SERVER_KEEPALIVE_MAX_IDLE, KEEPALIVE_MAX_IDLE, &ctx->keepalive_max_idle);
+
+	_get_int_setting(pCtx, SG_LOCALSETTING__SERVER_COMPRESSION_MIN_BYTES, GZIP_MIN_BYTES, &ctx->gzip_min_bytes);
+	if (ctx->gzip_min_bytes > 0)
+		_init_gzip_cache(pCtx, ctx);
+
+#if defined(LINUX)
+	{
+		struct epoll_event ev;
+
+		if (ctx->keepalive_max_idle > 0)
+			SG_ERR_CHECK(  SG_allocN(pCtx, (SG_uint32) ctx->keepalive_max_idle, ctx->parked)  );
+
+		ctx->epoll_fd = epoll_create(16);
+		if (ctx->epoll_fd == -1)
+			SG_ERR_THROW2(SG_ERR_ERRNO(errno), (pCtx, "epoll_create"));
+		set_close_on_exec(ctx->epoll_fd);
+
+		(void) memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.u32 = 0;
+		if (epoll_ctl(ctx->epoll_fd, EPOLL_CTL_ADD, ctx->listener.sock, &ev) == -1)
+			SG_ERR_THROW2(SG_ERR_ERRNO(errno), (pCtx, "epoll_ctl"));
+	}
+#endif
+
 	SG_ERR_CHECK(  SG_uridispatch__init(pCtx, NULL)  );
 
 	return;
@@ -2028,6 +3061,10 @@ fail:
 	SG_PATHNAME_NULLFREE(pCtx, ctx->static_root);
 	SG_PATHNAME_NULLFREE(pCtx, pCoreTemplates);
 	SG_NULLFREE(pCtx, sz_access_log);
+	SG_PATHNAME_NULLFREE(pCtx, ctx->gzip_cache);
+#if defined(LINUX)
+	SG_NULLFREE(pCtx, ctx->parked);
+#endif
 }
 
 void
@@ -2055,6 +3092,9 @@ mg_start(SG_context * pCtx, SG_bool public, int port, struct mg_context **pp_ctx
 	(void) pthread_cond_init(&ctx->thr_cond, NULL);
 	(void) pthread_cond_init(&ctx->empty_cond, NULL);
 	(void) pthread_cond_init(&ctx->full_cond, NULL);
+#if defined(LINUX)
+	ctx->epoll_fd = -1;
+#endif
 
 	SG_ERR_CHECK(  mg_init(pCtx, ctx, public, port)  );
 
@@ -0,0 +1,267 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <sg.h>
+
+#define sg_ARENA_DEFAULT_CHUNK_SPACE   (64 * 1024)
+
+// everything we hand out is aligned for doubles and pointers
+
+#define sg_ARENA_ALIGN                 (8)
+
+typedef struct _sg_arenachunk
+{
+	SG_uint32 count;
+	SG_uint32 space;
+	SG_byte* pBytes;
+	struct _sg_arenachunk* pNext;
+} sg_arenachunk;
+
+typedef struct _sg_arenaadoptee
+{
+	void* p;
+	SG_free_callback* pfnFree;
+	struct _sg_arenaadoptee* pNext;
+} sg_arenaadoptee;
+
+struct _SG_arena
+{
+	SG_uint32 chunk_space;
+	SG_uint32 count_chunks;
+	SG_uint64 count_bytes;
+	sg_arenachunk* pHead;
+
+	sg_arenaadoptee* pAdoptees;     // the nodes themselves live in the arena
+
+	SG_strpool* pStrPool;
+	SG_varpool* pVarPool;
+};
+
+static void sg_arenachunk__free(SG_context * pCtx, sg_arenachunk* pChunk)
+{
+	while (pChunk)
+	{
+		sg_arenachunk* pNext = pChunk->pNext;
+
+		SG_NULLFREE(pCtx, pChunk->pBytes);
+		SG_NULLFREE(pCtx, pChunk);
+
+		pChunk = pNext;
+	}
+}
+
+static void sg_arenachunk__alloc(
+        SG_context* pCtx,
+        SG_uint32 space,
+        sg_arenachunk** ppNew
+        )
+{
+	sg_arenachunk* pThis = NULL;
+
+	SG_ERR_CHECK_RETURN(  SG_alloc1(pCtx, pThis)  );
+
+	pThis->space = space;
+	SG_ERR_CHECK(  SG_alloc(pCtx, 1, space, &pThis->pBytes)  );
+
+	*ppNew = pThis;
+	return;
+
+fail:
+	sg_arenachunk__free(pCtx, pThis);
+}
+
+void SG_arena__alloc(SG_context* pCtx, SG_arena** ppResult, SG_uint32 chunk_space)
+{
+	SG_arena* pThis = NULL;
+
+	SG_NULLARGCHECK_RETURN(ppResult);
+
+	if (0 == chunk_space)
+	{
+		chunk_space = sg_ARENA_DEFAULT_CHUNK_SPACE;
+	}
+
+	SG_ERR_CHECK_RETURN(  SG_alloc1(pCtx, pThis)  );
+
+	pThis->chunk_space = chunk_space;
+
+	SG_ERR_CHECK(  sg_arenachunk__alloc(pCtx, chunk_space, &pThis->pHead)  );
+	pThis->count_chunks = 1;
+
+	// the pools grow in subpools just like the chunks do, so
+	// size them so that a subpool is roughly one chunk.
+
+	SG_ERR_CHECK(  SG_STRPOOL__ALLOC(pCtx, &pThis->pStrPool, chunk_space)  );
+	SG_ERR_CHECK(  SG_VARPOOL__ALLOC(pCtx, &pThis->pVarPool, chunk_space / sizeof(SG_variant))  );
+
+	*ppResult = pThis;
+	return;
+
+fail:
+	SG_ERR_IGNORE(  SG_arena__free(pCtx, pThis)  );
+}
+
+void SG_arena__free(SG_context * pCtx, SG_arena* pArena)
+{
+	sg_arenaadoptee* pAdoptee = NULL;
+
+	if (!pArena)
+	{
+		return;
+	}
+
+	// adoptees may reference strings and variants in our
+	// pools, but they do not reference each other, so the
+	// order in which we free them doesn't matter.
+
+	for (pAdoptee = pArena->pAdoptees; pAdoptee; pAdoptee = pAdoptee->pNext)
+	{
+		SG_ERR_IGNORE(  pAdoptee->pfnFree(pCtx, pAdoptee->p)  );
+	}
+
+	SG_STRPOOL_NULLFREE(pCtx, pArena->pStrPool);
+	SG_VARPOOL_NULLFREE(pCtx, pArena->pVarPool);
+
+	sg_arenachunk__free(pCtx, pArena->pHead);
+
+	SG_NULLFREE(pCtx, pArena);
+}
+
+void SG_arena__alloc_space(
+        SG_context* pCtx,
+        SG_arena* pArena,
+        SG_uint32 count,
+        SG_uint32 size,
+        void** ppOut
+        )
+{
+	SG_uint64 len64 = (SG_uint64)count * (SG_uint64)size;
+	SG_uint32 len = 0;
+	SG_uint32 mod = 0;
+
+	SG_NULLARGCHECK_RETURN(pArena);
+	SG_NULLARGCHECK_RETURN(ppOut);
+
+	if (len64 > (SG_UINT32_MAX - sg_ARENA_ALIGN))
+	{
+		SG_ERR_THROW_RETURN(  SG_ERR_LIMIT_EXCEEDED  );
+	}
+
+	len = (SG_uint32)len64;
+	mod = len % sg_ARENA_ALIGN;
+	if (mod)
+	{
+		len += (sg_ARENA_ALIGN - mod);
+	}
+
+	if ((pArena->pHead->count + len) > pArena->pHead->space)
+	{
+		sg_arenachunk* pChunk = NULL;
+
+		if (len > (pArena->chunk_space / 4))
+		{
+			// big requests get a chunk of their own.  we link it in
+			// *behind* the head so that the space left in the current
+			// chunk is not wasted.
+
+			SG_ERR_CHECK_RETURN(  sg_arenachunk__alloc(pCtx, len, &pChunk)  );
+
+			pChunk->count = len;
+			pChunk->pNext = pArena->pHead->pNext;
+			pArena->pHead->pNext = pChunk;
+			pArena->count_chunks++;
+			pArena->count_bytes += len;
+
+			*ppOut = pChunk->pBytes;
+			return;
+		}
+
+		SG_ERR_CHECK_RETURN(  sg_arenachunk__alloc(pCtx, pArena->chunk_space, &pChunk)  );
+
+		pChunk->pNext = pArena->pHead;
+		pArena->pHead = pChunk;
+		pArena->count_chunks++;
+	}
+
+	// chunks come from SG_alloc, so they are already zeroed.
+
+	*ppOut = pArena->pHead->pBytes + pArena->pHead->count;
+	pArena->pHead->count += len;
+	pArena->count_bytes += len;
+}
+
+void SG_arena__adopt(
+        SG_context* pCtx,
+        SG_arena* pArena,
+        void* p,
+        SG_free_callback* pfnFree
+        )
+{
+	sg_arenaadoptee* pAdoptee = NULL;
+
+	SG_NULLARGCHECK_RETURN(pArena);
+	SG_NULLARGCHECK_RETURN(pfnFree);
+
+	if (!p)
+	{
+		return;
+	}
+
+	SG_ERR_CHECK_RETURN(  SG_arena__alloc_space(pCtx, pArena, 1, sizeof(sg_arenaadoptee), (void**)&pAdoptee)  );
+
+	pAdoptee->p = p;
+	pAdoptee->pfnFree = pfnFree;
+	pAdoptee->pNext = pArena->pAdoptees;
+	pArena->pAdoptees = pAdoptee;
+}
+
+void SG_arena__get_pools(
+        SG_context* pCtx,
+        SG_arena* pArena,
+        SG_strpool** ppStrPool,
+        SG_varpool** ppVarPool
+        )
+{
+	SG_NULLARGCHECK_RETURN(pArena);
+
+	if (ppStrPool)
+	{
+		*ppStrPool = pArena->pStrPool;
+	}
+	if (ppVarPool)
+	{
+		*ppVarPool = pArena->pVarPool;
+	}
+}
+
+void SG_arena__get_stats(
+        SG_context* pCtx,
+        const SG_arena* pArena,
+        SG_uint64* pcbUsed,
+        SG_uint32* pcChunks
+        )
+{
+	SG_NULLARGCHECK_RETURN(pArena);
+
+	if (pcbUsed)
+	{
+		*pcbUsed = pArena->count_bytes;
+	}
+	if (pcChunks)
+	{
+		*pcChunks = pArena->count_chunks;
+	}
+}
@@ -15,6 +15,7 @@ limitations under the License.
 */
 
 #include <sg.h>
+#include <sghash.h>
 #include <zlib.h>
 
 #define MY_CHUNK_SIZE			(16*1024)
@@ -5549,25 +5550,44 @@ fail:
 		SG_ERR_IGNORE(  SG_log__pop_operation(pCtx)  );
 }
 		
+/**
+ * Get the clone fragball from the other side.  If bTopUp is set, the caller
+ * promises to pull from the other side afterward if *pb_stale comes back set,
+ * so the server may send a cached fragball that's a little behind rather than
+ * build a new one.  pb_stale can be NULL.
+ */
 void sg_clone__get_fragball(
 	SG_context* pCtx,
     SG_sync_client* pClient,
     SG_pathname* pPath_staging,
-    SG_pathname** pp
+    SG_bool bTopUp,
+    SG_pathname** pp,
+    SG_bool* pb_stale
     )
 {
     SG_pathname* pPath_fragball = NULL;
     char* psz_fragball_name = NULL;
+    SG_vhash* pvh_clone_request = NULL;
+    SG_bool b_stale = SG_FALSE;
 
-    SG_ERR_CHECK(  SG_sync_client__pull_clone(pCtx, pClient, NULL, pPath_staging, &psz_fragball_name)  );
+    if (bTopUp)
+    {
+        SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvh_clone_request)  );
+        SG_ERR_CHECK(  SG_vhash__add__bool(pCtx, pvh_clone_request, SG_SYNC_CLONE_REQUEST_KEY__TOPUP, SG_TRUE)  );
+    }
+
+    SG_ERR_CHECK(  SG_sync_client__pull_clone(pCtx, pClient, pvh_clone_request, pPath_staging, &psz_fragball_name, &b_stale)  );
     SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPath_fragball, pPath_staging, psz_fragball_name)  );
 
     *pp = pPath_fragball;
     pPath_fragball = NULL;
+    if (pb_stale)
+        *pb_stale = b_stale;
 
 fail:
     SG_PATHNAME_NULLFREE(pCtx, pPath_fragball);
     SG_NULLFREE(pCtx, psz_fragball_name);
+    SG_VHASH_NULLFREE(pCtx, pvh_clone_request);
 }
 
 void sg_clone__make_staging_area(
@@ -5590,6 +5610,56 @@ fail:
     SG_PATHNAME_NULLFREE(pCtx, pPath_staging);
 }
 
+/**
+ * The staging area for a clone from a remote server gets a name derived from
+ * where we're cloning from and what we're calling the result, rather than a new
+ * tid.  If the download is interrupted we leave the staging area behind, and
+ * running the same clone again finds it and resumes the download.
+ */
+static void sg_clone__make_resumable_staging_area(
+    SG_context* pCtx,
+    const char* psz_existing_repo_spec,
+    const char* psz_new_repo_name,
+    SG_pathname** pp,
+    SG_bool* pb_resuming
+    )
+{
+    SGHASH_handle* phh = NULL;
+    char buf_hash[SG_HID_MAX_BUFFER_LENGTH];
+    char buf_name[6 + SG_HID_MAX_BUFFER_LENGTH];
+    SG_pathname* pPath_staging = NULL;
+    SG_bool b_exists = SG_FALSE;
+    SG_error err;
+
+    err = SGHASH_init("SHA1/160", &phh);
+    if (SG_IS_ERROR(err))
+        SG_ERR_THROW(err);
+    err = SGHASH_update(phh, (const SG_byte*)psz_existing_repo_spec, SG_STRLEN(psz_existing_repo_spec) + 1);
+    if (SG_IS_ERROR(err))
+        SG_ERR_THROW(err);
+    err = SGHASH_update(phh, (const SG_byte*)psz_new_repo_name, SG_STRLEN(psz_new_repo_name));
+    if (SG_IS_ERROR(err))
+        SG_ERR_THROW(err);
+    err = SGHASH_final(&phh, buf_hash, sizeof(buf_hash));
+    if (SG_IS_ERROR(err))
+        SG_ERR_THROW(err);
+
+    SG_ERR_CHECK(  SG_sprintf(pCtx, buf_name, sizeof(buf_name), "clone-%s", buf_hash)  );
+    SG_ERR_CHECK(  SG_sync__make_temp_path(pCtx, buf_name, &pPath_staging)  );
+    SG_ERR_CHECK(  SG_fsobj__exists__pathname(pCtx, pPath_staging, &b_exists, NULL, NULL)  );
+    if (!b_exists)
+        SG_ERR_CHECK(  SG_fsobj__mkdir__pathname(pCtx, pPath_staging)  );
+
+    *pb_resuming = b_exists;
+    *pp = pPath_staging;
+    pPath_staging = NULL;
+
+fail:
+    if (phh)
+        SGHASH_abort(&phh);
+    SG_PATHNAME_NULLFREE(pCtx, pPath_staging);
+}
+
 static void sg_clone__create_repo(
     SG_context* pCtx,
     const char* psz_new_repo_name,
@@ -5639,6 +5709,8 @@ void SG_clone__to_local(
     SG_uint32 count_ops = 0;
     SG_fragballinfo* pfbi = NULL;
     SG_bool bExistingIsRemote = SG_FALSE;
+    SG_bool bResuming = SG_FALSE;
+    SG_bool bStale = SG_FALSE;
 
     SG_NULLARGCHECK_RETURN(psz_existing_repo_spec);
     SG_NULLARGCHECK_RETURN(psz_new_repo_spec);
@@ -5658,7 +5730,16 @@ void SG_clone__to_local(
     SG_ERR_CHECK(  SG_clone__validate_new_repo_name(pCtx, psz_new_repo_spec)  );
 
     // make a directory for our staging area
-    SG_ERR_CHECK(  sg_clone__make_staging_area(pCtx, &pPath_staging)  );
+    if (bExistingIsRemote)
+    {
+        SG_ERR_CHECK(  sg_clone__make_resumable_staging_area(pCtx, psz_existing_repo_spec, psz_new_repo_spec, &pPath_staging, &bResuming)  );
+        if (bResuming)
+            SG_ERR_CHECK(  SG_log__report_verbose(pCtx, "Resuming an earlier attempt to clone %s.", psz_existing_repo_spec)  );
+    }
+    else
+    {
+        SG_ERR_CHECK(  sg_clone__make_staging_area(pCtx, &pPath_staging)  );
+    }
 
     // open connection to the other side
     SG_ERR_CHECK(  SG_sync_client__open(pCtx, psz_existing_repo_spec, psz_username, psz_password, &pClient)  );
@@ -5674,7 +5755,7 @@ void SG_clone__to_local(
     }
 
     // get the fragball
-    SG_ERR_CHECK(  sg_clone__get_fragball(pCtx, pClient, pPath_staging, &pPath_fragball)  );
+    SG_ERR_CHECK(  sg_clone__get_fragball(pCtx, pClient, pPath_staging, bExistingIsRemote, &pPath_fragball, &bStale)  );
 
     SG_ERR_CHECK(  SG_log__push_operation(pCtx, "Creating new instance", SG_LOG__FLAG__NONE)  );
     count_ops++;
@@ -5717,6 +5798,23 @@ void SG_clone__to_local(
                     )  );
     }
 
+    /* The server sent a cached fragball from a little while ago.  Pull
+     * whatever's been added since.  What we have is a good repo either way,
+     * so if that fails we keep it and leave the rest to a later pull. */
+    if (bStale)
+    {
+        SG_ERR_CHECK(  SG_log__set_step(pCtx, "Pulling recent changes")  );
+        SG_pull__all(pCtx, pRepo, psz_existing_repo_spec, psz_username, psz_password, NULL, NULL);
+        if (SG_CONTEXT__HAS_ERR(pCtx))
+        {
+            SG_log__report_warning__current_error(pCtx);
+            SG_context__err_reset(pCtx);
+            SG_ERR_CHECK(  SG_log__report_warning(pCtx,
+                "The clone may be missing changes made to %s in the last few minutes. Pull from it to get them.",
+                psz_existing_repo_spec)  );
+        }
+    }
+
     bSuccess = SG_TRUE;
 
     if (count_ops)
@@ -5744,7 +5842,25 @@ fail:
     SG_fragballinfo__free(pCtx, pfbi);
     if (pPath_staging)
     {
-        SG_ERR_IGNORE(  SG_fsobj__rmdir_recursive__pathname(pCtx, pPath_staging) );
+        /* If we didn't finish downloading the fragball from a server, keep what we
+         * got.  Cloning again will pick up where we left off. */
+        if (bExistingIsRemote && !pPath_fragball)
+        {
+            SG_bool bKept;
+
+            // (This only removes it if it's empty.)
+            SG_context__push_level(pCtx);
+            SG_fsobj__rmdir__pathname(pCtx, pPath_staging);
+            bKept = SG_CONTEXT__HAS_ERR(pCtx);
+            SG_context__pop_level(pCtx);
+
+            if (bKept)
+                SG_ERR_IGNORE(  SG_log__report_info(pCtx, "The partially downloaded repository was kept in %s. Run the same clone again to resume.", SG_pathname__sz(pPath_staging))  );
+        }
+        else
+        {
+            SG_ERR_IGNORE(  SG_fsobj__rmdir_recursive__pathname(pCtx, pPath_staging) );
+        }
         SG_PATHNAME_NULLFREE(pCtx, pPath_staging);
     }
     SG_VHASH_NULLFREE(pCtx, pvh_repo_info);
@@ -6111,7 +6227,7 @@ void SG_clone__prep_usermap(
         SG_ERR_CHECK(  SG_sync_client__open(pCtx, psz_existing_repo_spec, psz_username, psz_password, &pClient)  );
 
         // get the fragball
-        SG_ERR_CHECK(  sg_clone__get_fragball(pCtx, pClient, pPath_staging, &pPath_orig_fragball)  );
+        SG_ERR_CHECK(  sg_clone__get_fragball(pCtx, pClient, pPath_staging, SG_FALSE, &pPath_orig_fragball, NULL)  );
 
         // rename the fragball file
         SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPath_fragball, pPath_staging, SG_USERMAP_FRAGBALL_NAME)  );
@@ -303,6 +303,20 @@ void SG_committing__db__add_record(SG_context * pCtx,
 							  pRecord,pCommitting->pRepo,pCommitting->pRepoTx,&iBlobFullLength)  );
 }
 
+void SG_committing__db__add_records(SG_context * pCtx,
+								 SG_committing * pCommitting,
+								 SG_dbrecord ** apRecords,
+								 SG_uint32 count)
+{
+	SG_NULLARGCHECK_RETURN(pCommitting);
+	SG_NULLARGCHECK_RETURN(pCommitting->pRepo);
+
+	SG_ASSERT_RELEASE_RETURN(  SG_DAGNUM__IS_DB(pCommitting->iDagNum)  );
+
+	SG_ERR_CHECK_RETURN(  SG_dbrecord__save_to_repo__batch(pCtx,
+							  apRecords, count, pCommitting->pRepo, pCommitting->pRepoTx)  );
+}
+
 void SG_committing__store_blob_from_file(
         SG_context* pCtx,
         SG_committing* pCommitting,
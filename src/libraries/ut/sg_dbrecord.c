@@ -278,6 +278,110 @@ fail:
 	SG_NULLFREE(pCtx, pszHidComputed);
 }
 
+// how much we hand to SG_repo__store_blobs__batch() at a time
+#define SG_DBRECORD__BATCH_MAX_COUNT	1024
+#define SG_DBRECORD__BATCH_MAX_BYTES	(4*1024*1024)
+
+static void sg_dbrecord__save_batch(
+	SG_context* pCtx,
+	SG_repo * pRepo,
+	SG_repo_tx_handle* pRepoTx,
+	SG_uint32 count,
+	SG_dbrecord** aprec,
+	SG_string** apstr
+	)
+{
+	const SG_byte** ap_buf = NULL;
+	SG_uint32* a_len = NULL;
+	char** apsz_hid = NULL;
+	SG_uint32 i;
+
+	SG_ERR_CHECK(  SG_allocN(pCtx, count, ap_buf)  );
+	SG_ERR_CHECK(  SG_allocN(pCtx, count, a_len)  );
+	SG_ERR_CHECK(  SG_allocN(pCtx, count, apsz_hid)  );
+
+	for (i=0; i<count; i++)
+	{
+		ap_buf[i] = (const SG_byte *)SG_string__sz(apstr[i]);
+		a_len[i] = SG_string__length_in_bytes(apstr[i]);
+	}
+
+	SG_ERR_CHECK(  SG_repo__store_blobs__batch(pCtx, pRepo, pRepoTx, SG_FALSE, count, ap_buf, a_len, apsz_hid)  );
+
+	// the records take ownership of the HIDs
+	for (i=0; i<count; i++)
+	{
+		SG_ERR_CHECK(  _sg_dbrecord__freeze(pCtx, aprec[i], apsz_hid[i])  );
+		apsz_hid[i] = NULL;
+	}
+
+fail:
+	if (apsz_hid)
+	{
+		for (i=0; i<count; i++)
+		{
+			SG_NULLFREE(pCtx, apsz_hid[i]);
+		}
+	}
+	SG_NULLFREE(pCtx, apsz_hid);
+	SG_NULLFREE(pCtx, a_len);
+	SG_NULLFREE(pCtx, ap_buf);
+}
+
+void SG_dbrecord__save_to_repo__batch(SG_context* pCtx, SG_dbrecord** aprec, SG_uint32 count, SG_repo * pRepo, SG_repo_tx_handle* pRepoTx)
+{
+	SG_string** apstr = NULL;
+	SG_uint32 first = 0;
+	SG_uint32 bytes = 0;
+	SG_uint32 i;
+
+	SG_NULLARGCHECK_RETURN(pRepo);
+	SG_NULLARGCHECK_RETURN(pRepoTx);
+
+	if (0 == count)
+	{
+		return;
+	}
+
+	SG_NULLARGCHECK_RETURN(aprec);
+
+	SG_ERR_CHECK(  SG_allocN(pCtx, count, apstr)  );
+
+	for (i=0; i<count; i++)
+	{
+		SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &apstr[i])  );
+		SG_ERR_CHECK(  SG_dbrecord__to_json(pCtx, aprec[i], apstr[i])  );
+		bytes += SG_string__length_in_bytes(apstr[i]);
+
+		if (
+				((i + 1) == count)
+				|| ((i + 1 - first) >= SG_DBRECORD__BATCH_MAX_COUNT)
+				|| (bytes >= SG_DBRECORD__BATCH_MAX_BYTES)
+		   )
+		{
+			SG_uint32 j;
+
+			SG_ERR_CHECK(  sg_dbrecord__save_batch(pCtx, pRepo, pRepoTx, i + 1 - first, aprec + first, apstr + first)  );
+			for (j=first; j<=i; j++)
+			{
+				SG_STRING_NULLFREE(pCtx, apstr[j]);
+			}
+			first = i + 1;
+			bytes = 0;
+		}
+	}
+
+fail:
+	if (apstr)
+	{
+		for (i=0; i<count; i++)
+		{
+			SG_STRING_NULLFREE(pCtx, apstr[i]);
+		}
+	}
+	SG_NULLFREE(pCtx, apstr);
+}
+
 static void sg_dbrecord__load_from_repo(SG_context* pCtx, SG_repo * pRepo, const char* pszidHidBlob, SG_bool b_utf8_fix, SG_dbrecord ** ppResult)
 {
 	// fetch contents of a dbrecord-type blob and convert to a dbrecord object.
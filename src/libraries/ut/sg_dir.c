@@ -168,12 +168,15 @@ void SG_dir__open(SG_context* pCtx, const SG_pathname * pPathnameDirectory,
 	// files/subdirs within it.
 
 	SG_dir * pThis = NULL;
+	SG_int64 tPerf;
 
 	SG_ARGCHECK_RETURN(SG_pathname__is_set(pPathnameDirectory), pPathnameDirectory);
 	SG_NULLARGCHECK_RETURN(ppDirResult);
 	SG_NULLARGCHECK_RETURN(pErrReadStat);
 	SG_NULLARGCHECK_RETURN(pStringNameFirstFileRead);
 
+	tPerf = SG_perf__start();
+
 	SG_ERR_CHECK_RETURN(  SG_alloc1(pCtx, pThis)  );
 
 	MY_SET_CLOSED(pThis);
@@ -188,6 +191,7 @@ void SG_dir__open(SG_context* pCtx, const SG_pathname * pPathnameDirectory,
 
 	*ppDirResult = pThis;
 
+	SG_perf__stop(SG_PERF_CATEGORY__FS_SCAN, tPerf, 1);
 	return;
 
 fail:
@@ -310,10 +314,13 @@ void SG_dir__read(SG_context* pCtx, SG_dir * pThis,
 	// optionally also stat the file.  (this may seem
 	// weird, but we get the information for free on
 	// windows.)
+	SG_int64 tPerf;
+
 	SG_NULLARGCHECK_RETURN(pThis);
 	SG_ARGCHECK_RETURN(!MY_IS_CLOSED(pThis), pThis);
 	SG_NULLARGCHECK_RETURN(pStringFileName);
 
+	tPerf = SG_perf__start();
 
 #if defined(MAC) || defined(LINUX)
 	SG_ERR_CHECK_RETURN( _sg_dir__read_posix(pCtx, pThis,pStringFileName,pStatResult) );
@@ -321,6 +328,8 @@ void SG_dir__read(SG_context* pCtx, SG_dir * pThis,
 #if defined(WINDOWS)
 	SG_ERR_CHECK_RETURN( _sg_dir__read_windows(pCtx, pThis,pStringFileName,pStatResult) );
 #endif
+
+	SG_perf__stop(SG_PERF_CATEGORY__FS_SCAN, tPerf, 1);
 }
 
 //////////////////////////////////////////////////////////////////
@@ -16,6 +16,567 @@ limitations under the License.
 
 #include <sg.h>
 
+//////////////////////////////////////////////////////////////////
+
+/*
+ * The stream goes out through a reorder buffer.  Text (commits,
+ * resets, tags and the headers of blobs) is collected as we go.
+ * Each blob we need is queued along with the text that comes before
+ * it, and an SG_thread_pool fetches the queued blobs (undeltify,
+ * inflate) into memory while we carry on with the following commits.
+ * Entries leave the queue in order and are written through a large
+ * output buffer.
+ */
+
+// Beyond this many workers we are waiting on the disk anyway.
+#define sg_FAST_EXPORT__MAX_THREADS			(8)
+
+#define sg_FAST_EXPORT__MAX_QUEUED_BLOBS	(1024)
+#define sg_FAST_EXPORT__MAX_QUEUED_BYTES	(128 * 1024 * 1024)
+
+// Bigger blobs are not fetched ahead.  They are streamed straight
+// from the repo into the file when their turn comes.
+#define sg_FAST_EXPORT__MAX_BLOB_BYTES		(16 * 1024 * 1024)
+
+#define sg_FAST_EXPORT__WRITE_BUFFER_SIZE	(1024 * 1024)
+
+#define sg_FAST_EXPORT__BLOB__QUEUED		(0)
+#define sg_FAST_EXPORT__BLOB__WORKING		(1)
+#define sg_FAST_EXPORT__BLOB__DONE			(2)
+
+struct sg_fast_export_blob
+{
+    SG_uint32 state;            // protected by the mutex
+    SG_string* pstr_before;     // text that goes ahead of this blob
+    char* psz_hid;
+    SG_uint64 len;
+    SG_bool b_stream;           // too big to fetch ahead
+    SG_byte* p_data;
+};
+
+struct sg_fast_export_out
+{
+    SG_repo* pRepo;             // we do not own this
+    SG_file* pfi;               // we do not own this
+    SG_string* pstr_text;       // text since the last queued blob
+    SG_string* pstr_write;      // not yet written to pfi
+
+    SG_mutex mutex;
+    SG_bool b_mutex;
+
+    // Broadcast whenever tail, a blob's state, b_quit or b_abort
+    // changes, so that nobody has to poll the queue.
+    SG_thread_cond cond;
+    SG_bool b_cond;
+
+    // Blobs are numbered in the order they were queued.  Blob n lives
+    // in a_blobs[n % sg_FAST_EXPORT__MAX_QUEUED_BLOBS].  Only the main
+    // thread changes head and tail, so it can read them without the mutex.
+    struct sg_fast_export_blob a_blobs[sg_FAST_EXPORT__MAX_QUEUED_BLOBS];
+    SG_uint32 head;             // oldest blob not yet written
+    SG_uint32 next;             // next blob to hand out (protected by mutex)
+    SG_uint32 tail;             // number of the next blob queued (protected by mutex)
+    SG_uint64 bytes_queued;     // main thread only
+    SG_bool b_quit;             // protected by mutex
+    SG_bool b_abort;            // a worker failed (protected by mutex)
+
+    SG_thread_pool* pPool;
+    SG_uint32 count_workers;
+};
+
+#define x_BLOB(pOut, n) (&(pOut)->a_blobs[(n) % sg_FAST_EXPORT__MAX_QUEUED_BLOBS])
+
+static void x_blob__reset(SG_context* pCtx, struct sg_fast_export_blob* pBlob)
+{
+    SG_STRING_NULLFREE(pCtx, pBlob->pstr_before);
+    SG_NULLFREE(pCtx, pBlob->psz_hid);
+    SG_NULLFREE(pCtx, pBlob->p_data);
+    memset(pBlob, 0, sizeof(*pBlob));
+}
+
+static void x_blob__fetch(
+    SG_context* pCtx,
+    SG_repo* pRepo,
+    struct sg_fast_export_blob* pBlob
+    )
+{
+    SG_uint64 len = 0;
+
+    if (pBlob->b_stream)
+    {
+        return;
+    }
+
+    SG_ERR_CHECK_RETURN(  SG_repo__fetch_blob_into_memory(pCtx, pRepo, pBlob->psz_hid, &pBlob->p_data, &len)  );
+
+    // we already wrote the length in the header
+    if (len != pBlob->len)
+    {
+        SG_ERR_THROW2_RETURN(  SG_ERR_BLOB_NOT_VERIFIED_INCOMPLETE, (pCtx, "%s", pBlob->psz_hid)  );
+    }
+}
+
+/**
+ * Fetch queued blobs until we are told to quit or somebody fails.
+ * The main thread queues blobs as it goes, so an empty queue just
+ * means we sleep until it queues another one.
+ */
+static void x_worker__loop(
+    SG_context* pCtx,
+    struct sg_fast_export_out* pOut,
+    SG_repo* pRepo
+    )
+{
+    struct sg_fast_export_blob* pBlob;
+    SG_bool b_quit;
+    SG_bool b_locked = SG_FALSE;
+
+    while (1)
+    {
+        pBlob = NULL;
+
+        SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pOut->mutex)  );
+        b_locked = SG_TRUE;
+        while (1)
+        {
+            b_quit = (pOut->b_quit || pOut->b_abort);
+            if (b_quit || (pOut->next != pOut->tail))
+            {
+                break;
+            }
+            SG_ERR_CHECK(  SG_thread_cond__wait(pCtx, &pOut->cond, &pOut->mutex)  );
+        }
+        if (!b_quit)
+        {
+            pBlob = x_BLOB(pOut, pOut->next++);
+            pBlob->state = sg_FAST_EXPORT__BLOB__WORKING;
+        }
+        b_locked = SG_FALSE;
+        SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pOut->mutex)  );
+
+        if (b_quit)
+        {
+            break;
+        }
+
+        SG_ERR_CHECK(  x_blob__fetch(pCtx, pRepo, pBlob)  );
+
+        SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pOut->mutex)  );
+        pBlob->state = sg_FAST_EXPORT__BLOB__DONE;
+        SG_ERR_CHECK(  SG_thread_cond__broadcast(pCtx, &pOut->cond)  );
+        SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pOut->mutex)  );
+    }
+
+    return;
+
+fail:
+    // Tell everybody else to stop.  Our context has the error.
+    if (b_locked || (SG_mutex__lock__bare(&pOut->mutex) == 0))
+    {
+        pOut->b_abort = SG_TRUE;
+        (void)SG_thread_cond__broadcast__bare(&pOut->cond);
+        (void)SG_mutex__unlock__bare(&pOut->mutex);
+    }
+}
+
+static SG_thread_pool__work x_worker__main;
+
+static void x_worker__main(SG_context* pCtx, SG_repo* pRepo, void * pVoidData)
+{
+    x_worker__loop(pCtx, (struct sg_fast_export_out*) pVoidData, pRepo);
+}
+
+/**
+ * Tell the workers to quit and wait for them.  Throws the first
+ * error that any of them hit.
+ */
+static void x_out__stop(
+    SG_context* pCtx,
+    struct sg_fast_export_out* pOut
+    )
+{
+    if (!pOut || !pOut->b_mutex)
+    {
+        return;
+    }
+
+    SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pOut->mutex)  );
+    pOut->b_quit = SG_TRUE;
+    if (pOut->b_cond)
+    {
+        SG_ERR_CHECK(  SG_thread_cond__broadcast(pCtx, &pOut->cond)  );
+    }
+    SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pOut->mutex)  );
+
+    if (pOut->pPool)
+    {
+        SG_ERR_CHECK(  SG_thread_pool__join(pCtx, pOut->pPool)  );
+    }
+
+fail:
+    ;
+}
+
+static void x_out__free(
+    SG_context* pCtx,
+    struct sg_fast_export_out* pOut
+    )
+{
+    SG_uint32 k;
+
+    if (!pOut)
+    {
+        return;
+    }
+
+    // Make sure that no worker is still using our data before we free it.
+    if (pOut->b_mutex && (SG_mutex__lock__bare(&pOut->mutex) == 0))
+    {
+        pOut->b_quit = SG_TRUE;
+        if (pOut->b_cond)
+        {
+            (void)SG_thread_cond__broadcast__bare(&pOut->cond);
+        }
+        (void)SG_mutex__unlock__bare(&pOut->mutex);
+    }
+    SG_THREAD_POOL_NULLFREE(pCtx, pOut->pPool);
+
+    for (k=0; k<sg_FAST_EXPORT__MAX_QUEUED_BLOBS; k++)
+    {
+        x_blob__reset(pCtx, &pOut->a_blobs[k]);
+    }
+
+    if (pOut->b_cond)
+    {
+        SG_thread_cond__destroy(&pOut->cond);
+    }
+    if (pOut->b_mutex)
+    {
+        SG_mutex__destroy(&pOut->mutex);
+    }
+    SG_STRING_NULLFREE(pCtx, pOut->pstr_text);
+    SG_STRING_NULLFREE(pCtx, pOut->pstr_write);
+    SG_NULLFREE(pCtx, pOut);
+}
+
+/**
+ * The number of workers can be set with the fast_export/threads
+ * setting.  Zero fetches every blob on the main thread.
+ */
+static void x_get_thread_setting(
+    SG_context* pCtx,
+    SG_uint32 count_default,
+    SG_uint32* pCount
+    )
+{
+    char* psz_value = NULL;
+    SG_uint32 count = count_default;
+
+    SG_localsettings__get__sz(pCtx, SG_LOCALSETTING__FAST_EXPORT_THREADS, NULL, &psz_value, NULL);
+    if (!SG_context__has_err(pCtx) && psz_value && *psz_value)
+    {
+        SG_uint32__parse__strict(pCtx, &count, psz_value);
+    }
+    if (SG_context__has_err(pCtx))
+    {
+        SG_log__report_error__current_error(pCtx);
+        SG_context__err_reset(pCtx);
+        count = count_default;
+    }
+
+    SG_NULLFREE(pCtx, psz_value);
+    *pCount = count;
+}
+
+static void x_out__alloc(
+    SG_context* pCtx,
+    SG_repo* pRepo,
+    SG_file* pfi,
+    struct sg_fast_export_out** ppOut
+    )
+{
+    struct sg_fast_export_out* pOut = NULL;
+    SG_uint32 count_processors = 1;
+
+    SG_ERR_CHECK(  SG_alloc1(pCtx, pOut)  );
+    pOut->pRepo = pRepo;
+    pOut->pfi = pfi;
+    SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pOut->pstr_text)  );
+    SG_ERR_CHECK(  SG_STRING__ALLOC__RESERVE(pCtx, &pOut->pstr_write, sg_FAST_EXPORT__WRITE_BUFFER_SIZE)  );
+
+    SG_ERR_CHECK(  SG_mutex__init(pCtx, &pOut->mutex)  );
+    pOut->b_mutex = SG_TRUE;
+    SG_ERR_CHECK(  SG_thread_cond__init(pCtx, &pOut->cond)  );
+    pOut->b_cond = SG_TRUE;
+
+    // The main thread is busy computing tree deltas, so it
+    // doesn't count as one of the workers.
+    SG_ERR_CHECK(  SG_thread__get_processor_count(pCtx, &count_processors)  );
+    SG_ERR_CHECK(  x_get_thread_setting(pCtx, count_processors - 1, &pOut->count_workers)  );
+    pOut->count_workers = SG_MIN(pOut->count_workers, sg_FAST_EXPORT__MAX_THREADS);
+
+    if (pOut->count_workers > 0)
+    {
+        SG_ERR_CHECK(  SG_thread_pool__alloc(pCtx, pOut->count_workers, pRepo, x_worker__main, pOut, &pOut->pPool)  );
+        SG_ERR_CHECK(  SG_thread_pool__start(pCtx, pOut->pPool)  );
+    }
+
+    *ppOut = pOut;
+    pOut = NULL;
+
+fail:
+    x_out__free(pCtx, pOut);
+}
+
+static void x_out__flush(
+    SG_context* pCtx,
+    struct sg_fast_export_out* pOut
+    )
+{
+    if (SG_string__length_in_bytes(pOut->pstr_write))
+    {
+        SG_ERR_CHECK_RETURN(  SG_file__write__string(pCtx, pOut->pfi, pOut->pstr_write)  );
+        SG_ERR_CHECK_RETURN(  SG_string__clear(pCtx, pOut->pstr_write)  );
+    }
+}
+
+static void x_out__write(
+    SG_context* pCtx,
+    struct sg_fast_export_out* pOut,
+    const SG_byte* p,
+    SG_uint32 len
+    )
+{
+    if ((SG_string__length_in_bytes(pOut->pstr_write) + len) > sg_FAST_EXPORT__WRITE_BUFFER_SIZE)
+    {
+        SG_ERR_CHECK_RETURN(  x_out__flush(pCtx, pOut)  );
+    }
+
+    if (len >= sg_FAST_EXPORT__WRITE_BUFFER_SIZE)
+    {
+        SG_ERR_CHECK_RETURN(  SG_file__write(pCtx, pOut->pfi, len, p, NULL)  );
+    }
+    else if (len)
+    {
+        SG_ERR_CHECK_RETURN(  SG_string__append__buf_len(pCtx, pOut->pstr_write, p, len)  );
+    }
+}
+
+static void x_out__format(
+    SG_context* pCtx,
+    struct sg_fast_export_out* pOut,
+    const char* psz_format,
+    ...
+    )
+{
+    SG_string* pstr = NULL;
+    va_list ap;
+
+    va_start(ap, psz_format);
+    SG_ERR_CHECK(  SG_STRING__ALLOC__VFORMAT(pCtx, &pstr, psz_format, ap)  );
+    va_end(ap);
+
+    SG_ERR_CHECK(  SG_string__append__string(pCtx, pOut->pstr_text, pstr)  );
+
+fail:
+    SG_STRING_NULLFREE(pCtx, pstr);
+}
+
+/**
+ * Write the oldest queued blob (and the text ahead of it), waiting
+ * for it if we have to.  If nobody has started on it yet, we fetch
+ * it ourselves.
+ */
+static void x_out__write_oldest(
+    SG_context* pCtx,
+    struct sg_fast_export_out* pOut
+    )
+{
+    struct sg_fast_export_blob* pBlob = x_BLOB(pOut, pOut->head);
+    SG_bool b_abort = SG_FALSE;
+    SG_bool b_mine = SG_FALSE;
+    SG_bool b_locked = SG_FALSE;
+    SG_uint32 state = sg_FAST_EXPORT__BLOB__QUEUED;
+
+    SG_ASSERT(pOut->head != pOut->tail);
+
+    SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pOut->mutex)  );
+    b_locked = SG_TRUE;
+    while (1)
+    {
+        b_abort = pOut->b_abort;
+        state = pBlob->state;
+        if (!b_abort && (sg_FAST_EXPORT__BLOB__QUEUED == state))
+        {
+            // blobs are handed out in order, so this one must be next
+            SG_ASSERT(pOut->next == pOut->head);
+            pOut->next++;
+            pBlob->state = sg_FAST_EXPORT__BLOB__WORKING;
+            b_mine = SG_TRUE;
+        }
+        if (b_abort || b_mine || (sg_FAST_EXPORT__BLOB__DONE == state))
+        {
+            break;
+        }
+
+        // a worker has it
+        SG_ERR_CHECK(  SG_thread_cond__wait(pCtx, &pOut->cond, &pOut->mutex)  );
+    }
+    b_locked = SG_FALSE;
+    SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pOut->mutex)  );
+
+    if (b_abort)
+    {
+        SG_ERR_CHECK(  x_out__stop(pCtx, pOut)  );
+        SG_ERR_THROW(  SG_ERR_UNSPECIFIED  );
+    }
+    if (b_mine)
+    {
+        SG_ERR_CHECK(  x_blob__fetch(pCtx, pOut->pRepo, pBlob)  );
+    }
+
+    SG_ERR_CHECK(  x_out__write(pCtx, pOut,
+                (const SG_byte*) SG_string__sz(pBlob->pstr_before),
+                SG_string__length_in_bytes(pBlob->pstr_before))  );
+
+    if (pBlob->b_stream)
+    {
+        SG_uint64 len_check = 0;
+
+        SG_ERR_CHECK(  x_out__flush(pCtx, pOut)  );
+        SG_ERR_CHECK(  SG_repo__fetch_blob_into_file(pCtx, pOut->pRepo, pBlob->psz_hid, pOut->pfi, &len_check)  );
+    }
+    else
+    {
+        SG_ERR_CHECK(  x_out__write(pCtx, pOut, pBlob->p_data, (SG_uint32) pBlob->len)  );
+        pOut->bytes_queued -= pBlob->len;
+    }
+
+    x_blob__reset(pCtx, pBlob);
+    pOut->head++;
+
+fail:
+    if (b_locked)
+    {
+        (void)SG_mutex__unlock__bare(&pOut->mutex);
+    }
+}
+
+/**
+ * Write every blob at the front of the queue that has already
+ * been fetched.
+ */
+static void x_out__write_done(
+    SG_context* pCtx,
+    struct sg_fast_export_out* pOut
+    )
+{
+    SG_bool b_done = SG_FALSE;
+
+    while (pOut->head != pOut->tail)
+    {
+        SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pOut->mutex)  );
+        b_done = (sg_FAST_EXPORT__BLOB__DONE == x_BLOB(pOut, pOut->head)->state);
+        SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pOut->mutex)  );
+
+        if (!b_done)
+        {
+            break;
+        }
+        SG_ERR_CHECK(  x_out__write_oldest(pCtx, pOut)  );
+    }
+
+fail:
+    ;
+}
+
+/**
+ * Queue the contents of a blob.  The caller has already written
+ * the "data" header.
+ */
+static void x_out__blob(
+    SG_context* pCtx,
+    struct sg_fast_export_out* pOut,
+    const char* psz_hid,
+    SG_uint64 len
+    )
+{
+    struct sg_fast_export_blob* pBlob = NULL;
+    SG_bool b_stream = (len > sg_FAST_EXPORT__MAX_BLOB_BYTES);
+
+    // make room
+    while (
+            (pOut->head != pOut->tail)
+            && (
+                ((pOut->tail - pOut->head) >= sg_FAST_EXPORT__MAX_QUEUED_BLOBS)
+                || (!b_stream && ((pOut->bytes_queued + len) > sg_FAST_EXPORT__MAX_QUEUED_BYTES))
+               )
+          )
+    {
+        SG_ERR_CHECK(  x_out__write_oldest(pCtx, pOut)  );
+    }
+
+    // nobody else looks at this slot until we bump tail
+    pBlob = x_BLOB(pOut, pOut->tail);
+    SG_ERR_CHECK(  SG_STRDUP(pCtx, psz_hid, &pBlob->psz_hid)  );
+    pBlob->len = len;
+    pBlob->b_stream = b_stream;
+    pBlob->pstr_before = pOut->pstr_text;
+    pOut->pstr_text = NULL;
+    SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pOut->pstr_text)  );
+    pBlob->state = sg_FAST_EXPORT__BLOB__QUEUED;
+
+    SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pOut->mutex)  );
+    pOut->tail++;
+    SG_ERR_CHECK(  SG_thread_cond__broadcast(pCtx, &pOut->cond)  );
+    SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pOut->mutex)  );
+    if (!b_stream)
+    {
+        pOut->bytes_queued += len;
+    }
+    pBlob = NULL;
+
+    if (0 == pOut->count_workers)
+    {
+        SG_ERR_CHECK(  x_out__write_oldest(pCtx, pOut)  );
+    }
+    else
+    {
+        SG_ERR_CHECK(  x_out__write_done(pCtx, pOut)  );
+    }
+
+    return;
+
+fail:
+    if (pBlob)
+    {
+        x_blob__reset(pCtx, pBlob);
+    }
+}
+
+/**
+ * Write everything that is still queued.
+ */
+static void x_out__finish(
+    SG_context* pCtx,
+    struct sg_fast_export_out* pOut
+    )
+{
+    while (pOut->head != pOut->tail)
+    {
+        SG_ERR_CHECK(  x_out__write_oldest(pCtx, pOut)  );
+    }
+
+    SG_ERR_CHECK(  x_out__write(pCtx, pOut,
+                (const SG_byte*) SG_string__sz(pOut->pstr_text),
+                SG_string__length_in_bytes(pOut->pstr_text))  );
+    SG_ERR_CHECK(  SG_string__clear(pCtx, pOut->pstr_text)  );
+    SG_ERR_CHECK(  x_out__flush(pCtx, pOut)  );
+
+fail:
+    ;
+}
+
 static void x_get_audits(
         SG_context * pCtx,
         SG_varray* pva,
@@ -132,10 +693,9 @@ fail:
 
 static void write_blobs(
     SG_context * pCtx,
-    SG_repo* pRepo,
     SG_blobset* pbs,
     SG_vhash* pvh_files,
-    SG_file* pfi,
+    struct sg_fast_export_out* pOut,
     SG_vhash* pvh_blobid_to_mark,
     SG_uint32* pi_next_mark
     )
@@ -151,7 +711,6 @@ static void write_blobs(
         const char* psz_hid = NULL;
 
         SG_uint64 len_full = 0;
-        SG_uint64 len_check = 0;
         SG_bool b_already = SG_FALSE;
         SG_int64 my_mark = -1;
 
@@ -171,8 +730,8 @@ static void write_blobs(
                 SG_bool b_found = SG_FALSE;
 
                 my_mark = (*pi_next_mark)++;
-                SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "blob\n")  );
-                SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "mark :%d\n", (int) my_mark)  );
+                SG_ERR_CHECK(  x_out__format(pCtx, pOut, "blob\n")  );
+                SG_ERR_CHECK(  x_out__format(pCtx, pOut, "mark :%d\n", (int) my_mark)  );
                 SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvh_blobid_to_mark, psz_hid, my_mark)  );
                 SG_ERR_CHECK(  SG_blobset__lookup(
                             pCtx, 
@@ -186,15 +745,9 @@ static void write_blobs(
                             &len_full, 
                             NULL
                             )  );
-                SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "data %d\n", (SG_uint32) len_full)  ); // TODO 64 bit int
-                SG_ERR_CHECK(  SG_repo__fetch_blob_into_file(
-                            pCtx, 
-                            pRepo, 
-                            psz_hid, 
-                            pfi,
-                            &len_check
-                            )  );
-                SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "\n")  );
+                SG_ERR_CHECK(  x_out__format(pCtx, pOut, "data %d\n", (SG_uint32) len_full)  ); // TODO 64 bit int
+                SG_ERR_CHECK(  x_out__blob(pCtx, pOut, psz_hid, len_full)  );
+                SG_ERR_CHECK(  x_out__format(pCtx, pOut, "\n")  );
             }
         }
     }
@@ -308,6 +861,7 @@ void SG_fast_export__export(
 
     SG_vhash* pvh_paths = NULL;
     SG_blobset* pbs = NULL;
+    struct sg_fast_export_out* pOut = NULL;
 
     SG_NULLARGCHECK_RETURN(psz_repo);
     SG_NULLARGCHECK_RETURN(psz_fi);
@@ -380,6 +934,7 @@ void SG_fast_export__export(
 
     SG_ERR_CHECK(  SG_pathname__alloc__sz(pCtx, &pPath_fi, psz_fi)  );
 	SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath_fi, SG_FILE_WRONLY | SG_FILE_CREATE_NEW, 0644, &pfi)  );
+    SG_ERR_CHECK(  x_out__alloc(pCtx, pRepo, pfi, &pOut)  );
 
     /*
 
@@ -496,10 +1051,10 @@ void SG_fast_export__export(
 #endif
             SG_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvh_deltas, "add", &pvh_add)  );
             SG_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvh_deltas, "del", &pvh_del)  );
-            SG_ERR_CHECK(  write_blobs(pCtx, pRepo, pbs, pvh_add, pfi, pvh_blobid_to_mark, &next_mark)  );
+            SG_ERR_CHECK(  write_blobs(pCtx, pbs, pvh_add, pOut, pvh_blobid_to_mark, &next_mark)  );
         }
 
-        //SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "# csid %s from %s\n", psz_csid_current, psz_csid_parent_from)  );
+        //SG_ERR_CHECK(  x_out__format(pCtx, pOut, "# csid %s from %s\n", psz_csid_current, psz_csid_parent_from)  );
 
         // hmmph.  the git-fast-import spec says that a branch name can
         // have spaces in it, but git itself barfs.
@@ -513,10 +1068,10 @@ void SG_fast_export__export(
             SG_UINT32_MAX,SG_TRUE,
             NULL
             )  );
-        SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "commit refs/heads/%s\n", SG_string__sz(pstr_branch_name))  );
+        SG_ERR_CHECK(  x_out__format(pCtx, pOut, "commit refs/heads/%s\n", SG_string__sz(pstr_branch_name))  );
         SG_STRING_NULLFREE(pCtx, pstr_branch_name);
 
-        SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "mark :%d\n", next_mark)  );
+        SG_ERR_CHECK(  x_out__format(pCtx, pOut, "mark :%d\n", next_mark)  );
         SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvh_csid_to_commit_mark, psz_csid_current, next_mark)  );
         next_mark++;
 
@@ -535,7 +1090,7 @@ void SG_fast_export__export(
             }
 
             SG_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvh_a, "timestamp", &timestamp)  );
-            SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "committer <%s> %d +0000\n", psz_username, (SG_int32) (timestamp / 1000))  );
+            SG_ERR_CHECK(  x_out__format(pCtx, pOut, "committer <%s> %d +0000\n", psz_username, (SG_int32) (timestamp / 1000))  );
         }
         else
         {
@@ -545,12 +1100,12 @@ void SG_fast_export__export(
         SG_ERR_CHECK(  SG_vhash__check__sz(pCtx, pvh_comments, psz_csid_current, &psz_comment)  );
         if (psz_comment)
         {
-            SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "data %d\n", SG_STRLEN(psz_comment))  );
-            SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "%s\n", psz_comment)  );
+            SG_ERR_CHECK(  x_out__format(pCtx, pOut, "data %d\n", SG_STRLEN(psz_comment))  );
+            SG_ERR_CHECK(  x_out__format(pCtx, pOut, "%s\n", psz_comment)  );
         }
         else
         {
-            SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "data 0\n")  );
+            SG_ERR_CHECK(  x_out__format(pCtx, pOut, "data 0\n")  );
         }
 
         if (i_changeset > 1)
@@ -560,12 +1115,12 @@ void SG_fast_export__export(
                 SG_int32 mark = -1;
 
                 SG_ERR_CHECK(  SG_vhash__get__int32(pCtx, pvh_csid_to_commit_mark, psz_csid_parent_from, &mark)  );
-                SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "from :%d\n", mark)  );
+                SG_ERR_CHECK(  x_out__format(pCtx, pOut, "from :%d\n", mark)  );
 
                 if (psz_csid_parent_merge)
                 {
                     SG_ERR_CHECK(  SG_vhash__get__int32(pCtx, pvh_csid_to_commit_mark, psz_csid_parent_merge, &mark)  );
-                    SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "merge :%d\n", mark)  );
+                    SG_ERR_CHECK(  x_out__format(pCtx, pOut, "merge :%d\n", mark)  );
                 }
             }
         }
@@ -589,7 +1144,7 @@ void SG_fast_export__export(
                     SG_ERR_CHECK(  get_contents(pCtx, psz_path, pvh_manifest, &pvh_dir_contents)  );
                     if (!pvh_dir_contents)
                     {
-                        //SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "# already empty %s\n", 2+psz_path)  );
+                        //SG_ERR_CHECK(  x_out__format(pCtx, pOut, "# already empty %s\n", 2+psz_path)  );
                     }
                     else
                     {
@@ -620,7 +1175,7 @@ void SG_fast_export__export(
                                 SG_ERR_CHECK(  SG_vhash__remove(pCtx, pvh_manifest, psz_path_item)  );
                                 SG_ERR_CHECK(  SG_vhash__update__null(pCtx, pvh_manifest, SG_string__sz(pstr_new_path))  );
                                 
-                                SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "R %s %s\n", 2+psz_path_item, SG_string__sz(pstr_new_path))  );
+                                SG_ERR_CHECK(  x_out__format(pCtx, pOut, "R %s %s\n", 2+psz_path_item, SG_string__sz(pstr_new_path))  );
 
                                 SG_STRING_NULLFREE(pCtx, pstr_new_path);
                             }
@@ -635,7 +1190,7 @@ void SG_fast_export__export(
 
                                 SG_ERR_CHECK(  SG_vhash__remove(pCtx, pvh_manifest, psz_path_item)  );
 
-                                SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "D %s\n", 2+psz_path_item)  );
+                                SG_ERR_CHECK(  x_out__format(pCtx, pOut, "D %s\n", 2+psz_path_item)  );
                             }
                         }
 
@@ -651,11 +1206,11 @@ void SG_fast_export__export(
                     if (psz_tid)
                     {
                         SG_ERR_CHECK(  SG_vhash__update__null(pCtx, pvh_manifest, psz_tid)  );
-                        SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "R %s %s\n", 2+psz_path, psz_tid)  );
+                        SG_ERR_CHECK(  x_out__format(pCtx, pOut, "R %s %s\n", 2+psz_path, psz_tid)  );
                     }
                     else
                     {
-                        SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "D %s\n", 2+psz_path)  );
+                        SG_ERR_CHECK(  x_out__format(pCtx, pOut, "D %s\n", 2+psz_path)  );
                     }
                 }
             }
@@ -700,7 +1255,7 @@ void SG_fast_export__export(
                             SG_ERR_CHECK(  SG_vhash__remove(pCtx, pvh_manifest, psz_path_item)  );
                             SG_ERR_CHECK(  SG_vhash__update__null(pCtx, pvh_manifest, SG_string__sz(pstr_new_path))  );
 
-                            SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "R %s %s\n", psz_path_item, 2+SG_string__sz(pstr_new_path))  );
+                            SG_ERR_CHECK(  x_out__format(pCtx, pOut, "R %s %s\n", psz_path_item, 2+SG_string__sz(pstr_new_path))  );
                             
                             SG_STRING_NULLFREE(pCtx, pstr_new_path);
                         }
@@ -717,7 +1272,7 @@ void SG_fast_export__export(
                             SG_ERR_CHECK(  SG_vhash__remove(pCtx, pvh_manifest, psz_mv)  );
                             SG_ERR_CHECK(  SG_vhash__update__null(pCtx, pvh_manifest, psz_path)  );
 
-                            SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "R %s %s\n", psz_mv, 2+psz_path)  );
+                            SG_ERR_CHECK(  x_out__format(pCtx, pOut, "R %s %s\n", psz_mv, 2+psz_path)  );
                         }
                     }
                 }
@@ -728,7 +1283,7 @@ void SG_fast_export__export(
                 {
                     if (0 == strcmp(psz_op, "mkdir"))
                     {
-                        //SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "# mkdir %s\n", 2+psz_path)  );
+                        //SG_ERR_CHECK(  x_out__format(pCtx, pOut, "# mkdir %s\n", 2+psz_path)  );
                     }
                     else if (0 == strcmp(psz_op, "file"))
                     {
@@ -740,7 +1295,7 @@ void SG_fast_export__export(
                         SG_ERR_CHECK(  SG_vhash__get__int32(pCtx, pvh_blobid_to_mark, psz_hid, &my_mark)  );
 
                         // TODO 100755 for executables
-                        SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "M %s :%d %s\n", "100644", (int) my_mark, 2 + psz_path)  );
+                        SG_ERR_CHECK(  x_out__format(pCtx, pOut, "M %s :%d %s\n", "100644", (int) my_mark, 2 + psz_path)  );
                         SG_ERR_CHECK(  SG_vhash__update__null(pCtx, pvh_manifest, psz_path)  );
                     }
                     else if (0 == strcmp(psz_op, "symlink"))
@@ -752,7 +1307,7 @@ void SG_fast_export__export(
 
                         SG_ERR_CHECK(  SG_vhash__get__int32(pCtx, pvh_blobid_to_mark, psz_hid, &my_mark)  );
 
-                        SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "M %s :%d %s\n", "120000", (int) my_mark, 2 + psz_path)  );
+                        SG_ERR_CHECK(  x_out__format(pCtx, pOut, "M %s :%d %s\n", "120000", (int) my_mark, 2 + psz_path)  );
                         SG_ERR_CHECK(  SG_vhash__update__null(pCtx, pvh_manifest, psz_path)  );
                     }
                     else
@@ -763,7 +1318,7 @@ void SG_fast_export__export(
             }
         }
 
-        SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "\n")  );
+        SG_ERR_CHECK(  x_out__format(pCtx, pOut, "\n")  );
 
         if (count_branch_names > 1)
         {
@@ -787,10 +1342,10 @@ void SG_fast_export__export(
                         SG_UINT32_MAX,SG_TRUE,
                         NULL
                         )  );
-                    SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "reset refs/heads/%s\n", SG_string__sz(pstr_branch_name))  );
+                    SG_ERR_CHECK(  x_out__format(pCtx, pOut, "reset refs/heads/%s\n", SG_string__sz(pstr_branch_name))  );
                     SG_ERR_CHECK(  SG_vhash__get__int32(pCtx, pvh_csid_to_commit_mark, psz_csid_current, &mark)  );
-                    SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "from :%d\n", mark)  );
-                    SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "\n")  );
+                    SG_ERR_CHECK(  x_out__format(pCtx, pOut, "from :%d\n", mark)  );
+                    SG_ERR_CHECK(  x_out__format(pCtx, pOut, "\n")  );
                     SG_STRING_NULLFREE(pCtx, pstr_branch_name);
                 }
             }
@@ -856,12 +1411,12 @@ void SG_fast_export__export(
             SG_UINT32_MAX,SG_TRUE,
             NULL
             )  );
-        SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "tag %s\n", SG_string__sz(pstr_branch_name))  );
+        SG_ERR_CHECK(  x_out__format(pCtx, pOut, "tag %s\n", SG_string__sz(pstr_branch_name))  );
         SG_STRING_NULLFREE(pCtx, pstr_branch_name);
-        SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "from :%d\n", mark)  );
-        SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "tagger <%s> %d +0000\n", psz_username, (SG_int32) (timestamp / 1000))  );
-        SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "data 0\n")  );
-        SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "\n")  );
+        SG_ERR_CHECK(  x_out__format(pCtx, pOut, "from :%d\n", mark)  );
+        SG_ERR_CHECK(  x_out__format(pCtx, pOut, "tagger <%s> %d +0000\n", psz_username, (SG_int32) (timestamp / 1000))  );
+        SG_ERR_CHECK(  x_out__format(pCtx, pOut, "data 0\n")  );
+        SG_ERR_CHECK(  x_out__format(pCtx, pOut, "\n")  );
     }
 
     {
@@ -889,12 +1444,15 @@ void SG_fast_export__export(
                 SG_UINT32_MAX,SG_TRUE,
                 NULL
                 )  );
-            SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "reset refs/heads/%s\n", SG_string__sz(pstr_branch_name))  );
+            SG_ERR_CHECK(  x_out__format(pCtx, pOut, "reset refs/heads/%s\n", SG_string__sz(pstr_branch_name))  );
             SG_STRING_NULLFREE(pCtx, pstr_branch_name);
-            SG_ERR_CHECK(  SG_file__write__format(pCtx, pfi, "\n")  );
+            SG_ERR_CHECK(  x_out__format(pCtx, pOut, "\n")  );
         }
     }
 
+    SG_ERR_CHECK(  x_out__finish(pCtx, pOut)  );
+    SG_ERR_CHECK(  x_out__stop(pCtx, pOut)  );
+
 fail:
     while (count_pop)
     {
@@ -904,6 +1462,7 @@ fail:
     SG_VHASH_NULLFREE(pCtx, pvh_pile);
     SG_STRING_NULLFREE(pCtx, pstr_new_path);
     SG_VHASH_NULLFREE(pCtx, pvh_dir_contents);
+    x_out__free(pCtx, pOut);
     SG_ERR_IGNORE(  SG_file__close(pCtx, &pfi)  );
     SG_BLOBSET_NULLFREE(pCtx, pbs);
     SG_STRING_NULLFREE(pCtx, pstr_branch_name);
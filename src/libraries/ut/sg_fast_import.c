@@ -16,6 +16,7 @@ limitations under the License.
 
 #include <sg.h>
 #include <sghash.h>
+#include <zlib.h>
 
 #include <sg_vv2__public_typedefs.h>
 #include <sg_vv2__public_prototypes.h>
@@ -37,6 +38,7 @@ struct sg_fast_import_state
     SG_uint32 count_commits;
     SG_uint32 count_done;
     char* psz_initial_csid;
+    struct sg_fast_import_pool* pPool; // pass 2 only
 };
 
 struct node
@@ -103,34 +105,27 @@ struct sg_pending_commit
     SG_int64 time_end;
 };
 
-static void store_blob(
+/**
+ * Start a Git-style SHA1 hash of a blob: "blob LENGTH\0" followed
+ * by the contents, which the caller adds.
+ */
+static void x_git_hash__begin(
 	SG_context* pCtx,
-    struct sg_fast_import_state* pst,
     SG_uint64 len,
-    char** ppsz_hid
+    SGHASH_handle** pphh
 	)
 {
-	SG_uint32 sofar = 0;
-	SG_uint32 got = 0;
-	SG_repo_store_blob_handle* pbh = NULL;
 	SGHASH_handle* phh = NULL;
 	SG_error err = SG_ERR_OK;
 	SG_int_to_string_buffer intbuf;
 	char psz_git_header[27]; // length of int_to_string_buffer (21) + remaining header chars
-	char psz_git_hash[41];
-	const char* psz_existing_hid = NULL;
-
-	SG_NULLARGCHECK_RETURN(pst);
 
-	// initialize a handle for generating the blob's Git-style SHA1 hash
-	// we might need to refer to this blob later by that hash
 	err = SGHASH_init("SHA1/160", &phh);
 	if (SG_IS_ERROR(err))
 	{
 		SG_ERR_THROW(err);
 	}
 
-	// hash the Git-style blob header: "blob LENGTH\0"
 	SG_ERR_CHECK(  SG_sprintf(pCtx, psz_git_header, 27u, "blob %s", SG_uint64_to_sz(len, intbuf))  );
 	err = SGHASH_update(phh, (SG_byte*)psz_git_header, SG_STRLEN(psz_git_header) + 1u); // +1 because we WANT the NULL terminator
 	if (SG_IS_ERROR(err))
@@ -138,6 +133,82 @@ static void store_blob(
 		SG_ERR_THROW(err);
 	}
 
+	*pphh = phh;
+	phh = NULL;
+
+fail:
+	if (phh)
+	{
+		SGHASH_abort(&phh);
+	}
+}
+
+/**
+ * Map a blob's Git-style hash to our HID so we can find the blob
+ * later when a commit refers to it by that hash.
+ */
+static void x_remember_git_sha1(
+	SG_context* pCtx,
+    struct sg_fast_import_state* pst,
+    const char* psz_git_hash,
+    const char* psz_hid
+	)
+{
+	const char* psz_existing_hid = NULL;
+
+	SG_ERR_CHECK(  SG_vhash__check__sz(pCtx, pst->pvh_blob_sha1s, psz_git_hash, &psz_existing_hid)  );
+	if (psz_existing_hid == NULL)
+	{
+		SG_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pst->pvh_blob_sha1s, psz_git_hash, psz_hid)  );
+	}
+	else if (strcmp(psz_hid, psz_existing_hid) != 0)
+	{
+		// We've calculated this Git-style hash before.
+		// It SHOULD be indicating the same HID as last time, but it's not.
+		// The only way I can think of that this is possible is that there are
+		// two different blobs that actually have a hash collision on their
+		// Git-style SHA1 hash, but because the destination Veracity repo
+		// is using a different hash algorithm, those HIDs do NOT collide.
+		// Regardless of how it happened, though, we can't continue.
+		// Firstly, how did we get a repo in a Git-compatible format that included
+		// two different blobs with the same Git-style SHA1 hash?  Git shouldn't
+		// allow that, and other systems exporting to a Git format should probably
+		// also have noticed the problem and blown up along the way.
+		// Secondly, we can't very well choose which HID to map to here, and we
+		// can't map to both.  If we look up this Git-style hash later, it needs to
+		// unambiguously indicate a single HID.  In theory we could perhaps keep
+		// importing and hope that this Git-style hash is never referenced later in
+		// the file.  That even seems reasonably likely, since blobs aren't
+		// referenced by hash very frequently.  However, this problem still indicates
+		// a bad import file (containing two blobs with a hash collision) and should
+		// also be so rare as to basically never happen, so I'm not going to bother
+		// trying to handle it any further right now.
+		SG_ERR_THROW2(  SG_ERR_VHASH_DUPLICATEKEY, (pCtx, "Same Git SHA1 (%s) maps to different Veracity HIDs (%s and %s)", psz_git_hash, psz_hid, psz_existing_hid));
+	}
+
+fail:
+	;
+}
+
+static void store_blob(
+	SG_context* pCtx,
+    struct sg_fast_import_state* pst,
+    SG_uint64 len,
+    char** ppsz_hid
+	)
+{
+	SG_uint32 sofar = 0;
+	SG_uint32 got = 0;
+	SG_repo_store_blob_handle* pbh = NULL;
+	SGHASH_handle* phh = NULL;
+	SG_error err = SG_ERR_OK;
+	char psz_git_hash[41];
+
+	SG_NULLARGCHECK_RETURN(pst);
+
+	// we might need to refer to this blob later by its Git-style SHA1 hash
+	SG_ERR_CHECK(  x_git_hash__begin(pCtx, len, &phh)  );
+
     if (!pst->ptx)
     {
         SG_ERR_CHECK(  SG_repo__begin_tx(pCtx, pst->pRepo, &pst->ptx)  );
@@ -187,49 +258,654 @@ static void store_blob(
 		SG_ERR_THROW(err);
 	}
 
-	// map the Git-style hash to our HID
-	// so we can use it to find the blob later
-	SG_ERR_CHECK(  SG_vhash__check__sz(pCtx, pst->pvh_blob_sha1s, psz_git_hash, &psz_existing_hid)  );
-	if (psz_existing_hid == NULL)
+	SG_ERR_CHECK(  x_remember_git_sha1(pCtx, pst, psz_git_hash, *ppsz_hid)  );
+
+	return;
+
+fail:
+	if (pbh)
+    {
+		SG_ERR_IGNORE(  SG_repo__store_blob__abort(pCtx, pst->pRepo, pst->ptx, &pbh)  );
+    }
+	if (phh)
 	{
-		SG_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pst->pvh_blob_sha1s, psz_git_hash, *ppsz_hid)  );
+		SGHASH_abort(&phh);
 	}
-	else if (strcmp(*ppsz_hid, psz_existing_hid) != 0)
+}
+
+//////////////////////////////////////////////////////////////////
+
+/*
+ * In pass 2 the blobs are hashed and compressed by an SG_thread_pool
+ * while we keep parsing.  We read each blob into
+ * memory and queue it.  A worker computes both its Git-style SHA1
+ * and its HID and deflates it.  Then we (we own the repo tx) store
+ * the compressed bytes under the known HID, so the repo doesn't
+ * hash or compress them again.
+ *
+ * Jobs are stored in the order they were queued, but only when we
+ * need to: when the queue is full, or when a commit refers to a mark
+ * that is still in the queue.  Blobs that are too big to hold in
+ * memory skip the queue and go through store_blob().
+ *
+ * Blobs are stored ZLIB, just as the repo would have stored them.
+ * Deltifying them is left to "vv clone --pack" afterward.
+ */
+
+// The parser keeps one processor busy.  Beyond this many workers
+// we are waiting on the disk anyway.
+#define sg_FAST_IMPORT__MAX_THREADS			(8)
+
+#define sg_FAST_IMPORT__MAX_QUEUED_JOBS		(256)
+#define sg_FAST_IMPORT__MAX_QUEUED_BYTES	(128 * 1024 * 1024)
+#define sg_FAST_IMPORT__MAX_JOB_BYTES		(16 * 1024 * 1024)
+
+#define sg_FAST_IMPORT__JOB__QUEUED			(0)
+#define sg_FAST_IMPORT__JOB__WORKING		(1)
+#define sg_FAST_IMPORT__JOB__DONE			(2)
+
+struct sg_fast_import_job
+{
+    SG_uint32 state;            // protected by the mutex
+    char buf_mark[32];          // empty if the blob has no mark
+    SG_byte* p_full;            // freed once it has been compressed
+    SG_uint32 len_full;
+    SG_byte* p_encoded;
+    SG_uint32 len_encoded;
+    char* psz_hid;
+    char buf_git_hash[41];
+};
+
+struct sg_fast_import_pool
+{
+    char* psz_hash_method;
+
+    SG_mutex mutex;
+    SG_bool b_mutex;
+
+    // Broadcast whenever tail, a job's state, b_quit or b_abort
+    // changes, so that nobody has to poll the queue.
+    SG_thread_cond cond;
+    SG_bool b_cond;
+
+    // Jobs are numbered in the order they were queued.  Job n lives
+    // in a_jobs[n % sg_FAST_IMPORT__MAX_QUEUED_JOBS].  Only the parser
+    // changes head and tail, so it can read them without the mutex.
+    struct sg_fast_import_job a_jobs[sg_FAST_IMPORT__MAX_QUEUED_JOBS];
+    SG_uint32 head;             // oldest job not yet stored
+    SG_uint32 next;             // next job to hand out (protected by mutex)
+    SG_uint32 tail;             // number of the next job queued (protected by mutex)
+    SG_uint64 bytes_queued;     // parser only
+    SG_bool b_quit;             // protected by mutex
+    SG_bool b_abort;            // a worker failed (protected by mutex)
+
+    SG_thread_pool* pThreads;
+    SG_uint32 count_workers;
+};
+
+#define x_JOB(pPool, n) (&(pPool)->a_jobs[(n) % sg_FAST_IMPORT__MAX_QUEUED_JOBS])
+
+static void x_job__reset(SG_context* pCtx, struct sg_fast_import_job* pJob)
+{
+    SG_NULLFREE(pCtx, pJob->p_full);
+    SG_NULLFREE(pCtx, pJob->p_encoded);
+    SG_NULLFREE(pCtx, pJob->psz_hid);
+    memset(pJob, 0, sizeof(*pJob));
+}
+
+/**
+ * Hash and compress one blob.  This is run by the workers and, when
+ * it is waiting on a job nobody has picked up yet, by the parser.
+ * It touches nothing but the job.
+ */
+static void x_job__do(
+	SG_context* pCtx,
+    const char* psz_hash_method,
+    struct sg_fast_import_job* pJob
+	)
+{
+	SGHASH_handle* phh = NULL;
+	SG_error err = SG_ERR_OK;
+	char buf_hid[SG_HID_MAX_BUFFER_LENGTH];
+	z_stream zs;
+	SG_bool b_zs = SG_FALSE;
+	SG_uint32 len_bound = 0;
+	int zError;
+
+	SG_ERR_CHECK(  x_git_hash__begin(pCtx, pJob->len_full, &phh)  );
+	err = SGHASH_update(phh, pJob->p_full, pJob->len_full);
+	if (SG_IS_ERROR(err))
 	{
-		// We've calculated this Git-style hash before.
-		// It SHOULD be indicating the same HID as last time, but it's not.
-		// The only way I can think of that this is possible is that there are
-		// two different blobs that actually have a hash collision on their
-		// Git-style SHA1 hash, but because the destination Veracity repo
-		// is using a different hash algorithm, those HIDs do NOT collide.
-		// Regardless of how it happened, though, we can't continue.
-		// Firstly, how did we get a repo in a Git-compatible format that included
-		// two different blobs with the same Git-style SHA1 hash?  Git shouldn't
-		// allow that, and other systems exporting to a Git format should probably
-		// also have noticed the problem and blown up along the way.
-		// Secondly, we can't very well choose which HID to map to here, and we
-		// can't map to both.  If we look up this Git-style hash later, it needs to
-		// unambiguously indicate a single HID.  In theory we could perhaps keep
-		// importing and hope that this Git-style hash is never referenced later in
-		// the file.  That even seems reasonably likely, since blobs aren't
-		// referenced by hash very frequently.  However, this problem still indicates
-		// a bad import file (containing two blobs with a hash collision) and should
-		// also be so rare as to basically never happen, so I'm not going to bother
-		// trying to handle it any further right now.
-		SG_ERR_THROW2(  SG_ERR_VHASH_DUPLICATEKEY, (pCtx, "Same Git SHA1 (%s) maps to different Veracity HIDs (%s and %s)", psz_git_hash, *ppsz_hid, psz_existing_hid));
+		SG_ERR_THROW(err);
+	}
+	err = SGHASH_final(&phh, pJob->buf_git_hash, sizeof(pJob->buf_git_hash));
+	if (SG_IS_ERROR(err))
+	{
+		SG_ERR_THROW(err);
+	}
+
+	err = SGHASH_init(psz_hash_method, &phh);
+	if (SG_IS_ERROR(err))
+	{
+		SG_ERR_THROW(err);
+	}
+	err = SGHASH_update(phh, pJob->p_full, pJob->len_full);
+	if (SG_IS_ERROR(err))
+	{
+		SG_ERR_THROW(err);
+	}
+	err = SGHASH_final(&phh, buf_hid, sizeof(buf_hid));
+	if (SG_IS_ERROR(err))
+	{
+		SG_ERR_THROW(err);
+	}
+	SG_ERR_CHECK(  SG_STRDUP(pCtx, buf_hid, &pJob->psz_hid)  );
+
+	// compress it the way the repo would have (see sg_blob_fs3__store_blob__begin)
+	memset(&zs, 0, sizeof(zs));
+	zError = deflateInit(&zs, Z_DEFAULT_COMPRESSION);
+	if (zError != Z_OK)
+	{
+		SG_ERR_THROW(  SG_ERR_ZLIB(zError)  );
+	}
+	b_zs = SG_TRUE;
+
+	len_bound = (SG_uint32) deflateBound(&zs, pJob->len_full);
+	SG_ERR_CHECK(  SG_allocN(pCtx, len_bound, pJob->p_encoded)  );
+
+	zs.next_in = pJob->p_full;
+	zs.avail_in = pJob->len_full;
+	zs.next_out = pJob->p_encoded;
+	zs.avail_out = len_bound;
+	zError = deflate(&zs, Z_FINISH);
+	if (zError != Z_STREAM_END)
+	{
+		SG_ERR_THROW(  SG_ERR_ZLIB((zError == Z_OK) ? Z_BUF_ERROR : zError)  );
+	}
+	pJob->len_encoded = (SG_uint32) zs.total_out;
+
+	SG_NULLFREE(pCtx, pJob->p_full);
+
+fail:
+	if (b_zs)
+	{
+		(void) deflateEnd(&zs);
+	}
+	if (phh)
+	{
+		SGHASH_abort(&phh);
+	}
+}
+
+/**
+ * Take jobs from the queue until we are told to quit or somebody
+ * fails.  The parser queues jobs as it goes, so an empty queue just
+ * means we sleep until it queues another one.
+ */
+static void x_worker__loop(
+	SG_context* pCtx,
+    struct sg_fast_import_pool* pPool
+	)
+{
+	struct sg_fast_import_job* pJob;
+	SG_bool b_quit;
+	SG_bool b_locked = SG_FALSE;
+
+	while (1)
+	{
+		pJob = NULL;
+
+		SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pPool->mutex)  );
+		b_locked = SG_TRUE;
+		while (1)
+		{
+			b_quit = (pPool->b_quit || pPool->b_abort);
+			if (b_quit || (pPool->next != pPool->tail))
+			{
+				break;
+			}
+			SG_ERR_CHECK(  SG_thread_cond__wait(pCtx, &pPool->cond, &pPool->mutex)  );
+		}
+		if (!b_quit)
+		{
+			pJob = x_JOB(pPool, pPool->next++);
+			pJob->state = sg_FAST_IMPORT__JOB__WORKING;
+		}
+		b_locked = SG_FALSE;
+		SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pPool->mutex)  );
+
+		if (b_quit)
+		{
+			break;
+		}
+
+		SG_ERR_CHECK(  x_job__do(pCtx, pPool->psz_hash_method, pJob)  );
+
+		SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pPool->mutex)  );
+		pJob->state = sg_FAST_IMPORT__JOB__DONE;
+		SG_ERR_CHECK(  SG_thread_cond__broadcast(pCtx, &pPool->cond)  );
+		SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pPool->mutex)  );
 	}
 
 	return;
 
+fail:
+	// Tell everybody else to stop.  Our context has the error.
+	if (b_locked || (SG_mutex__lock__bare(&pPool->mutex) == 0))
+	{
+		pPool->b_abort = SG_TRUE;
+		(void)SG_thread_cond__broadcast__bare(&pPool->cond);
+		(void)SG_mutex__unlock__bare(&pPool->mutex);
+	}
+}
+
+static SG_thread_pool__work x_worker__main;
+
+static void x_worker__main(SG_context* pCtx, SG_repo* pRepo, void * pVoidData)
+{
+	SG_UNUSED(pRepo);
+
+	x_worker__loop(pCtx, (struct sg_fast_import_pool*) pVoidData);
+}
+
+/**
+ * Tell the workers to quit and wait for them.  Throws the first
+ * error that any of them hit.  Jobs still queued are left alone.
+ */
+static void x_pool__stop(
+	SG_context* pCtx,
+    struct sg_fast_import_pool* pPool
+	)
+{
+	if (!pPool || !pPool->b_mutex)
+	{
+		return;
+	}
+
+	SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pPool->mutex)  );
+	pPool->b_quit = SG_TRUE;
+	if (pPool->b_cond)
+	{
+		SG_ERR_CHECK(  SG_thread_cond__broadcast(pCtx, &pPool->cond)  );
+	}
+	SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pPool->mutex)  );
+
+	if (pPool->pThreads)
+	{
+		SG_ERR_CHECK(  SG_thread_pool__join(pCtx, pPool->pThreads)  );
+	}
+
+fail:
+	;
+}
+
+static void x_pool__free(
+	SG_context* pCtx,
+    struct sg_fast_import_pool* pPool
+	)
+{
+	SG_uint32 k;
+
+	if (!pPool)
+	{
+		return;
+	}
+
+	// Make sure that no worker is still using our data before we free it.
+	if (pPool->b_mutex && (SG_mutex__lock__bare(&pPool->mutex) == 0))
+	{
+		pPool->b_quit = SG_TRUE;
+		if (pPool->b_cond)
+		{
+			(void)SG_thread_cond__broadcast__bare(&pPool->cond);
+		}
+		(void)SG_mutex__unlock__bare(&pPool->mutex);
+	}
+	SG_THREAD_POOL_NULLFREE(pCtx, pPool->pThreads);
+
+	for (k=0; k<sg_FAST_IMPORT__MAX_QUEUED_JOBS; k++)
+	{
+		x_job__reset(pCtx, &pPool->a_jobs[k]);
+	}
+
+	if (pPool->b_cond)
+	{
+		SG_thread_cond__destroy(&pPool->cond);
+	}
+	if (pPool->b_mutex)
+	{
+		SG_mutex__destroy(&pPool->mutex);
+	}
+	SG_NULLFREE(pCtx, pPool->psz_hash_method);
+	SG_NULLFREE(pCtx, pPool);
+}
+
+/**
+ * The number of workers can be set with the fast_import/threads
+ * setting.  Zero does all the work on the parser's thread.
+ */
+static void x_get_thread_setting(
+	SG_context* pCtx,
+	SG_uint32 count_default,
+	SG_uint32* pCount
+	)
+{
+	char* psz_value = NULL;
+	SG_uint32 count = count_default;
+
+	SG_localsettings__get__sz(pCtx, SG_LOCALSETTING__FAST_IMPORT_THREADS, NULL, &psz_value, NULL);
+	if (!SG_context__has_err(pCtx) && psz_value && *psz_value)
+	{
+		SG_uint32__parse__strict(pCtx, &count, psz_value);
+	}
+	if (SG_context__has_err(pCtx))
+	{
+		SG_log__report_error__current_error(pCtx);
+		SG_context__err_reset(pCtx);
+		count = count_default;
+	}
+
+	SG_NULLFREE(pCtx, psz_value);
+	*pCount = count;
+}
+
+static void x_pool__alloc(
+	SG_context* pCtx,
+    SG_repo* pRepo,
+    struct sg_fast_import_pool** ppPool
+	)
+{
+	struct sg_fast_import_pool* pPool = NULL;
+	SG_uint32 count_processors = 1;
+
+	SG_ERR_CHECK(  SG_alloc1(pCtx, pPool)  );
+	SG_ERR_CHECK(  SG_repo__get_hash_method(pCtx, pRepo, &pPool->psz_hash_method)  );
+
+	SG_ERR_CHECK(  SG_mutex__init(pCtx, &pPool->mutex)  );
+	pPool->b_mutex = SG_TRUE;
+	SG_ERR_CHECK(  SG_thread_cond__init(pCtx, &pPool->cond)  );
+	pPool->b_cond = SG_TRUE;
+
+	SG_ERR_CHECK(  SG_thread__get_processor_count(pCtx, &count_processors)  );
+	SG_ERR_CHECK(  x_get_thread_setting(pCtx, count_processors - 1, &pPool->count_workers)  );
+	pPool->count_workers = SG_MIN(pPool->count_workers, sg_FAST_IMPORT__MAX_THREADS);
+
+	if (pPool->count_workers > 0)
+	{
+		SG_ERR_CHECK(  SG_thread_pool__alloc(pCtx, pPool->count_workers, NULL, x_worker__main, pPool, &pPool->pThreads)  );
+		SG_ERR_CHECK(  SG_thread_pool__start(pCtx, pPool->pThreads)  );
+	}
+
+	*ppPool = pPool;
+	pPool = NULL;
+
+fail:
+	x_pool__free(pCtx, pPool);
+}
+
+/**
+ * Store a finished job into the repo and remember its mark and its
+ * Git-style hash.
+ */
+static void x_pool__store_job(
+	SG_context* pCtx,
+    struct sg_fast_import_state* pst,
+    struct sg_fast_import_job* pJob
+	)
+{
+	SG_repo_store_blob_handle* pbh = NULL;
+	char* psz_hid = NULL;
+
+    if (!pst->ptx)
+    {
+        SG_ERR_CHECK(  SG_repo__begin_tx(pCtx, pst->pRepo, &pst->ptx)  );
+    }
+
+	SG_ERR_CHECK(  SG_repo__store_blob__begin(
+                pCtx, 
+                pst->pRepo, 
+                pst->ptx, 
+                SG_BLOBENCODING__ZLIB, 
+                NULL, 
+                pJob->len_full, 
+                pJob->len_encoded, 
+                pJob->psz_hid, 
+                &pbh)  );
+	SG_ERR_CHECK(  SG_repo__store_blob__chunk(pCtx, pst->pRepo, pbh, pJob->len_encoded, pJob->p_encoded, NULL)  );
+	SG_ERR_CHECK(  SG_repo__store_blob__end(pCtx, pst->pRepo, pst->ptx, &pbh, &psz_hid)  );
+
+	if (pJob->buf_mark[0])
+	{
+		SG_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pst->pvh_blob_marks, pJob->buf_mark, psz_hid)  );
+	}
+	SG_ERR_CHECK(  x_remember_git_sha1(pCtx, pst, pJob->buf_git_hash, psz_hid)  );
+
 fail:
 	if (pbh)
     {
 		SG_ERR_IGNORE(  SG_repo__store_blob__abort(pCtx, pst->pRepo, pst->ptx, &pbh)  );
     }
-	if (phh)
+	SG_NULLFREE(pCtx, psz_hid);
+}
+
+/**
+ * Store the oldest job in the queue, waiting for it if we have to.
+ * If nobody has started on it yet, we do it ourselves.
+ */
+static void x_pool__store_oldest(
+	SG_context* pCtx,
+    struct sg_fast_import_state* pst
+	)
+{
+	struct sg_fast_import_pool* pPool = pst->pPool;
+	struct sg_fast_import_job* pJob = x_JOB(pPool, pPool->head);
+	SG_bool b_abort = SG_FALSE;
+	SG_bool b_mine = SG_FALSE;
+	SG_bool b_locked = SG_FALSE;
+	SG_uint32 state = sg_FAST_IMPORT__JOB__QUEUED;
+
+	SG_ASSERT(pPool->head != pPool->tail);
+
+	SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pPool->mutex)  );
+	b_locked = SG_TRUE;
+	while (1)
 	{
-		SGHASH_abort(&phh);
+		b_abort = pPool->b_abort;
+		state = pJob->state;
+		if (!b_abort && (sg_FAST_IMPORT__JOB__QUEUED == state))
+		{
+			// jobs are handed out in order, so this one must be next
+			SG_ASSERT(pPool->next == pPool->head);
+			pPool->next++;
+			pJob->state = sg_FAST_IMPORT__JOB__WORKING;
+			b_mine = SG_TRUE;
+		}
+		if (b_abort || b_mine || (sg_FAST_IMPORT__JOB__DONE == state))
+		{
+			break;
+		}
+
+		// a worker has it
+		SG_ERR_CHECK(  SG_thread_cond__wait(pCtx, &pPool->cond, &pPool->mutex)  );
+	}
+	b_locked = SG_FALSE;
+	SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pPool->mutex)  );
+
+	if (b_abort)
+	{
+		SG_ERR_CHECK(  x_pool__stop(pCtx, pPool)  );
+		SG_ERR_THROW(  SG_ERR_UNSPECIFIED  );
+	}
+	if (b_mine)
+	{
+		SG_ERR_CHECK(  x_job__do(pCtx, pPool->psz_hash_method, pJob)  );
 	}
+
+	SG_ERR_CHECK(  x_pool__store_job(pCtx, pst, pJob)  );
+
+	pPool->bytes_queued -= pJob->len_full;
+	x_job__reset(pCtx, pJob);
+	pPool->head++;
+
+fail:
+	if (b_locked)
+	{
+		(void)SG_mutex__unlock__bare(&pPool->mutex);
+	}
+}
+
+/**
+ * Store every job at the front of the queue that is already done.
+ */
+static void x_pool__store_done(
+	SG_context* pCtx,
+    struct sg_fast_import_state* pst
+	)
+{
+	struct sg_fast_import_pool* pPool = pst->pPool;
+	SG_bool b_done = SG_FALSE;
+
+	while (pPool->head != pPool->tail)
+	{
+		SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pPool->mutex)  );
+		b_done = (sg_FAST_IMPORT__JOB__DONE == x_JOB(pPool, pPool->head)->state);
+		SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pPool->mutex)  );
+
+		if (!b_done)
+		{
+			break;
+		}
+		SG_ERR_CHECK(  x_pool__store_oldest(pCtx, pst)  );
+	}
+
+fail:
+	;
+}
+
+/**
+ * Read the next len bytes of the stream into a new job.
+ */
+static void x_pool__queue(
+	SG_context* pCtx,
+    struct sg_fast_import_state* pst,
+    const char* psz_mark,
+    SG_uint32 len
+	)
+{
+	struct sg_fast_import_pool* pPool = pst->pPool;
+	struct sg_fast_import_job* pJob = NULL;
+	SG_uint32 sofar = 0;
+	SG_uint32 got = 0;
+
+	// make room
+	while (
+			(pPool->head != pPool->tail)
+			&& (
+				((pPool->tail - pPool->head) >= sg_FAST_IMPORT__MAX_QUEUED_JOBS)
+				|| ((pPool->bytes_queued + len) > sg_FAST_IMPORT__MAX_QUEUED_BYTES)
+			   )
+		  )
+	{
+		SG_ERR_CHECK(  x_pool__store_oldest(pCtx, pst)  );
+	}
+
+	// nobody else looks at this slot until we bump tail
+	pJob = x_JOB(pPool, pPool->tail);
+	if (psz_mark)
+	{
+		SG_ERR_CHECK(  SG_strcpy(pCtx, pJob->buf_mark, sizeof(pJob->buf_mark), psz_mark)  );
+	}
+	pJob->len_full = len;
+	SG_ERR_CHECK(  SG_allocN(pCtx, (len ? len : 1), pJob->p_full)  );
+	while (sofar < len)
+	{
+		SG_ERR_CHECK(  SG_file__read(pCtx, pst->pfi, len - sofar, pJob->p_full + sofar, &got)  );
+		sofar += got;
+	}
+	pJob->state = sg_FAST_IMPORT__JOB__QUEUED;
+
+	SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pPool->mutex)  );
+	pPool->tail++;
+	SG_ERR_CHECK(  SG_thread_cond__broadcast(pCtx, &pPool->cond)  );
+	SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pPool->mutex)  );
+	pPool->bytes_queued += len;
+	pJob = NULL;
+
+	if (0 == pPool->count_workers)
+	{
+		SG_ERR_CHECK(  x_pool__store_oldest(pCtx, pst)  );
+	}
+	else
+	{
+		SG_ERR_CHECK(  x_pool__store_done(pCtx, pst)  );
+	}
+
+	return;
+
+fail:
+	if (pJob)
+	{
+		x_job__reset(pCtx, pJob);
+	}
+}
+
+/**
+ * If the blob with this mark is still in the queue, store it (and
+ * everything queued before it).
+ */
+static void x_pool__wait_for_mark(
+	SG_context* pCtx,
+    struct sg_fast_import_state* pst,
+    const char* psz_mark
+	)
+{
+	struct sg_fast_import_pool* pPool = pst->pPool;
+	SG_uint32 n;
+	SG_uint32 count = 0;
+
+	if (!pPool)
+	{
+		return;
+	}
+
+	// if a mark was reused, the latest definition wins
+	for (n = pPool->head; n != pPool->tail; n++)
+	{
+		if (0 == strcmp(x_JOB(pPool, n)->buf_mark, psz_mark))
+		{
+			count = n - pPool->head + 1;
+		}
+	}
+
+	while (count--)
+	{
+		SG_ERR_CHECK(  x_pool__store_oldest(pCtx, pst)  );
+	}
+
+fail:
+	;
+}
+
+/**
+ * Store everything in the queue.
+ */
+static void x_pool__finish(
+	SG_context* pCtx,
+    struct sg_fast_import_state* pst
+	)
+{
+	if (!pst->pPool)
+	{
+		return;
+	}
+
+	while (pst->pPool->head != pst->pPool->tail)
+	{
+		SG_ERR_CHECK(  x_pool__store_oldest(pCtx, pst)  );
+	}
+
+fail:
+	;
 }
 
 static void x_skip_optional_lf(
@@ -499,16 +1175,27 @@ static void x_do__blob(
 
         // TODO check len > 0
 
-        SG_ERR_CHECK(  store_blob(pCtx,
-                    pst,
-                    len,
-                    &psz_hid)  );
-        if (idnum)
+        if (pst->pPool && (len <= sg_FAST_IMPORT__MAX_JOB_BYTES))
+        {
+            // the mark is stored along with the blob
+            SG_ERR_CHECK(  x_pool__queue(pCtx,
+                        pst,
+                        (idnum ? buf_idnum : NULL),
+                        (SG_uint32) len)  );
+        }
+        else
         {
-            // store the mark
-            SG_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pst->pvh_blob_marks, buf_idnum, psz_hid)  );
+            SG_ERR_CHECK(  store_blob(pCtx,
+                        pst,
+                        len,
+                        &psz_hid)  );
+            if (idnum)
+            {
+                // store the mark
+                SG_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pst->pvh_blob_marks, buf_idnum, psz_hid)  );
+            }
+            SG_NULLFREE(pCtx, psz_hid);
         }
-        SG_NULLFREE(pCtx, psz_hid);
     }
 
     SG_ERR_CHECK(  x_skip_optional_lf(pCtx, pst)  );
@@ -2084,6 +2771,7 @@ static void x_commit__filemodify(
 
     if (':' == pline->words[2][0])
     {
+        SG_ERR_CHECK(  x_pool__wait_for_mark(pCtx, pst, pline->words[2])  );
         SG_ERR_CHECK(  SG_vhash__get__sz(pCtx, pst->pvh_blob_marks, pline->words[2], &psz_hid)  );
     }
     else if (0 == strcmp("inline", pline->words[2]))
@@ -2112,6 +2800,14 @@ static void x_commit__filemodify(
     }
 	else if (SG_STRLEN(pline->words[2]) == 40u)
 	{
+		SG_bool b_found = SG_FALSE;
+
+		// we don't know the Git-style hash of a queued blob until it has been stored
+		SG_ERR_CHECK(  SG_vhash__has(pCtx, pst->pvh_blob_sha1s, pline->words[2], &b_found)  );
+		if (!b_found)
+		{
+			SG_ERR_CHECK(  x_pool__finish(pCtx, pst)  );
+		}
 		SG_ERR_CHECK(  SG_vhash__get__sz(pCtx, pst->pvh_blob_sha1s, pline->words[2], &psz_hid)  );
 	}
     else
@@ -3239,6 +3935,7 @@ static void x_do__tag(
 		{
 			// Git tags can also reference arbitrary blobs, so check our blob marks
 			// this merely determines whether or not the import file is malformed
+			SG_ERR_CHECK(  x_pool__wait_for_mark(pCtx, pst, line.words[1])  );
 			SG_ERR_CHECK(  SG_vhash__has(pCtx, pst->pvh_blob_marks, line.words[1], &b_found)  );
 			if (b_found == SG_FALSE)
 			{
@@ -3834,11 +4531,14 @@ void SG_fast_import__import(
 
     // pass 2
     SG_ERR_CHECK(  SG_file__seek(pCtx, st.pfi, 0)  );
+    SG_ERR_CHECK(  x_pool__alloc(pCtx, st.pRepo, &st.pPool)  );
     st.b_done = SG_FALSE;
     while (!st.b_done)
     {
         SG_ERR_CHECK(  x_do_one_command(pCtx, &st)  );
     }
+    SG_ERR_CHECK(  x_pool__finish(pCtx, &st)  );
+    SG_ERR_CHECK(  x_pool__stop(pCtx, st.pPool)  );
     SG_ERR_CHECK(  SG_log__pop_operation(pCtx)  );
     count_pop--;
 
@@ -3867,6 +4567,7 @@ fail:
         SG_ERR_IGNORE(  SG_log__pop_operation(pCtx)  );
         count_pop--;
     }
+    x_pool__free(pCtx, st.pPool);
     SG_REPO_NULLFREE(pCtx, st.pRepo);
     if (!b_success && b_created)
     {
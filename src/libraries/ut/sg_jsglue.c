@@ -2118,6 +2118,84 @@ fail:
 	return JS_FALSE;
 }
 
+/**
+ * sg.server.cache_get(etag, key)
+ *
+ * The cached text for an ETag from repo.cache_etag(), or null.
+ */
+SG_JSGLUE_METHOD_PROTOTYPE(server, cache_get)
+{
+	SG_context * pCtx = SG_jsglue__get_clean_sg_context(cx);
+	jsval * argv = JS_ARGV(cx, vp);
+	char * szEtag = NULL;
+	char * szKey = NULL;
+	SG_string * pstrText = NULL;
+	jsval jv;
+
+	SG_JS_BOOL_CHECK(argc==2);
+	SG_JS_BOOL_CHECK(JSVAL_IS_STRING(argv[0]) && JSVAL_IS_STRING(argv[1]));
+
+	SG_ERR_CHECK(  sg_jsglue__jsstring_to_sz(pCtx, cx, JSVAL_TO_STRING(argv[0]), &szEtag)  );
+	SG_ERR_CHECK(  sg_jsglue__jsstring_to_sz(pCtx, cx, JSVAL_TO_STRING(argv[1]), &szKey)  );
+
+	SG_ERR_CHECK(  SG_responsecache__get(pCtx, szEtag, szKey, &pstrText)  );
+	if (pstrText)
+	{
+		JSVAL_FROM_SZ(jv, SG_string__sz(pstrText));
+		JS_SET_RVAL(cx, vp, jv);
+	}
+	else
+	{
+		JS_SET_RVAL(cx, vp, JSVAL_NULL);
+	}
+
+	SG_NULLFREE(pCtx, szEtag);
+	SG_NULLFREE(pCtx, szKey);
+	SG_STRING_NULLFREE(pCtx, pstrText);
+	return JS_TRUE;
+
+fail:
+	SG_jsglue__report_sg_error(pCtx,cx); // DO NOT SG_ERR_IGNORE() THIS
+	SG_NULLFREE(pCtx, szEtag);
+	SG_NULLFREE(pCtx, szKey);
+	SG_STRING_NULLFREE(pCtx, pstrText);
+	return JS_FALSE;
+}
+
+/**
+ * sg.server.cache_put(etag, key, text)
+ */
+SG_JSGLUE_METHOD_PROTOTYPE(server, cache_put)
+{
+	SG_context * pCtx = SG_jsglue__get_clean_sg_context(cx);
+	jsval * argv = JS_ARGV(cx, vp);
+	char * szEtag = NULL;
+	char * szKey = NULL;
+	char * szText = NULL;
+
+	SG_JS_BOOL_CHECK(argc==3);
+	SG_JS_BOOL_CHECK(JSVAL_IS_STRING(argv[0]) && JSVAL_IS_STRING(argv[1]) && JSVAL_IS_STRING(argv[2]));
+
+	SG_ERR_CHECK(  sg_jsglue__jsstring_to_sz(pCtx, cx, JSVAL_TO_STRING(argv[0]), &szEtag)  );
+	SG_ERR_CHECK(  sg_jsglue__jsstring_to_sz(pCtx, cx, JSVAL_TO_STRING(argv[1]), &szKey)  );
+	SG_ERR_CHECK(  sg_jsglue__jsstring_to_sz(pCtx, cx, JSVAL_TO_STRING(argv[2]), &szText)  );
+
+	SG_ERR_CHECK(  SG_responsecache__put(pCtx, szEtag, szKey, szText)  );
+
+	SG_NULLFREE(pCtx, szEtag);
+	SG_NULLFREE(pCtx, szKey);
+	SG_NULLFREE(pCtx, szText);
+	JS_SET_RVAL(cx, vp, JSVAL_VOID);
+	return JS_TRUE;
+
+fail:
+	SG_jsglue__report_sg_error(pCtx,cx); // DO NOT SG_ERR_IGNORE() THIS
+	SG_NULLFREE(pCtx, szEtag);
+	SG_NULLFREE(pCtx, szKey);
+	SG_NULLFREE(pCtx, szText);
+	return JS_FALSE;
+}
+
 SG_JSGLUE_METHOD_PROTOTYPE(sg, from_json)
 {
     SG_context * pCtx = SG_jsglue__get_clean_sg_context(cx);
@@ -6949,6 +7027,63 @@ fail:
 	return JS_FALSE;
 }
 
+/**
+ * repo.blob_file_range(hid) returns {path, offset, length} (offset and
+ * length as strings) when the blob's bytes can be read straight out of a
+ * file, so the server can send them with sendfile().  Otherwise null.
+ */
+SG_JSGLUE_METHOD_PROTOTYPE(repo, blob_file_range)
+{
+	SG_context * pCtx = SG_jsglue__get_clean_sg_context(cx);
+	jsval * argv = JS_ARGV(cx, vp);
+	SG_repo* pRepo = NULL;
+	SG_safeptr* psp_repo = NULL;
+	JSObject* jso = NULL;
+	char *psz_blobid = NULL;
+	SG_pathname* pPath = NULL;
+	SG_uint64 offset = 0;
+	SG_uint64 len = 0;
+
+	psp_repo = sg_jsglue__get_object_private(cx, JS_THIS_OBJECT(cx, vp));
+	SG_ERR_CHECK(  SG_safeptr__unwrap__repo(pCtx, psp_repo, &pRepo)  );
+
+	SG_JS_BOOL_CHECK(argc==1);
+	SG_JS_BOOL_CHECK(  JSVAL_IS_STRING(argv[0])  );
+	SG_ERR_CHECK(  sg_jsglue__jsstring_to_sz(pCtx, cx, JSVAL_TO_STRING(argv[0]), &psz_blobid)  );
+
+	SG_ERR_CHECK(  SG_repo__fetch_blob__file_range(pCtx, pRepo, psz_blobid, &pPath, &offset, &len)  );
+
+	if (pPath)
+	{
+		jsval jv;
+		SG_int_to_string_buffer buf_uint64;
+
+		SG_JS_NULL_CHECK(  (jso = JS_NewObject(cx, NULL, NULL, NULL))  );
+		JS_SET_RVAL(cx, vp, OBJECT_TO_JSVAL(jso));
+
+		JSVAL_FROM_SZ(jv, SG_pathname__sz(pPath));
+		SG_JS_BOOL_CHECK(  JS_SetProperty(cx, jso, "path", &jv)  );
+		JSVAL_FROM_SZ(jv, SG_uint64_to_sz(offset, buf_uint64));
+		SG_JS_BOOL_CHECK(  JS_SetProperty(cx, jso, "offset", &jv)  );
+		JSVAL_FROM_SZ(jv, SG_uint64_to_sz(len, buf_uint64));
+		SG_JS_BOOL_CHECK(  JS_SetProperty(cx, jso, "length", &jv)  );
+	}
+	else
+	{
+		JS_SET_RVAL(cx, vp, JSVAL_NULL);
+	}
+
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+	SG_NULLFREE(pCtx, psz_blobid);
+	return JS_TRUE;
+
+fail:
+	SG_jsglue__report_sg_error(pCtx,cx); // DO NOT SG_ERR_IGNORE() THIS
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+	SG_NULLFREE(pCtx, psz_blobid);
+	return JS_FALSE;
+}
+
 /**
  * fetchblobhandle.next_chunk() returns a cbuffer.
  * A cbuffer is essentially an object that is meant to be returned back down to
@@ -8353,6 +8488,68 @@ fail:
     return JS_FALSE;
 }
 
+/**
+ * repo.cache_etag(dags, key)
+ *
+ * The response cache ETag for a response built from the given dags
+ * (an array of dagnums) and identified within the repo by key.
+ */
+SG_JSGLUE_METHOD_PROTOTYPE(repo, cache_etag)
+{
+	SG_context * pCtx = SG_jsglue__get_clean_sg_context(cx);
+	jsval * argv = JS_ARGV(cx, vp);
+	SG_repo* pRepo = NULL;
+	SG_safeptr* psp = sg_jsglue__get_object_private(cx, JS_THIS_OBJECT(cx, vp));
+	SG_varray* pva_dags = NULL;
+	SG_uint64* pa_dagnums = NULL;
+	SG_uint32 count_dags = 0;
+	SG_uint32 i;
+	char* psz_key = NULL;
+	char* psz_etag = NULL;
+	jsval jv;
+
+	SG_JS_BOOL_CHECK(argc==2);
+	SG_JS_BOOL_CHECK(  JSVAL_IS_OBJECT(argv[0]) && !JSVAL_IS_NULL(argv[0]) && JS_IsArrayObject(cx, JSVAL_TO_OBJECT(argv[0]))  );
+	SG_JS_BOOL_CHECK(  JSVAL_IS_STRING(argv[1])  );
+
+	SG_ERR_CHECK(  SG_safeptr__unwrap__repo(pCtx, psp, &pRepo)  );
+
+	SG_ERR_CHECK(  sg_jsglue__jsobject_to_varray(pCtx, cx, JSVAL_TO_OBJECT(argv[0]), &pva_dags)  );
+	SG_ERR_CHECK(  SG_varray__count(pCtx, pva_dags, &count_dags)  );
+	if (count_dags)
+	{
+		SG_ERR_CHECK(  SG_allocN(pCtx, count_dags, pa_dagnums)  );
+		for (i=0; i<count_dags; i++)
+		{
+			const char* psz_dagnum = NULL;
+
+			SG_ERR_CHECK(  SG_varray__get__sz(pCtx, pva_dags, i, &psz_dagnum)  );
+			SG_ERR_CHECK(  SG_dagnum__from_sz__hex(pCtx, psz_dagnum, &pa_dagnums[i])  );
+		}
+	}
+
+	SG_ERR_CHECK(  sg_jsglue__jsstring_to_sz(pCtx, cx, JSVAL_TO_STRING(argv[1]), &psz_key)  );
+
+	SG_ERR_CHECK(  SG_responsecache__get_etag(pCtx, pRepo, pa_dagnums, count_dags, psz_key, &psz_etag)  );
+
+	JSVAL_FROM_SZ(jv, psz_etag);
+	JS_SET_RVAL(cx, vp, jv);
+
+	SG_VARRAY_NULLFREE(pCtx, pva_dags);
+	SG_NULLFREE(pCtx, pa_dagnums);
+	SG_NULLFREE(pCtx, psz_key);
+	SG_NULLFREE(pCtx, psz_etag);
+	return JS_TRUE;
+
+fail:
+	SG_jsglue__report_sg_error(pCtx,cx);	// DO NOT SG_ERR_IGNORE() THIS
+	SG_VARRAY_NULLFREE(pCtx, pva_dags);
+	SG_NULLFREE(pCtx, pa_dagnums);
+	SG_NULLFREE(pCtx, psz_key);
+	SG_NULLFREE(pCtx, psz_etag);
+	return JS_FALSE;
+}
+
 SG_JSGLUE_METHOD_PROTOTYPE(repo, compare)
 {
 	SG_context * pCtx = SG_jsglue__get_clean_sg_context(cx);
@@ -10027,6 +10224,7 @@ static JSFunctionSpec sg_repo_methods[] = {
     {"lookup_audits", 			SG_JSGLUE_METHOD_NAME(repo,lookup_audits),0,0},
     {"create_nobody", 			SG_JSGLUE_METHOD_NAME(repo,create_nobody),0,0},
     {"fetch_dag_leaves", SG_JSGLUE_METHOD_NAME(repo,fetch_dag_leaves),1,0},
+    {"cache_etag", SG_JSGLUE_METHOD_NAME(repo,cache_etag),2,0},
     {"close", SG_JSGLUE_METHOD_NAME(repo,close),0,0},
     {"find_new_dagnodes_since", SG_JSGLUE_METHOD_NAME(repo,find_new_dagnodes_since),1,0},
     {"install_vc_hook", SG_JSGLUE_METHOD_NAME(repo,install_vc_hook),1,0},
@@ -10049,6 +10247,7 @@ static JSFunctionSpec sg_repo_methods[] = {
     {"fetch_json", SG_JSGLUE_METHOD_NAME(repo,fetch_json),1,0},
     {"fetch_blob_into_tempfile", SG_JSGLUE_METHOD_NAME(repo,fetch_blob_into_tempfile),1,0},
     {"fetch_blob", SG_JSGLUE_METHOD_NAME(repo,fetch_blob), 2,0},
+    {"blob_file_range", SG_JSGLUE_METHOD_NAME(repo,blob_file_range), 1,0},
     {"diff_file", SG_JSGLUE_METHOD_NAME(repo,diff_file), 3,0},
     {"diff_file_local", SG_JSGLUE_METHOD_NAME(repo, diff_file_local), 2,0},
     {"get_treenode_info_by_gid", SG_JSGLUE_METHOD_NAME(repo, get_treenode_info_by_gid), 2,0},
@@ -10349,6 +10548,8 @@ static JSFunctionSpec server_methods[] = {
 	{"debug_shutdown", SG_JSGLUE_METHOD_NAME(server,debug_shutdown), 0,0},
 	{"request_profiler_start", SG_JSGLUE_METHOD_NAME(server,request_profiler_start), 1,0},
 	{"request_profiler_stop",  SG_JSGLUE_METHOD_NAME(server,request_profiler_stop),  0,0},
+	{"cache_get", SG_JSGLUE_METHOD_NAME(server,cache_get), 2,0},
+	{"cache_put", SG_JSGLUE_METHOD_NAME(server,cache_put), 3,0},
 	{NULL,NULL,0,0}
 };
 
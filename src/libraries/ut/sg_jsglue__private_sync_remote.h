@@ -176,6 +176,72 @@ fail:
 }
 #undef REQUEST_FRAGBALL_USAGE
 
+/**
+ * sg.sync_remote.request_clone_fragball(repo, create_in_dir, [clone_request_obj])
+ *
+ * Returns an object with the (string) name of the clone fragball and whether it's
+ * stale: { "name" : ..., "stale" : ... }
+ */
+#define REQUEST_CLONE_FRAGBALL_USAGE "Usage: sg.sync_remote.request_clone_fragball(repo, create_in_dir, [clone_request_obj])"
+SG_JSGLUE_METHOD_PROTOTYPE(sync_remote, request_clone_fragball)
+{
+	SG_context * pCtx = SG_jsglue__get_clean_sg_context(cx);
+	jsval * argv = JS_ARGV(cx, vp);
+	SG_safeptr* pspRepo = NULL;
+	SG_repo* pRepo = NULL;
+	SG_pathname* pPathname = NULL;
+	SG_vhash* pvhCloneRequest = NULL;
+	SG_vhash* pvhResult = NULL;
+	char* pszFileName = NULL;
+	SG_bool bStale = SG_FALSE;
+	JSObject* jso = NULL;
+
+	if (argc < 2 || argc > 3)
+		SG_ERR_THROW2(SG_ERR_INVALIDARG, (pCtx, "Expected 2 or 3 arguments.  " REQUEST_CLONE_FRAGBALL_USAGE)  );
+
+	if ( JSVAL_IS_NULL(argv[0]) || !JSVAL_IS_OBJECT(argv[0]) )
+		SG_ERR_THROW2(  SG_ERR_INVALIDARG, (pCtx, "repo must be a repository object.  " REQUEST_CLONE_FRAGBALL_USAGE)  );
+	pspRepo = sg_jsglue__get_object_private(cx, JSVAL_TO_OBJECT(argv[0]));
+	SG_ERR_CHECK(  SG_safeptr__unwrap__repo(pCtx, pspRepo, &pRepo)  );
+
+	if ( !JSVAL_IS_STRING(argv[1]) )
+		SG_ERR_THROW2(  SG_ERR_INVALIDARG, (pCtx, "create_in_dir must be a string.  " REQUEST_CLONE_FRAGBALL_USAGE)  );
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__JSSTRING(pCtx, &pPathname, cx, JSVAL_TO_STRING(argv[1]))  );
+
+	if ( argc == 3 && !JSVAL_IS_VOID(argv[2]) && !JSVAL_IS_NULL(argv[2]) )
+	{
+		if ( !JSVAL_IS_OBJECT(argv[2]) )
+			SG_ERR_THROW2(  SG_ERR_INVALIDARG, (pCtx, "clone_request_obj must be an object.  " REQUEST_CLONE_FRAGBALL_USAGE)  );
+		SG_ERR_CHECK(  sg_jsglue__jsobject_to_vhash(pCtx, cx, JSVAL_TO_OBJECT(argv[2]), &pvhCloneRequest)  );
+	}
+
+	SUSPEND_REQUEST_ERR_CHECK(  SG_sync_remote__request_clone_fragball(pCtx, pRepo, pPathname, pvhCloneRequest, &pszFileName, &bStale)  );
+
+	SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvhResult)  );
+	SG_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pvhResult, "name", pszFileName)  );
+	SG_ERR_CHECK(  SG_vhash__add__bool(pCtx, pvhResult, "stale", bStale)  );
+
+	SG_JS_NULL_CHECK(  (jso = JS_NewObject(cx, NULL, NULL, NULL))  );
+	JS_SET_RVAL(cx, vp, OBJECT_TO_JSVAL(jso));
+	SG_ERR_CHECK(  sg_jsglue__copy_vhash_into_jsobject(pCtx, cx, pvhResult, jso)  );
+
+	SG_VHASH_NULLFREE(pCtx, pvhResult);
+	SG_NULLFREE(pCtx, pszFileName);
+	SG_PATHNAME_NULLFREE(pCtx, pPathname);
+	SG_VHASH_NULLFREE(pCtx, pvhCloneRequest);
+
+	return JS_TRUE;
+
+fail:
+	SG_jsglue__report_sg_error(pCtx,cx); // Don't SG_ERR_IGNORE.
+	SG_VHASH_NULLFREE(pCtx, pvhResult);
+	SG_PATHNAME_NULLFREE(pCtx, pPathname);
+	SG_VHASH_NULLFREE(pCtx, pvhCloneRequest);
+	SG_NULLFREE(pCtx, pszFileName);
+	return JS_FALSE;
+}
+#undef REQUEST_CLONE_FRAGBALL_USAGE
+
 /**
  * sg.sync_remote.push_add(repo, push_id, fragball_path)
  *
@@ -707,6 +773,7 @@ static JSClass sg_sync_remote__class = {
 static JSFunctionSpec sg_sync_remote__methods[] = {
 	{ "get_repo_info",					SG_JSGLUE_METHOD_NAME(sync_remote,	get_repo_info),						1,0 },
 	{ "request_fragball",				SG_JSGLUE_METHOD_NAME(sync_remote,	request_fragball),					1,0 },
+	{ "request_clone_fragball",			SG_JSGLUE_METHOD_NAME(sync_remote,	request_clone_fragball),			2,0 },
 	{ "push_begin",						SG_JSGLUE_METHOD_NAME(sync_remote,	push_begin),						0,0 },
 	{ "push_add",						SG_JSGLUE_METHOD_NAME(sync_remote,	push_add),							3,0 },
 	{ "push_commit",					SG_JSGLUE_METHOD_NAME(sync_remote,	push_commit),						2,0 },
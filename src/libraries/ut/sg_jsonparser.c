@@ -1627,6 +1627,7 @@ struct sg_json_context
 	struct sg_json_stackentry* ptop;
 	SG_strpool* pStrPool;
 	SG_varpool* pVarPool;
+	SG_arena* pArena;
     SG_uint32 total_json_length;
     SG_bool b_utf8_fix;
 };
@@ -1639,7 +1640,14 @@ static void sg_vhash__json_cb__object_begin(
 	struct sg_json_stackentry* pse = NULL;
 	SG_vhash* pvh = NULL;
 
-	SG_ERR_CHECK(  SG_VHASH__ALLOC__PARAMS(pCtx, &pvh, 0, p->pStrPool, p->pVarPool)  );
+	if (p->pArena)
+	{
+		SG_ERR_CHECK(  SG_vhash__alloc__arena(pCtx, &pvh, 0, p->pArena)  );
+	}
+	else
+	{
+		SG_ERR_CHECK(  SG_VHASH__ALLOC__PARAMS(pCtx, &pvh, 0, p->pStrPool, p->pVarPool)  );
+	}
 
 	SG_ERR_CHECK(  SG_alloc1(pCtx, pse)  );
 
@@ -1695,7 +1703,14 @@ static void sg_vhash__json_cb__array_begin(
 	struct sg_json_stackentry* pse = NULL;
 	SG_varray* pva = NULL;
 
-	SG_ERR_CHECK(  SG_VARRAY__ALLOC__PARAMS(pCtx, &pva, 4, p->pStrPool, p->pVarPool)  );
+	if (p->pArena)
+	{
+		SG_ERR_CHECK(  SG_varray__alloc__arena(pCtx, &pva, 4, p->pArena)  );
+	}
+	else
+	{
+		SG_ERR_CHECK(  SG_VARRAY__ALLOC__PARAMS(pCtx, &pva, 4, p->pStrPool, p->pVarPool)  );
+	}
 
 	SG_ERR_CHECK(  SG_alloc1(pCtx, pse)  );
 
@@ -2020,6 +2035,7 @@ fail:
 
 static void sg_veither__parse_json__buflen(
         SG_context* pCtx, 
+        SG_arena* pArena,
         const char* pszJson,
         SG_uint32 len,
         SG_bool b_utf8_fix,
@@ -2039,9 +2055,13 @@ static void sg_veither__parse_json__buflen(
     ctx.toptype = 0;
 	ctx.pStrPool = NULL;
 	ctx.pVarPool = NULL;
+	ctx.pArena = pArena;
     ctx.total_json_length = len;
-    SG_ERR_CHECK(  SG_STRPOOL__ALLOC(pCtx, &ctx.pStrPool, ctx.total_json_length)  );
-    SG_ERR_CHECK(  SG_VARPOOL__ALLOC(pCtx, &ctx.pVarPool, ctx.total_json_length + 4 / 4)  );
+    if (!pArena)
+    {
+        SG_ERR_CHECK(  SG_STRPOOL__ALLOC(pCtx, &ctx.pStrPool, ctx.total_json_length)  );
+        SG_ERR_CHECK(  SG_VARPOOL__ALLOC(pCtx, &ctx.pVarPool, ctx.total_json_length + 4 / 4)  );
+    }
 
 	SG_ERR_CHECK(  SG_jsonparser__alloc(pCtx, &jc, sg_vhash__json_cb, &ctx)  );
 
@@ -2103,7 +2123,7 @@ void SG_veither__parse_json__buflen(
         SG_varray** ppva
         )
 {
-    SG_ERR_CHECK_RETURN(  sg_veither__parse_json__buflen(pCtx, pszJson, len, SG_FALSE, ppvh, ppva)  );
+    SG_ERR_CHECK_RETURN(  sg_veither__parse_json__buflen(pCtx, NULL, pszJson, len, SG_FALSE, ppvh, ppva)  );
 }
 
 void SG_veither__parse_json__buflen__utf8_fix(
@@ -2114,6 +2134,20 @@ void SG_veither__parse_json__buflen__utf8_fix(
         SG_varray** ppva
         )
 {
-    SG_ERR_CHECK_RETURN(  sg_veither__parse_json__buflen(pCtx, pszJson, len, SG_TRUE, ppvh, ppva)  );
+    SG_ERR_CHECK_RETURN(  sg_veither__parse_json__buflen(pCtx, NULL, pszJson, len, SG_TRUE, ppvh, ppva)  );
+}
+
+void SG_veither__parse_json__buflen__arena(
+        SG_context* pCtx, 
+        SG_arena* pArena,
+        const char* pszJson,
+        SG_uint32 len,
+        SG_vhash** ppvh, 
+        SG_varray** ppva
+        )
+{
+    SG_NULLARGCHECK_RETURN(pArena);
+
+    SG_ERR_CHECK_RETURN(  sg_veither__parse_json__buflen(pCtx, pArena, pszJson, len, SG_FALSE, ppvh, ppva)  );
 }
 
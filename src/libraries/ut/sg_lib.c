@@ -112,6 +112,7 @@ void SG_lib__global_initialize(SG_context * pCtx)
 
 
 	SG_ERR_CHECK(  SG_zing__init_template_caches(pCtx)  );
+	SG_ERR_CHECK(  SG_tncache__global_initialize(pCtx)  );
 
     {
         SG_int64 itime = -1;
@@ -160,7 +161,9 @@ void SG_lib__global_cleanup(SG_context * pCtx)
 	SG_jscore__shutdown(pCtx);
 #endif
     SG_zing__now_free_all_cached_templates(pCtx);
+	SG_tncache__global_cleanup(pCtx);
     SG_repo__free_implementation_plugin_list(pCtx);
+	SG_perf__global_cleanup();
 	SG_log__global_cleanup();
 	sg_localsettings__global_cleanup(pCtx);
 	sg_closet__global_cleanup(pCtx);
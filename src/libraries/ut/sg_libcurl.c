@@ -29,6 +29,13 @@ struct _sg_curl__file_read_state
 	                  // 0 ends the transfer... But see work item H5833.
 };
 
+struct _sg_curl__resume_state
+{
+	SG_file* pFile; // We don't own this and shouldn't attempt to free it.
+	const SG_pathname* pPathETag; // Nor this.
+	SG_bool bStarted; // True once we've seen the first chunk of the response body.
+};
+
 /**
  * The structure for which SG_curl is an opaque wrapper.
  */
@@ -44,11 +51,22 @@ typedef struct
 
 	SG_curl__callback* pFnWriteResponse;
 	void* pWriteState; // We don't own this and shouldn't attempt to free it.
+	struct _sg_curl__resume_state resumeState;
 
 	SG_curl_progress_callback* pFnProgress;
 	void* pProgressState; // We don't own this and shouldn't attempt to free it.
 } _sg_curl;
 
+/**
+ * Process-wide totals over every request made through SG_curl,
+ * for benchmarks and tracing.  See SG_curl__get_transfer_totals.
+ */
+static SG_mutex g_mutex_transfer_totals;
+static SG_bool g_bTransferTotalsInitialized = SG_FALSE;
+static SG_uint64 g_count_requests;
+static SG_uint64 g_bytes_sent;
+static SG_uint64 g_bytes_received;
+
 //////////////////////////////////////////////////////////////////////////
 
 #define _SETOPT(val) 	_sg_curl* pMe = (_sg_curl*)pCurl;	\
@@ -336,6 +354,63 @@ static void _write_string_chunk(SG_context* pCtx, SG_curl* pCurl, char* buffer,
 	}
 }
 
+/**
+ * The first chunk of the response body tells us whether the server honored our Range header.
+ * Record the response's validator before anything else, so that if we're interrupted a later
+ * attempt can pick up where this one left off.
+ */
+static void _start_resumed_file(SG_context* pCtx, SG_curl* pCurl, struct _sg_curl__resume_state* pState)
+{
+	SG_int32 responseCode = 0;
+	char* pszETag = NULL;
+	SG_file* pFileETag = NULL;
+
+	pState->bStarted = SG_TRUE;
+
+	SG_ERR_CHECK(  SG_curl__getinfo__int32(pCtx, pCurl, CURLINFO_RESPONSE_CODE, &responseCode)  );
+	if (responseCode != 200 && responseCode != 206)
+		return;
+
+	// A 200 means we're getting the whole thing again, so throw away what we had.
+	if (responseCode == 200)
+	{
+		SG_ERR_CHECK(  SG_file__seek(pCtx, pState->pFile, 0)  );
+		SG_ERR_CHECK(  SG_file__truncate(pCtx, pState->pFile)  );
+	}
+
+	if (pState->pPathETag)
+	{
+		SG_ERR_CHECK(  SG_curl__get_response_header(pCtx, pCurl, "ETag", &pszETag)  );
+		if (pszETag)
+		{
+			SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pState->pPathETag, SG_FILE_WRONLY | SG_FILE_OPEN_OR_CREATE | SG_FILE_TRUNC, 0644, &pFileETag)  );
+			SG_ERR_CHECK(  SG_file__write(pCtx, pFileETag, SG_STRLEN(pszETag), (const SG_byte*)pszETag, NULL)  );
+			SG_ERR_CHECK(  SG_file__close(pCtx, &pFileETag)  );
+		}
+		else
+		{
+			// Without a validator there's nothing we can safely resume.
+			SG_ERR_CHECK(  SG_fsobj__remove__pathname(pCtx, pState->pPathETag)  );
+			SG_ERR_CHECK_CURRENT_DISREGARD(SG_ERR_NOT_FOUND);
+		}
+	}
+
+	/* fall through */
+fail:
+	SG_FILE_NULLCLOSE(pCtx, pFileETag);
+	SG_NULLFREE(pCtx, pszETag);
+}
+
+static void _write_resumed_file_chunk(SG_context* pCtx, SG_curl* pCurl, char* buffer, SG_uint32 bufLen, void* pVoidState, SG_uint32* pLenHandled)
+{
+	struct _sg_curl__resume_state* pState = (struct _sg_curl__resume_state*)pVoidState;
+
+	if (!pState->bStarted)
+		SG_ERR_CHECK_RETURN(  _start_resumed_file(pCtx, pCurl, pState)  );
+
+	SG_ERR_CHECK_RETURN(  _write_file_chunk(pCtx, pCurl, buffer, bufLen, pState->pFile, pLenHandled)  );
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 /* Set up to use the built-in read/write callbacks. */
@@ -419,6 +494,25 @@ void SG_curl__set__write_file(SG_context* pCtx, SG_curl* pCurl, SG_file* pFile)
 	SG_ERR_CHECK_RETURN(  _setopt__write_cb(pCtx, pCurl, CURLOPT_WRITEFUNCTION, _write_callback_shim)  );
 }
 
+void SG_curl__set__resume_file(SG_context* pCtx, SG_curl* pCurl, SG_file* pFile, const SG_pathname* pPathETag)
+{
+	_sg_curl* pMe = (_sg_curl*)pCurl;
+
+	SG_NULLARGCHECK_RETURN(pCurl);
+	SG_NULLARGCHECK_RETURN(pFile);
+
+	if (pPathETag && !pMe->pstrRawHeaders)
+		SG_ERR_CHECK_RETURN(  SG_curl__record_headers(pCtx, pCurl)  );
+
+	pMe->resumeState.pFile = pFile;
+	pMe->resumeState.pPathETag = pPathETag;
+	pMe->resumeState.bStarted = SG_FALSE;
+	pMe->pWriteState = &pMe->resumeState;
+	pMe->pFnWriteResponse = _write_resumed_file_chunk;
+	SG_ERR_CHECK_RETURN(  _setopt__pv(pCtx, pCurl, CURLOPT_WRITEDATA, pCurl)  );
+	SG_ERR_CHECK_RETURN(  _setopt__write_cb(pCtx, pCurl, CURLOPT_WRITEFUNCTION, _write_callback_shim)  );
+}
+
 /**
  * Use the provided progress callback for this request/response.
  * The caller retains ownership of pState and should free it after SG_curl__perform.
@@ -449,11 +543,90 @@ void SG_curl__global_init(SG_context* pCtx)
 
 	if (rc)
 		SG_ERR_THROW_RETURN(SG_ERR_LIBCURL(rc));
+
+	SG_ERR_CHECK_RETURN(  SG_mutex__init(pCtx, &g_mutex_transfer_totals)  );
+	g_bTransferTotalsInitialized = SG_TRUE;
 }
 
 void SG_curl__global_cleanup()
 {
 	(void) curl_global_cleanup();
+
+	// Init may have failed before it got to the mutex.
+	if (g_bTransferTotalsInitialized)
+	{
+		SG_mutex__destroy(&g_mutex_transfer_totals);
+		g_bTransferTotalsInitialized = SG_FALSE;
+	}
+}
+
+void SG_curl__get_transfer_totals(SG_context* pCtx, SG_uint64* pCountRequests, SG_uint64* pBytesSent, SG_uint64* pBytesReceived)
+{
+	if (!g_bTransferTotalsInitialized)
+	{
+		if (pCountRequests)
+			*pCountRequests = 0;
+		if (pBytesSent)
+			*pBytesSent = 0;
+		if (pBytesReceived)
+			*pBytesReceived = 0;
+		return;
+	}
+
+	SG_ERR_CHECK_RETURN(  SG_mutex__lock(pCtx, &g_mutex_transfer_totals)  );
+
+	if (pCountRequests)
+		*pCountRequests = g_count_requests;
+	if (pBytesSent)
+		*pBytesSent = g_bytes_sent;
+	if (pBytesReceived)
+		*pBytesReceived = g_bytes_received;
+
+	SG_ERR_CHECK_RETURN(  SG_mutex__unlock(pCtx, &g_mutex_transfer_totals)  );
+}
+
+/**
+ * Add a finished request's traffic, headers included, to the totals,
+ * and return it.  This is bookkeeping only, so it never fails the request.
+ */
+static SG_uint64 _add_transfer_totals(_sg_curl* pMe)
+{
+	long lenRequestHeaders = 0;
+	long lenResponseHeaders = 0;
+#if LIBCURL_VERSION_NUM >= 0x073700
+	curl_off_t lenUploaded = 0;
+	curl_off_t lenDownloaded = 0;
+#else
+	// Before 7.55.0 these were only available as doubles.
+	double lenUploaded = 0;
+	double lenDownloaded = 0;
+#endif
+	SG_uint64 sent;
+	SG_uint64 received;
+
+	(void) curl_easy_getinfo(pMe->pCurl, CURLINFO_REQUEST_SIZE, &lenRequestHeaders);
+	(void) curl_easy_getinfo(pMe->pCurl, CURLINFO_HEADER_SIZE, &lenResponseHeaders);
+#if LIBCURL_VERSION_NUM >= 0x073700
+	(void) curl_easy_getinfo(pMe->pCurl, CURLINFO_SIZE_UPLOAD_T, &lenUploaded);
+	(void) curl_easy_getinfo(pMe->pCurl, CURLINFO_SIZE_DOWNLOAD_T, &lenDownloaded);
+#else
+	(void) curl_easy_getinfo(pMe->pCurl, CURLINFO_SIZE_UPLOAD, &lenUploaded);
+	(void) curl_easy_getinfo(pMe->pCurl, CURLINFO_SIZE_DOWNLOAD, &lenDownloaded);
+#endif
+
+	sent = (SG_uint64)lenRequestHeaders + (SG_uint64)lenUploaded;
+	received = (SG_uint64)lenResponseHeaders + (SG_uint64)lenDownloaded;
+
+	if (g_bTransferTotalsInitialized && SG_mutex__lock__bare(&g_mutex_transfer_totals) == 0)
+	{
+		g_count_requests++;
+		g_bytes_sent += sent;
+		g_bytes_received += received;
+
+		(void) SG_mutex__unlock__bare(&g_mutex_transfer_totals);
+	}
+
+	return sent + received;
 }
 
 void SG_curl__free(SG_context* pCtx, SG_curl* pCurl)
@@ -492,6 +665,11 @@ void _set_curl_options(SG_context* pCtx, CURL* pCurl)
 	if (rc)
 		SG_ERR_THROW(SG_ERR_LIBCURL(rc));
 
+	// Requests may run on several threads at once (see sg_pull.c), and curl's
+	// default name-resolution timeouts use signals, which isn't thread-safe.
+	rc = curl_easy_setopt(pCurl, CURLOPT_NOSIGNAL, 1L);
+	if (rc)
+		SG_ERR_THROW(SG_ERR_LIBCURL(rc));
 
 #ifdef WINDOWS
 	if (bVerifyCerts)
@@ -568,6 +746,7 @@ void SG_curl__reset(SG_context* pCtx, SG_curl* pCurl)
 	p->readState.finished = SG_FALSE;
 	p->pFnWriteResponse = NULL;
 	p->pWriteState = NULL;
+	memset(&p->resumeState, 0, sizeof(p->resumeState));
 	p->pFnProgress = NULL;
 	p->pProgressState = NULL;
 fail:
@@ -605,6 +784,59 @@ void SG_curl__get_response_headers(SG_context * pCtx, SG_curl * pCurl, SG_string
 	SG_ERR_CHECK_RETURN( SG_STRING__ALLOC__COPY(pCtx, ppHeaders, pMe->pstrRawHeaders) );
 }
 
+void SG_curl__get_response_header(SG_context * pCtx, SG_curl * pCurl, const char * pszName, char ** ppszValue)
+{
+	_sg_curl* pMe = (_sg_curl*)pCurl;
+	const char* pszLine = NULL;
+	const char* pszFound = NULL;
+	SG_uint32 lenFound = 0;
+	SG_uint32 lenName;
+
+	SG_NULLARGCHECK_RETURN(pCurl);
+	SG_NONEMPTYCHECK_RETURN(pszName);
+	SG_NULLARGCHECK_RETURN(ppszValue);
+
+	*ppszValue = NULL;
+	if (!pMe->pstrRawHeaders)
+		return;
+
+	// The raw headers may hold several responses (an auth challenge, say, before
+	// the real one).  We want the last one, so keep the last match.
+	lenName = SG_STRLEN(pszName);
+	pszLine = SG_string__sz(pMe->pstrRawHeaders);
+	while (*pszLine)
+	{
+		const char* pszEnd = strchr(pszLine, '\n');
+		SG_uint32 lenLine = pszEnd ? (SG_uint32)(pszEnd - pszLine) : SG_STRLEN(pszLine);
+
+		if (lenLine > lenName && pszLine[lenName] == ':' && 0 == SG_strnicmp(pszLine, pszName, lenName))
+		{
+			pszFound = pszLine + lenName + 1;
+			lenFound = lenLine - lenName - 1;
+			while (lenFound && (*pszFound == ' ' || *pszFound == '\t'))
+			{
+				pszFound++;
+				lenFound--;
+			}
+			while (lenFound && (pszFound[lenFound - 1] == '\r' || pszFound[lenFound - 1] == ' '))
+				lenFound--;
+		}
+
+		if (!pszEnd)
+			break;
+		pszLine = pszEnd + 1;
+	}
+
+	if (pszFound)
+	{
+		char* pszValue = NULL;
+
+		SG_ERR_CHECK_RETURN(  SG_allocN(pCtx, lenFound + 1, pszValue)  );
+		memcpy(pszValue, pszFound, lenFound);
+		*ppszValue = pszValue;
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 void SG_curl__set_headers_from_varray(SG_context * pCtx, SG_curl * pCurl, SG_varray * pvaHeaders, struct curl_slist ** ppHeaderList)
@@ -702,10 +934,18 @@ void SG_curl__perform(SG_context* pCtx, SG_curl* pCurl)
 {
 	CURLcode rc = CURLE_OK;
 	_sg_curl* pMe = (_sg_curl*)pCurl;
+	SG_int64 tPerf;
 	
 	SG_NULLARGCHECK_RETURN(pCurl);
-	
+
+	// The callbacks report errors to pMe->pCtx.  This request may be running
+	// on a different thread (and context) than the one that allocated us.
+	pMe->pCtx = pCtx;
+
+	tPerf = SG_perf__start();
 	rc = curl_easy_perform(pMe->pCurl);
+
+	SG_perf__stop(SG_PERF_CATEGORY__NETWORK, tPerf, _add_transfer_totals(pMe));
 	
 	// Check for errors in the request and response callbacks.
 	SG_ERR_CHECK_RETURN_CURRENT;
@@ -388,6 +388,11 @@ void SG_pendingdb__commit(
     SG_varray* pva_fields = NULL;
     SG_vhash* pvh_rec = NULL;
     SG_vhash* pvh_dont_add = NULL;
+    SG_dbrecord** aprec = NULL;
+    const char** apsz_hid_key = NULL;
+    SG_uint32 count_records = 0;
+    SG_uint32 count_aprec = 0;
+    SG_uint32 i_rec = 0;
 
 	SG_NULLARGCHECK_RETURN(pPendingDb);
 
@@ -487,24 +492,49 @@ void SG_pendingdb__commit(
     }
 
 
-    // store the records
+    // store the records.  there can be a lot of them, so they all go in
+    // as one batch.  the rbtree doesn't own them, so we free them here.
+    SG_ERR_CHECK(  SG_rbtree__count(pCtx, pPendingDb->prb_records_add, &count_records)  );
+    SG_ERR_CHECK(  SG_allocN(pCtx, count_records + 1, aprec)  );
+    SG_ERR_CHECK(  SG_allocN(pCtx, count_records + 1, apsz_hid_key)  );
     SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pit, pPendingDb->prb_records_add, &b, &psz_hid_record, (void**) &prec)  );
     while (b)
     {
         if (prec)
         {
-            const char* psz_hid_from_record = NULL;
-
-            SG_ERR_CHECK(  SG_committing__db__add_record(pCtx, ptx, prec)  );
-            SG_ERR_CHECK(  SG_dbrecord__get_hid__ref(pCtx, prec, &psz_hid_from_record)  );
-            /* TODO we COULD verify that the new hid matches the rbtree's key */
+            apsz_hid_key[count_aprec] = psz_hid_record;
+            aprec[count_aprec++] = prec;
+            prec = NULL;
         }
 
-        SG_DBRECORD_NULLFREE(pCtx, prec);
-
         SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pit, &b, &psz_hid_record, (void**) &prec)  );
     }
     SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+    prec = NULL;
+
+    SG_ERR_CHECK(  SG_committing__db__add_records(pCtx, ptx, aprec, count_aprec)  );
+
+    // the batch computes the hids over again.  they must match the
+    // rbtree's keys, which went into the deltas.
+    for (i_rec=0; i_rec<count_aprec; i_rec++)
+    {
+        const char* psz_hid_stored = NULL;
+
+        SG_ERR_CHECK(  SG_dbrecord__get_hid__ref(pCtx, aprec[i_rec], &psz_hid_stored)  );
+        if (0 != strcmp(psz_hid_stored, apsz_hid_key[i_rec]))
+        {
+            SG_ERR_THROW2(  SG_ERR_BLOB_NOT_VERIFIED_MISMATCH,
+                            (pCtx, "record %s was stored as %s", apsz_hid_key[i_rec], psz_hid_stored)  );
+        }
+    }
+    SG_NULLFREE(pCtx, apsz_hid_key);
+
+    for (i_rec=0; i_rec<count_aprec; i_rec++)
+    {
+        SG_DBRECORD_NULLFREE(pCtx, aprec[i_rec]);
+    }
+    SG_NULLFREE(pCtx, aprec);
+    count_aprec = 0;
 
     // Now calculate the deltas
 
@@ -664,6 +694,12 @@ fail:
     SG_VHASH_NULLFREE(pCtx, pvh_delta);
     SG_VHASH_NULLFREE(pCtx, pvh_rec);
     SG_VARRAY_NULLFREE(pCtx, pva_fields);
+    for (i_rec=0; i_rec<count_aprec; i_rec++)
+    {
+        SG_DBRECORD_NULLFREE(pCtx, aprec[i_rec]);
+    }
+    SG_NULLFREE(pCtx, aprec);
+    SG_NULLFREE(pCtx, apsz_hid_key);
 }
 
 
@@ -0,0 +1,470 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file sg_perf.c
+ *
+ * @details Timers and counters for the hot paths.  See sg_perf_prototypes.h.
+ *
+ * Everything hangs off gpPerfState, which is NULL unless someone asked
+ * for timings, so the instrumented paths pay one test when nobody did.
+ *
+ */
+
+#include <sg.h>
+
+#include <time.h>
+#if defined(MAC) || defined(LINUX)
+#include <sys/time.h>
+#endif
+
+//////////////////////////////////////////////////////////////////
+
+static const char * SG_PERF_CATEGORY_NAMES[] =
+{
+	"command",
+	"sqlite",
+	"blob_fetch",
+	"blob_inflate",
+	"blob_undeltify",
+	"hash",
+	"fs_scan",
+	"network",
+};
+
+SG_STATIC_ASSERT(SG_NrElements(SG_PERF_CATEGORY_NAMES) == SG_PERF_CATEGORY__COUNT);
+
+// Trace events are kept in fixed-size blocks, so remembering one
+// never moves the others.  Past the last block we only keep totals.
+#define EVENTS_PER_BLOCK	16384
+#define MAX_EVENT_BLOCKS	64
+
+// Flush the trace file whenever this much JSON has accumulated.
+#define TRACE_WRITE_CHUNK	65536
+
+struct sg_perf_event
+{
+	const char *		pszName;
+	SG_int64			tStart;
+	SG_int64			duration;	// -1 for a counter, whose units are its running total
+	SG_uint64			units;
+	SG_thread_id		thread;
+	SG_perf_category	category;
+};
+
+struct sg_perf_total
+{
+	SG_uint64	calls;
+	SG_uint64	us;
+	SG_uint64	units;
+};
+
+static struct
+{
+	SG_mutex mutex; // Protects all other members, including pCtx.
+
+	SG_context * pCtx; // Protected by the mutex.  For the calls that can't take one.
+
+	SG_int64 tOrigin;
+	struct sg_perf_total totals[SG_PERF_CATEGORY__COUNT];
+	SG_rbtree * prbNamed; // name --> struct sg_perf_total, for named timers and counters
+
+	SG_bool bTrace;
+	struct sg_perf_event * aBlocks[MAX_EVENT_BLOCKS];
+	SG_uint32 countEvents;
+	SG_uint32 countDropped;
+} * gpPerfState;
+
+//////////////////////////////////////////////////////////////////
+
+/**
+ * A monotonic clock in microseconds.  The origin is arbitrary.
+ */
+static SG_int64 _now_us(void)
+{
+#if defined(WINDOWS)
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+
+	if (freq.QuadPart == 0)
+		(void)QueryPerformanceFrequency(&freq);
+	(void)QueryPerformanceCounter(&now);
+
+	return (SG_int64)((now.QuadPart / freq.QuadPart) * 1000000
+					  + ((now.QuadPart % freq.QuadPart) * 1000000) / freq.QuadPart);
+#elif defined(LINUX)
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ((SG_int64)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+#else
+	struct timeval tv;
+
+	(void)gettimeofday(&tv, NULL);
+
+	return ((SG_int64)tv.tv_sec * 1000000) + tv.tv_usec;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////
+
+static void _remember(SG_context * pCtx,
+					  SG_perf_category category,
+					  const char * pszName,
+					  SG_int64 tStart,
+					  SG_int64 duration,
+					  SG_uint64 units)
+{
+	SG_uint32 ndxBlock = gpPerfState->countEvents / EVENTS_PER_BLOCK;
+	struct sg_perf_event * pEvent;
+
+	if (ndxBlock >= MAX_EVENT_BLOCKS)
+	{
+		gpPerfState->countDropped++;
+		return;
+	}
+
+	if (!gpPerfState->aBlocks[ndxBlock])
+		SG_ERR_CHECK_RETURN(  SG_alloc(pCtx, EVENTS_PER_BLOCK, sizeof(struct sg_perf_event), &gpPerfState->aBlocks[ndxBlock])  );
+
+	pEvent = &gpPerfState->aBlocks[ndxBlock][gpPerfState->countEvents % EVENTS_PER_BLOCK];
+	pEvent->pszName = pszName;
+	pEvent->tStart = tStart - gpPerfState->tOrigin;
+	pEvent->duration = duration;
+	pEvent->units = units;
+	pEvent->category = category;
+	SG_ERR_CHECK_RETURN(  SG_thread__get_current_thread(pCtx, &pEvent->thread)  );
+
+	gpPerfState->countEvents++;
+}
+
+/**
+ * Find (or start) the totals for a named timer or counter.
+ */
+static void _named_total(SG_context * pCtx, const char * pszName, struct sg_perf_total ** ppTotal)
+{
+	struct sg_perf_total * pTotal = NULL;
+	SG_bool bFound = SG_FALSE;
+
+	SG_ERR_CHECK(  SG_rbtree__find(pCtx, gpPerfState->prbNamed, pszName, &bFound, (void **)&pTotal)  );
+	if (!bFound)
+	{
+		SG_ERR_CHECK(  SG_alloc1(pCtx, pTotal)  );
+		SG_ERR_CHECK(  SG_rbtree__add__with_assoc(pCtx, gpPerfState->prbNamed, pszName, pTotal)  );
+	}
+
+	*ppTotal = pTotal;
+	return;
+
+fail:
+	if (!bFound)
+		SG_NULLFREE(pCtx, pTotal);
+}
+
+static void _free_total(SG_context * pCtx, void * pVoid)
+{
+	SG_NULLFREE(pCtx, pVoid);
+}
+
+void SG_perf__global_init(SG_context * pCtx, SG_bool bTrace)
+{
+	SG_error err = SG_ERR_OK;
+
+	if (gpPerfState != NULL)
+		return;
+
+	SG_ERR_CHECK_RETURN(  SG_alloc1(pCtx, gpPerfState)  );
+
+	err = SG_context__alloc(&gpPerfState->pCtx);
+	if (!SG_IS_OK(err))
+	{
+		SG_ERR_THROW(err);
+	}
+
+	SG_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &gpPerfState->prbNamed)  );
+	SG_ERR_CHECK(  SG_mutex__init(pCtx, &gpPerfState->mutex)  );
+
+	gpPerfState->bTrace = bTrace;
+	gpPerfState->tOrigin = _now_us();
+
+	return;
+
+fail:
+	SG_RBTREE_NULLFREE(pCtx, gpPerfState->prbNamed);
+	SG_CONTEXT_NULLFREE(gpPerfState->pCtx);
+	SG_NULLFREE(pCtx, gpPerfState);
+}
+
+void SG_perf__global_cleanup(void)
+{
+	if (gpPerfState != NULL)
+	{
+		SG_context * pCtx = gpPerfState->pCtx;
+		SG_uint32 k;
+
+		for (k=0; k<MAX_EVENT_BLOCKS; k++)
+			SG_NULLFREE(pCtx, gpPerfState->aBlocks[k]);
+		SG_RBTREE_NULLFREE_WITH_ASSOC(pCtx, gpPerfState->prbNamed, _free_total);
+		SG_mutex__destroy(&gpPerfState->mutex);
+		SG_NULLFREE(pCtx, gpPerfState);
+		SG_CONTEXT_NULLFREE(pCtx);
+	}
+}
+
+//////////////////////////////////////////////////////////////////
+
+SG_int64 SG_perf__start(void)
+{
+	if (gpPerfState == NULL)
+		return 0;
+
+	return _now_us();
+}
+
+void SG_perf__stop(SG_perf_category category, SG_int64 tStart, SG_uint64 units)
+{
+	SG_perf__stop__named(category, NULL, tStart, units);
+}
+
+void SG_perf__stop__named(SG_perf_category category, const char * pszName, SG_int64 tStart, SG_uint64 units)
+{
+	SG_int64 duration;
+
+	// tStart is 0 if we weren't collecting when the call began.
+	if (gpPerfState == NULL || tStart == 0)
+		return;
+
+	duration = _now_us() - tStart;
+
+	if (SG_mutex__lock__bare(&gpPerfState->mutex))
+		return;
+
+	gpPerfState->totals[category].calls++;
+	gpPerfState->totals[category].us += (SG_uint64)duration;
+	gpPerfState->totals[category].units += units;
+
+	if (pszName)
+	{
+		struct sg_perf_total * pTotal = NULL;
+
+		_named_total(gpPerfState->pCtx, pszName, &pTotal);
+		if (pTotal)
+		{
+			pTotal->calls++;
+			pTotal->us += (SG_uint64)duration;
+			pTotal->units += units;
+		}
+		SG_context__err_reset(gpPerfState->pCtx);
+	}
+
+	if (gpPerfState->bTrace)
+	{
+		_remember(gpPerfState->pCtx, category, pszName, tStart, duration, units);
+		SG_context__err_reset(gpPerfState->pCtx);
+	}
+
+	(void)SG_mutex__unlock__bare(&gpPerfState->mutex);
+}
+
+void SG_perf__count(const char * pszName, SG_uint64 units)
+{
+	struct sg_perf_total * pTotal = NULL;
+
+	if (gpPerfState == NULL)
+		return;
+
+	if (SG_mutex__lock__bare(&gpPerfState->mutex))
+		return;
+
+	_named_total(gpPerfState->pCtx, pszName, &pTotal);
+	if (pTotal)
+	{
+		pTotal->calls++;
+		pTotal->units += units;
+
+		if (gpPerfState->bTrace)
+			_remember(gpPerfState->pCtx, SG_PERF_CATEGORY__COUNT, pszName, _now_us(), -1, pTotal->units);
+	}
+	SG_context__err_reset(gpPerfState->pCtx);
+
+	(void)SG_mutex__unlock__bare(&gpPerfState->mutex);
+}
+
+//////////////////////////////////////////////////////////////////
+
+void SG_perf__get_totals(SG_context * pCtx, SG_vhash ** ppvhTotals)
+{
+	SG_vhash * pvhTotals = NULL;
+	SG_vhash * pvhCategory = NULL;
+	struct sg_perf_total totals[SG_PERF_CATEGORY__COUNT];
+	SG_uint32 k;
+
+	SG_NULLARGCHECK_RETURN(ppvhTotals);
+
+	*ppvhTotals = NULL;
+	if (gpPerfState == NULL)
+		return;
+
+	SG_ERR_CHECK_RETURN(  SG_mutex__lock(pCtx, &gpPerfState->mutex)  );
+	memcpy(totals, gpPerfState->totals, sizeof(totals));
+	SG_ERR_CHECK_RETURN(  SG_mutex__unlock(pCtx, &gpPerfState->mutex)  );
+
+	SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvhTotals)  );
+	for (k=0; k<SG_PERF_CATEGORY__COUNT; k++)
+	{
+		if (totals[k].calls == 0)
+			continue;
+
+		SG_ERR_CHECK(  SG_vhash__addnew__vhash(pCtx, pvhTotals, SG_PERF_CATEGORY_NAMES[k], &pvhCategory)  );
+		SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvhCategory, "calls", (SG_int64)totals[k].calls)  );
+		SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvhCategory, "us", (SG_int64)totals[k].us)  );
+		SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvhCategory, "units", (SG_int64)totals[k].units)  );
+	}
+
+	*ppvhTotals = pvhTotals;
+	pvhTotals = NULL;
+
+fail:
+	SG_VHASH_NULLFREE(pCtx, pvhTotals);
+}
+
+void SG_perf__get_named_totals(SG_context * pCtx, SG_vhash ** ppvhTotals)
+{
+	SG_vhash * pvhTotals = NULL;
+	SG_vhash * pvhName = NULL;
+	SG_rbtree_iterator * pIter = NULL;
+	const char * pszName = NULL;
+	struct sg_perf_total * pTotal = NULL;
+	SG_bool bOK = SG_FALSE;
+	SG_bool bLocked = SG_FALSE;
+
+	SG_NULLARGCHECK_RETURN(ppvhTotals);
+
+	*ppvhTotals = NULL;
+	if (gpPerfState == NULL)
+		return;
+
+	SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvhTotals)  );
+
+	SG_ERR_CHECK(  SG_mutex__lock(pCtx, &gpPerfState->mutex)  );
+	bLocked = SG_TRUE;
+
+	SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pIter, gpPerfState->prbNamed, &bOK, &pszName, (void **)&pTotal)  );
+	while (bOK)
+	{
+		SG_ERR_CHECK(  SG_vhash__addnew__vhash(pCtx, pvhTotals, pszName, &pvhName)  );
+		SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvhName, "calls", (SG_int64)pTotal->calls)  );
+		SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvhName, "us", (SG_int64)pTotal->us)  );
+		SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvhName, "units", (SG_int64)pTotal->units)  );
+
+		SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pIter, &bOK, &pszName, (void **)&pTotal)  );
+	}
+
+	SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &gpPerfState->mutex)  );
+	bLocked = SG_FALSE;
+
+	*ppvhTotals = pvhTotals;
+	pvhTotals = NULL;
+
+fail:
+	if (bLocked)
+		(void)SG_mutex__unlock__bare(&gpPerfState->mutex);
+	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pIter);
+	SG_VHASH_NULLFREE(pCtx, pvhTotals);
+}
+
+void SG_perf__write_trace(SG_context * pCtx, const SG_pathname * pPath)
+{
+	SG_file * pFile = NULL;
+	SG_string * pstr = NULL;
+	SG_jsonwriter * pjson = NULL;
+	SG_bool bLocked = SG_FALSE;
+	SG_uint32 k;
+
+	SG_NULLARGCHECK_RETURN(pPath);
+
+	if (gpPerfState == NULL || !gpPerfState->bTrace)
+		SG_ERR_THROW2_RETURN(  SG_ERR_INVALIDARG, (pCtx, "Tracing was not enabled.")  );
+
+	SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_WRONLY|SG_FILE_OPEN_OR_CREATE|SG_FILE_TRUNC, 0644, &pFile)  );
+	SG_ERR_CHECK(  SG_STRING__ALLOC__RESERVE(pCtx, &pstr, TRACE_WRITE_CHUNK + 1024)  );
+	SG_ERR_CHECK(  SG_jsonwriter__alloc(pCtx, &pjson, pstr)  );
+
+	SG_ERR_CHECK(  SG_mutex__lock(pCtx, &gpPerfState->mutex)  );
+	bLocked = SG_TRUE;
+
+	// ts and dur are in microseconds, which is what the format expects.
+	// Names come from callers, so they go through the writer to be escaped.
+
+	SG_ERR_CHECK(  SG_jsonwriter__write_start_object(pCtx, pjson)  );
+	SG_ERR_CHECK(  SG_jsonwriter__write_begin_pair(pCtx, pjson, "traceEvents")  );
+	SG_ERR_CHECK(  SG_jsonwriter__write_start_array(pCtx, pjson)  );
+	for (k=0; k<gpPerfState->countEvents; k++)
+	{
+		const struct sg_perf_event * pEvent = &gpPerfState->aBlocks[k / EVENTS_PER_BLOCK][k % EVENTS_PER_BLOCK];
+		SG_bool bCounter = (pEvent->duration < 0);
+		const char * pszCategory = ((bCounter) ? "counter" : SG_PERF_CATEGORY_NAMES[pEvent->category]);
+
+		SG_ERR_CHECK(  SG_jsonwriter__write_begin_element(pCtx, pjson)  );
+		SG_ERR_CHECK(  SG_jsonwriter__write_start_object(pCtx, pjson)  );
+		SG_ERR_CHECK(  SG_jsonwriter__write_pair__string__sz(pCtx, pjson, "name", ((pEvent->pszName) ? pEvent->pszName : pszCategory))  );
+		SG_ERR_CHECK(  SG_jsonwriter__write_pair__string__sz(pCtx, pjson, "cat", pszCategory)  );
+		SG_ERR_CHECK(  SG_jsonwriter__write_pair__string__sz(pCtx, pjson, "ph", ((bCounter) ? "C" : "X"))  );
+		SG_ERR_CHECK(  SG_jsonwriter__write_pair__int64(pCtx, pjson, "ts", pEvent->tStart)  );
+		if (!bCounter)
+			SG_ERR_CHECK(  SG_jsonwriter__write_pair__int64(pCtx, pjson, "dur", pEvent->duration)  );
+		SG_ERR_CHECK(  SG_jsonwriter__write_pair__int64(pCtx, pjson, "pid", 1)  );
+		SG_ERR_CHECK(  SG_jsonwriter__write_pair__int64(pCtx, pjson, "tid", (SG_int64)pEvent->thread)  );
+		if (pEvent->units || bCounter)
+		{
+			// a counter's args are what the trace viewer plots
+			SG_ERR_CHECK(  SG_jsonwriter__write_begin_pair(pCtx, pjson, "args")  );
+			SG_ERR_CHECK(  SG_jsonwriter__write_start_object(pCtx, pjson)  );
+			SG_ERR_CHECK(  SG_jsonwriter__write_pair__int64(pCtx, pjson, ((bCounter) ? "value" : "units"), (SG_int64)pEvent->units)  );
+			SG_ERR_CHECK(  SG_jsonwriter__write_end_object(pCtx, pjson)  );
+		}
+		SG_ERR_CHECK(  SG_jsonwriter__write_end_object(pCtx, pjson)  );
+
+		if (SG_string__length_in_bytes(pstr) >= TRACE_WRITE_CHUNK)
+		{
+			SG_ERR_CHECK(  SG_file__write__string(pCtx, pFile, pstr)  );
+			SG_ERR_CHECK(  SG_string__clear(pCtx, pstr)  );
+		}
+	}
+	SG_ERR_CHECK(  SG_jsonwriter__write_end_array(pCtx, pjson)  );
+	SG_ERR_CHECK(  SG_jsonwriter__write_pair__string__sz(pCtx, pjson, "displayTimeUnit", "ms")  );
+	SG_ERR_CHECK(  SG_jsonwriter__write_begin_pair(pCtx, pjson, "otherData")  );
+	SG_ERR_CHECK(  SG_jsonwriter__write_start_object(pCtx, pjson)  );
+	SG_ERR_CHECK(  SG_jsonwriter__write_pair__int64(pCtx, pjson, "events_dropped", gpPerfState->countDropped)  );
+	SG_ERR_CHECK(  SG_jsonwriter__write_end_object(pCtx, pjson)  );
+	SG_ERR_CHECK(  SG_jsonwriter__write_end_object(pCtx, pjson)  );
+	SG_ERR_CHECK(  SG_string__append__sz(pCtx, pstr, "\n")  );
+
+	SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &gpPerfState->mutex)  );
+	bLocked = SG_FALSE;
+
+	SG_ERR_CHECK(  SG_file__write__string(pCtx, pFile, pstr)  );
+	SG_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+
+fail:
+	if (bLocked)
+		(void)SG_mutex__unlock__bare(&gpPerfState->mutex);
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+	SG_JSONWRITER_NULLFREE(pCtx, pjson);
+	SG_STRING_NULLFREE(pCtx, pstr);
+}
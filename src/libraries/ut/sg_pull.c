@@ -18,6 +18,14 @@ limitations under the License.
 
 #define TRACE_PULL 0
 
+/* When we need more blobs than this, we ask for them in several fragballs
+ * so that we can slurp one while the next one is downloading. */
+#define sg_PULL__BLOBS_PER_REQUEST 2500
+
+/* How many of those fragball requests we keep in flight at once, each over its
+ * own connection.  A single stream rarely fills a long, fat pipe. */
+#define sg_PULL__CONCURRENT_REQUESTS 4
+
 /* This exists primarily as a convenience so policy/credential data can be added to it later. 
  * It's only used in this file, there's no opaque wrapper. */
 typedef struct
@@ -176,6 +184,115 @@ fail:
 	SG_ERR_IGNORE(  _sg_pull__nullfree(pCtx, &pMyPull)  );
 }
 
+static void _add_dagnum_to_request(SG_context* pCtx, SG_uint64 iDagnum, SG_vhash** ppvhFragballRequest);
+
+/**
+ * Our leaves in a dag and their generations, which is what the other
+ * repo needs to make a "best guess" dagfrag.
+ */
+static void _get_dag_leaves_and_gens(SG_context* pCtx,
+									 SG_repo* pRepo,
+									 SG_uint64 dagnum,
+									 SG_vhash** ppvhDagLeaves)
+{
+	SG_rbtree* prbLeaves = NULL;
+	SG_rbtree_iterator* pit = NULL;
+	SG_repo_fetch_dagnodes_handle* pdh = NULL;
+	SG_dagnode* pdn = NULL;
+	SG_vhash* pvhDagLeaves = NULL;
+	SG_uint32 countLeaves;
+	const char* pszRefHid;
+	SG_int32 gen;
+	SG_bool b;
+
+	SG_ERR_CHECK(  SG_repo__fetch_dag_leaves(pCtx, pRepo, dagnum, &prbLeaves)  );
+	SG_ERR_CHECK(  SG_rbtree__count(pCtx, prbLeaves, &countLeaves)  );
+	SG_ERR_CHECK(  SG_VHASH__ALLOC__PARAMS(pCtx, &pvhDagLeaves, countLeaves, NULL, NULL)  );
+
+	SG_ERR_CHECK(  SG_repo__fetch_dagnodes__begin(pCtx, pRepo, dagnum, &pdh)  );
+	SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pit, prbLeaves, &b, &pszRefHid, NULL)  );
+	while (b)
+	{
+		SG_ERR_CHECK(  SG_repo__fetch_dagnodes__one(pCtx, pRepo, pdh, pszRefHid, &pdn)  );
+		SG_ERR_CHECK(  SG_dagnode__get_generation(pCtx, pdn, &gen)  );
+		SG_DAGNODE_NULLFREE(pCtx, pdn);
+		SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvhDagLeaves, pszRefHid, gen)  );
+		SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pit, &b, &pszRefHid, NULL)  );
+	}
+	SG_ERR_CHECK(  SG_repo__fetch_dagnodes__end(pCtx, pRepo, &pdh)  );
+
+	SG_RETURN_AND_NULL(pvhDagLeaves, ppvhDagLeaves);
+
+	/* fall through */
+fail:
+	SG_RBTREE_NULLFREE(pCtx, prbLeaves);
+	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+	SG_DAGNODE_NULLFREE(pCtx, pdn);
+	SG_VHASH_NULLFREE(pCtx, pvhDagLeaves);
+	if (pdh)
+		SG_ERR_IGNORE(  SG_repo__fetch_dagnodes__end(pCtx, pRepo, &pdh)  );
+}
+
+/**
+ * Tell the other repo what we already have in each requested dag: our
+ * leaves, and a have-set it can use to send a connected frag in its
+ * first response.  Servers that don't know about have-sets ignore them
+ * and fall back to a best guess from the leaves.
+ */
+static void _add_have_sets_to_request(SG_context* pCtx,
+									  SG_repo* pRepo,
+									  SG_vhash* pvhRequest)
+{
+	SG_vhash* pvhRefDags = NULL;
+	SG_vhash* pvhRefAllLeaves = NULL;
+	SG_vhash* pvhRefAllHaveSets = NULL;
+	SG_vhash* pvhDagLeaves = NULL;
+	SG_vhash* pvhHaveSet = NULL;
+	SG_rbtree* prbLocalDagnums = NULL;
+	SG_uint32 countDags, i;
+
+	SG_ERR_CHECK(  SG_vhash__check__vhash(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__DAGS, &pvhRefDags)  );
+	if (!pvhRefDags)
+		return;
+
+	SG_ERR_CHECK(  SG_repo__list_dags__rbtree(pCtx, pRepo, &prbLocalDagnums)  );
+	SG_ERR_CHECK(  SG_vhash__addnew__vhash(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__LEAVES, &pvhRefAllLeaves)  );
+	SG_ERR_CHECK(  SG_vhash__addnew__vhash(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__HAVE, &pvhRefAllHaveSets)  );
+
+	SG_ERR_CHECK(  SG_vhash__count(pCtx, pvhRefDags, &countDags)  );
+	for (i = 0; i < countDags; i++)
+	{
+		const char* pszRefDagnum = NULL;
+		SG_uint64 dagnum;
+		SG_bool bHaveDag = SG_FALSE;
+
+		SG_ERR_CHECK(  SG_vhash__get_nth_pair(pCtx, pvhRefDags, i, &pszRefDagnum, NULL)  );
+		if (prbLocalDagnums) // NULL when our repo has no dags at all
+			SG_ERR_CHECK(  SG_rbtree__find(pCtx, prbLocalDagnums, pszRefDagnum, &bHaveDag, NULL)  );
+		if (!bHaveDag)
+		{
+			// We have nothing in this dag.  An empty list of leaves says so.
+			SG_ERR_CHECK(  SG_vhash__addnew__vhash(pCtx, pvhRefAllLeaves, pszRefDagnum, NULL)  );
+			continue;
+		}
+
+		SG_ERR_CHECK(  SG_dagnum__from_sz__hex(pCtx, pszRefDagnum, &dagnum)  );
+
+		SG_ERR_CHECK(  _get_dag_leaves_and_gens(pCtx, pRepo, dagnum, &pvhDagLeaves)  );
+		SG_ERR_CHECK(  SG_vhash__add__vhash(pCtx, pvhRefAllLeaves, pszRefDagnum, &pvhDagLeaves)  );
+
+		SG_ERR_CHECK(  SG_sync__build_have_set(pCtx, pRepo, dagnum, &pvhHaveSet)  );
+		if (pvhHaveSet)
+			SG_ERR_CHECK(  SG_vhash__add__vhash(pCtx, pvhRefAllHaveSets, pszRefDagnum, &pvhHaveSet)  );
+	}
+
+	/* fall through */
+fail:
+	SG_RBTREE_NULLFREE(pCtx, prbLocalDagnums);
+	SG_VHASH_NULLFREE(pCtx, pvhDagLeaves);
+	SG_VHASH_NULLFREE(pCtx, pvhHaveSet);
+}
+
 /**
  * Based on the current contents of our staging area, add dagnodes until the DAGs connect. 
  * May do several roundtrips with the other repo.
@@ -197,11 +314,6 @@ static void _add_dagnodes_until_connected(SG_context* pCtx,
 	
 	SG_vhash* pvhAllLeaves = NULL;
 	SG_vhash* pvhDagLeaves = NULL;
-	SG_rbtree* prbLeaves = NULL;
-	SG_rbtree_iterator* pit = NULL;
-
-	SG_repo_fetch_dagnodes_handle* pdh = NULL;
-	SG_dagnode* pdn = NULL;
 
 	SG_ERR_CHECK(  SG_staging__get_pathname(pCtx, pMe->pszPullId, &pStagingPathname)  );
 
@@ -220,6 +332,7 @@ static void _add_dagnodes_until_connected(SG_context* pCtx,
 		{
 			SG_vhash* pvhRefStatusDags;
 			SG_vhash* pvhRefStatusDag;
+			SG_vhash* pvhRefStatusHaveSets = NULL;
 			const char* pszRefDagnum;
 			SG_uint32 countDags, i;
 
@@ -254,36 +367,18 @@ static void _add_dagnodes_until_connected(SG_context* pCtx,
 				SG_REV_SPEC_NULLFREE(pCtx, pRevSpec);
 
 				/* Add leaves and gens */
-				{
-					SG_uint32 countLeaves;
-					SG_int32 gen;
-					SG_bool b;
-
-					SG_ERR_CHECK(  SG_repo__fetch_dag_leaves(pCtx, pMe->pPullIntoRepo, dagnum, &prbLeaves)  );
-					SG_ERR_CHECK(  SG_rbtree__count(pCtx, prbLeaves, &countLeaves)  );
-					SG_ERR_CHECK(  SG_VHASH__ALLOC__PARAMS(pCtx, &pvhDagLeaves, countLeaves, NULL, NULL)  );
-
-					SG_ERR_CHECK(  SG_repo__fetch_dagnodes__begin(pCtx, pMe->pPullIntoRepo, dagnum, &pdh)  );
-					SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pit, prbLeaves, &b, &pszRefHid, NULL)  );
-					while (b)
-					{
-						SG_ERR_CHECK(  SG_repo__fetch_dagnodes__one(pCtx, pMe->pPullIntoRepo, pdh, pszRefHid, &pdn)  );
-						SG_ERR_CHECK(  SG_dagnode__get_generation(pCtx, pdn, &gen)  );
-						SG_DAGNODE_NULLFREE(pCtx, pdn);
-						SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvhDagLeaves, pszRefHid, gen)  );
-						SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pit, &b, &pszRefHid, NULL)  );
-					}
-					SG_ERR_CHECK(  SG_repo__fetch_dagnodes__end(pCtx, pMe->pPullIntoRepo, &pdh)  );
-					SG_RBTREE_NULLFREE(pCtx, prbLeaves);
-					SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
-
-					SG_ERR_CHECK(  SG_vhash__add__vhash(pCtx, pvhAllLeaves, pszRefDagnum, &pvhDagLeaves)  );
-				}
+				SG_ERR_CHECK(  _get_dag_leaves_and_gens(pCtx, pMe->pPullIntoRepo, dagnum, &pvhDagLeaves)  );
+				SG_ERR_CHECK(  SG_vhash__add__vhash(pCtx, pvhAllLeaves, pszRefDagnum, &pvhDagLeaves)  );
 			}
 
 			SG_ERR_CHECK(  SG_vhash__add__vhash(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__DAGS, &pvhRequestDags)  );
 
 			SG_ERR_CHECK(  SG_vhash__add__vhash(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__LEAVES, &pvhAllLeaves)  );
+
+			/* The staging status already summarized what we have near those leaves. */
+			SG_ERR_CHECK(  SG_vhash__check__vhash(pCtx, *ppvhStagingStatus, SG_SYNC_STATUS_KEY__HAVE, &pvhRefStatusHaveSets)  );
+			if (pvhRefStatusHaveSets)
+				SG_ERR_CHECK(  SG_vhash__addcopy__vhash(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__HAVE, pvhRefStatusHaveSets)  );
 		}
 
 		SG_ERR_CHECK(  SG_sync_client__pull_request_fragball(pCtx, pClient, pvhRequest, 
@@ -319,10 +414,238 @@ fail:
 	SG_VHASH_NULLFREE(pCtx, pvhRequestRevs);
 	SG_VHASH_NULLFREE(pCtx, pvhAllLeaves);
 	SG_VHASH_NULLFREE(pCtx, pvhDagLeaves);
-	SG_RBTREE_NULLFREE(pCtx, prbLeaves);
-	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
-	if (pdh && pMe && pMe->pPullIntoRepo)
-		SG_ERR_IGNORE(  SG_repo__fetch_dagnodes__end(pCtx, pMe->pPullIntoRepo, &pdh)  );
+}
+
+/**
+ * A fragball request running on its own thread, so that we can slurp
+ * the previous fragball while this one downloads.  The thread gets its
+ * own context.  Nothing else may use the sync client until the request
+ * is finished.
+ */
+typedef struct
+{
+	SG_context* pCtx;
+	SG_sync_client* pClient; // we don't own this
+	const SG_pathname* pStagingPathname; // we don't own this
+	SG_vhash* pvhRequest;
+	char* pszFragballName;
+	SG_thread* pThread;
+} _sg_pull_async_request;
+
+#if defined(DEBUG)
+/* Force a request to fail on its thread, in order to test how the pipeline
+ * bails out while other requests are in flight.  This is the changeset which
+ * u0073_pull.c commits to the testing dag with no parents and the SHA1/160
+ * HID of "u0073_pull: fail this blob request" as its root. */
+#define DEBUG_PULL_FAILURE__HID "73387ec539bc01cc0173e844a758580beaa955bc"
+
+static void _async_request__debug_failure(SG_context* pCtx, const SG_vhash* pvhRequest)
+{
+	SG_vhash* pvhRefBlobs = NULL;
+	SG_bool bFail = SG_FALSE;
+
+	SG_ERR_CHECK_RETURN(  SG_vhash__check__vhash(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__BLOBS, &pvhRefBlobs)  );
+	if (pvhRefBlobs)
+		SG_ERR_CHECK_RETURN(  SG_vhash__has(pCtx, pvhRefBlobs, DEBUG_PULL_FAILURE__HID, &bFail)  );
+	if (bFail)
+		SG_ERR_THROW2_RETURN(  SG_ERR_DEBUG_1, (pCtx, "Pull: %s", DEBUG_PULL_FAILURE__HID)  );
+}
+#endif
+
+static SG_thread__main _async_request__main;
+
+static void _async_request__main(void* pVoidData)
+{
+	_sg_pull_async_request* pReq = (_sg_pull_async_request*)pVoidData;
+	SG_context* pCtx = pReq->pCtx;
+
+#if defined(DEBUG)
+	SG_ERR_CHECK(  _async_request__debug_failure(pCtx, pReq->pvhRequest)  );
+#endif
+
+	/* Progress events go to the request thread's context, which has no log
+	 * handlers, so don't bother asking for them. */
+	SG_ERR_CHECK(  SG_sync_client__pull_request_fragball(pCtx, pReq->pClient, pReq->pvhRequest,
+		SG_FALSE, pReq->pStagingPathname, &pReq->pszFragballName)  );
+
+	/* fall through */
+fail:
+	return;
+}
+
+static void _async_request__free(SG_context* pCtx, _sg_pull_async_request* pReq)
+{
+	if (pReq)
+	{
+		SG_ERR_IGNORE(  SG_thread__join(pCtx, &pReq->pThread)  );
+		SG_VHASH_NULLFREE(pCtx, pReq->pvhRequest);
+		SG_NULLFREE(pCtx, pReq->pszFragballName);
+		SG_CONTEXT_NULLFREE(pReq->pCtx);
+		SG_NULLFREE(pCtx, pReq);
+	}
+}
+#define _ASYNC_REQUEST_NULLFREE(pCtx,p) SG_STATEMENT(  _async_request__free(pCtx, p); p=NULL;  )
+
+static void _async_request__start(SG_context* pCtx,
+								  SG_sync_client* pClient,
+								  SG_vhash** ppvhRequest,
+								  const SG_pathname* pStagingPathname,
+								  _sg_pull_async_request** ppReq)
+{
+	_sg_pull_async_request* pReq = NULL;
+
+	SG_ERR_CHECK(  SG_alloc1(pCtx, pReq)  );
+	SG_CTX_ALLOC_W_ERR_CHECK(&pReq->pCtx);
+	pReq->pClient = pClient;
+	pReq->pStagingPathname = pStagingPathname;
+	pReq->pvhRequest = *ppvhRequest;
+	*ppvhRequest = NULL;
+
+	SG_ERR_CHECK(  SG_thread__create(pCtx, _async_request__main, pReq, &pReq->pThread)  );
+
+	SG_RETURN_AND_NULL(pReq, ppReq);
+
+	/* fall through */
+fail:
+	_ASYNC_REQUEST_NULLFREE(pCtx, pReq);
+}
+
+/**
+ * Wait for a request started with _async_request__start and return the
+ * fragball's name.  An error from the request thread is rethrown here.
+ */
+static void _async_request__finish(SG_context* pCtx,
+								   _sg_pull_async_request** ppReq,
+								   char** ppszFragballName)
+{
+	_sg_pull_async_request* pReq = *ppReq;
+
+	*ppReq = NULL;
+
+	SG_ERR_CHECK(  SG_thread__join(pCtx, &pReq->pThread)  );
+
+	if (SG_CONTEXT__HAS_ERR(pReq->pCtx))
+	{
+		SG_error err = SG_ERR_UNSPECIFIED;
+		const char* pszDescription = NULL;
+
+		(void)SG_context__get_err(pReq->pCtx, &err);
+		(void)SG_context__err_get_description(pReq->pCtx, &pszDescription);
+		SG_ERR_THROW2(err, (pCtx, "%s", pszDescription ? pszDescription : ""));
+	}
+
+	SG_RETURN_AND_NULL(pReq->pszFragballName, ppszFragballName);
+
+	/* fall through */
+fail:
+	_ASYNC_REQUEST_NULLFREE(pCtx, pReq);
+}
+
+/**
+ * Build a fragball request for (at most) sg_PULL__BLOBS_PER_REQUEST of the blobs
+ * in pvhBlobs, starting at the given index.
+ */
+static void _make_blob_request(SG_context* pCtx,
+							   const SG_vhash* pvhBlobs,
+							   SG_uint32 iFirst,
+							   SG_vhash** ppvhRequest)
+{
+	SG_vhash* pvhRequest = NULL;
+	SG_vhash* pvhBatch = NULL;
+	SG_uint32 count, i, iEnd;
+
+	SG_ERR_CHECK(  SG_vhash__count(pCtx, pvhBlobs, &count)  );
+	iEnd = SG_MIN(count, iFirst + sg_PULL__BLOBS_PER_REQUEST);
+
+	SG_ERR_CHECK(  SG_VHASH__ALLOC__PARAMS(pCtx, &pvhBatch, iEnd - iFirst, NULL, NULL)  );
+	for (i = iFirst; i < iEnd; i++)
+	{
+		const char* pszHid;
+
+		SG_ERR_CHECK(  SG_vhash__get_nth_pair(pCtx, pvhBlobs, i, &pszHid, NULL)  );
+		SG_ERR_CHECK(  SG_vhash__add__null(pCtx, pvhBatch, pszHid)  );
+	}
+
+	SG_ERR_CHECK(  SG_VHASH__ALLOC__PARAMS(pCtx, &pvhRequest, 1, NULL, NULL)  );
+	SG_ERR_CHECK(  SG_vhash__add__vhash(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__BLOBS, &pvhBatch)  );
+
+	SG_RETURN_AND_NULL(pvhRequest, ppvhRequest);
+
+	/* fall through */
+fail:
+	SG_VHASH_NULLFREE(pCtx, pvhBatch);
+	SG_VHASH_NULLFREE(pCtx, pvhRequest);
+}
+
+/**
+ * Request the blobs listed in the staging status in batches.  Up to
+ * sg_PULL__CONCURRENT_REQUESTS batches download at once, each over its own
+ * connection to the other repo, while we slurp the ones that have arrived.
+ * Batches are slurped in the order they were requested.  We don't re-check the
+ * staging status between batches: the list of missing blobs can only change
+ * once we've slurped the changeset blobs, and the caller checks after we're done.
+ */
+static void _add_blobs__pipelined(SG_context* pCtx,
+								  _sg_pull* pMyPull,
+								  const SG_vhash* pvhBlobs,
+								  const SG_pathname* pStagingPathname)
+{
+	sg_pull_instance_data* pMe = pMyPull->pPullInstance;
+	SG_sync_client* apClients[sg_PULL__CONCURRENT_REQUESTS] = { NULL };
+	_sg_pull_async_request* apReqs[sg_PULL__CONCURRENT_REQUESTS] = { NULL };
+	SG_vhash* pvhRequest = NULL;
+	char* pszFragballName = NULL;
+	SG_uint32 countBlobs, countBatches, countStreams, i;
+
+	SG_ERR_CHECK(  SG_vhash__count(pCtx, pvhBlobs, &countBlobs)  );
+	countBatches = (countBlobs + sg_PULL__BLOBS_PER_REQUEST - 1) / sg_PULL__BLOBS_PER_REQUEST;
+	countStreams = SG_MIN(countBatches, sg_PULL__CONCURRENT_REQUESTS);
+	SG_ERR_CHECK(  SG_log__set_steps(pCtx, countBatches, "requests")  );
+
+	/* The first stream uses the pull's own client.  The others get their own. */
+	for (i = 0; i < countStreams; i++)
+	{
+		if (i == 0)
+			apClients[i] = pMyPull->pSyncClient;
+		else
+			SG_ERR_CHECK(  SG_sync_client__open__copy(pCtx, pMyPull->pSyncClient, &apClients[i])  );
+
+		SG_ERR_CHECK(  _make_blob_request(pCtx, pvhBlobs, i * sg_PULL__BLOBS_PER_REQUEST, &pvhRequest)  );
+		SG_ERR_CHECK(  _async_request__start(pCtx, apClients[i], &pvhRequest, pStagingPathname, &apReqs[i])  );
+	}
+
+	for (i = 0; i < countBatches; i++)
+	{
+		SG_uint32 iStream = i % countStreams;
+
+		SG_ERR_CHECK(  _async_request__finish(pCtx, &apReqs[iStream], &pszFragballName)  );
+		pMe->countRoundtrips++;
+
+		if (i + countStreams < countBatches)
+		{
+			SG_ERR_CHECK(  _make_blob_request(pCtx, pvhBlobs, (i + countStreams) * sg_PULL__BLOBS_PER_REQUEST, &pvhRequest)  );
+			SG_ERR_CHECK(  _async_request__start(pCtx, apClients[iStream], &pvhRequest, pStagingPathname, &apReqs[iStream])  );
+		}
+
+		SG_ERR_CHECK(  SG_staging__slurp_fragball(pCtx, pMe->pStaging, (const char*)pszFragballName)  );
+		SG_NULLFREE(pCtx, pszFragballName);
+
+		SG_ERR_CHECK(  SG_log__finish_step(pCtx)  );
+		SG_ERR_CHECK(  SG_log__check_cancel(pCtx)  );
+	}
+
+	/* fall through */
+fail:
+	/* If we're bailing out, this waits for any downloads still in progress
+	 * before closing the connections they're using. */
+	for (i = 0; i < sg_PULL__CONCURRENT_REQUESTS; i++)
+	{
+		_ASYNC_REQUEST_NULLFREE(pCtx, apReqs[i]);
+		if (i > 0)
+			SG_SYNC_CLIENT_NULLFREE(pCtx, apClients[i]);
+	}
+	SG_VHASH_NULLFREE(pCtx, pvhRequest);
+	SG_NULLFREE(pCtx, pszFragballName);
 }
 
 /**
@@ -356,21 +679,42 @@ static void _add_blobs_until_done(SG_context* pCtx,
 
 	for (i = 0; need_blobs; i++)
 	{
-		pvhFragballRequest = pvhStagingStatus;
-		pvhStagingStatus = NULL;
+		SG_vhash* pvhRefBlobs = NULL;
+		SG_uint32 countBlobs = 0;
 
-        SG_ERR_CHECK(  SG_log__push_operation(pCtx, "Downloading blobs", SG_LOG__FLAG__NONE)  );
-		bPopOp = SG_TRUE;
+		SG_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhStagingStatus, SG_SYNC_STATUS_KEY__BLOBS, &pvhRefBlobs)  );
+		SG_ERR_CHECK(  SG_vhash__count(pCtx, pvhRefBlobs, &countBlobs)  );
 
-		SG_ERR_CHECK(  SG_sync_client__pull_request_fragball(pCtx, pClient, pvhFragballRequest, SG_TRUE, pStagingPathname, &pszFragballName)  );
-		pMe->countRoundtrips++;
-		SG_ERR_CHECK(  SG_log__pop_operation(pCtx)  );
-		bPopOp = SG_FALSE;
+		if (countBlobs > sg_PULL__BLOBS_PER_REQUEST)
+		{
+			/* This can take a while, so it can be cancelled between batches. */
+			SG_ERR_CHECK(  SG_log__push_operation(pCtx, "Downloading blobs", SG_LOG__FLAG__CAN_CANCEL)  );
+			bPopOp = SG_TRUE;
 
-		SG_VHASH_NULLFREE(pCtx, pvhFragballRequest);
+			SG_ERR_CHECK(  _add_blobs__pipelined(pCtx, pMyPull, pvhRefBlobs, pStagingPathname)  );
+			SG_ERR_CHECK(  SG_log__pop_operation(pCtx)  );
+			bPopOp = SG_FALSE;
 
-		SG_ERR_CHECK(  SG_staging__slurp_fragball(pCtx, pStaging, (const char*)pszFragballName)  );
-		SG_NULLFREE(pCtx, pszFragballName);
+			SG_VHASH_NULLFREE(pCtx, pvhStagingStatus);
+		}
+		else
+		{
+			SG_ERR_CHECK(  SG_log__push_operation(pCtx, "Downloading blobs", SG_LOG__FLAG__NONE)  );
+			bPopOp = SG_TRUE;
+
+			pvhFragballRequest = pvhStagingStatus;
+			pvhStagingStatus = NULL;
+
+			SG_ERR_CHECK(  SG_sync_client__pull_request_fragball(pCtx, pClient, pvhFragballRequest, SG_TRUE, pStagingPathname, &pszFragballName)  );
+			pMe->countRoundtrips++;
+			SG_ERR_CHECK(  SG_log__pop_operation(pCtx)  );
+			bPopOp = SG_FALSE;
+
+			SG_VHASH_NULLFREE(pCtx, pvhFragballRequest);
+
+			SG_ERR_CHECK(  SG_staging__slurp_fragball(pCtx, pStaging, (const char*)pszFragballName)  );
+			SG_NULLFREE(pCtx, pszFragballName);
+		}
 
 		SG_ERR_CHECK(  SG_staging__check_status(pCtx, pStaging, pMe->pPullIntoRepo,
 			SG_FALSE, SG_FALSE, SG_TRUE, SG_TRUE, SG_FALSE, 
@@ -410,6 +754,7 @@ static void _add_dagnodes(
 	SG_pathname* pStagingPathname = NULL;
 	char*              pszFragballName  = NULL;
 	SG_vhash*          pvhStatus        = NULL;
+	SG_vhash*          pvhRequest       = NULL;
 
 	SG_NULLARGCHECK_RETURN(pStaging);
 	SG_NULLARGCHECK_RETURN(pClient);
@@ -417,7 +762,30 @@ static void _add_dagnodes(
 
 	SG_ERR_CHECK(  SG_staging__get_pathname(pCtx, pMe->pszPullId, &pStagingPathname)  );
 
-	SG_sync_client__pull_request_fragball(pCtx, pClient, pMyPull->pvhFragballRequest, 
+	/* Spell out "every dag" so there's somewhere to put our have-sets. */
+	if (pMyPull->pvhFragballRequest)
+		SG_ERR_CHECK(  SG_VHASH__ALLOC__COPY(pCtx, &pvhRequest, pMyPull->pvhFragballRequest)  );
+	else
+	{
+		SG_vhash* pvhRefRemoteDags = NULL;
+		SG_uint32 countDags, i;
+
+		SG_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pMe->pvh_remote_repo_info, "dags", &pvhRefRemoteDags)  );
+		SG_ERR_CHECK(  SG_vhash__count(pCtx, pvhRefRemoteDags, &countDags)  );
+		for (i = 0; i < countDags; i++)
+		{
+			const char* pszRefDagnum = NULL;
+			SG_uint64 dagnum;
+
+			SG_ERR_CHECK(  SG_vhash__get_nth_pair(pCtx, pvhRefRemoteDags, i, &pszRefDagnum, NULL)  );
+			SG_ERR_CHECK(  SG_dagnum__from_sz__hex(pCtx, pszRefDagnum, &dagnum)  );
+			SG_ERR_CHECK(  _add_dagnum_to_request(pCtx, dagnum, &pvhRequest)  );
+		}
+	}
+	if (pvhRequest)
+		SG_ERR_CHECK(  _add_have_sets_to_request(pCtx, pMe->pPullIntoRepo, pvhRequest)  );
+
+	SG_sync_client__pull_request_fragball(pCtx, pClient, pvhRequest, 
 		SG_FALSE, pStagingPathname, &pszFragballName);
 	if(SG_context__err_equals(pCtx, SG_ERR_BRANCH_HEAD_CHANGESET_NOT_PRESENT))
 	{
@@ -444,6 +812,7 @@ static void _add_dagnodes(
 fail:
 	SG_PATHNAME_NULLFREE(pCtx, pStagingPathname);
 	SG_VHASH_NULLFREE(pCtx, pvhStatus);
+	SG_VHASH_NULLFREE(pCtx, pvhRequest);
 	SG_NULLFREE(pCtx, pszFragballName);
 }
 
@@ -238,6 +238,8 @@ static void _add_dagnodes_until_connected(SG_context* pCtx,
 				SG_uint64 iDagnum;
 				SG_vhash* pvhRefAllLeaves;
 				SG_vhash* pvhRefDagLeaves = NULL;
+				SG_vhash* pvhRefAllHaveSets = NULL;
+				SG_vhash* pvhRefHaveSet = NULL;
 				SG_bool bHas;
 
 				SG_ERR_CHECK(  SG_dagnum__from_sz__hex(pCtx, pszRefDagNum, &iDagnum)  );
@@ -253,8 +255,17 @@ static void _add_dagnodes_until_connected(SG_context* pCtx,
 						SG_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhRefAllLeaves, pszRefDagNum, &pvhRefDagLeaves)  );
 				}
 
-				SG_ERR_CHECK(  SG_sync__build_best_guess_dagfrag(pCtx, pMyPush->pRepo, iDagnum, 
-					prb_missing_nodes, pvhRefDagLeaves, &pFrag)  );
+				// Newer servers also tell us what they have, which saves guessing.
+				SG_ERR_CHECK(  SG_vhash__check__vhash(pCtx, *ppvh_status, SG_SYNC_STATUS_KEY__HAVE, &pvhRefAllHaveSets)  );
+				if (pvhRefAllHaveSets)
+					SG_ERR_CHECK(  SG_vhash__check__vhash(pCtx, pvhRefAllHaveSets, pszRefDagNum, &pvhRefHaveSet)  );
+
+				if (pvhRefHaveSet)
+					SG_ERR_CHECK(  SG_sync__build_dagfrag_from_have_set(pCtx, pMyPush->pRepo, iDagnum,
+						prb_missing_nodes, pvhRefHaveSet, &pFrag)  );
+				else
+					SG_ERR_CHECK(  SG_sync__build_best_guess_dagfrag(pCtx, pMyPush->pRepo, iDagnum, 
+						prb_missing_nodes, pvhRefDagLeaves, &pFrag)  );
 				if (pFrag)
 					SG_ERR_CHECK(  SG_fragball__write__frag(pCtx, pfb, pFrag)  );
 				
@@ -15,141 +15,480 @@ limitations under the License.
 */
 
 /*
-   Originally based on code written by Julienne Walker, obtained from
-   the following location, and identified there as "public domain":
-
-     http://www.eternallyconfuzzled.com/tuts/datastructures/jsw_tut_rbtree.aspx
+   An ordered map from string keys to void* assoc data.
+
+   In spite of the name, this is no longer a red-black tree (that
+   code was originally based on Julienne Walker's public domain
+   jsw_rbtree).  It is a B+tree.  All of the keys and assoc data live
+   in the leaves, in sorted arrays, and the leaves are linked together
+   so that iterating is just walking through them.  The branch nodes
+   above the leaves hold separator keys and child pointers.  A lookup
+   in a tree of 100,000 keys visits 4 nodes rather than ~20, and most
+   of its key compares are against pointers which sit next to each
+   other in memory.
+
+   We remember the rightmost leaf, so adding keys in increasing order
+   (which is what happens when one tree is filled from another or
+   from anything else that is sorted) doesn't search at all.  When
+   that leaf is full we leave it full and start a new one, so a tree
+   built in order has no wasted space.
+
+   Removing keys does not rebalance.  A node is freed when it becomes
+   empty, but otherwise nodes are allowed to be sparse.
 */
 
 #include <sg.h>
 
+#define sg_RBTREE_NODE_SPACE		(32)
+
+// Enough for sg_RBTREE_NODE_SPACE^sg_RBTREE_MAX_HEIGHT keys, which
+// is a lot more than an SG_uint32 count can describe.
+#define sg_RBTREE_MAX_HEIGHT		(8)
+
 typedef struct _sg_rbtree_node
 {
-	int red;
-	const char* pszKey;
-	void* assocData;
-	struct _sg_rbtree_node *link[2];
+	SG_uint32 count;
+	SG_bool bLeaf;
+	struct _sg_rbtree_node* pParent;
+	struct _sg_rbtree_node* pPrev;		// leaves only
+	struct _sg_rbtree_node* pNext;		// leaves only
+
+	// In a leaf, aValues[i] is the assocData for aKeys[i].
+	//
+	// In a branch, aValues[i] is a child node.  Every key under it
+	// is >= aKeys[i] and < aKeys[i+1].  Lookups never look at
+	// aKeys[0]; it is only there to be handed up to our parent if
+	// we split.
+	const char* aKeys[sg_RBTREE_NODE_SPACE];
+	void* aValues[sg_RBTREE_NODE_SPACE];
 } sg_rbtree_node;
 
-typedef struct _sg_nodesubpool
+struct _sg_rbtree
 {
+	sg_rbtree_node *root;
+	sg_rbtree_node *pFirst;		// leftmost leaf, where iterators start
+	sg_rbtree_node *pLast;		// rightmost leaf, where in-order adds go
+	SG_uint16 height;
+	SG_strpool *pStrPool;
+	SG_rbtree_compare_function_callback * pfnCompare;
 	SG_uint32 count;
-	SG_uint32 space;
-	sg_rbtree_node* pNodes;
-	struct _sg_nodesubpool* pNext;
-} sg_nodesubpool;
+	SG_bool strpool_is_mine;
+};
 
-typedef struct _sg_rbnodepool
+struct _sg_rbtree_trav
 {
-	SG_uint32 subpool_space;
-	SG_uint32 count_subpools;
-	SG_uint32 count_items;
-	sg_nodesubpool *pHead;
-} sg_rbnodepool;
+	const sg_rbtree_node* pLeaf;
+	SG_uint32 ndx;
+};
 
-void sg_nodesubpool__alloc(SG_context * pCtx, SG_uint32 space, sg_nodesubpool* pNext,
-						   sg_nodesubpool ** ppNew)
-{
-	sg_nodesubpool* pThis = NULL;
-	sg_rbtree_node * pNodes = NULL;
+static void _sg_rbtree__iterator__first(
+	SG_context* pCtx,
+	SG_rbtree_iterator *pit,
+	const SG_rbtree *tree,
+	SG_bool* pbOK,
+	const char** ppszKey,
+	void** pAssocData
+	);
 
-	SG_ERR_CHECK_RETURN(  SG_alloc1(pCtx, pThis)  );
-	SG_ERR_CHECK(  SG_allocN(pCtx, space, pNodes)  );
+//////////////////////////////////////////////////////////////////
 
-	pThis->space = space;
-	pThis->pNodes = pNodes;
-	pThis->pNext = pNext;
-	pThis->count = 0;
+static void sg_rbtree_node__alloc(SG_context* pCtx, SG_bool bLeaf, sg_rbtree_node** ppNew)
+{
+	sg_rbtree_node* pNode = NULL;
 
-	*ppNew = pThis;
+	SG_ERR_CHECK_RETURN(  SG_alloc1(pCtx, pNode)  );
 
-	return;
+	pNode->bLeaf = bLeaf;
 
-fail:
-	SG_NULLFREE(pCtx, pNodes);
-	SG_NULLFREE(pCtx, pThis);
+	*ppNew = pNode;
 }
 
-void sg_nodesubpool__free(SG_context * pCtx, sg_nodesubpool *psp)
+static void sg_rbtree_node__free_recursive(SG_context* pCtx, sg_rbtree_node* pNode)
 {
-	// free this node and everything in the next-chain.
-	// i converted this to a loop rather than recursive
-	// so that we don't blow a stack (either procedure or
-	// error-level).
+	SG_uint32 i;
 
-	while (psp)
+	if (!pNode)
 	{
-		sg_nodesubpool * pspNext = psp->pNext;
+		return;
+	}
 
-		SG_NULLFREE(pCtx, psp->pNodes);
-		SG_NULLFREE(pCtx, psp);
+	if (!pNode->bLeaf)
+	{
+		for (i=0; i<pNode->count; i++)
+		{
+			sg_rbtree_node__free_recursive(pCtx, (sg_rbtree_node*) pNode->aValues[i]);
+		}
+	}
 
-		psp = pspNext;
+	SG_NULLFREE(pCtx, pNode);
+}
+
+/**
+ * Binary search of aKeys[lo..count) for the first key which is
+ * not less than pszKey.  *pbEqual says whether it is equal.
+ */
+static SG_uint32 sg_rbtree_node__search(
+	const sg_rbtree_node* pNode,
+	SG_uint32 lo,
+	SG_rbtree_compare_function_callback * pfnCompare,
+	const char* pszKey,
+	SG_bool* pbEqual
+	)
+{
+	SG_uint32 hi = pNode->count;
+
+	*pbEqual = SG_FALSE;
+
+	while (lo < hi)
+	{
+		SG_uint32 mid = lo + ((hi - lo) / 2);
+		int cmp = (*pfnCompare)(pNode->aKeys[mid], pszKey);
+
+		if (cmp < 0)
+		{
+			lo = mid + 1;
+		}
+		else if (cmp > 0)
+		{
+			hi = mid;
+		}
+		else
+		{
+			*pbEqual = SG_TRUE;
+			return mid;
+		}
 	}
+
+	return lo;
 }
 
-void sg_rbnodepool__alloc(SG_context* pCtx, sg_rbnodepool** ppResult, SG_uint32 subpool_space)
+/**
+ * Find the leaf where pszKey is (or would be) and its
+ * position in that leaf.
+ */
+static void sg_rbtree__search(
+	const SG_rbtree* prb,
+	const char* pszKey,
+	sg_rbtree_node** ppLeaf,
+	SG_uint32* pNdx,
+	SG_bool* pbFound
+	)
 {
-	sg_rbnodepool* pThis = NULL;
+	sg_rbtree_node* pNode = prb->root;
+	SG_bool bEqual = SG_FALSE;
+	SG_uint32 i;
 
-	SG_ERR_CHECK_RETURN(  SG_alloc1(pCtx, pThis)  );
+	if (!pNode)
+	{
+		*ppLeaf = NULL;
+		*pNdx = 0;
+		*pbFound = SG_FALSE;
+		return;
+	}
 
-	pThis->subpool_space = subpool_space;
+	while (!pNode->bLeaf)
+	{
+		i = sg_rbtree_node__search(pNode, 1, prb->pfnCompare, pszKey, &bEqual);
+		if (!bEqual)
+		{
+			i--;
+		}
+		pNode = (sg_rbtree_node*) pNode->aValues[i];
+	}
+
+	*pNdx = sg_rbtree_node__search(pNode, 0, prb->pfnCompare, pszKey, pbFound);
+	*ppLeaf = pNode;
+}
+
+static SG_uint32 sg_rbtree_node__index_in_parent(const sg_rbtree_node* pNode)
+{
+	const sg_rbtree_node* pParent = pNode->pParent;
+	SG_uint32 i;
 
-	SG_ERR_CHECK(  sg_nodesubpool__alloc(pCtx, pThis->subpool_space, NULL, &pThis->pHead)  );
+	for (i=0; i<pParent->count; i++)
+	{
+		if (pParent->aValues[i] == pNode)
+		{
+			break;
+		}
+	}
 
-	pThis->count_subpools = 1;
+	SG_ASSERT(  (i < pParent->count)  );
 
-	*ppResult = pThis;
+	return i;
+}
 
-	return;
+static SG_bool sg_rbtree_node__is_rightmost(const sg_rbtree_node* pNode)
+{
+	while (pNode->pParent)
+	{
+		if (pNode->pParent->aValues[pNode->pParent->count - 1] != pNode)
+		{
+			return SG_FALSE;
+		}
+		pNode = pNode->pParent;
+	}
 
-fail:
-	SG_NULLFREE(pCtx, pThis);
+	return SG_TRUE;
 }
 
-void sg_rbnodepool__free(SG_context * pCtx, sg_rbnodepool* pPool)
+static void sg_rbtree_node__insert_at(
+	sg_rbtree_node* pNode,
+	SG_uint32 ndx,
+	const char* pszKey,
+	void* pValue
+	)
 {
-	if (!pPool)
+	SG_ASSERT(  (pNode->count < sg_RBTREE_NODE_SPACE)  );
+
+	memmove((void*)&pNode->aKeys[ndx + 1], &pNode->aKeys[ndx], (pNode->count - ndx) * sizeof(const char*));
+	memmove(&pNode->aValues[ndx + 1], &pNode->aValues[ndx], (pNode->count - ndx) * sizeof(void*));
+
+	pNode->aKeys[ndx] = pszKey;
+	pNode->aValues[ndx] = pValue;
+	pNode->count++;
+
+	if (!pNode->bLeaf)
 	{
-		return;
+		((sg_rbtree_node*) pValue)->pParent = pNode;
 	}
+}
+
+static void sg_rbtree_node__remove_at(sg_rbtree_node* pNode, SG_uint32 ndx)
+{
+	memmove((void*)&pNode->aKeys[ndx], &pNode->aKeys[ndx + 1], (pNode->count - ndx - 1) * sizeof(const char*));
+	memmove(&pNode->aValues[ndx], &pNode->aValues[ndx + 1], (pNode->count - ndx - 1) * sizeof(void*));
 
-	SG_ERR_IGNORE(  sg_nodesubpool__free(pCtx, pPool->pHead)  );
-	SG_NULLFREE(pCtx, pPool);
+	pNode->count--;
 }
 
-void sg_rbnodepool__add(SG_context* pCtx, sg_rbnodepool* pPool, sg_rbtree_node** ppResult)
+/**
+ * Put the key (which must already be pooled) at position ndx of
+ * pNode, splitting nodes on the way up as necessary.
+ *
+ * All of the nodes a split might need are allocated before we
+ * change anything, so if this fails, the tree is as it was.
+ */
+static void sg_rbtree__insert(
+	SG_context* pCtx,
+	SG_rbtree* prb,
+	sg_rbtree_node* pNode,
+	SG_uint32 ndx,
+	const char* pszKey,
+	void* pValue
+	)
 {
-	if ((pPool->pHead->count + 1) > pPool->pHead->space)
+	sg_rbtree_node* aSpare[sg_RBTREE_MAX_HEIGHT + 1];
+	SG_uint32 count_spare = 0;
+	SG_uint32 i;
+	const sg_rbtree_node* p;
+
+	memset(aSpare, 0, sizeof(aSpare));
+
+	for (p = pNode; p && (p->count == sg_RBTREE_NODE_SPACE); p = p->pParent)
+	{
+		count_spare++;
+	}
+	if (count_spare && !p)
+	{
+		// the root splits, so we need a new root
+		count_spare++;
+	}
+	if (count_spare > sg_RBTREE_MAX_HEIGHT)
 	{
-		sg_nodesubpool* psp = NULL;
+		SG_ERR_THROW_RETURN(  SG_ERR_LIMIT_EXCEEDED  );
+	}
+	for (i=0; i<count_spare; i++)
+	{
+		SG_ERR_CHECK(  sg_rbtree_node__alloc(pCtx, SG_FALSE, &aSpare[i])  );
+	}
+
+	// from here on, nothing can fail
+
+	i = 0;
+	while (1)
+	{
+		sg_rbtree_node* pRight = NULL;
+		SG_uint32 split;
+		SG_uint32 j;
+
+		if (pNode->count < sg_RBTREE_NODE_SPACE)
+		{
+			sg_rbtree_node__insert_at(pNode, ndx, pszKey, pValue);
+			break;
+		}
+
+		pRight = aSpare[i++];
+		pRight->bLeaf = pNode->bLeaf;
+
+		if ((ndx == pNode->count) && sg_rbtree_node__is_rightmost(pNode))
+		{
+			// appending.  leave this node full.
+			split = pNode->count;
+		}
+		else
+		{
+			split = pNode->count / 2;
+		}
+
+		pRight->count = pNode->count - split;
+		memcpy((void*)pRight->aKeys, &pNode->aKeys[split], pRight->count * sizeof(const char*));
+		memcpy(pRight->aValues, &pNode->aValues[split], pRight->count * sizeof(void*));
+		pNode->count = split;
+
+		if (pNode->bLeaf)
+		{
+			pRight->pPrev = pNode;
+			pRight->pNext = pNode->pNext;
+			if (pNode->pNext)
+			{
+				pNode->pNext->pPrev = pRight;
+			}
+			else
+			{
+				prb->pLast = pRight;
+			}
+			pNode->pNext = pRight;
+		}
+		else
+		{
+			for (j=0; j<pRight->count; j++)
+			{
+				((sg_rbtree_node*) pRight->aValues[j])->pParent = pRight;
+			}
+		}
+
+		if (ndx < split)
+		{
+			sg_rbtree_node__insert_at(pNode, ndx, pszKey, pValue);
+		}
+		else
+		{
+			sg_rbtree_node__insert_at(pRight, ndx - split, pszKey, pValue);
+		}
 
-		SG_ERR_CHECK_RETURN(  sg_nodesubpool__alloc(pCtx, pPool->subpool_space, pPool->pHead, &psp)  );
+		if (!pNode->pParent)
+		{
+			sg_rbtree_node* pRoot = aSpare[i++];
+
+			pRoot->bLeaf = SG_FALSE;
+			sg_rbtree_node__insert_at(pRoot, 0, pNode->aKeys[0], pNode);
+			sg_rbtree_node__insert_at(pRoot, 1, pRight->aKeys[0], pRight);
+			prb->root = pRoot;
+			prb->height++;
+			break;
+		}
 
-		pPool->pHead = psp;
-		pPool->count_subpools++;
+		// now insert pRight into our parent, right after us
+
+		ndx = sg_rbtree_node__index_in_parent(pNode) + 1;
+		pszKey = pRight->aKeys[0];
+		pValue = pRight;
+		pNode = pNode->pParent;
 	}
 
-	*ppResult = &(pPool->pHead->pNodes[pPool->pHead->count++]);
-	pPool->count_items++;
+	SG_ASSERT(  (i == count_spare)  );
 
 	return;
+
+fail:
+	for (i=0; i<count_spare; i++)
+	{
+		SG_NULLFREE(pCtx, aSpare[i]);
+	}
 }
 
-struct _sg_rbtree
+/**
+ * Add a key (which must already be pooled) which sorts after
+ * every key already in the tree.
+ */
+static void sg_rbtree__append(
+	SG_context* pCtx,
+	SG_rbtree* prb,
+	const char* pszPooledKey,
+	void* assocData
+	)
 {
-	sg_rbtree_node *root;
-	sg_rbnodepool* pNodePool;
-	SG_strpool *pStrPool;
-	SG_rbtree_compare_function_callback * pfnCompare;
-	SG_uint32 count;
-	SG_bool strpool_is_mine;
-};
+	if (!prb->root)
+	{
+		SG_ERR_CHECK_RETURN(  sg_rbtree_node__alloc(pCtx, SG_TRUE, &prb->root)  );
+		prb->pFirst = prb->root;
+		prb->pLast = prb->root;
+		prb->height = 1;
+	}
+
+	SG_ERR_CHECK_RETURN(  sg_rbtree__insert(pCtx, prb, prb->pLast, prb->pLast->count, pszPooledKey, assocData)  );
+	prb->count++;
+}
+
+/**
+ * pNode just became empty.  Take it out of the tree, along with
+ * any ancestors which become empty as a result.
+ */
+static void sg_rbtree__unlink_empty_node(SG_context* pCtx, SG_rbtree* prb, sg_rbtree_node* pNode)
+{
+	while (1)
+	{
+		sg_rbtree_node* pParent = pNode->pParent;
+
+		if (pNode->bLeaf)
+		{
+			if (pNode->pPrev)
+			{
+				pNode->pPrev->pNext = pNode->pNext;
+			}
+			else
+			{
+				prb->pFirst = pNode->pNext;
+			}
+
+			if (pNode->pNext)
+			{
+				pNode->pNext->pPrev = pNode->pPrev;
+			}
+			else
+			{
+				prb->pLast = pNode->pPrev;
+			}
+		}
+
+		if (!pParent)
+		{
+			// the tree is empty now
+			SG_NULLFREE(pCtx, pNode);
+			prb->root = NULL;
+			prb->pFirst = NULL;
+			prb->pLast = NULL;
+			prb->height = 0;
+			return;
+		}
+
+		sg_rbtree_node__remove_at(pParent, sg_rbtree_node__index_in_parent(pNode));
+		SG_NULLFREE(pCtx, pNode);
+
+		if (pParent->count)
+		{
+			break;
+		}
+
+		pNode = pParent;
+	}
+
+	// a root with only one child is just overhead
+
+	while (!prb->root->bLeaf && (1 == prb->root->count))
+	{
+		sg_rbtree_node* pOld = prb->root;
+
+		prb->root = (sg_rbtree_node*) pOld->aValues[0];
+		prb->root->pParent = NULL;
+		prb->height--;
+		SG_NULLFREE(pCtx, pOld);
+	}
+}
 
 //////////////////////////////////////////////////////////////////
 // Some debug routines to test consistency and dump the tree.
-// These are for the code in SG_rbtree__remove__with_assoc().
 
 #if defined(DEBUG)
 
@@ -195,19 +534,23 @@ void sg_rbtree__verify_count(SG_context * pCtx, const SG_rbtree * prb, SG_uint32
 
 void sg_rbtree_node__recursive_dump_to_console(SG_context * pCtx, const sg_rbtree_node * pNode, SG_uint32 indent)
 {
+	SG_uint32 i;
+
 	if (pNode == NULL)
 	{
 		SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDERR, "%*c(null node)\n", indent, ' ')  );
+		return;
 	}
-	else
-	{
-		SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDERR, "%*c%s [%p] [red %c]\n",
-								   indent, ' ',
-								   pNode->pszKey, pNode->assocData,
-								   ((pNode->red) ? 'Y' : 'N'))  );
 
-		SG_ERR_IGNORE(  sg_rbtree_node__recursive_dump_to_console(pCtx, pNode->link[0], indent+1)  );
-		SG_ERR_IGNORE(  sg_rbtree_node__recursive_dump_to_console(pCtx, pNode->link[1], indent+1)  );
+	for (i=0; i<pNode->count; i++)
+	{
+		SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDERR, "%*c%s%s\n", indent, ' ',
+								   ((pNode->bLeaf) ? "" : ">= "),
+								   ((pNode->bLeaf || i) ? pNode->aKeys[i] : "(first)"))  );
+		if (!pNode->bLeaf)
+		{
+			sg_rbtree_node__recursive_dump_to_console(pCtx, (const sg_rbtree_node *) pNode->aValues[i], indent + 4);
+		}
 	}
 }
 
@@ -254,6 +597,8 @@ void SG_rbtree__alloc__params2(
 	else
 		ptree->pfnCompare = SG_RBTREE__DEFAULT__COMPARE_FUNCTION;
 
+	// the first leaf is allocated on the first add
+
 	ptree->root = NULL;
 
 	if (pStrPool)
@@ -272,8 +617,6 @@ void SG_rbtree__alloc__params2(
 		SG_ERR_CHECK(  SG_STRPOOL__ALLOC(pCtx, &ptree->pStrPool, guess * 64)  );
 	}
 
-	SG_ERR_CHECK(  sg_rbnodepool__alloc(pCtx, &ptree->pNodePool, guess)  );
-
 	ptree->count = 0;
 
 	*ppNew = ptree;
@@ -297,112 +640,6 @@ void SG_rbtree__alloc(
 	SG_ERR_CHECK_RETURN(  SG_rbtree__alloc__params2(pCtx, ppNew, 128, NULL, NULL)  );		// do not use SG_RBTREE__ALLOC__PARAMS macro here.
 }
 
-#if 0
-static int sg_rbtree__is_red ( sg_rbtree_node *root )
-{
-	return root != NULL && root->red == 1;
-}
-#endif
-
-#define sg_rbtree__is_red(root) ( (root) && (1 == (root)->red)  )
-
-static sg_rbtree_node *sg_rbtree_single ( sg_rbtree_node *root, int dir )
-{
-	sg_rbtree_node *save = root->link[!dir];
-
-	root->link[!dir] = save->link[dir];
-	save->link[dir] = root;
-
-	root->red = 1;
-	save->red = 0;
-
-	return save;
-}
-
-static sg_rbtree_node *sg_rbtree_double ( sg_rbtree_node *root, int dir )
-{
-	root->link[!dir] = sg_rbtree_single ( root->link[!dir], !dir );
-	return sg_rbtree_single ( root, dir );
-}
-
-#if 0
-static int sg_rbtree_rb_assert ( sg_rbtree_node *root, SG_rbtree_compare_function_callback * pfnCompare )
-{
-	int lh, rh;
-
-	if ( root == NULL )
-		return 1;
-	else {
-		sg_rbtree_node *ln = root->link[0];
-		sg_rbtree_node *rn = root->link[1];
-
-		/* Consecutive red links */
-		if ( sg_rbtree__is_red ( root ) )
-		{
-			if ( sg_rbtree__is_red ( ln ) || sg_rbtree__is_red ( rn ) )
-			{
-				puts ( "Red violation" );
-				return 0;
-			}
-		}
-
-		lh = sg_rbtree_rb_assert ( ln, pfnCompare );
-		rh = sg_rbtree_rb_assert ( rn, pfnCompare );
-
-		/* Invalid binary search tree */
-		if ( ( ln != NULL && (*pfnCompare)(ln->pszKey, root->pszKey) >= 0 )
-			 || ( rn != NULL && (*pfnCompare)(rn->pszKey, root->pszKey) <= 0 ) )
-		{
-			puts ( "Binary tree violation" );
-			return 0;
-		}
-
-		/* Black height mismatch */
-		if ( lh != 0 && rh != 0 && lh != rh )
-		{
-			puts ( "Black violation" );
-			return 0;
-		}
-
-		/* Only count black links */
-		if ( lh != 0 && rh != 0 )
-			return sg_rbtree__is_red ( root ) ? lh : lh + 1;
-		else
-			return 0;
-	}
-}
-
-void SG_rbtree__verify(
-	SG_UNUSED_PARM( SG_context* pCtx ),
-	const SG_rbtree* prb
-	)
-{
-	SG_UNUSED(  pCtx  );
-	sg_rbtree_rb_assert(prb->root, prb->pfnCompare);
-	return SG_ERR_OK;
-}
-#endif
-
-static void sg_rbtree__alloc_node (SG_context* pCtx, SG_rbtree *tree, sg_rbtree_node** ppnode, const char* pszKey, void* assocData )
-{
-	sg_rbtree_node* rn = NULL;
-
-	SG_ERR_CHECK(  sg_rbnodepool__add(pCtx, tree->pNodePool, &rn)  );
-
-	SG_ERR_CHECK(  SG_strpool__add__sz(pCtx, tree->pStrPool, pszKey, &(rn->pszKey))  );
-	rn->assocData = assocData;
-	rn->red = 1; /* 1 is red, 0 is black */
-	rn->link[0] = NULL;
-	rn->link[1] = NULL;
-
-	*ppnode = rn;
-
-	tree->count++;
-
-fail:
-	return;
-}
-
 void SG_rbtree__free(SG_context * pCtx, SG_rbtree* ptree)
 {
 	if (!ptree)
@@ -415,36 +652,10 @@ void SG_rbtree__free(SG_context * pCtx, SG_rbtree* ptree)
 		SG_STRPOOL_NULLFREE(pCtx, ptree->pStrPool);
 	}
 
-	SG_ERR_IGNORE(  sg_rbnodepool__free(pCtx, ptree->pNodePool)  );
+	sg_rbtree_node__free_recursive(pCtx, ptree->root);
 	SG_NULLFREE(pCtx, ptree);
 }
 
-static void sg_rbtreenode__find(
-	SG_context* pCtx,
-	const sg_rbtree_node* pnode,
-	SG_rbtree_compare_function_callback * pfnCompare,	// i'm passing this down to avoid having a backlink in node to rbtree
-	const char* pszKey,
-	const sg_rbtree_node** pp_result
-	)
-{
-	int cmp;
-
-	if (!pnode)
-		return;
-
-	cmp = (*pfnCompare)(pnode->pszKey, pszKey);
-	if (0 == cmp)
-	{
-        *pp_result = pnode;
-	}
-	else
-	{
-		int dir = cmp < 0;
-
-		SG_ERR_CHECK_RETURN(  sg_rbtreenode__find(pCtx, pnode->link[dir], pfnCompare, pszKey, pp_result)  );
-	}
-}
-
 void SG_rbtree__key(
 	SG_context* pCtx,
 	const SG_rbtree* prb,
@@ -452,13 +663,17 @@ void SG_rbtree__key(
     const char** ppsz_key
 	)
 {
-    const sg_rbtree_node* pnode = NULL;
+	sg_rbtree_node* pLeaf = NULL;
+	SG_uint32 ndx = 0;
+	SG_bool bFound = SG_FALSE;
+
+	SG_NULLARGCHECK_RETURN(prb);
 
-	SG_ERR_CHECK_RETURN(  sg_rbtreenode__find(pCtx, prb->root, prb->pfnCompare, psz, &pnode)  );
+	sg_rbtree__search(prb, psz, &pLeaf, &ndx, &bFound);
 
-	if (pnode)
+	if (bFound)
 	{
-        *ppsz_key = pnode->pszKey;
+        *ppsz_key = pLeaf->aKeys[ndx];
 	}
 	else
 	{
@@ -474,11 +689,15 @@ void SG_rbtree__find(
 	void** pAssocData
 	)
 {
-    const sg_rbtree_node* pnode = NULL;
+	sg_rbtree_node* pLeaf = NULL;
+	SG_uint32 ndx = 0;
+	SG_bool bFound = SG_FALSE;
+
+	SG_NULLARGCHECK_RETURN(prb);
 
-	SG_ERR_CHECK_RETURN(  sg_rbtreenode__find(pCtx, prb->root, prb->pfnCompare, pszKey, &pnode)  );
+	sg_rbtree__search(prb, pszKey, &pLeaf, &ndx, &bFound);
 
-	if (pnode)
+	if (bFound)
 	{
         if (pbFound)
         {
@@ -487,7 +706,7 @@ void SG_rbtree__find(
 
         if (pAssocData)
         {
-            *pAssocData = pnode->assocData;
+            *pAssocData = pLeaf->aValues[ndx];
         }
 	}
 	else
@@ -513,133 +732,65 @@ static void sg_rbtree__add_or_update(
 	const char** ppKeyPooled
 	)
 {
-	SG_bool bCreated = SG_FALSE;
+	sg_rbtree_node* pLeaf = NULL;
+	SG_uint32 ndx = 0;
+	SG_bool bFound = SG_FALSE;
+	const char* pszPooled = NULL;
 
 	SG_NULLARGCHECK_RETURN(pszKey);
 
-	if ( tree->root == NULL )
+	if (
+		tree->pLast
+		&& ((*tree->pfnCompare)(tree->pLast->aKeys[tree->pLast->count - 1], pszKey) < 0)
+		)
 	{
-		/* Empty tree case */
-		SG_ERR_CHECK(  sg_rbtree__alloc_node (pCtx, tree, &tree->root, pszKey, assocData )  );
-		bCreated = SG_TRUE;
-		if (ppKeyPooled)
-		{
-			*ppKeyPooled = tree->root->pszKey;
-		}
+		// after everything in the tree.  no need to search.
+		pLeaf = tree->pLast;
+		ndx = pLeaf->count;
 	}
 	else
 	{
-		sg_rbtree_node head = {0,0,0,{0,0}}; /* False tree root */
-
-		sg_rbtree_node *g, *t;     /* Grandparent & parent */
-		sg_rbtree_node *p, *q;     /* Iterator & parent */
-		int dir = 0;
-		int last = 0;
-
-		/* Set up helpers */
-		t = &head;
-		g = p = NULL;
-		q = t->link[1] = tree->root;
+		sg_rbtree__search(tree, pszKey, &pLeaf, &ndx, &bFound);
+	}
 
-		/* Search down the tree */
-		for ( ; ; )
+	if (bFound)
+	{
+		if (!bUpdate)
 		{
-			int cmp;
-
-			if (!q)
-			{
-				/* Insert new node at the bottom */
-				SG_ERR_CHECK(  sg_rbtree__alloc_node (pCtx, tree, &q, pszKey, assocData )  );
-				if (ppKeyPooled)
-				{
-					*ppKeyPooled = q->pszKey;
-				}
-				p->link[dir] = q;
-				bCreated = SG_TRUE;
-			}
-			else if ( sg_rbtree__is_red ( q->link[0] ) && sg_rbtree__is_red ( q->link[1] ) )
-			{
-				/* Color flip */
-				q->red = 1;
-				q->link[0]->red = 0;
-				q->link[1]->red = 0;
-			}
-
-			/* Fix red violation */
-			if ( sg_rbtree__is_red ( q ) && sg_rbtree__is_red ( p ) )
-			{
-				int dir2 = t->link[1] == g;
-
-				if ( q == p->link[last] )
-				{
-					t->link[dir2] = sg_rbtree_single ( g, !last );
-				}
-				else
-				{
-					t->link[dir2] = sg_rbtree_double ( g, !last );
-				}
-			}
-
-			/* Stop if found */
-			if (bCreated)
-			{
-				break;
-			}
-
-			cmp = (*tree->pfnCompare)(q->pszKey, pszKey);
-
-			if (0 == cmp)
-			{
-				if (bUpdate)
-				{
-					if (pOldAssoc)
-					{
-						*pOldAssoc = q->assocData;
-					}
-					q->assocData = assocData;
-				}
-
-				break;
-			}
-
-			last = dir;
-			dir = cmp < 0;
-
-			/* Update helpers */
-			if ( g != NULL )
-			{
-				t = g;
-			}
-			g = p, p = q;
-			q = q->link[dir];
+			SG_ERR_THROW2_RETURN( SG_ERR_RBTREE_DUPLICATEKEY,
+								  (pCtx, "Key [%s]", pszKey)  );
 		}
 
-		/* Update root */
-		tree->root = head.link[1];
-	}
-
-	/* Make root black */
-	tree->root->red = 0;
-
-	if (bCreated)
-	{
 		if (pOldAssoc)
 		{
-			*pOldAssoc = NULL;
+			*pOldAssoc = pLeaf->aValues[ndx];
 		}
+		pLeaf->aValues[ndx] = assocData;
+
 		return;
 	}
 
-	if (bUpdate)
+	SG_ERR_CHECK_RETURN(  SG_strpool__add__sz(pCtx, tree->pStrPool, pszKey, &pszPooled)  );
+
+	if (!pLeaf)
 	{
-		return;
+		// empty tree
+		SG_ERR_CHECK_RETURN(  sg_rbtree__append(pCtx, tree, pszPooled, assocData)  );
+	}
+	else
+	{
+		SG_ERR_CHECK_RETURN(  sg_rbtree__insert(pCtx, tree, pLeaf, ndx, pszPooled, assocData)  );
+		tree->count++;
 	}
 
-	SG_ERR_THROW2_RETURN( SG_ERR_RBTREE_DUPLICATEKEY,
-						  (pCtx, "Key [%s]", pszKey)  );
-
-fail:
-	return;
+	if (pOldAssoc)
+	{
+		*pOldAssoc = NULL;
+	}
+	if (ppKeyPooled)
+	{
+		*ppKeyPooled = pszPooled;
+	}
 }
 
 void SG_memoryblob__pack(
@@ -863,215 +1014,40 @@ fail:
     return;
 }
 
-
-static void _sg_rbtree__remove__with_assoc__actual( SG_context* pCtx, SG_rbtree *tree, const char* pszKey, void** ppAssocData )
-{
-	if (!tree->root)
-	{
-		SG_ERR_THROW_RETURN( SG_ERR_NOT_FOUND );
-	}
-	else
-	{
-		sg_rbtree_node head = {0,0,0,{0,0}}; /* False tree root */
-		sg_rbtree_node *q, *p, *g; /* Helpers */
-		sg_rbtree_node *f = NULL;  /* Found item */
-		int dir = 1;
-
-		/* Set up helpers */
-		q = &head;
-		g = p = NULL;
-		q->link[1] = tree->root;
-
-		/* Search and push a red down */
-		while ( q->link[dir] != NULL )
-		{
-			int cmp;
-			int last = dir;
-
-			/* Update helpers */
-			g = p, p = q;
-			q = q->link[dir];
-			cmp = (*tree->pfnCompare)(q->pszKey, pszKey);
-			dir = cmp < 0;
-
-			/* Save found node */
-			if ( 0 == cmp )
-			{
-				f = q;
-			}
-
-			/* Push the red node down */
-			if ( !sg_rbtree__is_red ( q ) && !sg_rbtree__is_red ( q->link[dir] ) )
-			{
-				if ( sg_rbtree__is_red ( q->link[!dir] ) )
-				{
-					p = p->link[last] = sg_rbtree_single ( q, dir );
-				}
-				else if ( !sg_rbtree__is_red ( q->link[!dir] ) )
-				{
-					sg_rbtree_node *s = p->link[!last];
-
-					if ( s != NULL )
-					{
-						if ( !sg_rbtree__is_red ( s->link[!last] ) && !sg_rbtree__is_red ( s->link[last] ) )
-						{
-							/* Color flip */
-							p->red = 0;
-							s->red = 1;
-							q->red = 1;
-						}
-						else
-						{
-							int dir2 = g->link[1] == p;
-
-							if ( sg_rbtree__is_red ( s->link[last] ) )
-							{
-								g->link[dir2] = sg_rbtree_double ( p, last );
-							}
-							else if ( sg_rbtree__is_red ( s->link[!last] ) )
-							{
-								g->link[dir2] = sg_rbtree_single ( p, last );
-							}
-
-							/* Ensure correct coloring */
-							q->red = g->link[dir2]->red = 1;
-							g->link[dir2]->link[0]->red = 0;
-							g->link[dir2]->link[1]->red = 0;
-						}
-					}
-				}
-			}
-		}
-
-		/* Replace and remove if found */
-		if ( f != NULL )
-		{
-			if (ppAssocData)
-			{
-				*ppAssocData = f->assocData;
-			}
-
-			f->pszKey = q->pszKey;
-			f->assocData = q->assocData;
-			p->link[p->link[1] == q] =
-				q->link[q->link[0] == NULL];
-
-			tree->count--;
-		}
-		else
-		{
-			SG_ERR_THROW(  SG_ERR_NOT_FOUND  );
-		}
-
-		/* Update root and make it black */
-		tree->root = head.link[1];
-		if ( tree->root != NULL )
-		{
-			tree->root->red = 0;
-		}
-	}
-
-fail:
-	return;
-}
-
 void SG_rbtree__remove__with_assoc( SG_context* pCtx, SG_rbtree *tree, const char* pszKey, void** ppAssocData )
 {
-	// TODO 2010/08/13 BUGBUG sprawl-786
-	// TODO
-	// TODO            There is a bug in the actual remove code when trying
-	// TODO            to remove an key that isn't in the tree.  It starts
-	// TODO            diving and rotating nodes and when finished it has
-	// TODO            lost a bunch of nodes.
-	// TODO
-	// TODO            It doesn't always happen.  It depends on where the
-	// TODO            key is in relation to the other keys in the tree.
-	// TODO
-	// TODO            If we fix that, we can remove this interlude which
-	// TODO            causes us to do a double-lookup.
-
-	SG_bool bFound;
-
-	SG_ERR_CHECK_RETURN(  SG_rbtree__find(pCtx, tree, pszKey, &bFound, NULL)  );
-	if (bFound)
-	{
-		SG_ERR_CHECK_RETURN(  _sg_rbtree__remove__with_assoc__actual(pCtx, tree, pszKey, ppAssocData)  );
-		return;
-	}
-	else
-	{
-		// The item is not present in the rbtree.  We have nothing to do.
-		// But to test the bug, use the following:
-
-#if 0 && defined(DEBUG)
-		SG_uint32 official_count_before;
-		SG_uint32 official_count_after;
-		SG_uint32 observed_count_before;
-		SG_uint32 observed_count_after;
-
-		SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDERR, "[%p] Preparing to remove non-existant key [%s]\n", tree, pszKey)  );
-		SG_ERR_IGNORE(  sg_rbtree__dump_nodes_to_console(pCtx, tree, "Before Attempted Remove")  );
-		SG_ERR_IGNORE(  sg_rbtree__verify_count(pCtx, tree, &observed_count_before)  );
-		official_count_before = tree->count;
-
-		_sg_rbtree__remove__with_assoc__actual(pCtx, tree, pszKey, ppAssocData);
+	sg_rbtree_node* pLeaf = NULL;
+	SG_uint32 ndx = 0;
+	SG_bool bFound = SG_FALSE;
 
-		SG_ERR_IGNORE(  sg_rbtree__dump_nodes_to_console(pCtx, tree, "After Attempted Remove")  );
-		SG_ERR_IGNORE(  sg_rbtree__verify_count(pCtx, tree, &observed_count_after)  );
-		official_count_after = tree->count;
-
-		SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDERR,
-								   ("Counts: before [observed %5d][official %5d]\n"
-									"         after [observed %5d][official %5d]\n"),
-								   observed_count_before, official_count_before,
-								   observed_count_after,  official_count_after)  );
+	SG_NULLARGCHECK_RETURN(tree);
+	SG_NULLARGCHECK_RETURN(pszKey);
 
-		// let the SG_ERR_NOT_FOUND from the actual-remove continue up.
+	sg_rbtree__search(tree, pszKey, &pLeaf, &ndx, &bFound);
 
-		SG_ERR_RETHROW_RETURN;
-#else
+	if (!bFound)
+	{
 		SG_ERR_THROW_RETURN(  SG_ERR_NOT_FOUND  );
-#endif
 	}
-}
 
-void SG_rbtree__remove ( SG_context* pCtx, SG_rbtree *tree, const char* pszKey )
-{
-	SG_ERR_CHECK_RETURN(  SG_rbtree__remove__with_assoc(pCtx, tree, pszKey, NULL)  );
-}
-
-void sg_rbtreenode__calc_depth(
-	SG_context* pCtx,
-	const sg_rbtree_node* pnode,
-	SG_uint16* piDepth,
-	SG_uint16 curDepth
-	)
-{
-	if (curDepth > *piDepth)
+	if (ppAssocData)
 	{
-		*piDepth = curDepth;
+		*ppAssocData = pLeaf->aValues[ndx];
 	}
 
-	if (pnode->link[0])
-	{
-		SG_ERR_CHECK(  sg_rbtreenode__calc_depth(pCtx, pnode->link[0], piDepth, 1 + curDepth)  );
-	}
+	sg_rbtree_node__remove_at(pLeaf, ndx);
+	tree->count--;
 
-	if (pnode->link[1])
+	if (0 == pLeaf->count)
 	{
-		SG_ERR_CHECK(  sg_rbtreenode__calc_depth(pCtx, pnode->link[1], piDepth, 1 + curDepth)  );
+		sg_rbtree__unlink_empty_node(pCtx, tree, pLeaf);
 	}
-
-fail:
-	return;
 }
 
-struct _sg_rbtree_trav
+void SG_rbtree__remove ( SG_context* pCtx, SG_rbtree *tree, const char* pszKey )
 {
-	sg_rbtree_node *up[128]; /* Stack */
-	sg_rbtree_node *it;     /* Current node */
-	int top;                 /* Top of stack */
-};
+	SG_ERR_CHECK_RETURN(  SG_rbtree__remove__with_assoc(pCtx, tree, pszKey, NULL)  );
+}
 
 static void _sg_rbtree__iterator__first(
 	SG_context* pCtx,
@@ -1084,27 +1060,20 @@ static void _sg_rbtree__iterator__first(
 {
 	SG_NULLARGCHECK_RETURN(pit);
 
-	pit->it = tree->root;
-	pit->top = 0;
+	// leaves are never empty, except for a moment during remove
 
-	if ( pit->it != NULL )
-	{
-		while ( pit->it->link[0] != NULL )
-		{
-			pit->up[pit->top++] = pit->it;
-			pit->it = pit->it->link[0];
-		}
-	}
+	pit->pLeaf = tree->pFirst;
+	pit->ndx = 0;
 
-	if ( pit->it != NULL )
+	if ( pit->pLeaf != NULL )
 	{
         if (ppszKey)
         {
-		    *ppszKey = pit->it->pszKey;
+		    *ppszKey = pit->pLeaf->aKeys[0];
         }
 		if (pAssocData)
 		{
-			*pAssocData = pit->it->assocData;
+			*pAssocData = pit->pLeaf->aValues[0];
 		}
 		if (pbOK)
 			*pbOK = SG_TRUE;
@@ -1127,12 +1096,12 @@ void SG_rbtree__get_only_entry(
 
     if (ppszKey)
     {
-        *ppszKey = tree->root->pszKey;
+        *ppszKey = tree->pFirst->aKeys[0];
     }
 
     if (pAssocData)
     {
-        *pAssocData = tree->root->assocData;
+        *pAssocData = tree->pFirst->aValues[0];
     }
 }
 
@@ -1179,43 +1148,25 @@ void SG_rbtree__iterator__next(
 	SG_NULLARGCHECK_RETURN(trav);
 	SG_NULLARGCHECK_RETURN(pbOK);
 
-	if ( trav->it->link[1] != NULL )
+	if ( trav->pLeaf != NULL )
 	{
-		trav->up[trav->top++] = trav->it;
-		trav->it = trav->it->link[1];
-
-		while ( trav->it->link[0] != NULL )
+		trav->ndx++;
+		if (trav->ndx >= trav->pLeaf->count)
 		{
-			trav->up[trav->top++] = trav->it;
-			trav->it = trav->it->link[0];
+			trav->pLeaf = trav->pLeaf->pNext;
+			trav->ndx = 0;
 		}
 	}
-	else
-	{
-		sg_rbtree_node *last;
-
-		do
-		{
-			if ( trav->top == 0 )
-			{
-				trav->it = NULL;
-				break;
-			}
-
-			last = trav->it;
-			trav->it = trav->up[--trav->top];
-		} while ( last == trav->it->link[1] );
-	}
 
-	if ( trav->it != NULL )
+	if ( trav->pLeaf != NULL )
 	{
         if (ppszKey)
         {
-		    *ppszKey = trav->it->pszKey;
+		    *ppszKey = trav->pLeaf->aKeys[trav->ndx];
         }
 		if (pAssocData)
 		{
-			*pAssocData = trav->it->assocData;
+			*pAssocData = trav->pLeaf->aValues[trav->ndx];
 		}
 		*pbOK = SG_TRUE;
 	}
@@ -1252,9 +1203,6 @@ void SG_rbtree__foreach(
 
 	/* Note that foreach is not allowed to alloc memory from the heap.
 	 * We instantiate the iterator on the stack instead.
-	 *
-	 * REVIEW: Jeff says: Is the above comment still valid?  We're probably
-	 *                    breaking that rule all over the place....
 	 */
 
 	SG_ERR_CHECK(  _sg_rbtree__iterator__first(pCtx, &trav, prb, &b, &pszKey, &assocData)  );
@@ -1273,11 +1221,11 @@ fail:
 void SG_rbtree__compare__keys_only(SG_context* pCtx, const SG_rbtree* prb1, const SG_rbtree* prb2, SG_bool* pbIdentical, SG_rbtree* prbOnly1, SG_rbtree* prbOnly2, SG_rbtree* prbBoth)
 {
 	SG_bool bIdentical;
-	SG_rbtree_iterator* ptrav1 = NULL;
+	SG_rbtree_iterator trav1;
 	const char* pszKey1;
 	SG_bool b1;
 
-	SG_rbtree_iterator* ptrav2 = NULL;
+	SG_rbtree_iterator trav2;
 	const char* pszKey2;
 	SG_bool b2;
 
@@ -1287,14 +1235,20 @@ void SG_rbtree__compare__keys_only(SG_context* pCtx, const SG_rbtree* prb1, cons
 		&& !prbBoth
 		);
 
+	SG_NULLARGCHECK_RETURN(prb1);
+	SG_NULLARGCHECK_RETURN(prb2);
+
 	// for now, we require that both rbtrees have the same ordering function
 	// because we are just iterating on them in tandom.
 	SG_ARGCHECK_RETURN(  (prb1->pfnCompare == prb2->pfnCompare),  prb1->pfnCompare  );
 
 	bIdentical = SG_TRUE;
 
-	SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &ptrav1, prb1, &b1, &pszKey1, NULL)  );
-	SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &ptrav2, prb2, &b2, &pszKey2, NULL)  );
+	// Keys come out of this in order, so each of the output
+	// trees gets appended to without searching.
+
+	SG_ERR_CHECK(  _sg_rbtree__iterator__first(pCtx, &trav1, prb1, &b1, &pszKey1, NULL)  );
+	SG_ERR_CHECK(  _sg_rbtree__iterator__first(pCtx, &trav2, prb2, &b2, &pszKey2, NULL)  );
 
 	while (b1 || b2)
 	{
@@ -1307,75 +1261,71 @@ void SG_rbtree__compare__keys_only(SG_context* pCtx, const SG_rbtree* prb1, cons
 				{
 					SG_ERR_CHECK(  SG_rbtree__add(pCtx, prbBoth, pszKey1)  );
 				}
-				SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, ptrav1, &b1, &pszKey1, NULL)  );
-				SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, ptrav2, &b2, &pszKey2, NULL)  );
+				SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, &trav1, &b1, &pszKey1, NULL)  );
+				SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, &trav2, &b2, &pszKey2, NULL)  );
 			}
 			else
 			{
 				bIdentical = SG_FALSE;
 				if (bNoOutputLists)
 				{
-					if (pbIdentical)
-					{
-						*pbIdentical = SG_FALSE;
-					}
 					break;
 				}
 
 				if (cmp > 0)
 				{
-
 					// 1 is ahead.
 					if (prbOnly2)
 					{
 						SG_ERR_CHECK(  SG_rbtree__add(pCtx, prbOnly2, pszKey2)  );
 					}
-					SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, ptrav2, &b2, &pszKey2, NULL)  );
+					SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, &trav2, &b2, &pszKey2, NULL)  );
 				}
 				else
 				{
-					bIdentical = SG_FALSE;
-
 					// 2 is ahead.
 					if (prbOnly1)
 					{
 						SG_ERR_CHECK(  SG_rbtree__add(pCtx, prbOnly1, pszKey1)  );
 					}
-					SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, ptrav1, &b1, &pszKey1, NULL)  );
+					SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, &trav1, &b1, &pszKey1, NULL)  );
 				}
 			}
 		}
-		else if (b1)
+		else
 		{
-			if (prbOnly1)
+			bIdentical = SG_FALSE;
+			if (bNoOutputLists)
 			{
-				SG_ERR_CHECK(  SG_rbtree__add(pCtx, prbOnly1, pszKey1)  );
+				break;
 			}
-			SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, ptrav1, &b1, &pszKey1, NULL)  );
-		}
-		else
-		{
-			if (prbOnly2)
+
+			if (b1)
 			{
-				SG_ERR_CHECK(  SG_rbtree__add(pCtx, prbOnly2, pszKey2)  );
+				if (prbOnly1)
+				{
+					SG_ERR_CHECK(  SG_rbtree__add(pCtx, prbOnly1, pszKey1)  );
+				}
+				SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, &trav1, &b1, &pszKey1, NULL)  );
+			}
+			else
+			{
+				if (prbOnly2)
+				{
+					SG_ERR_CHECK(  SG_rbtree__add(pCtx, prbOnly2, pszKey2)  );
+				}
+				SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, &trav2, &b2, &pszKey2, NULL)  );
 			}
-			SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, ptrav2, &b2, &pszKey2, NULL)  );
 		}
 	}
 
-	SG_RBTREE_ITERATOR_NULLFREE(pCtx, ptrav1);
-	SG_RBTREE_ITERATOR_NULLFREE(pCtx, ptrav2);
-
 	if (pbIdentical)
 	{
 		*pbIdentical = bIdentical;
 	}
 
-	return;
-
 fail:
-	SG_RBTREE_ITERATOR_NULLFREE(pCtx, ptrav1);
-	SG_RBTREE_ITERATOR_NULLFREE(pCtx, ptrav2);
+	return;
 }
 
 void SG_rbtree__copy_keys_into_varray(SG_context* pCtx, const SG_rbtree* prb, SG_varray* pva)
@@ -1522,15 +1472,122 @@ void SG_rbtree__depth(
 	SG_uint16* piDepth
 	)
 {
-	SG_uint16 depth = 0;
-
 	SG_NULLARGCHECK_RETURN(prb);
-	SG_ERR_CHECK(  sg_rbtreenode__calc_depth(pCtx, prb->root, &depth, 0)  );
+	SG_NULLARGCHECK_RETURN(piDepth);
+
+	*piDepth = prb->height;
+}
+
+/**
+ * Rebuild prb from the union of its own keys and the keys of
+ * prbOther.  Both trees are walked in order and the result is
+ * built by appending, so this is linear rather than a search per
+ * key, and the new tree has full leaves.
+ *
+ * When a key is in both trees, bUpdate says what happens: either
+ * it gets NULL assoc data (like SG_rbtree__update()) or it is a
+ * duplicate key error, in which case prb is left as it was.
+ * Keys which are only in prbOther get its assoc data when
+ * bUpdate is false and NULL when it is true.
+ */
+static void sg_rbtree__merge(
+	SG_context* pCtx,
+	SG_rbtree* prb,
+	const SG_rbtree* prbOther,
+	SG_bool bUpdate
+	)
+{
+	SG_rbtree merged;
+	SG_rbtree_iterator trav1;
+	SG_rbtree_iterator trav2;
+	const char* pszKey1 = NULL;
+	const char* pszKey2 = NULL;
+	void* assoc1 = NULL;
+	void* assoc2 = NULL;
+	SG_bool b1 = SG_FALSE;
+	SG_bool b2 = SG_FALSE;
+	SG_bool bSamePool = (prb->pStrPool == prbOther->pStrPool);
 
-	*piDepth = depth;
+	memset(&merged, 0, sizeof(merged));
+	merged.pfnCompare = prb->pfnCompare;
+	merged.pStrPool = prb->pStrPool;
+
+	SG_ERR_CHECK(  _sg_rbtree__iterator__first(pCtx, &trav1, prb, &b1, &pszKey1, &assoc1)  );
+	SG_ERR_CHECK(  _sg_rbtree__iterator__first(pCtx, &trav2, prbOther, &b2, &pszKey2, &assoc2)  );
+
+	while (b1 || b2)
+	{
+		int cmp;
+
+		if (b1 && b2)
+			cmp = (*prb->pfnCompare)(pszKey1, pszKey2);
+		else if (b1)
+			cmp = -1;
+		else
+			cmp = 1;
+
+		if (cmp < 0)
+		{
+			SG_ERR_CHECK(  sg_rbtree__append(pCtx, &merged, pszKey1, assoc1)  );
+			SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, &trav1, &b1, &pszKey1, &assoc1)  );
+		}
+		else if (cmp > 0)
+		{
+			const char* pszPooled = pszKey2;
+
+			if (!bSamePool)
+			{
+				SG_ERR_CHECK(  SG_strpool__add__sz(pCtx, merged.pStrPool, pszKey2, &pszPooled)  );
+			}
+			SG_ERR_CHECK(  sg_rbtree__append(pCtx, &merged, pszPooled, ((bUpdate) ? NULL : assoc2))  );
+			SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, &trav2, &b2, &pszKey2, &assoc2)  );
+		}
+		else
+		{
+			if (!bUpdate)
+			{
+				SG_ERR_THROW2( SG_ERR_RBTREE_DUPLICATEKEY,
+							   (pCtx, "Key [%s]", pszKey2)  );
+			}
+
+			SG_ERR_CHECK(  sg_rbtree__append(pCtx, &merged, pszKey1, NULL)  );
+			SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, &trav1, &b1, &pszKey1, &assoc1)  );
+			SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, &trav2, &b2, &pszKey2, &assoc2)  );
+		}
+	}
+
+	sg_rbtree_node__free_recursive(pCtx, prb->root);
+
+	prb->root = merged.root;
+	prb->pFirst = merged.pFirst;
+	prb->pLast = merged.pLast;
+	prb->height = merged.height;
+	prb->count = merged.count;
 
-fail:
 	return;
+
+fail:
+	sg_rbtree_node__free_recursive(pCtx, merged.root);
+}
+
+/**
+ * Is it cheaper to merge prbOther into prb than to add its keys
+ * one at a time?  Merging touches every key in both trees, so it
+ * only wins when prbOther is not tiny compared to prb.
+ */
+static SG_bool sg_rbtree__should_merge(const SG_rbtree* prb, const SG_rbtree* prbOther)
+{
+	if (prb->pfnCompare != prbOther->pfnCompare)
+	{
+		return SG_FALSE;
+	}
+
+	if (0 == prbOther->count)
+	{
+		return SG_FALSE;
+	}
+
+	return ((SG_uint64)prbOther->count * 8 >= (SG_uint64)prb->count);
 }
 
 void SG_rbtree__add__from_other_rbtree(
@@ -1539,7 +1596,7 @@ void SG_rbtree__add__from_other_rbtree(
 	const SG_rbtree* prbOther
 	)
 {
-	SG_rbtree_iterator* ptrav = NULL;
+	SG_rbtree_iterator trav;
 	const char* pszKey;
 	void* assocData;
 	SG_bool b;
@@ -1547,21 +1604,20 @@ void SG_rbtree__add__from_other_rbtree(
 	SG_NULLARGCHECK_RETURN( prb );
 	SG_NULLARGCHECK_RETURN( prbOther );
 
-	SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &ptrav, prbOther, &b, &pszKey, &assocData)  );
-
-	while (b)
+	if (sg_rbtree__should_merge(prb, prbOther))
 	{
-		SG_ERR_CHECK(  SG_rbtree__add__with_assoc(pCtx, prb, pszKey, assocData)  );
-
-		SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, ptrav, &b, &pszKey, &assocData)  );
+		SG_ERR_CHECK_RETURN(  sg_rbtree__merge(pCtx, prb, prbOther, SG_FALSE)  );
+		return;
 	}
 
-	SG_RBTREE_ITERATOR_NULLFREE(pCtx, ptrav);
+	SG_ERR_CHECK_RETURN(  _sg_rbtree__iterator__first(pCtx, &trav, prbOther, &b, &pszKey, &assocData)  );
 
-	return;
+	while (b)
+	{
+		SG_ERR_CHECK_RETURN(  SG_rbtree__add__with_assoc(pCtx, prb, pszKey, assocData)  );
 
-fail:
-	SG_RBTREE_ITERATOR_NULLFREE(pCtx, ptrav);
+		SG_ERR_CHECK_RETURN(  SG_rbtree__iterator__next(pCtx, &trav, &b, &pszKey, &assocData)  );
+	}
 }
 
 void SG_rbtree__update__from_other_rbtree__keys_only(
@@ -1570,28 +1626,27 @@ void SG_rbtree__update__from_other_rbtree__keys_only(
 	const SG_rbtree* prbOther
 	)
 {
-	SG_rbtree_iterator* ptrav = NULL;
+	SG_rbtree_iterator trav;
 	const char* pszKey;
 	SG_bool b;
 
 	SG_NULLARGCHECK_RETURN( prb );
 	SG_NULLARGCHECK_RETURN( prbOther );
 
-	SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &ptrav, prbOther, &b, &pszKey, NULL)  );
-
-	while (b)
+	if (sg_rbtree__should_merge(prb, prbOther))
 	{
-		SG_ERR_CHECK(  SG_rbtree__update(pCtx, prb, pszKey)  );
-
-		SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, ptrav, &b, &pszKey, NULL)  );
+		SG_ERR_CHECK_RETURN(  sg_rbtree__merge(pCtx, prb, prbOther, SG_TRUE)  );
+		return;
 	}
 
-	SG_RBTREE_ITERATOR_NULLFREE(pCtx, ptrav);
+	SG_ERR_CHECK_RETURN(  _sg_rbtree__iterator__first(pCtx, &trav, prbOther, &b, &pszKey, NULL)  );
 
-	return;
+	while (b)
+	{
+		SG_ERR_CHECK_RETURN(  SG_rbtree__update(pCtx, prb, pszKey)  );
 
-fail:
-	SG_RBTREE_ITERATOR_NULLFREE(pCtx, ptrav);
+		SG_ERR_CHECK_RETURN(  SG_rbtree__iterator__next(pCtx, &trav, &b, &pszKey, NULL)  );
+	}
 }
 
 void SG_rbtree__free__with_assoc(SG_context * pCtx, SG_rbtree * prb, SG_free_callback* cb)
@@ -44,6 +44,36 @@ void SG_repo__get_descriptor_name(
 	*ppszDescriptorName = pRepo->psz_descriptor_name;
 }
 
+void SG_repo__get_instance_key(
+	SG_context* pCtx,
+	SG_repo* pRepo,
+	const char** ppszKey)
+{
+	char* pszRepoId = NULL;
+	SG_string* pstrDescriptor = NULL;
+	SG_string* pstrKey = NULL;
+
+	SG_NULLARGCHECK_RETURN(pRepo);
+	SG_NULLARGCHECK_RETURN(ppszKey);
+
+	if (!pRepo->psz_instance_key)
+	{
+		SG_ERR_CHECK(  SG_repo__get_repo_id(pCtx, pRepo, &pszRepoId)  );
+		SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstrDescriptor)  );
+		SG_ERR_CHECK(  SG_vhash__to_json(pCtx, pRepo->pvh_descriptor, pstrDescriptor)  );
+		SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstrKey)  );
+		SG_ERR_CHECK(  SG_string__sprintf(pCtx, pstrKey, "%s %s", pszRepoId, SG_string__sz(pstrDescriptor))  );
+		SG_ERR_CHECK(  SG_string__sizzle(pCtx, &pstrKey, (SG_byte**)&pRepo->psz_instance_key, NULL)  );
+	}
+
+	*ppszKey = pRepo->psz_instance_key;
+
+fail:
+	SG_NULLFREE(pCtx, pszRepoId);
+	SG_STRING_NULLFREE(pCtx, pstrDescriptor);
+	SG_STRING_NULLFREE(pCtx, pstrKey);
+}
+
 //////////////////////////////////////////////////////////////////
 
 void SG_repo__alloc(SG_context * pCtx, SG_repo ** ppRepo, const char * pszStorage)
@@ -345,8 +375,10 @@ void SG_repo__free(SG_context* pCtx, SG_repo* pRepo)
 	SG_ERR_IGNORE(  sg_repo__unbind_vtable(pCtx, pRepo)  );
 
     SG_VHASH_NULLFREE(pCtx, pRepo->pvh_descriptor);
+	SG_VECTOR_I64_NULLFREE(pCtx, pRepo->pvec_dagnums_changed);
 
 	SG_NULLFREE(pCtx, pRepo->psz_descriptor_name);
+	SG_NULLFREE(pCtx, pRepo->psz_instance_key);
 
 	SG_NULLFREE(pCtx, pRepo);
 }
@@ -520,13 +552,61 @@ void SG_repo__begin_tx__flags(SG_context* pCtx,
 	pRepo->p_vtable->begin_tx(pCtx,pRepo,flags,ppTx);
 }
 
+/**
+ * Remember that the current tx gives this dag new nodes, so we can tell
+ * the response cache once it commits.
+ */
+static void _note_dag_changed(SG_context* pCtx, SG_repo* pRepo, SG_uint64 iDagNum)
+{
+	SG_uint32 count = 0;
+	SG_uint32 k;
+
+	if (!pRepo->pvec_dagnums_changed)
+		SG_ERR_CHECK_RETURN(  SG_VECTOR_I64__ALLOC(pCtx, &pRepo->pvec_dagnums_changed, 4)  );
+
+	SG_ERR_CHECK_RETURN(  SG_vector_i64__length(pCtx, pRepo->pvec_dagnums_changed, &count)  );
+	for (k=0; k<count; k++)
+	{
+		SG_int64 i64 = 0;
+
+		SG_ERR_CHECK_RETURN(  SG_vector_i64__get(pCtx, pRepo->pvec_dagnums_changed, k, &i64)  );
+		if ((SG_uint64)i64 == iDagNum)
+			return;
+	}
+
+	SG_ERR_CHECK_RETURN(  SG_vector_i64__append(pCtx, pRepo->pvec_dagnums_changed, (SG_int64)iDagNum, NULL)  );
+}
+
 void SG_repo__commit_tx(SG_context* pCtx,
 						SG_repo* pRepo,
 						SG_repo_tx_handle** ppTx)
 {
+	SG_uint32 count = 0;
+	SG_uint32 k;
+
 	VERIFY_VTABLE_AND_INSTANCE(pRepo);
 
 	pRepo->p_vtable->commit_tx(pCtx,pRepo,ppTx);
+	if (SG_CONTEXT__HAS_ERR(pCtx))
+	{
+		SG_VECTOR_I64_NULLFREE(pCtx, pRepo->pvec_dagnums_changed);
+		SG_ERR_RETHROW_RETURN;
+	}
+
+	if (pRepo->pvec_dagnums_changed)
+	{
+		SG_ERR_CHECK(  SG_vector_i64__length(pCtx, pRepo->pvec_dagnums_changed, &count)  );
+		for (k=0; k<count; k++)
+		{
+			SG_int64 i64 = 0;
+
+			SG_ERR_CHECK(  SG_vector_i64__get(pCtx, pRepo->pvec_dagnums_changed, k, &i64)  );
+			SG_ERR_CHECK(  SG_responsecache__dag_changed(pCtx, pRepo, (SG_uint64)i64)  );
+		}
+	}
+
+fail:
+	SG_VECTOR_I64_NULLFREE(pCtx, pRepo->pvec_dagnums_changed);
 }
 
 void SG_repo__abort_tx(SG_context* pCtx,
@@ -535,6 +615,8 @@ void SG_repo__abort_tx(SG_context* pCtx,
 {
 	VERIFY_VTABLE_AND_INSTANCE(pRepo);
 
+	SG_VECTOR_I64_NULLFREE(pCtx, pRepo->pvec_dagnums_changed);
+
 	pRepo->p_vtable->abort_tx(pCtx,pRepo,ppTx);
 }
 
@@ -702,11 +784,19 @@ void SG_repo__store_dagfrag(SG_context* pCtx,
 								 SG_repo_tx_handle* pTx,
 								 SG_dagfrag * pFrag)
 {
+	SG_uint64 iDagNum = 0;
+
 	VERIFY_VTABLE_AND_INSTANCE(pRepo);
 
 	SG_NULLARGCHECK_RETURN(pFrag);
 
+	// The implementation takes the frag, so get the dagnum first.
+	SG_ERR_CHECK_RETURN(  SG_dagfrag__get_dagnum(pCtx, pFrag, &iDagNum)  );
+
 	pRepo->p_vtable->store_dagfrag(pCtx,pRepo,pTx,pFrag);
+	SG_ERR_CHECK_RETURN_CURRENT;
+
+	SG_ERR_CHECK_RETURN(  _note_dag_changed(pCtx, pRepo, iDagNum)  );
 }
 
 void SG_repo__done_with_dag(SG_context* pCtx,
@@ -1175,6 +1265,20 @@ void SG_repo__store_blob__abort(
     pRepo->p_vtable->store_blob__abort(pCtx, pRepo, pTx, ppHandle);
 }
 
+void SG_repo__store_blobs__batch(SG_context* pCtx,
+								 SG_repo * pRepo,
+								 SG_repo_tx_handle* pTx,
+								 SG_bool b_dont_bother,
+								 SG_uint32 count,
+								 const SG_byte* const* ap_buf,
+								 const SG_uint32* a_len,
+								 char** apsz_hid_returned)
+{
+    VERIFY_VTABLE_AND_INSTANCE(pRepo);
+
+    pRepo->p_vtable->store_blobs__batch(pCtx, pRepo, pTx, b_dont_bother, count, ap_buf, a_len, apsz_hid_returned);
+}
+
 void SG_repo__fetch_blob__begin(
 	SG_context* pCtx,
     SG_repo * pRepo,
@@ -1187,10 +1291,13 @@ void SG_repo__fetch_blob__begin(
     SG_repo_fetch_blob_handle** ppHandle
     )
 {
+    SG_int64 tPerf;
+
     VERIFY_VTABLE_AND_INSTANCE(pRepo);
 
+    tPerf = SG_perf__start();
     pRepo->p_vtable->fetch_blob__begin(pCtx, pRepo, psz_hid_blob, b_convert_to_full, pBlobFormat, ppsz_hid_vcdiff_reference, pLenRawData, pLenFull, ppHandle);
-
+    SG_perf__stop(SG_PERF_CATEGORY__BLOB_FETCH, tPerf, 0);
 }
 
 void SG_repo__fetch_blob__chunk(
@@ -1203,10 +1310,14 @@ void SG_repo__fetch_blob__chunk(
     SG_bool* pb_done
     )
 {
+    SG_int64 tPerf;
+
     VERIFY_VTABLE_AND_INSTANCE(pRepo);
 	SG_NULLARGCHECK_RETURN(pHandle);
 
+    tPerf = SG_perf__start();
     pRepo->p_vtable->fetch_blob__chunk(pCtx, pRepo, pHandle, len_buf, p_buf, p_len_got, pb_done);
+    SG_perf__stop(SG_PERF_CATEGORY__BLOB_FETCH, tPerf, ((p_len_got && !SG_CONTEXT__HAS_ERR(pCtx)) ? *p_len_got : 0));
 }
 
 void SG_repo__fetch_blob__end(
@@ -1231,6 +1342,24 @@ void SG_repo__fetch_blob__abort(
     pRepo->p_vtable->fetch_blob__abort(pCtx, pRepo, ppHandle);
 }
 
+void SG_repo__fetch_blob__file_range(
+	SG_context* pCtx,
+    SG_repo * pRepo,
+    const char* psz_hid_blob,
+    SG_pathname** ppPath,
+    SG_uint64* pOffset,
+    SG_uint64* pLen
+    )
+{
+    VERIFY_VTABLE_AND_INSTANCE(pRepo);
+	SG_NONEMPTYCHECK_RETURN(psz_hid_blob);
+	SG_NULLARGCHECK_RETURN(ppPath);
+	SG_NULLARGCHECK_RETURN(pOffset);
+	SG_NULLARGCHECK_RETURN(pLen);
+
+    pRepo->p_vtable->fetch_blob__file_range(pCtx, pRepo, psz_hid_blob, ppPath, pOffset, pLen);
+}
+
 void SG_repo__store_audit(
     SG_context* pCtx,
     SG_repo * pRepo,
@@ -1890,6 +2019,17 @@ void SG_repo__rebuild_indexes(
 	pRepo->p_vtable->rebuild_indexes(pCtx,pRepo);
 }
 
+void SG_repo__train_blob_dictionaries(
+	SG_context* pCtx,
+    SG_repo* pRepo,
+    SG_vhash** ppvh_stats
+    )
+{
+	VERIFY_VTABLE_AND_INSTANCE(pRepo);
+
+	pRepo->p_vtable->train_blob_dictionaries(pCtx,pRepo,ppvh_stats);
+}
+
 void SG_repo__get_blob(
     SG_context* pCtx,
 	SG_repo * pRepo,
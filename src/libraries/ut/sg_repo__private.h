@@ -76,6 +76,10 @@ struct _SG_repo
 
 	sg_repo__vtable *		            p_vtable;		        // the binding to a specific REPO VTABLE implementation
 	void*	                            p_vtable_instance_data;	// binding-specific instance data (opaque outside of imp)
+
+	SG_vector_i64*						pvec_dagnums_changed;	// dags given new nodes in the current tx, for the response cache
+
+	char*								psz_instance_key;		// see SG_repo__get_instance_key(), computed on first use
 };
 
 //////////////////////////////////////////////////////////////////
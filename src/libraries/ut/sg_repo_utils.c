@@ -113,11 +113,14 @@ void sg_repo_utils__hash_chunk__from_sghash(SG_context * pCtx,
 {
 	SGHASH_handle * p_sghash_handle = (SGHASH_handle *)pHandle;
 	SG_error err;
+	SG_int64 tPerf;
 
 	SG_NULLARGCHECK_RETURN(p_sghash_handle);
 	// we allow a null or zero-length buffer
 
+	tPerf = SG_perf__start();
 	err = SGHASH_update(p_sghash_handle, p_chunk, len_chunk);
+	SG_perf__stop(SG_PERF_CATEGORY__HASH, tPerf, len_chunk);
 	if (SG_IS_ERROR(err))
 		SG_ERR_THROW_RETURN(  err  );
 }
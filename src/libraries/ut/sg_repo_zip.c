@@ -16,84 +16,518 @@ limitations under the License.
 
 /**
  * @file sg_repo_zip.c
+ *
+ * @details Write the tree of a changeset into a zip file.
+ *
+ * Most of the work is getting each file's contents deflated, and the
+ * files are independent of each other, so we first walk the tree to
+ * make a list of entries and then let an SG_thread_pool build them
+ * (the same way sg_wc_fetch_blobs does for checkout).  Each
+ * worker deflates an entry into memory and then appends it to the zip
+ * while holding the zip's mutex.  The queue has a mutex of its own, so
+ * a worker streaming a big entry into the zip doesn't keep the others
+ * from taking their next job and deflating it.  The order of the entries in a zip file
+ * doesn't matter; the central directory lists them.
+ *
+ * A blob the repo stores with zlib is already deflated, so we copy its
+ * deflate stream into the zip as-is (minus the zlib header and adler32
+ * trailer) instead of inflating it and deflating it again.  We still
+ * have to inflate it to get the CRC-32 for the zip's headers, but
+ * inflate is much cheaper than deflate.
  */
 
 #include <sg.h>
+#include <zlib.h>
 
-static void _fetch_blob_to_zip_file(
-        SG_context* pCtx, 
-        SG_repo* pRepo, 
-        const char* pszHid, 
-        SG_string* pstrPath, 
-        const char* pszName, 
-        SG_zip** pzip
-        )
+// Don't bother starting threads unless each one will get
+// at least this many entries.
+#define sg_REPO_ZIP__MIN_JOBS_PER_THREAD	(16)
+
+// Limit the number of threads regardless of the number of processors.
+#define sg_REPO_ZIP__MAX_THREADS			(8)
+
+// An entry whose deflated data might be bigger than this is streamed
+// into the zip while holding the zip's mutex, rather than built in memory.
+#define sg_REPO_ZIP__MAX_BUFFERED			(8 * 1024 * 1024)
+
+// The level SG_zip uses when it deflates.
+#define sg_REPO_ZIP__LEVEL					(8)
+
+typedef struct _sg_repo_zip__job
+{
+	char *				pszPath;		// name in the zip
+	char *				pszHid;			// NULL for an empty folder
+} sg_repo_zip__job;
+
+typedef struct _sg_repo_zip
 {
-	SG_repo_fetch_blob_handle* pbh = NULL;
-    SG_uint64 len = 0;
-    SG_uint32 got = 0;
-    SG_byte* p_buf = NULL;
-    SG_uint64 left = 0;
-	SG_string* pPathFile = NULL;
-    SG_bool b_done = SG_FALSE;
+	SG_repo *			pRepo;			// we do not own this
+	SG_vector *			pvecJobs;		// vec[sg_repo_zip__job *]
 
-	SG_ERR_CHECK(  SG_string__alloc__sz(pCtx, &pPathFile, SG_string__sz(pstrPath))  );
+	// The following are only used while __run() is active.
 
-	if (strlen(SG_string__sz(pPathFile)) > 0)
+	SG_zip *			pZip;			// we do not own this (protected by mutexZip)
+	SG_mutex			mutexZip;
+	SG_mutex			mutexQueue;
+	SG_uint32			ndxNext;		// next job to hand out (protected by mutexQueue)
+	SG_bool				bAbort;			// a worker failed (protected by mutexQueue)
+} sg_repo_zip;
+
+// Where an entry's deflated data goes: straight into the zip (the
+// caller holds mutexZip) or into a buffer big enough for all of it.
+typedef struct _sg_repo_zip__out
+{
+	SG_zip *			pZip;
+	SG_byte *			pBuf;
+	SG_uint32			len;
+	SG_uint32			size;
+} sg_repo_zip__out;
+
+//////////////////////////////////////////////////////////////////
+
+static void _job__free(SG_context * pCtx, sg_repo_zip__job * pJob)
+{
+	if (!pJob)
+		return;
+
+	SG_NULLFREE(pCtx, pJob->pszPath);
+	SG_NULLFREE(pCtx, pJob->pszHid);
+	SG_NULLFREE(pCtx, pJob);
+}
+
+static void _add_job(SG_context * pCtx,
+					 sg_repo_zip * pState,
+					 const char * pszPath,
+					 const char * pszHid)
+{
+	sg_repo_zip__job * pJob = NULL;
+
+	SG_ERR_CHECK(  SG_alloc1(pCtx, pJob)  );
+	SG_ERR_CHECK(  SG_STRDUP(pCtx, pszPath, &pJob->pszPath)  );
+	if (pszHid)
+		SG_ERR_CHECK(  SG_STRDUP(pCtx, pszHid, &pJob->pszHid)  );
+
+	SG_ERR_CHECK(  SG_vector__append(pCtx, pState->pvecJobs, pJob, NULL)  );
+	return;
+
+fail:
+	_job__free(pCtx, pJob);
+}
+
+//////////////////////////////////////////////////////////////////
+
+static void _out__write(SG_context * pCtx,
+						sg_repo_zip__out * pOut,
+						const SG_byte * p,
+						SG_uint32 len)
+{
+	if (pOut->pZip)
 	{
-		SG_ERR_CHECK(  SG_string__append__sz(pCtx, pPathFile, "/") );
+		SG_ERR_CHECK_RETURN(  SG_zip__write__raw(pCtx, pOut->pZip, p, len)  );
 	}
-	SG_ERR_CHECK(  SG_string__append__sz(pCtx, pPathFile, pszName) );
+	else
+	{
+		if (len > (pOut->size - pOut->len))
+			SG_ERR_THROW_RETURN(  SG_ERR_BUFFERTOOSMALL  );
+		memcpy(pOut->pBuf + pOut->len, p, len);
+		pOut->len += len;
+	}
+}
 
-	SG_ERR_CHECK(  SG_zip__begin_file(pCtx, *pzip, SG_string__sz(pPathFile))  );
-	SG_ERR_CHECK(  SG_repo__fetch_blob__begin(pCtx, pRepo,  pszHid, SG_TRUE, NULL, NULL, NULL, &len, &pbh)  );
-	left = len;
-	SG_ERR_CHECK(  SG_alloc(pCtx, SG_STREAMING_BUFFER_SIZE, 1, &p_buf)  );
-	while (!b_done)
+/**
+ * Is this the start of a zlib stream whose deflate data we can use
+ * as-is?  Not if it needs a preset dictionary.
+ */
+static SG_bool _is_plain_zlib_header(const SG_byte * p, SG_uint32 len)
+{
+	return ((len >= 2)
+			&& ((p[0] & 0x0f) == Z_DEFLATED)
+			&& ((((SG_uint32)p[0] << 8) | p[1]) % 31 == 0)
+			&& ((p[1] & 0x20) == 0));
+}
+
+/**
+ * Copy the deflate data out of a zlib-encoded blob, computing the
+ * CRC-32 of the inflated contents along the way.  The first chunk
+ * of the blob has already been read, to look at its header.
+ */
+static void _copy_deflated(SG_context * pCtx,
+						   SG_repo * pRepo,
+						   SG_repo_fetch_blob_handle * pbh,
+						   const SG_byte * pFirst,
+						   SG_uint32 lenFirst,
+						   SG_bool bFirstDone,
+						   SG_uint64 len_encoded,
+						   SG_uint64 len_full,
+						   sg_repo_zip__out * pOut,
+						   SG_uint32 * pCrc)
+{
+	z_stream zs;
+	SG_bool bZInit = SG_FALSE;
+	int zerr = Z_OK;
+	SG_byte * pBufIn = NULL;
+	SG_byte * pBufOut = NULL;
+	const SG_byte * p = pFirst;
+	SG_uint32 got = lenFirst;
+	SG_bool b_done = bFirstDone;
+	SG_uint64 pos = 0;
+	SG_uint32 crc = crc32(0L, Z_NULL, 0);
+
+	SG_ERR_CHECK(  SG_alloc(pCtx, SG_STREAMING_BUFFER_SIZE, 1, &pBufIn)  );
+	SG_ERR_CHECK(  SG_alloc(pCtx, SG_STREAMING_BUFFER_SIZE, 1, &pBufOut)  );
+
+	memset(&zs, 0, sizeof(zs));
+	zerr = inflateInit(&zs);
+	if (zerr != Z_OK)
+		SG_ERR_THROW(  SG_ERR_ZLIB(zerr)  );
+	bZInit = SG_TRUE;
+
+	while (1)
 	{
-		SG_uint32 want = SG_STREAMING_BUFFER_SIZE;
-		if (want > left)
+		// The part of this chunk between the 2-byte zlib header
+		// and the 4-byte adler32 trailer goes into the zip.
+		SG_uint64 lo = SG_MAX(pos, 2);
+		SG_uint64 hi = SG_MIN(pos + got, len_encoded - 4);
+
+		if (hi > lo)
+			SG_ERR_CHECK(  _out__write(pCtx, pOut, p + (lo - pos), (SG_uint32)(hi - lo))  );
+
+		zs.next_in = (Bytef *)p;
+		zs.avail_in = got;
+		while ((zerr != Z_STREAM_END) && (zs.avail_in > 0 || zs.avail_out == 0))
 		{
-			want = (SG_uint32) left;
+			zs.next_out = pBufOut;
+			zs.avail_out = SG_STREAMING_BUFFER_SIZE;
+			zerr = inflate(&zs, Z_NO_FLUSH);
+			if (zerr == Z_BUF_ERROR)
+				break;
+			if ((zerr != Z_OK) && (zerr != Z_STREAM_END))
+				SG_ERR_THROW(  SG_ERR_ZLIB(zerr)  );
+			crc = crc32(crc, pBufOut, SG_STREAMING_BUFFER_SIZE - zs.avail_out);
 		}
-		SG_ERR_CHECK(  SG_repo__fetch_blob__chunk(pCtx, pRepo, pbh, want, p_buf, &got, &b_done)  );
-		SG_ERR_CHECK(  SG_zip__write(pCtx, *pzip, p_buf, got)  );
+
+		pos += got;
+		if (b_done)
+			break;
+
+		SG_ERR_CHECK(  SG_repo__fetch_blob__chunk(pCtx, pRepo, pbh,
+												  (SG_uint32)SG_MIN(SG_STREAMING_BUFFER_SIZE, len_encoded - pos),
+												  pBufIn, &got, &b_done)  );
+		p = pBufIn;
+	}
+
+	if ((zerr != Z_STREAM_END) || (zs.total_out != len_full) || (pos != len_encoded))
+		SG_ERR_THROW2(  SG_ERR_ZLIB(Z_DATA_ERROR), (pCtx, "Stored blob is not a complete zlib stream.")  );
+
+	*pCrc = crc;
+
+fail:
+	if (bZInit)
+		inflateEnd(&zs);
+	SG_NULLFREE(pCtx, pBufIn);
+	SG_NULLFREE(pCtx, pBufOut);
+}
+
+/**
+ * Deflate a blob's full contents, computing their CRC-32.
+ */
+static void _deflate(SG_context * pCtx,
+					 SG_repo * pRepo,
+					 SG_repo_fetch_blob_handle * pbh,
+					 SG_uint64 len_full,
+					 sg_repo_zip__out * pOut,
+					 SG_uint32 * pCrc)
+{
+	z_stream zs;
+	SG_bool bZInit = SG_FALSE;
+	int zerr = Z_OK;
+	SG_byte * pBufIn = NULL;
+	SG_byte * pBufOut = NULL;
+	SG_uint64 left = len_full;
+	SG_uint32 got = 0;
+	SG_bool b_done = SG_FALSE;
+	SG_uint32 crc = crc32(0L, Z_NULL, 0);
+
+	SG_ERR_CHECK(  SG_alloc(pCtx, SG_STREAMING_BUFFER_SIZE, 1, &pBufIn)  );
+	SG_ERR_CHECK(  SG_alloc(pCtx, SG_STREAMING_BUFFER_SIZE, 1, &pBufOut)  );
+
+	memset(&zs, 0, sizeof(zs));
+	zerr = deflateInit2(&zs, sg_REPO_ZIP__LEVEL, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+	if (zerr != Z_OK)
+		SG_ERR_THROW(  SG_ERR_ZLIB(zerr)  );
+	bZInit = SG_TRUE;
+
+	while (!b_done)
+	{
+		SG_ERR_CHECK(  SG_repo__fetch_blob__chunk(pCtx, pRepo, pbh,
+												  (SG_uint32)SG_MIN(SG_STREAMING_BUFFER_SIZE, left),
+												  pBufIn, &got, &b_done)  );
 		left -= got;
+		crc = crc32(crc, pBufIn, got);
+
+		zs.next_in = pBufIn;
+		zs.avail_in = got;
+		do
+		{
+			zs.next_out = pBufOut;
+			zs.avail_out = SG_STREAMING_BUFFER_SIZE;
+			zerr = deflate(&zs, (b_done ? Z_FINISH : Z_NO_FLUSH));
+			if (zerr == Z_STREAM_ERROR)
+				SG_ERR_THROW(  SG_ERR_ZLIB(zerr)  );
+			SG_ERR_CHECK(  _out__write(pCtx, pOut, pBufOut, SG_STREAMING_BUFFER_SIZE - zs.avail_out)  );
+		} while (zs.avail_out == 0);
 	}
+	SG_ASSERT(0 == left);
+	SG_ASSERT(Z_STREAM_END == zerr);
+
+	*pCrc = crc;
+
+fail:
+	if (bZInit)
+		deflateEnd(&zs);
+	SG_NULLFREE(pCtx, pBufIn);
+	SG_NULLFREE(pCtx, pBufOut);
+}
+
+static void _do_file(SG_context * pCtx,
+					 sg_repo_zip * pState,
+					 SG_repo * pRepo,
+					 const sg_repo_zip__job * pJob)
+{
+	SG_repo_fetch_blob_handle * pbh = NULL;
+	SG_blob_encoding encoding = 0;
+	SG_uint64 len_encoded = 0;
+	SG_uint64 len_full = 0;
+	SG_byte * pFirst = NULL;
+	SG_uint32 lenFirst = 0;
+	SG_bool bFirstDone = SG_FALSE;
+	SG_bool bPassthrough = SG_FALSE;
+	SG_uint64 lenOutMax = 0;
+	sg_repo_zip__out out;
+	SG_uint32 crc = 0;
+	SG_bool bLocked = SG_FALSE;
+
+	memset(&out, 0, sizeof(out));
+
+	SG_ERR_CHECK(  SG_repo__fetch_blob__begin(pCtx, pRepo, pJob->pszHid, SG_FALSE, &encoding, NULL, &len_encoded, &len_full, &pbh)  );
+
+	if (SG_IS_BLOBENCODING_ZLIB(encoding) && (len_encoded > 6) && (len_full <= SG_UINT32_MAX))
+	{
+		SG_ERR_CHECK(  SG_alloc(pCtx, SG_STREAMING_BUFFER_SIZE, 1, &pFirst)  );
+		SG_ERR_CHECK(  SG_repo__fetch_blob__chunk(pCtx, pRepo, pbh,
+												  (SG_uint32)SG_MIN(SG_STREAMING_BUFFER_SIZE, len_encoded),
+												  pFirst, &lenFirst, &bFirstDone)  );
+		bPassthrough = _is_plain_zlib_header(pFirst, lenFirst);
+	}
+
+	if (bPassthrough)
+	{
+		lenOutMax = len_encoded;
+	}
+	else
+	{
+		SG_ERR_CHECK(  SG_repo__fetch_blob__abort(pCtx, pRepo, &pbh)  );
+		SG_ERR_CHECK(  SG_repo__fetch_blob__begin(pCtx, pRepo, pJob->pszHid, SG_TRUE, NULL, NULL, NULL, &len_full, &pbh)  );
+		lenOutMax = (len_full <= sg_REPO_ZIP__MAX_BUFFERED) ? compressBound((uLong)len_full) : len_full;
+	}
+
+	if (lenOutMax <= sg_REPO_ZIP__MAX_BUFFERED)
+	{
+		out.size = (SG_uint32)lenOutMax;
+		SG_ERR_CHECK(  SG_alloc(pCtx, SG_MAX(out.size, 1), 1, &out.pBuf)  );
+		if (bPassthrough)
+			SG_ERR_CHECK(  _copy_deflated(pCtx, pRepo, pbh, pFirst, lenFirst, bFirstDone, len_encoded, len_full, &out, &crc)  );
+		else
+			SG_ERR_CHECK(  _deflate(pCtx, pRepo, pbh, len_full, &out, &crc)  );
+
+		SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pState->mutexZip)  );
+		bLocked = SG_TRUE;
+		SG_ERR_CHECK(  SG_zip__store__raw(pCtx, pState->pZip, pJob->pszPath, out.pBuf, out.len, (SG_uint32)len_full, crc)  );
+	}
+	else
+	{
+		SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pState->mutexZip)  );
+		bLocked = SG_TRUE;
+		out.pZip = pState->pZip;
+		SG_ERR_CHECK(  SG_zip__begin_file__raw(pCtx, pState->pZip, pJob->pszPath)  );
+		if (bPassthrough)
+			SG_ERR_CHECK(  _copy_deflated(pCtx, pRepo, pbh, pFirst, lenFirst, bFirstDone, len_encoded, len_full, &out, &crc)  );
+		else
+			SG_ERR_CHECK(  _deflate(pCtx, pRepo, pbh, len_full, &out, &crc)  );
+		SG_ERR_CHECK(  SG_zip__end_file__raw(pCtx, pState->pZip, (SG_uint32)len_full, crc)  );
+	}
+
+	bLocked = SG_FALSE;
+	SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pState->mutexZip)  );
+
 	SG_ERR_CHECK(  SG_repo__fetch_blob__end(pCtx, pRepo, &pbh)  );
-    SG_ASSERT(0 == left);
-	SG_ERR_CHECK(  SG_zip__end_file(pCtx, *pzip)  );
-	SG_NULLFREE(pCtx, p_buf);
-	SG_STRING_NULLFREE(pCtx, pPathFile);
+
+	SG_NULLFREE(pCtx, pFirst);
+	SG_NULLFREE(pCtx, out.pBuf);
 	return;
 
 fail:
-	SG_ERR_IGNORE(  SG_repo__fetch_blob__abort(pCtx, pRepo, &pbh)  );
-	SG_STRING_NULLFREE(pCtx, pPathFile);
-    SG_NULLFREE(pCtx, p_buf);
+	if (bLocked)
+		(void)SG_mutex__unlock__bare(&pState->mutexZip);
+	if (pbh)
+		SG_ERR_IGNORE(  SG_repo__fetch_blob__abort(pCtx, pRepo, &pbh)  );
+	SG_NULLFREE(pCtx, pFirst);
+	SG_NULLFREE(pCtx, out.pBuf);
 }
 
+static void _do_job(SG_context * pCtx,
+					sg_repo_zip * pState,
+					SG_repo * pRepo,
+					const sg_repo_zip__job * pJob)
+{
+	if (pJob->pszHid)
+	{
+		SG_ERR_CHECK_RETURN(  _do_file(pCtx, pState, pRepo, pJob)  );
+	}
+	else
+	{
+		SG_ERR_CHECK_RETURN(  SG_mutex__lock(pCtx, &pState->mutexZip)  );
+		SG_zip__add_folder(pCtx, pState->pZip, pJob->pszPath);
+		(void)SG_mutex__unlock__bare(&pState->mutexZip);
+		SG_ERR_CHECK_RETURN_CURRENT;
+	}
+}
+
+//////////////////////////////////////////////////////////////////
+
+/**
+ * Take jobs from the queue until it is empty or somebody fails.
+ * This is run by each worker thread and by the calling thread.
+ */
+static void _worker__loop(SG_context * pCtx,
+						  sg_repo_zip * pState,
+						  SG_repo * pRepo)
+{
+	sg_repo_zip__job * pJob;
+	SG_uint32 nrJobs;
+	SG_uint32 ndx;
+
+	SG_ERR_CHECK(  SG_vector__length(pCtx, pState->pvecJobs, &nrJobs)  );
+
+	while (1)
+	{
+		SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pState->mutexQueue)  );
+		if (pState->bAbort || (pState->ndxNext >= nrJobs))
+		{
+			SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pState->mutexQueue)  );
+			break;
+		}
+		ndx = pState->ndxNext++;
+		SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pState->mutexQueue)  );
+
+		SG_ERR_CHECK(  SG_vector__get(pCtx, pState->pvecJobs, ndx, (void **)&pJob)  );
+		SG_ERR_CHECK(  _do_job(pCtx, pState, pRepo, pJob)  );
+	}
+
+	return;
+
+fail:
+	// Tell everybody else to stop.  Our context has the error.
+	if (SG_mutex__lock__bare(&pState->mutexQueue) == 0)
+	{
+		pState->bAbort = SG_TRUE;
+		(void)SG_mutex__unlock__bare(&pState->mutexQueue);
+	}
+}
+
+static SG_thread_pool__work _worker__main;
+
+static void _worker__main(SG_context * pCtx, SG_repo * pRepo, void * pVoidData)
+{
+	_worker__loop(pCtx, (sg_repo_zip *)pVoidData, pRepo);
+}
+
+/**
+ * Write all of the queued entries into the zip.  If any of them fail,
+ * we stop handing out new ones, wait for the ones in progress, and
+ * throw the first error that we saw.
+ */
+static void _run(SG_context * pCtx,
+				 sg_repo_zip * pState,
+				 SG_zip * pZip)
+{
+	SG_thread_pool * pPool = NULL;
+	SG_uint32 nrJobs = 0;
+	SG_uint32 nrThreads = 0;
+	SG_bool bMutexQueue = SG_FALSE;
+	SG_bool bMutexZip = SG_FALSE;
+
+	SG_ERR_CHECK(  SG_vector__length(pCtx, pState->pvecJobs, &nrJobs)  );
+	if (nrJobs == 0)
+		return;
+
+	SG_ERR_CHECK(  SG_mutex__init(pCtx, &pState->mutexQueue)  );
+	bMutexQueue = SG_TRUE;
+	SG_ERR_CHECK(  SG_mutex__init(pCtx, &pState->mutexZip)  );
+	bMutexZip = SG_TRUE;
+	pState->pZip = pZip;
+	pState->ndxNext = 0;
+	pState->bAbort = SG_FALSE;
+
+	SG_ERR_CHECK(  SG_thread_pool__size_for_jobs(pCtx, nrJobs,
+												 sg_REPO_ZIP__MIN_JOBS_PER_THREAD,
+												 sg_REPO_ZIP__MAX_THREADS,
+												 &nrThreads)  );
+	if (nrThreads > 0)
+	{
+		SG_ERR_CHECK(  SG_thread_pool__alloc(pCtx, nrThreads, pState->pRepo, _worker__main, pState, &pPool)  );
+		SG_ERR_CHECK(  SG_thread_pool__start(pCtx, pPool)  );
+	}
+
+	// Do our share of the work using the caller's repo handle.
+
+	SG_ERR_CHECK(  _worker__loop(pCtx, pState, pState->pRepo)  );
+
+	if (pPool)
+		SG_ERR_CHECK(  SG_thread_pool__join(pCtx, pPool)  );
+
+fail:
+	if (pPool)
+	{
+		// If we are bailing out early, make sure that no worker
+		// is still using our data before we free it.
+
+		if (SG_mutex__lock__bare(&pState->mutexQueue) == 0)
+		{
+			pState->bAbort = SG_TRUE;
+			(void)SG_mutex__unlock__bare(&pState->mutexQueue);
+		}
+		SG_THREAD_POOL_NULLFREE(pCtx, pPool);
+	}
+	if (bMutexZip)
+		SG_mutex__destroy(&pState->mutexZip);
+	if (bMutexQueue)
+		SG_mutex__destroy(&pState->mutexQueue);
+	pState->pZip = NULL;
+}
+
+//////////////////////////////////////////////////////////////////
+
 static void _zip_repo_treenode(
         SG_context* pCtx, 
-        SG_repo* pRepo, 
+        sg_repo_zip* pState, 
         const char* pszHid, 
-        SG_string** ppstrPath, 
-        SG_zip** pzip
+        SG_string** ppstrPath
         )
 {
 	SG_treenode* pTreenode = NULL;
 	SG_uint32 count = 0;
 	SG_uint32 i;
+	SG_string* pstrPathEntry = NULL;
 
-	SG_ERR_CHECK(  SG_treenode__load_from_repo(pCtx, pRepo, pszHid, &pTreenode)  );
+	SG_ERR_CHECK(  SG_treenode__load_from_repo(pCtx, pState->pRepo, pszHid, &pTreenode)  );
 	SG_ERR_CHECK(  SG_treenode__count(pCtx, pTreenode, &count)  );
 	if (count == 0)
 	{
-		SG_string* pPathFolderEmpty = NULL;
-		SG_ERR_CHECK(  SG_string__alloc__sz(pCtx, &pPathFolderEmpty, SG_string__sz(*ppstrPath))  );
-		SG_ERR_CHECK(  SG_string__append__sz(pCtx, pPathFolderEmpty, "/") );
-		SG_ERR_CHECK(  SG_zip__add_folder(pCtx, *pzip, SG_string__sz(pPathFolderEmpty))  );
-		SG_STRING_NULLFREE(pCtx, pPathFolderEmpty);
+		SG_ERR_CHECK(  SG_string__alloc__sz(pCtx, &pstrPathEntry, SG_string__sz(*ppstrPath))  );
+		SG_ERR_CHECK(  SG_string__append__sz(pCtx, pstrPathEntry, "/") );
+		SG_ERR_CHECK(  _add_job(pCtx, pState, SG_string__sz(pstrPathEntry), NULL)  );
+		SG_STRING_NULLFREE(pCtx, pstrPathEntry);
 	}
 	for (i=0; i<count; i++)
 	{
@@ -110,23 +544,30 @@ static void _zip_repo_treenode(
 
 		if (SG_TREENODEENTRY_TYPE_DIRECTORY == type)
 		{
-			SG_string* pPathFolder = NULL;
-			SG_ERR_CHECK(  SG_string__alloc__sz(pCtx, &pPathFolder, SG_string__sz(*ppstrPath))  );
+			SG_ERR_CHECK(  SG_string__alloc__sz(pCtx, &pstrPathEntry, SG_string__sz(*ppstrPath))  );
 
-			if (strlen(SG_string__sz(pPathFolder)) > 0)
+			if (strlen(SG_string__sz(pstrPathEntry)) > 0)
 			{
-				SG_ERR_CHECK(  SG_string__append__sz(pCtx, pPathFolder, "/") );
+				SG_ERR_CHECK(  SG_string__append__sz(pCtx, pstrPathEntry, "/") );
 			}
 			if (strcmp(pszName, "@") != 0)
 			{
-				SG_ERR_CHECK(  SG_string__append__sz(pCtx, pPathFolder, pszName) );
+				SG_ERR_CHECK(  SG_string__append__sz(pCtx, pstrPathEntry, pszName) );
 			}
-			SG_ERR_CHECK(  _zip_repo_treenode(pCtx, pRepo, pszidHid, &pPathFolder, &(*pzip))  );
-			SG_STRING_NULLFREE(pCtx, pPathFolder);
+			SG_ERR_CHECK(  _zip_repo_treenode(pCtx, pState, pszidHid, &pstrPathEntry)  );
+			SG_STRING_NULLFREE(pCtx, pstrPathEntry);
 		}
 		else if (SG_TREENODEENTRY_TYPE_REGULAR_FILE == type)
 		{
-			SG_ERR_CHECK(  _fetch_blob_to_zip_file(pCtx, pRepo, pszidHid, *ppstrPath, pszName, &(*pzip) ) );
+			SG_ERR_CHECK(  SG_string__alloc__sz(pCtx, &pstrPathEntry, SG_string__sz(*ppstrPath))  );
+
+			if (strlen(SG_string__sz(pstrPathEntry)) > 0)
+			{
+				SG_ERR_CHECK(  SG_string__append__sz(pCtx, pstrPathEntry, "/") );
+			}
+			SG_ERR_CHECK(  SG_string__append__sz(pCtx, pstrPathEntry, pszName) );
+			SG_ERR_CHECK(  _add_job(pCtx, pState, SG_string__sz(pstrPathEntry), pszidHid)  );
+			SG_STRING_NULLFREE(pCtx, pstrPathEntry);
 		}
         else
         {
@@ -136,6 +577,7 @@ static void _zip_repo_treenode(
         }
 	}
 fail:
+	SG_STRING_NULLFREE(pCtx, pstrPathEntry);
 	SG_TREENODE_NULLFREE(pCtx, pTreenode);
 }
 
@@ -149,20 +591,26 @@ void SG_repo__zip(
 	char* pszHidTreeNode = NULL;
 	SG_string* pstrPathInit = NULL;
 	SG_zip* pzip = NULL;
-	SG_rbtree* prbLeaves = NULL;
 	SG_pathname* pPathZip = NULL;
+	sg_repo_zip state;
 
 	SG_NULLARGCHECK_RETURN(pRepo);
 	SG_NULLARGCHECK_RETURN(psz_hid_cs);
 	SG_NULLARGCHECK_RETURN(psz_path);
 
+	memset(&state, 0, sizeof(state));
+	state.pRepo = pRepo;
+	SG_ERR_CHECK(  SG_VECTOR__ALLOC(pCtx, &state.pvecJobs, 256)  );
+
 	SG_ERR_CHECK(  SG_changeset__tree__find_root_hid(pCtx, pRepo, psz_hid_cs, &pszHidTreeNode)  );
 
 	SG_ERR_CHECK(  SG_pathname__alloc__sz(pCtx, &pPathZip, psz_path)  );
 
 	SG_ERR_CHECK(  SG_STRING__ALLOC__SZ(pCtx, &pstrPathInit, "")  );
+	SG_ERR_CHECK(  _zip_repo_treenode(pCtx, &state, pszHidTreeNode, &pstrPathInit) );
+
 	SG_ERR_CHECK(  SG_zip__open(pCtx, pPathZip, &pzip)  );
-	SG_ERR_CHECK(  _zip_repo_treenode(pCtx, pRepo, pszHidTreeNode, &pstrPathInit, &pzip) );
+	SG_ERR_CHECK(  _run(pCtx, &state, pzip)  );
 	SG_ERR_CHECK(  SG_zip__nullclose(pCtx, &pzip) );
 
 fail:
@@ -173,6 +621,5 @@ fail:
     {
 		 SG_zip__nullclose(pCtx, &pzip);
     }
-    SG_RBTREE_NULLFREE(pCtx, prbLeaves);
+	SG_VECTOR_NULLFREE_WITH_ASSOC(pCtx, state.pvecJobs, (SG_free_callback *)_job__free);
 }
-
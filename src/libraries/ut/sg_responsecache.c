@@ -0,0 +1,800 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file sg_responsecache.c
+ *
+ * @details The server's response cache.  See sg_responsecache_prototypes.h.
+ *
+ * An ETag looks like "<keyhash>-<statehash>".  The key hash covers the repo
+ * instance (see SG_repo__get_instance_key) and the caller's key, so there's
+ * at most one entry per key: a new response for the same key replaces the
+ * old one, in memory and in the spill file, which is named for the key hash.
+ *
+ * The state hash covers, for each dag, a hash of its leaves when we first
+ * looked at it plus its change counter.  Using the leaves as the starting
+ * point (rather than 0) keeps ETags valid across server restarts when
+ * nothing has changed, so browsers still get their 304s.
+ *
+ */
+
+#include <sg.h>
+
+//////////////////////////////////////////////////////////////////
+
+#define DEFAULT_MAX_MB				32
+#define DEFAULT_VALIDATE_SECONDS	0
+#define DEFAULT_SPILL				1
+
+#define SPILL_DIR					"vvcache"
+
+// Each entry costs this much on top of its strings.
+#define ENTRY_OVERHEAD				128
+
+#define HASH_HEX_LEN				16
+
+struct sg_rc_dag
+{
+	SG_uint64 base;			// hash of the leaves when we first looked
+	SG_uint64 counter;		// bumped whenever the dag changes
+	SG_uint64 sig;			// hash of the leaves when we last looked
+	SG_bool bSigKnown;		// FALSE after a bump, until we look again
+	SG_int64 checked_ms;	// when we last looked
+};
+
+struct sg_rc_entry
+{
+	char * pszEtag;
+	char * pszKey;
+	char * pszText;
+	SG_uint32 lenText;
+	SG_uint64 cost;
+
+	struct sg_rc_entry * pPrev;	// more recently used
+	struct sg_rc_entry * pNext;	// less recently used
+};
+
+static struct
+{
+	SG_mutex mutex; // Protects all other members.
+
+	SG_rbtree * prbDags;		// "<instance key>:<dagnum>" -> struct sg_rc_dag
+	SG_rbtree * prbEntries;		// keyhash -> struct sg_rc_entry
+
+	struct sg_rc_entry * pMostRecent;
+	struct sg_rc_entry * pLeastRecent;
+	SG_uint64 total;
+	SG_uint64 limit;
+
+	SG_int64 validate_ms;	// 0 means look at the leaves on every request
+	SG_pathname * pSpillDir;	// NULL if we don't spill
+} * gpResponseCacheState;
+
+//////////////////////////////////////////////////////////////////
+
+/**
+ * 64-bit FNV-1a.  These hashes only need to tell our own entries apart.
+ */
+static SG_uint64 _fnv(SG_uint64 h, const void * pBuf, SG_uint32 len)
+{
+	const SG_byte * p = (const SG_byte *)pBuf;
+	SG_uint32 k;
+
+	for (k=0; k<len; k++)
+	{
+		h ^= p[k];
+		h *= 1099511628211ULL;
+	}
+
+	return h;
+}
+
+#define FNV_INIT	14695981039346656037ULL
+
+static void _hex64(SG_uint64 v, char * pBuf)
+{
+	static const char * HEX = "0123456789abcdef";
+	int k;
+
+	for (k=HASH_HEX_LEN-1; k>=0; k--)
+	{
+		pBuf[k] = HEX[v & 0xf];
+		v >>= 4;
+	}
+	pBuf[HASH_HEX_LEN] = 0;
+}
+
+static void _get_setting(
+	SG_context * pCtx,
+	const char * pszSetting,
+	SG_uint32 valDefault,
+	SG_uint32 * pVal)
+{
+	char * pszValue = NULL;
+	SG_uint32 val = valDefault;
+
+	SG_localsettings__get__sz(pCtx, pszSetting, NULL, &pszValue, NULL);
+	if (!SG_context__has_err(pCtx) && pszValue != NULL)
+		SG_uint32__parse__strict(pCtx, &val, pszValue);
+	if (SG_context__has_err(pCtx))
+	{
+		SG_log__report_error__current_error(pCtx);
+		SG_context__err_reset(pCtx);
+		val = valDefault;
+	}
+
+	SG_NULLFREE(pCtx, pszValue);
+	*pVal = val;
+}
+
+/**
+ * The old JavaScript cache's directory: server/cache, or vvcache in the
+ * server state directory.
+ */
+static void _get_spill_dir(SG_context * pCtx, SG_pathname ** ppPath)
+{
+	char * pszDir = NULL;
+	SG_pathname * pPath = NULL;
+
+	SG_ERR_CHECK(  SG_localsettings__get__sz(pCtx, "server/cache", NULL, &pszDir, NULL)  );
+	if (pszDir && *pszDir)
+	{
+		SG_ERR_CHECK(  SG_PATHNAME__ALLOC__SZ(pCtx, &pPath, pszDir)  );
+	}
+	else
+	{
+		SG_ERR_CHECK(  SG_closet__get_server_state_path(pCtx, &pPath)  );
+		SG_ERR_CHECK(  SG_pathname__append__from_sz(pCtx, pPath, SPILL_DIR)  );
+	}
+
+	SG_fsobj__mkdir_recursive__pathname(pCtx, pPath);
+	SG_ERR_CHECK_CURRENT_DISREGARD(SG_ERR_DIR_ALREADY_EXISTS);
+
+	*ppPath = pPath;
+	pPath = NULL;
+
+fail:
+	SG_NULLFREE(pCtx, pszDir);
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+}
+
+//////////////////////////////////////////////////////////////////
+
+static void _entry__free(SG_context * pCtx, struct sg_rc_entry * pEntry)
+{
+	if (pEntry)
+	{
+		SG_NULLFREE(pCtx, pEntry->pszEtag);
+		SG_NULLFREE(pCtx, pEntry->pszKey);
+		SG_NULLFREE(pCtx, pEntry->pszText);
+		SG_NULLFREE(pCtx, pEntry);
+	}
+}
+
+static void _entry__free_cb(SG_context * pCtx, void * pVoid)
+{
+	_entry__free(pCtx, (struct sg_rc_entry *)pVoid);
+}
+
+static void _dag__free_cb(SG_context * pCtx, void * pVoid)
+{
+	SG_free(pCtx, pVoid);
+}
+
+static void _entry__alloc(
+	SG_context * pCtx,
+	const char * pszEtag,
+	const char * pszKey,
+	const char * pszText,
+	SG_uint32 lenText,
+	struct sg_rc_entry ** ppEntry)
+{
+	struct sg_rc_entry * pEntry = NULL;
+
+	SG_ERR_CHECK(  SG_alloc1(pCtx, pEntry)  );
+	SG_ERR_CHECK(  SG_STRDUP(pCtx, pszEtag, &pEntry->pszEtag)  );
+	SG_ERR_CHECK(  SG_STRDUP(pCtx, pszKey, &pEntry->pszKey)  );
+	SG_ERR_CHECK(  SG_allocN(pCtx, lenText + 1, pEntry->pszText)  );
+	memcpy(pEntry->pszText, pszText, lenText);
+	pEntry->lenText = lenText;
+	pEntry->cost = lenText + strlen(pszEtag) + strlen(pszKey) + ENTRY_OVERHEAD;
+
+	*ppEntry = pEntry;
+	pEntry = NULL;
+
+fail:
+	_entry__free(pCtx, pEntry);
+}
+
+static void _unlink(struct sg_rc_entry * pEntry)
+{
+	if (pEntry->pPrev)
+		pEntry->pPrev->pNext = pEntry->pNext;
+	else
+		gpResponseCacheState->pMostRecent = pEntry->pNext;
+
+	if (pEntry->pNext)
+		pEntry->pNext->pPrev = pEntry->pPrev;
+	else
+		gpResponseCacheState->pLeastRecent = pEntry->pPrev;
+
+	pEntry->pPrev = pEntry->pNext = NULL;
+}
+
+static void _link_most_recent(struct sg_rc_entry * pEntry)
+{
+	pEntry->pPrev = NULL;
+	pEntry->pNext = gpResponseCacheState->pMostRecent;
+	if (pEntry->pNext)
+		pEntry->pNext->pPrev = pEntry;
+	else
+		gpResponseCacheState->pLeastRecent = pEntry;
+	gpResponseCacheState->pMostRecent = pEntry;
+}
+
+//////////////////////////////////////////////////////////////////
+
+/**
+ * The spill file is the ETag and the key, each on a line, then the text.
+ * It's written to a temporary name and renamed, so a reader never sees
+ * half of one.
+ */
+static void _spill(SG_context * pCtx, const struct sg_rc_entry * pEntry)
+{
+	SG_pathname * pPathTemp = NULL;
+	SG_pathname * pPath = NULL;
+	SG_file * pFile = NULL;
+	char bufTid[SG_TID_MAX_BUFFER_LENGTH];
+	char bufName[HASH_HEX_LEN + 1];
+
+	memcpy(bufName, pEntry->pszEtag, HASH_HEX_LEN);
+	bufName[HASH_HEX_LEN] = 0;
+
+	SG_ERR_CHECK(  SG_tid__generate(pCtx, bufTid, sizeof(bufTid))  );
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathTemp, gpResponseCacheState->pSpillDir, bufTid)  );
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPath, gpResponseCacheState->pSpillDir, bufName)  );
+
+	SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPathTemp, SG_FILE_WRONLY|SG_FILE_CREATE_NEW, 0644, &pFile)  );
+	SG_ERR_CHECK(  SG_file__write__sz(pCtx, pFile, pEntry->pszEtag)  );
+	SG_ERR_CHECK(  SG_file__write__sz(pCtx, pFile, "\n")  );
+	SG_ERR_CHECK(  SG_file__write__sz(pCtx, pFile, pEntry->pszKey)  );
+	SG_ERR_CHECK(  SG_file__write__sz(pCtx, pFile, "\n")  );
+	SG_ERR_CHECK(  SG_file__write(pCtx, pFile, pEntry->lenText, (const SG_byte *)pEntry->pszText, NULL)  );
+	SG_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+
+	SG_ERR_CHECK(  SG_fsobj__move__pathname_pathname(pCtx, pPathTemp, pPath)  );
+
+	SG_PATHNAME_NULLFREE(pCtx, pPathTemp);
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+	return;
+
+fail:
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+	if (pPathTemp)
+		SG_ERR_IGNORE(  SG_fsobj__remove__pathname(pCtx, pPathTemp)  );
+	SG_PATHNAME_NULLFREE(pCtx, pPathTemp);
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+}
+
+/**
+ * *ppstrText is NULL if the spill file is missing or is for another ETag.
+ */
+static void _unspill(
+	SG_context * pCtx,
+	const char * pszEtag,
+	const char * pszKey,
+	SG_string ** ppstrText)
+{
+	SG_pathname * pPath = NULL;
+	SG_string * pstrFile = NULL;
+	SG_string * pstrText = NULL;
+	char bufName[HASH_HEX_LEN + 1];
+	const char * psz;
+	const char * pszEol;
+	SG_bool bExists = SG_FALSE;
+	size_t len;
+
+	*ppstrText = NULL;
+
+	memcpy(bufName, pszEtag, HASH_HEX_LEN);
+	bufName[HASH_HEX_LEN] = 0;
+
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPath, gpResponseCacheState->pSpillDir, bufName)  );
+	SG_ERR_CHECK(  SG_fsobj__exists__pathname(pCtx, pPath, &bExists, NULL, NULL)  );
+	if (!bExists)
+		goto fail;
+
+	SG_file__read_into_string(pCtx, pPath, &pstrFile);
+	if (SG_CONTEXT__HAS_ERR(pCtx))
+	{
+		// replaced or removed while we were looking
+		SG_context__err_reset(pCtx);
+		goto fail;
+	}
+
+	psz = SG_string__sz(pstrFile);
+
+	len = strlen(pszEtag);
+	if (strncmp(psz, pszEtag, len) != 0 || psz[len] != '\n')
+		goto fail;
+	psz += len + 1;
+
+	len = strlen(pszKey);
+	if (strncmp(psz, pszKey, len) != 0 || psz[len] != '\n')
+		goto fail;
+	psz += len + 1;
+
+	pszEol = psz + strlen(psz);
+	SG_ERR_CHECK(  SG_STRING__ALLOC__BUF_LEN(pCtx, &pstrText, (const SG_byte *)psz, (SG_uint32)(pszEol - psz))  );
+
+	*ppstrText = pstrText;
+	pstrText = NULL;
+
+fail:
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+	SG_STRING_NULLFREE(pCtx, pstrFile);
+	SG_STRING_NULLFREE(pCtx, pstrText);
+}
+
+//////////////////////////////////////////////////////////////////
+
+void SG_responsecache__global_init(SG_context * pCtx)
+{
+	SG_uint32 max_mb = 0;
+	SG_uint32 validate_seconds = 0;
+	SG_uint32 spill = 0;
+
+	if (gpResponseCacheState != NULL)
+		return;
+
+	SG_ERR_CHECK_RETURN(  SG_alloc1(pCtx, gpResponseCacheState)  );
+
+	SG_ERR_CHECK(  SG_mutex__init(pCtx, &gpResponseCacheState->mutex)  );
+	SG_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &gpResponseCacheState->prbDags)  );
+	SG_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &gpResponseCacheState->prbEntries)  );
+
+	SG_ERR_CHECK(  _get_setting(pCtx, SG_LOCALSETTING__SERVER_RESPONSE_CACHE_SIZE, DEFAULT_MAX_MB, &max_mb)  );
+	SG_ERR_CHECK(  _get_setting(pCtx, SG_LOCALSETTING__SERVER_RESPONSE_CACHE_VALIDATE_SECONDS, DEFAULT_VALIDATE_SECONDS, &validate_seconds)  );
+	SG_ERR_CHECK(  _get_setting(pCtx, SG_LOCALSETTING__SERVER_RESPONSE_CACHE_SPILL, DEFAULT_SPILL, &spill)  );
+
+	gpResponseCacheState->limit = (SG_uint64)max_mb * 1024 * 1024;
+	gpResponseCacheState->validate_ms = (SG_int64)validate_seconds * 1000;
+
+	if (spill)
+	{
+		_get_spill_dir(pCtx, &gpResponseCacheState->pSpillDir);
+		if (SG_CONTEXT__HAS_ERR(pCtx))
+		{
+			// We can do without it.
+			SG_log__report_error__current_error(pCtx);
+			SG_context__err_reset(pCtx);
+		}
+	}
+
+	return;
+
+fail:
+	SG_RBTREE_NULLFREE(pCtx, gpResponseCacheState->prbEntries);
+	SG_RBTREE_NULLFREE(pCtx, gpResponseCacheState->prbDags);
+	SG_NULLFREE(pCtx, gpResponseCacheState);
+}
+
+void SG_responsecache__global_cleanup(void)
+{
+	if (gpResponseCacheState != NULL)
+	{
+		SG_context * pCtx = NULL;
+
+		if (!SG_IS_OK(SG_context__alloc(&pCtx)))
+			return;
+
+		SG_RBTREE_NULLFREE_WITH_ASSOC(pCtx, gpResponseCacheState->prbEntries, _entry__free_cb);
+		SG_RBTREE_NULLFREE_WITH_ASSOC(pCtx, gpResponseCacheState->prbDags, _dag__free_cb);
+		SG_PATHNAME_NULLFREE(pCtx, gpResponseCacheState->pSpillDir);
+		SG_mutex__destroy(&gpResponseCacheState->mutex);
+		SG_NULLFREE(pCtx, gpResponseCacheState);
+		SG_CONTEXT_NULLFREE(pCtx);
+	}
+}
+
+//////////////////////////////////////////////////////////////////
+
+/**
+ * Dags are keyed by the repo instance rather than its id: clones of a repo
+ * share the id but not their dags.
+ */
+static void _format_dag_key(
+	SG_context * pCtx,
+	const char * pszInstanceKey,
+	SG_uint64 iDagNum,
+	SG_string * pstrKey)
+{
+	char bufDagnum[SG_DAGNUM__BUF_MAX__HEX];
+
+	SG_ERR_CHECK_RETURN(  SG_dagnum__to_sz__hex(pCtx, iDagNum, bufDagnum, sizeof(bufDagnum))  );
+	SG_ERR_CHECK_RETURN(  SG_string__sprintf(pCtx, pstrKey, "%s:%s", pszInstanceKey, bufDagnum)  );
+}
+
+void SG_responsecache__dag_changed(SG_context * pCtx, SG_repo * pRepo, SG_uint64 iDagNum)
+{
+	const char * pszInstanceKey = NULL;
+	SG_string * pstrKey = NULL;
+	struct sg_rc_dag * pDag = NULL;
+	SG_bool bFound = SG_FALSE;
+	SG_bool bLocked = SG_FALSE;
+
+	if (gpResponseCacheState == NULL)
+		return;
+
+	SG_NULLARGCHECK_RETURN(pRepo);
+
+	SG_ERR_CHECK(  SG_repo__get_instance_key(pCtx, pRepo, &pszInstanceKey)  );
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstrKey)  );
+	SG_ERR_CHECK(  _format_dag_key(pCtx, pszInstanceKey, iDagNum, pstrKey)  );
+
+	SG_ERR_CHECK(  SG_mutex__lock(pCtx, &gpResponseCacheState->mutex)  );
+	bLocked = SG_TRUE;
+	SG_ERR_CHECK(  SG_rbtree__find(pCtx, gpResponseCacheState->prbDags, SG_string__sz(pstrKey), &bFound, (void **)&pDag)  );
+	if (bFound)
+	{
+		// If nobody has asked about this dag yet, there's nothing to invalidate.
+		pDag->counter++;
+		pDag->bSigKnown = SG_FALSE;
+	}
+	SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &gpResponseCacheState->mutex)  );
+	bLocked = SG_FALSE;
+
+fail:
+	if (bLocked)
+		SG_ERR_IGNORE(  SG_mutex__unlock(pCtx, &gpResponseCacheState->mutex)  );
+	SG_STRING_NULLFREE(pCtx, pstrKey);
+}
+
+/**
+ * Hash the dag's leaves.  This is the query the counters save us from
+ * making on every request.
+ */
+static void _hash_leaves(SG_context * pCtx, SG_repo * pRepo, SG_uint64 iDagNum, SG_uint64 * pSig)
+{
+	SG_rbtree * prbLeaves = NULL;
+	SG_rbtree_iterator * pit = NULL;
+	const char * pszLeaf = NULL;
+	SG_bool b = SG_FALSE;
+	SG_uint64 sig = FNV_INIT;
+
+	SG_ERR_CHECK(  SG_repo__fetch_dag_leaves(pCtx, pRepo, iDagNum, &prbLeaves)  );
+	if (prbLeaves)
+	{
+		SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pit, prbLeaves, &b, &pszLeaf, NULL)  );
+		while (b)
+		{
+			sig = _fnv(sig, pszLeaf, SG_STRLEN(pszLeaf) + 1);
+			SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pit, &b, &pszLeaf, NULL)  );
+		}
+	}
+
+	*pSig = sig;
+
+fail:
+	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+	SG_RBTREE_NULLFREE(pCtx, prbLeaves);
+}
+
+/**
+ * Add the dag's state to *pState, looking at its leaves first unless
+ * we've been told we may skip that for a while and we looked recently.
+ */
+static void _add_dag_state(
+	SG_context * pCtx,
+	SG_repo * pRepo,
+	SG_uint64 iDagNum,
+	const char * pszDagKey,
+	SG_uint64 * pState)
+{
+	struct sg_rc_dag * pDag = NULL;
+	struct sg_rc_dag * pDagNew = NULL;
+	SG_bool bFound = SG_FALSE;
+	SG_bool bLocked = SG_FALSE;
+	SG_bool bCheck = SG_FALSE;
+	SG_int64 now = 0;
+	SG_uint64 sig = 0;
+
+	SG_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &now)  );
+
+	SG_ERR_CHECK(  SG_mutex__lock(pCtx, &gpResponseCacheState->mutex)  );
+	bLocked = SG_TRUE;
+	SG_ERR_CHECK(  SG_rbtree__find(pCtx, gpResponseCacheState->prbDags, pszDagKey, &bFound, (void **)&pDag)  );
+	bCheck = (!bFound
+			  || gpResponseCacheState->validate_ms == 0
+			  || now - pDag->checked_ms >= gpResponseCacheState->validate_ms);
+	SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &gpResponseCacheState->mutex)  );
+	bLocked = SG_FALSE;
+
+	// Don't hold the lock while we go to the repo.
+	if (bCheck)
+		SG_ERR_CHECK(  _hash_leaves(pCtx, pRepo, iDagNum, &sig)  );
+
+	SG_ERR_CHECK(  SG_mutex__lock(pCtx, &gpResponseCacheState->mutex)  );
+	bLocked = SG_TRUE;
+
+	if (bCheck)
+	{
+		SG_ERR_CHECK(  SG_rbtree__find(pCtx, gpResponseCacheState->prbDags, pszDagKey, &bFound, (void **)&pDag)  );
+		if (!bFound)
+		{
+			SG_ERR_CHECK(  SG_alloc1(pCtx, pDagNew)  );
+			pDagNew->base = sig;
+			pDagNew->sig = sig;
+			SG_ERR_CHECK(  SG_rbtree__add__with_assoc(pCtx, gpResponseCacheState->prbDags, pszDagKey, pDagNew)  );
+			pDag = pDagNew;
+			pDagNew = NULL;
+		}
+		else if (pDag->bSigKnown && pDag->sig != sig)
+		{
+			// Someone else changed it.
+			pDag->counter++;
+		}
+		pDag->sig = sig;
+		pDag->bSigKnown = SG_TRUE;
+		pDag->checked_ms = now;
+	}
+
+	*pState = _fnv(*pState, &pDag->base, sizeof(pDag->base));
+	*pState = _fnv(*pState, &pDag->counter, sizeof(pDag->counter));
+
+fail:
+	if (bLocked)
+		SG_ERR_IGNORE(  SG_mutex__unlock(pCtx, &gpResponseCacheState->mutex)  );
+	SG_NULLFREE(pCtx, pDagNew);
+}
+
+void SG_responsecache__get_etag(
+	SG_context * pCtx,
+	SG_repo * pRepo,
+	const SG_uint64 * paDagNums,
+	SG_uint32 countDagNums,
+	const char * pszKey,
+	char ** ppszEtag)
+{
+	const char * pszInstanceKey = NULL;
+	SG_string * pstrDagKey = NULL;
+	SG_uint64 keyhash = FNV_INIT;
+	SG_uint64 state = FNV_INIT;
+	char bufEtag[2 * HASH_HEX_LEN + 2];
+	SG_uint32 k;
+
+	SG_NULLARGCHECK_RETURN(pRepo);
+	SG_NULLARGCHECK_RETURN(pszKey);
+	SG_NULLARGCHECK_RETURN(ppszEtag);
+	if (countDagNums > 0)
+		SG_NULLARGCHECK_RETURN(paDagNums);
+
+	if (gpResponseCacheState == NULL)
+		SG_ERR_THROW2_RETURN(  SG_ERR_NOTIMPLEMENTED, (pCtx, "The response cache is only available in the server.")  );
+
+	SG_ERR_CHECK(  SG_repo__get_instance_key(pCtx, pRepo, &pszInstanceKey)  );
+	keyhash = _fnv(keyhash, pszInstanceKey, SG_STRLEN(pszInstanceKey) + 1);
+	keyhash = _fnv(keyhash, pszKey, SG_STRLEN(pszKey));
+
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstrDagKey)  );
+	for (k=0; k<countDagNums; k++)
+	{
+		SG_ERR_CHECK(  _format_dag_key(pCtx, pszInstanceKey, paDagNums[k], pstrDagKey)  );
+		SG_ERR_CHECK(  _add_dag_state(pCtx, pRepo, paDagNums[k], SG_string__sz(pstrDagKey), &state)  );
+	}
+
+	_hex64(keyhash, bufEtag);
+	bufEtag[HASH_HEX_LEN] = '-';
+	_hex64(state, bufEtag + HASH_HEX_LEN + 1);
+
+	SG_ERR_CHECK(  SG_STRDUP(pCtx, bufEtag, ppszEtag)  );
+
+fail:
+	SG_STRING_NULLFREE(pCtx, pstrDagKey);
+}
+
+//////////////////////////////////////////////////////////////////
+
+static SG_bool _is_valid_etag(const char * pszEtag)
+{
+	return (pszEtag
+			&& SG_STRLEN(pszEtag) == 2 * HASH_HEX_LEN + 1
+			&& pszEtag[HASH_HEX_LEN] == '-');
+}
+
+/**
+ * Add an entry, replacing any for the same key, and unlink the least
+ * recently used ones until we're under the limit.  The ones pushed out
+ * are chained through pNext into *ppEvicted for the caller to spill and
+ * free once it has let go of the lock.
+ */
+static void _add_locked(
+	SG_context * pCtx,
+	struct sg_rc_entry ** ppEntry,
+	struct sg_rc_entry ** ppEvicted)
+{
+	struct sg_rc_entry * pEntry = *ppEntry;
+	struct sg_rc_entry * pOld = NULL;
+	char bufName[HASH_HEX_LEN + 1];
+
+	memcpy(bufName, pEntry->pszEtag, HASH_HEX_LEN);
+	bufName[HASH_HEX_LEN] = 0;
+
+	SG_rbtree__remove__with_assoc(pCtx, gpResponseCacheState->prbEntries, bufName, (void **)&pOld);
+	if (SG_CONTEXT__HAS_ERR(pCtx))
+	{
+		SG_ERR_CHECK_RETURN_CURRENT_DISREGARD(SG_ERR_NOT_FOUND);
+	}
+	else
+	{
+		// A newer response for the same key.  The old one isn't worth spilling.
+		_unlink(pOld);
+		gpResponseCacheState->total -= pOld->cost;
+		_entry__free(pCtx, pOld);
+	}
+
+	SG_ERR_CHECK_RETURN(  SG_rbtree__add__with_assoc(pCtx, gpResponseCacheState->prbEntries, bufName, pEntry)  );
+	*ppEntry = NULL;
+	_link_most_recent(pEntry);
+	gpResponseCacheState->total += pEntry->cost;
+
+	while (gpResponseCacheState->total > gpResponseCacheState->limit
+		   && gpResponseCacheState->pLeastRecent != pEntry)
+	{
+		struct sg_rc_entry * pVictim = gpResponseCacheState->pLeastRecent;
+
+		memcpy(bufName, pVictim->pszEtag, HASH_HEX_LEN);
+		SG_ERR_CHECK_RETURN(  SG_rbtree__remove(pCtx, gpResponseCacheState->prbEntries, bufName)  );
+		_unlink(pVictim);
+		gpResponseCacheState->total -= pVictim->cost;
+
+		pVictim->pNext = *ppEvicted;
+		*ppEvicted = pVictim;
+	}
+}
+
+/**
+ * Add an entry to memory, or straight to the spill directory if it's too
+ * big to keep there.
+ */
+static void _add(SG_context * pCtx, struct sg_rc_entry ** ppEntry)
+{
+	struct sg_rc_entry * pEvicted = NULL;
+	SG_bool bLocked = SG_FALSE;
+
+	if ((*ppEntry)->cost > gpResponseCacheState->limit)
+	{
+		pEvicted = *ppEntry;
+		*ppEntry = NULL;
+	}
+	else
+	{
+		SG_ERR_CHECK(  SG_mutex__lock(pCtx, &gpResponseCacheState->mutex)  );
+		bLocked = SG_TRUE;
+		SG_ERR_CHECK(  _add_locked(pCtx, ppEntry, &pEvicted)  );
+		SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &gpResponseCacheState->mutex)  );
+		bLocked = SG_FALSE;
+	}
+
+	// fall through
+fail:
+	if (bLocked)
+		SG_ERR_IGNORE(  SG_mutex__unlock(pCtx, &gpResponseCacheState->mutex)  );
+
+	while (pEvicted)
+	{
+		struct sg_rc_entry * pNext = pEvicted->pNext;
+
+		if (gpResponseCacheState->pSpillDir)
+		{
+			_spill(pCtx, pEvicted);
+			if (SG_CONTEXT__HAS_ERR(pCtx))
+			{
+				SG_log__report_error__current_error(pCtx);
+				SG_context__err_reset(pCtx);
+			}
+		}
+		_entry__free(pCtx, pEvicted);
+		pEvicted = pNext;
+	}
+}
+
+void SG_responsecache__get(
+	SG_context * pCtx,
+	const char * pszEtag,
+	const char * pszKey,
+	SG_string ** ppstrText)
+{
+	struct sg_rc_entry * pEntry = NULL;
+	struct sg_rc_entry * pEntryNew = NULL;
+	SG_string * pstrText = NULL;
+	char bufName[HASH_HEX_LEN + 1];
+	SG_bool bFound = SG_FALSE;
+	SG_bool bLocked = SG_FALSE;
+
+	SG_NULLARGCHECK_RETURN(pszKey);
+	SG_NULLARGCHECK_RETURN(ppstrText);
+
+	*ppstrText = NULL;
+
+	if (gpResponseCacheState == NULL)
+		SG_ERR_THROW2_RETURN(  SG_ERR_NOTIMPLEMENTED, (pCtx, "The response cache is only available in the server.")  );
+
+	// An ETag we didn't make can't be in the cache.
+	if (!_is_valid_etag(pszEtag))
+		return;
+
+	memcpy(bufName, pszEtag, HASH_HEX_LEN);
+	bufName[HASH_HEX_LEN] = 0;
+
+	SG_ERR_CHECK(  SG_mutex__lock(pCtx, &gpResponseCacheState->mutex)  );
+	bLocked = SG_TRUE;
+	SG_ERR_CHECK(  SG_rbtree__find(pCtx, gpResponseCacheState->prbEntries, bufName, &bFound, (void **)&pEntry)  );
+	if (bFound && 0 == strcmp(pEntry->pszEtag, pszEtag) && 0 == strcmp(pEntry->pszKey, pszKey))
+	{
+		SG_ERR_CHECK(  SG_STRING__ALLOC__BUF_LEN(pCtx, &pstrText, (const SG_byte *)pEntry->pszText, pEntry->lenText)  );
+		_unlink(pEntry);
+		_link_most_recent(pEntry);
+	}
+	SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &gpResponseCacheState->mutex)  );
+	bLocked = SG_FALSE;
+
+	if (!pstrText && gpResponseCacheState->pSpillDir)
+	{
+		SG_ERR_CHECK(  _unspill(pCtx, pszEtag, pszKey, &pstrText)  );
+
+		// It's been asked for again, so bring it back in.
+		if (pstrText)
+		{
+			SG_ERR_CHECK(  _entry__alloc(pCtx, pszEtag, pszKey, SG_string__sz(pstrText), SG_string__length_in_bytes(pstrText), &pEntryNew)  );
+			SG_ERR_CHECK(  _add(pCtx, &pEntryNew)  );
+		}
+	}
+
+	*ppstrText = pstrText;
+	pstrText = NULL;
+
+fail:
+	if (bLocked)
+		SG_ERR_IGNORE(  SG_mutex__unlock(pCtx, &gpResponseCacheState->mutex)  );
+	SG_STRING_NULLFREE(pCtx, pstrText);
+	_entry__free(pCtx, pEntryNew);
+}
+
+void SG_responsecache__put(
+	SG_context * pCtx,
+	const char * pszEtag,
+	const char * pszKey,
+	const char * pszText)
+{
+	struct sg_rc_entry * pEntry = NULL;
+
+	SG_NULLARGCHECK_RETURN(pszKey);
+	SG_NULLARGCHECK_RETURN(pszText);
+
+	if (gpResponseCacheState == NULL)
+		SG_ERR_THROW2_RETURN(  SG_ERR_NOTIMPLEMENTED, (pCtx, "The response cache is only available in the server.")  );
+
+	if (!_is_valid_etag(pszEtag))
+		SG_ERR_THROW2_RETURN(  SG_ERR_INVALIDARG, (pCtx, "Not a response cache ETag.")  );
+
+	SG_ERR_CHECK(  _entry__alloc(pCtx, pszEtag, pszKey, pszText, SG_STRLEN(pszText), &pEntry)  );
+	SG_ERR_CHECK(  _add(pCtx, &pEntry)  );
+
+fail:
+	_entry__free(pCtx, pEntry);
+}
@@ -280,6 +280,7 @@ void sg_sqlite__exec(SG_context * pCtx, sqlite3* psql, const char* psz)
 	int rc;
     SG_int64 t1 = 0;
     SG_int64 t2 = 0;
+    SG_int64 tPerf;
 
 #if TRACE_SQLITE
 	fprintf(stderr,"Attempting sqlite3_exec(%s)\n",psz);
@@ -290,7 +291,9 @@ void sg_sqlite__exec(SG_context * pCtx, sqlite3* psql, const char* psz)
 #endif
 
     SG_time__get_milliseconds_since_1970_utc(pCtx, &t1);
+    tPerf = SG_perf__start();
 	rc = sqlite3_exec(psql, psz, NULL, NULL, NULL);
+    SG_perf__stop(SG_PERF_CATEGORY__SQLITE, tPerf, 0);
     SG_time__get_milliseconds_since_1970_utc(pCtx, &t2);
 
 #if TRACE_SQLITE
@@ -470,7 +473,10 @@ void sg_sqlite__step__nocheck__retry(
 
     while (1)
     {
+        SG_int64 tPerf = SG_perf__start();
+
         rc = sqlite3_step(pStmt);
+        SG_perf__stop(SG_PERF_CATEGORY__SQLITE, tPerf, 0);
 
         if (SQLITE_BUSY == rc)
         {
@@ -508,7 +514,10 @@ void sg_sqlite__step__retry(
 
     while (1)
     {
+        SG_int64 tPerf = SG_perf__start();
+
         rc = sqlite3_step(pStmt);
+        SG_perf__stop(SG_PERF_CATEGORY__SQLITE, tPerf, 0);
 
         if (rcshould == rc)
         {
@@ -535,12 +544,15 @@ void sg_sqlite__step__retry(
 void sg_sqlite__step(SG_context * pCtx, sqlite3_stmt* pStmt, int rcshould)
 {
 	int rc;
+	SG_int64 tPerf;
 
 #if TRACE_SQLITE && (SQLITE_VERSION_NUMBER >= 3006000)
 	fprintf(stderr,"Attempting sqlite3_step(%s)\n",sqlite3_sql(pStmt));
 #endif
 
+	tPerf = SG_perf__start();
 	rc = sqlite3_step(pStmt);
+	SG_perf__stop(SG_PERF_CATEGORY__SQLITE, tPerf, 0);
 
 #if TRACE_SQLITE_ERRORS && (SQLITE_VERSION_NUMBER >= 3006000)
 	if (rc == SQLITE_BUSY)
@@ -572,6 +584,23 @@ void sg_sqlite__bind_blob__string(SG_context * pCtx, sqlite3_stmt* pStmt, SG_uin
 		SG_ERR_THROW_RETURN(  SG_ERR_SQLITE(rc)  );
 }
 
+void sg_sqlite__bind_blob(SG_context * pCtx, sqlite3_stmt* pStmt, SG_uint32 ndx, const SG_byte* p, SG_uint32 len)
+{
+	int rc;
+
+#if TRACE_SQLITE
+	fprintf(stderr,"Binding[%d] blob of length %d...\n",ndx, len);
+#endif
+
+	// sqlite binds a NULL pointer as NULL rather than as an empty blob.
+	if (len)
+		rc = sqlite3_bind_blob(pStmt, ndx, p, len, SQLITE_STATIC);
+	else
+		rc = sqlite3_bind_zeroblob(pStmt, ndx, 0);
+	if (rc)
+		SG_ERR_THROW_RETURN(  SG_ERR_SQLITE(rc)  );
+}
+
 void sg_sqlite__bind_blob__stream(SG_context * pCtx, sqlite3_stmt* pStmt, SG_uint32 ndx, SG_uint32 lenFull)
 {
 	int rc;
@@ -23,7 +23,17 @@ limitations under the License.
 #define VERSION_FILENAME "__VER__"
 #define CLONE_REPO_INFO_FILENAME "__INFO__"
 
-#define MY_VERSION 1
+#define MY_VERSION 2
+
+/* Values for blobs_referenced.state.  A referenced blob starts out
+ * UNCHECKED and is asked of the repo exactly once; after that the
+ * row only changes when the blob arrives in the staging area.  So
+ * the rows in state MISSING are, at any time, exactly the blobs we
+ * still need, and a status check never has to rescan the rest. */
+#define sg_STAGING_BLOB__UNCHECKED		0
+#define sg_STAGING_BLOB__IN_REPO		1
+#define sg_STAGING_BLOB__MISSING		2
+#define sg_STAGING_BLOB__PRESENT		3
 
 struct _sg_staging_blob_handle
 {
@@ -217,6 +227,8 @@ static void _add_disconnected_dag_to_status(
 	const char* pszRefHid = NULL;
 	SG_vhash* pvhRefAllLeaves = NULL;
 	SG_vhash* pvhRefDagLeaves = NULL;
+	SG_vhash* pvhRefAllHaveSets = NULL;
+	SG_vhash* pvhHaveSet = NULL;
 
 	SG_ERR_CHECK(  SG_rbtree__count(pCtx, prb_missing, &count)  );
 	SG_ASSERT(count);
@@ -275,9 +287,22 @@ static void _add_disconnected_dag_to_status(
 		SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pit, &b, &pszRefHid, NULL)  );
 	}
 
+	/* And a summary of what we have near those leaves, which lets the
+	 * other side find the connection point in one go. */
+
+	SG_ERR_CHECK(  SG_sync__build_have_set(pCtx, pRepo, iDagNum, &pvhHaveSet)  );
+	if (pvhHaveSet)
+	{
+		SG_ERR_CHECK(  SG_vhash__check__vhash(pCtx, pvh_status, SG_SYNC_STATUS_KEY__HAVE, &pvhRefAllHaveSets)  );
+		if (!pvhRefAllHaveSets)
+			SG_ERR_CHECK(  SG_vhash__addnew__vhash(pCtx, pvh_status, SG_SYNC_STATUS_KEY__HAVE, &pvhRefAllHaveSets)  );
+		SG_ERR_CHECK(  SG_vhash__add__vhash(pCtx, pvhRefAllHaveSets, pszDagnum, &pvhHaveSet)  );
+	}
+
 	// fall through
 fail:
 	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+	SG_VHASH_NULLFREE(pCtx, pvhHaveSet);
     SG_VHASH_NULLFREE(pCtx, pvh_dag_fringe_container);
     SG_VHASH_NULLFREE(pCtx, pvh_fringe);
 	SG_VHASH_NULLFREE(pCtx, pvhTmp);
@@ -613,9 +638,102 @@ fail:
 	SG_ERR_IGNORE(  sg_sqlite__finalize(pCtx,pStmt)  );
 }
 
+/**
+ * Referenced blobs which arrived in the staging area before anyone
+ * got around to asking the repo about them don't need to be asked.
+ * Only rows which haven't been looked at yet are touched.
+ */
+static void _mark_unchecked_blobs_present(
+	SG_context* pCtx,
+	sg_staging* pMe)
+{
+	SG_ERR_CHECK_RETURN(  sg_sqlite__exec__va(pCtx, pMe->psql,
+		("UPDATE blobs_referenced SET state = %d "
+		 "WHERE state = %d "
+		 " AND hid IN (SELECT hid FROM blobs_present)"),
+		sg_STAGING_BLOB__PRESENT, sg_STAGING_BLOB__UNCHECKED)  );
+}
+
+/**
+ * Ask the repo about every referenced blob of the requested kind(s)
+ * that we haven't asked about before, and record the answer.
+ */
+static void _query_repo_for_unchecked_blobs(
+	SG_context* pCtx,
+	sg_staging* pMe,
+	SG_repo* pRepo,
+	const char* pszKindFilter)
+{
+	sqlite3_stmt* pStmt = NULL;
+	int rc;
+	SG_int32 count = 0;
+	SG_uint32 i, countNotInRepo = 0;
+	SG_stringarray* psaQueryRepoForBlobs = NULL;
+	SG_stringarray* psaBlobsNotInRepo = NULL;
+
+	SG_ERR_CHECK(  sg_sqlite__exec__va__int32(pCtx, pMe->psql, &count,
+		"SELECT count(*) FROM blobs_referenced WHERE state = %d%s",
+		sg_STAGING_BLOB__UNCHECKED, pszKindFilter)  );
+	if (count <= 0)
+		return;
+
+	SG_ERR_CHECK(  SG_STRINGARRAY__ALLOC(pCtx, &psaQueryRepoForBlobs, count)  );
+
+	SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pMe->psql, &pStmt,
+		"SELECT hid FROM blobs_referenced WHERE state = %d%s",
+		sg_STAGING_BLOB__UNCHECKED, pszKindFilter)  );
+	while ((rc=sqlite3_step(pStmt)) == SQLITE_ROW)
+	{
+		SG_ERR_CHECK(  SG_stringarray__add(pCtx, psaQueryRepoForBlobs,
+			(const char*)sqlite3_column_text(pStmt, 0))  );
+	}
+	if (rc != SQLITE_DONE)
+		SG_ERR_THROW(  SG_ERR_SQLITE(rc)  );
+	SG_ERR_CHECK(  sg_sqlite__nullfinalize(pCtx, &pStmt)  );
+
+	SG_ERR_CHECK(  SG_repo__query_blob_existence(pCtx, pRepo, psaQueryRepoForBlobs, &psaBlobsNotInRepo)  );
+
+	// Flag the ones the repo doesn't have first, then everything else
+	// we just asked about is, by elimination, in the repo.
+	if (psaBlobsNotInRepo)
+		SG_ERR_CHECK(  SG_stringarray__count(pCtx, psaBlobsNotInRepo, &countNotInRepo)  );
+	if (countNotInRepo)
+	{
+		SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pMe->psql, &pStmt,
+			"UPDATE blobs_referenced SET state = %d WHERE hid = ?",
+			sg_STAGING_BLOB__MISSING)  );
+		for (i = 0; i < countNotInRepo; i++)
+		{
+			const char* pszHid = NULL;
+
+			SG_ERR_CHECK(  SG_stringarray__get_nth(pCtx, psaBlobsNotInRepo, i, &pszHid)  );
+			SG_ERR_CHECK(  sg_sqlite__reset(pCtx, pStmt)  );
+			SG_ERR_CHECK(  sg_sqlite__clear_bindings(pCtx, pStmt)  );
+			SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx, pStmt, 1, pszHid)  );
+			SG_ERR_CHECK(  sg_sqlite__step(pCtx, pStmt, SQLITE_DONE)  );
+		}
+		SG_ERR_CHECK(  sg_sqlite__nullfinalize(pCtx, &pStmt)  );
+	}
+
+	SG_ERR_CHECK(  sg_sqlite__exec__va(pCtx, pMe->psql,
+		"UPDATE blobs_referenced SET state = %d WHERE state = %d%s",
+		sg_STAGING_BLOB__IN_REPO, sg_STAGING_BLOB__UNCHECKED, pszKindFilter)  );
+
+	/* fall through */
+fail:
+	SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmt)  );
+	SG_STRINGARRAY_NULLFREE(pCtx, psaQueryRepoForBlobs);
+	SG_STRINGARRAY_NULLFREE(pCtx, psaBlobsNotInRepo);
+}
+
 /**
  * Updates pvh_status to reflect blobs in the current push that are
  * not yet present in the staging area or the repo itself.
+ *
+ * This runs after every fragball, so it must only cost as much as
+ * what arrived since the last call.  Each referenced blob carries a
+ * state (see sg_STAGING_BLOB__*), the repo is asked about a blob only
+ * once, and the answer is read back from the MISSING rows.
  */
 static void _check_blobs(
 	SG_context* pCtx,
@@ -628,10 +746,12 @@ static void _check_blobs(
 {
 	sqlite3_stmt* pStmt = NULL;
 	int rc;
-	SG_stringarray* psaQueryRepoForBlobs = NULL;
-	SG_stringarray* psaBlobsNotInRepo = NULL;
+	SG_stringarray* psaMissing = NULL;
 	SG_changeset* pChangeset = NULL;
 	sg_staging_blob_handle* pBlobHandle = NULL;
+	const char* pszKindFilter = NULL;
+
+	SG_ERR_CHECK(  _mark_unchecked_blobs_present(pCtx, pMe)  );
 
 	// If the caller cares about non-changeset blobs, we crack open
 	// all the changeset blobs that are present in the staging area and haven't
@@ -644,8 +764,8 @@ static void _check_blobs(
 		// Get a list of all the changesets whose blobs haven't yet been explored.
 		SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pMe->psql, &pStmt,
 			("SELECT hid FROM blobs_referenced "
-			 "WHERE is_changeset = 1 AND data_blobs_known = 0 "
-			 " AND hid IN (SELECT hid from blobs_present)"))  );
+			 "WHERE state = %d AND is_changeset = 1 AND data_blobs_known = 0"),
+			sg_STAGING_BLOB__PRESENT)  );
 		while ((rc=sqlite3_step(pStmt)) == SQLITE_ROW)
 		{
 			pszHid = (const char*)sqlite3_column_text(pStmt, 0);
@@ -666,67 +786,44 @@ static void _check_blobs(
 
 		// Regardless of the sqlite transaction status, this is safe because
 		// staging areas are unique to each invocation of pull_begin/push_begin.
-		SG_ERR_CHECK(  sg_sqlite__exec(pCtx, pMe->psql,
+		SG_ERR_CHECK(  sg_sqlite__exec__va(pCtx, pMe->psql,
 			("UPDATE blobs_referenced SET data_blobs_known = 1 "
-			 "WHERE is_changeset = 1 AND data_blobs_known = 0 "
-			 "  AND hid IN (SELECT hid from blobs_present)"))  );
+			 "WHERE state = %d AND is_changeset = 1 AND data_blobs_known = 0"),
+			sg_STAGING_BLOB__PRESENT)  );
 
 		// At this point the blobs_referenced table is up-to-date given the
-		// frags and changeset blobs that are present.
+		// frags and changeset blobs that are present.  The data blobs we
+		// just discovered may already be here too.
+		SG_ERR_CHECK(  _mark_unchecked_blobs_present(pCtx, pMe)  );
 	}
 
-	// Build the list of blobs to ask the repo which ones it needs.
-	if (bCheckChangesetBlobs)
-	{
-		if (bCheckDataBlobs)
-		{
-			SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pMe->psql, &pStmt,
-				("SELECT hid FROM blobs_referenced "
-				 "WHERE hid NOT IN (SELECT hid FROM blobs_present)"))  );
-		}
-		else
-		{
-			SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pMe->psql, &pStmt,
-				("SELECT hid FROM blobs_referenced "
-				 "WHERE is_changeset = 1 "
-				 " AND hid NOT IN (SELECT hid FROM blobs_present)"))  );
-		}
-	}
-	else
-	{
-		if (bCheckDataBlobs)
-		{
-			SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pMe->psql, &pStmt,
-				("SELECT hid FROM blobs_referenced "
-				"WHERE is_changeset = 0 "
-				" AND hid NOT IN (SELECT hid FROM blobs_present)"))  );
-		}
-	}
-	if (pStmt)
-	{
-		SG_int32 count = 0;
+	if (bCheckChangesetBlobs && bCheckDataBlobs)
+		pszKindFilter = "";
+	else if (bCheckChangesetBlobs)
+		pszKindFilter = " AND is_changeset = 1";
+	else if (bCheckDataBlobs)
+		pszKindFilter = " AND is_changeset = 0";
 
-		SG_ERR_CHECK(  sg_sqlite__exec__va__int32(pCtx, pMe->psql, &count,
-			("SELECT (SELECT count(*) FROM blobs_referenced) "
-			 " - (SELECT count(*) FROM blobs_present)"))  );
+	if (pszKindFilter)
+	{
+		SG_ERR_CHECK(  _query_repo_for_unchecked_blobs(pCtx, pMe, pRepo, pszKindFilter)  );
 
-		if (count > 0)
+		SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pMe->psql, &pStmt,
+			"SELECT hid FROM blobs_referenced WHERE state = %d%s",
+			sg_STAGING_BLOB__MISSING, pszKindFilter)  );
+		while ((rc=sqlite3_step(pStmt)) == SQLITE_ROW)
 		{
-			SG_ERR_CHECK(  SG_STRINGARRAY__ALLOC(pCtx, &psaQueryRepoForBlobs, count)  );
-
-			while ((rc=sqlite3_step(pStmt)) == SQLITE_ROW)
-			{
-				SG_ERR_CHECK(  SG_stringarray__add(pCtx, psaQueryRepoForBlobs,
-					(const char*)sqlite3_column_text(pStmt, 0))  );
-			}
-			if (rc != SQLITE_DONE)
-				SG_ERR_THROW(  SG_ERR_SQLITE(rc)  );
-			SG_ERR_CHECK(  sg_sqlite__nullfinalize(pCtx, &pStmt)  );
-
-			SG_ERR_CHECK(  SG_repo__query_blob_existence(pCtx, pRepo, psaQueryRepoForBlobs, &psaBlobsNotInRepo)  );
-
-			SG_ERR_CHECK(  _add_missing_blobs_to_status(pCtx, pvh_status, psaBlobsNotInRepo)  );
+			if (!psaMissing)
+				SG_ERR_CHECK(  SG_STRINGARRAY__ALLOC(pCtx, &psaMissing, 1000)  );
+			SG_ERR_CHECK(  SG_stringarray__add(pCtx, psaMissing,
+				(const char*)sqlite3_column_text(pStmt, 0))  );
 		}
+		if (rc != SQLITE_DONE)
+			SG_ERR_THROW(  SG_ERR_SQLITE(rc)  );
+		SG_ERR_CHECK(  sg_sqlite__nullfinalize(pCtx, &pStmt)  );
+
+		if (psaMissing)
+			SG_ERR_CHECK(  _add_missing_blobs_to_status(pCtx, pvh_status, psaMissing)  );
 	}
 
 	if (bGetCounts)
@@ -745,12 +842,10 @@ static void _check_blobs(
 
 	/* fall through*/
 fail:
-	SG_ERR_IGNORE(  sg_sqlite__finalize(pCtx, pStmt)  );
+	SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmt)  );
 	SG_CHANGESET_NULLFREE(pCtx, pChangeset);
 	SG_ERR_IGNORE(  _nullfree_staging_blob_handle(pCtx, &pBlobHandle)  );
-	SG_STRINGARRAY_NULLFREE(pCtx, psaQueryRepoForBlobs);
-	SG_STRINGARRAY_NULLFREE(pCtx, psaBlobsNotInRepo);
-
+	SG_STRINGARRAY_NULLFREE(pCtx, psaMissing);
 }
 
 static void _store_one_frag(
@@ -955,10 +1050,15 @@ static void _open_db(
 												"    ("
 												"      hid VARCHAR UNIQUE NOT NULL,"
 												"      is_changeset INTEGER NOT NULL, "
-												"      data_blobs_known INTEGER NOT NULL "
+												"      data_blobs_known INTEGER NOT NULL, "
+												"      state INTEGER NOT NULL DEFAULT 0 "
 												"    )"))  );
 
 		// We don't need an indexes on hids because the unique constraints imply them.
+		// The state index is what keeps _check_blobs proportional to what changed.
+
+		SG_ERR_CHECK(  sg_sqlite__exec(pCtx, psql,
+			"CREATE INDEX blobs_referenced_state ON blobs_referenced (state, is_changeset)")  );
 
 		SG_ERR_CHECK(  sg_sqlite__exec(pCtx, psql, "COMMIT TRANSACTION")  );
 	}
@@ -1218,8 +1318,11 @@ static void _save_frag(
 			SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstr)  );
 			SG_ERR_CHECK(  SG_vhash__to_json(pCtx, pvh_combined_frag, pstr)  );
 			SG_VHASH_NULLFREE(pCtx, pvh_combined_frag);
+			// The merged frag may have grown a new disconnected piece, and
+			// its new nodes haven't been referenced yet, so it has to be
+			// checked again.  Frags that didn't change are left alone.
 			SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pMe->psql, &pStmt,
-				"UPDATE frags SET frag = ? WHERE iDagnum = ?")  );
+				"UPDATE frags SET frag = ?, connected = 0 WHERE iDagnum = ?")  );
 			SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx,pStmt,1,SG_string__sz(pstr))  );
 			SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx,pStmt,2,buf_dagnum)  );
 			SG_ERR_CHECK(  sg_sqlite__step(pCtx, pStmt, SQLITE_DONE)  );
@@ -1259,6 +1362,7 @@ static void _slurp__version_2(
     SG_uint32 count_blobs = 0;
 
 	sqlite3_stmt* pStmtSaveBlobInfo = NULL;
+	sqlite3_stmt* pStmtMarkPresent = NULL;
 	sqlite3_stmt* pStmt_audits = NULL;
 	SG_stringarray* psaDeltaRefHids = NULL;
 	const SG_uint32 limitDeltaRefHids = 1000;
@@ -1273,6 +1377,12 @@ static void _slurp__version_2(
 		"VALUES (?, ?, ?, ?, ?, ?, ?)"
 		) )  );
 
+	// Keep the missing set current as blobs arrive, so check_status
+	// doesn't have to compare everything referenced with everything present.
+	SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pMe->psql, &pStmtMarkPresent,
+		"UPDATE blobs_referenced SET state = %d WHERE hid = ?",
+		sg_STAGING_BLOB__PRESENT)  );
+
 	SG_ERR_CHECK(  sg_sqlite__prepare(pCtx, pMe->psql, &pStmt_audits,
 		(
 		"INSERT INTO audits "
@@ -1373,6 +1483,11 @@ static void _slurp__version_2(
 			SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx,pStmtSaveBlobInfo,7,psz_hid_vcdiff_reference)  );
 			SG_ERR_CHECK(  sg_sqlite__step(pCtx,pStmtSaveBlobInfo,SQLITE_DONE)  );
 
+			SG_ERR_CHECK(  sg_sqlite__reset(pCtx, pStmtMarkPresent)  );
+			SG_ERR_CHECK(  sg_sqlite__clear_bindings(pCtx, pStmtMarkPresent)  );
+			SG_ERR_CHECK(  sg_sqlite__bind_text(pCtx,pStmtMarkPresent,1,psz_hid)  );
+			SG_ERR_CHECK(  sg_sqlite__step(pCtx,pStmtMarkPresent,SQLITE_DONE)  );
+
 			if (psz_hid_vcdiff_reference && SG_IS_BLOBENCODING_VCDIFF(encoding))
 			{
 				if (!psaDeltaRefHids)
@@ -1416,6 +1531,7 @@ static void _slurp__version_2(
 
 	SG_VHASH_NULLFREE(pCtx, pvh);
 	SG_ERR_CHECK(  sg_sqlite__nullfinalize(pCtx, &pStmtSaveBlobInfo)  );
+	SG_ERR_CHECK(  sg_sqlite__nullfinalize(pCtx, &pStmtMarkPresent)  );
 	SG_ERR_CHECK(  sg_sqlite__nullfinalize(pCtx, &pStmt_audits)  );
 	SG_STRINGARRAY_NULLFREE(pCtx, psaDeltaRefHids);
 
@@ -1426,6 +1542,7 @@ static void _slurp__version_2(
 fail:
 	SG_VHASH_NULLFREE(pCtx, pvh);
 	SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmtSaveBlobInfo)  );
+	SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmtMarkPresent)  );
 	SG_ERR_IGNORE(  sg_sqlite__nullfinalize(pCtx, &pStmt_audits)  );
 	SG_STRINGARRAY_NULLFREE(pCtx, psaDeltaRefHids);
 }
@@ -1476,6 +1593,75 @@ fail:
 	SG_PATHNAME_NULLFREE(pCtx, pPath);
 }
 
+/**
+ * Version 1 staging areas differ only in pending.db, whose
+ * blobs_referenced table predates the state column.  Add the column
+ * and its index (every row starts out UNCHECKED, so the next status
+ * check asks the repo about each blob once) and restamp the version.
+ */
+static void _upgrade_staging__v1(SG_context* pCtx, const SG_pathname* pPath_staging)
+{
+	SG_pathname* pPath = NULL;
+	SG_bool bExists = SG_FALSE;
+	sqlite3* psql = NULL;
+	sqlite3_stmt* pStmt = NULL;
+	int rc;
+
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPath, pPath_staging, "pending.db")  );
+	SG_ERR_CHECK(  SG_fsobj__exists__pathname(pCtx, pPath, &bExists, NULL, NULL)  );
+	if (bExists)
+	{
+		SG_ERR_CHECK(  sg_sqlite__open__pathname(pCtx, pPath, SG_SQLITE__SYNC__OFF, &psql)  );
+		sqlite3_busy_timeout(psql,MY_BUSY_TIMEOUT_MS);
+
+		// A crash between the ALTER and the restamp below leaves a
+		// v1 stamp on a v2 table, so look before altering.
+		rc = sqlite3_prepare_v2(psql, "SELECT state FROM blobs_referenced LIMIT 0", -1, &pStmt, NULL);
+		sqlite3_finalize(pStmt);
+		pStmt = NULL;
+		if (rc != SQLITE_OK)
+		{
+			SG_ERR_CHECK(  sg_sqlite__exec(pCtx, psql, "BEGIN TRANSACTION")  );
+			SG_ERR_CHECK(  sg_sqlite__exec(pCtx, psql,
+				"ALTER TABLE blobs_referenced ADD COLUMN state INTEGER NOT NULL DEFAULT 0")  );
+			SG_ERR_CHECK(  sg_sqlite__exec(pCtx, psql,
+				"CREATE INDEX blobs_referenced_state ON blobs_referenced (state, is_changeset)")  );
+			SG_ERR_CHECK(  sg_sqlite__exec(pCtx, psql, "COMMIT TRANSACTION")  );
+		}
+
+		SG_ERR_CHECK(  sg_sqlite__close(pCtx, psql)  );
+		psql = NULL;
+	}
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPath, pPath_staging, VERSION_FILENAME)  );
+	SG_ERR_CHECK(  SG_fsobj__remove__pathname(pCtx, pPath)  );
+	SG_ERR_CHECK(  _write_staging_version(pCtx, pPath_staging, MY_VERSION)  );
+
+	/* fall through */
+fail:
+	if (psql)
+	{
+		SG_ERR_IGNORE(  sg_sqlite__exec(pCtx, psql, "ROLLBACK TRANSACTION")  );
+		SG_ERR_IGNORE(  sg_sqlite__close(pCtx, psql)  );
+	}
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+}
+
+static void _check_staging_version(SG_context* pCtx, const SG_pathname* pPath_staging)
+{
+	SG_uint32 iVersion = 0;
+
+	SG_ERR_CHECK_RETURN(  _read_staging_version(pCtx, pPath_staging, &iVersion)  );
+	if (iVersion == 1)
+		SG_ERR_CHECK_RETURN(  _upgrade_staging__v1(pCtx, pPath_staging)  );
+	else if (iVersion != MY_VERSION)
+	{
+		SG_ERR_THROW2_RETURN(  SG_ERR_UNKNOWN_STAGING_VERSION,
+			(pCtx, "version %u at %s", iVersion, SG_pathname__sz(pPath_staging))  );
+	}
+}
+
 static void _write_repo_descriptor_name(SG_context* pCtx, const SG_pathname* pPath_staging, const char* psz_repo_descriptor_name)
 {
 	SG_file * pFile = NULL;
@@ -1562,7 +1748,6 @@ void SG_staging__open(SG_context* pCtx,
 					  SG_staging** ppStaging)
 {
 	SG_pathname* pPath_staging = NULL;
-	SG_uint32 iVersion = 0;
 	sg_staging* pMe = NULL;
 	SG_staging* pStaging = NULL;
 	char* pszDescriptorName = NULL;
@@ -1575,12 +1760,7 @@ void SG_staging__open(SG_context* pCtx,
 	pMe->pPath = pPath_staging;
 	pPath_staging = NULL;
 
-	SG_ERR_CHECK(  _read_staging_version(pCtx, pMe->pPath, &iVersion)  );
-	if (iVersion != MY_VERSION)
-	{
-		SG_ERR_THROW2(  SG_ERR_UNKNOWN_STAGING_VERSION,
-			(pCtx, "version %u at %s", iVersion, SG_pathname__sz(pMe->pPath))  );
-	}
+	SG_ERR_CHECK(  _check_staging_version(pCtx, pMe->pPath)  );
 
 	SG_ERR_CHECK(  _open_db(pCtx, pMe->pPath, &pMe->psql)  );
 
@@ -1913,7 +2093,6 @@ static void _clone__commit_prep(
 	SG_string** ppstrFragballFilename)
 {
 	SG_pathname* pPathCloneStaging = NULL;
-	SG_uint32 iVersion = 0;
 	char* pszDescriptorName = NULL;
 	SG_pathname* pPathRepoInfoVfile = NULL;
 	SG_vhash* pvhRepoInfo = NULL;
@@ -1921,12 +2100,7 @@ static void _clone__commit_prep(
 	SG_pathname* pPathDestFragball = NULL;
 
 	SG_ERR_CHECK(  SG_sync__make_temp_path(pCtx, pszCloneId, &pPathCloneStaging)  );
-	SG_ERR_CHECK(  _read_staging_version(pCtx, pPathCloneStaging, &iVersion)  );
-	if (iVersion != MY_VERSION)
-	{
-		SG_ERR_THROW2(  SG_ERR_UNKNOWN_STAGING_VERSION,
-			(pCtx, "version %u at %s", iVersion, SG_pathname__sz(pPathCloneStaging))  );
-	}
+	SG_ERR_CHECK(  _check_staging_version(pCtx, pPathCloneStaging)  );
 
 	SG_ERR_CHECK(  _read_repo_descriptor_name(pCtx, pPathCloneStaging, &pszDescriptorName)  );
 
@@ -2075,7 +2249,6 @@ void SG_staging__clone__abort(
 	const char* pszCloneId)
 {
 	SG_pathname* pPathCloneStaging = NULL;
-	SG_uint32 iVersion = 0;
 	char* pszDescriptorName = NULL;
 	SG_closet__repo_status status = SG_REPO_STATUS__UNSPECIFIED;
 	SG_vhash* pvhDescriptor = NULL;
@@ -2084,12 +2257,7 @@ void SG_staging__clone__abort(
 	SG_NONEMPTYCHECK_RETURN(pszCloneId);
 
 	SG_ERR_CHECK(  SG_sync__make_temp_path(pCtx, pszCloneId, &pPathCloneStaging)  );
-	SG_ERR_CHECK(  _read_staging_version(pCtx, pPathCloneStaging, &iVersion)  );
-	if (iVersion != MY_VERSION)
-	{
-		SG_ERR_THROW2(  SG_ERR_UNKNOWN_STAGING_VERSION,
-			(pCtx, "version %u at %s", iVersion, SG_pathname__sz(pPathCloneStaging))  );
-	}
+	SG_ERR_CHECK(  _check_staging_version(pCtx, pPathCloneStaging)  );
 
 	SG_ERR_CHECK(  _read_repo_descriptor_name(pCtx, pPathCloneStaging, &pszDescriptorName)  );
 	SG_ERR_CHECK(  SG_closet__descriptors__get__unavailable(pCtx, pszDescriptorName, NULL, NULL, &status, NULL, &pvhDescriptor)  );
@@ -2116,19 +2284,13 @@ void SG_staging__clone__get_info(
 	SG_vhash** ppvhRepoInfo)
 {
 	SG_pathname* pPathCloneStaging = NULL;
-	SG_uint32 iVersion = 0;
 	SG_pathname* pPathRepoInfoVfile = NULL;
 	SG_vhash* pvhRepoInfo = NULL;
 
 	SG_NULLARGCHECK_RETURN(ppvhRepoInfo);
 
 	SG_ERR_CHECK(  SG_sync__make_temp_path(pCtx, pszCloneId, &pPathCloneStaging)  );
-	SG_ERR_CHECK(  _read_staging_version(pCtx, pPathCloneStaging, &iVersion)  );
-	if (iVersion != MY_VERSION)
-	{
-		SG_ERR_THROW2(  SG_ERR_UNKNOWN_STAGING_VERSION,
-			(pCtx, "version %u at %s", iVersion, SG_pathname__sz(pPathCloneStaging))  );
-	}
+	SG_ERR_CHECK(  _check_staging_version(pCtx, pPathCloneStaging)  );
 
 	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathRepoInfoVfile, pPathCloneStaging, CLONE_REPO_INFO_FILENAME)  );
 	SG_ERR_CHECK(  SG_vfile__slurp(pCtx, pPathRepoInfoVfile, &pvhRepoInfo)  );
@@ -438,6 +438,305 @@ fail:
 	SG_ERR_IGNORE(  SG_repo__fetch_dagnodes__end(pCtx, pRepo, &pdh)  );
 }
 
+/* A have-set is a Bloom filter over the dagnodes a repo has in one
+ * dag, from its leaves down to a floor generation.  The other side
+ * walks back from the nodes it wants to send and stops at anything
+ * the filter claims we have, so the connection point is found in one
+ * request instead of a series of best guesses.
+ *
+ * A false positive just leaves a hole at the bottom of the frag.  The
+ * staging area reports that hole as a disconnected fringe, and the
+ * normal connect loop fills it in with its next request. */
+
+#define HAVE_SET_KEY__FLOOR		"floor"
+#define HAVE_SET_KEY__HASHES	"k"
+#define HAVE_SET_KEY__BITS		"bits"
+#define HAVE_SET_KEY__FILTER	"filter"
+
+/* About 1% false positives with 7 hashes at 10 bits per node. */
+#define HAVE_SET_BITS_PER_NODE	10
+#define HAVE_SET_HASHES			7
+
+/* A small dag gets a few more bits than that.  The cost is trivial and
+ * a false positive costs a roundtrip. */
+#define HAVE_SET_MIN_BITS		512
+
+/* The filter covers this many generations below our highest leaf. */
+#define HAVE_SET_GENERATIONS	FALLBACK_GENS_PER_ROUNDTRIP
+
+static void _have_set__hash(const char* pszHid, SG_uint32* pH1, SG_uint32* pH2)
+{
+	/* FNV-1a.  Hids are already well mixed; this just makes us
+	 * independent of the hash method and the hid length. */
+	SG_uint64 h = 14695981039346656037ULL;
+	const unsigned char* p = (const unsigned char*)pszHid;
+
+	while (*p)
+	{
+		h ^= *p++;
+		h *= 1099511628211ULL;
+	}
+
+	*pH1 = (SG_uint32)h;
+	*pH2 = ((SG_uint32)(h >> 32)) | 1;
+}
+
+static void _have_set__add(SG_byte* pBits, SG_uint32 countBits, SG_uint32 countHashes, const char* pszHid)
+{
+	SG_uint32 h1, h2, i;
+
+	_have_set__hash(pszHid, &h1, &h2);
+	for (i = 0; i < countHashes; i++)
+	{
+		SG_uint32 bit = (h1 + i * h2) % countBits;
+		pBits[bit >> 3] |= (SG_byte)(1 << (bit & 7));
+	}
+}
+
+static SG_bool _have_set__maybe_has(const SG_byte* pBits, SG_uint32 countBits, SG_uint32 countHashes, const char* pszHid)
+{
+	SG_uint32 h1, h2, i;
+
+	_have_set__hash(pszHid, &h1, &h2);
+	for (i = 0; i < countHashes; i++)
+	{
+		SG_uint32 bit = (h1 + i * h2) % countBits;
+		if (!(pBits[bit >> 3] & (1 << (bit & 7))))
+			return SG_FALSE;
+	}
+
+	return SG_TRUE;
+}
+
+void SG_sync__build_have_set(
+	SG_context* pCtx,
+	SG_repo* pRepo,
+	SG_uint64 iDagNum,
+	SG_vhash** ppvhHaveSet)
+{
+	SG_rbtree* prbLeaves = NULL;
+	SG_rbtree_iterator* pit = NULL;
+	SG_repo_fetch_dagnodes_handle* pdh = NULL;
+	SG_dagnode* pdn = NULL;
+	SG_ihash* pihNodes = NULL;
+	SG_byte* pBits = NULL;
+	SG_string* pstrFilter = NULL;
+	SG_vhash* pvhHaveSet = NULL;
+	SG_uint32 countNodes = 0, countBits = 0, i;
+	SG_int32 maxGen = -1, floorGen = 0;
+	SG_bool b = SG_FALSE;
+	const char* pszRefHid = NULL;
+
+	SG_NULLARGCHECK_RETURN(pRepo);
+	SG_NULLARGCHECK_RETURN(ppvhHaveSet);
+
+	*ppvhHaveSet = NULL;
+
+	SG_ERR_CHECK(  SG_repo__fetch_dag_leaves(pCtx, pRepo, iDagNum, &prbLeaves)  );
+	if (!prbLeaves)
+		return;
+
+	SG_ERR_CHECK(  SG_repo__fetch_dagnodes__begin(pCtx, pRepo, iDagNum, &pdh)  );
+	SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pit, prbLeaves, &b, &pszRefHid, NULL)  );
+	while (b)
+	{
+		SG_int32 gen;
+
+		SG_ERR_CHECK(  SG_repo__fetch_dagnodes__one(pCtx, pRepo, pdh, pszRefHid, &pdn)  );
+		SG_ERR_CHECK(  SG_dagnode__get_generation(pCtx, pdn, &gen)  );
+		SG_DAGNODE_NULLFREE(pCtx, pdn);
+		if (gen > maxGen)
+			maxGen = gen;
+		SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pit, &b, &pszRefHid, NULL)  );
+	}
+	SG_ERR_CHECK(  SG_repo__fetch_dagnodes__end(pCtx, pRepo, &pdh)  );
+
+	// An empty dag has nothing to summarize.
+	if (maxGen < 0)
+		goto fail;
+
+	// Every node is an ancestor of some leaf, so this is the whole of
+	// what we have at or above the floor.
+	floorGen = (maxGen > HAVE_SET_GENERATIONS) ? (maxGen - HAVE_SET_GENERATIONS) : 0;
+	SG_ERR_CHECK(  SG_repo__fetch_dagnode_ids(pCtx, pRepo, iDagNum, floorGen, -1, &pihNodes)  );
+	SG_ERR_CHECK(  SG_ihash__count(pCtx, pihNodes, &countNodes)  );
+
+	countBits = ((countNodes * HAVE_SET_BITS_PER_NODE + 63) / 64) * 64;
+	if (countBits < HAVE_SET_MIN_BITS)
+		countBits = HAVE_SET_MIN_BITS;
+	SG_ERR_CHECK(  SG_allocN(pCtx, countBits / 8, pBits)  );
+
+	for (i = 0; i < countNodes; i++)
+	{
+		SG_ERR_CHECK(  SG_ihash__get_nth_pair(pCtx, pihNodes, i, &pszRefHid, NULL)  );
+		_have_set__add(pBits, countBits, HAVE_SET_HASHES, pszRefHid);
+	}
+
+	SG_ERR_CHECK(  SG_string__alloc__base64(pCtx, &pstrFilter, pBits, countBits / 8)  );
+
+	SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvhHaveSet)  );
+	SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvhHaveSet, HAVE_SET_KEY__FLOOR, floorGen)  );
+	SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvhHaveSet, HAVE_SET_KEY__HASHES, HAVE_SET_HASHES)  );
+	SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvhHaveSet, HAVE_SET_KEY__BITS, countBits)  );
+	SG_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pvhHaveSet, HAVE_SET_KEY__FILTER, SG_string__sz(pstrFilter))  );
+
+	*ppvhHaveSet = pvhHaveSet;
+	pvhHaveSet = NULL;
+
+	/* Common cleanup */
+fail:
+	SG_RBTREE_NULLFREE(pCtx, prbLeaves);
+	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+	SG_DAGNODE_NULLFREE(pCtx, pdn);
+	SG_IHASH_NULLFREE(pCtx, pihNodes);
+	SG_NULLFREE(pCtx, pBits);
+	SG_STRING_NULLFREE(pCtx, pstrFilter);
+	SG_VHASH_NULLFREE(pCtx, pvhHaveSet);
+	if (pdh)
+		SG_ERR_IGNORE(  SG_repo__fetch_dagnodes__end(pCtx, pRepo, &pdh)  );
+}
+
+void SG_sync__build_dagfrag_from_have_set(
+	SG_context* pCtx,
+	SG_repo* pRepo,
+	SG_uint64 iDagNum,
+	SG_rbtree* prbStartFromHids,
+	const SG_vhash* pvhHaveSet,
+	SG_dagfrag** ppFrag)
+{
+	SG_int64 i64 = 0;
+	SG_int32 floorGen = 0;
+	SG_int32 limitGen = 0;
+	SG_uint32 countHashes = 0, countBits = 0, lenBits = 0, lenGot = 0;
+	const char* pszFilter = NULL;
+	SG_byte* pBits = NULL;
+
+	SG_rbtree* prbSeen = NULL;
+	SG_vector* pvecPending = NULL;
+	SG_rbtree_iterator* pit = NULL;
+	SG_repo_fetch_dagnodes_handle* pdh = NULL;
+	SG_dagnode* pdn = NULL;
+	SG_dagnode* pdnParent = NULL;
+	SG_dagfrag* pFrag = NULL;
+	char* psz_repo_id = NULL;
+	char* psz_admin_id = NULL;
+	SG_uint32 countPending = 0;
+	SG_bool b = SG_FALSE;
+	const char* pszRefHid = NULL;
+
+	SG_NULLARGCHECK_RETURN(pRepo);
+	SG_NULLARGCHECK_RETURN(prbStartFromHids);
+	SG_NULLARGCHECK_RETURN(pvhHaveSet);
+	SG_NULLARGCHECK_RETURN(ppFrag);
+
+	SG_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvhHaveSet, HAVE_SET_KEY__FLOOR, &i64)  );
+	floorGen = (SG_int32)i64;
+	SG_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvhHaveSet, HAVE_SET_KEY__HASHES, &i64)  );
+	countHashes = (SG_uint32)i64;
+	SG_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvhHaveSet, HAVE_SET_KEY__BITS, &i64)  );
+	countBits = (SG_uint32)i64;
+	SG_ERR_CHECK(  SG_vhash__get__sz(pCtx, pvhHaveSet, HAVE_SET_KEY__FILTER, &pszFilter)  );
+
+	if (!countBits || (countBits % 8) || !countHashes || (countHashes > 32))
+		SG_ERR_THROW2(  SG_ERR_INVALIDARG, (pCtx, "malformed have-set")  );
+
+	SG_ERR_CHECK(  SG_base64__space_needed_for_decode(pCtx, pszFilter, &lenBits)  );
+	if (lenBits < countBits / 8)
+		SG_ERR_THROW2(  SG_ERR_INVALIDARG, (pCtx, "malformed have-set")  );
+	SG_ERR_CHECK(  SG_allocN(pCtx, lenBits, pBits)  );
+	SG_ERR_CHECK(  SG_base64__decode(pCtx, pszFilter, pBits, lenBits, &lenGot)  );
+	if (lenGot != countBits / 8)
+		SG_ERR_THROW2(  SG_ERR_INVALIDARG, (pCtx, "malformed have-set")  );
+
+	SG_ERR_CHECK(  SG_repo__get_repo_id(pCtx, pRepo, &psz_repo_id)  );
+	SG_ERR_CHECK(  SG_repo__get_admin_id(pCtx, pRepo, &psz_admin_id)  );
+	SG_ERR_CHECK(  SG_dagfrag__alloc(pCtx, &pFrag, psz_repo_id, psz_admin_id, iDagNum)  );
+
+	SG_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &prbSeen)  );
+	SG_ERR_CHECK(  SG_VECTOR__ALLOC(pCtx, &pvecPending, 64)  );
+	SG_ERR_CHECK(  SG_repo__fetch_dagnodes__begin(pCtx, pRepo, iDagNum, &pdh)  );
+
+	/* The requested nodes always go in, even if the filter claims the
+	 * other side has them.  That's what guarantees progress when a
+	 * false positive sends the other side back to us for a node. */
+	limitGen = floorGen;
+	SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pit, prbStartFromHids, &b, &pszRefHid, NULL)  );
+	while (b)
+	{
+		SG_int32 gen = 0;
+
+		SG_ERR_CHECK(  SG_repo__fetch_dagnodes__one(pCtx, pRepo, pdh, pszRefHid, &pdn)  );
+		SG_ERR_CHECK(  SG_dagnode__get_generation(pCtx, pdn, &gen)  );
+		if (gen < limitGen)
+			limitGen = gen;
+		SG_ERR_CHECK(  SG_rbtree__add(pCtx, prbSeen, pszRefHid)  );
+		SG_ERR_CHECK(  SG_vector__append(pCtx, pvecPending, pdn, NULL)  );
+		pdn = NULL;
+		SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pit, &b, &pszRefHid, NULL)  );
+	}
+
+	/* Below the floor the filter knows nothing, so all we can do is
+	 * what a best guess would: go back a fixed number of generations
+	 * past the lower of the floor and the requested nodes, and let the
+	 * connect loop ask again if that wasn't enough. */
+	limitGen -= FALLBACK_GENS_PER_ROUNDTRIP;
+
+	SG_ERR_CHECK(  SG_vector__length(pCtx, pvecPending, &countPending)  );
+	while (countPending)
+	{
+		const char** paParents = NULL;
+		SG_uint32 countParents = 0, i;
+
+		SG_ERR_CHECK(  SG_vector__pop_back(pCtx, pvecPending, (void**)&pdn)  );
+
+		SG_ERR_CHECK(  SG_dagnode__get_parents__ref(pCtx, pdn, &countParents, &paParents)  );
+		for (i = 0; i < countParents; i++)
+		{
+			SG_bool bSeen = SG_FALSE;
+			SG_int32 gen = 0;
+
+			SG_ERR_CHECK(  SG_rbtree__find(pCtx, prbSeen, paParents[i], &bSeen, NULL)  );
+			if (bSeen)
+				continue;
+			SG_ERR_CHECK(  SG_rbtree__add(pCtx, prbSeen, paParents[i])  );
+
+			SG_ERR_CHECK(  SG_repo__fetch_dagnodes__one(pCtx, pRepo, pdh, paParents[i], &pdnParent)  );
+			SG_ERR_CHECK(  SG_dagnode__get_generation(pCtx, pdnParent, &gen)  );
+
+			// Stop where the filter says the other side already has the
+			// parent, or where we've gone as deep as one roundtrip should.
+			// Either way the parent is left out and ends up in the end fringe.
+			if (gen < limitGen || _have_set__maybe_has(pBits, countBits, countHashes, paParents[i]))
+				SG_DAGNODE_NULLFREE(pCtx, pdnParent);
+			else
+			{
+				SG_ERR_CHECK(  SG_vector__append(pCtx, pvecPending, pdnParent, NULL)  );
+				pdnParent = NULL;
+			}
+		}
+
+		SG_ERR_CHECK(  SG_dagfrag__add_dagnode(pCtx, pFrag, &pdn)  );
+		SG_ERR_CHECK(  SG_vector__length(pCtx, pvecPending, &countPending)  );
+	}
+
+	*ppFrag = pFrag;
+	pFrag = NULL;
+
+	/* Common cleanup */
+fail:
+	SG_NULLFREE(pCtx, pBits);
+	SG_NULLFREE(pCtx, psz_repo_id);
+	SG_NULLFREE(pCtx, psz_admin_id);
+	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+	SG_RBTREE_NULLFREE(pCtx, prbSeen);
+	SG_VECTOR_NULLFREE_WITH_ASSOC(pCtx, pvecPending, (SG_free_callback*)SG_dagnode__free);
+	SG_DAGNODE_NULLFREE(pCtx, pdn);
+	SG_DAGNODE_NULLFREE(pCtx, pdnParent);
+	SG_DAGFRAG_NULLFREE(pCtx, pFrag);
+	if (pdh)
+		SG_ERR_IGNORE(  SG_repo__fetch_dagnodes__end(pCtx, pRepo, &pdh)  );
+}
+
 void SG_sync__make_temp_path(SG_context* pCtx, const char* psz_name, SG_pathname** ppPath)
 {
 	SG_pathname* pPath_tempdir = NULL;
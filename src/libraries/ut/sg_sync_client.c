@@ -81,6 +81,39 @@ fail:
 	SG_SYNC_CLIENT_NULLFREE(pCtx, pClient);
 }
 
+void SG_sync_client__open__copy(
+	SG_context* pCtx,
+	const SG_sync_client* pClient,
+	SG_sync_client** ppNew)
+{
+	SG_sync_client* pNew = NULL;
+	SG_repo* pRepo = NULL;
+
+	SG_NULLARGCHECK_RETURN(pClient);
+	SG_NULLARGCHECK_RETURN(ppNew);
+
+	if (pClient->pRepoOther)
+	{
+		SG_ERR_CHECK(  SG_repo__open_repo_instance__copy(pCtx, pClient->pRepoOther, &pRepo)  );
+		SG_ERR_CHECK(  SG_sync_client__open__local(pCtx, pRepo, &pNew)  );
+		pNew->bRepoOtherIsMine = SG_TRUE;
+		pRepo = NULL;
+	}
+	else
+	{
+		SG_ERR_CHECK(  SG_sync_client__open(pCtx, pClient->psz_remote_repo_spec,
+			pClient->psz_username, pClient->psz_password, &pNew)  );
+	}
+
+	SG_RETURN_AND_NULL(pNew, ppNew);
+
+	return;
+
+fail:
+	SG_REPO_NULLFREE(pCtx, pRepo);
+	SG_SYNC_CLIENT_NULLFREE(pCtx, pNew);
+}
+
 #define VERIFY_VTABLE(pClient)												\
 	SG_STATEMENT(	SG_NULLARGCHECK_RETURN(pClient);						\
 					if (!(pClient)->p_vtable)								\
@@ -200,11 +233,12 @@ void SG_sync_client__pull_clone(
 	SG_sync_client* pClient,
     SG_vhash* pvh_partial,
 	const SG_pathname* pStagingPathname,
-	char** ppszFragballName)
+	char** ppszFragballName,
+	SG_bool* pbStale)
 {
 	VERIFY_VTABLE(pClient);
 
-	SG_ERR_CHECK_RETURN(  pClient->p_vtable->pull_clone(pCtx, pClient, pvh_partial, pStagingPathname, ppszFragballName)  );
+	SG_ERR_CHECK_RETURN(  pClient->p_vtable->pull_clone(pCtx, pClient, pvh_partial, pStagingPathname, ppszFragballName, pbStale)  );
 }
 
 void SG_sync_client__get_repo_info(
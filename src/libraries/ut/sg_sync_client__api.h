@@ -90,7 +90,8 @@ typedef void FN__sg_sync_client__pull_clone(
 	SG_sync_client* pClient,
     SG_vhash* pvh_partial,
 	const SG_pathname* pStagingPathname,
-	char** ppszFragballName);
+	char** ppszFragballName,
+	SG_bool* pbStale);
 
 typedef void FN__sg_sync_client__get_repo_info(
 	SG_context* pCtx,
@@ -201,19 +201,22 @@ void sg_sync_client__c__pull_clone(
 	SG_sync_client* pClient,
     SG_vhash* pvh_fragball_request,
 	const SG_pathname* pStagingPathname,
-	char** ppszFragballName)
+	char** ppszFragballName,
+	SG_bool* pbStale)
 {
 	SG_repo* pRepo = NULL;
 	SG_vhash* pvhStatus = NULL;
 
 	SG_NULLARGCHECK_RETURN(pClient);
 	SG_NULLARGCHECK_RETURN(ppszFragballName);
+	SG_NULLARGCHECK_RETURN(pbStale);
 
 	SG_ERR_CHECK(  SG_REPO__OPEN_REPO_INSTANCE(pCtx, pClient->psz_remote_repo_spec, &pRepo)  );
 
     SG_UNUSED(pvh_fragball_request);
 
     SG_ERR_CHECK(  SG_repo__fetch_repo__fragball(pCtx, pRepo, 3, pStagingPathname, ppszFragballName) );
+	*pbStale = SG_FALSE; // built just now
 
 	/* fall through */
 fail:
@@ -1087,7 +1087,8 @@ void sg_sync_client__http__pull_clone(
 	SG_sync_client* pSyncClient,
     SG_vhash* pvh_clone_request,
 	const SG_pathname* pStagingPathname,
-	char** ppszFragballName)
+	char** ppszFragballName,
+	SG_bool* pbStale)
 {
 	SG_vhash* pvhRequest = NULL;
 	char* pszFragballName = NULL;
@@ -1098,6 +1099,7 @@ void sg_sync_client__http__pull_clone(
 	SG_ERR_CHECK(  SG_log__push_operation(pCtx, "Requesting repository from server", SG_LOG__FLAG__NONE)  );
 
 	SG_NULLARGCHECK_RETURN(pSyncClient);
+	SG_NULLARGCHECK_RETURN(pbStale);
 
 	SG_ERR_CHECK(  SG_allocN(pCtx, SG_TID_MAX_BUFFER_LENGTH, pszFragballName)  );
 	SG_ERR_CHECK(  SG_tid__generate(pCtx, pszFragballName, SG_TID_MAX_BUFFER_LENGTH)  );
@@ -1117,6 +1119,10 @@ void sg_sync_client__http__pull_clone(
 	SG_ERR_CHECK(  SG_pathname__alloc__pathname_sz(pCtx, &pPathFragball, pStagingPathname, (const char*)pszFragballName)  );
    SG_ERR_CHECK(  do_url(pCtx, pszUrl, "POST", SG_string__sz(pstrRequest), pSyncClient->psz_username, pSyncClient->psz_password, NULL, pPathFragball, SG_TRUE)  );
 
+	/* do_url doesn't give us the response headers, so if we asked to top up,
+	 * assume the server took us up on it. */
+	*pbStale = (pvh_clone_request != NULL);
+
 	SG_RETURN_AND_NULL(pszFragballName, ppszFragballName);
 
 	/* fall through */
@@ -36,6 +36,16 @@ limitations under the License.
 
 #define DOWNLOAD_PROGRESS_MIN_BYTES	1000
 
+/* A fragball download that fails with what looks like a network hiccup is
+ * retried (resumed, where we can) this many times before we give up. */
+#define MAX_DOWNLOAD_ATTEMPTS		5
+
+/* The clone fragball is kept under a fixed name in the staging area, next to the
+ * ETag the server gave it.  That's all we need to resume an interrupted download,
+ * whether it's this attempt or a later one that's given the same staging area. */
+#define CLONE_FRAGBALL_NAME			"clone.fragball"
+#define CLONE_FRAGBALL_ETAG_NAME	"clone.fragball.etag"
+
 //////////////////////////////////////////////////////////////////////////
 
 struct _sg_sync_client_http_push_handle
@@ -136,12 +146,14 @@ static void _pull_clone_progress_callback(
 	double ulnow,
 	void *pVoidState)
 {
+	/* When we're resuming, curl only knows about the rest of the file. */
+	double already = (double)*(SG_uint64*)pVoidState;
+
 	SG_UNUSED(ultotal);
 	SG_UNUSED(ulnow);
-	SG_UNUSED(pVoidState);
 
 	if (dlnow > 0 && dltotal > DOWNLOAD_PROGRESS_MIN_BYTES)
-		SG_ERR_CHECK_RETURN(  _report_transfer_progress(pCtx, "Downloading repository", dlnow, dltotal)  );
+		SG_ERR_CHECK_RETURN(  _report_transfer_progress(pCtx, "Downloading repository", already + dlnow, already + dltotal)  );
 }
 
 static void _push_clone_progress_callback(
@@ -205,6 +217,37 @@ static void _push_progress_callback(
 		SG_ERR_CHECK_RETURN(  _report_transfer_progress(pCtx, NULL, ulnow, ultotal)  );
 }
 
+/**
+ * If the context holds an error that looks like the network dropped out from
+ * under a download, and we haven't already tried too many times, log it, clear
+ * it and return true so the caller can try again.
+ */
+static SG_bool _retry_download(SG_context* pCtx, SG_uint32 attempt)
+{
+	SG_error err = SG_ERR_OK;
+
+	if (!SG_CONTEXT__HAS_ERR(pCtx) || attempt >= MAX_DOWNLOAD_ATTEMPTS)
+		return SG_FALSE;
+
+	(void)SG_context__get_err(pCtx, &err);
+	if (err != SG_ERR_LIBCURL(CURLE_RECV_ERROR)
+		&& err != SG_ERR_LIBCURL(CURLE_SEND_ERROR)
+		&& err != SG_ERR_LIBCURL(CURLE_PARTIAL_FILE)
+		&& err != SG_ERR_LIBCURL(CURLE_OPERATION_TIMEDOUT)
+		&& err != SG_ERR_LIBCURL(CURLE_GOT_NOTHING)
+		&& err != SG_ERR_LIBCURL(CURLE_COULDNT_CONNECT))
+	{
+		return SG_FALSE;
+	}
+
+	SG_context__push_level(pCtx);
+	SG_log__report_verbose(pCtx, "Download interrupted (attempt %u of %u), retrying.", attempt, MAX_DOWNLOAD_ATTEMPTS);
+	SG_context__pop_level(pCtx);
+	SG_context__err_reset(pCtx);
+
+	return SG_TRUE;
+}
+
 static void _curl_reset(SG_context* pCtx, SG_curl* pCurl)
 {
 	SG_ERR_CHECK_RETURN(  SG_curl__reset(pCtx, pCurl)  );
@@ -511,6 +554,7 @@ void sg_sync_client__http__request_fragball(
 	SG_string* pstrRequest = NULL;
 	char* pszUrl = NULL;
 	struct curl_slist* pHeaderList = NULL;
+	SG_uint32 attempt;
 
 	SG_NULLARGCHECK_RETURN(pSyncClient);
 
@@ -523,36 +567,51 @@ void sg_sync_client__http__request_fragball(
 	SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPathFragball, SG_FILE_CREATE_NEW | SG_FILE_WRONLY, 0644, &pFragballFile)  );
 
 	SG_ERR_CHECK(  _get_sync_url(pCtx, pSyncClient->psz_remote_repo_spec, SYNC_URL_SUFFIX FRAGBALL_URL_SUFFIX, NULL, NULL, &pszUrl)  );
-	
-	SG_ERR_CHECK(  _curl_reset(pCtx, pMe->pCurl)  );
-	SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_POST, 1)  );
-	SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_URL, pszUrl)  );
-	if(pSyncClient->psz_username && pSyncClient->psz_password)
-	{
-		SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_HTTPAUTH, CURLAUTH_DIGEST)  );
-		SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_USERNAME, pSyncClient->psz_username)  );
-		SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_PASSWORD, pSyncClient->psz_password)  );
-	}
 
 	if (pvhRequest)
 	{
 		SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstrRequest)  );
 		SG_ERR_CHECK(  SG_vhash__to_json(pCtx, pvhRequest, pstrRequest)  );
-
- 		SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_POSTFIELDS, SG_string__sz(pstrRequest))  );
- 		SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_POSTFIELDSIZE, SG_string__length_in_bytes(pstrRequest))  );
 	}
-	else
+
+	/* These fragballs are generated on the fly, so there's nothing to resume: if the
+	 * download fails we just ask again. */
+	for (attempt = 1; ; attempt++)
 	{
-		SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_POSTFIELDSIZE, 0)  );
-	}
+		SG_ERR_CHECK(  _curl_reset(pCtx, pMe->pCurl)  );
+		SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_POST, 1)  );
+		SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_URL, pszUrl)  );
+		if(pSyncClient->psz_username && pSyncClient->psz_password)
+		{
+			SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_HTTPAUTH, CURLAUTH_DIGEST)  );
+			SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_USERNAME, pSyncClient->psz_username)  );
+			SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_PASSWORD, pSyncClient->psz_password)  );
+		}
 
-	if (bProgressIfPossible)
-		SG_ERR_CHECK(  SG_curl__set__progress_cb(pCtx, pMe->pCurl, _pull_progress_callback, NULL)  );
+		if (pstrRequest)
+		{
+ 			SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_POSTFIELDS, SG_string__sz(pstrRequest))  );
+ 			SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_POSTFIELDSIZE, SG_string__length_in_bytes(pstrRequest))  );
+		}
+		else
+		{
+			SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_POSTFIELDSIZE, 0)  );
+		}
 
-	SG_ERR_CHECK(  SG_curl__set__write_file(pCtx, pMe->pCurl, pFragballFile)  );
+		if (bProgressIfPossible)
+			SG_ERR_CHECK(  SG_curl__set__progress_cb(pCtx, pMe->pCurl, _pull_progress_callback, NULL)  );
+
+		SG_ERR_CHECK(  SG_curl__set__write_file(pCtx, pMe->pCurl, pFragballFile)  );
+
+		SG_curl__perform(pCtx, pMe->pCurl);
+		if (!_retry_download(pCtx, attempt))
+			break;
+
+		SG_ERR_CHECK(  SG_file__seek(pCtx, pFragballFile, 0)  );
+		SG_ERR_CHECK(  SG_file__truncate(pCtx, pFragballFile)  );
+	}
+	SG_ERR_CHECK_CURRENT;
 
-	SG_ERR_CHECK(  SG_curl__perform(pCtx, pMe->pCurl)  );
 	SG_ERR_CHECK(  SG_curl__throw_on_non200(pCtx, pMe->pCurl)  );
 
 	SG_RETURN_AND_NULL(pszFragballName, ppszFragballName);
@@ -567,48 +626,67 @@ fail:
 	SG_CURL_HEADERS_NULLFREE(pCtx, pHeaderList);
 }
 
+/**
+ * Read the ETag we saved for a partially downloaded clone fragball.
+ * Sets *ppszETag to NULL if there isn't one.
+ */
+static void _read_clone_etag(SG_context* pCtx, const SG_pathname* pPathETag, char** ppszETag)
+{
+	SG_bool bExists = SG_FALSE;
+	SG_string* pstrETag = NULL;
+
+	*ppszETag = NULL;
+
+	SG_ERR_CHECK(  SG_fsobj__exists__pathname(pCtx, pPathETag, &bExists, NULL, NULL)  );
+	if (bExists)
+	{
+		SG_ERR_CHECK(  SG_file__read_into_string(pCtx, pPathETag, &pstrETag)  );
+		if (SG_string__length_in_bytes(pstrETag))
+			SG_ERR_CHECK(  SG_STRDUP(pCtx, SG_string__sz(pstrETag), ppszETag)  );
+	}
+
+	/* fall through */
+fail:
+	SG_STRING_NULLFREE(pCtx, pstrETag);
+}
+
 void sg_sync_client__http__pull_clone(
 	SG_context* pCtx,
 	SG_sync_client* pSyncClient,
     SG_vhash* pvh_clone_request,
 	const SG_pathname* pStagingPathname,
-	char** ppszFragballName)
+	char** ppszFragballName,
+	SG_bool* pbStale)
 {
 	sg_client_http_instance_data* pMe = NULL;
 	SG_vhash* pvhRequest = NULL;
-	char* pszFragballName = NULL;
 	SG_pathname* pPathFragball = NULL;
+	SG_pathname* pPathETag = NULL;
+	char* pszStale = NULL;
 	SG_file* pFragballFile = NULL;
 	SG_string* pstrRequest = NULL;
 	char* pszUrl = NULL;
+	char* pszETag = NULL;
+	SG_string* pstrHeader = NULL;
+	SG_varray* pvaHeaders = NULL;
 	struct curl_slist* pHeaderList = NULL;
 	SG_int32 httpResponseCode = 0;
+	SG_uint64 lenHave = 0;
+	SG_uint32 attempt;
 
 	SG_ERR_CHECK(  SG_log__push_operation(pCtx, "Waiting for server to start transfer", SG_LOG__FLAG__NONE)  );
 
 	SG_NULLARGCHECK_RETURN(pSyncClient);
+	SG_NULLARGCHECK_RETURN(pbStale);
 
 	pMe = (sg_client_http_instance_data*)pSyncClient->p_vtable_instance_data;
 
-	SG_ERR_CHECK(  SG_allocN(pCtx, SG_TID_MAX_BUFFER_LENGTH, pszFragballName)  );
-	SG_ERR_CHECK(  SG_tid__generate(pCtx, pszFragballName, SG_TID_MAX_BUFFER_LENGTH)  );
-
-	SG_ERR_CHECK(  SG_pathname__alloc__pathname_sz(pCtx, &pPathFragball, pStagingPathname, (const char*)pszFragballName)  );
-	SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPathFragball, SG_FILE_CREATE_NEW | SG_FILE_WRONLY, 0644, &pFragballFile)  );
+	SG_ERR_CHECK(  SG_pathname__alloc__pathname_sz(pCtx, &pPathFragball, pStagingPathname, CLONE_FRAGBALL_NAME)  );
+	SG_ERR_CHECK(  SG_pathname__alloc__pathname_sz(pCtx, &pPathETag, pStagingPathname, CLONE_FRAGBALL_ETAG_NAME)  );
+	SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPathFragball, SG_FILE_OPEN_OR_CREATE | SG_FILE_WRONLY, 0644, &pFragballFile)  );
 
 	SG_ERR_CHECK(  _get_sync_url(pCtx, pSyncClient->psz_remote_repo_spec, SYNC_URL_SUFFIX FRAGBALL_URL_SUFFIX, NULL, NULL, &pszUrl)  );
 
-	SG_ERR_CHECK(  _curl_reset(pCtx, pMe->pCurl)  );
-	
-	SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_POST, 1)  );
-	SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_URL, pszUrl)  );
-	if(pSyncClient->psz_username && pSyncClient->psz_password)
-	{
-		SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_HTTPAUTH, CURLAUTH_DIGEST)  );
-		SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_USERNAME, pSyncClient->psz_username)  );
-		SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_PASSWORD, pSyncClient->psz_password)  );
-	}
-
 	SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvhRequest)  );
 	SG_ERR_CHECK(  SG_vhash__add__null(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__CLONE)  );
     if (pvh_clone_request)
@@ -618,30 +696,101 @@ void sg_sync_client__http__pull_clone(
 	SG_ERR_CHECK(  SG_STRING__ALLOC__RESERVE(pCtx, &pstrRequest, 50)  );
 	SG_ERR_CHECK(  SG_vhash__to_json(pCtx, pvhRequest, pstrRequest)  );
 
-	SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_POSTFIELDS, SG_string__sz(pstrRequest))  );
-	SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_POSTFIELDSIZE, SG_string__length_in_bytes(pstrRequest))  );
+	for (attempt = 1; ; attempt++)
+	{
+		/* Whatever we already have (from an earlier attempt, or an earlier run) we
+		 * ask the server not to send again.  If what it has now isn't what we
+		 * started downloading, If-Range makes it send the whole thing instead. */
+		SG_NULLFREE(pCtx, pszETag);
+		SG_ERR_CHECK(  SG_file__seek_end(pCtx, pFragballFile, &lenHave)  );
+		if (lenHave)
+			SG_ERR_CHECK(  _read_clone_etag(pCtx, pPathETag, &pszETag)  );
+		if (!pszETag && lenHave)
+		{
+			SG_ERR_CHECK(  SG_file__seek(pCtx, pFragballFile, 0)  );
+			SG_ERR_CHECK(  SG_file__truncate(pCtx, pFragballFile)  );
+			lenHave = 0;
+		}
 
-	SG_ERR_CHECK(  SG_curl__set__progress_cb(pCtx, pMe->pCurl, _pull_clone_progress_callback, NULL)  );
-	SG_ERR_CHECK(  SG_curl__set__write_file(pCtx, pMe->pCurl, pFragballFile)  );
+		SG_ERR_CHECK(  _curl_reset(pCtx, pMe->pCurl)  );
+		SG_CURL_HEADERS_NULLFREE(pCtx, pHeaderList);
 
-	SG_ERR_CHECK(  SG_curl__perform(pCtx, pMe->pCurl)  );
+		SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_POST, 1)  );
+		SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_URL, pszUrl)  );
+		if(pSyncClient->psz_username && pSyncClient->psz_password)
+		{
+			SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_HTTPAUTH, CURLAUTH_DIGEST)  );
+			SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_USERNAME, pSyncClient->psz_username)  );
+			SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_PASSWORD, pSyncClient->psz_password)  );
+		}
+
+		SG_ERR_CHECK(  SG_curl__setopt__sz(pCtx, pMe->pCurl, CURLOPT_POSTFIELDS, SG_string__sz(pstrRequest))  );
+		SG_ERR_CHECK(  SG_curl__setopt__int32(pCtx, pMe->pCurl, CURLOPT_POSTFIELDSIZE, SG_string__length_in_bytes(pstrRequest))  );
+
+		if (pszETag)
+		{
+			SG_int_to_string_buffer bufHave;
+
+			SG_ERR_CHECK(  SG_VARRAY__ALLOC(pCtx, &pvaHeaders)  );
+			SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstrHeader)  );
+			SG_ERR_CHECK(  SG_string__sprintf(pCtx, pstrHeader, "Range: bytes=%s-", SG_uint64_to_sz(lenHave, bufHave))  );
+			SG_ERR_CHECK(  SG_varray__append__string__sz(pCtx, pvaHeaders, SG_string__sz(pstrHeader))  );
+			SG_ERR_CHECK(  SG_string__sprintf(pCtx, pstrHeader, "If-Range: %s", pszETag)  );
+			SG_ERR_CHECK(  SG_varray__append__string__sz(pCtx, pvaHeaders, SG_string__sz(pstrHeader))  );
+			SG_ERR_CHECK(  SG_curl__set_headers_from_varray(pCtx, pMe->pCurl, pvaHeaders, &pHeaderList)  );
+			SG_VARRAY_NULLFREE(pCtx, pvaHeaders);
+			SG_STRING_NULLFREE(pCtx, pstrHeader);
+		}
+
+		SG_ERR_CHECK(  SG_curl__set__progress_cb(pCtx, pMe->pCurl, _pull_clone_progress_callback, &lenHave)  );
+		SG_ERR_CHECK(  SG_curl__set__resume_file(pCtx, pMe->pCurl, pFragballFile, pPathETag)  );
+
+		SG_curl__perform(pCtx, pMe->pCurl);
+
+		/* A 416 means we already have as much as the server does.  Rather
+		 * than trust that it's all there, start over without a Range. */
+		if (!SG_CONTEXT__HAS_ERR(pCtx) && lenHave && attempt < MAX_DOWNLOAD_ATTEMPTS)
+		{
+			SG_ERR_CHECK(  SG_curl__getinfo__int32(pCtx, pMe->pCurl, CURLINFO_RESPONSE_CODE, &httpResponseCode)  );
+			if (httpResponseCode == 416)
+			{
+				SG_ERR_CHECK(  SG_file__seek(pCtx, pFragballFile, 0)  );
+				SG_ERR_CHECK(  SG_file__truncate(pCtx, pFragballFile)  );
+				continue;
+			}
+		}
+
+		if (!_retry_download(pCtx, attempt))
+			break;
+	}
+	SG_ERR_CHECK_CURRENT;
 
 	SG_ERR_CHECK(  SG_curl__getinfo__int32(pCtx, pMe->pCurl, CURLINFO_RESPONSE_CODE, &httpResponseCode)  );
 	if (httpResponseCode == 404)
 		SG_ERR_RESET_THROW2(SG_ERR_NOTAREPOSITORY, (pCtx, "%s", pSyncClient->psz_remote_repo_spec));
 
-	SG_ERR_CHECK(  SG_curl__throw_on_non200(pCtx, pMe->pCurl)  );
+	if (httpResponseCode != 206)
+		SG_ERR_CHECK(  SG_curl__throw_on_non200(pCtx, pMe->pCurl)  );
 
-	SG_RETURN_AND_NULL(pszFragballName, ppszFragballName);
+	/* A 206 is the rest of the same file (If-Range saw to that), and the
+	 * server says the same thing about it every time. */
+	SG_ERR_CHECK(  SG_curl__get_response_header(pCtx, pMe->pCurl, SG_SYNC_CLONE_HEADER__STALE, &pszStale)  );
+	*pbStale = (pszStale && 0 != strcmp(pszStale, "0"));
+
+	SG_ERR_CHECK(  SG_STRDUP(pCtx, CLONE_FRAGBALL_NAME, ppszFragballName)  );
 
 	/* fall through */
 fail:
 	SG_log__pop_operation(pCtx);
-	SG_NULLFREE(pCtx, pszFragballName);
 	SG_VHASH_NULLFREE(pCtx, pvhRequest);
 	SG_PATHNAME_NULLFREE(pCtx, pPathFragball);
+	SG_PATHNAME_NULLFREE(pCtx, pPathETag);
 	SG_FILE_NULLCLOSE(pCtx, pFragballFile);
 	SG_NULLFREE(pCtx, pszUrl);
+	SG_NULLFREE(pCtx, pszETag);
+	SG_NULLFREE(pCtx, pszStale);
+	SG_STRING_NULLFREE(pCtx, pstrHeader);
+	SG_VARRAY_NULLFREE(pCtx, pvaHeaders);
 	SG_STRING_NULLFREE(pCtx, pstrRequest);
 	SG_CURL_HEADERS_NULLFREE(pCtx, pHeaderList);
 }
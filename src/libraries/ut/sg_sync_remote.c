@@ -18,6 +18,16 @@ limitations under the License.
 
 #define TRACE_SYNC_REMOTE 0
 
+#define sg_CLONE_FRAGBALL__PREFIX					"clone-"
+#define sg_CLONE_FRAGBALL__LOCK_SUFFIX				".lock"
+#define sg_CLONE_FRAGBALL__LEASE_SUFFIX				".lease"
+#define sg_CLONE_FRAGBALL__DEFAULT_CACHE_MB			4096
+#define sg_CLONE_FRAGBALL__DEFAULT_TOPUP_SECONDS	600
+#define sg_CLONE_FRAGBALL__DEFAULT_LOCK_WAIT_SECONDS	60
+#define sg_CLONE_FRAGBALL__DEFAULT_STALE_LOCK_SECONDS	(60 * 60)
+#define sg_CLONE_FRAGBALL__LOCK_POLL_MS				250
+#define sg_CLONE_FRAGBALL__LEASE_MS					(5 * 60 * 1000)
+
 void SG_sync_remote__get_staging_path(SG_context* pCtx, const char* pszPushId, SG_pathname** ppStagingPathname)
 {
 	SG_NULLARGCHECK_RETURN(ppStagingPathname);
@@ -337,6 +347,726 @@ fail:
     SG_IHASH_NULLFREE(pCtx, pih_new);
 }
 
+/**
+ * Clone fragballs for one repo instance all start with this.  Several repos on
+ * one server can share a repo id (they're clones of each other), so it's a hash
+ * of the instance key rather than the repo id.
+ */
+static void _get_clone_fragball_prefix(
+	SG_context* pCtx,
+	SG_repo* pRepo,
+	SG_string** ppstrPrefix)
+{
+	const char* pszInstanceKey = NULL;
+	char* pszHash = NULL;
+	SG_string* pstrPrefix = NULL;
+
+	SG_ERR_CHECK(  SG_repo__get_instance_key(pCtx, pRepo, &pszInstanceKey)  );
+	SG_ERR_CHECK(  SG_repo__alloc_compute_hash__from_bytes(pCtx, pRepo,
+		SG_STRLEN(pszInstanceKey), (const SG_byte*)pszInstanceKey, &pszHash)  );
+
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstrPrefix)  );
+	SG_ERR_CHECK(  SG_string__sprintf(pCtx, pstrPrefix, sg_CLONE_FRAGBALL__PREFIX "%s-", pszHash)  );
+
+	SG_RETURN_AND_NULL(pstrPrefix, ppstrPrefix);
+
+	/* fall through */
+fail:
+	SG_NULLFREE(pCtx, pszHash);
+	SG_STRING_NULLFREE(pCtx, pstrPrefix);
+}
+
+/**
+ * The name a clone fragball gets in the fragball directory: the prefix for the
+ * repo instance and a hash of the leaves of every dag.  Two clone fragballs with
+ * the same name describe the same state of the same repo.
+ */
+static void _get_clone_fragball_name(
+	SG_context* pCtx,
+	SG_repo* pRepo,
+	const char* pszPrefix,
+	SG_uint32 version,
+	SG_string** ppstrName)
+{
+	char* pszHash = NULL;
+	SG_rbtree* prbDagnums = NULL;
+	SG_rbtree* prbLeaves = NULL;
+	SG_rbtree_iterator* pitDags = NULL;
+	SG_rbtree_iterator* pitLeaves = NULL;
+	SG_string* pstrState = NULL;
+	SG_string* pstrName = NULL;
+	const char* pszDagnum = NULL;
+	const char* pszLeaf = NULL;
+	SG_bool bDag, bLeaf;
+
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstrState)  );
+	SG_ERR_CHECK(  SG_string__sprintf(pCtx, pstrState, "%u\n", version)  );
+
+	SG_ERR_CHECK(  SG_repo__list_dags__rbtree(pCtx, pRepo, &prbDagnums)  );
+	SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pitDags, prbDagnums, &bDag, &pszDagnum, NULL)  );
+	while (bDag)
+	{
+		SG_uint64 iDagnum = 0;
+
+		SG_ERR_CHECK(  SG_dagnum__from_sz__hex(pCtx, pszDagnum, &iDagnum)  );
+		SG_ERR_CHECK(  SG_repo__fetch_dag_leaves(pCtx, pRepo, iDagnum, &prbLeaves)  );
+
+		SG_ERR_CHECK(  SG_string__append__format(pCtx, pstrState, "%s:", pszDagnum)  );
+		if (prbLeaves)
+		{
+			SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pitLeaves, prbLeaves, &bLeaf, &pszLeaf, NULL)  );
+			while (bLeaf)
+			{
+				SG_ERR_CHECK(  SG_string__append__format(pCtx, pstrState, " %s", pszLeaf)  );
+				SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pitLeaves, &bLeaf, &pszLeaf, NULL)  );
+			}
+			SG_RBTREE_ITERATOR_NULLFREE(pCtx, pitLeaves);
+			SG_RBTREE_NULLFREE(pCtx, prbLeaves);
+		}
+		SG_ERR_CHECK(  SG_string__append__sz(pCtx, pstrState, "\n")  );
+
+		SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pitDags, &bDag, &pszDagnum, NULL)  );
+	}
+
+	SG_ERR_CHECK(  SG_repo__alloc_compute_hash__from_string(pCtx, pRepo, pstrState, &pszHash)  );
+
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstrName)  );
+	SG_ERR_CHECK(  SG_string__sprintf(pCtx, pstrName, "%s%s", pszPrefix, pszHash)  );
+
+	SG_RETURN_AND_NULL(pstrName, ppstrName);
+
+	/* fall through */
+fail:
+	SG_NULLFREE(pCtx, pszHash);
+	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pitDags);
+	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pitLeaves);
+	SG_RBTREE_NULLFREE(pCtx, prbDagnums);
+	SG_RBTREE_NULLFREE(pCtx, prbLeaves);
+	SG_STRING_NULLFREE(pCtx, pstrState);
+	SG_STRING_NULLFREE(pCtx, pstrName);
+}
+
+static SG_bool _has_suffix(const char* pszName, const char* pszSuffix)
+{
+	size_t len = strlen(pszName);
+	size_t lenSuffix = strlen(pszSuffix);
+
+	return (len > lenSuffix) && (0 == strcmp(pszName + len - lenSuffix, pszSuffix));
+}
+
+/**
+ * The lock and lease files live next to the fragballs and share their prefix.
+ */
+static SG_bool _is_clone_fragball(const char* pszName)
+{
+	return !_has_suffix(pszName, sg_CLONE_FRAGBALL__LOCK_SUFFIX)
+		&& !_has_suffix(pszName, sg_CLONE_FRAGBALL__LEASE_SUFFIX);
+}
+
+static void _alloc_clone_fragball_sibling(
+	SG_context* pCtx,
+	const SG_pathname* pFragballDirPathname,
+	const char* pszName,
+	const char* pszSuffix,
+	SG_pathname** ppPath)
+{
+	SG_string* pstr = NULL;
+
+	SG_ERR_CHECK(  SG_STRING__ALLOC__SZ(pCtx, &pstr, pszName)  );
+	SG_ERR_CHECK(  SG_string__append__sz(pCtx, pstr, pszSuffix)  );
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, ppPath, pFragballDirPathname, SG_string__sz(pstr))  );
+
+	/* fall through */
+fail:
+	SG_STRING_NULLFREE(pCtx, pstr);
+}
+
+/**
+ * Try to lock the named clone fragball: to build it, to lease it or to remove it.
+ * The lock is a file next to it, created exclusively, so it works across server
+ * processes as well as threads.  A lock left behind by a server that died while
+ * building is broken once it's older than stale_ms.
+ */
+static void _try_lock_clone_fragball(
+	SG_context* pCtx,
+	const SG_pathname* pPathLock,
+	SG_int64 stale_ms,
+	SG_bool* pbLocked)
+{
+	SG_file* pFile = NULL;
+	SG_fsobj_stat st;
+	SG_int64 now = 0;
+
+	*pbLocked = SG_FALSE;
+
+	SG_file__open__pathname(pCtx, pPathLock, SG_FILE_WRONLY|SG_FILE_CREATE_NEW, 0644, &pFile);
+	if (!SG_CONTEXT__HAS_ERR(pCtx))
+	{
+		*pbLocked = SG_TRUE;
+		SG_FILE_NULLCLOSE(pCtx, pFile);
+		return;
+	}
+	SG_context__err_reset(pCtx);
+
+	SG_fsobj__stat__pathname(pCtx, pPathLock, &st);
+	if (SG_CONTEXT__HAS_ERR(pCtx))
+	{
+		// released while we were looking; the caller will try again
+		SG_context__err_reset(pCtx);
+		return;
+	}
+
+	SG_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &now)  );
+	if (now - st.mtime_ms > stale_ms)
+		SG_ERR_IGNORE(  SG_fsobj__remove__pathname(pCtx, pPathLock)  );
+
+	/* fall through */
+fail:
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+}
+
+/**
+ * Note that we're about to hand out the named clone fragball.  Until the request
+ * that gets it has had time to open it, _trim_clone_fragball_cache leaves it be.
+ * (Once it's open, removing it does no harm where that's allowed at all.)
+ * The caller must hold the fragball's lock.
+ */
+static void _write_clone_fragball_lease(
+	SG_context* pCtx,
+	const SG_pathname* pFragballDirPathname,
+	const char* pszName)
+{
+	SG_pathname* pPathLease = NULL;
+	SG_file* pFile = NULL;
+	SG_int64 now = 0;
+	SG_int_to_string_buffer bufNow;
+
+	SG_ERR_CHECK(  _alloc_clone_fragball_sibling(pCtx, pFragballDirPathname, pszName, sg_CLONE_FRAGBALL__LEASE_SUFFIX, &pPathLease)  );
+
+	/* Writing something is what's sure to update the mtime. */
+	SG_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &now)  );
+	SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPathLease, SG_FILE_WRONLY | SG_FILE_OPEN_OR_CREATE | SG_FILE_TRUNC, 0644, &pFile)  );
+	SG_ERR_CHECK(  SG_file__write__sz(pCtx, pFile, SG_int64_to_sz(now, bufNow))  );
+	SG_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+
+	/* fall through */
+fail:
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+	SG_PATHNAME_NULLFREE(pCtx, pPathLease);
+}
+
+/**
+ * Lease an existing clone fragball (see _write_clone_fragball_lease).  Sets
+ * *pbLeased to false if a trim removed it before we got the lock, or if we
+ * couldn't get the lock by deadline_ms.
+ */
+static void _lease_clone_fragball(
+	SG_context* pCtx,
+	const SG_pathname* pFragballDirPathname,
+	const char* pszName,
+	SG_int64 stale_ms,
+	SG_int64 deadline_ms,
+	SG_bool* pbLeased)
+{
+	SG_pathname* pPathLock = NULL;
+	SG_pathname* pPathFragball = NULL;
+	SG_bool bLocked = SG_FALSE;
+	SG_bool bExists = SG_FALSE;
+
+	*pbLeased = SG_FALSE;
+
+	SG_ERR_CHECK(  _alloc_clone_fragball_sibling(pCtx, pFragballDirPathname, pszName, sg_CLONE_FRAGBALL__LOCK_SUFFIX, &pPathLock)  );
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathFragball, pFragballDirPathname, pszName)  );
+
+	while (1)
+	{
+		SG_int64 now = 0;
+
+		SG_ERR_CHECK(  _try_lock_clone_fragball(pCtx, pPathLock, stale_ms, &bLocked)  );
+		if (bLocked)
+			break;
+		SG_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &now)  );
+		if (now >= deadline_ms)
+			goto fail;
+		SG_sleep_ms(sg_CLONE_FRAGBALL__LOCK_POLL_MS);
+	}
+
+	SG_ERR_CHECK(  SG_fsobj__exists__pathname(pCtx, pPathFragball, &bExists, NULL, NULL)  );
+	if (bExists)
+	{
+		SG_ERR_CHECK(  _write_clone_fragball_lease(pCtx, pFragballDirPathname, pszName)  );
+		*pbLeased = SG_TRUE;
+	}
+
+	/* fall through */
+fail:
+	if (bLocked)
+		SG_ERR_IGNORE(  SG_fsobj__remove__pathname(pCtx, pPathLock)  );
+	SG_PATHNAME_NULLFREE(pCtx, pPathLock);
+	SG_PATHNAME_NULLFREE(pCtx, pPathFragball);
+}
+
+/**
+ * Is the named clone fragball leased to a request that may not have opened it yet?
+ */
+static void _is_clone_fragball_leased(
+	SG_context* pCtx,
+	const SG_pathname* pFragballDirPathname,
+	const char* pszName,
+	SG_int64 now,
+	SG_bool* pbLeased)
+{
+	SG_pathname* pPathLease = NULL;
+	SG_fsobj_stat st;
+
+	*pbLeased = SG_FALSE;
+
+	SG_ERR_CHECK(  _alloc_clone_fragball_sibling(pCtx, pFragballDirPathname, pszName, sg_CLONE_FRAGBALL__LEASE_SUFFIX, &pPathLease)  );
+
+	SG_fsobj__stat__pathname(pCtx, pPathLease, &st);
+	if (SG_CONTEXT__HAS_ERR(pCtx))
+		SG_context__err_reset(pCtx); // never leased
+	else
+		*pbLeased = (now - st.mtime_ms <= sg_CLONE_FRAGBALL__LEASE_MS);
+
+	/* fall through */
+fail:
+	SG_PATHNAME_NULLFREE(pCtx, pPathLease);
+}
+
+/**
+ * Remove one clone fragball from the cache, unless it's in use.  *pLenRemoved
+ * is how many bytes that freed.
+ */
+static void _evict_clone_fragball(
+	SG_context* pCtx,
+	const SG_pathname* pFragballDirPathname,
+	const char* pszName,
+	SG_int64 now,
+	SG_int64 stale_ms,
+	SG_uint64* pLenRemoved)
+{
+	SG_pathname* pPathLock = NULL;
+	SG_pathname* pPathLease = NULL;
+	SG_pathname* pPathFragball = NULL;
+	SG_bool bLocked = SG_FALSE;
+	SG_bool bLeased = SG_FALSE;
+	SG_uint64 len = 0;
+
+	*pLenRemoved = 0;
+
+	/* Whoever holds the lock is leasing it; don't wait for them. */
+	SG_ERR_CHECK(  _alloc_clone_fragball_sibling(pCtx, pFragballDirPathname, pszName, sg_CLONE_FRAGBALL__LOCK_SUFFIX, &pPathLock)  );
+	SG_ERR_CHECK(  _try_lock_clone_fragball(pCtx, pPathLock, stale_ms, &bLocked)  );
+	if (!bLocked)
+		goto fail;
+
+	SG_ERR_CHECK(  _is_clone_fragball_leased(pCtx, pFragballDirPathname, pszName, now, &bLeased)  );
+	if (bLeased)
+		goto fail;
+
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathFragball, pFragballDirPathname, pszName)  );
+	SG_fsobj__length__pathname(pCtx, pPathFragball, &len, NULL);
+	if (!SG_CONTEXT__HAS_ERR(pCtx))
+		SG_fsobj__remove__pathname(pCtx, pPathFragball);
+	if (SG_CONTEXT__HAS_ERR(pCtx))
+	{
+		// already gone, or still being sent
+		SG_context__err_reset(pCtx);
+		goto fail;
+	}
+	*pLenRemoved = len;
+
+	SG_ERR_CHECK(  _alloc_clone_fragball_sibling(pCtx, pFragballDirPathname, pszName, sg_CLONE_FRAGBALL__LEASE_SUFFIX, &pPathLease)  );
+	SG_ERR_IGNORE(  SG_fsobj__remove__pathname(pCtx, pPathLease)  );
+
+	/* fall through */
+fail:
+	if (bLocked)
+		SG_ERR_IGNORE(  SG_fsobj__remove__pathname(pCtx, pPathLock)  );
+	SG_PATHNAME_NULLFREE(pCtx, pPathLock);
+	SG_PATHNAME_NULLFREE(pCtx, pPathLease);
+	SG_PATHNAME_NULLFREE(pCtx, pPathFragball);
+}
+
+/**
+ * Read one of the server/clone_cache settings.  Like the other server settings,
+ * a bad value is logged and the default is used.  An empty one is the same as
+ * one that isn't set.
+ */
+static void _get_clone_cache_setting(
+	SG_context* pCtx,
+	const char* pszSetting,
+	SG_uint32 valDefault,
+	SG_uint32* pVal)
+{
+	char* pszValue = NULL;
+	SG_uint32 val = valDefault;
+
+	SG_localsettings__get__sz(pCtx, pszSetting, NULL, &pszValue, NULL);
+	if (!SG_context__has_err(pCtx) && pszValue != NULL && *pszValue)
+		SG_uint32__parse__strict(pCtx, &val, pszValue);
+	if (SG_context__has_err(pCtx))
+	{
+		SG_log__report_error__current_error(pCtx);
+		SG_context__err_reset(pCtx);
+		val = valDefault;
+	}
+
+	SG_NULLFREE(pCtx, pszValue);
+	*pVal = val;
+}
+
+/**
+ * Find the most recently built clone fragball for this repo, whatever state it
+ * describes.  *ppszName is NULL if there isn't one.
+ */
+static void _find_newest_clone_fragball(
+	SG_context* pCtx,
+	const SG_pathname* pFragballDirPathname,
+	const char* pszPrefix,
+	char** ppszName,
+	SG_int64* pmtime_ms)
+{
+	SG_rbtree* prb = NULL;
+	SG_rbtree_iterator* pit = NULL;
+	const char* pszName = NULL;
+	const char* pszNewest = NULL;
+	SG_int64 mtime_newest = 0;
+	SG_bool b = SG_FALSE;
+
+	*ppszName = NULL;
+
+	SG_ERR_CHECK(  SG_dir__list(pCtx, pFragballDirPathname, pszPrefix, NULL, NULL, &prb)  );
+	if (prb)
+	{
+		SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pit, prb, &b, &pszName, NULL)  );
+		while (b)
+		{
+			SG_fsobj_stat st;
+
+			if (_is_clone_fragball(pszName))
+			{
+				SG_fsobj__stat__pathname_sz(pCtx, pFragballDirPathname, pszName, &st);
+				if (SG_CONTEXT__HAS_ERR(pCtx))
+				{
+					// evicted while we were looking
+					SG_context__err_reset(pCtx);
+				}
+				else if (!pszNewest || st.mtime_ms > mtime_newest)
+				{
+					pszNewest = pszName;
+					mtime_newest = st.mtime_ms;
+				}
+			}
+			SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pit, &b, &pszName, NULL)  );
+		}
+	}
+
+	if (pszNewest)
+	{
+		SG_ERR_CHECK(  SG_STRDUP(pCtx, pszNewest, ppszName)  );
+		*pmtime_ms = mtime_newest;
+	}
+
+	/* fall through */
+fail:
+	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+	SG_RBTREE_NULLFREE(pCtx, prb);
+}
+
+/**
+ * Keep the clone fragballs in the fragball directory, for all repos, under the
+ * configured size by removing the oldest ones first.  pszKeep is the one we're
+ * about to send, so it stays regardless, as do any others that were handed out
+ * recently enough that they might not be open yet.  A fragball that's still
+ * being sent may not be removable yet; we'll get it next time.
+ */
+static void _trim_clone_fragball_cache(
+	SG_context* pCtx,
+	const SG_pathname* pFragballDirPathname,
+	const char* pszKeep)
+{
+	SG_rbtree* prbNames = NULL;
+	SG_rbtree* prbByAge = NULL;
+	SG_rbtree_iterator* pit = NULL;
+	SG_string* pstrKey = NULL;
+	const char* pszName = NULL;
+	const char* pszKey = NULL;
+	SG_uint32 max_mb = 0;
+	SG_uint32 stale_lock_seconds = 0;
+	SG_uint64 total = 0;
+	SG_uint64 limit = 0;
+	SG_int64 now = 0;
+	SG_bool b = SG_FALSE;
+
+	SG_ERR_CHECK(  _get_clone_cache_setting(pCtx, SG_LOCALSETTING__SERVER_CLONE_CACHE_SIZE, sg_CLONE_FRAGBALL__DEFAULT_CACHE_MB, &max_mb)  );
+	limit = (SG_uint64)max_mb * 1024 * 1024;
+	SG_ERR_CHECK(  _get_clone_cache_setting(pCtx, SG_LOCALSETTING__SERVER_CLONE_CACHE_STALE_LOCK_SECONDS, sg_CLONE_FRAGBALL__DEFAULT_STALE_LOCK_SECONDS, &stale_lock_seconds)  );
+
+	SG_ERR_CHECK(  SG_dir__list(pCtx, pFragballDirPathname, sg_CLONE_FRAGBALL__PREFIX, NULL, NULL, &prbNames)  );
+	if (!prbNames)
+		return;
+
+	/* Sort them oldest first.  The key is the mtime, zero-padded so the rbtree's
+	 * string order is numeric order, then the name to keep keys unique. */
+	SG_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &prbByAge)  );
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstrKey)  );
+	SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pit, prbNames, &b, &pszName, NULL)  );
+	while (b)
+	{
+		SG_fsobj_stat st;
+
+		if (_is_clone_fragball(pszName))
+		{
+			SG_fsobj__stat__pathname_sz(pCtx, pFragballDirPathname, pszName, &st);
+			if (SG_CONTEXT__HAS_ERR(pCtx))
+			{
+				SG_context__err_reset(pCtx);
+			}
+			else
+			{
+				total += st.size;
+				if (0 != strcmp(pszName, pszKeep))
+				{
+					SG_ERR_CHECK(  SG_string__sprintf(pCtx, pstrKey, "%020lld %s", (long long)st.mtime_ms, pszName)  );
+					SG_ERR_CHECK(  SG_rbtree__add(pCtx, prbByAge, SG_string__sz(pstrKey))  );
+				}
+			}
+		}
+		SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pit, &b, &pszName, NULL)  );
+	}
+	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+
+	if (total > limit)
+	{
+		SG_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &now)  );
+		SG_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pit, prbByAge, &b, &pszKey, NULL)  );
+		while (b && total > limit)
+		{
+			SG_uint64 len = 0;
+
+			SG_ERR_CHECK(  _evict_clone_fragball(pCtx, pFragballDirPathname, strchr(pszKey, ' ') + 1, now, (SG_int64)stale_lock_seconds * 1000, &len)  );
+			total -= len;
+
+			SG_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pit, &b, &pszKey, NULL)  );
+		}
+	}
+
+	/* fall through */
+fail:
+	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+	SG_RBTREE_NULLFREE(pCtx, prbNames);
+	SG_RBTREE_NULLFREE(pCtx, prbByAge);
+	SG_STRING_NULLFREE(pCtx, pstrKey);
+}
+
+/**
+ * Get a clone fragball for the repo.
+ *
+ * Clone fragballs are kept around after they're sent, under a name that
+ * identifies the state of the repo they describe (see _get_clone_fragball_name),
+ * which makes the fragball directory a cache of them:
+ *
+ * - A request for a state that's already cached just gets that file.  A client
+ *   whose download was interrupted can ask for the rest of the same file (see
+ *   the Range handling in sync.js).
+ *
+ * - If the client said it will top up (by pulling after the clone), any cached
+ *   fragball for this repo that's younger than server/clone_cache/topup_seconds
+ *   will do, even if the repo has moved on since it was built.  *pbStale is set
+ *   when that's what we're sending, so the client knows the pull is needed.
+ *
+ * - Otherwise one request builds it, and concurrent requests for the same state
+ *   wait for that rather than building their own.  They wait at most
+ *   server/clone_cache/lock_wait_seconds.  After that a request builds its own,
+ *   under a name of its own, without the lock.
+ *
+ * The cache is bounded by server/clone_cache/max_mb, oldest out first.  Each
+ * fragball we hand out gets a lease, taken under its lock, so that a trim for
+ * another request doesn't remove it before the request that asked for it has
+ * opened it.
+ */
+static void _get_clone_fragball(
+	SG_context* pCtx,
+	SG_repo* pRepo,
+	const SG_pathname* pFragballDirPathname,
+	SG_bool bTopUp,
+	char** ppszFragballName,
+	SG_bool* pbStale)
+{
+	SG_string* pstrName = NULL;
+	SG_string* pstrLock = NULL;
+	SG_string* pstrOwnName = NULL;
+	SG_pathname* pPathFragball = NULL;
+	SG_pathname* pPathLock = NULL;
+	SG_pathname* pPathBuilt = NULL;
+	SG_pathname* pPathOwnLease = NULL;
+	SG_string* pstrPrefix = NULL;
+	char* pszBuiltName = NULL;
+	char* pszNewest = NULL;
+	char* pszResult = NULL;
+	SG_bool bLocked = SG_FALSE;
+	SG_bool bBuilt = SG_FALSE;
+	SG_bool bStale = SG_FALSE;
+	SG_uint32 lock_wait_seconds = 0;
+	SG_uint32 stale_lock_seconds = 0;
+	SG_int64 stale_ms = 0;
+	SG_int64 deadline_ms = 0;
+
+	SG_ERR_CHECK(  _get_clone_fragball_prefix(pCtx, pRepo, &pstrPrefix)  );
+	SG_ERR_CHECK(  _get_clone_fragball_name(pCtx, pRepo, SG_string__sz(pstrPrefix), 3, &pstrName)  );
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathFragball, pFragballDirPathname, SG_string__sz(pstrName))  );
+	SG_ERR_CHECK(  SG_STRING__ALLOC__COPY(pCtx, &pstrLock, pstrName)  );
+	SG_ERR_CHECK(  SG_string__append__sz(pCtx, pstrLock, sg_CLONE_FRAGBALL__LOCK_SUFFIX)  );
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathLock, pFragballDirPathname, SG_string__sz(pstrLock))  );
+
+	SG_ERR_CHECK(  _get_clone_cache_setting(pCtx, SG_LOCALSETTING__SERVER_CLONE_CACHE_LOCK_WAIT_SECONDS, sg_CLONE_FRAGBALL__DEFAULT_LOCK_WAIT_SECONDS, &lock_wait_seconds)  );
+	SG_ERR_CHECK(  _get_clone_cache_setting(pCtx, SG_LOCALSETTING__SERVER_CLONE_CACHE_STALE_LOCK_SECONDS, sg_CLONE_FRAGBALL__DEFAULT_STALE_LOCK_SECONDS, &stale_lock_seconds)  );
+	stale_ms = (SG_int64)stale_lock_seconds * 1000;
+	SG_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &deadline_ms)  );
+	deadline_ms += (SG_int64)lock_wait_seconds * 1000;
+
+	while (1)
+	{
+		SG_bool bExists = SG_FALSE;
+		SG_bool bLeased = SG_FALSE;
+		SG_int64 now = 0;
+
+		SG_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &now)  );
+		if (now >= deadline_ms)
+		{
+			/* Whoever has the lock is taking too long.  Build one of our own,
+			 * leased before it appears under its name so a trim can't take it. */
+			SG_ERR_CHECK(  SG_repo__fetch_repo__fragball(pCtx, pRepo, 3, pFragballDirPathname, &pszBuiltName)  );
+			SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathBuilt, pFragballDirPathname, pszBuiltName)  );
+			SG_ERR_CHECK(  SG_STRING__ALLOC__COPY(pCtx, &pstrOwnName, pstrPrefix)  );
+			SG_ERR_CHECK(  SG_string__append__sz(pCtx, pstrOwnName, pszBuiltName)  );
+			SG_ERR_CHECK(  _write_clone_fragball_lease(pCtx, pFragballDirPathname, SG_string__sz(pstrOwnName))  );
+			SG_ERR_CHECK(  _alloc_clone_fragball_sibling(pCtx, pFragballDirPathname, SG_string__sz(pstrOwnName), sg_CLONE_FRAGBALL__LEASE_SUFFIX, &pPathOwnLease)  );
+			SG_PATHNAME_NULLFREE(pCtx, pPathFragball);
+			SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathFragball, pFragballDirPathname, SG_string__sz(pstrOwnName))  );
+			SG_ERR_CHECK(  SG_fsobj__move__pathname_pathname(pCtx, pPathBuilt, pPathFragball)  );
+			bBuilt = SG_TRUE;
+
+			SG_ERR_CHECK(  SG_STRDUP(pCtx, SG_string__sz(pstrOwnName), &pszResult)  );
+			break;
+		}
+
+		SG_ERR_CHECK(  SG_fsobj__exists__pathname(pCtx, pPathFragball, &bExists, NULL, NULL)  );
+		if (bExists)
+		{
+			SG_ERR_CHECK(  _lease_clone_fragball(pCtx, pFragballDirPathname, SG_string__sz(pstrName), stale_ms, deadline_ms, &bLeased)  );
+			if (!bLeased)
+				continue;
+			SG_ERR_CHECK(  SG_STRDUP(pCtx, SG_string__sz(pstrName), &pszResult)  );
+			break;
+		}
+
+		if (bTopUp)
+		{
+			SG_int64 mtime = 0;
+			SG_uint32 max_age = 0;
+
+			SG_ERR_CHECK(  _find_newest_clone_fragball(pCtx, pFragballDirPathname, SG_string__sz(pstrPrefix), &pszNewest, &mtime)  );
+			if (pszNewest)
+			{
+				SG_ERR_CHECK(  _get_clone_cache_setting(pCtx, SG_LOCALSETTING__SERVER_CLONE_CACHE_TOPUP_SECONDS, sg_CLONE_FRAGBALL__DEFAULT_TOPUP_SECONDS, &max_age)  );
+				if (now - mtime <= (SG_int64)max_age * 1000)
+				{
+					SG_ERR_CHECK(  _lease_clone_fragball(pCtx, pFragballDirPathname, pszNewest, stale_ms, deadline_ms, &bLeased)  );
+					if (!bLeased)
+					{
+						SG_NULLFREE(pCtx, pszNewest);
+						continue;
+					}
+					pszResult = pszNewest;
+					pszNewest = NULL;
+					bStale = SG_TRUE;
+					break;
+				}
+				SG_NULLFREE(pCtx, pszNewest);
+			}
+		}
+
+		SG_ERR_CHECK(  _try_lock_clone_fragball(pCtx, pPathLock, stale_ms, &bLocked)  );
+		if (!bLocked)
+		{
+			SG_sleep_ms(sg_CLONE_FRAGBALL__LOCK_POLL_MS);
+			continue;
+		}
+
+		/* Whoever held the lock before us may have just finished. */
+		SG_ERR_CHECK(  SG_fsobj__exists__pathname(pCtx, pPathFragball, &bExists, NULL, NULL)  );
+		if (!bExists)
+		{
+			SG_ERR_CHECK(  SG_repo__fetch_repo__fragball(pCtx, pRepo, 3, pFragballDirPathname, &pszBuiltName)  );
+			SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathBuilt, pFragballDirPathname, pszBuiltName)  );
+			SG_ERR_CHECK(  SG_fsobj__move__pathname_pathname(pCtx, pPathBuilt, pPathFragball)  );
+			bBuilt = SG_TRUE;
+		}
+		SG_ERR_CHECK(  _write_clone_fragball_lease(pCtx, pFragballDirPathname, SG_string__sz(pstrName))  );
+
+		SG_ERR_CHECK(  SG_fsobj__remove__pathname(pCtx, pPathLock)  );
+		bLocked = SG_FALSE;
+
+		SG_ERR_CHECK(  SG_STRDUP(pCtx, SG_string__sz(pstrName), &pszResult)  );
+		break;
+	}
+
+	if (bBuilt)
+		SG_ERR_IGNORE(  _trim_clone_fragball_cache(pCtx, pFragballDirPathname, pszResult)  );
+
+	SG_RETURN_AND_NULL(pszResult, ppszFragballName);
+	*pbStale = bStale;
+
+	/* fall through */
+fail:
+	if (pPathBuilt && !bBuilt)
+	{
+		SG_ERR_IGNORE(  SG_fsobj__remove__pathname(pCtx, pPathBuilt)  );
+		if (pPathOwnLease)
+			SG_ERR_IGNORE(  SG_fsobj__remove__pathname(pCtx, pPathOwnLease)  );
+	}
+	if (bLocked)
+		SG_ERR_IGNORE(  SG_fsobj__remove__pathname(pCtx, pPathLock)  );
+	SG_STRING_NULLFREE(pCtx, pstrName);
+	SG_STRING_NULLFREE(pCtx, pstrLock);
+	SG_STRING_NULLFREE(pCtx, pstrOwnName);
+	SG_PATHNAME_NULLFREE(pCtx, pPathFragball);
+	SG_PATHNAME_NULLFREE(pCtx, pPathLock);
+	SG_PATHNAME_NULLFREE(pCtx, pPathBuilt);
+	SG_PATHNAME_NULLFREE(pCtx, pPathOwnLease);
+	SG_NULLFREE(pCtx, pszBuiltName);
+	SG_STRING_NULLFREE(pCtx, pstrPrefix);
+	SG_NULLFREE(pCtx, pszNewest);
+	SG_NULLFREE(pCtx, pszResult);
+}
+
+void SG_sync_remote__request_clone_fragball(
+	SG_context* pCtx,
+	SG_repo* pRepo,
+	const SG_pathname* pFragballDirPathname,
+	const SG_vhash* pvhCloneRequest,
+	char** ppszFragballName,
+	SG_bool* pbStale)
+{
+	SG_bool bTopUp = SG_FALSE;
+	SG_bool bStale = SG_FALSE;
+
+	SG_NULLARGCHECK_RETURN(pRepo);
+	SG_NULLARGCHECK_RETURN(pFragballDirPathname);
+	SG_NULLARGCHECK_RETURN(ppszFragballName);
+
+	if (pvhCloneRequest)
+		SG_ERR_CHECK_RETURN(  SG_vhash__has(pCtx, pvhCloneRequest, SG_SYNC_CLONE_REQUEST_KEY__TOPUP, &bTopUp)  );
+
+	SG_ERR_CHECK_RETURN(  _get_clone_fragball(pCtx, pRepo, pFragballDirPathname, bTopUp, ppszFragballName, &bStale)  );
+
+	if (pbStale)
+		*pbStale = bStale;
+}
+
 void SG_sync_remote__request_fragball(
 	SG_context* pCtx,
 	SG_repo* pRepo,
@@ -398,8 +1128,10 @@ void SG_sync_remote__request_fragball(
 		SG_ERR_CHECK(  SG_vhash__has(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__CLONE, &found)  );
 		if (found)
 		{
-            // SG_SYNC_STATUS_KEY__CLONE_REQUEST is currently ignored
-            SG_ERR_CHECK(  SG_repo__fetch_repo__fragball(pCtx, pRepo, 3, pFragballDirPathname, ppszFragballName) );
+            SG_vhash* pvhCloneRequest = NULL;
+
+            SG_ERR_CHECK(  SG_vhash__check__vhash(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__CLONE_REQUEST, &pvhCloneRequest)  );
+            SG_ERR_CHECK(  SG_sync_remote__request_clone_fragball(pCtx, pRepo, pFragballDirPathname, pvhCloneRequest, ppszFragballName, NULL)  );
 		}
 		else
 		{
@@ -477,19 +1209,29 @@ void SG_sync_remote__request_fragball(
 
 					if (prbDagnodes) // can be null when leaves of an empty dag are requested
 					{
-						// Get the leaves of the other repo, which we need to connect to.
+						SG_vhash* pvhRefAllHaveSets = NULL;
+						SG_vhash* pvhRefHaveSet = NULL;
+
+						// If the other repo told us what it has, we can find the connection point directly.
+						SG_ERR_CHECK(  SG_vhash__check__vhash(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__HAVE, &pvhRefAllHaveSets)  );
+						if (pvhRefAllHaveSets)
+							SG_ERR_CHECK(  SG_vhash__check__vhash(pCtx, pvhRefAllHaveSets, pszRefDagNum, &pvhRefHaveSet)  );
+
+						// Otherwise get the leaves of the other repo, which we need to connect to.
 						SG_ERR_CHECK(  SG_vhash__has(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__LEAVES, &found)  );
-						if (found)
+						if (pvhRefHaveSet)
+						{
+							SG_ERR_CHECK(  SG_sync__build_dagfrag_from_have_set(pCtx, pRepo, iDagnum,
+								prbDagnodes, pvhRefHaveSet, &pFrag)  );
+						}
+						else if (found)
 						{
 							SG_vhash* pvhRefAllLeaves;
 							SG_vhash* pvhRefDagLeaves;
 							SG_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhRequest, SG_SYNC_STATUS_KEY__LEAVES, &pvhRefAllLeaves)  );
-							SG_ERR_CHECK(  SG_vhash__has(pCtx, pvhRequest, pszRefDagNum, &found)  );
-							{
-								SG_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhRefAllLeaves, pszRefDagNum, &pvhRefDagLeaves)  );
-								SG_ERR_CHECK(  SG_sync__build_best_guess_dagfrag(pCtx, pRepo, iDagnum, 
-									prbDagnodes, pvhRefDagLeaves, &pFrag)  );
-							}
+							SG_ERR_CHECK(  SG_vhash__check__vhash(pCtx, pvhRefAllLeaves, pszRefDagNum, &pvhRefDagLeaves)  );
+							SG_ERR_CHECK(  SG_sync__build_best_guess_dagfrag(pCtx, pRepo, iDagnum, 
+								prbDagnodes, pvhRefDagLeaves, &pFrag)  );
 						}
 						else
 						{
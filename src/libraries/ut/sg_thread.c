@@ -104,3 +104,406 @@ const char* SG_thread__sz(
 fail:
 	return pBuffer;
 }
+
+struct _sg_thread
+{
+	SG_thread__main* pfnMain;
+	void*            pVoidData;
+
+#if defined(WINDOWS)
+	HANDLE           hThread;
+#endif
+
+#if defined(MAC) || defined(LINUX)
+	pthread_t        thread;
+#endif
+};
+
+#if defined(WINDOWS)
+static DWORD WINAPI sg_thread__trampoline(LPVOID pVoid)
+{
+	SG_thread* pThread = (SG_thread*)pVoid;
+
+	pThread->pfnMain(pThread->pVoidData);
+
+	return 0;
+}
+#endif
+
+#if defined(MAC) || defined(LINUX)
+static void* sg_thread__trampoline(void* pVoid)
+{
+	SG_thread* pThread = (SG_thread*)pVoid;
+
+	pThread->pfnMain(pThread->pVoidData);
+
+	return NULL;
+}
+#endif
+
+void SG_thread__create(
+	SG_context*      pCtx,
+	SG_thread__main* pfnMain,
+	void*            pVoidData,
+	SG_thread**      ppThread
+	)
+{
+	SG_thread* pThread = NULL;
+#if defined(MAC) || defined(LINUX)
+	int rc;
+#endif
+
+	SG_NULLARGCHECK_RETURN(pfnMain);
+	SG_NULLARGCHECK_RETURN(ppThread);
+
+	SG_ERR_CHECK(  SG_alloc1(pCtx, pThread)  );
+	pThread->pfnMain = pfnMain;
+	pThread->pVoidData = pVoidData;
+
+#if defined(WINDOWS)
+	pThread->hThread = CreateThread(NULL, 0, sg_thread__trampoline, pThread, 0, NULL);
+	if (pThread->hThread == NULL)
+		SG_ERR_THROW2(  SG_ERR_GETLASTERROR(GetLastError()),
+						(pCtx, "Could not create thread.")  );
+#endif
+
+#if defined(MAC) || defined(LINUX)
+	rc = pthread_create(&pThread->thread, NULL, sg_thread__trampoline, pThread);
+	if (rc)
+		SG_ERR_THROW2(  SG_ERR_ERRNO(rc),
+						(pCtx, "Could not create thread.")  );
+#endif
+
+	*ppThread = pThread;
+	return;
+
+fail:
+	SG_NULLFREE(pCtx, pThread);
+}
+
+void SG_thread__join(
+	SG_context* pCtx,
+	SG_thread** ppThread
+	)
+{
+	SG_thread* pThread = NULL;
+#if defined(MAC) || defined(LINUX)
+	int rc;
+#endif
+
+	SG_NULLARGCHECK_RETURN(ppThread);
+
+	pThread = *ppThread;
+	if (!pThread)
+		return;
+	*ppThread = NULL;
+
+#if defined(WINDOWS)
+	(void) WaitForSingleObject(pThread->hThread, INFINITE);
+	(void) CloseHandle(pThread->hThread);
+#endif
+
+#if defined(MAC) || defined(LINUX)
+	rc = pthread_join(pThread->thread, NULL);
+	if (rc)
+		SG_ERR_THROW2(  SG_ERR_ERRNO(rc),
+						(pCtx, "Could not join thread.")  );
+#endif
+
+fail:
+	SG_NULLFREE(pCtx, pThread);
+}
+
+void SG_thread__get_processor_count(
+	SG_context* pCtx,
+	SG_uint32*  pCount
+	)
+{
+	SG_uint32 count = 1;
+
+	SG_NULLARGCHECK_RETURN(pCount);
+
+#if defined(WINDOWS)
+	{
+		SYSTEM_INFO si;
+
+		GetSystemInfo(&si);
+		count = (SG_uint32)si.dwNumberOfProcessors;
+	}
+#endif
+
+#if defined(MAC) || defined(LINUX)
+	{
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+		if (n > 0)
+			count = (SG_uint32)n;
+	}
+#endif
+
+	*pCount = ((count > 0) ? count : 1);
+}
+
+//////////////////////////////////////////////////////////////////
+
+void SG_thread_cond__init(
+	SG_context*     pCtx,
+	SG_thread_cond* pCond
+	)
+{
+#if defined(MAC) || defined(LINUX)
+	int rc;
+#endif
+
+	SG_NULLARGCHECK_RETURN(pCond);
+
+#if defined(WINDOWS)
+	InitializeConditionVariable(&pCond->cv);
+#endif
+
+#if defined(MAC) || defined(LINUX)
+	rc = pthread_cond_init(&pCond->cond, NULL);
+	if (rc)
+		SG_ERR_THROW2_RETURN(  SG_ERR_ERRNO(rc),
+							   (pCtx, "Could not create condition variable.")  );
+#endif
+}
+
+void SG_thread_cond__destroy(
+	SG_thread_cond* pCond
+	)
+{
+#if defined(WINDOWS)
+	// nothing to release
+	SG_UNUSED(pCond);
+#endif
+
+#if defined(MAC) || defined(LINUX)
+	(void) pthread_cond_destroy(&pCond->cond);
+#endif
+}
+
+void SG_thread_cond__wait(
+	SG_context*     pCtx,
+	SG_thread_cond* pCond,
+	SG_mutex*       pm
+	)
+{
+#if defined(MAC) || defined(LINUX)
+	int rc;
+#endif
+
+	SG_NULLARGCHECK_RETURN(pCond);
+	SG_NULLARGCHECK_RETURN(pm);
+
+#if defined(WINDOWS)
+	if (!SleepConditionVariableCS(&pCond->cv, &pm->cs, INFINITE))
+		SG_ERR_THROW2_RETURN(  SG_ERR_GETLASTERROR(GetLastError()),
+							   (pCtx, "Could not wait on condition variable.")  );
+#endif
+
+#if defined(MAC) || defined(LINUX)
+	rc = pthread_cond_wait(&pCond->cond, &pm->mtx);
+	if (rc)
+		SG_ERR_THROW2_RETURN(  SG_ERR_ERRNO(rc),
+							   (pCtx, "Could not wait on condition variable.")  );
+#endif
+}
+
+int SG_thread_cond__broadcast__bare(
+	SG_thread_cond* pCond
+	)
+{
+#if defined(WINDOWS)
+	WakeAllConditionVariable(&pCond->cv);
+	return 0;
+#endif
+
+#if defined(MAC) || defined(LINUX)
+	return pthread_cond_broadcast(&pCond->cond);
+#endif
+}
+
+void SG_thread_cond__broadcast(
+	SG_context*     pCtx,
+	SG_thread_cond* pCond
+	)
+{
+	int rc;
+
+	SG_NULLARGCHECK_RETURN(pCond);
+
+	rc = SG_thread_cond__broadcast__bare(pCond);
+	if (rc)
+		SG_ERR_THROW2_RETURN(  SG_ERR_ERRNO(rc),
+							   (pCtx, "Could not wake condition variable waiters.")  );
+}
+
+//////////////////////////////////////////////////////////////////
+
+typedef struct _sg_thread_pool__worker
+{
+	SG_thread_pool*  pPool;     // back ptr.  we do not own this
+	SG_context*      pCtx;      // the worker's own context
+	SG_repo*         pRepo;     // the worker's own instance of the repo, or NULL
+	SG_thread*       pThread;
+} sg_thread_pool__worker;
+
+struct _sg_thread_pool
+{
+	SG_thread_pool__work*   pfnWork;
+	void*                   pVoidData;
+
+	sg_thread_pool__worker* aWorkers;
+	SG_uint32               nrWorkers;
+
+	SG_mutex                mutex;
+	sg_thread_pool__worker* pFirstFailed;   // protected by mutex
+};
+
+static SG_thread__main sg_thread_pool__main;
+
+static void sg_thread_pool__main(void* pVoidData)
+{
+	sg_thread_pool__worker* pWorker = (sg_thread_pool__worker*)pVoidData;
+	SG_thread_pool* pPool = pWorker->pPool;
+
+	pPool->pfnWork(pWorker->pCtx, pWorker->pRepo, pPool->pVoidData);
+
+	if (SG_CONTEXT__HAS_ERR(pWorker->pCtx) && (SG_mutex__lock__bare(&pPool->mutex) == 0))
+	{
+		if (!pPool->pFirstFailed)
+			pPool->pFirstFailed = pWorker;
+		(void)SG_mutex__unlock__bare(&pPool->mutex);
+	}
+}
+
+void SG_thread_pool__size_for_jobs(
+	SG_context* pCtx,
+	SG_uint32   nrJobs,
+	SG_uint32   nrMinJobsPerWorker,
+	SG_uint32   nrMaxThreads,
+	SG_uint32*  pNrWorkers
+	)
+{
+	SG_uint32 nrProcessors = 1;
+	SG_uint32 nrThreads;
+
+	SG_NULLARGCHECK_RETURN(pNrWorkers);
+
+	SG_ERR_CHECK_RETURN(  SG_thread__get_processor_count(pCtx, &nrProcessors)  );
+
+	nrThreads = SG_MIN(nrProcessors, nrMaxThreads);
+	if (nrMinJobsPerWorker)
+		nrThreads = SG_MIN(nrThreads, (nrJobs / nrMinJobsPerWorker));
+
+	*pNrWorkers = ((nrThreads > 0) ? (nrThreads - 1) : 0);
+}
+
+void SG_thread_pool__alloc(
+	SG_context*           pCtx,
+	SG_uint32             nrWorkers,
+	SG_repo*              pRepo,
+	SG_thread_pool__work* pfnWork,
+	void*                 pVoidData,
+	SG_thread_pool**      ppPool
+	)
+{
+	SG_thread_pool* pPool = NULL;
+	SG_bool bMutex = SG_FALSE;
+	SG_uint32 k;
+
+	SG_NULLARGCHECK_RETURN(pfnWork);
+	SG_NULLARGCHECK_RETURN(ppPool);
+
+	SG_ERR_CHECK(  SG_alloc1(pCtx, pPool)  );
+	pPool->pfnWork = pfnWork;
+	pPool->pVoidData = pVoidData;
+
+	SG_ERR_CHECK(  SG_mutex__init(pCtx, &pPool->mutex)  );
+	bMutex = SG_TRUE;
+
+	if (nrWorkers > 0)
+	{
+		SG_ERR_CHECK(  SG_allocN(pCtx, nrWorkers, pPool->aWorkers)  );
+		pPool->nrWorkers = nrWorkers;
+		for (k=0; k<nrWorkers; k++)
+		{
+			pPool->aWorkers[k].pPool = pPool;
+			SG_CTX_ALLOC_W_ERR_CHECK(  &pPool->aWorkers[k].pCtx  );
+			if (pRepo)
+				SG_ERR_CHECK(  SG_repo__open_repo_instance__copy(pCtx, pRepo, &pPool->aWorkers[k].pRepo)  );
+		}
+	}
+
+	*ppPool = pPool;
+	return;
+
+fail:
+	if (pPool && !bMutex)
+		SG_NULLFREE(pCtx, pPool);
+	SG_THREAD_POOL_NULLFREE(pCtx, pPool);
+}
+
+void SG_thread_pool__start(
+	SG_context*     pCtx,
+	SG_thread_pool* pPool
+	)
+{
+	SG_uint32 k;
+
+	SG_NULLARGCHECK_RETURN(pPool);
+
+	for (k=0; k<pPool->nrWorkers; k++)
+		SG_ERR_CHECK_RETURN(  SG_thread__create(pCtx, sg_thread_pool__main, &pPool->aWorkers[k], &pPool->aWorkers[k].pThread)  );
+}
+
+void SG_thread_pool__join(
+	SG_context*     pCtx,
+	SG_thread_pool* pPool
+	)
+{
+	SG_uint32 k;
+
+	SG_NULLARGCHECK_RETURN(pPool);
+
+	for (k=0; k<pPool->nrWorkers; k++)
+		SG_ERR_CHECK_RETURN(  SG_thread__join(pCtx, &pPool->aWorkers[k].pThread)  );
+
+	// Every worker is done, so nobody else is looking at pFirstFailed.
+
+	if (pPool->pFirstFailed)
+	{
+		SG_error err = SG_ERR_UNSPECIFIED;
+		const char * pszDescription = NULL;
+
+		(void)SG_context__get_err(pPool->pFirstFailed->pCtx, &err);
+		(void)SG_context__err_get_description(pPool->pFirstFailed->pCtx, &pszDescription);
+		SG_ERR_THROW2_RETURN(  err,
+							   (pCtx, "%s", ((pszDescription) ? pszDescription : ""))  );
+	}
+}
+
+void SG_thread_pool__free(
+	SG_context*     pCtx,
+	SG_thread_pool* pPool
+	)
+{
+	SG_uint32 k;
+
+	if (!pPool)
+		return;
+
+	for (k=0; k<pPool->nrWorkers; k++)
+		SG_ERR_IGNORE(  SG_thread__join(pCtx, &pPool->aWorkers[k].pThread)  );
+
+	for (k=0; k<pPool->nrWorkers; k++)
+	{
+		SG_REPO_NULLFREE(pCtx, pPool->aWorkers[k].pRepo);
+		SG_CONTEXT_NULLFREE(pPool->aWorkers[k].pCtx);
+	}
+	SG_NULLFREE(pCtx, pPool->aWorkers);
+
+	SG_mutex__destroy(&pPool->mutex);
+	SG_NULLFREE(pCtx, pPool);
+}
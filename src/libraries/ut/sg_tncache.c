@@ -72,3 +72,456 @@ void SG_tncache__load(
     }
 }
 
+
+//////////////////////////////////////////////////////////////////
+// The process-wide treenode cache.  See sg_tncache_prototypes.h.
+
+#define sg_TNCACHE_SHARED_DEFAULT_LIMIT     (16 * 1024 * 1024)
+
+struct _sg_tncache_entry
+{
+    char* psz_key;              // see sg_tncache__shared__format_key()
+    SG_treenode* ptn;
+    SG_uint32 cb;
+
+    // one for each caller holding ptn, plus one for the
+    // cache itself while b_in_cache is set
+    SG_uint32 refs;
+    SG_bool b_in_cache;
+
+    // LRU order, most recently used at the head.  once the
+    // entry is out of the cache, pNext is just a list of
+    // things waiting to be freed.
+    struct _sg_tncache_entry* pPrev;
+    struct _sg_tncache_entry* pNext;
+};
+
+static struct
+{
+    SG_bool b_initialized;
+    SG_mutex mutex;
+
+    SG_rbtree* prb;                 // repo instance and HID --> SG_tncache_entry
+    SG_uint32 count_adds;           // since prb was last rebuilt
+    SG_tncache_entry* pHead;
+    SG_tncache_entry* pTail;
+
+    SG_uint32 count;
+    SG_uint64 cb;
+    SG_uint64 cb_limit;
+
+    SG_uint64 hits;
+    SG_uint64 misses;
+    SG_uint64 evictions;
+} g_tncache_shared;
+
+static void sg_tncache__shared__unlock(SG_context* pCtx)
+{
+    if (SG_CONTEXT__HAS_ERR(pCtx))
+    {
+        SG_mutex__unlock__bare(&g_tncache_shared.mutex);
+    }
+    else
+    {
+        SG_ERR_CHECK_RETURN(  SG_mutex__unlock(pCtx, &g_tncache_shared.mutex)  );
+    }
+}
+
+static void sg_tncache__shared__unlink(SG_tncache_entry* pEntry)
+{
+    if (pEntry->pPrev)
+    {
+        pEntry->pPrev->pNext = pEntry->pNext;
+    }
+    else
+    {
+        g_tncache_shared.pHead = pEntry->pNext;
+    }
+
+    if (pEntry->pNext)
+    {
+        pEntry->pNext->pPrev = pEntry->pPrev;
+    }
+    else
+    {
+        g_tncache_shared.pTail = pEntry->pPrev;
+    }
+
+    pEntry->pPrev = NULL;
+    pEntry->pNext = NULL;
+}
+
+static void sg_tncache__shared__push_front(SG_tncache_entry* pEntry)
+{
+    pEntry->pPrev = NULL;
+    pEntry->pNext = g_tncache_shared.pHead;
+    if (g_tncache_shared.pHead)
+    {
+        g_tncache_shared.pHead->pPrev = pEntry;
+    }
+    else
+    {
+        g_tncache_shared.pTail = pEntry;
+    }
+    g_tncache_shared.pHead = pEntry;
+}
+
+/**
+ * Evict from the tail until we're under the limit.  Entries which
+ * nobody else holds are put on *ppDoomed, so that the caller can
+ * free their treenodes after letting go of the mutex.
+ *
+ * The mutex must be held.
+ */
+static void sg_tncache__shared__trim(SG_context* pCtx, SG_tncache_entry** ppDoomed)
+{
+    while (g_tncache_shared.pTail && (g_tncache_shared.cb > g_tncache_shared.cb_limit))
+    {
+        SG_tncache_entry* pEntry = g_tncache_shared.pTail;
+
+        SG_ERR_CHECK_RETURN(  SG_rbtree__remove(pCtx, g_tncache_shared.prb, pEntry->psz_key)  );
+
+        sg_tncache__shared__unlink(pEntry);
+        pEntry->b_in_cache = SG_FALSE;
+        g_tncache_shared.count--;
+        g_tncache_shared.cb -= pEntry->cb;
+        g_tncache_shared.evictions++;
+
+        pEntry->refs--;
+        if (0 == pEntry->refs)
+        {
+            pEntry->pNext = *ppDoomed;
+            *ppDoomed = pEntry;
+        }
+    }
+}
+
+static void sg_tncache__shared__free_doomed(SG_context* pCtx, SG_tncache_entry* pDoomed)
+{
+    while (pDoomed)
+    {
+        SG_tncache_entry* pNext = pDoomed->pNext;
+        SG_treenode* ptn = pDoomed->ptn;
+
+        // the last reference is gone, so this frees pDoomed too.
+        SG_TREENODE_NULLFREE(pCtx, ptn);
+
+        pDoomed = pNext;
+    }
+}
+
+/**
+ * Removing keys from an rbtree doesn't give back the space
+ * they took in its string pool.  Every so often, start over
+ * with a fresh one.
+ *
+ * The mutex must be held.
+ */
+static void sg_tncache__shared__rebuild_index(SG_context* pCtx)
+{
+    SG_rbtree* prb = NULL;
+    SG_tncache_entry* pEntry = NULL;
+
+    SG_ERR_CHECK(  SG_RBTREE__ALLOC__PARAMS(pCtx, &prb, g_tncache_shared.count, NULL)  );
+    for (pEntry = g_tncache_shared.pHead; pEntry; pEntry = pEntry->pNext)
+    {
+        SG_ERR_CHECK(  SG_rbtree__add__with_assoc(pCtx, prb, pEntry->psz_key, pEntry)  );
+    }
+
+    SG_RBTREE_NULLFREE(pCtx, g_tncache_shared.prb);
+    g_tncache_shared.prb = prb;
+    prb = NULL;
+    g_tncache_shared.count_adds = 0;
+
+fail:
+    SG_RBTREE_NULLFREE(pCtx, prb);
+}
+
+/**
+ * A treenode is only shared with callers of the repo instance it was
+ * loaded from.  Another repo (or another clone of the same one) may
+ * not have the blob at all, and it has to find that out for itself.
+ */
+static void sg_tncache__shared__format_key(
+    SG_context* pCtx,
+    SG_repo* pRepo,
+    const char* psz_hid_treenode,
+    SG_string** ppstr_key
+    )
+{
+    const char* psz_instance = NULL;
+    SG_string* pstr = NULL;
+
+    SG_ERR_CHECK(  SG_repo__get_instance_key(pCtx, pRepo, &psz_instance)  );
+    SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstr)  );
+    SG_ERR_CHECK(  SG_string__sprintf(pCtx, pstr, "%s %s", psz_hid_treenode, psz_instance)  );
+
+    *ppstr_key = pstr;
+    pstr = NULL;
+
+fail:
+    SG_STRING_NULLFREE(pCtx, pstr);
+}
+
+void SG_tncache__global_initialize(SG_context* pCtx)
+{
+    memset(&g_tncache_shared, 0, sizeof(g_tncache_shared));
+
+    SG_ERR_CHECK_RETURN(  SG_mutex__init(pCtx, &g_tncache_shared.mutex)  );
+    SG_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &g_tncache_shared.prb)  );
+    g_tncache_shared.cb_limit = sg_TNCACHE_SHARED_DEFAULT_LIMIT;
+
+    g_tncache_shared.b_initialized = SG_TRUE;
+    return;
+
+fail:
+    SG_mutex__destroy(&g_tncache_shared.mutex);
+}
+
+void SG_tncache__global_cleanup(SG_context* pCtx)
+{
+    if (!g_tncache_shared.b_initialized)
+    {
+        return;
+    }
+
+    SG_ERR_IGNORE(  SG_tncache__shared__set_limit(pCtx, 0)  );
+
+    // anything still held by someone is no longer in the cache,
+    // so it gets freed without us when they let go.
+
+    g_tncache_shared.b_initialized = SG_FALSE;
+    SG_RBTREE_NULLFREE(pCtx, g_tncache_shared.prb);
+    SG_mutex__destroy(&g_tncache_shared.mutex);
+}
+
+void SG_tncache__shared__set_limit(
+    SG_context* pCtx,
+    SG_uint64 cb_limit
+    )
+{
+    SG_tncache_entry* pDoomed = NULL;
+
+    if (!g_tncache_shared.b_initialized)
+    {
+        return;
+    }
+
+    SG_ERR_CHECK_RETURN(  SG_mutex__lock(pCtx, &g_tncache_shared.mutex)  );
+
+    g_tncache_shared.cb_limit = cb_limit;
+    SG_ERR_CHECK(  sg_tncache__shared__trim(pCtx, &pDoomed)  );
+
+fail:
+    sg_tncache__shared__unlock(pCtx);
+    sg_tncache__shared__free_doomed(pCtx, pDoomed);
+}
+
+void SG_tncache__shared__find(
+    SG_context* pCtx,
+    SG_repo* pRepo,
+    const char* psz_hid_treenode,
+    SG_treenode** pptn
+    )
+{
+    SG_tncache_entry* pEntry = NULL;
+    SG_string* pstr_key = NULL;
+    SG_bool b_found = SG_FALSE;
+    SG_bool b_locked = SG_FALSE;
+
+    SG_NULLARGCHECK_RETURN(pRepo);
+    SG_NULLARGCHECK_RETURN(psz_hid_treenode);
+    SG_NULLARGCHECK_RETURN(pptn);
+
+    *pptn = NULL;
+
+    if (!g_tncache_shared.b_initialized || (0 == g_tncache_shared.cb_limit))
+    {
+        return;
+    }
+
+    SG_ERR_CHECK(  sg_tncache__shared__format_key(pCtx, pRepo, psz_hid_treenode, &pstr_key)  );
+
+    SG_ERR_CHECK(  SG_mutex__lock(pCtx, &g_tncache_shared.mutex)  );
+    b_locked = SG_TRUE;
+
+    SG_ERR_CHECK(  SG_rbtree__find(pCtx, g_tncache_shared.prb, SG_string__sz(pstr_key), &b_found, (void**) &pEntry)  );
+    if (b_found)
+    {
+        pEntry->refs++;
+        g_tncache_shared.hits++;
+        SG_perf__count("tncache_hit", 1);
+
+        if (pEntry != g_tncache_shared.pHead)
+        {
+            sg_tncache__shared__unlink(pEntry);
+            sg_tncache__shared__push_front(pEntry);
+        }
+
+        *pptn = pEntry->ptn;
+    }
+    else
+    {
+        g_tncache_shared.misses++;
+        SG_perf__count("tncache_miss", 1);
+    }
+
+fail:
+    if (b_locked)
+    {
+        sg_tncache__shared__unlock(pCtx);
+    }
+    SG_STRING_NULLFREE(pCtx, pstr_key);
+}
+
+void SG_tncache__shared__add(
+    SG_context* pCtx,
+    SG_repo* pRepo,
+    const char* psz_hid_treenode,
+    SG_uint32 cb,
+    SG_treenode** pptn
+    )
+{
+    SG_tncache_entry* pEntry = NULL;
+    SG_tncache_entry* pExisting = NULL;
+    SG_tncache_entry* pDoomed = NULL;
+    SG_treenode* ptn_dup = NULL;
+    SG_string* pstr_key = NULL;
+    SG_bool b_found = SG_FALSE;
+    SG_bool b_locked = SG_FALSE;
+
+    SG_NULLARGCHECK_RETURN(pRepo);
+    SG_NULLARGCHECK_RETURN(psz_hid_treenode);
+    SG_NULLARGCHECK_RETURN(pptn);
+    SG_NULLARGCHECK_RETURN(*pptn);
+
+    // one huge directory shouldn't push out everything else
+
+    if (!g_tncache_shared.b_initialized || (cb > (g_tncache_shared.cb_limit / 4)))
+    {
+        return;
+    }
+
+    SG_ERR_CHECK_RETURN(  SG_alloc1(pCtx, pEntry)  );
+    SG_ERR_CHECK(  sg_tncache__shared__format_key(pCtx, pRepo, psz_hid_treenode, &pstr_key)  );
+    SG_ERR_CHECK(  SG_string__sizzle(pCtx, &pstr_key, (SG_byte**) &pEntry->psz_key, NULL)  );
+
+    SG_ERR_CHECK(  SG_mutex__lock(pCtx, &g_tncache_shared.mutex)  );
+    b_locked = SG_TRUE;
+
+    SG_ERR_CHECK(  SG_rbtree__find(pCtx, g_tncache_shared.prb, pEntry->psz_key, &b_found, (void**) &pExisting)  );
+    if (b_found)
+    {
+        // somebody else loaded it while we were.  use theirs.
+
+        pExisting->refs++;
+        ptn_dup = *pptn;
+        *pptn = pExisting->ptn;
+    }
+    else
+    {
+        pEntry->ptn = *pptn;
+        pEntry->cb = cb;
+        pEntry->refs = 2;
+        pEntry->b_in_cache = SG_TRUE;
+
+        SG_ERR_CHECK(  SG_rbtree__add__with_assoc(pCtx, g_tncache_shared.prb, pEntry->psz_key, pEntry)  );
+        SG_treenode__set_cache_entry(pEntry->ptn, pEntry);
+        sg_tncache__shared__push_front(pEntry);
+        pEntry = NULL;
+
+        g_tncache_shared.count++;
+        g_tncache_shared.cb += cb;
+        g_tncache_shared.count_adds++;
+
+        SG_ERR_CHECK(  sg_tncache__shared__trim(pCtx, &pDoomed)  );
+
+        if (g_tncache_shared.count_adds > (4 * g_tncache_shared.count) + 1024)
+        {
+            SG_ERR_CHECK(  sg_tncache__shared__rebuild_index(pCtx)  );
+        }
+    }
+
+fail:
+    if (b_locked)
+    {
+        sg_tncache__shared__unlock(pCtx);
+    }
+    if (pEntry)
+    {
+        SG_NULLFREE(pCtx, pEntry->psz_key);
+        SG_NULLFREE(pCtx, pEntry);
+    }
+    SG_STRING_NULLFREE(pCtx, pstr_key);
+    sg_tncache__shared__free_doomed(pCtx, pDoomed);
+    SG_TREENODE_NULLFREE(pCtx, ptn_dup);
+}
+
+void SG_tncache__shared__release(
+    SG_context* pCtx,
+    SG_tncache_entry* pEntry,
+    SG_bool* pbLast
+    )
+{
+    SG_bool b_last = SG_FALSE;
+
+    SG_NULLARGCHECK_RETURN(pEntry);
+    SG_NULLARGCHECK_RETURN(pbLast);
+
+    if (g_tncache_shared.b_initialized)
+    {
+        SG_ERR_CHECK_RETURN(  SG_mutex__lock(pCtx, &g_tncache_shared.mutex)  );
+    }
+
+    // refs is already zero when the cache let go of the
+    // last reference itself.  see sg_tncache__shared__trim().
+
+    if (pEntry->refs)
+    {
+        pEntry->refs--;
+    }
+    b_last = (0 == pEntry->refs);
+
+    if (g_tncache_shared.b_initialized)
+    {
+        SG_ERR_CHECK_RETURN(  SG_mutex__unlock(pCtx, &g_tncache_shared.mutex)  );
+    }
+
+    if (b_last)
+    {
+        SG_NULLFREE(pCtx, pEntry->psz_key);
+        SG_NULLFREE(pCtx, pEntry);
+    }
+
+    *pbLast = b_last;
+}
+
+void SG_tncache__shared__get_stats(
+    SG_context* pCtx,
+    SG_uint32* pCount,
+    SG_uint64* pcb,
+    SG_uint64* pHits,
+    SG_uint64* pMisses,
+    SG_uint64* pEvictions
+    )
+{
+    if (!g_tncache_shared.b_initialized)
+    {
+        SG_ERR_THROW_RETURN(  SG_ERR_UNINITIALIZED  );
+    }
+
+    SG_ERR_CHECK_RETURN(  SG_mutex__lock(pCtx, &g_tncache_shared.mutex)  );
+
+    if (pCount)
+        *pCount = g_tncache_shared.count;
+    if (pcb)
+        *pcb = g_tncache_shared.cb;
+    if (pHits)
+        *pHits = g_tncache_shared.hits;
+    if (pMisses)
+        *pMisses = g_tncache_shared.misses;
+    if (pEvictions)
+        *pEvictions = g_tncache_shared.evictions;
+
+    SG_ERR_CHECK_RETURN(  SG_mutex__unlock(pCtx, &g_tncache_shared.mutex)  );
+}
@@ -64,6 +64,14 @@ struct SG_treenode
 	 */
 	char *					m_pszHidFrozen;
 	SG_string *				m_pStringFrozenJSON;
+
+	/**
+	 * Non-NULL when this Treenode is held by the process-wide
+	 * treenode cache and may be shared with other callers (and
+	 * other threads).  Such a Treenode stays frozen for good and
+	 * SG_treenode__free() only drops a reference.  See sg_tncache.c.
+	 */
+	SG_tncache_entry *		m_pCacheEntry;
 };
 
 //////////////////////////////////////////////////////////////////
@@ -121,6 +129,15 @@ void SG_treenode__free(SG_context * pCtx, SG_treenode * pTreenode)
 	if (!pTreenode)
 		return;
 
+	if (pTreenode->m_pCacheEntry)
+	{
+		SG_bool bLast = SG_FALSE;
+
+		SG_ERR_IGNORE(  SG_tncache__shared__release(pCtx, pTreenode->m_pCacheEntry, &bLast)  );
+		if (!bLast)
+			return;
+	}
+
 	SG_VHASH_NULLFREE(pCtx, pTreenode->m_vhash);
 	SG_NULLFREE(pCtx, pTreenode->m_pszHidFrozen);
 	SG_STRING_NULLFREE(pCtx, pTreenode->m_pStringFrozenJSON);
@@ -689,10 +706,19 @@ void SG_treenode__unfreeze(SG_context * pCtx, SG_treenode * pTreenode)
 {
 	SG_NULLARGCHECK_RETURN(pTreenode);
 
+	// other people may be looking at a shared Treenode.
+	if (pTreenode->m_pCacheEntry)
+		SG_ERR_THROW_RETURN(SG_ERR_INVALID_WHILE_FROZEN);
+
 	SG_NULLFREE(pCtx, pTreenode->m_pszHidFrozen);
 	SG_STRING_NULLFREE(pCtx, pTreenode->m_pStringFrozenJSON);
 }
 
+void SG_treenode__set_cache_entry(SG_treenode * pTreenode, SG_tncache_entry * pEntry)
+{
+	pTreenode->m_pCacheEntry = pEntry;
+}
+
 void SG_treenode__get_vhash_ref(SG_UNUSED_PARAM(SG_context * pCtx), const SG_treenode * pTreenode, SG_vhash** ppvh)
 {
 	SG_UNUSED(pCtx);
@@ -838,6 +864,13 @@ void SG_treenode__load_from_repo(
 
 	*ppTreenodeReturned = NULL;
 
+	// treenodes never change, so if anybody has parsed this
+	// one from this repo already, we can share theirs.
+
+	SG_ERR_CHECK_RETURN(  SG_tncache__shared__find(pCtx, pRepo, pszidHidBlob, ppTreenodeReturned)  );
+	if (*ppTreenodeReturned)
+		return;
+
 	// fetch the Blob for the given HID.
 
 	SG_ERR_CHECK(  SG_repo__fetch_blob_into_memory(pCtx,
@@ -855,6 +888,8 @@ void SG_treenode__load_from_repo(
 												  pszidHidBlob)  );
 	SG_NULLFREE(pCtx, pbuf);
 
+	SG_ERR_CHECK(  SG_tncache__shared__add(pCtx, pRepo, pszidHidBlob, (SG_uint32) len, &pTreenode)  );
+
 	*ppTreenodeReturned = pTreenode;
 	return;
 
@@ -208,6 +208,9 @@ void SG_uridispatch__init(
 	}
 	SG_NULLFREE(pCtx, szConfigSetting);
 
+	// Start up the response cache before any handler can use it.
+	SG_ERR_CHECK(  SG_responsecache__global_init(pCtx)  );
+
 	// Start up the js context pool.
 	SG_ERR_CHECK(  SG_jscontextpool__init(pCtx, SG_string__sz(gpUridispatchGlobalState->pApplicationRoot))  );
 
@@ -396,12 +399,19 @@ struct _sg_uridispatchcontext
 	char * szStatusCode; // Status code returned by SSJS.
 	SG_uint64 responseLength;
 	SG_uint64 responseLength_chunked;
+	char * szResponseFile; // sendFile.path returned by SSJS. The server sends the body from this file itself.
+	SG_uint64 responseFileOffset;
 
 	SG_string * pIncomingJson;
 	SG_tempfile * pIncomingFile;
 	SG_cbuffer * pOutgoingChunk;
+
+	SG_arena * pArena; // Backs the parsed JSON body, if there is one. Freed all at once with the context.
 };
 
+// Incoming JSON bodies are usually small, so the arena gets small chunks.
+#define SG_URIDISPATCH_ARENA_CHUNK_SPACE (4*1024)
+
 // For when all else fails. This is not a valid dispatch context, so don't try to access its members.
 SG_uridispatchcontext * URIDISPATCHCONTEXT__MALLOC_FAILED = (SG_uridispatchcontext*)(void*)&URIDISPATCHCONTEXT__MALLOC_FAILED;
 #define SZ_MALLOC_FAILED "Memory allocation failure."
@@ -472,6 +482,7 @@ void _SG_uridispatchcontext__nullfree(SG_uridispatchcontext ** ppDispatchContext
 	}
 
 	SG_NULLFREE(pCtx, pDispatchContext->szStatusCode);
+	SG_NULLFREE(pCtx, pDispatchContext->szResponseFile);
 	SG_STRING_NULLFREE(pCtx, pDispatchContext->pIncomingJson);
 	if(pDispatchContext->pIncomingFile!=NULL)
 	{
@@ -485,6 +496,8 @@ void _SG_uridispatchcontext__nullfree(SG_uridispatchcontext ** ppDispatchContext
 	}
 	SG_cbuffer__nullfree(&pDispatchContext->pOutgoingChunk);
 
+	SG_ARENA_NULLFREE(pCtx, pDispatchContext->pArena);
+
 	SG_NULLFREE(pCtx, pDispatchContext);
 
 	*ppDispatchContext = NULL;
@@ -600,6 +613,8 @@ static void _sg_uridispatch__get_response_headers_from_SSJS_responseObject(SG_co
 	JSObject * headersObject;
 	jsval contentLengthVal;
 	char *szContentLength = NULL;
+	jsval sendFileVal;
+	jsval fileVal;
 
 	SG_vhash * pResponseHeaders = NULL;
 
@@ -635,6 +650,30 @@ static void _sg_uridispatch__get_response_headers_from_SSJS_responseObject(SG_co
 		SG_ERR_THROW2(SG_ERR_UNSPECIFIED, (pCtx, "Error retrieving Content-Length from response headers (value missing or of the wrong type?)."));
 	SG_ERR_CHECK(  SG_vhash__remove(pCtx, pResponseHeaders, "Content-Length")  );
 
+	// An optional sendFile: {path, offset} means "the body is Content-Length bytes of this file".
+	SG_NULLFREE(pCtx, pDispatchContext->szResponseFile);
+	pDispatchContext->responseFileOffset = 0;
+	ok = JS_GetProperty(pDispatchContext->pJs->cx, pDispatchContext->responseObject, "sendFile", &sendFileVal);
+	if(ok && JSVAL_IS_NONNULL_OBJECT(sendFileVal))
+	{
+		ok = JS_GetProperty(pDispatchContext->pJs->cx, JSVAL_TO_OBJECT(sendFileVal), "path", &fileVal);
+		if(!ok || !JSVAL_IS_STRING(fileVal))
+			SG_ERR_THROW2(SG_ERR_UNSPECIFIED, (pCtx, "The response's sendFile has no path."));
+		SG_ERR_CHECK(  sg_jsglue__jsstring_to_sz(pCtx, pDispatchContext->pJs->cx, JSVAL_TO_STRING(fileVal), &pDispatchContext->szResponseFile)  );
+
+		ok = JS_GetProperty(pDispatchContext->pJs->cx, JSVAL_TO_OBJECT(sendFileVal), "offset", &fileVal);
+		if(ok && JSVAL_IS_INT(fileVal) && JSVAL_TO_INT(fileVal)>=0)
+			pDispatchContext->responseFileOffset = JSVAL_TO_INT(fileVal);
+		else if(ok && JSVAL_IS_STRING(fileVal))
+		{
+			SG_ERR_CHECK(  sg_jsglue__jsstring_to_sz(pCtx, pDispatchContext->pJs->cx, JSVAL_TO_STRING(fileVal), &szContentLength)  );
+			SG_ERR_CHECK(  SG_uint64__parse__strict(pCtx, &pDispatchContext->responseFileOffset, szContentLength)  );
+			SG_NULLFREE(pCtx, szContentLength);
+		}
+		else if(ok && !JSVAL_IS_VOID(fileVal))
+			SG_ERR_THROW2(SG_ERR_UNSPECIFIED, (pCtx, "The response's sendFile has an offset of the wrong type."));
+	}
+
 	*ppStatusCode = pDispatchContext->szStatusCode;
 	*pContentLength = pDispatchContext->responseLength;
 	*ppResponseHeaders = pResponseHeaders;
@@ -1022,7 +1061,9 @@ static void _sg_uridispatch__on_after_last_chunk_received(SG_context * pCtx, SG_
 
 		if(JSVAL_IS_VOID(args[1]))
 		{
-			SG_veither__parse_json__buflen(pCtx, pJson, lenJson, &pVhash, &pVarray);
+			if(pDispatchContext->pArena==NULL)
+				SG_ERR_CHECK(  SG_ARENA__ALLOC(pCtx, &pDispatchContext->pArena, SG_URIDISPATCH_ARENA_CHUNK_SPACE)  );
+			SG_veither__parse_json__buflen__arena(pCtx, pDispatchContext->pArena, pJson, lenJson, &pVhash, &pVarray);
 			SG_ERR_CHECK_CURRENT_DISREGARD(SG_ERR_JSONPARSER_SYNTAX);
 			if(!SG_context__has_err(pCtx) && pVhash!=NULL)
 			{
@@ -1621,6 +1662,42 @@ fail:
 	return;
 }
 
+SG_bool SG_uridispatch__get_response_file(SG_uridispatchcontext * pDispatchContext, const char ** ppszPath, SG_uint64 * pOffset)
+{
+	SG_ASSERT(pDispatchContext!=NULL);
+	SG_ASSERT(ppszPath!=NULL);
+	SG_ASSERT(pOffset!=NULL);
+
+	if(pDispatchContext==URIDISPATCHCONTEXT__MALLOC_FAILED || pDispatchContext==URIDISPATCHCONTEXT__NO_pCtx_PROVIDED)
+		return SG_FALSE;
+	if(pDispatchContext->szResponseFile==NULL || pDispatchContext->szErrorMessage!=NULL)
+		return SG_FALSE;
+
+	*ppszPath = pDispatchContext->szResponseFile;
+	*pOffset = pDispatchContext->responseFileOffset;
+	return SG_TRUE;
+}
+
+void SG_uridispatch__response_file_sent(SG_uridispatchcontext ** ppDispatchContext, SG_bool bComplete)
+{
+	const SG_byte * pBuffer = NULL;
+	SG_uint32 bufferLength = 0;
+
+	SG_ASSERT(ppDispatchContext!=NULL && *ppDispatchContext!=NULL);
+
+	if(!bComplete)
+	{
+		// Not onFinish(). The response's finalize() gets called instead.
+		_SG_uridispatchcontext__nullfree(ppDispatchContext);
+		return;
+	}
+
+	// The whole body went out, so finish up just as if it had been chunked out.
+	(*ppDispatchContext)->responseLength_chunked = (*ppDispatchContext)->responseLength;
+	while(*ppDispatchContext!=NULL)
+		SG_uridispatch__chunk_response_body(ppDispatchContext, &pBuffer, &bufferLength);
+}
+
 void SG_uridispatch__abort(SG_uridispatchcontext ** ppDispatchContext)
 {
 	_SG_uridispatchcontext__nullfree(ppDispatchContext);
@@ -1633,6 +1710,7 @@ void SG_uridispatch__global_cleanup(SG_context * pCtx)
 	if(gpUridispatchGlobalState!=NULL)
 	{
 		SG_jscontextpool__teardown(pCtx);
+		SG_responsecache__global_cleanup();
 		SG_ERR_IGNORE(  _unregister_server_log_handler(pCtx, &gpUridispatchGlobalState->cLogData, &gpUridispatchGlobalState->cLogFileWriterData)  );
 
 		SG_VHASH_NULLFREE(pCtx, gpUridispatchGlobalState->pInclude);
@@ -27,6 +27,10 @@ struct _SG_varray
 	SG_variant** aSlots;
 	SG_uint32 space;
 	SG_uint32 count;
+
+	// Non-NULL if everything we own belongs to an arena.
+	// See SG_varray__alloc__arena().
+	SG_arena *pArena;
 };
 
 void SG_varray__count(SG_context* pCtx, const SG_varray* pva, SG_uint32* piResult)
@@ -41,10 +45,20 @@ void sg_varray__grow(SG_context* pCtx, SG_varray* pa)
 	SG_uint32 new_space = pa->space * 2;
 	SG_variant** new_aSlots = NULL;
 
-	SG_ERR_CHECK_RETURN(  SG_alloc(pCtx, new_space, sizeof(SG_variant*), &new_aSlots)  );
+	if (pa->pArena)
+	{
+		SG_ERR_CHECK_RETURN(  SG_arena__alloc_space(pCtx, pa->pArena, new_space, sizeof(SG_variant*), (void**)&new_aSlots)  );
+	}
+	else
+	{
+		SG_ERR_CHECK_RETURN(  SG_alloc(pCtx, new_space, sizeof(SG_variant*), &new_aSlots)  );
+	}
 
 	memcpy(new_aSlots, pa->aSlots, pa->count * sizeof(SG_variant*));
-	SG_NULLFREE(pCtx, pa->aSlots);
+	if (!pa->pArena)
+	{
+		SG_NULLFREE(pCtx, pa->aSlots);
+	}
 	pa->aSlots = new_aSlots;
 	pa->space = new_space;
 }
@@ -113,6 +127,80 @@ fail:
 	}
 }
 
+void SG_varray__alloc__arena(
+        SG_context* pCtx,
+        SG_varray** ppResult,
+        SG_uint32 initial_space,
+        SG_arena* pArena
+        )
+{
+	SG_varray * pThis = NULL;
+
+	SG_NULLARGCHECK_RETURN(ppResult);
+	SG_NULLARGCHECK_RETURN(pArena);
+
+	if (initial_space == 0u)
+	{
+		initial_space = guDefaultSize;
+	}
+
+	SG_ERR_CHECK_RETURN(  SG_arena__alloc_space(pCtx, pArena, 1, sizeof(SG_varray), (void**)&pThis)  );
+
+	pThis->pArena = pArena;
+	SG_ERR_CHECK_RETURN(  SG_arena__get_pools(pCtx, pArena, &pThis->pStrPool, &pThis->pVarPool)  );
+	pThis->strpool_is_mine = SG_FALSE;
+	pThis->varpool_is_mine = SG_FALSE;
+
+	pThis->space = initial_space;
+	SG_ERR_CHECK_RETURN(  SG_arena__alloc_space(pCtx, pArena, pThis->space, sizeof(SG_variant *), (void**)&pThis->aSlots)  );
+
+	*ppResult = pThis;
+}
+
+void SG_varray__get_arena(
+        SG_context* pCtx,
+        const SG_varray* pva,
+        SG_arena** ppArena
+        )
+{
+	SG_NULLARGCHECK_RETURN(pva);
+	SG_NULLARGCHECK_RETURN(ppArena);
+
+	*ppArena = pva->pArena;
+}
+
+/**
+ * When an arena-backed varray takes ownership of a vhash or varray
+ * which did not come from the arena, hand it to the arena so that
+ * it gets freed along with everything else.
+ */
+static void sg_varray__adopt(SG_context* pCtx, const SG_varray* pva, SG_variant* pv)
+{
+	SG_arena* pArenaChild = NULL;
+
+	if (!pva->pArena)
+	{
+		return;
+	}
+
+	switch (pv->type)
+	{
+	case SG_VARIANT_TYPE_VARRAY:
+		if (!pv->v.val_varray->pArena)
+		{
+			SG_ERR_CHECK_RETURN(  SG_arena__adopt(pCtx, pva->pArena, pv->v.val_varray, (SG_free_callback *)SG_varray__free)  );
+		}
+		break;
+	case SG_VARIANT_TYPE_VHASH:
+		SG_ERR_CHECK_RETURN(  SG_vhash__get_arena(pCtx, pv->v.val_vhash, &pArenaChild)  );
+		if (!pArenaChild)
+		{
+			SG_ERR_CHECK_RETURN(  SG_arena__adopt(pCtx, pva->pArena, pv->v.val_vhash, (SG_free_callback *)SG_vhash__free)  );
+		}
+		break;
+	}
+}
+
 void SG_varray__alloc__shared(
         SG_context* pCtx,
         SG_varray** ppResult,
@@ -185,6 +273,12 @@ void SG_varray__free(SG_context * pCtx, SG_varray* pThis)
 		return;
 	}
 
+	if (pThis->pArena)
+	{
+		// the arena will take care of it
+		return;
+	}
+
 	for (i=0; i<pThis->count; i++)
 	{
 		switch (pThis->aSlots[i]->type)
@@ -238,15 +332,19 @@ void SG_varray__remove(SG_context *pCtx, SG_varray *pThis, SG_uint32 idx)
 		SG_ERR_THROW_RETURN(SG_ERR_VARRAY_INDEX_OUT_OF_RANGE);
 	}
 
-	switch (pThis->aSlots[idx]->type)
+	// arena-backed children (and adopted ones) go away with the arena
+	if (!pThis->pArena)
 	{
-		case SG_VARIANT_TYPE_VARRAY:
-			SG_VARRAY_NULLFREE(pCtx, pThis->aSlots[idx]->v.val_varray);
-			break;
-		case SG_VARIANT_TYPE_VHASH:
-			SG_VHASH_NULLFREE(pCtx, pThis->aSlots[idx]->v.val_vhash);
-			break;
-	}	
+		switch (pThis->aSlots[idx]->type)
+		{
+			case SG_VARIANT_TYPE_VARRAY:
+				SG_VARRAY_NULLFREE(pCtx, pThis->aSlots[idx]->v.val_varray);
+				break;
+			case SG_VARIANT_TYPE_VHASH:
+				SG_VHASH_NULLFREE(pCtx, pThis->aSlots[idx]->v.val_vhash);
+				break;
+		}
+	}
 
 	for ( i = idx; i < pThis->count - 1; ++i )
 	{
@@ -324,7 +422,14 @@ void SG_varray__appendnew__vhash(SG_context* pCtx, SG_varray* pva, SG_vhash** pp
 
 	SG_NULLARGCHECK_RETURN(pva);
 
-    SG_ERR_CHECK(  SG_vhash__alloc__params(pCtx, &pvh_sub, 0, pva->pStrPool, pva->pVarPool)  );
+    if (pva->pArena)
+    {
+        SG_ERR_CHECK(  SG_vhash__alloc__arena(pCtx, &pvh_sub, 0, pva->pArena)  );
+    }
+    else
+    {
+        SG_ERR_CHECK(  SG_vhash__alloc__params(pCtx, &pvh_sub, 0, pva->pStrPool, pva->pVarPool)  );
+    }
     pvh_result = pvh_sub;
     SG_ERR_CHECK(  SG_varray__append__vhash(pCtx, pva, &pvh_sub)  );
 
@@ -347,6 +452,7 @@ void SG_varray__append__vhash(SG_context* pCtx, SG_varray* pva, SG_vhash** ppvh)
 
     pv->type = SG_VARIANT_TYPE_VHASH;
     pv->v.val_vhash = *ppvh;
+    SG_ERR_CHECK_RETURN(  sg_varray__adopt(pCtx, pva, pv)  );
     *ppvh = NULL;
 }
 
@@ -357,7 +463,14 @@ void SG_varray__appendnew__varray(SG_context* pCtx, SG_varray* pva, SG_varray**
 
 	SG_NULLARGCHECK_RETURN(pva);
 
-	SG_ERR_CHECK(  SG_varray__alloc__params(pCtx, &pva_sub, 4, pva->pStrPool, pva->pVarPool)  );
+	if (pva->pArena)
+	{
+		SG_ERR_CHECK(  SG_varray__alloc__arena(pCtx, &pva_sub, 4, pva->pArena)  );
+	}
+	else
+	{
+		SG_ERR_CHECK(  SG_varray__alloc__params(pCtx, &pva_sub, 4, pva->pStrPool, pva->pVarPool)  );
+	}
     pva_result = pva_sub;
     SG_ERR_CHECK(  SG_varray__append__varray(pCtx, pva, &pva_sub)  );
 
@@ -381,6 +494,7 @@ void SG_varray__append__varray(SG_context* pCtx, SG_varray* pva, SG_varray** ppv
 
     pv->type = SG_VARIANT_TYPE_VARRAY;
     pv->v.val_varray = *ppva;
+    SG_ERR_CHECK_RETURN(  sg_varray__adopt(pCtx, pva, pv)  );
     *ppva = NULL;
 }
 
@@ -1088,6 +1202,12 @@ void SG_varray__steal_the_pools(
 {
     SG_NULLARGCHECK_RETURN(pva);
 
+    if (pva->pArena)
+    {
+        // the pools belong to the arena
+        return;
+    }
+
     pva->strpool_is_mine = SG_TRUE;
     pva->varpool_is_mine = SG_TRUE;
 }
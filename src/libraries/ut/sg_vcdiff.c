@@ -1050,6 +1050,8 @@ fail:
 
 void SG_vcdiff__undeltify__chunk(SG_context* pCtx, SG_vcdiff_undeltify_state* pst, SG_byte** ppResult, SG_uint32* pi_got)
 {
+    SG_int64 tPerf = SG_perf__start();
+
     sg_vcdiff_window__reset(&pst->window);
     SG_ERR_CHECK(  sg_vcdiff__read_window(pCtx, &pst->window, pst->pstrm_delta, DECODE_MAX_WINDOW_SIZE)  );
 
@@ -1072,6 +1074,8 @@ void SG_vcdiff__undeltify__chunk(SG_context* pCtx, SG_vcdiff_undeltify_state* ps
     *ppResult = pst->window.WindowBuffer + pst->window.SourceSize;
     *pi_got = pst->window.TargetWinSize;
 
+    SG_perf__stop(SG_PERF_CATEGORY__BLOB_UNDELTIFY, tPerf, pst->window.TargetWinSize);
+
 fail:
     return;
 }
@@ -16,10 +16,30 @@ limitations under the License.
 
 #include <sg.h>
 
-// 8 buckets is enough for audit, stamp, tag, comment or sup
+// 8 slots is enough for audit, stamp, tag, comment or sup
 
 #define sg_VHASH_NUM_BUILTIN (8)
 
+// By default the index is open-addressed.  Every slot has a control byte and
+// the position of its item in aItems.  A control byte of zero means
+// the slot is empty.  Otherwise it holds the high bit plus the top 7
+// bits of the hash of the key, so most non-matching slots can be
+// rejected without touching the item (or the key) at all.
+//
+// Slots are probed a group at a time.  A group is 8 control bytes,
+// loaded as one SG_uint64 and tested for a match (or for an empty
+// slot) all at once.  The groups are visited in triangular order,
+// which visits every group when the number of groups is a power of 2.
+//
+// There are no tombstones.  remove already shifts aItems down, which
+// changes the positions, so it rebuilds the index anyway.
+//
+// Building with SG_VHASH_CHAINED defined brings back the older index,
+// an array of buckets chained through the items, so that the two can
+// be compared (see "vvbench vhash").
+
+#if defined(SG_VHASH_CHAINED)
+
 typedef struct _sg_hashitem
 {
 	const char* key;            // points into the strpool
@@ -33,6 +53,24 @@ typedef struct _sg_hashbucket
     sg_hashitem* head;
 } sg_hashbucket;
 
+#else
+
+#define sg_VHASH_GROUP_WIDTH (8)
+
+#define sg_VHASH_GROUP_LSBS  (0x0101010101010101ULL)
+#define sg_VHASH_GROUP_MSBS  (0x8080808080808080ULL)
+
+#define sg_VHASH_CTRL(hash32)   ((SG_uint8)(0x80 | ((hash32) >> 25)))
+
+typedef struct _sg_hashitem
+{
+	const char* key;            // points into the strpool
+    SG_uint32 hash32;           // so we can just mask on rehash
+    SG_variant* pVariant;       // points into the varpool
+} sg_hashitem;
+
+#endif
+
 struct _SG_vhash
 {
 	SG_uint32 count;
@@ -43,23 +81,44 @@ struct _SG_vhash
 	SG_varpool *pVarPool;
 	SG_bool varpool_is_mine;
 
-	SG_uint32 space;
+	// If we were allocated from an arena, then everything
+	// (us, our items and buckets, our pools and any nested
+	// vhashes/varrays) belongs to the arena and is released
+	// when the arena is freed, not when we are.
+	SG_arena *pArena;
 
-	sg_hashitem* aItems;
+	SG_uint32 space;            // for aItems and the index
+
+	sg_hashitem* aItems;        // in insertion (or sorted) order
+#if defined(SG_VHASH_CHAINED)
 	sg_hashbucket* aBuckets;
     SG_uint32 bucket_mask;
 
     sg_hashbucket builtin_buckets[sg_VHASH_NUM_BUILTIN];
+#else
+	SG_uint8* aCtrl;
+	SG_uint32* aSlots;          // index into aItems
+    SG_uint32 group_mask;
+
+    SG_uint8 builtin_ctrl[sg_VHASH_NUM_BUILTIN];
+    SG_uint32 builtin_slots[sg_VHASH_NUM_BUILTIN];
+#endif
     sg_hashitem builtin_items[sg_VHASH_NUM_BUILTIN];
 };
 
-void sg_vhash_variant__freecontents(SG_context * pCtx, SG_variant* pv)
+void sg_vhash_variant__freecontents(SG_context * pCtx, const SG_vhash* pvh, SG_variant* pv)
 {
     if (!pv)
     {
         return;
     }
 
+    if (pvh->pArena)
+    {
+        // the arena owns (or has adopted) anything we point to
+        return;
+    }
+
 	switch (pv->type)
 	{
 	case SG_VARIANT_TYPE_VARRAY:
@@ -71,6 +130,33 @@ void sg_vhash_variant__freecontents(SG_context * pCtx, SG_variant* pv)
 	}
 }
 
+/**
+ * When an arena-backed vhash takes ownership of a vhash or varray
+ * which did not come from the arena, hand it to the arena so that
+ * it gets freed along with everything else.
+ */
+static void sg_vhash__adopt__vhash(SG_context * pCtx, const SG_vhash* pvh, SG_vhash* pvh_child)
+{
+    if (pvh->pArena && !pvh_child->pArena)
+    {
+        SG_ERR_CHECK_RETURN(  SG_arena__adopt(pCtx, pvh->pArena, pvh_child, (SG_free_callback *)SG_vhash__free)  );
+    }
+}
+
+static void sg_vhash__adopt__varray(SG_context * pCtx, const SG_vhash* pvh, SG_varray* pva_child)
+{
+    SG_arena* pArenaChild = NULL;
+
+    if (pvh->pArena)
+    {
+        SG_ERR_CHECK_RETURN(  SG_varray__get_arena(pCtx, pva_child, &pArenaChild)  );
+        if (!pArenaChild)
+        {
+            SG_ERR_CHECK_RETURN(  SG_arena__adopt(pCtx, pvh->pArena, pva_child, (SG_free_callback *)SG_varray__free)  );
+        }
+    }
+}
+
 SG_uint8 sg_vhash__calc_bits_for_guess(SG_uint32 guess)
 {
 	SG_uint8 log = 1;
@@ -235,10 +321,144 @@ void SG_vhash__steal_the_pools(
 {
     SG_NULLARGCHECK_RETURN(pvh);
 
+    if (pvh->pArena)
+    {
+        // the pools belong to the arena
+        return;
+    }
+
     pvh->strpool_is_mine = SG_TRUE;
     pvh->varpool_is_mine = SG_TRUE;
 }
 
+static void sg_vhash__alloc_space(
+        SG_context* pCtx, 
+        SG_arena* pArena, 
+        SG_uint32 count,
+        SG_uint32 size,
+        void* ppResult
+        )
+{
+    if (pArena)
+    {
+        SG_ERR_CHECK_RETURN(  SG_arena__alloc_space(pCtx, pArena, count, size, (void**)ppResult)  );
+    }
+    else
+    {
+        SG_ERR_CHECK_RETURN(  SG_alloc(pCtx, count, size, ppResult)  );
+    }
+}
+
+#if defined(SG_VHASH_CHAINED)
+
+static void sg_vhash__index__use_builtin(SG_vhash* pvh)
+{
+    pvh->aBuckets = pvh->builtin_buckets;
+    pvh->bucket_mask = pvh->space - 1;
+}
+
+static void sg_vhash__index__alloc(SG_context* pCtx, SG_vhash* pvh)
+{
+    SG_ERR_CHECK_RETURN(  sg_vhash__alloc_space(pCtx, pvh->pArena, pvh->space, sizeof(sg_hashbucket), &pvh->aBuckets)  );
+    pvh->bucket_mask = pvh->space - 1;
+}
+
+static void sg_vhash__index__free(SG_context* pCtx, SG_vhash* pvh)
+{
+    if ((pvh->aBuckets != pvh->builtin_buckets) && !pvh->pArena)
+    {
+        SG_NULLFREE(pCtx, pvh->aBuckets);
+    }
+    pvh->aBuckets = NULL;
+}
+
+#else
+
+static void sg_vhash__index__use_builtin(SG_vhash* pvh)
+{
+    pvh->aCtrl = pvh->builtin_ctrl;
+    pvh->aSlots = pvh->builtin_slots;
+    pvh->group_mask = (pvh->space / sg_VHASH_GROUP_WIDTH) - 1;
+}
+
+static void sg_vhash__index__alloc(SG_context* pCtx, SG_vhash* pvh)
+{
+    SG_ERR_CHECK_RETURN(  sg_vhash__alloc_space(pCtx, pvh->pArena, pvh->space, sizeof(SG_uint8), &pvh->aCtrl)  );
+    SG_ERR_CHECK_RETURN(  sg_vhash__alloc_space(pCtx, pvh->pArena, pvh->space, sizeof(SG_uint32), &pvh->aSlots)  );
+    pvh->group_mask = (pvh->space / sg_VHASH_GROUP_WIDTH) - 1;
+}
+
+static void sg_vhash__index__free(SG_context* pCtx, SG_vhash* pvh)
+{
+    if (!pvh->pArena)
+    {
+        if (pvh->aCtrl != pvh->builtin_ctrl)
+        {
+            SG_NULLFREE(pCtx, pvh->aCtrl);
+        }
+        if (pvh->aSlots != pvh->builtin_slots)
+        {
+            SG_NULLFREE(pCtx, pvh->aSlots);
+        }
+    }
+    pvh->aCtrl = NULL;
+    pvh->aSlots = NULL;
+}
+
+#endif
+
+void SG_vhash__alloc__arena(
+        SG_context* pCtx, 
+        SG_vhash** ppResult, 
+        SG_uint32 guess,
+        SG_arena* pArena
+        )
+{
+	SG_vhash * pvh = NULL;
+	SG_strpool* pStrPool = NULL;
+	SG_varpool* pVarPool = NULL;
+
+	SG_NULLARGCHECK_RETURN(ppResult);
+	SG_NULLARGCHECK_RETURN(pArena);
+
+	SG_ERR_CHECK_RETURN(  SG_arena__get_pools(pCtx, pArena, &pStrPool, &pVarPool)  );
+	SG_ERR_CHECK_RETURN(  SG_arena__alloc_space(pCtx, pArena, 1, sizeof(SG_vhash), (void**)&pvh)  );
+
+	pvh->pArena = pArena;
+	pvh->pStrPool = pStrPool;
+	pvh->strpool_is_mine = SG_FALSE;
+	pvh->pVarPool = pVarPool;
+	pvh->varpool_is_mine = SG_FALSE;
+
+    if (0 == guess)
+    {
+        pvh->space = sg_VHASH_NUM_BUILTIN;
+        sg_vhash__index__use_builtin(pvh);
+        pvh->aItems = pvh->builtin_items;
+    }
+    else
+    {
+        pvh->space = (1 << sg_vhash__calc_bits_for_guess(guess));
+
+        SG_ERR_CHECK_RETURN(  sg_vhash__index__alloc(pCtx, pvh)  );
+        SG_ERR_CHECK_RETURN(  SG_arena__alloc_space(pCtx, pArena, pvh->space, sizeof(sg_hashitem), (void**)&pvh->aItems)  );
+    }
+
+	*ppResult = pvh;
+}
+
+void SG_vhash__get_arena(
+        SG_context* pCtx, 
+        const SG_vhash* pvh, 
+        SG_arena** ppArena
+        )
+{
+	SG_NULLARGCHECK_RETURN(pvh);
+	SG_NULLARGCHECK_RETURN(ppArena);
+
+	*ppArena = pvh->pArena;
+}
+
 void SG_vhash__alloc__params(
         SG_context* pCtx, 
         SG_vhash** ppResult, 
@@ -276,17 +496,16 @@ void SG_vhash__alloc__params(
     if (0 == guess)
     {
         pvh->space = sg_VHASH_NUM_BUILTIN;
-        pvh->aBuckets = pvh->builtin_buckets;
+        sg_vhash__index__use_builtin(pvh);
         pvh->aItems = pvh->builtin_items;
     }
     else
     {
         pvh->space = (1 << sg_vhash__calc_bits_for_guess(guess));
 
-        SG_ERR_CHECK(  SG_alloc(pCtx, pvh->space, sizeof(sg_hashbucket), &pvh->aBuckets)  );
+        SG_ERR_CHECK(  sg_vhash__index__alloc(pCtx, pvh)  );
         SG_ERR_CHECK(  SG_alloc(pCtx, pvh->space, sizeof(sg_hashitem), &pvh->aItems)  );
     }
-    pvh->bucket_mask = pvh->space - 1;
 
 	*ppResult = pvh;
     pvh = NULL;
@@ -305,6 +524,12 @@ void SG_vhash__free(SG_context * pCtx, SG_vhash* pvh)
 	if (!pvh)
 		return;
 
+	if (pvh->pArena)
+	{
+		// the arena will take care of it
+		return;
+	}
+
     //printf("vhash_count\t%06d\n", pvh->count);
 
 	if (pvh->aItems)
@@ -313,7 +538,7 @@ void SG_vhash__free(SG_context * pCtx, SG_vhash* pvh)
 
         for (i=0; i<pvh->space; i++)
         {
-            sg_vhash_variant__freecontents(pCtx, pvh->aItems[i].pVariant);
+            sg_vhash_variant__freecontents(pCtx, pvh, pvh->aItems[i].pVariant);
         }
 
         if (pvh->aItems != pvh->builtin_items)
@@ -322,10 +547,7 @@ void SG_vhash__free(SG_context * pCtx, SG_vhash* pvh)
         }
 	}
 
-    if (pvh->aBuckets != pvh->builtin_buckets)
-    {
-        SG_NULLFREE(pCtx, pvh->aBuckets);
-    }
+    sg_vhash__index__free(pCtx, pvh);
 
 	if (pvh->strpool_is_mine)
 	{
@@ -609,110 +831,242 @@ not_hex:
 
 // http://www.burtleburtle.net/bob/hash/doobs.html
 
-static void sg_hashbucket__add__hashitem(
-        SG_context* pCtx, 
-        sg_hashbucket* pbuck, 
-        sg_hashitem* pNew
+#if defined(SG_VHASH_CHAINED)
+
+/**
+ * Walks the chain for hash32.  If the key is present, its position
+ * in aItems is returned in *pi_item.  Otherwise *pi_item is set to -1.
+ * Either way, if pi_slot is not NULL, *pi_slot is the bucket.
+ */
+static void sg_vhash__probe(
+        const SG_vhash* pvh,
+        const char* psz_key,
+        SG_uint32 hash32,
+        SG_int32* pi_item,
+        SG_uint32* pi_slot
         )
 {
-	if (!(pbuck->head))
-	{
-        pbuck->head = pNew;
-	}
-	else
-	{
-		sg_hashitem* pCur = pbuck->head;
-		sg_hashitem* pPrev = NULL;
+    SG_uint32 iBucket = hash32 & pvh->bucket_mask;
+    const sg_hashitem* pCur = pvh->aBuckets[iBucket].head;
 
-		while (pCur)
-		{
-			int cmp = strcmp(pNew->key, pCur->key);
-			if (cmp == 0)
-			{
-				SG_ERR_THROW2_RETURN(  SG_ERR_VHASH_DUPLICATEKEY, (pCtx, "%s", pNew->key)  );
-			}
-			else if (cmp < 0)
-			{
-				// put pv before this one
-				if (pPrev)
-				{
-					pPrev->pNext = pNew;
-				}
-				else
-				{
-					pbuck->head = pNew;
-				}
-
-				pNew->pNext = pCur;
-				return;
-			}
-			else
-			{
-				pPrev = pCur;
-				pCur = pCur->pNext;
-			}
-		}
-		pPrev->pNext = pNew;
-	}
+    if (pi_slot)
+    {
+        *pi_slot = iBucket;
+    }
+
+    while (pCur)
+    {
+        int cmp = strcmp(psz_key, pCur->key);
+        if (cmp == 0)
+        {
+            *pi_item = (SG_int32) (pCur - pvh->aItems);
+            return;
+        }
+        else if (cmp < 0)
+        {
+            // the chains are sorted
+            break;
+        }
+        pCur = pCur->pNext;
+    }
+
+    *pi_item = -1;
 }
 
-void sg_vhash__rehash__same_buckets(
-        SG_context* pCtx, 
-        SG_vhash* pvh
+static void sg_vhash__index__set(
+        SG_vhash* pvh,
+        SG_uint32 i_slot,
+        SG_uint32 i_item
         )
 {
-    SG_uint32 i = 0;
-
-    SG_NULLARGCHECK_RETURN(pvh);
+    sg_hashitem* pNew = &pvh->aItems[i_item];
+    sg_hashitem** ppCur = &pvh->aBuckets[i_slot].head;
 
-    for (i=0; i<pvh->space; i++)
+    while (*ppCur && (strcmp((*ppCur)->key, pNew->key) < 0))
     {
-        pvh->aBuckets[i].head = NULL;
+        ppCur = &(*ppCur)->pNext;
     }
 
-    // rehash everything
+    pNew->pNext = *ppCur;
+    *ppCur = pNew;
+}
+
+static void sg_vhash__index__rebuild(SG_vhash* pvh)
+{
+    SG_uint32 i = 0;
+
+    memset(pvh->aBuckets, 0, pvh->space * sizeof(sg_hashbucket));
+
     for (i=0; i<pvh->count; i++)
     {
-        sg_hashitem* p = &pvh->aItems[i];
-        SG_uint32 iBucket = p->hash32 & pvh->bucket_mask;
-        p->pNext = NULL;
-        SG_ERR_CHECK(  sg_hashbucket__add__hashitem(pCtx, &pvh->aBuckets[iBucket], p)  );
+        sg_vhash__index__set(pvh, pvh->aItems[i].hash32 & pvh->bucket_mask, i);
     }
+}
 
-fail:
-    // TODO what should we do here?  do we need to leave the vhash
-    // in a usable state?  can we?
-    ;
+#else
+
+/**
+ * Returns a mask with the high bit set in each byte of the group
+ * which equals b.  It can have false positives (a byte following a
+ * match), never false negatives, so callers must check each candidate.
+ */
+static SG_uint64 sg_vhash__group__match(SG_uint64 group, SG_uint8 b)
+{
+    SG_uint64 x = group ^ (sg_VHASH_GROUP_LSBS * b);
+
+    return (x - sg_VHASH_GROUP_LSBS) & ~x & sg_VHASH_GROUP_MSBS;
 }
 
-void sg_vhash__rehash__new_buckets(
-        SG_context* pCtx, 
-        SG_vhash* pvh
-        )
+static SG_uint64 sg_vhash__group__load(const SG_vhash* pvh, SG_uint32 iGroup)
 {
-    SG_uint32 i = 0;
+    SG_uint64 group;
 
-    SG_NULLARGCHECK_RETURN(pvh);
+    // memcpy rather than a cast so that we don't care about alignment
+    memcpy(&group, pvh->aCtrl + (iGroup * sg_VHASH_GROUP_WIDTH), sizeof(group));
 
-    if (pvh->aBuckets != pvh->builtin_buckets)
+    return group;
+}
+
+/**
+ * Walks the probe sequence for hash32.  If the key is present, its
+ * position in aItems is returned in *pi_item.  Otherwise *pi_item is
+ * set to -1 and, if pi_slot is not NULL, *pi_slot is the first empty
+ * slot on the probe sequence, which is where the key belongs.
+ */
+static void sg_vhash__probe(
+        const SG_vhash* pvh,
+        const char* psz_key,
+        SG_uint32 hash32,
+        SG_int32* pi_item,
+        SG_uint32* pi_slot
+        )
+{
+    SG_uint8 ctrl = sg_VHASH_CTRL(hash32);
+    SG_uint32 iGroup = hash32 & pvh->group_mask;
+    SG_uint32 step = 0;
+
+    while (1)
     {
-        SG_NULLFREE(pCtx, pvh->aBuckets);
+        SG_uint64 group = sg_vhash__group__load(pvh, iGroup);
+        SG_uint32 iFirst = iGroup * sg_VHASH_GROUP_WIDTH;
+        SG_uint32 j;
+
+        if (sg_vhash__group__match(group, ctrl))
+        {
+            for (j=0; j<sg_VHASH_GROUP_WIDTH; j++)
+            {
+                if (pvh->aCtrl[iFirst + j] == ctrl)
+                {
+                    SG_uint32 i_item = pvh->aSlots[iFirst + j];
+                    const sg_hashitem* phit = &pvh->aItems[i_item];
+
+                    if (
+                            (phit->hash32 == hash32)
+                            && (0 == strcmp(psz_key, phit->key))
+                       )
+                    {
+                        *pi_item = (SG_int32) i_item;
+                        return;
+                    }
+                }
+            }
+        }
+
+        if (sg_vhash__group__match(group, 0))
+        {
+            // an empty slot ends the probe sequence
+            *pi_item = -1;
+            if (pi_slot)
+            {
+                for (j=0; j<sg_VHASH_GROUP_WIDTH; j++)
+                {
+                    if (0 == pvh->aCtrl[iFirst + j])
+                    {
+                        *pi_slot = iFirst + j;
+                        break;
+                    }
+                }
+            }
+            return;
+        }
+
+        step++;
+        iGroup = (iGroup + step) & pvh->group_mask;
     }
-    SG_ERR_CHECK(  SG_alloc(pCtx, pvh->space, sizeof(sg_hashbucket), &pvh->aBuckets)  );
+}
+
+static void sg_vhash__index__set(
+        SG_vhash* pvh,
+        SG_uint32 i_slot,
+        SG_uint32 i_item
+        )
+{
+    pvh->aCtrl[i_slot] = sg_VHASH_CTRL(pvh->aItems[i_item].hash32);
+    pvh->aSlots[i_slot] = i_item;
+}
+
+/**
+ * Rebuild the index from aItems.  The keys are known to be unique,
+ * so there are no string compares, just a search for an empty slot.
+ */
+static void sg_vhash__index__rebuild(SG_vhash* pvh)
+{
+    SG_uint32 i = 0;
+
+    memset(pvh->aCtrl, 0, pvh->space);
 
-    // rehash everything
     for (i=0; i<pvh->count; i++)
     {
-        sg_hashitem* p = &pvh->aItems[i];
-        SG_uint32 iBucket = p->hash32 & pvh->bucket_mask;
-        p->pNext = NULL;
-        SG_ERR_CHECK(  sg_hashbucket__add__hashitem(pCtx, &pvh->aBuckets[iBucket], p)  );
+        SG_uint32 hash32 = pvh->aItems[i].hash32;
+        SG_uint32 iGroup = hash32 & pvh->group_mask;
+        SG_uint32 step = 0;
+        SG_uint64 empties;
+
+        while (0 == (empties = sg_vhash__group__match(sg_vhash__group__load(pvh, iGroup), 0)))
+        {
+            step++;
+            iGroup = (iGroup + step) & pvh->group_mask;
+        }
+
+        {
+            SG_uint32 iFirst = iGroup * sg_VHASH_GROUP_WIDTH;
+            SG_uint32 j;
+
+            for (j=0; j<sg_VHASH_GROUP_WIDTH; j++)
+            {
+                if (0 == pvh->aCtrl[iFirst + j])
+                {
+                    sg_vhash__index__set(pvh, iFirst + j, i);
+                    break;
+                }
+            }
+        }
     }
+}
 
-fail:
-    // TODO what should we do here?  do we need to leave the vhash
-    // in a usable state?  can we?
-    ;
+#endif
+
+void sg_vhash__rehash__same_buckets(
+        SG_context* pCtx, 
+        SG_vhash* pvh
+        )
+{
+    SG_NULLARGCHECK_RETURN(pvh);
+
+    sg_vhash__index__rebuild(pvh);
+}
+
+void sg_vhash__rehash__new_buckets(
+        SG_context* pCtx, 
+        SG_vhash* pvh
+        )
+{
+    SG_NULLARGCHECK_RETURN(pvh);
+
+    sg_vhash__index__free(pCtx, pvh);
+    SG_ERR_CHECK_RETURN(  sg_vhash__index__alloc(pCtx, pvh)  );
+
+    sg_vhash__index__rebuild(pvh);
 }
 
 void sg_vhash__grow(
@@ -723,16 +1077,15 @@ void sg_vhash__grow(
     SG_uint32 new_space = 4 * pvh->space;
     sg_hashitem* new_aKeys = NULL;
 
-    SG_ERR_CHECK_RETURN(  SG_alloc(pCtx, new_space, sizeof(sg_hashitem), &new_aKeys)  );
+    SG_ERR_CHECK_RETURN(  sg_vhash__alloc_space(pCtx, pvh->pArena, new_space, sizeof(sg_hashitem), &new_aKeys)  );
 
     memcpy((char **)new_aKeys, pvh->aItems, pvh->count * sizeof(sg_hashitem));
-    if (pvh->aItems != pvh->builtin_items)
+    if ((pvh->aItems != pvh->builtin_items) && !pvh->pArena)
     {
         SG_NULLFREE(pCtx, pvh->aItems);
     }
     pvh->aItems = new_aKeys;
     pvh->space = new_space;
-    pvh->bucket_mask = pvh->space - 1;
 
     SG_ERR_CHECK_RETURN(  sg_vhash__rehash__new_buckets(pCtx, pvh)  );
 }
@@ -744,8 +1097,10 @@ static void sg_vhash__add(
         SG_variant* pv
         )
 {
-	SG_int32 iBucket = -1;
     sg_hashitem* phit = NULL;
+    SG_uint32 hash32 = 0;
+    SG_int32 i_item = -1;
+    SG_uint32 i_slot = 0;
 
 	SG_NULLARGCHECK_RETURN(psz_key);
 
@@ -754,14 +1109,19 @@ static void sg_vhash__add(
         SG_ERR_CHECK(  sg_vhash__grow(pCtx, pvh)  );
     }
 
+    hash32 = sg_vhash__hashlittle((SG_uint8*)psz_key, strlen(psz_key));
+    sg_vhash__probe(pvh, psz_key, hash32, &i_item, &i_slot);
+    if (i_item >= 0)
+    {
+        SG_ERR_THROW2_RETURN(  SG_ERR_VHASH_DUPLICATEKEY, (pCtx, "%s", psz_key)  );
+    }
+
     phit = &(pvh->aItems[pvh->count]);
 	SG_ERR_CHECK(  SG_strpool__add__sz(pCtx, pvh->pStrPool, psz_key, &phit->key)  );
-    phit->hash32 = sg_vhash__hashlittle((SG_uint8*)phit->key, strlen(phit->key));
+    phit->hash32 = hash32;
     phit->pVariant = pv;
-    phit->pNext = NULL;
 
-	iBucket = phit->hash32 & (pvh->bucket_mask);
-    SG_ERR_CHECK(  sg_hashbucket__add__hashitem(pCtx, &pvh->aBuckets[iBucket], phit)  );
+    sg_vhash__index__set(pvh, i_slot, pvh->count);
     pvh->count++;
 
 fail:
@@ -783,30 +1143,13 @@ void sg_vhash__find(
     }
     else
     {
-        SG_uint32 iBucket = sg_vhash__hashlittle((SG_uint8*)psz_key, strlen(psz_key)) & (pvh->bucket_mask);
-        sg_hashitem* pCur = pvh->aBuckets[iBucket].head;
+        SG_int32 i_item = -1;
 
         SG_UNUSED(pCtx);
 
-        while (pCur)
-        {
-            int cmp = strcmp(psz_key, pCur->key);
-            if (cmp == 0)
-            {
-                *ppResult = pCur;
-                return;
-            }
-            else if (cmp < 0)
-            {
-                *ppResult = NULL;
-                return;
-            }
-            else
-            {
-                pCur = pCur->pNext;
-            }
-        }
-        *ppResult = NULL;
+        sg_vhash__probe(pvh, psz_key, sg_vhash__hashlittle((SG_uint8*)psz_key, strlen(psz_key)), &i_item, NULL);
+
+        *ppResult = (i_item >= 0) ? &pvh->aItems[i_item] : NULL;
     }
 }
 
@@ -839,7 +1182,7 @@ void SG_vhash__update__string__buflen(
 			return;
 		}
 
-		sg_vhash_variant__freecontents(pCtx, phit->pVariant);
+		sg_vhash_variant__freecontents(pCtx, pvh, phit->pVariant);
 
 		phit->pVariant->type = SG_VARIANT_TYPE_SZ;
 
@@ -870,7 +1213,7 @@ void SG_vhash__update__int64(
 		return;
 	}
 
-    sg_vhash_variant__freecontents(pCtx, phit->pVariant);
+    sg_vhash_variant__freecontents(pCtx, pvh, phit->pVariant);
 
 	phit->pVariant->type = SG_VARIANT_TYPE_INT64;
 	phit->pVariant->v.val_int64 = ival;
@@ -892,7 +1235,7 @@ void SG_vhash__update__double(
 		return;
 	}
 
-    sg_vhash_variant__freecontents(pCtx, phit->pVariant);
+    sg_vhash_variant__freecontents(pCtx, pvh, phit->pVariant);
 
 	phit->pVariant->type = SG_VARIANT_TYPE_DOUBLE;
 	phit->pVariant->v.val_double = val;
@@ -914,7 +1257,7 @@ void SG_vhash__update__bool(
 		return;
 	}
 
-    sg_vhash_variant__freecontents(pCtx, phit->pVariant);
+    sg_vhash_variant__freecontents(pCtx, pvh, phit->pVariant);
 
 	phit->pVariant->type = SG_VARIANT_TYPE_BOOL;
 	phit->pVariant->v.val_bool = val;
@@ -938,7 +1281,8 @@ void SG_vhash__update__vhash(
 			return;
 		}
 
-        sg_vhash_variant__freecontents(pCtx, phit->pVariant);
+        SG_ERR_CHECK_RETURN(  sg_vhash__adopt__vhash(pCtx, pvh, *ppvh_val)  );
+        sg_vhash_variant__freecontents(pCtx, pvh, phit->pVariant);
 
 		phit->pVariant->type = SG_VARIANT_TYPE_VHASH;
 		phit->pVariant->v.val_vhash = *ppvh_val;
@@ -967,7 +1311,8 @@ void SG_vhash__update__varray(
 			return;
 		}
 
-        sg_vhash_variant__freecontents(pCtx, phit->pVariant);
+        SG_ERR_CHECK_RETURN(  sg_vhash__adopt__varray(pCtx, pvh, *ppva_val)  );
+        sg_vhash_variant__freecontents(pCtx, pvh, phit->pVariant);
 
 		phit->pVariant->type = SG_VARIANT_TYPE_VARRAY;
 		phit->pVariant->v.val_varray = *ppva_val;
@@ -994,7 +1339,7 @@ void SG_vhash__update__null(
 		return;
 	}
 
-    sg_vhash_variant__freecontents(pCtx, phit->pVariant);
+    sg_vhash_variant__freecontents(pCtx, pvh, phit->pVariant);
 
 	phit->pVariant->type = SG_VARIANT_TYPE_NULL;
 }
@@ -1159,7 +1504,14 @@ void SG_vhash__addnew__varray(
     SG_varray* pva_sub = NULL;
     SG_varray* pva_sub_ref = NULL;
 
-    SG_ERR_CHECK(  SG_varray__alloc__params(pCtx, &pva_sub, 4, pvh->pStrPool, pvh->pVarPool)  );
+    if (pvh->pArena)
+    {
+        SG_ERR_CHECK(  SG_varray__alloc__arena(pCtx, &pva_sub, 4, pvh->pArena)  );
+    }
+    else
+    {
+        SG_ERR_CHECK(  SG_varray__alloc__params(pCtx, &pva_sub, 4, pvh->pStrPool, pvh->pVarPool)  );
+    }
     pva_sub_ref = pva_sub;
     SG_ERR_CHECK(  SG_vhash__add__varray(pCtx, pvh, psz_key, &pva_sub)  );
     *pResult = pva_sub_ref;
@@ -1204,7 +1556,14 @@ void SG_vhash__addnew__vhash(
     SG_vhash* pvh_sub = NULL;
     SG_vhash* pvh_sub_ref = NULL;
 
-    SG_ERR_CHECK(  SG_vhash__alloc__params(pCtx, &pvh_sub, 0, pvh->pStrPool, pvh->pVarPool)  );
+    if (pvh->pArena)
+    {
+        SG_ERR_CHECK(  SG_vhash__alloc__arena(pCtx, &pvh_sub, 0, pvh->pArena)  );
+    }
+    else
+    {
+        SG_ERR_CHECK(  SG_vhash__alloc__params(pCtx, &pvh_sub, 0, pvh->pStrPool, pvh->pVarPool)  );
+    }
     pvh_sub_ref = pvh_sub;
     SG_ERR_CHECK(  SG_vhash__add__vhash(pCtx, pvh, psz_key, &pvh_sub)  );
     if (pResult)
@@ -1226,7 +1585,14 @@ void SG_vhash__updatenew__vhash(
     SG_vhash* pvh_sub = NULL;
     SG_vhash* pvh_sub_ref = NULL;
 
-    SG_ERR_CHECK(  SG_vhash__alloc__params(pCtx, &pvh_sub, 0, pvh->pStrPool, pvh->pVarPool)  );
+    if (pvh->pArena)
+    {
+        SG_ERR_CHECK(  SG_vhash__alloc__arena(pCtx, &pvh_sub, 0, pvh->pArena)  );
+    }
+    else
+    {
+        SG_ERR_CHECK(  SG_vhash__alloc__params(pCtx, &pvh_sub, 0, pvh->pStrPool, pvh->pVarPool)  );
+    }
     pvh_sub_ref = pvh_sub;
     SG_ERR_CHECK(  SG_vhash__update__vhash(pCtx, pvh, psz_key, &pvh_sub)  );
     if (pResult)
@@ -1251,6 +1617,7 @@ void SG_vhash__add__vhash(
     SG_NULLARGCHECK_RETURN(*ppvh_val);
 
     SG_ERR_CHECK(  SG_varpool__add(pCtx, pvh->pVarPool, &pv)  );
+    SG_ERR_CHECK(  sg_vhash__adopt__vhash(pCtx, pvh, *ppvh_val)  );
     pv->type = SG_VARIANT_TYPE_VHASH;
     pv->v.val_vhash = *ppvh_val;
     *ppvh_val = NULL;
@@ -1274,6 +1641,7 @@ void SG_vhash__add__varray(
     SG_NULLARGCHECK_RETURN(*ppva_val);
 
     SG_ERR_CHECK(  SG_varpool__add(pCtx, pvh->pVarPool, &pv)  );
+    SG_ERR_CHECK(  sg_vhash__adopt__varray(pCtx, pvh, *ppva_val)  );
     pv->type = SG_VARIANT_TYPE_VARRAY;
     pv->v.val_varray = *ppva_val;
     *ppva_val = NULL;
@@ -1752,7 +2120,7 @@ void SG_vhash__remove_if_present(
     {
         SG_uint32 key_ndx = (SG_uint32) (phit - pvh->aItems);
 
-        sg_vhash_variant__freecontents(pCtx, pvh->aItems[key_ndx].pVariant);
+        sg_vhash_variant__freecontents(pCtx, pvh, pvh->aItems[key_ndx].pVariant);
 
         memmove((char**)&(pvh->aItems[key_ndx]), &(pvh->aItems[key_ndx+1]), (pvh->space - key_ndx - 1) * sizeof(sg_hashitem));
 
@@ -73,6 +73,7 @@ typedef struct
     SG_uint32 flag;                 /* flag of the file currently writing */
 
     int  method;                /* compression method of file currenty wr.*/
+    int  raw;                   /* 1 if the caller hands us deflated data */
     Byte buffered_data[Z_BUFSIZE];/* buffer contain compressed data to be writ*/
     SG_uint32 dosDate;
     SG_uint32 crc32;
@@ -270,11 +271,12 @@ static void my_dosdate_now(SG_context* pCtx, SG_uint32* pi)
     *pi = t;
 }
 
-void sg_zip__begin_file(
+static void sg_zip__begin_file(
         SG_context* pCtx,
         SG_zip* zi,
         const char* filename,
-		SG_bool bIsFolderOnly
+		SG_bool bIsFolderOnly,
+		SG_bool bRaw
         )
 {
     SG_uint32 size_filename;
@@ -315,6 +317,7 @@ void sg_zip__begin_file(
 
     zi->ci.crc32 = 0;
     zi->ci.method = Z_DEFLATED;
+    zi->ci.raw = bRaw ? 1 : 0;
     zi->ci.stream_initialised = 0;
     zi->ci.pos_in_buffered_data = 0;
     SG_ERR_CHECK(  SG_file__tell(pCtx, zi->pFile, &zi->ci.pos_local_header)  );
@@ -370,7 +373,11 @@ void sg_zip__begin_file(
     zi->ci.stream.total_in = 0;
     zi->ci.stream.total_out = 0;
 
-    if (zi->ci.method == Z_DEFLATED)
+    if (zi->ci.raw)
+    {
+        zi->in_opened_file_inzip = 1;
+    }
+    else if (zi->ci.method == Z_DEFLATED)
     {
         int zerr = Z_OK;
 
@@ -399,7 +406,14 @@ void SG_zip__begin_file(SG_context* pCtx,
         SG_zip* zi,
         const char* filename)
 {
-	sg_zip__begin_file(pCtx, zi, filename, SG_FALSE);
+	sg_zip__begin_file(pCtx, zi, filename, SG_FALSE, SG_FALSE);
+}
+
+void SG_zip__begin_file__raw(SG_context* pCtx,
+        SG_zip* zi,
+        const char* filename)
+{
+	sg_zip__begin_file(pCtx, zi, filename, SG_FALSE, SG_TRUE);
 }
 
 static void sg_zip__flush(SG_context* pCtx, SG_zip* zi)
@@ -418,6 +432,7 @@ void SG_zip__write(SG_context* pCtx, SG_zip* zi, const SG_byte* buf, SG_uint32 l
 
     SG_NULLARGCHECK_RETURN( zi );
 	SG_ARGCHECK_RETURN((zi->in_opened_file_inzip != 0), zi->in_opened_file_inzip);
+	SG_ARGCHECK_RETURN((zi->ci.raw == 0), zi->ci.raw);
 
     zi->ci.stream.next_in = (void*)buf;
     zi->ci.stream.avail_in = len;
@@ -477,6 +492,19 @@ fail:
     return;
 }
 
+void SG_zip__write__raw(SG_context* pCtx, SG_zip* zi, const SG_byte* buf, SG_uint32 len)
+{
+    SG_NULLARGCHECK_RETURN( zi );
+	SG_ARGCHECK_RETURN((zi->in_opened_file_inzip != 0), zi->in_opened_file_inzip);
+	SG_ARGCHECK_RETURN((zi->ci.raw != 0), zi->ci.raw);
+
+    if (len > 0)
+    {
+        SG_ERR_CHECK_RETURN(  SG_file__write(pCtx, zi->pFile, len, buf, NULL)  );
+        zi->ci.stream.total_out += len;
+    }
+}
+
 static void sg_zip__end_file_raw(SG_context* pCtx, SG_zip* zi, SG_uint32 uncompressed_size, SG_uint32 crc32)
 {
     SG_uint32 compressed_size;
@@ -487,7 +515,7 @@ static void sg_zip__end_file_raw(SG_context* pCtx, SG_zip* zi, SG_uint32 uncompr
 
     zi->ci.stream.avail_in = 0;
 
-    if (zi->ci.method == Z_DEFLATED)
+    if (!zi->ci.raw && (zi->ci.method == Z_DEFLATED))
     {
         while (Z_OK == zerr)
         {
@@ -510,19 +538,23 @@ static void sg_zip__end_file_raw(SG_context* pCtx, SG_zip* zi, SG_uint32 uncompr
         SG_ERR_CHECK(  sg_zip__flush(pCtx, zi)  );
     }
 
-    if (zi->ci.method == Z_DEFLATED)
+    if (zi->ci.stream_initialised)
     {
         deflateEnd(&zi->ci.stream);
         zi->ci.stream_initialised = 0;
     }
 
-    crc32 = (SG_uint32)zi->ci.crc32;
-    uncompressed_size = (SG_uint32)zi->ci.stream.total_in;
+    /* In raw mode, the caller knows what went into the deflated data */
+    if (!zi->ci.raw)
+    {
+        crc32 = (SG_uint32)zi->ci.crc32;
+        uncompressed_size = (SG_uint32)zi->ci.stream.total_in;
+    }
     compressed_size = (SG_uint32)zi->ci.stream.total_out;
 
     ziplocal_putValue_inmemory(zi->ci.central_header+16,crc32,4); /*crc*/
     ziplocal_putValue_inmemory(zi->ci.central_header+20, compressed_size,4); /*compr size*/
-    if (zi->ci.stream.data_type == Z_ASCII)
+    if (!zi->ci.raw && (zi->ci.stream.data_type == Z_ASCII))
     {
         ziplocal_putValue_inmemory(zi->ci.central_header+36,(SG_uint32)Z_ASCII,2);
     }
@@ -560,11 +592,16 @@ void SG_zip__end_file(SG_context* pCtx, SG_zip* file)
     SG_ERR_CHECK_RETURN(  sg_zip__end_file_raw (pCtx, file,0,0)  );
 }
 
+void SG_zip__end_file__raw(SG_context* pCtx, SG_zip* file, SG_uint32 uncompressed_size, SG_uint32 crc32)
+{
+    SG_ERR_CHECK_RETURN(  sg_zip__end_file_raw (pCtx, file,uncompressed_size,crc32)  );
+}
+
 void SG_zip__add_folder(SG_context* pCtx,
         SG_zip* zi,
         const char* foldername)
 {
-	sg_zip__begin_file(pCtx, zi, foldername, SG_TRUE);
+	sg_zip__begin_file(pCtx, zi, foldername, SG_TRUE, SG_FALSE);
 	SG_zip__end_file(pCtx, zi);
 }
 
@@ -644,6 +681,16 @@ fail:
     return;
 }
 
+void SG_zip__store__raw(SG_context* pCtx, SG_zip* pz, const char* filename, const SG_byte* buf, SG_uint32 len, SG_uint32 uncompressed_size, SG_uint32 crc32)
+{
+    SG_ERR_CHECK(  SG_zip__begin_file__raw(pCtx, pz, filename)  );
+    SG_ERR_CHECK(  SG_zip__write__raw(pCtx, pz, buf, len)  );
+    SG_ERR_CHECK(  SG_zip__end_file__raw(pCtx, pz, uncompressed_size, crc32)  );
+
+fail:
+    return;
+}
+
 #if 0
 // TODO 2010/11/30 This function is currently not being used.
 // TODO            It also has a bug in the body of the loop.
@@ -145,6 +145,13 @@ void sg_vv2__status__main(SG_context * pCtx,
 						  SG_varray ** pvaStatus,
 						  SG_vhash ** ppvhLegend);
 
+void sg_vv2__status__range(SG_context * pCtx,
+						   SG_repo * pRepo,
+						   const SG_stringarray * psaHids,
+						   SG_bool bNoSort,
+						   SG_vv2__status_range_callback * pfnCallback,
+						   void * pVoidCallbackData);
+
 void sg_vv2__filtered_status(SG_context * pCtx,
 							 SG_repo * pRepo,
 							 SG_rbtree * prbTreenodeCache_Shared,	// optional
@@ -0,0 +1,118 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file sg_vv2__status__range.c
+ *
+ * @details Compute a COMPLETE STATUS for each pair of neighbours
+ * in a list of changesets.  This is what a history detail view,
+ * a set of release notes or an audit wants: what changed in each
+ * changeset across a whole range.
+ *
+ * Calling sg_vv2__status__main() once per pair would work, but
+ * each call would start with an empty treenode cache.  We keep
+ * one cache for the whole walk, so the treenodes loaded for the
+ * "dest" side of one pair are already there when the same cset
+ * is the "orig" side of the next.  The compare itself only
+ * descends into directories whose HIDs differ between the two
+ * csets, so for neighbouring csets very little gets loaded.
+ *
+ * Results are handed to the caller one pair at a time rather than
+ * being accumulated.
+ *
+ */
+
+//////////////////////////////////////////////////////////////////
+
+#include <sg.h>
+
+#include <sg_wc__public_typedefs.h>
+#include <sg_wc__public_prototypes.h>
+
+#include "sg_vv2__public_typedefs.h"
+#include "sg_vv2__public_prototypes.h"
+#include "sg_vv2__private.h"
+
+//////////////////////////////////////////////////////////////////
+
+/**
+ * The cache only needs the treenodes of the most recent cset,
+ * but it can't tell those from the ones left over from earlier
+ * csets.  Once it gets this big we just start over.
+ */
+#define sg_VV2__STATUS_RANGE__MAX_CACHED_TREENODES		(4096)
+
+void sg_vv2__status__range(SG_context * pCtx,
+						   SG_repo * pRepo,
+						   const SG_stringarray * psaHids,
+						   SG_bool bNoSort,
+						   SG_vv2__status_range_callback * pfnCallback,
+						   void * pVoidCallbackData)
+{
+	SG_rbtree * prbTreenodeCache = NULL;
+	SG_varray * pvaStatus = NULL;
+	SG_uint32 nrHids = 0;
+	SG_uint32 k;
+
+	SG_NULLARGCHECK_RETURN(pRepo);
+	SG_NULLARGCHECK_RETURN(psaHids);
+	SG_NULLARGCHECK_RETURN(pfnCallback);
+
+	SG_ERR_CHECK(  SG_stringarray__count(pCtx, psaHids, &nrHids)  );
+	if (nrHids < 2)
+		SG_ERR_THROW2(  SG_ERR_INVALIDARG,
+						(pCtx, "At least two changesets are required for this operation.")  );
+
+	SG_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &prbTreenodeCache)  );
+
+	for (k=1; k<nrHids; k++)
+	{
+		const char * pszHid_0 = NULL;
+		const char * pszHid_1 = NULL;
+		SG_uint32 nrCached = 0;
+
+		SG_ERR_CHECK(  SG_stringarray__get_nth(pCtx, psaHids, k-1, &pszHid_0)  );
+		SG_ERR_CHECK(  SG_stringarray__get_nth(pCtx, psaHids, k,   &pszHid_1)  );
+
+#if TRACE_VV2_STATUS
+		SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDERR,
+								   "vv2status: RANGE [%d] [cset0 %s][cset1 %s]\n",
+								   k-1, pszHid_0, pszHid_1)  );
+#endif
+
+		SG_ERR_CHECK(  sg_vv2__status__main(pCtx, pRepo, prbTreenodeCache,
+											pszHid_0, pszHid_1,
+											SG_VV2__REPO_PATH_DOMAIN__0, SG_VV2__REPO_PATH_DOMAIN__1,
+											SG_WC__STATUS_SUBSECTION__A, SG_WC__STATUS_SUBSECTION__B,
+											"Changeset (0)", "Changeset (1)",
+											bNoSort,
+											&pvaStatus, NULL)  );
+		SG_ERR_CHECK(  (*pfnCallback)(pCtx, k-1, pszHid_0, pszHid_1, pvaStatus, pVoidCallbackData)  );
+		SG_VARRAY_NULLFREE(pCtx, pvaStatus);
+
+		SG_ERR_CHECK(  SG_rbtree__count(pCtx, prbTreenodeCache, &nrCached)  );
+		if (nrCached > sg_VV2__STATUS_RANGE__MAX_CACHED_TREENODES)
+		{
+			SG_RBTREE_NULLFREE_WITH_ASSOC(pCtx, prbTreenodeCache, ((SG_free_callback *)SG_treenode__free));
+			SG_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &prbTreenodeCache)  );
+		}
+	}
+
+fail:
+	SG_RBTREE_NULLFREE_WITH_ASSOC(pCtx, prbTreenodeCache, ((SG_free_callback *)SG_treenode__free));
+	SG_VARRAY_NULLFREE(pCtx, pvaStatus);
+}
@@ -105,6 +105,39 @@ void SG_vv2__status__repo(SG_context * pCtx,
 						  SG_varray ** ppvaStatus,
 						  SG_vhash ** ppvhLegend);
 
+/**
+ * Do a FULL HISTORICAL STATUS for each cset in a line of
+ * history, handing the status of each one (relative to its
+ * parent) to the callback, oldest first.  This is much cheaper
+ * than calling SG_vv2__status() once per cset because treenodes
+ * are carried from one cset to the next.
+ *
+ * The rev-spec must name 2 csets, one of which is an ancestor
+ * of the other by way of first parents.
+ *
+ * This DOES NOT REQUIRE A WD.  If repo-name is omitted,
+ * it will try to get it from the WD, if it exists.
+ *
+ */
+void SG_vv2__status__range(SG_context * pCtx,
+						   const char * pszRepoName,
+						   const SG_rev_spec * pRevSpec,
+						   SG_bool bNoSort,
+						   SG_vv2__status_range_callback * pfnCallback,
+						   void * pVoidCallbackData);
+
+/**
+ * Like SG_vv2__status__range(), but the caller supplies the
+ * list of csets.  Each cset is compared with the one before it
+ * in the list.
+ */
+void SG_vv2__status__range__repo(SG_context * pCtx,
+								 SG_repo * pRepo,
+								 const SG_stringarray * psaHids,
+								 SG_bool bNoSort,
+								 SG_vv2__status_range_callback * pfnCallback,
+								 void * pVoidCallbackData);
+
 //////////////////////////////////////////////////////////////////
 
 void SG_vv2__mstatus(SG_context * pCtx,
@@ -44,6 +44,22 @@ typedef struct _sg_vv2_history_args SG_vv2_history_args;
 
 //////////////////////////////////////////////////////////////////
 
+/**
+ * Called by SG_vv2__status__range() with the status of each
+ * pair of neighbouring changesets, in order.  ndx is the position
+ * of pszHid_0 in the range.  pvaStatus is in the same format that
+ * SG_vv2__status() returns, and it belongs to the caller of the
+ * callback; copy anything you need to keep.
+ */
+typedef void (SG_vv2__status_range_callback)(SG_context * pCtx,
+											 SG_uint32 ndx,
+											 const char * pszHid_0,
+											 const char * pszHid_1,
+											 const SG_varray * pvaStatus,
+											 void * pVoidCallbackData);
+
+//////////////////////////////////////////////////////////////////
+
 END_EXTERN_C;
 
 #endif//H_SG_VV2__API__PUBLIC_TYPEDEFS_H
@@ -220,3 +220,148 @@ fail:
 	SG_VARRAY_NULLFREE(pCtx, pvaStatus);
 	SG_VHASH_NULLFREE(pCtx, pvhLegend);
 }
+
+//////////////////////////////////////////////////////////////////
+
+/**
+ * Compute a COMPLETE STATUS for each pair of neighbours in the
+ * given list of csets (which the caller puts in order, usually
+ * oldest first).  See sg_vv2__status__range.c.
+ *
+ */
+void SG_vv2__status__range__repo(SG_context * pCtx,
+								 SG_repo * pRepo,
+								 const SG_stringarray * psaHids,
+								 SG_bool bNoSort,
+								 SG_vv2__status_range_callback * pfnCallback,
+								 void * pVoidCallbackData)
+{
+	SG_ERR_CHECK_RETURN(  sg_vv2__status__range(pCtx, pRepo, psaHids, bNoSort,
+												pfnCallback, pVoidCallbackData)  );
+}
+
+/**
+ * Get the csets from the older of the 2 given csets up to the
+ * newer one, oldest first, by following parents back from the
+ * newer one.  At a merge we follow the first parent.  The older
+ * cset must be on that path.
+ *
+ */
+static void _my__get_linear_chain(SG_context * pCtx,
+								  struct _my_data * pData,
+								  SG_stringarray ** ppsaChain)
+{
+	SG_changeset * pcs = NULL;
+	SG_stringarray * psaBackwards = NULL;
+	SG_stringarray * psaChain = NULL;
+	const char * pszHidOlder = pData->pszHid_0;
+	const char * pszHidNewer = pData->pszHid_1;
+	char bufHid[SG_HID_MAX_BUFFER_LENGTH];
+	SG_int32 genOlder = 0;
+	SG_int32 genNewer = 0;
+	SG_uint32 k, nrHids;
+
+	SG_ERR_CHECK(  SG_changeset__load_from_repo(pCtx, pData->pRepo, pszHidOlder, &pcs)  );
+	SG_ERR_CHECK(  SG_changeset__get_generation(pCtx, pcs, &genOlder)  );
+	SG_CHANGESET_NULLFREE(pCtx, pcs);
+	SG_ERR_CHECK(  SG_changeset__load_from_repo(pCtx, pData->pRepo, pszHidNewer, &pcs)  );
+	SG_ERR_CHECK(  SG_changeset__get_generation(pCtx, pcs, &genNewer)  );
+	SG_CHANGESET_NULLFREE(pCtx, pcs);
+
+	if (genOlder > genNewer)
+	{
+		const char * pszTemp = pszHidOlder;
+		SG_int32 genTemp = genOlder;
+
+		pszHidOlder = pszHidNewer;
+		pszHidNewer = pszTemp;
+		genOlder = genNewer;
+		genNewer = genTemp;
+	}
+
+	SG_ERR_CHECK(  SG_STRINGARRAY__ALLOC(pCtx, &psaBackwards, (SG_uint32)(genNewer - genOlder + 1))  );
+	SG_ERR_CHECK(  SG_strcpy(pCtx, bufHid, sizeof(bufHid), pszHidNewer)  );
+	SG_ERR_CHECK(  SG_stringarray__add(pCtx, psaBackwards, bufHid)  );
+
+	while (strcmp(bufHid, pszHidOlder) != 0)
+	{
+		SG_varray * pvaParents = NULL;		// owned by pcs
+		const char * pszHidParent = NULL;
+		SG_int32 gen = 0;
+		SG_uint32 nrParents = 0;
+
+		SG_ERR_CHECK(  SG_changeset__load_from_repo(pCtx, pData->pRepo, bufHid, &pcs)  );
+		SG_ERR_CHECK(  SG_changeset__get_generation(pCtx, pcs, &gen)  );
+		if (gen <= genOlder)
+			SG_ERR_THROW2(  SG_ERR_INVALIDARG,
+							(pCtx, "Changeset '%s' is not an ancestor of '%s' along a single line of parents.",
+							 pszHidOlder, pszHidNewer)  );
+
+		SG_ERR_CHECK(  SG_changeset__get_parents(pCtx, pcs, &pvaParents)  );
+		if (pvaParents)
+			SG_ERR_CHECK(  SG_varray__count(pCtx, pvaParents, &nrParents)  );
+		if (nrParents == 0)
+			SG_ERR_THROW2(  SG_ERR_INVALIDARG,
+							(pCtx, "Changeset '%s' is not an ancestor of '%s'.",
+							 pszHidOlder, pszHidNewer)  );
+		SG_ERR_CHECK(  SG_varray__get__sz(pCtx, pvaParents, 0, &pszHidParent)  );
+		SG_ERR_CHECK(  SG_strcpy(pCtx, bufHid, sizeof(bufHid), pszHidParent)  );
+		SG_CHANGESET_NULLFREE(pCtx, pcs);
+
+		SG_ERR_CHECK(  SG_stringarray__add(pCtx, psaBackwards, bufHid)  );
+	}
+
+	SG_ERR_CHECK(  SG_stringarray__count(pCtx, psaBackwards, &nrHids)  );
+	SG_ERR_CHECK(  SG_STRINGARRAY__ALLOC(pCtx, &psaChain, nrHids)  );
+	for (k=nrHids; k>0; k--)
+	{
+		const char * psz = NULL;
+
+		SG_ERR_CHECK(  SG_stringarray__get_nth(pCtx, psaBackwards, k-1, &psz)  );
+		SG_ERR_CHECK(  SG_stringarray__add(pCtx, psaChain, psz)  );
+	}
+
+	SG_RETURN_AND_NULL( psaChain, ppsaChain );
+
+fail:
+	SG_CHANGESET_NULLFREE(pCtx, pcs);
+	SG_STRINGARRAY_NULLFREE(pCtx, psaBackwards);
+	SG_STRINGARRAY_NULLFREE(pCtx, psaChain);
+}
+
+/**
+ * Compute the historical status of every cset between the 2
+ * csets in the rev-spec, one call to the callback per cset.
+ * The callback gets them oldest first and each status is
+ * relative to the cset's parent.  (The older of the 2 given
+ * csets is only used as a starting point.)
+ *
+ * This DOES NOT REQUIRE A WD.  If repo-name is omitted,
+ * it will try to get it from the WD, if it exists.
+ *
+ */
+void SG_vv2__status__range(SG_context * pCtx,
+						   const char * pszRepoName,
+						   const SG_rev_spec * pRevSpec,
+						   SG_bool bNoSort,
+						   SG_vv2__status_range_callback * pfnCallback,
+						   void * pVoidCallbackData)
+{
+	struct _my_data data;
+	SG_stringarray * psaChain = NULL;
+
+	memset(&data, 0, sizeof(data));
+
+	// pszRepoName is optional (defaults to WD if present)
+	SG_NULLARGCHECK_RETURN( pRevSpec );
+	SG_NULLARGCHECK_RETURN( pfnCallback );
+
+	SG_ERR_CHECK(  _my__get_cset_hids(pCtx, &data, pszRepoName, pRevSpec)  );
+	SG_ERR_CHECK(  _my__get_linear_chain(pCtx, &data, &psaChain)  );
+	SG_ERR_CHECK(  sg_vv2__status__range(pCtx, data.pRepo, psaChain, bNoSort,
+										 pfnCallback, pVoidCallbackData)  );
+
+fail:
+	_my__free_data(pCtx, &data);
+	SG_STRINGARRAY_NULLFREE(pCtx, psaChain);
+}
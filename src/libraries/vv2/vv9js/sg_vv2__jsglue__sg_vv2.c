@@ -520,6 +520,163 @@ fail:
 
 //////////////////////////////////////////////////////////////////
 
+/**
+ * The status-range callback for sg.vv2.status_range().
+ * Append one row per pair to the result varray.  The
+ * status belongs to our caller, so we copy it.
+ */
+static void _status_range__append_cb(SG_context * pCtx,
+									 SG_uint32 ndx,
+									 const char * pszHid_0,
+									 const char * pszHid_1,
+									 const SG_varray * pvaStatus,
+									 void * pVoidCallbackData)
+{
+	SG_varray * pvaResult = (SG_varray *)pVoidCallbackData;
+	SG_vhash * pvhRow = NULL;
+	SG_varray * pvaCopy = NULL;
+
+	SG_UNUSED(ndx);
+
+	SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvhRow)  );
+	SG_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pvhRow, "cset0", pszHid_0)  );
+	SG_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pvhRow, "cset1", pszHid_1)  );
+	SG_ERR_CHECK(  SG_VARRAY__ALLOC__COPY(pCtx, &pvaCopy, pvaStatus)  );
+	SG_ERR_CHECK(  SG_vhash__add__varray(pCtx, pvhRow, "changes", &pvaCopy)  );
+	SG_ERR_CHECK(  SG_varray__append__vhash(pCtx, pvaResult, &pvhRow)  );
+
+fail:
+	SG_VARRAY_NULLFREE(pCtx, pvaCopy);
+	SG_VHASH_NULLFREE(pCtx, pvhRow);
+}
+
+/**
+ * result = sg.vv2.status_range( { "repo"    : "<repo_name>",
+ *                                 "revs"    : [ <<rev-spec-0>>,
+ *                                               <<rev-spec-1>> ],
+ *                                 "no-sort" : <bool> } );
+ *
+ * Compute the historical STATUS of every cset in a line of
+ * history, each relative to its (first) parent.  This is what
+ * a history detail view wants, and it is much cheaper than
+ * calling sg.vv2.status() once per cset.
+ *
+ * We REQUIRE 2 CSETs to be specified, in the same "revs"
+ * syntax as sg.vv2.status().  One must be an ancestor of
+ * the other by way of first parents; the order doesn't
+ * matter.
+ *
+ * If <repo_name> is omitted, we will try to get it from the
+ * WD if we can find one.
+ *
+ * We return one row per cset after the older one, oldest
+ * first:
+ *
+ * result := [ { "cset0"   : "<hid_of_parent>",
+ *               "cset1"   : "<hid>",
+ *               "changes" : <<array_of_status>> },
+ *             ... ]
+ *
+ */
+SG_JSGLUE_METHOD_PROTOTYPE(vv2, status_range)
+{
+	SG_context * pCtx = SG_jsglue__get_clean_sg_context(cx);
+	jsval * argv = JS_ARGV(cx, vp);
+	SG_varray * pvaResult = NULL;
+    SG_vhash* pvh_args = NULL;
+    SG_vhash* pvh_got = NULL;
+    SG_vhash* pvh_got_k = NULL;
+	JSObject* jso = NULL;
+	SG_rev_spec * pRevSpec = NULL;
+	const char * pszRepoName = NULL;	// we do not own this
+	SG_bool bNoSort = SG_FALSE;
+	SG_varray * pvaRevs = NULL;			// we do not own this
+	SG_uint32 nrRevs;
+	SG_uint32 k;
+
+	SG_JS_BOOL_CHECK( (argc == 1) );
+	SG_JS_BOOL_CHECK( (JSVAL_IS_OBJECT(argv[0])) );
+    SG_ERR_CHECK(  sg_jsglue__jsobject_to_vhash(pCtx, cx, JSVAL_TO_OBJECT(argv[0]), &pvh_args)  );
+    SG_ERR_CHECK(  SG_vhash__alloc(pCtx, &pvh_got)  );
+
+	SG_ERR_CHECK(  SG_jsglue__np__optional__sz(    pCtx, pvh_args, pvh_got, "repo",        NULL, &pszRepoName)  );
+	SG_ERR_CHECK(  SG_jsglue__np__required__varray(pCtx, pvh_args, pvh_got, "revs",      &pvaRevs)  );
+	SG_ERR_CHECK(  SG_jsglue__np__optional__bool(pCtx, pvh_args, pvh_got, "no-sort",     SG_FALSE, &bNoSort)  );
+    SG_ERR_CHECK(  SG_jsglue__np__anything_not_got_is_invalid( pCtx, "sg.vv2.status_range", pvh_args, pvh_got)  );
+
+	SG_ERR_CHECK(  SG_REV_SPEC__ALLOC(pCtx, &pRevSpec)  );
+
+	SG_ERR_CHECK(  SG_varray__count(pCtx, pvaRevs, &nrRevs)  );
+	if (nrRevs != 2)
+		SG_ERR_THROW2(  SG_ERR_JS_NAMED_PARAM_REQUIRED,
+						(pCtx, "The 'revs' field must have 2 values")  );
+	for (k=0; k<nrRevs; k++)
+	{
+		SG_vhash* pvh_args_k = NULL;		// we do not own this
+		const char * pszRev = NULL;			// we do not own this
+		const char * pszTag = NULL;			// we do not own this
+		const char * pszBranch = NULL;		// we do not own this
+		SG_uint32 count_rev_spec = 0;
+
+		SG_ERR_CHECK(  SG_varray__get__vhash(pCtx, pvaRevs, k, &pvh_args_k)  );
+		SG_ERR_CHECK(  SG_vhash__alloc(pCtx, &pvh_got_k)  );
+
+		SG_ERR_CHECK(  SG_jsglue__np__optional__sz(  pCtx, pvh_args_k, pvh_got_k, "rev",    NULL, &pszRev)  );
+		SG_ERR_CHECK(  SG_jsglue__np__optional__sz(  pCtx, pvh_args_k, pvh_got_k, "tag",    NULL, &pszTag)  );
+		SG_ERR_CHECK(  SG_jsglue__np__optional__sz(  pCtx, pvh_args_k, pvh_got_k, "branch", NULL, &pszBranch)  );
+		SG_ERR_CHECK(  SG_jsglue__np__anything_not_got_is_invalid( pCtx, "sg.vv2.status_range", pvh_args_k, pvh_got_k)  );
+
+		if (pszRev)
+		{
+			SG_ERR_CHECK(  SG_rev_spec__add_rev(pCtx, pRevSpec, pszRev)  );
+			count_rev_spec++;
+		}
+		if (pszTag)
+		{
+			SG_ERR_CHECK(  SG_rev_spec__add_tag(pCtx, pRevSpec, pszTag)  );
+			count_rev_spec++;
+		}
+		if (pszBranch)
+		{
+			SG_ERR_CHECK(  SG_rev_spec__add_branch(pCtx, pRevSpec, pszBranch)  );
+			count_rev_spec++;
+		}
+		if (count_rev_spec != 1)
+			SG_ERR_THROW2(  SG_ERR_JS_NAMED_PARAM_REQUIRED,
+							(pCtx,
+							 "Exactly one instance of 'rev', 'tag', or 'branch' is required in 'revs[%d]'",
+							 k)  );
+
+		SG_VHASH_NULLFREE(pCtx, pvh_got_k);
+	}
+
+	SG_ERR_CHECK(  SG_VARRAY__ALLOC(pCtx, &pvaResult)  );
+	SG_ERR_CHECK(  SG_vv2__status__range(pCtx, pszRepoName, pRevSpec, bNoSort,
+										 _status_range__append_cb, pvaResult)  );
+
+	SG_JS_NULL_CHECK(  (jso = JS_NewArrayObject(cx, 0, NULL))  );
+	JS_SET_RVAL(cx, vp, OBJECT_TO_JSVAL(jso));
+	SG_ERR_CHECK(  sg_jsglue__copy_varray_into_jsobject(pCtx, cx, pvaResult, jso)  );
+
+	SG_VARRAY_NULLFREE(pCtx, pvaResult);
+    SG_VHASH_NULLFREE(pCtx, pvh_args);
+    SG_VHASH_NULLFREE(pCtx, pvh_got);
+	SG_REV_SPEC_NULLFREE(pCtx, pRevSpec);
+
+    return JS_TRUE;
+
+fail:
+	SG_VARRAY_NULLFREE(pCtx, pvaResult);
+    SG_VHASH_NULLFREE(pCtx, pvh_args);
+    SG_VHASH_NULLFREE(pCtx, pvh_got);
+    SG_VHASH_NULLFREE(pCtx, pvh_got_k);
+	SG_REV_SPEC_NULLFREE(pCtx, pRevSpec);
+	SG_jsglue__report_sg_error(pCtx,cx);	// DO NOT SG_ERR_IGNORE() THIS
+    return JS_FALSE;
+}
+
+//////////////////////////////////////////////////////////////////
+
 /**
  * result = sg.vv2.mstatus( { "repo"        : "<repo_name>",
  *                            "rev"         : "<revision_number_or_csid_prefix>",
@@ -1876,6 +2033,7 @@ static JSFunctionSpec sg_vv2__methods[] = {
 	{ "export",           SG_JSGLUE_METHOD_NAME(vv2, export),          1,0},
 	{ "comment",          SG_JSGLUE_METHOD_NAME(vv2, comment),         1,0},
 	{ "status",           SG_JSGLUE_METHOD_NAME(vv2, status),          1,0},
+	{ "status_range",     SG_JSGLUE_METHOD_NAME(vv2, status_range),    1,0},
 	{ "mstatus",          SG_JSGLUE_METHOD_NAME(vv2, mstatus),         1,0},
 
 	{ "stamps",           SG_JSGLUE_METHOD_NAME(vv2, stamps),          1,0},
@@ -98,6 +98,7 @@ BEGIN_EXTERN_C;
 
 typedef struct _sg_wc_prescan_row  sg_wc_prescan_row;
 typedef struct _sg_wc_prescan_dir  sg_wc_prescan_dir;
+typedef struct _sg_wc_fetch_blobs  sg_wc_fetch_blobs;
 
 #include     "wc0util/sg_wc_attrbits__private_typedefs.h"
 #include     "wc0util/sg_wc_port__private_typedefs.h"
@@ -118,6 +119,7 @@ typedef struct _sg_wc_prescan_dir  sg_wc_prescan_dir;
 
 #include     "wc0util/sg_wc_attrbits__private_prototypes.h"
 #include     "wc0util/sg_wc_diff_utils__private_prototypes.h"
+#include     "wc0util/sg_wc_fetch_blobs__private_prototypes.h"
 #include     "wc0util/sg_wc_park__private_prototypes.h"
 #include     "wc0util/sg_wc_path__private_prototypes.h"
 #include     "wc0util/sg_wc_port__private_prototypes.h"
@@ -0,0 +1,283 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file sg_wc_fetch_blobs.c
+ *
+ * @details Fetch a batch of blobs from the repo into files on disk
+ * using a small pool of worker threads.
+ *
+ * Fetching a blob (undeltify, inflate, write) is CPU-bound and
+ * each file is independent of the others, so CHECKOUT and the APPLY
+ * phase of a TX queue up the files that they need written and let
+ * us do them in parallel (see SG_thread_pool).  The caller is
+ * responsible for anything that must happen in order (creating
+ * parent directories before we run, renames, attrbits, and updating
+ * the DB after we run).
+ *
+ * The calling thread also acts as a worker using the caller's
+ * repo handle.
+ *
+ */
+
+//////////////////////////////////////////////////////////////////
+
+#include <sg.h>
+
+#include "sg_wc__public_typedefs.h"
+#include "sg_wc__public_prototypes.h"
+#include "sg_wc__private.h"
+
+//////////////////////////////////////////////////////////////////
+
+// Don't bother starting threads unless each one will get
+// at least this many files.
+#define sg_WC_FETCH_BLOBS__MIN_JOBS_PER_THREAD		(16)
+
+// Limit the number of threads regardless of the number of
+// processors.  After this, the disk is the bottleneck.
+#define sg_WC_FETCH_BLOBS__MAX_THREADS				(8)
+
+typedef struct _sg_wc_fetch_blobs__job
+{
+	char *				pszHid;
+	SG_pathname *		pPathDest;
+	SG_fsobj_perms		perms;
+} sg_wc_fetch_blobs__job;
+
+struct _sg_wc_fetch_blobs
+{
+	SG_repo *			pRepo;			// we do not own this
+	SG_vector *			pvecJobs;		// vec[sg_wc_fetch_blobs__job *]
+
+	// The following are only used while __run() is active.
+
+	SG_mutex			mutex;
+	SG_uint32			ndxNext;		// next job to hand out (protected by mutex)
+	SG_bool				bAbort;			// a worker failed (protected by mutex)
+};
+
+//////////////////////////////////////////////////////////////////
+
+static void _job__free(SG_context * pCtx, sg_wc_fetch_blobs__job * pJob)
+{
+	if (!pJob)
+		return;
+
+	SG_NULLFREE(pCtx, pJob->pszHid);
+	SG_PATHNAME_NULLFREE(pCtx, pJob->pPathDest);
+	SG_NULLFREE(pCtx, pJob);
+}
+
+void sg_wc_fetch_blobs__free(SG_context * pCtx, sg_wc_fetch_blobs * pFetch)
+{
+	if (!pFetch)
+		return;
+
+	SG_VECTOR_NULLFREE_WITH_ASSOC(pCtx, pFetch->pvecJobs, (SG_free_callback *)_job__free);
+	SG_NULLFREE(pCtx, pFetch);
+}
+
+void sg_wc_fetch_blobs__alloc(SG_context * pCtx,
+							  SG_repo * pRepo,
+							  sg_wc_fetch_blobs ** ppFetch)
+{
+	sg_wc_fetch_blobs * pFetch = NULL;
+
+	SG_NULLARGCHECK_RETURN( pRepo );
+	SG_NULLARGCHECK_RETURN( ppFetch );
+
+	SG_ERR_CHECK(  SG_alloc1(pCtx, pFetch)  );
+	pFetch->pRepo = pRepo;
+	SG_ERR_CHECK(  SG_VECTOR__ALLOC(pCtx, &pFetch->pvecJobs, 64)  );
+
+	*ppFetch = pFetch;
+	return;
+
+fail:
+	SG_WC_FETCH_BLOBS__NULLFREE(pCtx, pFetch);
+}
+
+/**
+ * Queue a request to create a NEW file with the contents of
+ * the given blob.  The parent directory must exist by the time
+ * that __run() is called.  The file must not.
+ *
+ */
+void sg_wc_fetch_blobs__add(SG_context * pCtx,
+							sg_wc_fetch_blobs * pFetch,
+							const char * pszHid,
+							const SG_pathname * pPathDest,
+							SG_fsobj_perms perms)
+{
+	sg_wc_fetch_blobs__job * pJob = NULL;
+
+	SG_NULLARGCHECK_RETURN( pFetch );
+	SG_NONEMPTYCHECK_RETURN( pszHid );
+	SG_NULLARGCHECK_RETURN( pPathDest );
+
+	SG_ERR_CHECK(  SG_alloc1(pCtx, pJob)  );
+	SG_ERR_CHECK(  SG_STRDUP(pCtx, pszHid, &pJob->pszHid)  );
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__COPY(pCtx, &pJob->pPathDest, pPathDest)  );
+	pJob->perms = perms;
+
+	SG_ERR_CHECK(  SG_vector__append(pCtx, pFetch->pvecJobs, pJob, NULL)  );
+	return;
+
+fail:
+	_job__free(pCtx, pJob);
+}
+
+void sg_wc_fetch_blobs__count(SG_context * pCtx,
+							  const sg_wc_fetch_blobs * pFetch,
+							  SG_uint32 * pCount)
+{
+	SG_NULLARGCHECK_RETURN( pFetch );
+	SG_NULLARGCHECK_RETURN( pCount );
+
+	SG_ERR_CHECK_RETURN(  SG_vector__length(pCtx, pFetch->pvecJobs, pCount)  );
+}
+
+//////////////////////////////////////////////////////////////////
+
+static void _do_job(SG_context * pCtx,
+					SG_repo * pRepo,
+					const sg_wc_fetch_blobs__job * pJob)
+{
+	SG_file * pFile = NULL;
+
+	SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pJob->pPathDest,
+										   SG_FILE_WRONLY|SG_FILE_CREATE_NEW,
+										   pJob->perms,
+										   &pFile)  );
+	SG_ERR_CHECK(  SG_repo__fetch_blob_into_file(pCtx, pRepo, pJob->pszHid, pFile, NULL)  );
+	SG_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+
+	return;
+
+fail:
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+}
+
+/**
+ * Take jobs from the queue until it is empty or somebody fails.
+ * This is run by each worker thread and by the calling thread.
+ *
+ */
+static void _worker__loop(SG_context * pCtx,
+						  sg_wc_fetch_blobs * pFetch,
+						  SG_repo * pRepo)
+{
+	sg_wc_fetch_blobs__job * pJob;
+	SG_uint32 nrJobs;
+	SG_uint32 ndx;
+
+	SG_ERR_CHECK(  SG_vector__length(pCtx, pFetch->pvecJobs, &nrJobs)  );
+
+	while (1)
+	{
+		SG_ERR_CHECK(  SG_mutex__lock(pCtx, &pFetch->mutex)  );
+		if (pFetch->bAbort || (pFetch->ndxNext >= nrJobs))
+		{
+			SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pFetch->mutex)  );
+			break;
+		}
+		ndx = pFetch->ndxNext++;
+		SG_ERR_CHECK(  SG_mutex__unlock(pCtx, &pFetch->mutex)  );
+
+		SG_ERR_CHECK(  SG_vector__get(pCtx, pFetch->pvecJobs, ndx, (void **)&pJob)  );
+		SG_ERR_CHECK(  _do_job(pCtx, pRepo, pJob)  );
+	}
+
+	return;
+
+fail:
+	// Tell everybody else to stop.  Our context has the error.
+	if (SG_mutex__lock__bare(&pFetch->mutex) == 0)
+	{
+		pFetch->bAbort = SG_TRUE;
+		(void)SG_mutex__unlock__bare(&pFetch->mutex);
+	}
+}
+
+static SG_thread_pool__work _worker__main;
+
+static void _worker__main(SG_context * pCtx, SG_repo * pRepo, void * pVoidData)
+{
+	_worker__loop(pCtx, (sg_wc_fetch_blobs *)pVoidData, pRepo);
+}
+
+/**
+ * Fetch all of the queued blobs.  If any of them fail, we stop
+ * handing out new ones, wait for the ones in progress, and throw
+ * the first error that we saw.  Files that were already written
+ * are left on disk; the caller's cleanup deals with them the same
+ * way it would after a serial failure.
+ *
+ */
+void sg_wc_fetch_blobs__run(SG_context * pCtx,
+							sg_wc_fetch_blobs * pFetch)
+{
+	SG_thread_pool * pPool = NULL;
+	SG_uint32 nrJobs = 0;
+	SG_uint32 nrThreads = 0;
+	SG_bool bMutex = SG_FALSE;
+
+	SG_NULLARGCHECK_RETURN( pFetch );
+
+	SG_ERR_CHECK(  SG_vector__length(pCtx, pFetch->pvecJobs, &nrJobs)  );
+	if (nrJobs == 0)
+		return;
+
+	SG_ERR_CHECK(  SG_mutex__init(pCtx, &pFetch->mutex)  );
+	bMutex = SG_TRUE;
+	pFetch->ndxNext = 0;
+	pFetch->bAbort = SG_FALSE;
+
+	SG_ERR_CHECK(  SG_thread_pool__size_for_jobs(pCtx, nrJobs,
+												 sg_WC_FETCH_BLOBS__MIN_JOBS_PER_THREAD,
+												 sg_WC_FETCH_BLOBS__MAX_THREADS,
+												 &nrThreads)  );
+	if (nrThreads > 0)
+	{
+		SG_ERR_CHECK(  SG_thread_pool__alloc(pCtx, nrThreads, pFetch->pRepo, _worker__main, pFetch, &pPool)  );
+		SG_ERR_CHECK(  SG_thread_pool__start(pCtx, pPool)  );
+	}
+
+	// Do our share of the work using the caller's repo handle.
+
+	SG_ERR_CHECK(  _worker__loop(pCtx, pFetch, pFetch->pRepo)  );
+
+	if (pPool)
+		SG_ERR_CHECK(  SG_thread_pool__join(pCtx, pPool)  );
+
+fail:
+	if (pPool)
+	{
+		// If we are bailing out early, make sure that no worker
+		// is still using our data before we free it.
+
+		if (SG_mutex__lock__bare(&pFetch->mutex) == 0)
+		{
+			pFetch->bAbort = SG_TRUE;
+			(void)SG_mutex__unlock__bare(&pFetch->mutex);
+		}
+		SG_THREAD_POOL_NULLFREE(pCtx, pPool);
+	}
+	if (bMutex)
+		SG_mutex__destroy(&pFetch->mutex);
+}
@@ -0,0 +1,51 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+//////////////////////////////////////////////////////////////////
+
+#ifndef H_SG_WC_FETCH_BLOBS__PRIVATE_PROTOTYPES_H
+#define H_SG_WC_FETCH_BLOBS__PRIVATE_PROTOTYPES_H
+
+BEGIN_EXTERN_C;
+
+//////////////////////////////////////////////////////////////////
+
+void sg_wc_fetch_blobs__alloc(SG_context * pCtx,
+							  SG_repo * pRepo,
+							  sg_wc_fetch_blobs ** ppFetch);
+
+void sg_wc_fetch_blobs__free(SG_context * pCtx, sg_wc_fetch_blobs * pFetch);
+
+#define SG_WC_FETCH_BLOBS__NULLFREE(pCtx,p) _sg_generic_nullfree(pCtx,p,sg_wc_fetch_blobs__free)
+
+void sg_wc_fetch_blobs__add(SG_context * pCtx,
+							sg_wc_fetch_blobs * pFetch,
+							const char * pszHid,
+							const SG_pathname * pPathDest,
+							SG_fsobj_perms perms);
+
+void sg_wc_fetch_blobs__count(SG_context * pCtx,
+							  const sg_wc_fetch_blobs * pFetch,
+							  SG_uint32 * pCount);
+
+void sg_wc_fetch_blobs__run(SG_context * pCtx,
+							sg_wc_fetch_blobs * pFetch);
+
+//////////////////////////////////////////////////////////////////
+
+END_EXTERN_C;
+
+#endif//H_SG_WC_FETCH_BLOBS__PRIVATE_PROTOTYPES_H
@@ -124,8 +124,9 @@ struct _sg_wc_tx
 	//     For this we, build a list of the necessary SQLITE3 statements
 	//     as we identify them during the QUEUE phase.  We can then rip
 	//     thru them in order during the APPLY phase.
-	SG_varray *				pvaJournal;
+	SG_varray *				pvaJournal;				// allocated from pArenaJournal
 	SG_vector *				pvecJournalStmts;		// vec[sqlite3_stmt *] we own these
+	SG_arena *				pArenaJournal;			// the journal rows are only freed all at once
 
 	// A Read-Only Transaction can be used for
 	// things like STATUS. This lets the caller
@@ -169,6 +170,14 @@ struct _sg_wc_tx
 
 	SG_pathname *			pPathSessionTempDir;
 
+	//////////////////////////////////////////////////////////////////
+	// The following fields are used during APPLY when we fetch the
+	// contents of files from the repo in parallel before running the
+	// journal.  See sg_wc_tx__apply__prefetch.c.
+
+	SG_pathname *			pPathPrefetchDir;
+	SG_vhash *				pvhPrefetched;			// map[<gid>:<hid> --> <temp-file>]
+
 };
 
 //////////////////////////////////////////////////////////////////
@@ -208,6 +208,11 @@ void sg_wc_tx__run_apply(SG_context * pCtx, SG_wc_tx * pWcTx)
 
 	SG_ERR_CHECK(  SG_vector__foreach(pCtx, pWcTx->pvecJournalStmts, _apply_db_cb, (void *)pWcTx)  );
 
+	// fetch the contents of any new/restored files from
+	// the repo in parallel.  this does not touch the WD.
+
+	SG_ERR_CHECK(  sg_wc_tx__apply__prefetch(pCtx, pWcTx)  );
+
 	// re-arrange the working directory and/or store
 	// blobs in the repo according to the plan.
 
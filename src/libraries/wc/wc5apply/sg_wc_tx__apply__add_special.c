@@ -40,7 +40,6 @@ void sg_wc_tx__apply__add_special__file(SG_context * pCtx,
 	const char * pszHidBlob;
 	SG_int64 attrbits;
 	SG_pathname * pPath = NULL;
-	SG_file * pFile = NULL;
 	SG_bool bSrcIsSparse;
 
 	SG_ERR_CHECK_RETURN(  SG_vhash__get__sz(   pCtx, pvh, "src",            &pszRepoPath)  );
@@ -60,13 +59,7 @@ void sg_wc_tx__apply__add_special__file(SG_context * pCtx,
 
 	SG_ERR_CHECK(  sg_wc_db__path__sz_repopath_to_absolute(pCtx, pWcTx->pDb, pszRepoPath,  &pPath)  );
 
-	SG_ERR_CHECK(  SG_file__open__pathname(pCtx,
-										   pPath,
-										   SG_FILE_WRONLY|SG_FILE_CREATE_NEW,
-										   0644,
-										   &pFile)  );
-	SG_ERR_CHECK(  SG_repo__fetch_blob_into_file(pCtx, pWcTx->pDb->pRepo, pszHidBlob, pFile, NULL)  );
-	SG_FILE_NULLCLOSE(pCtx, pFile);
+	SG_ERR_CHECK(  sg_wc_tx__apply__fetch_file(pCtx, pWcTx, pszGid, pszHidBlob, pPath)  );
 
 	SG_ERR_CHECK(  SG_attributes__bits__apply(pCtx, pPath, attrbits)  );
 
@@ -84,7 +77,6 @@ void sg_wc_tx__apply__add_special__file(SG_context * pCtx,
 
 fail:
 	SG_PATHNAME_NULLFREE(pCtx, pPath);
-	SG_FILE_NULLCLOSE(pCtx, pFile);
 }
 
 /**
@@ -280,7 +272,6 @@ void sg_wc_tx__apply__overwrite_file_from_repo(SG_context * pCtx,
 	const char * pszBackupPath = NULL;
 	SG_int64 attrbits;
 	SG_pathname * pPath = NULL;
-	SG_file * pFile = NULL;
 	SG_pathname * pPathBackup = NULL;
 	SG_bool bSrcIsSparse;
 
@@ -319,13 +310,7 @@ void sg_wc_tx__apply__overwrite_file_from_repo(SG_context * pCtx,
 		SG_ERR_CHECK(  SG_fsobj__remove__pathname(pCtx, pPath)  );
 	}
 	
-	SG_ERR_CHECK(  SG_file__open__pathname(pCtx,
-										   pPath,
-										   SG_FILE_WRONLY|SG_FILE_CREATE_NEW,
-										   0644,
-										   &pFile)  );
-	SG_ERR_CHECK(  SG_repo__fetch_blob_into_file(pCtx, pWcTx->pDb->pRepo, pszHidBlob, pFile, NULL)  );
-	SG_FILE_NULLCLOSE(pCtx, pFile);
+	SG_ERR_CHECK(  sg_wc_tx__apply__fetch_file(pCtx, pWcTx, pszGid, pszHidBlob, pPath)  );
 
 	// Since we altered the content of the file, flush the
 	// TimeStampCache entry for this item.
@@ -339,7 +324,6 @@ done:
 fail:
 	SG_PATHNAME_NULLFREE(pCtx, pPath);
 	SG_PATHNAME_NULLFREE(pCtx, pPathBackup);
-	SG_FILE_NULLCLOSE(pCtx, pFile);
 }
 
 //////////////////////////////////////////////////////////////////
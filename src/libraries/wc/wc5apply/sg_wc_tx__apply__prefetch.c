@@ -0,0 +1,247 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file sg_wc_tx__apply__prefetch.c
+ *
+ * @details Fetch the contents of files from the repo before
+ * we run the journal.
+ *
+ * The journal must be applied to the WD one step at a time
+ * and in order (a file can't be created until its parent
+ * directory has been created or moved into place, etc.).
+ * But most of the time spent in a big UPDATE or REVERT is in
+ * fetching blobs (undeltify, inflate, write) and those don't
+ * depend on each other.
+ *
+ * So before we start on the journal we look for the steps that
+ * need to create a file from a blob and fetch all of those blobs
+ * into temp files in <sgtemp> in parallel.  Then, when the
+ * journal step runs, it just moves the temp file into place.
+ *
+ * This doesn't alter the WD until the journal runs, so it
+ * doesn't change what happens if we fail or crash; at worst
+ * we leave some garbage in <sgtemp>.
+ *
+ */
+
+//////////////////////////////////////////////////////////////////
+
+#include <sg.h>
+
+#include "sg_wc__public_typedefs.h"
+#include "sg_wc__public_prototypes.h"
+#include "sg_wc__private.h"
+
+//////////////////////////////////////////////////////////////////
+
+// If there are only a few files, it isn't worth the extra
+// rename to do them ahead of time.
+#define sg_WC_TX__APPLY__PREFETCH__MIN_FILES	(32)
+
+//////////////////////////////////////////////////////////////////
+
+/**
+ * If this journal step will create a file from a blob,
+ * return the GID and HID.  Otherwise return NULLs.
+ *
+ */
+static void _get_candidate(SG_context * pCtx,
+						   const SG_vhash * pvh,
+						   const char ** ppszGid,
+						   const char ** ppszHidBlob)
+{
+	const char * pszOp;
+	const char * pszHidBlob = NULL;
+	SG_bool bSkip = SG_FALSE;
+
+	*ppszGid = NULL;
+	*ppszHidBlob = NULL;
+
+	SG_ERR_CHECK_RETURN(  SG_vhash__get__sz(pCtx, pvh, "op", &pszOp)  );
+
+	if ((strcmp(pszOp, "special_add_file") == 0)
+		|| (strcmp(pszOp, "overwrite_file_from_repo") == 0))
+	{
+		SG_ERR_CHECK_RETURN(  SG_vhash__get__bool(pCtx, pvh, "src_sparse", &bSkip)  );
+	}
+	else if (strcmp(pszOp, "undo_delete_file") == 0)
+	{
+		SG_ERR_CHECK_RETURN(  SG_vhash__get__bool(pCtx, pvh, "make_sparse", &bSkip)  );
+	}
+	else if (strcmp(pszOp, "undo_lost_file") != 0)
+	{
+		return;
+	}
+
+	if (bSkip)
+		return;
+
+	// "undo_" steps may restore from a temp file rather than a blob.
+
+	SG_ERR_CHECK_RETURN(  SG_vhash__check__sz(pCtx, pvh, "hid", &pszHidBlob)  );
+	if (!pszHidBlob)
+		return;
+
+	SG_ERR_CHECK_RETURN(  SG_vhash__get__sz(pCtx, pvh, "gid", ppszGid)  );
+	*ppszHidBlob = pszHidBlob;
+}
+
+static void _make_key(SG_context * pCtx,
+					  SG_string * pStringKey,
+					  const char * pszGid,
+					  const char * pszHidBlob)
+{
+	SG_ERR_CHECK_RETURN(  SG_string__sprintf(pCtx, pStringKey, "%s:%s", pszGid, pszHidBlob)  );
+}
+
+/**
+ * Fetch the blobs for all of the file-creating steps
+ * in the journal into <sgtemp>.
+ *
+ */
+void sg_wc_tx__apply__prefetch(SG_context * pCtx, SG_wc_tx * pWcTx)
+{
+	sg_wc_fetch_blobs * pFetch = NULL;
+	SG_string * pStringKey = NULL;
+	SG_pathname * pPathTemp = NULL;
+	char bufName[32];
+	SG_uint32 nrSteps = 0;
+	SG_uint32 nrCandidates = 0;
+	SG_uint32 k;
+
+	SG_ERR_CHECK(  SG_varray__count(pCtx, pWcTx->pvaJournal, &nrSteps)  );
+	for (k=0; k<nrSteps; k++)
+	{
+		SG_vhash * pvh;
+		const char * pszGid;
+		const char * pszHidBlob;
+
+		SG_ERR_CHECK(  SG_varray__get__vhash(pCtx, pWcTx->pvaJournal, k, &pvh)  );
+		SG_ERR_CHECK(  _get_candidate(pCtx, pvh, &pszGid, &pszHidBlob)  );
+		if (pszHidBlob)
+			nrCandidates++;
+	}
+
+	if (nrCandidates < sg_WC_TX__APPLY__PREFETCH__MIN_FILES)
+		return;
+
+	SG_ERR_CHECK(  SG_workingdir__generate_and_create_temp_dir_for_purpose(pCtx,
+																		   pWcTx->pDb->pPathWorkingDirectoryTop,
+																		   "apply",
+																		   &pWcTx->pPathPrefetchDir)  );
+	SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pWcTx->pvhPrefetched)  );
+	SG_ERR_CHECK(  sg_wc_fetch_blobs__alloc(pCtx, pWcTx->pDb->pRepo, &pFetch)  );
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pStringKey)  );
+
+	for (k=0; k<nrSteps; k++)
+	{
+		SG_vhash * pvh;
+		const char * pszGid;
+		const char * pszHidBlob;
+		SG_bool bFound;
+
+		SG_ERR_CHECK(  SG_varray__get__vhash(pCtx, pWcTx->pvaJournal, k, &pvh)  );
+		SG_ERR_CHECK(  _get_candidate(pCtx, pvh, &pszGid, &pszHidBlob)  );
+		if (!pszHidBlob)
+			continue;
+
+		// If the same item gets the same content more than once
+		// in the journal (unlikely), only the first step uses the
+		// prefetched copy; the others fetch it the normal way.
+
+		SG_ERR_CHECK(  _make_key(pCtx, pStringKey, pszGid, pszHidBlob)  );
+		SG_ERR_CHECK(  SG_vhash__has(pCtx, pWcTx->pvhPrefetched, SG_string__sz(pStringKey), &bFound)  );
+		if (bFound)
+			continue;
+
+		SG_ERR_CHECK(  SG_sprintf(pCtx, bufName, sizeof(bufName), "%08d", k)  );
+		SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathTemp, pWcTx->pPathPrefetchDir, bufName)  );
+		SG_ERR_CHECK(  sg_wc_fetch_blobs__add(pCtx, pFetch, pszHidBlob, pPathTemp, 0644)  );
+		SG_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pWcTx->pvhPrefetched,
+												 SG_string__sz(pStringKey),
+												 SG_pathname__sz(pPathTemp))  );
+		SG_PATHNAME_NULLFREE(pCtx, pPathTemp);
+	}
+
+	SG_ERR_CHECK(  sg_wc_fetch_blobs__run(pCtx, pFetch)  );
+
+fail:
+	SG_WC_FETCH_BLOBS__NULLFREE(pCtx, pFetch);
+	SG_STRING_NULLFREE(pCtx, pStringKey);
+	SG_PATHNAME_NULLFREE(pCtx, pPathTemp);
+}
+
+//////////////////////////////////////////////////////////////////
+
+/**
+ * Create a NEW file at the given path with the contents of the
+ * given blob.  If we prefetched it, just move the temp file into
+ * place; otherwise fetch it now.  The caller must apply the
+ * attrbits.
+ *
+ */
+void sg_wc_tx__apply__fetch_file(SG_context * pCtx,
+								 SG_wc_tx * pWcTx,
+								 const char * pszGid,
+								 const char * pszHidBlob,
+								 const SG_pathname * pPath)
+{
+	SG_string * pStringKey = NULL;
+	SG_pathname * pPathTemp = NULL;
+	SG_file * pFile = NULL;
+	const char * pszPathTemp = NULL;
+	SG_bool bExists = SG_FALSE;
+
+	if (pWcTx->pvhPrefetched)
+	{
+		SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pStringKey)  );
+		SG_ERR_CHECK(  _make_key(pCtx, pStringKey, pszGid, pszHidBlob)  );
+		SG_ERR_CHECK(  SG_vhash__check__sz(pCtx, pWcTx->pvhPrefetched, SG_string__sz(pStringKey), &pszPathTemp)  );
+	}
+
+	if (pszPathTemp)
+	{
+		SG_ERR_CHECK(  SG_PATHNAME__ALLOC__SZ(pCtx, &pPathTemp, pszPathTemp)  );
+		SG_ERR_CHECK(  SG_vhash__remove(pCtx, pWcTx->pvhPrefetched, SG_string__sz(pStringKey))  );
+
+		// A rename would silently replace an existing file, so make
+		// the same check that SG_FILE_CREATE_NEW does below.
+
+		SG_ERR_CHECK(  SG_fsobj__exists__pathname(pCtx, pPath, &bExists, NULL, NULL)  );
+		if (bExists)
+			SG_ERR_THROW2(  SG_ERR_WC__ITEM_ALREADY_EXISTS,
+							(pCtx, "%s", SG_pathname__sz(pPath))  );
+
+		SG_ERR_CHECK(  SG_fsobj__move__pathname_pathname(pCtx, pPathTemp, pPath)  );
+	}
+	else
+	{
+		SG_ERR_CHECK(  SG_file__open__pathname(pCtx,
+											   pPath,
+											   SG_FILE_WRONLY|SG_FILE_CREATE_NEW,
+											   0644,
+											   &pFile)  );
+		SG_ERR_CHECK(  SG_repo__fetch_blob_into_file(pCtx, pWcTx->pDb->pRepo, pszHidBlob, pFile, NULL)  );
+		SG_FILE_NULLCLOSE(pCtx, pFile);
+	}
+
+fail:
+	SG_STRING_NULLFREE(pCtx, pStringKey);
+	SG_PATHNAME_NULLFREE(pCtx, pPathTemp);
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+}
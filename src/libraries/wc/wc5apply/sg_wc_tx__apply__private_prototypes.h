@@ -33,6 +33,14 @@ BEGIN_EXTERN_C;
 
 void sg_wc_tx__run_apply(SG_context * pCtx, SG_wc_tx * pWcTx);
 
+void sg_wc_tx__apply__prefetch(SG_context * pCtx, SG_wc_tx * pWcTx);
+
+void sg_wc_tx__apply__fetch_file(SG_context * pCtx,
+								 SG_wc_tx * pWcTx,
+								 const char * pszGid,
+								 const char * pszHidBlob,
+								 const SG_pathname * pPath);
+
 void sg_wc_tx__apply__add(SG_context * pCtx,
 						  SG_wc_tx * pWcTx,
 						  const SG_vhash * pvh);
@@ -34,7 +34,6 @@ void sg_wc_tx__apply__undo_lost__file(SG_context * pCtx,
 	const char * pszRepoPathTempFile = NULL;
 	SG_int64 attrbits;
 	SG_pathname * pPath = NULL;
-	SG_file * pFile = NULL;
 	SG_pathname * pPathTempFile = NULL;
 
 	SG_ERR_CHECK_RETURN(  SG_vhash__get__sz(   pCtx, pvh, "src",            &pszRepoPath)  );
@@ -55,13 +54,7 @@ void sg_wc_tx__apply__undo_lost__file(SG_context * pCtx,
 
 	if (pszHidBlob)
 	{
-		SG_ERR_CHECK(  SG_file__open__pathname(pCtx,
-											   pPath,
-											   SG_FILE_WRONLY|SG_FILE_CREATE_NEW,
-											   0644,
-											   &pFile)  );
-		SG_ERR_CHECK(  SG_repo__fetch_blob_into_file(pCtx, pWcTx->pDb->pRepo, pszHidBlob, pFile, NULL)  );
-		SG_FILE_NULLCLOSE(pCtx, pFile);
+		SG_ERR_CHECK(  sg_wc_tx__apply__fetch_file(pCtx, pWcTx, pszGid, pszHidBlob, pPath)  );
 	}
 	else if (pszRepoPathTempFile)
 	{
@@ -91,7 +84,6 @@ void sg_wc_tx__apply__undo_lost__file(SG_context * pCtx,
 fail:
 	SG_PATHNAME_NULLFREE(pCtx, pPath);
 	SG_PATHNAME_NULLFREE(pCtx, pPathTempFile);
-	SG_FILE_NULLCLOSE(pCtx, pFile);
 }
 
 void sg_wc_tx__apply__undo_lost__directory(SG_context * pCtx,
@@ -221,6 +221,7 @@ void SG_wc_tx__free(SG_context * pCtx, SG_wc_tx * pWcTx)
 	}
 
 	SG_VARRAY_NULLFREE(pCtx, pWcTx->pvaJournal);
+	SG_ARENA_NULLFREE(pCtx, pWcTx->pArenaJournal);
 	// The list of JournalStmts must be freed before we close/free the DB.
 	SG_VECTOR_NULLFREE_WITH_ASSOC(pCtx, pWcTx->pvecJournalStmts, (SG_free_callback *)_my_sqlite__finalize);
 
@@ -260,6 +261,16 @@ void SG_wc_tx__free(SG_context * pCtx, SG_wc_tx * pWcTx)
 		SG_PATHNAME_NULLFREE(pCtx, pWcTx->pPathSessionTempDir);
 	}
 
+	SG_VHASH_NULLFREE(pCtx, pWcTx->pvhPrefetched);
+	if (pWcTx->pPathPrefetchDir)
+	{
+		// Normally this is empty by now, but if the APPLY failed
+		// it may still have some files that we didn't use.
+
+		SG_ERR_IGNORE(  SG_fsobj__rmdir_recursive__pathname(pCtx, pWcTx->pPathPrefetchDir)  );
+		SG_PATHNAME_NULLFREE(pCtx, pWcTx->pPathPrefetchDir);
+	}
+
 	SG_NULLFREE(pCtx, pWcTx);
 }
 
@@ -314,7 +325,8 @@ void SG_wc_tx__alloc__begin(SG_context * pCtx,
 	SG_ERR_CHECK(  SG_RBTREE_UI64__ALLOC(pCtx, &pWcTx->prb64LiveViewDirCache)  );
 	SG_ERR_CHECK(  SG_RBTREE_UI64__ALLOC(pCtx, &pWcTx->prb64LiveViewItemCache)  );
 
-	SG_ERR_CHECK(  SG_VARRAY__ALLOC(pCtx, &pWcTx->pvaJournal)  );
+	SG_ERR_CHECK(  SG_ARENA__ALLOC(pCtx, &pWcTx->pArenaJournal, 0)  );
+	SG_ERR_CHECK(  SG_varray__alloc__arena(pCtx, &pWcTx->pvaJournal, 0, pWcTx->pArenaJournal)  );
 	SG_ERR_CHECK(  SG_VECTOR__ALLOC(pCtx, &pWcTx->pvecJournalStmts, 100)  );
 	
 	SG_ERR_CHECK(  sg_wc_db__open_db(pCtx, pRepo, pPathWorkingDirectoryTop, (pPathGiven == NULL), &pWcTx->pDb)  );
@@ -594,7 +606,8 @@ void SG_wc_tx__alloc__begin__create(SG_context * pCtx,
 	SG_ERR_CHECK(  SG_RBTREE_UI64__ALLOC(pCtx, &pWcTx->prb64LiveViewDirCache)  );
 	SG_ERR_CHECK(  SG_RBTREE_UI64__ALLOC(pCtx, &pWcTx->prb64LiveViewItemCache)  );
 
-	SG_ERR_CHECK(  SG_VARRAY__ALLOC(pCtx, &pWcTx->pvaJournal)  );
+	SG_ERR_CHECK(  SG_ARENA__ALLOC(pCtx, &pWcTx->pArenaJournal, 0)  );
+	SG_ERR_CHECK(  SG_varray__alloc__arena(pCtx, &pWcTx->pvaJournal, 0, pWcTx->pArenaJournal)  );
 	SG_ERR_CHECK(  SG_VECTOR__ALLOC(pCtx, &pWcTx->pvecJournalStmts, 100)  );
 	
 	// Specifying SG_FALSE for bWorkingDirPathFromCwd here is kind of a hack. This flag controls
@@ -140,6 +140,7 @@ struct _populate_data
 {
 	SG_wc_tx * pWcTx;					// we do not own this (this is inherited/shared from the top)
 	SG_file_spec * pFilespec;			// we do not own this (this is inherited/shared from the top)
+	sg_wc_fetch_blobs * pFetch;			// we do not own this (this is inherited/shared from the top)
 	const SG_pathname * pPathDir;		// we do not own this
 	SG_wc_port * pPort;
 };
@@ -147,6 +148,7 @@ struct _populate_data
 static void _dive_into_dir(SG_context * pCtx, 
 						   SG_wc_tx * pWcTx,
 						   SG_file_spec * pFilespec,
+						   sg_wc_fetch_blobs * pFetch,
 						   const SG_pathname * pPath,
 						   SG_uint64 uiAliasGid)
 {
@@ -154,6 +156,7 @@ static void _dive_into_dir(SG_context * pCtx,
 	
 	dirData.pWcTx               = pWcTx;
 	dirData.pFilespec           = pFilespec;
+	dirData.pFetch              = pFetch;
 	dirData.pPathDir            = pPath;
 	dirData.pPort               = NULL;
 
@@ -192,6 +195,7 @@ static void _populate_dir(SG_context * pCtx,
 	SG_ERR_CHECK(  _dive_into_dir(pCtx,
 								  pDirData->pWcTx,
 								  pDirData->pFilespec,
+								  pDirData->pFetch,
 								  pPath,
 								  pTneRow->p_s->uiAliasGid)  );
 
@@ -199,12 +203,17 @@ fail:
 	return;
 }
 
+/**
+ * Queue the file to be fetched from the repo.  We do all of
+ * the files in parallel after we have walked the whole tree
+ * and created all of the directories.
+ *
+ */
 static void _populate_file(SG_context * pCtx, 
 						   struct _populate_data * pDirData,
 						   const SG_pathname * pPath,
 						   sg_wc_db__tne_row * pTneRow)
 {
-	SG_file * pFile = NULL;
 	SG_fsobj_perms perms = 0;
 
 	// TODO 2011/10/19 I'm going to assume for now that all of the defined
@@ -225,21 +234,13 @@ static void _populate_file(SG_context * pCtx,
 				   SG_pathname__sz(pPath))  );
 #endif
 
-	SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_RDWR | SG_FILE_CREATE_NEW, perms, &pFile)  );
-	SG_ERR_CHECK(  SG_repo__fetch_blob_into_file(pCtx,
-												 pDirData->pWcTx->pDb->pRepo,
-												 pTneRow->p_d->pszHid,
-												 pFile,
-												 NULL)  );
-	SG_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+	SG_ERR_CHECK(  sg_wc_fetch_blobs__add(pCtx, pDirData->pFetch, pTneRow->p_d->pszHid, pPath, perms)  );
 
 	// We DO NOT record anything in the Timestamp Cache
 	// because of the clock blurr problem.
 
-	return;
-
 fail:
-	SG_ERR_IGNORE(  SG_file__close(pCtx, &pFile)  );
+	return;
 }
 
 #if !defined(WINDOWS)
@@ -480,6 +481,7 @@ static void _populate_from_root(SG_context * pCtx, SG_wc_tx * pWcTx,
 								SG_file_spec * pFilespec)
 {
 	SG_uint64 uiAliasGid_Root = 0;	// init only to quiet compiler
+	sg_wc_fetch_blobs * pFetch = NULL;
 
 #if TRACE_WC_CHECKOUT
 	SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDERR, "Checkout: beginning populate_from_root: %s\n",
@@ -489,10 +491,14 @@ static void _populate_from_root(SG_context * pCtx, SG_wc_tx * pWcTx,
 	SG_ERR_CHECK(  _finish_populate_of_root_directory(pCtx, pWcTx, &uiAliasGid_Root)  );
 	
 	// dive into the tree.  we do not have any depth limits here.
+	// this creates the directories and symlinks and queues up
+	// the files.  then fetch the files in parallel.
 
-	SG_ERR_CHECK(  _dive_into_dir(pCtx, pWcTx, pFilespec,
+	SG_ERR_CHECK(  sg_wc_fetch_blobs__alloc(pCtx, pWcTx->pDb->pRepo, &pFetch)  );
+	SG_ERR_CHECK(  _dive_into_dir(pCtx, pWcTx, pFilespec, pFetch,
 								  pWcTx->pDb->pPathWorkingDirectoryTop,
 								  uiAliasGid_Root)  );
+	SG_ERR_CHECK(  sg_wc_fetch_blobs__run(pCtx, pFetch)  );
 
 #if TRACE_WC_CHECKOUT
 	SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDERR, "Checkout: finished populate_from_root: %s\n",
@@ -500,7 +506,7 @@ static void _populate_from_root(SG_context * pCtx, SG_wc_tx * pWcTx,
 #endif
 
 fail:
-	return;
+	SG_WC_FETCH_BLOBS__NULLFREE(pCtx, pFetch);
 }
 
 //////////////////////////////////////////////////////////////////
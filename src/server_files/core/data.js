@@ -16,18 +16,49 @@ limitations under the License.
 
 var dispatchBlobDownload = function (request, download)
 {
+    // A blob never changes, so its HID makes a strong ETag.
+    var etag = "\"" + request.hid + "\"";
+    var inm = request.headers["If-None-Match"];
+    var response;
+
+    if (inm && (inm.indexOf(etag) >= 0 || inm.indexOf("*") >= 0))
+    {
+        return {
+            statusCode: STATUS_CODE__NOT_MODIFIED,
+            headers: { "Content-Length": 0, "ETag": etag }
+        };
+    }
+
     // todo: return 404 error if hid not found
-    var blob = request.repo.fetch_blob(request.hid, 2 * 1024 * 1024);
+    var range = request.repo.blob_file_range(request.hid);
 
-    var response = {
-        statusCode: STATUS_CODE__OK,
-        headers: {
-            "Content-Length": blob.length          
-        },
-        onChunk: function () { return blob.next_chunk(request.repo); },
-        onFinish: function () { blob.abort(request.repo); },
-        finalize: function () { blob.abort(request.repo); }
-    };
+    if (range)
+    {
+        // Stored uncompressed; the server sends it (or the Range asked for)
+        // straight from the blob file.
+        response = {
+            statusCode: STATUS_CODE__OK,
+            headers: {
+                "Content-Length": range.length
+            },
+            sendFile: { path: range.path, offset: range.offset }
+        };
+    }
+    else
+    {
+        var blob = request.repo.fetch_blob(request.hid, 2 * 1024 * 1024);
+
+        response = {
+            statusCode: STATUS_CODE__OK,
+            headers: {
+                "Content-Length": blob.length
+            },
+            onChunk: function () { return blob.next_chunk(request.repo); },
+            onFinish: function () { blob.abort(request.repo); },
+            finalize: function () { blob.abort(request.repo); }
+        };
+    }
+    response.headers["ETag"] = etag;
 
     if (download)
     {
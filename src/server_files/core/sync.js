@@ -20,12 +20,39 @@ limitations under the License.
 
 function fragballResponse(request, data)
 {
+	if (data && (data.clone !== undefined))
+		return cloneFragballResponse(request, data);
+
 	var tmpdir = sg.fs.tmpdir();
 	var fragball_file_path = tmpdir + "/" + sg.sync_remote.request_fragball(request.repo, tmpdir, data);
 	var response = fileResponse(fragball_file_path, true);
 	return response;
 }
 
+/**
+ * Clone fragballs aren't deleted once they're sent, so a client whose download
+ * was interrupted can send Range and If-Range to get just the part it's missing.
+ * The ETag comes from the file itself (its name, modification time and size,
+ * like the one mongoose makes for static files), so a fragball that was rebuilt
+ * under the same name doesn't match a partial download of the old one.
+ * If the fragball may be behind the repo (the client said it would top up, and
+ * got a cached one), X-Veracity-Clone-Stale tells the client to pull afterward.
+ */
+function cloneFragballResponse(request, data)
+{
+	var tmpdir = sg.fs.tmpdir();
+	var fragball = sg.sync_remote.request_clone_fragball(request.repo, tmpdir, data.clone_request);
+	var path = tmpdir + "/" + fragball.name;
+	var st = sg.fs.stat(path);
+	var response = fileResponse(path, false, CONTENT_TYPE__FRAGBALL);
+
+	response.headers["ETag"] = '"' + fragball.name + "." + st.modtime.getTime().toString(16) + "." + st.size.toString(16) + '"';
+	if (fragball.stale)
+		response.headers["X-Veracity-Clone-Stale"] = "1";
+
+	return response;
+}
+
 registerRoutes({
 
     "/version.txt":
@@ -177,6 +177,7 @@ var fileResponse = function (path, deleteWhenDone, contentType, forceDownload, f
         headers: {
             "Content-Length": file.total_length
         },
+        sendFile: { path: path, offset: 0 },
         onChunk: function () { return file.next_chunk(); },
         finalize: function () { file.abort(); },
         onFinish: function () { file.abort(); }
@@ -471,8 +472,13 @@ var getDefaultRepoName = function (request) {
 //                                  or an array of values.  In that case, the
 //                                  header will be sent multiple times to the client.
 //
-//     onChunk: function() **REQUIRED (unless Content-Length is 0)**
+//     onChunk: function() **REQUIRED (unless Content-Length is 0 or there's a sendFile)**
 //                         Function must return a "cbuffer".
+//     sendFile: { path: string, offset: int or string }
+//                       - The body is Content-Length bytes of this file, starting at
+//                         offset (default 0). The server sends them itself, with
+//                         sendfile() where it can, and answers Range requests.
+//                         onFinish/finalize are still called.
 //     onFinish: function() - Called after the last chunk has been sent. If this
 //                            function throws an exception or tries to return a
 //                            value of any kind it will be ignored.
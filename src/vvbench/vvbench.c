@@ -0,0 +1,608 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file vvbench.c
+ *
+ * @details vvbench runs reproducible end-to-end benchmarks against
+ * the library and writes the timings as JSON.
+ *
+ * Usage:
+ *
+ *     vvbench <suite> [--dir <path>] [--output <file>] [--seed <n>]
+ *                     [--iterations <n>] [--keep] [suite options]
+ *
+ * Repos are created in the closet given by $SGCLOSET (as for the
+ * test suite), so point it somewhere disposable.
+ *
+ */
+
+#include <sg.h>
+#include <sg_wc__public_typedefs.h>
+#include <sg_wc__public_prototypes.h>
+#include <sg_vv2__public_typedefs.h>
+#include <sg_vv2__public_prototypes.h>
+
+#include "vvbench.h"
+
+//////////////////////////////////////////////////////////////////
+
+struct _vvbench_suite_entry
+{
+	const char *		pszName;
+	vvbench__suite *	pfn;
+	const char *		pszUsage;
+};
+
+static struct _vvbench_suite_entry s_aSuites[] =
+{
+	{ "wc", vvbench__suite__wc,
+	  "[--files <n>] [--depth <n>] [--fanout <n>] [--size <bytes>] [--binary <percent>] [--modify <percent>]" },
+	{ "sync", vvbench__suite__sync,
+	  "[tree options as for wc] [--changesets <n>] [--incremental <n>] [--modify <percent>] [--port <n>]" },
+	{ "vhash", vvbench__suite__vhash,
+	  "[--keys <n>] [--ops <n>]" },
+};
+
+//////////////////////////////////////////////////////////////////
+
+void vvbench__option__uint32(SG_context * pCtx,
+							 vvbench * pBench,
+							 const char * pszName,
+							 SG_uint32 valDefault,
+							 SG_uint32 * pVal)
+{
+	const char * pszValue = NULL;
+	SG_uint32 val = valDefault;
+
+	SG_ERR_CHECK(  SG_vhash__check__sz(pCtx, pBench->pvhOptions, pszName, &pszValue)  );
+	if (pszValue)
+	{
+		SG_uint32__parse__strict(pCtx, &val, pszValue);
+		if (SG_CONTEXT__HAS_ERR(pCtx))
+			SG_ERR_RESET_THROW2(  SG_ERR_USAGE, (pCtx, "--%s needs a number, not '%s'.", pszName, pszValue)  );
+		SG_ERR_CHECK(  SG_vhash__remove(pCtx, pBench->pvhOptions, pszName)  );
+	}
+
+	SG_ERR_CHECK(  SG_vhash__update__int64(pCtx, pBench->pvhParams, pszName, (SG_int64)val)  );
+	*pVal = val;
+
+fail:
+	return;
+}
+
+void vvbench__options__done(SG_context * pCtx, vvbench * pBench)
+{
+	SG_uint32 count = 0;
+	const char * pszName = NULL;
+
+	SG_ERR_CHECK_RETURN(  SG_vhash__count(pCtx, pBench->pvhOptions, &count)  );
+	if (count)
+	{
+		SG_ERR_CHECK_RETURN(  SG_vhash__get_nth_pair(pCtx, pBench->pvhOptions, 0, &pszName, NULL)  );
+		SG_ERR_THROW2_RETURN(  SG_ERR_USAGE, (pCtx, "This suite doesn't take --%s.", pszName)  );
+	}
+}
+
+//////////////////////////////////////////////////////////////////
+
+void vvbench__phase__begin(SG_context * pCtx, vvbench * pBench, const char * pszName)
+{
+	SG_ASSERT(  (pBench->pvhPhase == NULL)  );
+
+	SG_ERR_CHECK_RETURN(  SG_varray__appendnew__vhash(pCtx, pBench->pvaPhases, &pBench->pvhPhase)  );
+	SG_ERR_CHECK_RETURN(  SG_vhash__add__string__sz(pCtx, pBench->pvhPhase, "name", pszName)  );
+	SG_ERR_CHECK_RETURN(  SG_vhash__addnew__vhash(pCtx, pBench->pvhPhase, "operations", &pBench->pvhOperations)  );
+
+	SG_ERR_CHECK_RETURN(  SG_time__get_milliseconds_since_1970_utc(pCtx, &pBench->timePhaseStart)  );
+}
+
+void vvbench__phase__set_counter(SG_context * pCtx, vvbench * pBench, const char * pszName, SG_int64 value)
+{
+	SG_NULLARGCHECK_RETURN(pBench->pvhPhase);
+
+	SG_ERR_CHECK_RETURN(  SG_vhash__update__int64(pCtx, pBench->pvhPhase, pszName, value)  );
+}
+
+void vvbench__phase__end(SG_context * pCtx, vvbench * pBench)
+{
+	SG_int64 timeEnd = 0;
+
+	SG_NULLARGCHECK_RETURN(pBench->pvhPhase);
+
+	SG_ERR_CHECK_RETURN(  SG_time__get_milliseconds_since_1970_utc(pCtx, &timeEnd)  );
+	SG_ERR_CHECK_RETURN(  SG_vhash__add__int64(pCtx, pBench->pvhPhase, "ms", timeEnd - pBench->timePhaseStart)  );
+
+	pBench->pvhPhase = NULL;
+	pBench->pvhOperations = NULL;
+}
+
+/**
+ * Add one occurrence taking ms to the named entry of the current phase.
+ */
+static void _charge(SG_context * pCtx, vvbench * pBench, const char * pszName, SG_int64 ms)
+{
+	SG_vhash * pvhOp = NULL;
+	SG_int64 count = 0;
+	SG_int64 msSoFar = 0;
+
+	if (pBench->pvhOperations == NULL)
+		return;
+
+	SG_ERR_CHECK_RETURN(  SG_vhash__check__vhash(pCtx, pBench->pvhOperations, pszName, &pvhOp)  );
+	if (pvhOp)
+	{
+		SG_ERR_CHECK_RETURN(  SG_vhash__get__int64(pCtx, pvhOp, "count", &count)  );
+		SG_ERR_CHECK_RETURN(  SG_vhash__get__int64(pCtx, pvhOp, "ms", &msSoFar)  );
+	}
+	else
+	{
+		SG_ERR_CHECK_RETURN(  SG_vhash__addnew__vhash(pCtx, pBench->pvhOperations, pszName, &pvhOp)  );
+	}
+	SG_ERR_CHECK_RETURN(  SG_vhash__update__int64(pCtx, pvhOp, "count", count + 1)  );
+	SG_ERR_CHECK_RETURN(  SG_vhash__update__int64(pCtx, pvhOp, "ms", msSoFar + ms)  );
+}
+
+/**
+ * Charge the step an operation is leaving, as "operation / step".
+ */
+static void _charge_step(SG_context * pCtx,
+						 vvbench * pBench,
+						 vvbench_operation * pOp,
+						 const char * pszDescription,
+						 SG_int64 timeNow)
+{
+	SG_string * pString = NULL;
+
+	if (pOp->szStep[0] == 0)
+		return;
+
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pString)  );
+	SG_ERR_CHECK(  SG_string__append__format(pCtx, pString, "%s / %s", pszDescription, pOp->szStep)  );
+	SG_ERR_CHECK(  _charge(pCtx, pBench, SG_string__sz(pString), timeNow - pOp->timeStepStart)  );
+	pOp->szStep[0] = 0;
+
+fail:
+	SG_STRING_NULLFREE(pCtx, pString);
+}
+
+/**
+ * SG_log handler: charge each completed operation, and each step
+ * within it, to the current phase.  Operations nest, so these times
+ * are inclusive and don't add up to the phase time.
+ *
+ * Only operations on the main thread's context are counted; helper
+ * threads have log stacks of their own.
+ */
+static void _log__operation(SG_context * pCtx,
+							void * pThis,
+							const SG_log__operation * pOperation,
+							SG_log__operation_change eChange,
+							SG_bool * pCancel)
+{
+	vvbench * pBench = (vvbench *)pThis;
+	vvbench_operation * pOp = NULL;
+	const char * pszDescription = NULL;
+	const char * pszStep = NULL;
+	SG_int64 timeNow = 0;
+	SG_int64 elapsed = 0;
+
+	SG_UNUSED(pCancel);
+
+	if (pCtx != pBench->pCtx)
+		return;
+
+	if (eChange == SG_LOG__OPERATION__PUSHED)
+	{
+		if (pBench->depthOperations < VVBENCH_MAX_OPERATION_DEPTH)
+		{
+			pOp = &pBench->aOperations[pBench->depthOperations];
+			pOp->pOperation = pOperation;
+			pOp->szStep[0] = 0;
+		}
+		pBench->depthOperations++;
+		return;
+	}
+	if (eChange == SG_LOG__OPERATION__POPPED)
+	{
+		if (pBench->depthOperations)
+			pBench->depthOperations--;
+		return;
+	}
+	if (eChange != SG_LOG__OPERATION__STEP_DESCRIBED && eChange != SG_LOG__OPERATION__COMPLETED)
+		return;
+
+	if (pBench->depthOperations && pBench->depthOperations <= VVBENCH_MAX_OPERATION_DEPTH
+		&& pBench->aOperations[pBench->depthOperations - 1].pOperation == pOperation)
+		pOp = &pBench->aOperations[pBench->depthOperations - 1];
+
+	SG_ERR_CHECK(  SG_log__operation__get_basic(pCtx, pOperation, &pszDescription, &pszStep, NULL)  );
+	SG_ERR_CHECK(  SG_log__operation__get_time(pCtx, pOperation, NULL, &timeNow, &elapsed)  );
+	if (pszDescription == NULL || *pszDescription == 0)
+		pszDescription = "(unnamed)";
+
+	if (pOp)
+		SG_ERR_CHECK(  _charge_step(pCtx, pBench, pOp, pszDescription, timeNow)  );
+
+	if (eChange == SG_LOG__OPERATION__COMPLETED)
+	{
+		SG_ERR_CHECK(  _charge(pCtx, pBench, pszDescription, elapsed)  );
+	}
+	else if (pOp && pszStep && *pszStep)
+	{
+		// a truncated step name is still a fine key
+		SG_strcpy(pCtx, pOp->szStep, sizeof(pOp->szStep), pszStep);
+		SG_ERR_CHECK_CURRENT_DISREGARD(SG_ERR_BUFFERTOOSMALL);
+		pOp->timeStepStart = timeNow;
+	}
+
+fail:
+	return;
+}
+
+static SG_log__handler s_logHandler =
+{
+	NULL,
+	_log__operation,
+	NULL,
+	NULL,
+	NULL,
+};
+
+//////////////////////////////////////////////////////////////////
+
+SG_uint32 vvbench__random(vvbench * pBench)
+{
+	// xorshift32
+	SG_uint32 x = pBench->random;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	pBench->random = x;
+	return x;
+}
+
+void vvbench__write_file(SG_context * pCtx,
+						 vvbench * pBench,
+						 const SG_pathname * pPath,
+						 SG_uint32 size,
+						 SG_bool bBinary,
+						 SG_bool bAppend)
+{
+	SG_file * pFile = NULL;
+	SG_string * pString = NULL;
+	SG_byte * pBytes = NULL;
+	SG_uint64 len = 0;
+	SG_uint32 k;
+
+	if (bAppend)
+	{
+		SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_OPEN_EXISTING | SG_FILE_WRONLY, 0644, &pFile)  );
+		SG_ERR_CHECK(  SG_file__seek_end(pCtx, pFile, &len)  );
+	}
+	else
+	{
+		SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_CREATE_NEW | SG_FILE_WRONLY, 0644, &pFile)  );
+	}
+
+	if (bBinary)
+	{
+		SG_ERR_CHECK(  SG_allocN(pCtx, size + 1, pBytes)  );
+		for (k=0; k<size; k++)
+			pBytes[k] = (SG_byte)(vvbench__random(pBench) >> 11);
+		SG_ERR_CHECK(  SG_file__write(pCtx, pFile, size, pBytes, NULL)  );
+	}
+	else
+	{
+		SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pString)  );
+		do
+		{
+			// a few words from a small vocabulary, so the content
+			// compresses and deltifies about like source code does.
+			SG_uint32 r = vvbench__random(pBench);
+
+			SG_ERR_CHECK(  SG_string__append__format(pCtx, pString, "%s %s_%u = %u;\n",
+													 ((r & 1) ? "int" : "const char*"),
+													 ((r & 2) ? "value" : "name"),
+													 (r >> 8) % 1000,
+													 (r >> 4) % 97)  );
+		} while (SG_string__length_in_bytes(pString) < size);
+		SG_ERR_CHECK(  SG_file__write__string(pCtx, pFile, pString)  );
+	}
+
+	SG_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+
+fail:
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+	SG_STRING_NULLFREE(pCtx, pString);
+	SG_NULLFREE(pCtx, pBytes);
+}
+
+void vvbench__new_repo(SG_context * pCtx,
+					   const char * pszRepoName,
+					   const SG_pathname * pPathWd)
+{
+	SG_repo * pRepo = NULL;
+
+	SG_ERR_CHECK(  SG_vv2__init_new_repo(pCtx,
+										 pszRepoName,
+										 SG_pathname__sz(pPathWd),
+										 NULL,			// default storage
+										 NULL,			// default hash method
+										 SG_FALSE,		// bNoWD
+										 NULL,			// shared users
+										 SG_FALSE,		// bFromUserMaster
+										 NULL,
+										 NULL)  );
+	SG_ERR_CHECK(  SG_REPO__OPEN_REPO_INSTANCE(pCtx, pszRepoName, &pRepo)  );
+	SG_ERR_CHECK(  SG_user__create(pCtx, pRepo, "vvbench@sourcegear.com", NULL)  );
+	SG_ERR_CHECK(  SG_user__set_user__repo(pCtx, pRepo, "vvbench@sourcegear.com")  );
+
+fail:
+	SG_REPO_NULLFREE(pCtx, pRepo);
+}
+
+void vvbench__delete_repo(SG_context * pCtx, const char * pszRepoName)
+{
+	SG_ERR_IGNORE(  SG_repo__delete_repo_instance(pCtx, pszRepoName)  );
+	SG_ERR_IGNORE(  SG_closet__descriptors__remove(pCtx, pszRepoName)  );
+}
+
+void vvbench__commit(SG_context * pCtx,
+					 const SG_pathname * pPathWd,
+					 SG_bool bDetached,
+					 const char * pszMessage,
+					 char ** ppszHid)
+{
+	SG_wc_commit_args ca;
+
+	memset(&ca, 0, sizeof(ca));
+	ca.bDetached = bDetached;
+	ca.pszUser = NULL;		// SG_AUDIT__WHO__FROM_SETTINGS
+	ca.pszWhen = NULL;		// SG_AUDIT__WHEN__NOW
+	ca.pszMessage = pszMessage;
+	ca.pfnPrompt = NULL;
+	ca.psaInputs = NULL;	// a complete (non-partial) commit
+	ca.depth = SG_INT32_MAX;
+	ca.psaAssocs = NULL;
+	ca.bAllowLost = SG_FALSE;
+	ca.psaStamps = NULL;
+
+	SG_ERR_CHECK_RETURN(  SG_wc__commit(pCtx, pPathWd, &ca, SG_FALSE, NULL, ppszHid)  );
+}
+
+//////////////////////////////////////////////////////////////////
+
+static void _usage(SG_context * pCtx, const char * pszAppName)
+{
+	SG_uint32 k;
+
+	SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDERR,
+							   "Usage: %s <suite> [--dir <path>] [--output <file>] [--seed <n>] [--iterations <n>] [--keep] [suite options]\n"
+							   "\n"
+							   "Suites:\n",
+							   pszAppName)  );
+	for (k=0; k<SG_NrElements(s_aSuites); k++)
+		SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDERR, "    %-6s %s\n", s_aSuites[k].pszName, s_aSuites[k].pszUsage)  );
+}
+
+static void _write_results(SG_context * pCtx,
+						   vvbench * pBench,
+						   const char * pszSuite,
+						   SG_int64 msTotal,
+						   const char * pszOutput)
+{
+	SG_vhash * pvhResults = NULL;
+	SG_string * pString = NULL;
+	SG_pathname * pPath = NULL;
+	SG_file * pFile = NULL;
+	const char * pszVersion = NULL;
+
+	SG_ERR_CHECK(  SG_lib__version(pCtx, &pszVersion)  );
+
+	SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvhResults)  );
+	SG_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pvhResults, "suite", pszSuite)  );
+	SG_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pvhResults, "version", pszVersion)  );
+	SG_ERR_CHECK(  SG_vhash__addcopy__vhash(pCtx, pvhResults, "params", pBench->pvhParams)  );
+	SG_ERR_CHECK(  SG_vhash__addcopy__varray(pCtx, pvhResults, "phases", pBench->pvaPhases)  );
+	SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvhResults, "ms", msTotal)  );
+
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pString)  );
+	SG_ERR_CHECK(  SG_vhash__to_json__pretty_print_NOT_for_storage(pCtx, pvhResults, pString)  );
+	SG_ERR_CHECK(  SG_string__append__sz(pCtx, pString, "\n")  );
+
+	if (pszOutput)
+	{
+		SG_ERR_CHECK(  SG_PATHNAME__ALLOC__SZ(pCtx, &pPath, pszOutput)  );
+		SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_OPEN_OR_CREATE | SG_FILE_WRONLY | SG_FILE_TRUNC, 0644, &pFile)  );
+		SG_ERR_CHECK(  SG_file__write__string(pCtx, pFile, pString)  );
+		SG_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+	}
+	else
+	{
+		SG_ERR_CHECK(  SG_console__raw(pCtx, SG_CS_STDOUT, SG_string__sz(pString))  );
+	}
+
+fail:
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+	SG_STRING_NULLFREE(pCtx, pString);
+	SG_VHASH_NULLFREE(pCtx, pvhResults);
+}
+
+static void _run(SG_context * pCtx, SG_getopt * pGetopt)
+{
+	vvbench bench;
+	const struct _vvbench_suite_entry * pSuite = NULL;
+	const char * pszOutput = NULL;
+	const char * pszDir = NULL;
+	SG_pathname * pPathParent = NULL;
+	SG_bool bKeep = SG_FALSE;
+	SG_bool bRegistered = SG_FALSE;
+	SG_bool bCreatedScratch = SG_FALSE;
+	SG_uint32 seed = 1;
+	SG_int64 timeStart = 0;
+	SG_int64 timeEnd = 0;
+	SG_uint32 k;
+	char bufTid[SG_TID_MAX_BUFFER_LENGTH];
+
+	memset(&bench, 0, sizeof(bench));
+	bench.pCtx = pCtx;
+	bench.iterations = 3;
+
+	if (pGetopt->count_args < 2)
+	{
+		_usage(pCtx, pGetopt->paszArgs[0]);
+		SG_ERR_THROW(  SG_ERR_USAGE  );
+	}
+
+	for (k=0; k<SG_NrElements(s_aSuites); k++)
+		if (0 == strcmp(pGetopt->paszArgs[1], s_aSuites[k].pszName))
+			pSuite = &s_aSuites[k];
+	if (!pSuite)
+	{
+		_usage(pCtx, pGetopt->paszArgs[0]);
+		SG_ERR_THROW(  SG_ERR_USAGE  );
+	}
+
+	SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &bench.pvhOptions)  );
+	SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &bench.pvhParams)  );
+	SG_ERR_CHECK(  SG_VARRAY__ALLOC(pCtx, &bench.pvaPhases)  );
+
+	// --keep, --dir and --output are ours; the rest are numeric
+	// options which the suite picks up with vvbench__option__uint32().
+	for (k=2; k<pGetopt->count_args; k++)
+	{
+		const char * pszArg = pGetopt->paszArgs[k];
+
+		if (0 == strcmp(pszArg, "--keep"))
+			bKeep = SG_TRUE;
+		else if (0 == strcmp(pszArg, "--dir") && k + 1 < pGetopt->count_args)
+			pszDir = pGetopt->paszArgs[++k];
+		else if (0 == strcmp(pszArg, "--output") && k + 1 < pGetopt->count_args)
+			pszOutput = pGetopt->paszArgs[++k];
+		else if (pszArg[0] != '-' || pszArg[1] != '-' || k + 1 == pGetopt->count_args)
+		{
+			_usage(pCtx, pGetopt->paszArgs[0]);
+			SG_ERR_THROW2(  SG_ERR_USAGE, (pCtx, "Unexpected argument '%s'.", pszArg)  );
+		}
+		else
+		{
+			SG_ERR_CHECK(  SG_vhash__update__string__sz(pCtx, bench.pvhOptions, pszArg + 2, pGetopt->paszArgs[k + 1])  );
+			k++;
+		}
+	}
+
+	SG_ERR_CHECK(  vvbench__option__uint32(pCtx, &bench, "seed", seed, &seed)  );
+	SG_ERR_CHECK(  vvbench__option__uint32(pCtx, &bench, "iterations", bench.iterations, &bench.iterations)  );
+	bench.random = (seed ? seed : 1);
+
+	if (pszDir)
+		SG_ERR_CHECK(  SG_PATHNAME__ALLOC__SZ(pCtx, &pPathParent, pszDir)  );
+	else
+		SG_ERR_CHECK(  SG_PATHNAME__ALLOC__USER_TEMP_DIRECTORY(pCtx, &pPathParent)  );
+	SG_ERR_CHECK(  SG_tid__generate(pCtx, bufTid, sizeof(bufTid))  );
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &bench.pPathScratch, pPathParent, "vvbench")  );
+	SG_ERR_CHECK(  SG_pathname__append__from_sz(pCtx, bench.pPathScratch, bufTid)  );
+	SG_ERR_CHECK(  SG_fsobj__mkdir_recursive__pathname(pCtx, bench.pPathScratch)  );
+	bCreatedScratch = SG_TRUE;
+
+	SG_ERR_CHECK(  SG_log__register_handler(pCtx, &s_logHandler, &bench, NULL, SG_LOG__FLAG__HANDLE_OPERATION__ALL)  );
+	bRegistered = SG_TRUE;
+
+	SG_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &timeStart)  );
+	SG_ERR_CHECK(  pSuite->pfn(pCtx, &bench)  );
+	SG_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &timeEnd)  );
+
+	SG_ERR_CHECK(  _write_results(pCtx, &bench, pSuite->pszName, timeEnd - timeStart, pszOutput)  );
+
+fail:
+	if (bRegistered)
+		SG_ERR_IGNORE(  SG_log__unregister_handler(pCtx, &s_logHandler, &bench)  );
+	if (bCreatedScratch)
+	{
+		if (bKeep)
+			SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDERR, "Kept %s\n", SG_pathname__sz(bench.pPathScratch))  );
+		else
+			SG_ERR_IGNORE(  SG_fsobj__rmdir_recursive__pathname(pCtx, bench.pPathScratch)  );
+	}
+	SG_PATHNAME_NULLFREE(pCtx, pPathParent);
+	SG_PATHNAME_NULLFREE(pCtx, bench.pPathScratch);
+	SG_VHASH_NULLFREE(pCtx, bench.pvhOptions);
+	SG_VHASH_NULLFREE(pCtx, bench.pvhParams);
+	SG_VARRAY_NULLFREE(pCtx, bench.pvaPhases);
+}
+
+/**
+ * Print error message on STDERR for the given error and convert the
+ * SG_ERR_ value into an exit status.
+ *
+ * DO NOT WRAP THE CALL TO THIS FUNCTION WITH SG_ERR_IGNORE() (because we
+ * need to be able to access the original error/status).
+ */
+static int _compute_exit_status_and_print_error_message(SG_context * pCtx)
+{
+	SG_error err;
+	SG_string * pStrContextDump = NULL;
+
+	SG_context__get_err(pCtx,&err);
+
+	if (err == SG_ERR_OK)
+		return 0;
+
+	SG_context__err_to_string(pCtx, SG_FALSE, &pStrContextDump);
+	SG_ERR_IGNORE(  SG_console(pCtx, SG_CS_STDERR, "%s\n",
+							   ((pStrContextDump) ? SG_string__sz(pStrContextDump) : "vvbench failed"))  );
+	SG_STRING_NULLFREE(pCtx, pStrContextDump);
+
+	return 1;
+}
+
+#if defined(WINDOWS)
+int wmain(int argc, wchar_t ** argv)
+#else
+int main(int argc, char ** argv)
+#endif
+{
+	SG_error err;
+	SG_context * pCtx = NULL;
+	SG_getopt * pGetopt = NULL;
+	int exitStatus = 0;
+
+	err = SG_context__alloc(&pCtx);
+	if ( !SG_IS_OK(err) )
+		return SG_ERR_ERRNO_VALUE(err);
+	if (pCtx == NULL)
+		return -1;
+
+	SG_ERR_CHECK(  SG_lib__global_initialize(pCtx)  );
+	SG_ERR_CHECK(  SG_getopt__alloc(pCtx, argc, argv, &pGetopt)  );
+
+	_run(pCtx, pGetopt);
+
+fail:
+	exitStatus = _compute_exit_status_and_print_error_message(pCtx);		// DO NOT WRAP THIS WITH SG_ERR_IGNORE
+	SG_context__err_reset(pCtx);
+
+	SG_GETOPT_NULLFREE(pCtx, pGetopt);
+	SG_ERR_IGNORE(  SG_lib__global_cleanup(pCtx)  );
+	SG_CONTEXT_NULLFREE(pCtx);
+
+	return exitStatus;
+}
@@ -0,0 +1,184 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file vvbench.h
+ *
+ * @details Shared declarations for the vvbench benchmark tool.
+ *
+ * Each suite (wc, sync, vhash) builds whatever it needs in a scratch
+ * directory, then runs a sequence of named phases.  Every phase
+ * gets a wall-clock time, any counters the suite wants to attach,
+ * and the inclusive time of each SG_log operation (and each step
+ * of those operations) that completed while it ran.  The results
+ * are written as JSON.
+ *
+ */
+
+#ifndef H_VVBENCH_H
+#define H_VVBENCH_H
+
+BEGIN_EXTERN_C;
+
+#define VVBENCH_MAX_OPERATION_DEPTH		16
+
+/**
+ * What we know about an SG_log operation on the stack,
+ * so that time can be charged to its steps.
+ */
+typedef struct _vvbench_operation
+{
+	const SG_log__operation *	pOperation;
+	SG_int64					timeStepStart;
+	char						szStep[128];		// empty until the first step is described
+} vvbench_operation;
+
+typedef struct _vvbench
+{
+	SG_vhash *		pvhOptions;			// --name value pairs given on the command line, not yet consumed
+	SG_vhash *		pvhParams;			// the options each suite actually ran with, echoed in the results
+	SG_varray *		pvaPhases;			// one vhash per phase, in the order they ran
+
+	SG_vhash *		pvhPhase;			// the current phase (belongs to pvaPhases)
+	SG_vhash *		pvhOperations;		// SG_log operations completed during the current phase (belongs to pvhPhase)
+	SG_int64		timePhaseStart;
+
+	SG_context *		pCtx;				// the main thread's context; see the log handler
+	vvbench_operation	aOperations[VVBENCH_MAX_OPERATION_DEPTH];	// mirrors the bottom of the SG_log stack
+	SG_uint32			depthOperations;	// the log stack's real depth, which may be more
+
+	SG_pathname *	pPathScratch;		// everything a suite creates on disk goes under here
+	SG_uint32		iterations;			// how many times to repeat read-only phases
+	SG_uint32		random;				// state for vvbench__random()
+} vvbench;
+
+typedef void vvbench__suite(SG_context * pCtx, vvbench * pBench);
+
+/**
+ * The shape of a synthetic tree: files spread round-robin over
+ * fanout^depth leaf directories, about size bytes each, with
+ * binary percent of them holding incompressible content.
+ */
+typedef struct _vvbench_tree
+{
+	SG_uint32		files;
+	SG_uint32		depth;
+	SG_uint32		fanout;
+	SG_uint32		size;
+	SG_uint32		binary;
+
+	SG_uint32		leaves;				// fanout^depth
+} vvbench_tree;
+
+//////////////////////////////////////////////////////////////////
+
+/**
+ * Get a numeric option for the current suite, or its default.
+ * The value used is recorded in the results.
+ */
+void vvbench__option__uint32(SG_context * pCtx,
+							 vvbench * pBench,
+							 const char * pszName,
+							 SG_uint32 valDefault,
+							 SG_uint32 * pVal);
+
+/**
+ * Complain about any options the suite didn't ask for.
+ */
+void vvbench__options__done(SG_context * pCtx, vvbench * pBench);
+
+void vvbench__phase__begin(SG_context * pCtx, vvbench * pBench, const char * pszName);
+void vvbench__phase__set_counter(SG_context * pCtx, vvbench * pBench, const char * pszName, SG_int64 value);
+void vvbench__phase__end(SG_context * pCtx, vvbench * pBench);
+
+/**
+ * A small deterministic PRNG, so that the same --seed
+ * produces the same trees and the same edits.
+ */
+SG_uint32 vvbench__random(vvbench * pBench);
+
+/**
+ * Write a file of roughly the given size.  Text files get
+ * line-oriented, mildly compressible content; binary ones
+ * get random bytes.
+ */
+void vvbench__write_file(SG_context * pCtx,
+						 vvbench * pBench,
+						 const SG_pathname * pPath,
+						 SG_uint32 size,
+						 SG_bool bBinary,
+						 SG_bool bAppend);
+
+/**
+ * Read the --files, --depth, --fanout, --size and --binary
+ * options into a tree shape, with the given default file count.
+ */
+void vvbench__tree__options(SG_context * pCtx,
+							vvbench * pBench,
+							SG_uint32 filesDefault,
+							vvbench_tree * pTree);
+
+/**
+ * Create the tree's directories and files under pPathWd.
+ */
+void vvbench__tree__generate(SG_context * pCtx,
+							 vvbench * pBench,
+							 const vvbench_tree * pTree,
+							 const SG_pathname * pPathWd,
+							 SG_uint64 * pBytes);
+
+/**
+ * Append to about percent of the files numbered first,
+ * first+step, first+2*step, ...  Returns how many were changed.
+ */
+void vvbench__tree__modify(SG_context * pCtx,
+						   vvbench * pBench,
+						   const vvbench_tree * pTree,
+						   const SG_pathname * pPathWd,
+						   SG_uint32 first,
+						   SG_uint32 step,
+						   SG_uint32 percent,
+						   SG_uint32 * pCount);
+
+/**
+ * Create a repo with a working copy at pPathWd, with a user
+ * to commit as.
+ */
+void vvbench__new_repo(SG_context * pCtx,
+					   const char * pszRepoName,
+					   const SG_pathname * pPathWd);
+
+void vvbench__delete_repo(SG_context * pCtx, const char * pszRepoName);
+
+/**
+ * Commit everything in the working copy.
+ */
+void vvbench__commit(SG_context * pCtx,
+					 const SG_pathname * pPathWd,
+					 SG_bool bDetached,
+					 const char * pszMessage,
+					 char ** ppszHid);
+
+//////////////////////////////////////////////////////////////////
+
+vvbench__suite vvbench__suite__wc;
+vvbench__suite vvbench__suite__sync;
+vvbench__suite vvbench__suite__vhash;
+
+END_EXTERN_C;
+
+#endif//H_VVBENCH_H
@@ -0,0 +1,247 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file vvbench_sync.c
+ *
+ * @details The "sync" suite: clone, pull and push over HTTP.
+ *
+ * We build a source repo with --changesets changesets of history on
+ * a synthetic tree (see vvbench__tree__options), each one editing
+ * --modify percent of the files, and serve it from an in-process
+ * server on 127.0.0.1:--port.  Then we time:
+ *
+ *     clone    the whole repo into a new one
+ *     pull     after --incremental more changesets in the source
+ *     push     --incremental changesets made in the clone
+ *
+ * Each phase reports the HTTP requests made and the bytes sent and
+ * received (headers included), the roundtrip and blob counts from
+ * the pull/push stats, and the time spent in each step of the
+ * client's operations ("Transferring data" is staging, "Committing"
+ * is the store).  The server's side of the work runs on its own
+ * threads, so it shows up only in the phase's wall time.
+ *
+ */
+
+#include <sg.h>
+#include <sg_wc__public_typedefs.h>
+#include <sg_wc__public_prototypes.h>
+#include "../libraries/mongoose/sg_mongoose.h"
+
+#include "vvbench.h"
+
+//////////////////////////////////////////////////////////////////
+
+struct _transfer_totals
+{
+	SG_uint64 requests;
+	SG_uint64 sent;
+	SG_uint64 received;
+};
+
+static void _transfer__begin(SG_context * pCtx, struct _transfer_totals * pStart)
+{
+	SG_ERR_CHECK_RETURN(  SG_curl__get_transfer_totals(pCtx, &pStart->requests, &pStart->sent, &pStart->received)  );
+}
+
+static void _transfer__end(SG_context * pCtx, vvbench * pBench, const struct _transfer_totals * pStart)
+{
+	struct _transfer_totals now;
+
+	SG_ERR_CHECK_RETURN(  SG_curl__get_transfer_totals(pCtx, &now.requests, &now.sent, &now.received)  );
+	SG_ERR_CHECK_RETURN(  vvbench__phase__set_counter(pCtx, pBench, "requests", (SG_int64)(now.requests - pStart->requests))  );
+	SG_ERR_CHECK_RETURN(  vvbench__phase__set_counter(pCtx, pBench, "bytes_sent", (SG_int64)(now.sent - pStart->sent))  );
+	SG_ERR_CHECK_RETURN(  vvbench__phase__set_counter(pCtx, pBench, "bytes_received", (SG_int64)(now.received - pStart->received))  );
+}
+
+/**
+ * Copy the numbers from a pull or push stats vhash into the phase.
+ */
+static void _add_sync_stats(SG_context * pCtx, vvbench * pBench, const SG_vhash * pvhStats)
+{
+	SG_uint32 count = 0;
+	SG_uint32 k;
+
+	if (!pvhStats)
+		return;
+
+	SG_ERR_CHECK_RETURN(  SG_vhash__count(pCtx, pvhStats, &count)  );
+	for (k=0; k<count; k++)
+	{
+		const char * pszKey = NULL;
+		const SG_variant * pv = NULL;
+
+		SG_ERR_CHECK_RETURN(  SG_vhash__get_nth_pair(pCtx, pvhStats, k, &pszKey, &pv)  );
+		if (pv->type == SG_VARIANT_TYPE_INT64)
+			SG_ERR_CHECK_RETURN(  vvbench__phase__set_counter(pCtx, pBench, pszKey, pv->v.val_int64)  );
+	}
+}
+
+/**
+ * Make count changesets in the working copy, each editing about
+ * percent of the files.
+ */
+static void _make_history(SG_context * pCtx,
+						  vvbench * pBench,
+						  const vvbench_tree * pTree,
+						  const SG_pathname * pPathWd,
+						  SG_uint32 count,
+						  SG_uint32 percent)
+{
+	char * pszHid = NULL;
+	SG_uint32 countModified = 0;
+	SG_uint32 k;
+
+	for (k=0; k<count; k++)
+	{
+		SG_ERR_CHECK(  vvbench__tree__modify(pCtx, pBench, pTree, pPathWd, 0, 1, percent, &countModified)  );
+		SG_ERR_CHECK(  vvbench__commit(pCtx, pPathWd, SG_FALSE, "vvbench: history", &pszHid)  );
+		SG_NULLFREE(pCtx, pszHid);
+	}
+
+fail:
+	SG_NULLFREE(pCtx, pszHid);
+}
+
+//////////////////////////////////////////////////////////////////
+
+void vvbench__suite__sync(SG_context * pCtx, vvbench * pBench)
+{
+	vvbench_tree tree;
+	struct _transfer_totals start;
+	struct mg_context * pServer = NULL;
+	SG_pathname * pPathWdSource = NULL;
+	SG_pathname * pPathWdClone = NULL;
+	SG_repo * pRepoClone = NULL;
+	SG_rev_spec * pRevSpec = NULL;
+	SG_vhash * pvhStats = NULL;
+	SG_string * pstrUrl = NULL;
+	char * pszHid = NULL;
+	SG_bool bCreatedSource = SG_FALSE;
+	SG_bool bCreatedClone = SG_FALSE;
+	SG_bool bProfilerInitialized = SG_FALSE;
+	SG_uint64 bytes = 0;
+	SG_uint32 changesets = 0;
+	SG_uint32 incremental = 0;
+	SG_uint32 modify = 0;
+	SG_uint32 port = 0;
+	char bufTid[SG_TID_MAX_BUFFER_LENGTH];
+	char bufSourceName[SG_TID_MAX_BUFFER_LENGTH + 16];
+	char bufCloneName[SG_TID_MAX_BUFFER_LENGTH + 16];
+
+	SG_ERR_CHECK(  vvbench__tree__options(pCtx, pBench, 200, &tree)  );
+	SG_ERR_CHECK(  vvbench__option__uint32(pCtx, pBench, "changesets",  20, &changesets)  );
+	SG_ERR_CHECK(  vvbench__option__uint32(pCtx, pBench, "incremental",  5, &incremental)  );
+	SG_ERR_CHECK(  vvbench__option__uint32(pCtx, pBench, "modify",      10, &modify)  );
+	SG_ERR_CHECK(  vvbench__option__uint32(pCtx, pBench, "port",      8089, &port)  );
+	SG_ERR_CHECK(  vvbench__options__done(pCtx, pBench)  );
+
+	if (changesets == 0 || modify > 100 || port == 0 || port > 65535)
+		SG_ERR_THROW2(  SG_ERR_USAGE, (pCtx, "--changesets must be at least 1, --modify at most 100 and --port a TCP port.")  );
+
+	SG_ERR_CHECK(  SG_tid__generate(pCtx, bufTid, sizeof(bufTid))  );
+	SG_ERR_CHECK(  SG_sprintf(pCtx, bufSourceName, sizeof(bufSourceName), "vvbench-%s", bufTid)  );
+	SG_ERR_CHECK(  SG_sprintf(pCtx, bufCloneName, sizeof(bufCloneName), "vvbench-clone-%s", bufTid)  );
+
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathWdSource, pBench->pPathScratch, "source")  );
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathWdClone, pBench->pPathScratch, "clone")  );
+	SG_ERR_CHECK(  SG_fsobj__mkdir__pathname(pCtx, pPathWdSource)  );
+
+	// the source repo and its history.
+
+	SG_ERR_CHECK(  vvbench__new_repo(pCtx, bufSourceName, pPathWdSource)  );
+	bCreatedSource = SG_TRUE;
+
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "generate")  );
+	SG_ERR_CHECK(  vvbench__tree__generate(pCtx, pBench, &tree, pPathWdSource, &bytes)  );
+	SG_ERR_CHECK(  SG_wc__addremove(pCtx, pPathWdSource, NULL, SG_INT32_MAX, SG_FALSE, SG_FALSE, NULL)  );
+	SG_ERR_CHECK(  vvbench__commit(pCtx, pPathWdSource, SG_FALSE, "vvbench: initial", &pszHid)  );
+	SG_NULLFREE(pCtx, pszHid);
+	SG_ERR_CHECK(  _make_history(pCtx, pBench, &tree, pPathWdSource, changesets - 1, modify)  );
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "files", tree.files)  );
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "bytes", (SG_int64)bytes)  );
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "changesets", changesets)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+
+	// serve it.
+
+	SG_ERR_CHECK(  SG_httprequestprofiler__global_init(pCtx)  );
+	bProfilerInitialized = SG_TRUE;
+	SG_ERR_CHECK(  mg_start(pCtx, SG_FALSE, (int)port, &pServer)  );
+
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstrUrl)  );
+	SG_ERR_CHECK(  SG_string__append__format(pCtx, pstrUrl, "http://127.0.0.1:%u/repos/%s", port, bufSourceName)  );
+
+	// clone
+
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "clone")  );
+	SG_ERR_CHECK(  _transfer__begin(pCtx, &start)  );
+	bCreatedClone = SG_TRUE;	// a failed clone can leave a partial repo behind
+	SG_ERR_CHECK(  SG_clone__to_local(pCtx, SG_string__sz(pstrUrl), NULL, NULL, bufCloneName, NULL, NULL, NULL)  );
+	SG_ERR_CHECK(  _transfer__end(pCtx, pBench, &start)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+
+	SG_ERR_CHECK(  SG_REPO__OPEN_REPO_INSTANCE(pCtx, bufCloneName, &pRepoClone)  );
+	SG_ERR_CHECK(  SG_user__set_user__repo(pCtx, pRepoClone, "vvbench@sourcegear.com")  );
+
+	// pull
+
+	SG_ERR_CHECK(  _make_history(pCtx, pBench, &tree, pPathWdSource, incremental, modify)  );
+
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "pull")  );
+	SG_ERR_CHECK(  _transfer__begin(pCtx, &start)  );
+	SG_ERR_CHECK(  SG_pull__all(pCtx, pRepoClone, SG_string__sz(pstrUrl), NULL, NULL, NULL, &pvhStats)  );
+	SG_ERR_CHECK(  _transfer__end(pCtx, pBench, &start)  );
+	SG_ERR_CHECK(  _add_sync_stats(pCtx, pBench, pvhStats)  );
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "changesets", incremental)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+	SG_VHASH_NULLFREE(pCtx, pvhStats);
+
+	// push, from a working copy attached to the same branch so that
+	// the push is a fast-forward.
+
+	SG_ERR_CHECK(  SG_REV_SPEC__ALLOC(pCtx, &pRevSpec)  );
+	SG_ERR_CHECK(  SG_rev_spec__add_branch(pCtx, pRevSpec, SG_VC_BRANCHES__DEFAULT)  );
+	SG_ERR_CHECK(  SG_wc__checkout(pCtx, bufCloneName, SG_pathname__sz(pPathWdClone), pRevSpec, SG_VC_BRANCHES__DEFAULT, NULL, NULL)  );
+	SG_ERR_CHECK(  _make_history(pCtx, pBench, &tree, pPathWdClone, incremental, modify)  );
+
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "push")  );
+	SG_ERR_CHECK(  _transfer__begin(pCtx, &start)  );
+	SG_ERR_CHECK(  SG_push__all(pCtx, pRepoClone, SG_string__sz(pstrUrl), NULL, NULL, SG_FALSE, NULL, &pvhStats)  );
+	SG_ERR_CHECK(  _transfer__end(pCtx, pBench, &start)  );
+	SG_ERR_CHECK(  _add_sync_stats(pCtx, pBench, pvhStats)  );
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "changesets", incremental)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+
+fail:
+	if (pServer)
+		SG_ERR_IGNORE(  mg_stop(pCtx, pServer)  );
+	if (bProfilerInitialized)
+		SG_httprequestprofiler__global_cleanup();
+	SG_REPO_NULLFREE(pCtx, pRepoClone);
+	if (bCreatedClone)
+		vvbench__delete_repo(pCtx, bufCloneName);
+	if (bCreatedSource)
+		vvbench__delete_repo(pCtx, bufSourceName);
+	SG_REV_SPEC_NULLFREE(pCtx, pRevSpec);
+	SG_VHASH_NULLFREE(pCtx, pvhStats);
+	SG_STRING_NULLFREE(pCtx, pstrUrl);
+	SG_PATHNAME_NULLFREE(pCtx, pPathWdSource);
+	SG_PATHNAME_NULLFREE(pCtx, pPathWdClone);
+	SG_NULLFREE(pCtx, pszHid);
+}
@@ -0,0 +1,182 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file vvbench_tree.c
+ *
+ * @details Synthetic trees for the suites to work on.
+ *
+ * File k lives in leaf directory k % leaves, which is the
+ * depth-digit, base-fanout spelling of that number.  Whether
+ * a file is binary depends only on k, so edits made later
+ * keep each file's kind.
+ *
+ */
+
+#include <sg.h>
+
+#include "vvbench.h"
+
+//////////////////////////////////////////////////////////////////
+
+static SG_bool _is_binary(const vvbench_tree * pTree, SG_uint32 ndx)
+{
+	return ((((ndx * 2654435761u) >> 16) % 100) < pTree->binary);
+}
+
+static void _leaf_path(SG_context * pCtx,
+					   const vvbench_tree * pTree,
+					   const SG_pathname * pPathWd,
+					   SG_uint32 k,
+					   SG_pathname ** ppPath)
+{
+	SG_pathname * pPath = NULL;
+	SG_uint32 level;
+	char buf[32];
+
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__COPY(pCtx, &pPath, pPathWd)  );
+	for (level=0; level<pTree->depth; level++)
+	{
+		SG_ERR_CHECK(  SG_sprintf(pCtx, buf, sizeof(buf), "d%u", k % pTree->fanout)  );
+		SG_ERR_CHECK(  SG_pathname__append__from_sz(pCtx, pPath, buf)  );
+		k /= pTree->fanout;
+	}
+
+	*ppPath = pPath;
+	pPath = NULL;
+
+fail:
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+}
+
+static void _file_path(SG_context * pCtx,
+					   const vvbench_tree * pTree,
+					   const SG_pathname * pPathWd,
+					   SG_uint32 ndx,
+					   SG_pathname ** ppPath)
+{
+	SG_pathname * pPath = NULL;
+	char buf[32];
+
+	SG_ERR_CHECK(  _leaf_path(pCtx, pTree, pPathWd, ndx % pTree->leaves, &pPath)  );
+	SG_ERR_CHECK(  SG_sprintf(pCtx, buf, sizeof(buf), "f%u.%s", ndx, (_is_binary(pTree, ndx) ? "bin" : "c"))  );
+	SG_ERR_CHECK(  SG_pathname__append__from_sz(pCtx, pPath, buf)  );
+
+	*ppPath = pPath;
+	pPath = NULL;
+
+fail:
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+}
+
+//////////////////////////////////////////////////////////////////
+
+void vvbench__tree__options(SG_context * pCtx,
+							vvbench * pBench,
+							SG_uint32 filesDefault,
+							vvbench_tree * pTree)
+{
+	SG_uint32 k;
+
+	memset(pTree, 0, sizeof(*pTree));
+	SG_ERR_CHECK_RETURN(  vvbench__option__uint32(pCtx, pBench, "files",  filesDefault, &pTree->files)  );
+	SG_ERR_CHECK_RETURN(  vvbench__option__uint32(pCtx, pBench, "depth",             2, &pTree->depth)  );
+	SG_ERR_CHECK_RETURN(  vvbench__option__uint32(pCtx, pBench, "fanout",           10, &pTree->fanout)  );
+	SG_ERR_CHECK_RETURN(  vvbench__option__uint32(pCtx, pBench, "size",           4096, &pTree->size)  );
+	SG_ERR_CHECK_RETURN(  vvbench__option__uint32(pCtx, pBench, "binary",            0, &pTree->binary)  );
+
+	if (pTree->fanout == 0 || pTree->binary > 100)
+		SG_ERR_THROW2_RETURN(  SG_ERR_USAGE, (pCtx, "--fanout must be at least 1 and --binary at most 100.")  );
+
+	pTree->leaves = 1;
+	for (k=0; k<pTree->depth; k++)
+	{
+		if (pTree->leaves > SG_UINT32_MAX / pTree->fanout)
+			SG_ERR_THROW2_RETURN(  SG_ERR_USAGE, (pCtx, "--fanout and --depth make too many directories.")  );
+		pTree->leaves *= pTree->fanout;
+	}
+}
+
+void vvbench__tree__generate(SG_context * pCtx,
+							 vvbench * pBench,
+							 const vvbench_tree * pTree,
+							 const SG_pathname * pPathWd,
+							 SG_uint64 * pBytes)
+{
+	SG_pathname * pPath = NULL;
+	SG_uint64 bytes = 0;
+	SG_uint32 k;
+
+	if (pTree->depth)
+	{
+		for (k=0; k<pTree->leaves; k++)
+		{
+			SG_ERR_CHECK(  _leaf_path(pCtx, pTree, pPathWd, k, &pPath)  );
+			SG_ERR_CHECK(  SG_fsobj__mkdir_recursive__pathname(pCtx, pPath)  );
+			SG_PATHNAME_NULLFREE(pCtx, pPath);
+		}
+	}
+
+	for (k=0; k<pTree->files; k++)
+	{
+		// vary the sizes between half and one-and-a-half times --size.
+		SG_uint32 size = pTree->size / 2 + (pTree->size ? vvbench__random(pBench) % (pTree->size + 1) : 0);
+
+		SG_ERR_CHECK(  _file_path(pCtx, pTree, pPathWd, k, &pPath)  );
+		SG_ERR_CHECK(  vvbench__write_file(pCtx, pBench, pPath, size, _is_binary(pTree, k), SG_FALSE)  );
+		SG_PATHNAME_NULLFREE(pCtx, pPath);
+		bytes += size;
+	}
+
+	if (pBytes)
+		*pBytes = bytes;
+
+fail:
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+}
+
+void vvbench__tree__modify(SG_context * pCtx,
+						   vvbench * pBench,
+						   const vvbench_tree * pTree,
+						   const SG_pathname * pPathWd,
+						   SG_uint32 first,
+						   SG_uint32 step,
+						   SG_uint32 percent,
+						   SG_uint32 * pCount)
+{
+	SG_pathname * pPath = NULL;
+	SG_uint32 count = 0;
+	SG_uint32 k;
+
+	SG_ARGCHECK_RETURN(  (step > 0), step  );
+
+	for (k=first; k<pTree->files; k+=step)
+	{
+		if ((vvbench__random(pBench) % 100) >= percent)
+			continue;
+
+		SG_ERR_CHECK(  _file_path(pCtx, pTree, pPathWd, k, &pPath)  );
+		SG_ERR_CHECK(  vvbench__write_file(pCtx, pBench, pPath, 64, _is_binary(pTree, k), SG_TRUE)  );
+		SG_PATHNAME_NULLFREE(pCtx, pPath);
+		count++;
+	}
+
+	*pCount = count;
+
+fail:
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+}
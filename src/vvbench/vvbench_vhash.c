@@ -0,0 +1,204 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file vvbench_vhash.c
+ *
+ * @details The "vhash" suite: SG_vhash insert, lookup and iteration.
+ *
+ * For each key shape (HID-like 40 hex chars, which hashlittle
+ * special-cases, and short field names) and each size (6, 100 and
+ * --keys keys), we time:
+ *
+ *     insert   building the vhash
+ *     hit      looking up every key
+ *     miss     looking up keys which aren't there
+ *     iterate  get_nth_pair over every item
+ *
+ * Each phase repeats its work until about --ops operations are done,
+ * so the small sizes aren't lost in the clock's resolution.
+ *
+ * The library can be built with its index open-addressed (the
+ * default) or chained (SG_VHASH_CHAINED).  The results say which,
+ * so that runs of the two builds can be compared.
+ *
+ */
+
+#include <sg.h>
+
+#include "vvbench.h"
+
+//////////////////////////////////////////////////////////////////
+
+#define KEY_SPACE 48
+
+static void _make_keys(SG_context * pCtx,
+					   vvbench * pBench,
+					   SG_uint32 count,
+					   SG_bool bHex,
+					   char ** ppBuf)
+{
+	char * pBuf = NULL;
+	SG_uint32 i, j;
+
+	SG_ERR_CHECK(  SG_alloc(pCtx, count, KEY_SPACE, &pBuf)  );
+	for (i=0; i<count; i++)
+	{
+		char * psz = pBuf + (i * KEY_SPACE);
+
+		if (bHex)
+		{
+			for (j=0; j<40; j++)
+				psz[j] = "0123456789abcdef"[vvbench__random(pBench) & 15];
+			psz[40] = 0;
+		}
+		else
+		{
+			SG_ERR_CHECK(  SG_sprintf(pCtx, psz, KEY_SPACE, "field_%d", i)  );
+		}
+	}
+
+	*ppBuf = pBuf;
+	pBuf = NULL;
+
+fail:
+	SG_NULLFREE(pCtx, pBuf);
+}
+
+static void _run_shape(SG_context * pCtx,
+					   vvbench * pBench,
+					   SG_uint32 count,
+					   SG_uint32 ops,
+					   SG_bool bHex)
+{
+	char * pBuf = NULL;
+	SG_vhash * pvh = NULL;
+	SG_string * pName = NULL;
+	SG_uint32 reps = (ops / count) + 1;
+	SG_uint32 found = 0;
+	SG_uint32 i, r;
+
+	SG_ERR_CHECK(  _make_keys(pCtx, pBench, count, bHex, &pBuf)  );
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pName)  );
+
+	SG_ERR_CHECK(  SG_string__sprintf(pCtx, pName, "insert %s %u", (bHex ? "hex" : "name"), count)  );
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, SG_string__sz(pName))  );
+	for (r=0; r<reps; r++)
+	{
+		SG_VHASH_NULLFREE(pCtx, pvh);
+		SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvh)  );
+		for (i=0; i<count; i++)
+			SG_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvh, pBuf + (i * KEY_SPACE), i)  );
+	}
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "ops", (SG_int64)reps * count)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+
+	SG_ERR_CHECK(  SG_string__sprintf(pCtx, pName, "hit %s %u", (bHex ? "hex" : "name"), count)  );
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, SG_string__sz(pName))  );
+	for (r=0; r<reps; r++)
+	{
+		for (i=0; i<count; i++)
+		{
+			SG_int64 v = 0;
+
+			SG_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvh, pBuf + (i * KEY_SPACE), &v)  );
+			if (v == (SG_int64)i)
+				found++;
+		}
+	}
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "ops", (SG_int64)reps * count)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+	if (found != reps * count)
+		SG_ERR_THROW2(  SG_ERR_UNSPECIFIED, (pCtx, "Only %u of %u lookups found their key.", found, reps * count)  );
+
+	// replace the first character with one no key has, so every lookup misses
+
+	for (i=0; i<count; i++)
+		pBuf[i * KEY_SPACE] = 'X';
+
+	SG_ERR_CHECK(  SG_string__sprintf(pCtx, pName, "miss %s %u", (bHex ? "hex" : "name"), count)  );
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, SG_string__sz(pName))  );
+	found = 0;
+	for (r=0; r<reps; r++)
+	{
+		for (i=0; i<count; i++)
+		{
+			SG_bool b = SG_FALSE;
+
+			SG_ERR_CHECK(  SG_vhash__has(pCtx, pvh, pBuf + (i * KEY_SPACE), &b)  );
+			if (b)
+				found++;
+		}
+	}
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "ops", (SG_int64)reps * count)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+	if (found)
+		SG_ERR_THROW2(  SG_ERR_UNSPECIFIED, (pCtx, "%u lookups of missing keys found something.", found)  );
+
+	SG_ERR_CHECK(  SG_string__sprintf(pCtx, pName, "iterate %s %u", (bHex ? "hex" : "name"), count)  );
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, SG_string__sz(pName))  );
+	for (r=0; r<reps; r++)
+	{
+		for (i=0; i<count; i++)
+		{
+			const char * pszKey = NULL;
+			const SG_variant * pv = NULL;
+
+			SG_ERR_CHECK(  SG_vhash__get_nth_pair(pCtx, pvh, i, &pszKey, &pv)  );
+		}
+	}
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "ops", (SG_int64)reps * count)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+
+fail:
+	SG_STRING_NULLFREE(pCtx, pName);
+	SG_VHASH_NULLFREE(pCtx, pvh);
+	SG_NULLFREE(pCtx, pBuf);
+}
+
+void vvbench__suite__vhash(SG_context * pCtx, vvbench * pBench)
+{
+	SG_uint32 keys = 0;
+	SG_uint32 ops = 0;
+	SG_uint32 aSizes[3];
+	SG_uint32 k;
+
+	SG_ERR_CHECK(  vvbench__option__uint32(pCtx, pBench, "keys", 100000, &keys)  );
+	SG_ERR_CHECK(  vvbench__option__uint32(pCtx, pBench, "ops", 1000000, &ops)  );
+	SG_ERR_CHECK(  vvbench__options__done(pCtx, pBench)  );
+	if (keys == 0)
+		SG_ERR_THROW2(  SG_ERR_USAGE, (pCtx, "--keys must be at least 1.")  );
+
+#if defined(SG_VHASH_CHAINED)
+	SG_ERR_CHECK(  SG_vhash__update__string__sz(pCtx, pBench->pvhParams, "layout", "chained")  );
+#else
+	SG_ERR_CHECK(  SG_vhash__update__string__sz(pCtx, pBench->pvhParams, "layout", "open")  );
+#endif
+
+	aSizes[0] = 6;
+	aSizes[1] = 100;
+	aSizes[2] = keys;
+
+	for (k=0; k<SG_NrElements(aSizes); k++)
+	{
+		SG_ERR_CHECK(  _run_shape(pCtx, pBench, aSizes[k], ops, SG_FALSE)  );
+		SG_ERR_CHECK(  _run_shape(pCtx, pBench, aSizes[k], ops, SG_TRUE)  );
+	}
+
+fail:
+	return;
+}
@@ -0,0 +1,212 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file vvbench_wc.c
+ *
+ * @details The "wc" suite: working-copy operations end-to-end.
+ *
+ * We synthesize a tree (see vvbench__tree__options), add and commit
+ * it, then time scan, status, checkout, commit, merge and update
+ * against it.  --modify is the percentage of files edited before
+ * each of the dirty phases.
+ *
+ * "scan" is a status with the timestamp cache flushed first, so
+ * every file gets re-hashed.  "status" runs with a warm cache.
+ *
+ * The merge is between two working copies of the same repo, one
+ * editing the even-numbered files and the other the odd-numbered
+ * ones, so it never conflicts.
+ *
+ */
+
+#include <sg.h>
+#include <sg_wc__public_typedefs.h>
+#include <sg_wc__public_prototypes.h>
+
+#include "vvbench.h"
+
+//////////////////////////////////////////////////////////////////
+
+static void _status(SG_context * pCtx,
+					vvbench * pBench,
+					const SG_pathname * pPathWd,
+					SG_bool bFlushTSC)
+{
+	SG_varray * pvaStatus = NULL;
+	SG_uint32 count = 0;
+
+	if (bFlushTSC)
+		SG_ERR_CHECK(  SG_wc__flush_timestamp_cache(pCtx, pPathWd)  );
+
+	SG_ERR_CHECK(  SG_wc__status(pCtx, pPathWd, NULL, SG_INT32_MAX,
+								 SG_FALSE,	// bListUnchanged
+								 SG_FALSE,	// bNoIgnores
+								 SG_FALSE,	// bNoTSC
+								 SG_FALSE,	// bListSparse
+								 SG_FALSE,	// bListReserved
+								 SG_TRUE,	// bNoSort
+								 &pvaStatus, NULL)  );
+	SG_ERR_CHECK(  SG_varray__count(pCtx, pvaStatus, &count)  );
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "changes", count)  );
+
+fail:
+	SG_VARRAY_NULLFREE(pCtx, pvaStatus);
+}
+
+//////////////////////////////////////////////////////////////////
+
+void vvbench__suite__wc(SG_context * pCtx, vvbench * pBench)
+{
+	vvbench_tree tree;
+	SG_pathname * pPathWd1 = NULL;
+	SG_pathname * pPathWd2 = NULL;
+	SG_rev_spec * pRevSpec = NULL;
+	char * pszHidInitial = NULL;
+	char * pszHidTrunk = NULL;
+	char * pszHidBranch = NULL;
+	char * pszHidMerge = NULL;
+	SG_bool bCreatedRepo = SG_FALSE;
+	SG_uint64 bytes = 0;
+	SG_uint32 modify = 0;
+	SG_uint32 count = 0;
+	SG_uint32 k;
+	char bufRepoName[SG_TID_MAX_BUFFER_LENGTH + 8];
+	char bufTid[SG_TID_MAX_BUFFER_LENGTH];
+
+	SG_ERR_CHECK(  vvbench__tree__options(pCtx, pBench, 1000, &tree)  );
+	SG_ERR_CHECK(  vvbench__option__uint32(pCtx, pBench, "modify", 10, &modify)  );
+	SG_ERR_CHECK(  vvbench__options__done(pCtx, pBench)  );
+
+	if (modify > 100)
+		SG_ERR_THROW2(  SG_ERR_USAGE, (pCtx, "--modify is a percentage.")  );
+
+	SG_ERR_CHECK(  SG_tid__generate(pCtx, bufTid, sizeof(bufTid))  );
+	SG_ERR_CHECK(  SG_sprintf(pCtx, bufRepoName, sizeof(bufRepoName), "vvbench-%s", bufTid)  );
+
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathWd1, pBench->pPathScratch, "wd1")  );
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathWd2, pBench->pPathScratch, "wd2")  );
+	SG_ERR_CHECK(  SG_fsobj__mkdir__pathname(pCtx, pPathWd1)  );
+
+	SG_ERR_CHECK(  vvbench__new_repo(pCtx, bufRepoName, pPathWd1)  );
+	bCreatedRepo = SG_TRUE;
+
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "generate")  );
+	SG_ERR_CHECK(  vvbench__tree__generate(pCtx, pBench, &tree, pPathWd1, &bytes)  );
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "files", tree.files)  );
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "directories", tree.leaves)  );
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "bytes", (SG_int64)bytes)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "add")  );
+	SG_ERR_CHECK(  SG_wc__addremove(pCtx, pPathWd1, NULL, SG_INT32_MAX, SG_FALSE, SG_FALSE, NULL)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "commit_initial")  );
+	SG_ERR_CHECK(  vvbench__commit(pCtx, pPathWd1, SG_FALSE, "vvbench: initial", &pszHidInitial)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+
+	for (k=0; k<pBench->iterations; k++)
+	{
+		SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "scan")  );
+		SG_ERR_CHECK(  _status(pCtx, pBench, pPathWd1, SG_TRUE)  );
+		SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+	}
+	for (k=0; k<pBench->iterations; k++)
+	{
+		SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "status")  );
+		SG_ERR_CHECK(  _status(pCtx, pBench, pPathWd1, SG_FALSE)  );
+		SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+	}
+
+	// a second, detached working copy of the initial changeset.
+
+	SG_ERR_CHECK(  SG_REV_SPEC__ALLOC(pCtx, &pRevSpec)  );
+	SG_ERR_CHECK(  SG_rev_spec__add_rev(pCtx, pRevSpec, pszHidInitial)  );
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "checkout")  );
+	SG_ERR_CHECK(  SG_wc__checkout(pCtx, bufRepoName, SG_pathname__sz(pPathWd2), pRevSpec, NULL, NULL, NULL)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+	SG_REV_SPEC_NULLFREE(pCtx, pRevSpec);
+
+	// trunk: edit the even files in wd1 and commit.
+
+	SG_ERR_CHECK(  vvbench__tree__modify(pCtx, pBench, &tree, pPathWd1, 0, 2, modify, &count)  );
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "status_dirty")  );
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "modified", count)  );
+	SG_ERR_CHECK(  _status(pCtx, pBench, pPathWd1, SG_FALSE)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "commit")  );
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "modified", count)  );
+	SG_ERR_CHECK(  vvbench__commit(pCtx, pPathWd1, SG_FALSE, "vvbench: trunk", &pszHidTrunk)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+
+	// branch: edit the odd files in wd2 and commit.
+
+	SG_ERR_CHECK(  vvbench__tree__modify(pCtx, pBench, &tree, pPathWd2, 1, 2, modify, &count)  );
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "commit_branch")  );
+	SG_ERR_CHECK(  vvbench__phase__set_counter(pCtx, pBench, "modified", count)  );
+	SG_ERR_CHECK(  vvbench__commit(pCtx, pPathWd2, SG_TRUE, "vvbench: branch", &pszHidBranch)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+
+	// merge trunk into the branch.
+
+	SG_ERR_CHECK(  SG_REV_SPEC__ALLOC(pCtx, &pRevSpec)  );
+	SG_ERR_CHECK(  SG_rev_spec__add_rev(pCtx, pRevSpec, pszHidTrunk)  );
+	{
+		SG_wc_merge_args ma;
+
+		memset(&ma, 0, sizeof(ma));
+		ma.pRevSpec = pRevSpec;
+
+		SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "merge")  );
+		SG_ERR_CHECK(  SG_wc__merge(pCtx, pPathWd2, &ma, SG_FALSE, NULL, NULL, NULL, NULL)  );
+		SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+	}
+	SG_REV_SPEC_NULLFREE(pCtx, pRevSpec);
+
+	SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "commit_merge")  );
+	SG_ERR_CHECK(  vvbench__commit(pCtx, pPathWd2, SG_TRUE, "vvbench: merge", &pszHidMerge)  );
+	SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+
+	// bring wd1 up to the merge.
+
+	SG_ERR_CHECK(  SG_REV_SPEC__ALLOC(pCtx, &pRevSpec)  );
+	SG_ERR_CHECK(  SG_rev_spec__add_rev(pCtx, pRevSpec, pszHidMerge)  );
+	{
+		SG_wc_update_args ua;
+
+		memset(&ua, 0, sizeof(ua));
+		ua.pRevSpec = pRevSpec;
+		ua.bDetached = SG_TRUE;
+
+		SG_ERR_CHECK(  vvbench__phase__begin(pCtx, pBench, "update")  );
+		SG_ERR_CHECK(  SG_wc__update(pCtx, pPathWd1, &ua, SG_FALSE, NULL, NULL, NULL, NULL)  );
+		SG_ERR_CHECK(  vvbench__phase__end(pCtx, pBench)  );
+	}
+
+fail:
+	if (bCreatedRepo)
+		vvbench__delete_repo(pCtx, bufRepoName);
+	SG_REV_SPEC_NULLFREE(pCtx, pRevSpec);
+	SG_PATHNAME_NULLFREE(pCtx, pPathWd1);
+	SG_PATHNAME_NULLFREE(pCtx, pPathWd2);
+	SG_NULLFREE(pCtx, pszHidInitial);
+	SG_NULLFREE(pCtx, pszHidTrunk);
+	SG_NULLFREE(pCtx, pszHidBranch);
+	SG_NULLFREE(pCtx, pszHidMerge);
+}
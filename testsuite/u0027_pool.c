@@ -40,11 +40,100 @@ int u0027_pool__test(SG_context* pCtx)
 	return 1;
 }
 
+int u0027_pool__test_arena(SG_context* pCtx)
+{
+	SG_arena* pArena = NULL;
+	SG_vhash* pvhTop = NULL;
+	SG_vhash* pvhSub = NULL;
+	SG_vhash* pvhForeign = NULL;
+	SG_varray* pva = NULL;
+	SG_varray* pvaParsed = NULL;
+	SG_vhash* pvhParsed = NULL;
+	SG_arena* pArenaGot = NULL;
+	SG_uint32 count = 0;
+	SG_uint32 count_chunks = 0;
+	SG_uint64 cb = 0;
+	SG_uint32 i;
+	SG_int64 i64 = 0;
+	const char* psz = NULL;
+	const char* pszJson = "{\"a\":[1,2,3],\"b\":{\"c\":\"d\"}}";
+
+	VERIFY_ERR_CHECK(  SG_ARENA__ALLOC(pCtx, &pArena, 4096)  );
+
+	VERIFY_ERR_CHECK(  SG_vhash__alloc__arena(pCtx, &pvhTop, 0, pArena)  );
+	VERIFY_ERR_CHECK(  SG_vhash__get_arena(pCtx, pvhTop, &pArenaGot)  );
+	VERIFY_COND("arena", (pArenaGot == pArena));
+
+	// children created in place come from the arena too
+
+	VERIFY_ERR_CHECK(  SG_vhash__addnew__varray(pCtx, pvhTop, "list", &pva)  );
+	for (i=0; i<1000; i++)
+	{
+		VERIFY_ERR_CHECK(  SG_varray__appendnew__vhash(pCtx, pva, &pvhSub)  );
+		VERIFY_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvhSub, "i", i)  );
+		VERIFY_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pvhSub, "s", "some value")  );
+	}
+	VERIFY_ERR_CHECK(  SG_varray__count(pCtx, pva, &count)  );
+	VERIFY_COND("count", (count == 1000));
+	VERIFY_ERR_CHECK(  SG_varray__get_arena(pCtx, pva, &pArenaGot)  );
+	VERIFY_COND("arena", (pArenaGot == pArena));
+
+	VERIFY_ERR_CHECK(  SG_varray__get__vhash(pCtx, pva, 999, &pvhSub)  );
+	VERIFY_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvhSub, "i", &i64)  );
+	VERIFY_COND("i", (i64 == 999));
+
+	// a malloc'd vhash gets adopted, even when it is replaced
+
+	VERIFY_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvhForeign)  );
+	VERIFY_ERR_CHECK(  SG_vhash__add__string__sz(pCtx, pvhForeign, "x", "y")  );
+	VERIFY_ERR_CHECK(  SG_vhash__add__vhash(pCtx, pvhTop, "foreign", &pvhForeign)  );
+	VERIFY_COND("stolen", (pvhForeign == NULL));
+	VERIFY_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvhForeign)  );
+	VERIFY_ERR_CHECK(  SG_vhash__update__vhash(pCtx, pvhTop, "foreign", &pvhForeign)  );
+	VERIFY_ERR_CHECK(  SG_vhash__remove(pCtx, pvhTop, "foreign")  );
+
+	// parsing json into the arena
+
+	VERIFY_ERR_CHECK(  SG_veither__parse_json__buflen__arena(pCtx, pArena, pszJson, (SG_uint32)strlen(pszJson), &pvhParsed, &pvaParsed)  );
+	VERIFY_COND("vhash", (pvhParsed != NULL));
+	VERIFY_ERR_CHECK(  SG_vhash__get_arena(pCtx, pvhParsed, &pArenaGot)  );
+	VERIFY_COND("arena", (pArenaGot == pArena));
+	VERIFY_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhParsed, "b", &pvhSub)  );
+	VERIFY_ERR_CHECK(  SG_vhash__get__sz(pCtx, pvhSub, "c", &psz)  );
+	VERIFY_COND("c", (0 == strcmp(psz, "d")));
+
+	// the pools belong to the arena, so stealing them does nothing
+
+	VERIFY_ERR_CHECK(  SG_vhash__steal_the_pools(pCtx, pvhParsed)  );
+	VERIFY_ERR_CHECK(  SG_veither__parse_json__buflen__arena(pCtx, pArena, "[1,\"two\"]", 9, &pvhSub, &pvaParsed)  );
+	VERIFY_COND("varray", (pvaParsed != NULL));
+	VERIFY_ERR_CHECK(  SG_varray__steal_the_pools(pCtx, pvaParsed)  );
+	VERIFY_ERR_CHECK(  SG_varray__get__sz(pCtx, pvaParsed, 1, &psz)  );
+	VERIFY_COND("two", (0 == strcmp(psz, "two")));
+	SG_VARRAY_NULLFREE(pCtx, pvaParsed);
+
+	VERIFY_ERR_CHECK(  SG_arena__get_stats(pCtx, pArena, &cb, &count_chunks)  );
+	VERIFY_COND("stats", (cb > 0));
+	VERIFY_COND("stats", (count_chunks > 1));
+
+	// these are no-ops; the arena frees everything
+
+	SG_VHASH_NULLFREE(pCtx, pvhParsed);
+	SG_VHASH_NULLFREE(pCtx, pvhTop);
+
+fail:
+	SG_VHASH_NULLFREE(pCtx, pvhForeign);
+	SG_ARENA_NULLFREE(pCtx, pArena);
+
+	return 1;
+}
+
 TEST_MAIN(u0027_pool)
 {
 	TEMPLATE_MAIN_START;
 
 	BEGIN_TEST(  u0027_pool__test(pCtx)  );
+	BEGIN_TEST(  u0027_pool__test_arena(pCtx)  );
 
 	TEMPLATE_MAIN_END;
 }
@@ -696,6 +696,133 @@ fail:
 	return;
 }
 
+/**
+ * Keys which defeat the hash.  A 40-char key that starts with 8 hex
+ * digits hashes to those digits, so keys sharing that prefix all have
+ * the same hash, and keys differing only in the last few prefix digits
+ * share the control byte but not the group.  Remove some of them and
+ * put them back, across several rehashes, and make sure every lookup
+ * still finds exactly the right item.
+ */
+#define u0028_NR_COLLIDE	(200)
+
+static void u0028_vhash__collide__key(SG_context * pCtx, SG_uint32 i, char * buf, SG_uint32 lenBuf)
+{
+	// thirds: the same hash, the same control byte, and ordinary keys
+	if (0 == (i % 3))
+		SG_ERR_CHECK_RETURN(  SG_sprintf(pCtx, buf, lenBuf, "0badf00d%032x", i)  );
+	else if (1 == (i % 3))
+		SG_ERR_CHECK_RETURN(  SG_sprintf(pCtx, buf, lenBuf, "0badf%03x%032x", i & 0xfff, i)  );
+	else
+		SG_ERR_CHECK_RETURN(  SG_sprintf(pCtx, buf, lenBuf, "key_%d", i)  );
+}
+
+static void u0028_vhash__collide__verify(SG_context * pCtx, SG_vhash * pvh, SG_uint32 nrKeys, SG_int64 * aValue)
+{
+	// aValue[i] is the value key i should have, or -1 if it should be absent
+	char buf[64];
+	SG_uint32 i;
+	SG_uint32 nrPresent = 0;
+	SG_uint32 count = 0;
+
+	for (i=0; i<nrKeys; i++)
+	{
+		SG_bool b = SG_FALSE;
+
+		VERIFY_ERR_CHECK(  u0028_vhash__collide__key(pCtx, i, buf, sizeof(buf))  );
+		VERIFY_ERR_CHECK(  SG_vhash__has(pCtx, pvh, buf, &b)  );
+		VERIFYP_COND("collide", (b == (aValue[i] >= 0)), ("key %s has=%d", buf, b));
+		if (b)
+		{
+			SG_int64 v = -1;
+
+			VERIFY_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvh, buf, &v)  );
+			VERIFYP_COND("collide", (v == aValue[i]), ("key %s is %d, not %d", buf, (int)v, (int)aValue[i]));
+			nrPresent++;
+		}
+	}
+
+	// near misses: the same hash, but never added
+	for (i=0; i<nrKeys; i+=3)
+	{
+		SG_bool b = SG_TRUE;
+
+		VERIFY_ERR_CHECK(  SG_sprintf(pCtx, buf, sizeof(buf), "0badf00d%032x", i + 0x100000)  );
+		VERIFY_ERR_CHECK(  SG_vhash__has(pCtx, pvh, buf, &b)  );
+		VERIFYP_COND("collide", (!b), ("key %s should not be there", buf));
+	}
+
+	VERIFY_ERR_CHECK(  SG_vhash__count(pCtx, pvh, &count)  );
+	VERIFYP_COND("collide", (count == nrPresent), ("count %d, expected %d", count, nrPresent));
+
+fail:
+	return;
+}
+
+void u0028_vhash__collide(SG_context * pCtx)
+{
+	SG_vhash * pvh = NULL;
+	SG_int64 aValue[2 * u0028_NR_COLLIDE];
+	char buf[64];
+	SG_uint32 i;
+
+	VERIFY_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvh)  );
+
+	// a few at a time, so that each rehash gets checked
+	for (i=0; i<u0028_NR_COLLIDE; i++)
+	{
+		VERIFY_ERR_CHECK(  u0028_vhash__collide__key(pCtx, i, buf, sizeof(buf))  );
+		VERIFY_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvh, buf, i)  );
+		aValue[i] = i;
+
+		if ((i == 7) || (i == 8) || (i == 33) || (i == 130))
+		{
+			VERIFY_ERR_CHECK(  u0028_vhash__collide__verify(pCtx, pvh, i + 1, aValue)  );
+		}
+	}
+	VERIFY_ERR_CHECK(  u0028_vhash__collide__verify(pCtx, pvh, u0028_NR_COLLIDE, aValue)  );
+
+	// adding one which is already there must fail
+	VERIFY_ERR_CHECK(  u0028_vhash__collide__key(pCtx, 3, buf, sizeof(buf))  );
+	VERIFY_ERR_CHECK_ERR_EQUALS_DISCARD(  SG_vhash__add__int64(pCtx, pvh, buf, 0),
+										  SG_ERR_VHASH_DUPLICATEKEY  );
+
+	// every other one goes away
+	for (i=0; i<u0028_NR_COLLIDE; i+=2)
+	{
+		VERIFY_ERR_CHECK(  u0028_vhash__collide__key(pCtx, i, buf, sizeof(buf))  );
+		VERIFY_ERR_CHECK(  SG_vhash__remove(pCtx, pvh, buf)  );
+		aValue[i] = -1;
+	}
+	VERIFY_ERR_CHECK(  u0028_vhash__collide__verify(pCtx, pvh, u0028_NR_COLLIDE, aValue)  );
+
+	// put them back with new values, plus enough new ones to rehash
+	for (i=0; i<2 * u0028_NR_COLLIDE; i++)
+	{
+		if ((i < u0028_NR_COLLIDE) && (i % 2))
+			continue;
+
+		VERIFY_ERR_CHECK(  u0028_vhash__collide__key(pCtx, i, buf, sizeof(buf))  );
+		VERIFY_ERR_CHECK(  SG_vhash__add__int64(pCtx, pvh, buf, 1000 + i)  );
+		aValue[i] = 1000 + i;
+	}
+	VERIFY_ERR_CHECK(  u0028_vhash__collide__verify(pCtx, pvh, 2 * u0028_NR_COLLIDE, aValue)  );
+
+	// update, which finds an existing one and replaces its value
+	for (i=0; i<2 * u0028_NR_COLLIDE; i+=5)
+	{
+		VERIFY_ERR_CHECK(  u0028_vhash__collide__key(pCtx, i, buf, sizeof(buf))  );
+		VERIFY_ERR_CHECK(  SG_vhash__update__int64(pCtx, pvh, buf, 5000 + i)  );
+		aValue[i] = 5000 + i;
+	}
+	VERIFY_ERR_CHECK(  u0028_vhash__collide__verify(pCtx, pvh, 2 * u0028_NR_COLLIDE, aValue)  );
+
+fail:
+	SG_VHASH_NULLFREE(pCtx, pvh);
+}
+
+#undef u0028_NR_COLLIDE
+
 TEST_MAIN(u0028_vhash)
 {
 	TEMPLATE_MAIN_START;
@@ -708,6 +835,7 @@ TEST_MAIN(u0028_vhash)
 	BEGIN_TEST(  u0028_vhash__sort(pCtx)  );
 	BEGIN_TEST(  u0028_vhash__update(pCtx)  );
 	BEGIN_TEST(  u0028_vhash__remove(pCtx)  );
+	BEGIN_TEST(  u0028_vhash__collide(pCtx)  );
 	BEGIN_TEST(  u0028_vhash__recursive_sort(pCtx)  );
 	BEGIN_TEST(  u0028_vhash__vfile(pCtx)  );
 	BEGIN_TEST(  u0028_vhash__test_5(pCtx)  );
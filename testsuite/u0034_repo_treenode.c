@@ -385,6 +385,86 @@ int u0034_repo_treenode__verify_bogus_treenode_not_found(SG_context* pCtx,SG_rep
 
 //////////////////////////////////////////////////////////////////
 
+/**
+ * Treenodes loaded from the repo go through the process-wide
+ * cache, so loading the same HID twice should give back the same
+ * (shared) object.
+ */
+int u0034_repo_treenode__verify_shared_cache(SG_context* pCtx, SG_repo * pRepo, const char * pszHid)
+{
+	SG_treenode * pTreenode1 = NULL;
+	SG_treenode * pTreenode2 = NULL;
+	SG_treenode * pTreenode3 = NULL;
+	SG_repo * pRepoCopy = NULL;
+	SG_repo * pRepoOther = NULL;
+	SG_uint64 hits0 = 0, hits1 = 0;
+	SG_uint64 misses0 = 0, misses1 = 0;
+	SG_uint32 count1 = 0, count2 = 0;
+
+	// start empty, so that the first load below is a miss
+	VERIFY_ERR_CHECK(  SG_tncache__shared__set_limit(pCtx, 0)  );
+	VERIFY_ERR_CHECK(  SG_tncache__shared__set_limit(pCtx, 16 * 1024 * 1024)  );
+	VERIFY_ERR_CHECK(  SG_tncache__shared__get_stats(pCtx, NULL, NULL, &hits0, &misses0, NULL)  );
+
+	VERIFY_ERR_CHECK(  SG_treenode__load_from_repo(pCtx, pRepo, pszHid, &pTreenode1)  );
+	VERIFY_ERR_CHECK(  SG_treenode__load_from_repo(pCtx, pRepo, pszHid, &pTreenode2)  );
+	VERIFY_COND("shared", (pTreenode1 == pTreenode2));
+
+	VERIFY_ERR_CHECK(  SG_tncache__shared__get_stats(pCtx, &count1, NULL, &hits1, &misses1, NULL)  );
+	VERIFY_COND("hit", (hits1 == hits0 + 1));
+	VERIFY_COND("miss", (misses1 == misses0 + 1));
+	VERIFY_COND("count", (count1 == 1));
+
+	VERIFY_ERR_CHECK_ERR_EQUALS_DISCARD(  SG_treenode__unfreeze(pCtx, pTreenode1),
+										  SG_ERR_INVALID_WHILE_FROZEN  );
+
+	// another instance of the same repo shares it too, but a repo
+	// which doesn't have the blob must not get it from the cache.
+
+	VERIFY_ERR_CHECK(  SG_repo__open_repo_instance__copy(pCtx, pRepo, &pRepoCopy)  );
+	VERIFY_ERR_CHECK(  SG_treenode__load_from_repo(pCtx, pRepoCopy, pszHid, &pTreenode3)  );
+	VERIFY_COND("shared with copy", (pTreenode3 == pTreenode1));
+	SG_TREENODE_NULLFREE(pCtx, pTreenode3);
+
+	pRepoOther = u0034_repo_treenode__open_repo(pCtx);
+	VERIFY_COND("other repo", (pRepoOther != NULL));
+	VERIFY_ERR_CHECK_ERR_EQUALS_DISCARD(  SG_treenode__load_from_repo(pCtx, pRepoOther, pszHid, &pTreenode3),
+										  SG_ERR_BLOB_NOT_FOUND  );
+	VERIFY_COND("not shared with other repo", (pTreenode3 == NULL));
+
+	// freeing one reference leaves the other one good
+
+	SG_TREENODE_NULLFREE(pCtx, pTreenode1);
+	VERIFY_ERR_CHECK(  SG_treenode__count(pCtx, pTreenode2, &count2)  );
+
+	// evict it while we still hold it.  it has to stay good
+	// until we free it.
+
+	VERIFY_ERR_CHECK(  SG_tncache__shared__set_limit(pCtx, 0)  );
+	VERIFY_ERR_CHECK(  SG_tncache__shared__get_stats(pCtx, &count1, NULL, NULL, NULL, NULL)  );
+	VERIFY_COND("evicted", (count1 == 0));
+	VERIFY_ERR_CHECK(  SG_treenode__count(pCtx, pTreenode2, &count1)  );
+	VERIFY_COND("still good", (count1 == count2));
+	SG_TREENODE_NULLFREE(pCtx, pTreenode2);
+
+	// with the cache off, every load is private
+
+	VERIFY_ERR_CHECK(  SG_treenode__load_from_repo(pCtx, pRepo, pszHid, &pTreenode1)  );
+	VERIFY_ERR_CHECK(  SG_treenode__load_from_repo(pCtx, pRepo, pszHid, &pTreenode2)  );
+	VERIFY_COND("not shared", (pTreenode1 != pTreenode2));
+
+fail:
+	SG_TREENODE_NULLFREE(pCtx, pTreenode1);
+	SG_TREENODE_NULLFREE(pCtx, pTreenode2);
+	SG_TREENODE_NULLFREE(pCtx, pTreenode3);
+	SG_REPO_NULLFREE(pCtx, pRepoCopy);
+	SG_REPO_NULLFREE(pCtx, pRepoOther);
+	SG_ERR_IGNORE(  SG_tncache__shared__set_limit(pCtx, 16 * 1024 * 1024)  );
+	return 1;
+}
+
+//////////////////////////////////////////////////////////////////
+
 
 int u0034_repo_treenode__run(SG_context* pCtx)
 {
@@ -421,6 +501,8 @@ int u0034_repo_treenode__run(SG_context* pCtx)
 		u0034_repo_treenode__add_entry_to_list(pCtx, "$",pszidHidTreenodeRoot,pszidGidObjectRoot);
 		SG_NULLFREE(pCtx, pszidGidObjectRoot);
 
+		u0034_repo_treenode__verify_shared_cache(pCtx, pRepo, pszidHidTreenodeRoot);
+
 		SG_NULLFREE(pCtx, pszidHidTreenodeRoot);
 	}
 
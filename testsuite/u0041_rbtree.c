@@ -913,6 +913,257 @@ fail:
 
 //////////////////////////////////////////////////////////////////
 
+/**
+ * Random adds, updates and removes against a small key space, so
+ * that nodes get split, emptied and freed, checked against a vhash
+ * which holds what the rbtree should contain.
+ */
+void u0041_rbtree__random_ops(SG_context * pCtx)
+{
+	SG_rbtree* prb = NULL;
+	SG_rbtree* prbOther = NULL;
+	SG_vhash* pvhShadow = NULL;
+	SG_rbtree_iterator* pit = NULL;
+	char buf[32];
+	SG_uint32 i, round;
+
+	VERIFY_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &prb)  );
+	VERIFY_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvhShadow)  );
+
+	for (round=0; round<8; round++)
+	{
+		SG_uint32 count = 0;
+		SG_uint32 count_shadow = 0;
+		SG_uint32 seen = 0;
+		SG_bool b = SG_FALSE;
+		const char* pszKey = NULL;
+		const char* pszPrev = NULL;
+		void* assoc = NULL;
+
+		for (i=0; i<20000; i++)
+		{
+			SG_uint32 r = SG_random_uint32__2(0, 0x7fffffff);
+			SG_bool bHas = SG_FALSE;
+
+			VERIFY_ERR_CHECK(  SG_sprintf(pCtx, buf, sizeof(buf), "k%05d", r % 5000)  );
+			VERIFY_ERR_CHECK(  SG_vhash__has(pCtx, pvhShadow, buf, &bHas)  );
+
+			if (((r >> 16) % 3) == 0)
+			{
+				SG_rbtree__remove(pCtx, prb, buf);
+				if (bHas)
+				{
+					VERIFY_CTX_IS_OK("remove", pCtx);
+					VERIFY_ERR_CHECK(  SG_vhash__remove(pCtx, pvhShadow, buf)  );
+				}
+				else
+				{
+					VERIFY_CTX_ERR_EQUALS("remove missing", pCtx, SG_ERR_NOT_FOUND);
+					SG_context__err_reset(pCtx);
+				}
+			}
+			else
+			{
+				VERIFY_ERR_CHECK(  SG_rbtree__update__with_assoc(pCtx, prb, buf, (void*)(SG_uint64)(r + 1), NULL)  );
+				VERIFY_ERR_CHECK(  SG_vhash__update__int64(pCtx, pvhShadow, buf, (SG_int64)(r + 1))  );
+			}
+		}
+
+		VERIFY_ERR_CHECK(  SG_rbtree__count(pCtx, prb, &count)  );
+		VERIFY_ERR_CHECK(  SG_vhash__count(pCtx, pvhShadow, &count_shadow)  );
+		VERIFY_COND("count", (count == count_shadow));
+
+		VERIFY_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pit, prb, &b, &pszKey, &assoc)  );
+		while (b)
+		{
+			SG_int64 v = 0;
+
+			if (pszPrev)
+			{
+				VERIFYP_COND("order", (strcmp(pszPrev, pszKey) < 0), ("%s %s", pszPrev, pszKey));
+			}
+			VERIFY_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvhShadow, pszKey, &v)  );
+			VERIFY_COND("assoc", (v == (SG_int64)(SG_uint64)assoc));
+			seen++;
+			pszPrev = pszKey;
+			VERIFY_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pit, &b, &pszKey, &assoc)  );
+		}
+		SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+		VERIFY_COND("seen", (seen == count));
+	}
+
+	// merging.  every third key from a different strpool, half of
+	// which are already in prb.
+
+	VERIFY_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &prbOther)  );
+	for (i=0; i<10000; i+=3)
+	{
+		VERIFY_ERR_CHECK(  SG_sprintf(pCtx, buf, sizeof(buf), "k%05d", i)  );
+		VERIFY_ERR_CHECK(  SG_rbtree__add__with_assoc(pCtx, prbOther, buf, buf)  );
+		VERIFY_ERR_CHECK(  SG_vhash__update__int64(pCtx, pvhShadow, buf, 0)  );
+	}
+
+	{
+		SG_uint32 count_before = 0;
+		SG_uint32 count = 0;
+		SG_uint32 count_shadow = 0;
+		SG_bool b = SG_FALSE;
+		const char* pszKey = NULL;
+		void* assoc = NULL;
+
+		VERIFY_ERR_CHECK(  SG_rbtree__count(pCtx, prb, &count_before)  );
+		SG_rbtree__add__from_other_rbtree(pCtx, prb, prbOther);
+		VERIFY_CTX_ERR_EQUALS("dup", pCtx, SG_ERR_RBTREE_DUPLICATEKEY);
+		SG_context__err_reset(pCtx);
+		VERIFY_ERR_CHECK(  SG_rbtree__count(pCtx, prb, &count)  );
+		VERIFY_COND("unchanged", (count == count_before));
+
+		VERIFY_ERR_CHECK(  SG_rbtree__update__from_other_rbtree__keys_only(pCtx, prb, prbOther)  );
+		VERIFY_ERR_CHECK(  SG_rbtree__count(pCtx, prb, &count)  );
+		VERIFY_ERR_CHECK(  SG_vhash__count(pCtx, pvhShadow, &count_shadow)  );
+		VERIFY_COND("count", (count == count_shadow));
+
+		VERIFY_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pit, prb, &b, &pszKey, &assoc)  );
+		while (b)
+		{
+			SG_int64 v = 0;
+
+			VERIFY_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvhShadow, pszKey, &v)  );
+			VERIFYP_COND("assoc", (v == (SG_int64)(SG_uint64)assoc), ("%s", pszKey));
+			VERIFY_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pit, &b, &pszKey, &assoc)  );
+		}
+		SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+	}
+
+	// empty it all out and make sure it still works
+
+	{
+		SG_bool b = SG_FALSE;
+		const char* pszKey = NULL;
+		SG_uint32 count = 0;
+
+		while (1)
+		{
+			VERIFY_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, NULL, prb, &b, &pszKey, NULL)  );
+			if (!b)
+			{
+				break;
+			}
+			VERIFY_ERR_CHECK(  SG_strcpy(pCtx, buf, sizeof(buf), pszKey)  );
+			VERIFY_ERR_CHECK(  SG_rbtree__remove(pCtx, prb, buf)  );
+		}
+		VERIFY_ERR_CHECK(  SG_rbtree__count(pCtx, prb, &count)  );
+		VERIFY_COND("empty", (count == 0));
+
+		VERIFY_ERR_CHECK(  SG_rbtree__add(pCtx, prb, "again")  );
+		VERIFY_ERR_CHECK(  SG_rbtree__get_only_entry(pCtx, prb, &pszKey, NULL)  );
+		VERIFY_COND("again", (0 == strcmp(pszKey, "again")));
+	}
+
+fail:
+	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+	SG_RBTREE_NULLFREE(pCtx, prb);
+	SG_RBTREE_NULLFREE(pCtx, prbOther);
+	SG_VHASH_NULLFREE(pCtx, pvhShadow);
+}
+
+/**
+ * Not a correctness test.  Times the things SG_rbtree is used for
+ * most: random inserts, lookups, in-order iteration, filling one
+ * tree from another and comparing two trees.
+ */
+void u0041_rbtree__perf(SG_context * pCtx)
+{
+	SG_uint32 count = 100000;
+	char* pBuf = NULL;
+	SG_rbtree* prb = NULL;
+	SG_rbtree* prbCopy = NULL;
+	SG_rbtree* prbBoth = NULL;
+	SG_uint32 i, r;
+	SG_int64 t0, t1, t2, t3, t4, t5, t6;
+	SG_uint32 found = 0;
+	SG_bool b = SG_FALSE;
+	const char* pszKey = NULL;
+	SG_rbtree_iterator* pit = NULL;
+
+	VERIFY_ERR_CHECK(  SG_alloc(pCtx, count, 48, &pBuf)  );
+	for (i=0; i<count; i++)
+	{
+		SG_byte bytes[20];
+
+		SG_random_bytes(bytes, sizeof(bytes));
+		SG_hex__format_buf(pBuf + (i * 48), bytes, sizeof(bytes));
+	}
+
+	VERIFY_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &t0)  );
+	VERIFY_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &prb)  );
+	for (i=0; i<count; i++)
+	{
+		VERIFY_ERR_CHECK(  SG_rbtree__update(pCtx, prb, pBuf + (i * 48))  );
+	}
+
+	VERIFY_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &t1)  );
+	for (r=0; r<5; r++)
+	{
+		for (i=0; i<count; i++)
+		{
+			VERIFY_ERR_CHECK(  SG_rbtree__find(pCtx, prb, pBuf + (i * 48), &b, NULL)  );
+			if (b)
+			{
+				found++;
+			}
+		}
+	}
+	VERIFY_COND("found", (found == (count * 5)));
+
+	VERIFY_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &t2)  );
+	for (r=0; r<20; r++)
+	{
+		VERIFY_ERR_CHECK(  SG_rbtree__iterator__first(pCtx, &pit, prb, &b, &pszKey, NULL)  );
+		while (b)
+		{
+			VERIFY_ERR_CHECK(  SG_rbtree__iterator__next(pCtx, pit, &b, &pszKey, NULL)  );
+		}
+		SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+	}
+
+	VERIFY_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &t3)  );
+	for (r=0; r<5; r++)
+	{
+		SG_RBTREE_NULLFREE(pCtx, prbCopy);
+		VERIFY_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &prbCopy)  );
+		VERIFY_ERR_CHECK(  SG_rbtree__add__from_other_rbtree(pCtx, prbCopy, prb)  );
+	}
+
+	VERIFY_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &t4)  );
+	for (i=0; i<count; i+=2)
+	{
+		VERIFY_ERR_CHECK(  SG_rbtree__remove(pCtx, prbCopy, pBuf + (i * 48))  );
+	}
+
+	VERIFY_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &t5)  );
+	for (r=0; r<5; r++)
+	{
+		SG_RBTREE_NULLFREE(pCtx, prbBoth);
+		VERIFY_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &prbBoth)  );
+		VERIFY_ERR_CHECK(  SG_rbtree__compare__keys_only(pCtx, prb, prbCopy, &b, NULL, NULL, prbBoth)  );
+		VERIFY_COND("not identical", !b);
+	}
+	VERIFY_ERR_CHECK(  SG_time__get_milliseconds_since_1970_utc(pCtx, &t6)  );
+
+	INFOP("rbtree_perf",("%d keys: insert %d ms, find x5 %d ms, iterate x20 %d ms, copy x5 %d ms, remove half %d ms, compare x5 %d ms",
+						 count,
+						 (int)(t1 - t0), (int)(t2 - t1), (int)(t3 - t2),
+						 (int)(t4 - t3), (int)(t5 - t4), (int)(t6 - t5)));
+
+fail:
+	SG_RBTREE_ITERATOR_NULLFREE(pCtx, pit);
+	SG_RBTREE_NULLFREE(pCtx, prb);
+	SG_RBTREE_NULLFREE(pCtx, prbCopy);
+	SG_RBTREE_NULLFREE(pCtx, prbBoth);
+	SG_NULLFREE(pCtx, pBuf);
+}
+
 TEST_MAIN(u0041_rbtree)
 {
 	TEMPLATE_MAIN_START;
@@ -935,5 +1186,8 @@ TEST_MAIN(u0041_rbtree)
 
 	//BEGIN_TEST(  u0041_rbtree__rm_nonexistent(pCtx)  );
 
+	BEGIN_TEST(  u0041_rbtree__random_ops(pCtx)  );
+	BEGIN_TEST(  u0041_rbtree__perf(pCtx)  );
+
 	TEMPLATE_MAIN_END;
 }
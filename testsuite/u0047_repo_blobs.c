@@ -45,6 +45,11 @@ limitations under the License.
 
 #define MyMaxFile				(16*1024)
 #define MyStepFile				(3*1024)
+#define MyBatchDistinct			10
+#define MyBatchCount			(MyBatchDistinct + 2)
+#define MyRecordCount			1100
+#define MyInlineCount			6
+#define MyDictCount				40
 
 //////////////////////////////////////////////////////////////////
 
@@ -485,6 +490,800 @@ void MyFn(create_zero_byte_blob)(SG_context* pCtx,
 
 //////////////////////////////////////////////////////////////////
 
+void MyFn(fill_batch_buf)(SG_context * pCtx, SG_byte * pBuf, SG_uint32 len, SG_uint32 seed)
+{
+	// lines of text, so that zlib has something to do, cut off at len.
+
+	char bufLine[64];
+	SG_uint32 k = 0;
+	SG_uint32 nrLine = 0;
+
+	while (k < len)
+	{
+		SG_uint32 lenLine;
+
+		VERIFY_ERR_CHECK(  SG_sprintf(pCtx, bufLine, sizeof(bufLine), "seed %u length %u line %u\n", seed, len, nrLine++)  );
+		lenLine = (SG_uint32)strlen(bufLine);
+		if (lenLine > len - k)
+			lenLine = len - k;
+		memcpy(pBuf + k, bufLine, lenLine);
+		k += lenLine;
+	}
+
+fail:
+	;
+}
+
+void MyFn(store_blobs_batch__one)(SG_context * pCtx, SG_repo * pRepo, SG_bool b_dont_bother)
+{
+	// store a batch with a mix of sizes on both sides of the inline
+	// limit, a couple of blobs that appear twice in the batch and one
+	// that was already stored the usual way.  then fetch each of them.
+
+	static const SG_uint32 aLen[MyBatchDistinct] = { 0, 1, 50, 500, 2000, 2048, 2049, 3000, 10000, 70000 };
+	SG_byte * apBuf[MyBatchCount];
+	SG_uint32 aLenBatch[MyBatchCount];
+	char * apszHid[MyBatchCount];
+	char * pszHidSingle = NULL;
+	char * pszHidVerify = NULL;
+	SG_byte * pBufFetched = NULL;
+	SG_uint64 lenFetched = 0;
+	SG_repo_tx_handle * pTx = NULL;
+	SG_uint32 k;
+
+	memset(apBuf, 0, sizeof(apBuf));
+	memset(apszHid, 0, sizeof(apszHid));
+
+	for (k=0; k<MyBatchDistinct; k++)
+	{
+		// the 500 byte blob is the same in both batches.
+		SG_uint32 seed = ((aLen[k] == 500) || !b_dont_bother) ? 0 : 1;
+
+		aLenBatch[k] = aLen[k];
+		VERIFY_ERR_CHECK(  SG_allocN(pCtx, aLen[k] + 1, apBuf[k])  );
+		VERIFY_ERR_CHECK(  MyFn(fill_batch_buf)(pCtx, apBuf[k], aLen[k], seed)  );
+	}
+	for (k=MyBatchDistinct; k<MyBatchCount; k++)
+	{
+		SG_uint32 kDup = (k == MyBatchDistinct) ? 3 : 7;
+
+		aLenBatch[k] = aLenBatch[kDup];
+		VERIFY_ERR_CHECK(  SG_allocN(pCtx, aLenBatch[k] + 1, apBuf[k])  );
+		memcpy(apBuf[k], apBuf[kDup], aLenBatch[k]);
+	}
+
+	VERIFY_ERR_CHECK(  SG_repo__begin_tx(pCtx, pRepo, &pTx)  );
+	VERIFY_ERR_CHECK(  SG_repo__store_blob_from_memory(pCtx, pRepo, pTx, SG_FALSE, apBuf[2], aLenBatch[2], &pszHidSingle)  );
+	VERIFY_ERR_CHECK(  SG_repo__store_blobs__batch(pCtx, pRepo, pTx, b_dont_bother, MyBatchCount,
+												   (const SG_byte * const *)apBuf, aLenBatch, apszHid)  );
+	VERIFY_ERR_CHECK(  SG_repo__commit_tx(pCtx, pRepo, &pTx)  );
+
+	VERIFYP_COND("store_blobs_batch", (0 == strcmp(pszHidSingle, apszHid[2])),
+				 ("single [%s] batch [%s]", pszHidSingle, apszHid[2]));
+	VERIFY_COND("store_blobs_batch(dup 3)", (0 == strcmp(apszHid[3], apszHid[MyBatchDistinct])));
+	VERIFY_COND("store_blobs_batch(dup 7)", (0 == strcmp(apszHid[7], apszHid[MyBatchDistinct + 1])));
+
+	for (k=0; k<MyBatchCount; k++)
+	{
+		VERIFY_ERR_CHECK(  SG_repo__alloc_compute_hash__from_bytes(pCtx, pRepo, aLenBatch[k], apBuf[k], &pszHidVerify)  );
+		VERIFYP_COND("store_blobs_batch(hid)", (0 == strcmp(pszHidVerify, apszHid[k])),
+					 ("blob %u: computed [%s] batch [%s]", k, pszHidVerify, apszHid[k]));
+		SG_NULLFREE(pCtx, pszHidVerify);
+
+		VERIFY_ERR_CHECK(  SG_repo__fetch_blob_into_memory(pCtx, pRepo, apszHid[k], &pBufFetched, &lenFetched)  );
+		VERIFYP_COND("store_blobs_batch(fetch)",
+					 ((lenFetched == (SG_uint64)aLenBatch[k]) && (0 == memcmp(pBufFetched, apBuf[k], aLenBatch[k]))),
+					 ("blob %u of length %u", k, aLenBatch[k]));
+		SG_NULLFREE(pCtx, pBufFetched);
+	}
+
+fail:
+	if (pTx)
+	{
+		SG_ERR_IGNORE(  SG_repo__abort_tx(pCtx, pRepo, &pTx)  );
+	}
+	for (k=0; k<MyBatchCount; k++)
+	{
+		SG_NULLFREE(pCtx, apBuf[k]);
+		SG_NULLFREE(pCtx, apszHid[k]);
+	}
+	SG_NULLFREE(pCtx, pszHidSingle);
+	SG_NULLFREE(pCtx, pszHidVerify);
+	SG_NULLFREE(pCtx, pBufFetched);
+}
+
+void MyFn(store_blobs_batch)(SG_context * pCtx, SG_repo * pRepo)
+{
+	VERIFY_ERR_CHECK_DISCARD(  MyFn(store_blobs_batch__one)(pCtx, pRepo, SG_FALSE)  );
+	VERIFY_ERR_CHECK_DISCARD(  MyFn(store_blobs_batch__one)(pCtx, pRepo, SG_TRUE)  );
+}
+
+void MyFn(commit_many_records)(SG_context * pCtx)
+{
+	// commit enough records in one changeset that SG_pendingdb__commit
+	// has to store them in more than one batch.  each record must be
+	// stored under the same HID, and with the same bytes, as
+	// SG_dbrecord__save_to_repo() would have used.
+
+	SG_repo * pRepo = NULL;
+	char * pszHidLeaf = NULL;
+	SG_zingtx * pztx = NULL;
+	SG_zingtemplate * pzt = NULL;
+	SG_zingfieldattributes * pzfa = NULL;
+	SG_zingrecord * pzrec = NULL;
+	SG_changeset * pcs = NULL;
+	SG_dagnode * pdn = NULL;
+	SG_vhash * pvhAdds = NULL;
+	SG_vhash * pvhNames = NULL;
+	SG_dbrecord * prec = NULL;
+	SG_string * pstrJson = NULL;
+	char * pszHidVerify = NULL;
+	SG_byte * pBufFetched = NULL;
+	SG_uint64 lenFetched = 0;
+	SG_varray * pvaUsers = NULL;
+	SG_uint32 count = 0;
+	SG_uint32 k;
+	SG_audit q;
+
+	VERIFY_ERR_CHECK(  MyFn(create_repo)(pCtx, &pRepo)  );
+	VERIFY_ERR_CHECK(  sg_zing__init_new_repo(pCtx, pRepo)  );
+	VERIFY_ERR_CHECK(  SG_user__create(pCtx, pRepo, "testing@sourcegear.com", NULL)  );
+	VERIFY_ERR_CHECK(  SG_user__set_user__repo(pCtx, pRepo, "testing@sourcegear.com")  );
+
+	VERIFY_ERR_CHECK(  SG_zing__get_leaf(pCtx, pRepo, NULL, SG_DAGNUM__USERS, &pszHidLeaf)  );
+	VERIFY_ERR_CHECK(  SG_audit__init(pCtx, &q, pRepo, SG_AUDIT__WHEN__NOW, SG_AUDIT__WHO__FROM_SETTINGS)  );
+	VERIFY_ERR_CHECK(  SG_zing__begin_tx(pCtx, pRepo, SG_DAGNUM__USERS, q.who_szUserId, pszHidLeaf, &pztx)  );
+	VERIFY_ERR_CHECK(  SG_zingtx__add_parent(pCtx, pztx, pszHidLeaf)  );
+	VERIFY_ERR_CHECK(  SG_zingtx__get_template(pCtx, pztx, &pzt)  );
+	VERIFY_ERR_CHECK(  SG_zingtemplate__get_field_attributes(pCtx, pzt, "user", "name", &pzfa)  );
+
+	VERIFY_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pvhNames)  );
+	for (k=0; k<MyRecordCount; k++)
+	{
+		char bufName[64];
+
+		VERIFY_ERR_CHECK(  SG_sprintf(pCtx, bufName, sizeof(bufName), "u0047_%04u@example.com", k)  );
+		VERIFY_ERR_CHECK(  SG_vhash__add__null(pCtx, pvhNames, bufName)  );
+		VERIFY_ERR_CHECK(  SG_zingtx__create_new_record(pCtx, pztx, "user", &pzrec)  );
+		VERIFY_ERR_CHECK(  SG_zingrecord__set_field__string(pCtx, pzrec, pzfa, bufName)  );
+	}
+
+	VERIFY_ERR_CHECK(  SG_zing__commit_tx__hidrecs(pCtx, q.when_int64, &pztx, &pcs, &pdn, NULL, &pvhAdds, NULL)  );
+
+	VERIFY_ERR_CHECK(  SG_vhash__count(pCtx, pvhAdds, &count)  );
+	VERIFYP_COND("commit_many_records", (count == MyRecordCount), ("added %u records", count));
+
+	for (k=0; k<count; k++)
+	{
+		const char * pszHidRec = NULL;
+		const char * pszName = NULL;
+		SG_bool bHas = SG_FALSE;
+
+		VERIFY_ERR_CHECK(  SG_vhash__get_nth_pair(pCtx, pvhAdds, k, &pszHidRec, NULL)  );
+		VERIFY_ERR_CHECK(  SG_dbrecord__load_from_repo(pCtx, pRepo, pszHidRec, &prec)  );
+
+		VERIFY_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstrJson)  );
+		VERIFY_ERR_CHECK(  SG_dbrecord__to_json(pCtx, prec, pstrJson)  );
+		VERIFY_ERR_CHECK(  SG_repo__alloc_compute_hash__from_bytes(pCtx, pRepo, SG_string__length_in_bytes(pstrJson),
+																   (const SG_byte *)SG_string__sz(pstrJson), &pszHidVerify)  );
+		VERIFYP_COND("commit_many_records(hid)", (0 == strcmp(pszHidVerify, pszHidRec)),
+					 ("record [%s] hashes to [%s]", pszHidRec, pszHidVerify));
+
+		VERIFY_ERR_CHECK(  SG_repo__fetch_blob_into_memory(pCtx, pRepo, pszHidRec, &pBufFetched, &lenFetched)  );
+		VERIFYP_COND("commit_many_records(bytes)",
+					 ((lenFetched == (SG_uint64)SG_string__length_in_bytes(pstrJson))
+					  && (0 == memcmp(pBufFetched, SG_string__sz(pstrJson), (size_t)lenFetched))),
+					 ("record [%s]", pszHidRec));
+
+		VERIFY_ERR_CHECK(  SG_dbrecord__get_value(pCtx, prec, "name", &pszName)  );
+		VERIFY_ERR_CHECK(  SG_vhash__has(pCtx, pvhNames, pszName, &bHas)  );
+		VERIFYP_COND("commit_many_records(name)", bHas, ("unexpected or repeated name [%s]", pszName));
+		if (bHas)
+		{
+			VERIFY_ERR_CHECK(  SG_vhash__remove(pCtx, pvhNames, pszName)  );
+		}
+
+		SG_NULLFREE(pCtx, pBufFetched);
+		SG_NULLFREE(pCtx, pszHidVerify);
+		SG_STRING_NULLFREE(pCtx, pstrJson);
+		SG_DBRECORD_NULLFREE(pCtx, prec);
+	}
+
+	VERIFY_ERR_CHECK(  SG_vhash__count(pCtx, pvhNames, &count)  );
+	VERIFYP_COND("commit_many_records(names)", (0 == count), ("%u names were not committed", count));
+
+	// and the index has all of them.
+	VERIFY_ERR_CHECK(  SG_user__list_all(pCtx, pRepo, &pvaUsers)  );
+	VERIFY_ERR_CHECK(  SG_varray__count(pCtx, pvaUsers, &count)  );
+	VERIFYP_COND("commit_many_records(list)", (count >= MyRecordCount + 1), ("listed %u users", count));
+
+fail:
+	if (pztx)
+	{
+		SG_ERR_IGNORE(  SG_zing__abort_tx(pCtx, &pztx)  );
+	}
+	SG_NULLFREE(pCtx, pszHidLeaf);
+	SG_NULLFREE(pCtx, pszHidVerify);
+	SG_NULLFREE(pCtx, pBufFetched);
+	SG_STRING_NULLFREE(pCtx, pstrJson);
+	SG_DBRECORD_NULLFREE(pCtx, prec);
+	SG_CHANGESET_NULLFREE(pCtx, pcs);
+	SG_DAGNODE_NULLFREE(pCtx, pdn);
+	SG_VHASH_NULLFREE(pCtx, pvhAdds);
+	SG_VHASH_NULLFREE(pCtx, pvhNames);
+	SG_VARRAY_NULLFREE(pCtx, pvaUsers);
+	SG_REPO_NULLFREE(pCtx, pRepo);
+}
+
+void MyFn(text)(SG_context * pCtx, SG_uint32 nrLines, SG_uint32 every, SG_byte ** ppBuf, SG_uint32 * pLen)
+{
+	// nrLines of text.  if every is not 0, every every'th line is changed.
+
+	SG_string * pstr = NULL;
+	SG_uint32 k;
+
+	VERIFY_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstr)  );
+	for (k=0; k<nrLines; k++)
+	{
+		if (every && (k % every) == 0)
+			VERIFY_ERR_CHECK(  SG_string__append__format(pCtx, pstr, "line %d was changed\n", k)  );
+		else
+			VERIFY_ERR_CHECK(  SG_string__append__format(pCtx, pstr, "line %d of the original text\n", k)  );
+	}
+
+	*pLen = SG_string__length_in_bytes(pstr);
+	VERIFY_ERR_CHECK(  SG_string__sizzle(pCtx, &pstr, ppBuf, NULL)  );
+
+fail:
+	SG_STRING_NULLFREE(pCtx, pstr);
+}
+
+void MyFn(write_file)(SG_context * pCtx, SG_pathname * pPath, const SG_byte * pBuf, SG_uint32 len)
+{
+	SG_file * pFile = NULL;
+
+	VERIFY_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_WRONLY | SG_FILE_CREATE_NEW, 0644, &pFile)  );
+	VERIFY_ERR_CHECK(  SG_file__write(pCtx, pFile, len, pBuf, NULL)  );
+	VERIFY_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+
+fail:
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+}
+
+void MyFn(store_vcdiff)(SG_context * pCtx,
+						SG_repo * pRepo,
+						SG_repo_tx_handle * pTx,
+						SG_pathname * pPathnameTempDir,
+						const SG_byte * pBufRef, SG_uint32 lenRef, const char * pszHidRef,
+						const SG_byte * pBuf, SG_uint32 len, const char * pszHid)
+{
+	// store pBuf as a vcdiff against pBufRef, which is already in the repo.
+
+	SG_pathname * pPathRef = NULL;
+	SG_pathname * pPathTarget = NULL;
+	SG_pathname * pPathDelta = NULL;
+	SG_file * pFile = NULL;
+	SG_byte * pDelta = NULL;
+	SG_uint64 lenDelta = 0;
+	SG_repo_store_blob_handle * pbh = NULL;
+	char * pszHidReturned = NULL;
+
+	VERIFY_ERR_CHECK(  unittest__alloc_unique_pathname(pCtx, SG_pathname__sz(pPathnameTempDir), &pPathRef)  );
+	VERIFY_ERR_CHECK(  unittest__alloc_unique_pathname(pCtx, SG_pathname__sz(pPathnameTempDir), &pPathTarget)  );
+	VERIFY_ERR_CHECK(  unittest__alloc_unique_pathname(pCtx, SG_pathname__sz(pPathnameTempDir), &pPathDelta)  );
+	VERIFY_ERR_CHECK(  MyFn(write_file)(pCtx, pPathRef, pBufRef, lenRef)  );
+	VERIFY_ERR_CHECK(  MyFn(write_file)(pCtx, pPathTarget, pBuf, len)  );
+	VERIFY_ERR_CHECK(  SG_vcdiff__deltify__files(pCtx, pPathRef, pPathTarget, pPathDelta)  );
+	VERIFY_ERR_CHECK(  SG_fsobj__length__pathname(pCtx, pPathDelta, &lenDelta, NULL)  );
+	VERIFY_ERR_CHECK(  SG_allocN(pCtx, (SG_uint32)lenDelta, pDelta)  );
+	VERIFY_ERR_CHECK(  SG_file__open__pathname(pCtx, pPathDelta, SG_FILE_RDONLY | SG_FILE_OPEN_EXISTING, SG_FSOBJ_PERMS__UNUSED, &pFile)  );
+	VERIFY_ERR_CHECK(  SG_file__read(pCtx, pFile, (SG_uint32)lenDelta, pDelta, NULL)  );
+	VERIFY_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+
+	VERIFY_ERR_CHECK(  SG_repo__store_blob__begin(pCtx, pRepo, pTx, SG_BLOBENCODING__VCDIFF, pszHidRef,
+												  len, lenDelta, pszHid, &pbh)  );
+	VERIFY_ERR_CHECK(  SG_repo__store_blob__chunk(pCtx, pRepo, pbh, (SG_uint32)lenDelta, pDelta, NULL)  );
+	VERIFY_ERR_CHECK(  SG_repo__store_blob__end(pCtx, pRepo, pTx, &pbh, &pszHidReturned)  );
+	VERIFY_COND("store_vcdiff(hid)", (0 == strcmp(pszHidReturned, pszHid)));
+
+fail:
+	if (pbh)
+	{
+		SG_ERR_IGNORE(  SG_repo__store_blob__abort(pCtx, pRepo, pTx, &pbh)  );
+	}
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+	SG_PATHNAME_NULLFREE(pCtx, pPathRef);
+	SG_PATHNAME_NULLFREE(pCtx, pPathTarget);
+	SG_PATHNAME_NULLFREE(pCtx, pPathDelta);
+	SG_NULLFREE(pCtx, pDelta);
+	SG_NULLFREE(pCtx, pszHidReturned);
+}
+
+void MyFn(verify_blobs)(SG_context * pCtx, SG_repo * pRepo, const char * pszLabel,
+						SG_byte ** apBuf, SG_uint32 * aLen, char ** apszHid, SG_uint32 count)
+{
+	SG_byte * pBufFetched = NULL;
+	SG_uint64 lenFetched = 0;
+	char * pszHidFetched = NULL;
+	SG_uint32 k;
+
+	for (k=0; k<count; k++)
+	{
+		VERIFY_ERR_CHECK(  SG_repo__fetch_blob_into_memory(pCtx, pRepo, apszHid[k], &pBufFetched, &lenFetched)  );
+		VERIFYP_COND(pszLabel,
+					 ((lenFetched == (SG_uint64)aLen[k]) && (0 == memcmp(pBufFetched, apBuf[k], aLen[k]))),
+					 ("blob %u [%s] of length %u", k, apszHid[k], aLen[k]));
+		VERIFY_ERR_CHECK(  SG_repo__alloc_compute_hash__from_bytes(pCtx, pRepo, (SG_uint32)lenFetched, pBufFetched, &pszHidFetched)  );
+		VERIFYP_COND(pszLabel, (0 == strcmp(pszHidFetched, apszHid[k])),
+					 ("blob %u [%s] hashes to [%s]", k, apszHid[k], pszHidFetched));
+		SG_NULLFREE(pCtx, pszHidFetched);
+		SG_NULLFREE(pCtx, pBufFetched);
+	}
+
+fail:
+	SG_NULLFREE(pCtx, pBufFetched);
+	SG_NULLFREE(pCtx, pszHidFetched);
+}
+
+void MyFn(file_range)(SG_context * pCtx, SG_repo * pRepo)
+{
+	// a blob stored full in a blob file can be read straight out of it.
+	// one that was compressed can't, and neither can anything while a
+	// transaction is open, since it could still be rolled back.
+
+	SG_byte * pBufFull = NULL;
+	SG_byte * pBufZlib = NULL;
+	SG_byte * pBufRead = NULL;
+	SG_uint32 lenFull = 0;
+	SG_uint32 lenZlib = 0;
+	SG_uint32 lenRead = 0;
+	char * pszHidFull = NULL;
+	char * pszHidZlib = NULL;
+	SG_repo_tx_handle * pTx = NULL;
+	SG_repo_fetch_blob_handle * pFetch = NULL;
+	SG_blob_encoding encoding = 0;
+	SG_pathname * pPath = NULL;
+	SG_file * pFile = NULL;
+	SG_uint64 offset = 0;
+	SG_uint64 len = 0;
+
+	VERIFY_ERR_CHECK(  MyFn(text)(pCtx, 500, 0, &pBufFull, &lenFull)  );
+	VERIFY_ERR_CHECK(  MyFn(text)(pCtx, 500, 7, &pBufZlib, &lenZlib)  );
+
+	VERIFY_ERR_CHECK(  SG_repo__begin_tx(pCtx, pRepo, &pTx)  );
+	VERIFY_ERR_CHECK(  SG_repo__store_blob_from_memory(pCtx, pRepo, pTx, SG_TRUE, pBufFull, lenFull, &pszHidFull)  );
+	VERIFY_ERR_CHECK(  SG_repo__store_blob_from_memory(pCtx, pRepo, pTx, SG_FALSE, pBufZlib, lenZlib, &pszHidZlib)  );
+
+	VERIFY_ERR_CHECK(  SG_repo__fetch_blob__file_range(pCtx, pRepo, pszHidFull, &pPath, &offset, &len)  );
+	VERIFY_COND("file_range(in tx)", (pPath == NULL));
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+
+	VERIFY_ERR_CHECK(  SG_repo__commit_tx(pCtx, pRepo, &pTx)  );
+
+	VERIFY_ERR_CHECK(  SG_repo__fetch_blob__file_range(pCtx, pRepo, pszHidFull, &pPath, &offset, &len)  );
+	VERIFY_COND("file_range(full)", (pPath != NULL));
+	VERIFYP_COND("file_range(full)", (len == (SG_uint64)lenFull), ("len=%d", (int)len));
+	if (pPath)
+	{
+		VERIFY_ERR_CHECK(  SG_allocN(pCtx, lenFull, pBufRead)  );
+		VERIFY_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_RDONLY | SG_FILE_OPEN_EXISTING, SG_FSOBJ_PERMS__UNUSED, &pFile)  );
+		VERIFY_ERR_CHECK(  SG_file__seek(pCtx, pFile, offset)  );
+		VERIFY_ERR_CHECK(  SG_file__read(pCtx, pFile, lenFull, pBufRead, &lenRead)  );
+		VERIFY_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+		VERIFY_COND("file_range(bytes)", ((lenRead == lenFull) && (0 == memcmp(pBufRead, pBufFull, lenFull))));
+	}
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+
+	// make sure the other one really was compressed.
+	VERIFY_ERR_CHECK(  SG_repo__fetch_blob__begin(pCtx, pRepo, pszHidZlib, SG_FALSE, &encoding, NULL, NULL, NULL, &pFetch)  );
+	VERIFY_ERR_CHECK(  SG_repo__fetch_blob__abort(pCtx, pRepo, &pFetch)  );
+	VERIFYP_COND("file_range(zlib)", (SG_BLOBENCODING__ZLIB == encoding), ("encoding=%d", (int)encoding));
+
+	VERIFY_ERR_CHECK(  SG_repo__fetch_blob__file_range(pCtx, pRepo, pszHidZlib, &pPath, &offset, &len)  );
+	VERIFY_COND("file_range(zlib)", (pPath == NULL));
+
+fail:
+	if (pTx)
+	{
+		SG_ERR_IGNORE(  SG_repo__abort_tx(pCtx, pRepo, &pTx)  );
+	}
+	if (pFetch)
+	{
+		SG_ERR_IGNORE(  SG_repo__fetch_blob__abort(pCtx, pRepo, &pFetch)  );
+	}
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+	SG_NULLFREE(pCtx, pBufFull);
+	SG_NULLFREE(pCtx, pBufZlib);
+	SG_NULLFREE(pCtx, pBufRead);
+	SG_NULLFREE(pCtx, pszHidFull);
+	SG_NULLFREE(pCtx, pszHidZlib);
+}
+
+void MyFn(inline_round_trip)(SG_context * pCtx, SG_repo * pRepoDefault, SG_pathname * pPathnameTempDir)
+{
+	// small blobs only go into the inline_blobs table of a repo created
+	// with new_repo/inline_blobs set.  store one of each kind of small
+	// blob there, including a vcdiff whose delta is small enough to be
+	// inline, and read them back from it and from a clone of it.
+
+	char bufName[SG_TID_MAX_BUFFER_LENGTH];
+	char bufCloneName[SG_TID_MAX_BUFFER_LENGTH];
+	SG_repo * pRepo = NULL;
+	SG_repo * pRepoClone = NULL;
+	SG_repo_tx_handle * pTx = NULL;
+	SG_repo_fetch_blob_handle * pFetch = NULL;
+	SG_vhash * pvhStats = NULL;
+	SG_byte * apBuf[MyInlineCount];
+	SG_uint32 aLen[MyInlineCount];
+	char * apszHid[MyInlineCount];
+	char * pszHid = NULL;
+	SG_blob_encoding encoding = 0;
+	SG_bool bSetting = SG_FALSE;
+	SG_pathname * pPath = NULL;
+	SG_uint64 offset = 0;
+	SG_uint64 len = 0;
+	SG_uint32 count = 0;
+	SG_uint32 k;
+
+	memset(apBuf, 0, sizeof(apBuf));
+	memset(apszHid, 0, sizeof(apszHid));
+
+	// a repo made without the setting keeps the old layout, which has
+	// nowhere to put a dictionary.
+	VERIFY_ERR_CHECK(  SG_repo__train_blob_dictionaries(pCtx, pRepoDefault, &pvhStats)  );
+	VERIFY_ERR_CHECK(  SG_vhash__count(pCtx, pvhStats, &count)  );
+	VERIFYP_COND("inline_round_trip(default)", (0 == count), ("trained %u kinds", count));
+	SG_VHASH_NULLFREE(pCtx, pvhStats);
+
+	VERIFY_ERR_CHECK(  SG_localsettings__update__sz(pCtx, SG_LOCALSETTING__NEWREPO_INLINE_BLOBS, "true")  );
+	bSetting = SG_TRUE;
+
+	VERIFY_ERR_CHECK(  SG_tid__generate2(pCtx, bufName, sizeof(bufName), 32)  );
+	VERIFY_ERR_CHECK(  SG_vv2__init_new_repo(pCtx, bufName, NULL, NULL, NULL, SG_TRUE, NULL, SG_FALSE, NULL, NULL)  );
+	VERIFY_ERR_CHECK(  SG_REPO__OPEN_REPO_INSTANCE(pCtx, bufName, &pRepo)  );
+
+	// 0: empty, 1: small zlib, 2: small full, 3: the vcdiff reference,
+	// which is too big to be inline, 4: an inline vcdiff against it,
+	// 5: another small one, stored in a batch.
+	VERIFY_ERR_CHECK(  SG_allocN(pCtx, 1, apBuf[0])  );
+	aLen[0] = 0;
+	VERIFY_ERR_CHECK(  MyFn(text)(pCtx, 12, 0, &apBuf[1], &aLen[1])  );
+	VERIFY_ERR_CHECK(  MyFn(text)(pCtx, 10, 3, &apBuf[2], &aLen[2])  );
+	VERIFY_ERR_CHECK(  MyFn(text)(pCtx, 2000, 0, &apBuf[3], &aLen[3])  );
+	VERIFY_ERR_CHECK(  MyFn(text)(pCtx, 2000, 97, &apBuf[4], &aLen[4])  );
+	VERIFY_ERR_CHECK(  MyFn(text)(pCtx, 20, 7, &apBuf[5], &aLen[5])  );
+	for (k=0; k<MyInlineCount; k++)
+	{
+		VERIFY_ERR_CHECK(  SG_repo__alloc_compute_hash__from_bytes(pCtx, pRepo, aLen[k], apBuf[k], &apszHid[k])  );
+	}
+
+	VERIFY_ERR_CHECK(  SG_repo__begin_tx(pCtx, pRepo, &pTx)  );
+	for (k=0; k<4; k++)
+	{
+		VERIFY_ERR_CHECK(  SG_repo__store_blob_from_memory(pCtx, pRepo, pTx, (k == 2), apBuf[k], aLen[k], &pszHid)  );
+		VERIFY_COND("inline_round_trip(store)", (0 == strcmp(pszHid, apszHid[k])));
+		SG_NULLFREE(pCtx, pszHid);
+	}
+	VERIFY_ERR_CHECK(  MyFn(store_vcdiff)(pCtx, pRepo, pTx, pPathnameTempDir,
+										  apBuf[3], aLen[3], apszHid[3], apBuf[4], aLen[4], apszHid[4])  );
+	VERIFY_ERR_CHECK(  SG_repo__store_blobs__batch(pCtx, pRepo, pTx, SG_FALSE, 1,
+												   (const SG_byte * const *)&apBuf[5], &aLen[5], &pszHid)  );
+	VERIFY_COND("inline_round_trip(batch)", (0 == strcmp(pszHid, apszHid[5])));
+	SG_NULLFREE(pCtx, pszHid);
+	VERIFY_ERR_CHECK(  SG_repo__commit_tx(pCtx, pRepo, &pTx)  );
+
+	// make sure the delta really was kept as one, or we aren't testing
+	// what we think we are.
+	VERIFY_ERR_CHECK(  SG_repo__fetch_blob__begin(pCtx, pRepo, apszHid[4], SG_FALSE, &encoding, NULL, NULL, NULL, &pFetch)  );
+	VERIFY_ERR_CHECK(  SG_repo__fetch_blob__abort(pCtx, pRepo, &pFetch)  );
+	VERIFYP_COND("inline_round_trip(vcdiff)", (SG_BLOBENCODING__VCDIFF == encoding), ("encoding=%d", (int)encoding));
+
+	VERIFY_ERR_CHECK(  MyFn(verify_blobs)(pCtx, pRepo, "inline_round_trip(fetch)", apBuf, aLen, apszHid, MyInlineCount)  );
+
+	// an inline blob has no file to send it from, even stored full.
+	VERIFY_ERR_CHECK(  SG_repo__fetch_blob__file_range(pCtx, pRepo, apszHid[2], &pPath, &offset, &len)  );
+	VERIFY_COND("inline_round_trip(file_range)", (pPath == NULL));
+
+	VERIFY_ERR_CHECK(  MyFn(store_blobs_batch)(pCtx, pRepo)  );
+
+	VERIFY_ERR_CHECK(  SG_repo__train_blob_dictionaries(pCtx, pRepo, &pvhStats)  );
+	VERIFY_ERR_CHECK(  SG_vhash__count(pCtx, pvhStats, &count)  );
+	VERIFYP_COND("inline_round_trip(inline)", (0 < count), ("trained %u kinds", count));
+	SG_VHASH_NULLFREE(pCtx, pvhStats);
+
+	VERIFY_ERR_CHECK(  SG_tid__generate2(pCtx, bufCloneName, sizeof(bufCloneName), 32)  );
+	VERIFY_ERR_CHECK(  SG_clone__to_local(pCtx, bufName, NULL, NULL, bufCloneName, NULL, NULL, NULL)  );
+	VERIFY_ERR_CHECK(  SG_REPO__OPEN_REPO_INSTANCE(pCtx, bufCloneName, &pRepoClone)  );
+	VERIFY_ERR_CHECK(  MyFn(verify_blobs)(pCtx, pRepoClone, "inline_round_trip(clone)", apBuf, aLen, apszHid, MyInlineCount)  );
+
+fail:
+	if (pTx)
+	{
+		SG_ERR_IGNORE(  SG_repo__abort_tx(pCtx, pRepo, &pTx)  );
+	}
+	if (pFetch)
+	{
+		SG_ERR_IGNORE(  SG_repo__fetch_blob__abort(pCtx, pRepo, &pFetch)  );
+	}
+	if (bSetting)
+	{
+		SG_ERR_IGNORE(  SG_localsettings__reset(pCtx, SG_LOCALSETTING__NEWREPO_INLINE_BLOBS)  );
+	}
+	for (k=0; k<MyInlineCount; k++)
+	{
+		SG_NULLFREE(pCtx, apBuf[k]);
+		SG_NULLFREE(pCtx, apszHid[k]);
+	}
+	SG_NULLFREE(pCtx, pszHid);
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+	SG_VHASH_NULLFREE(pCtx, pvhStats);
+	SG_REPO_NULLFREE(pCtx, pRepo);
+	SG_REPO_NULLFREE(pCtx, pRepoClone);
+}
+
+void MyFn(json)(SG_context * pCtx, SG_uint32 set, SG_uint32 k, SG_byte ** ppBuf, SG_uint32 * pLen)
+{
+	// a small dbrecord-ish blob.  sets 0 and 1 look alike; set 2 has
+	// different keys, so training on it gives a different dictionary.
+
+	SG_string * pstr = NULL;
+
+	VERIFY_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstr)  );
+	if (set < 2)
+		VERIFY_ERR_CHECK(  SG_string__append__format(pCtx, pstr,
+													 "{\"rectype\":\"item\",\"recid\":\"g%08u%08u\",\"title\":\"Item number %u\",\"status\":\"open\",\"priority\":%u,\"assignee\":\"someone@example.com\",\"milestone\":\"release %u\"}",
+													 set, k, k, k % 5, k % 3)  );
+	else
+		VERIFY_ERR_CHECK(  SG_string__append__format(pCtx, pstr,
+													 "{\"rectype\":\"comment\",\"item\":\"g%08u\",\"who\":\"nobody@example.com\",\"text\":\"This is comment %u, which says nothing at all\",\"when\":%u}",
+													 k, k, 1000000 + k)  );
+
+	*pLen = SG_string__length_in_bytes(pstr);
+	VERIFY_ERR_CHECK(  SG_string__sizzle(pCtx, &pstr, ppBuf, NULL)  );
+
+fail:
+	SG_STRING_NULLFREE(pCtx, pstr);
+}
+
+void MyFn(store_json)(SG_context * pCtx, SG_repo * pRepo, SG_uint32 set,
+					  SG_byte ** apBuf, SG_uint32 * aLen, char ** apszHid)
+{
+	// store the first half one at a time and the rest in a batch, so
+	// both ways of storing get to use the dictionary.
+
+	SG_repo_tx_handle * pTx = NULL;
+	char * pszHid = NULL;
+	char ** apszHidBatch = NULL;
+	SG_uint32 half = MyDictCount / 2;
+	SG_uint32 k;
+
+	for (k=0; k<MyDictCount; k++)
+	{
+		VERIFY_ERR_CHECK(  MyFn(json)(pCtx, set, k, &apBuf[k], &aLen[k])  );
+		VERIFY_ERR_CHECK(  SG_repo__alloc_compute_hash__from_bytes(pCtx, pRepo, aLen[k], apBuf[k], &apszHid[k])  );
+	}
+
+	VERIFY_ERR_CHECK(  SG_allocN(pCtx, MyDictCount - half, apszHidBatch)  );
+
+	VERIFY_ERR_CHECK(  SG_repo__begin_tx(pCtx, pRepo, &pTx)  );
+	for (k=0; k<half; k++)
+	{
+		VERIFY_ERR_CHECK(  SG_repo__store_blob_from_memory(pCtx, pRepo, pTx, SG_FALSE, apBuf[k], aLen[k], &pszHid)  );
+		VERIFY_COND("store_json(single)", (0 == strcmp(pszHid, apszHid[k])));
+		SG_NULLFREE(pCtx, pszHid);
+	}
+	VERIFY_ERR_CHECK(  SG_repo__store_blobs__batch(pCtx, pRepo, pTx, SG_FALSE, MyDictCount - half,
+												   (const SG_byte * const *)&apBuf[half], &aLen[half], apszHidBatch)  );
+	VERIFY_ERR_CHECK(  SG_repo__commit_tx(pCtx, pRepo, &pTx)  );
+
+	for (k=half; k<MyDictCount; k++)
+	{
+		VERIFY_COND("store_json(batch)", (0 == strcmp(apszHidBatch[k - half], apszHid[k])));
+	}
+
+fail:
+	if (pTx)
+	{
+		SG_ERR_IGNORE(  SG_repo__abort_tx(pCtx, pRepo, &pTx)  );
+	}
+	if (apszHidBatch)
+	{
+		for (k=half; k<MyDictCount; k++)
+			SG_NULLFREE(pCtx, apszHidBatch[k - half]);
+		SG_NULLFREE(pCtx, apszHidBatch);
+	}
+	SG_NULLFREE(pCtx, pszHid);
+}
+
+void MyFn(train_dbrecords)(SG_context * pCtx, SG_repo * pRepo, char * bufId, SG_uint32 lenBufId)
+{
+	// train, and return the id of the new dbrecord dictionary.
+
+	SG_vhash * pvhStats = NULL;
+	SG_vhash * pvhKind = NULL;
+	const char * pszId = NULL;
+	SG_bool bUsed = SG_FALSE;
+
+	VERIFY_ERR_CHECK(  SG_repo__train_blob_dictionaries(pCtx, pRepo, &pvhStats)  );
+	VERIFY_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhStats, "dbrecord", &pvhKind)  );
+	VERIFY_ERR_CHECK(  SG_vhash__get__bool(pCtx, pvhKind, "used", &bUsed)  );
+	VERIFY_ERR_CHECK(  SG_vhash__get__sz(pCtx, pvhKind, "id", &pszId)  );
+	VERIFYP_COND("train_dbrecords(used)", (bUsed), ("dictionary %s was not used", pszId));
+	VERIFY_ERR_CHECK(  SG_strcpy(pCtx, bufId, lenBufId, pszId)  );
+
+fail:
+	SG_VHASH_NULLFREE(pCtx, pvhStats);
+}
+
+void MyFn(verify_encoding)(SG_context * pCtx, SG_repo * pRepo, const char * pszLabel,
+						   char ** apszHid, SG_uint32 count, SG_blob_encoding encodingExpected)
+{
+	// check how the repo itself has the blobs stored.  fetching one
+	// always gives it back decoded, so ask for the list instead.
+
+	SG_blobset * pbs = NULL;
+	SG_blob_encoding encoding = 0;
+	SG_bool bFound = SG_FALSE;
+	SG_uint32 k;
+
+	VERIFY_ERR_CHECK(  SG_repo__list_blobs(pCtx, pRepo, 0, 0, 0, &pbs)  );
+	for (k=0; k<count; k++)
+	{
+		VERIFY_ERR_CHECK(  SG_blobset__lookup(pCtx, pbs, apszHid[k], &bFound, NULL, NULL, &encoding, NULL, NULL, NULL)  );
+		VERIFYP_COND(pszLabel, (bFound && (encodingExpected == encoding)),
+					 ("blob %u [%s] found=%d encoding=%d", k, apszHid[k], bFound, (int)encoding));
+	}
+
+fail:
+	SG_BLOBSET_NULLFREE(pCtx, pbs);
+}
+
+void MyFn(verify_fragball)(SG_context * pCtx, SG_repo * pRepo, SG_pathname * pPathnameTempDir,
+						   SG_byte ** apBuf, SG_uint32 * aLen, char ** apszHid, SG_uint32 count)
+{
+	// the other side of a sync has no dictionary, so every blob in a
+	// v3 fragball has to be FULL.
+
+	SG_pathname * pPath = NULL;
+	SG_fragball_writer * pfb = NULL;
+	SG_file * pFile = NULL;
+	SG_vhash * pvh = NULL;
+	SG_byte * pPayload = NULL;
+	SG_uint32 nrBlobs = 0;
+	SG_uint32 k;
+
+	VERIFY_ERR_CHECK(  unittest__alloc_unique_pathname(pCtx, SG_pathname__sz(pPathnameTempDir), &pPath)  );
+	VERIFY_ERR_CHECK(  SG_fragball_writer__alloc(pCtx, pRepo, pPath, SG_TRUE, 3, &pfb)  );
+	VERIFY_ERR_CHECK(  SG_fragball__write__blobs(pCtx, pfb, (const char * const *)apszHid, count)  );
+	VERIFY_ERR_CHECK(  SG_fragball_writer__close(pCtx, pfb)  );
+	SG_FRAGBALL_WRITER_NULLFREE(pCtx, pfb);
+
+	VERIFY_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_RDONLY | SG_FILE_OPEN_EXISTING, SG_FSOBJ_PERMS__UNUSED, &pFile)  );
+	VERIFY_ERR_CHECK(  SG_fragball__v1__read_object_header(pCtx, pFile, &pvh)  );
+	SG_VHASH_NULLFREE(pCtx, pvh);
+
+	while (1)
+	{
+		SG_uint16 type = 0;
+		SG_uint16 flags = 0;
+		SG_uint32 lenJson = 0;
+		SG_uint32 lenZlibJson = 0;
+		SG_uint64 lenPayload = 0;
+		const char * pszHid = NULL;
+		SG_int64 encoding = 0;
+		SG_int64 lenEncoded = 0;
+		SG_int64 lenFull = 0;
+
+		VERIFY_ERR_CHECK(  SG_fragball__v3__read_object_header(pCtx, pFile, &type, &flags, &lenJson, &lenZlibJson, &lenPayload)  );
+		if (0 == type)
+			break;
+		VERIFYP_COND("verify_fragball(type)", (SG_FRAGBALL_V3_TYPE__BLOB == type), ("type=%d", (int)type));
+		if (SG_FRAGBALL_V3_TYPE__BLOB != type)
+			break;
+
+		VERIFY_ERR_CHECK(  SG_fragball__v3__read_json(pCtx, pFile, flags, lenJson, lenZlibJson, &pvh)  );
+		VERIFY_ERR_CHECK(  SG_vhash__get__sz(pCtx, pvh, "hid", &pszHid)  );
+		VERIFY_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvh, "encoding", &encoding)  );
+		VERIFY_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvh, "len_encoded", &lenEncoded)  );
+		VERIFY_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvh, "len_full", &lenFull)  );
+		VERIFYP_COND("verify_fragball(full)",
+					 ((SG_BLOBENCODING__FULL == encoding) && (lenEncoded == lenFull) && ((SG_uint64)lenFull == lenPayload)),
+					 ("blob [%s] encoding=%d len_encoded=%d len_full=%d", pszHid, (int)encoding, (int)lenEncoded, (int)lenFull));
+
+		VERIFY_ERR_CHECK(  SG_allocN(pCtx, (SG_uint32)lenPayload + 1, pPayload)  );
+		VERIFY_ERR_CHECK(  SG_file__read(pCtx, pFile, (SG_uint32)lenPayload, pPayload, NULL)  );
+		for (k=0; k<count; k++)
+		{
+			if (0 == strcmp(pszHid, apszHid[k]))
+				break;
+		}
+		VERIFYP_COND("verify_fragball(contents)",
+					 ((k < count) && (lenPayload == (SG_uint64)aLen[k]) && (0 == memcmp(pPayload, apBuf[k], aLen[k]))),
+					 ("blob [%s]", pszHid));
+		SG_NULLFREE(pCtx, pPayload);
+		SG_VHASH_NULLFREE(pCtx, pvh);
+		nrBlobs++;
+	}
+	VERIFYP_COND("verify_fragball(count)", (nrBlobs == count), ("found %u of %u blobs", nrBlobs, count));
+
+fail:
+	SG_FRAGBALL_WRITER_NULLFREE(pCtx, pfb);
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+	if (pPath)
+		SG_ERR_IGNORE(  SG_fsobj__remove__pathname(pCtx, pPath)  );
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+	SG_VHASH_NULLFREE(pCtx, pvh);
+	SG_NULLFREE(pCtx, pPayload);
+}
+
+void MyFn(zlibdict)(SG_context * pCtx, SG_pathname * pPathnameTempDir)
+{
+	// small JSON blobs in an inline repo.  after training, new ones are
+	// stored with the dictionary.  after training again on different
+	// ones, the blobs stored with the old dictionary still read back.
+	// none of them ever leave the repo as ZLIBDICT.
+
+	char bufName[SG_TID_MAX_BUFFER_LENGTH];
+	char bufId1[16];
+	char bufId2[16];
+	SG_repo * pRepo = NULL;
+	SG_byte * apBuf[3][MyDictCount];
+	SG_uint32 aLen[3][MyDictCount];
+	char * apszHid[3][MyDictCount];
+	SG_bool bSetting = SG_FALSE;
+	SG_uint32 set;
+	SG_uint32 k;
+
+	memset(apBuf, 0, sizeof(apBuf));
+	memset(apszHid, 0, sizeof(apszHid));
+
+	VERIFY_ERR_CHECK(  SG_localsettings__update__sz(pCtx, SG_LOCALSETTING__NEWREPO_INLINE_BLOBS, "true")  );
+	bSetting = SG_TRUE;
+
+	VERIFY_ERR_CHECK(  SG_tid__generate2(pCtx, bufName, sizeof(bufName), 32)  );
+	VERIFY_ERR_CHECK(  SG_vv2__init_new_repo(pCtx, bufName, NULL, NULL, NULL, SG_TRUE, NULL, SG_FALSE, NULL, NULL)  );
+	VERIFY_ERR_CHECK(  SG_REPO__OPEN_REPO_INSTANCE(pCtx, bufName, &pRepo)  );
+
+	// before there is a dictionary, they are plain zlib
+	VERIFY_ERR_CHECK(  MyFn(store_json)(pCtx, pRepo, 0, apBuf[0], aLen[0], apszHid[0])  );
+	VERIFY_ERR_CHECK(  MyFn(verify_encoding)(pCtx, pRepo, "zlibdict(before)", apszHid[0], MyDictCount, SG_BLOBENCODING__ZLIB)  );
+
+	VERIFY_ERR_CHECK(  MyFn(train_dbrecords)(pCtx, pRepo, bufId1, sizeof(bufId1))  );
+	VERIFY_ERR_CHECK(  MyFn(store_json)(pCtx, pRepo, 1, apBuf[1], aLen[1], apszHid[1])  );
+	VERIFY_ERR_CHECK(  MyFn(verify_encoding)(pCtx, pRepo, "zlibdict(trained)", apszHid[1], MyDictCount, SG_BLOBENCODING__ZLIBDICT)  );
+
+	// retire the first dictionary
+	VERIFY_ERR_CHECK(  MyFn(store_json)(pCtx, pRepo, 2, apBuf[2], aLen[2], apszHid[2])  );
+	VERIFY_ERR_CHECK(  MyFn(train_dbrecords)(pCtx, pRepo, bufId2, sizeof(bufId2))  );
+	VERIFYP_COND("zlibdict(retrained)", (0 != strcmp(bufId1, bufId2)), ("dictionary %s again", bufId1));
+
+	for (set=0; set<3; set++)
+	{
+		VERIFY_ERR_CHECK(  MyFn(verify_blobs)(pCtx, pRepo, "zlibdict(fetch)", apBuf[set], aLen[set], apszHid[set], MyDictCount)  );
+	}
+	VERIFY_ERR_CHECK(  MyFn(verify_encoding)(pCtx, pRepo, "zlibdict(retired)", apszHid[1], MyDictCount, SG_BLOBENCODING__ZLIBDICT)  );
+
+	VERIFY_ERR_CHECK(  MyFn(verify_fragball)(pCtx, pRepo, pPathnameTempDir, apBuf[1], aLen[1], apszHid[1], MyDictCount)  );
+
+fail:
+	if (bSetting)
+	{
+		SG_ERR_IGNORE(  SG_localsettings__reset(pCtx, SG_LOCALSETTING__NEWREPO_INLINE_BLOBS)  );
+	}
+	for (set=0; set<3; set++)
+	{
+		for (k=0; k<MyDictCount; k++)
+		{
+			SG_NULLFREE(pCtx, apBuf[set][k]);
+			SG_NULLFREE(pCtx, apszHid[set][k]);
+		}
+	}
+	SG_REPO_NULLFREE(pCtx, pRepo);
+}
+
+//////////////////////////////////////////////////////////////////
+
 MyMain()
 {
 	SG_repo * pRepo = NULL;
@@ -500,6 +1299,12 @@ MyMain()
 
 	BEGIN_TEST(  MyFn(create_zero_byte_blob)(pCtx, pRepo)  );
 
+	BEGIN_TEST(  MyFn(store_blobs_batch)(pCtx, pRepo)  );
+	BEGIN_TEST(  MyFn(commit_many_records)(pCtx)  );
+	BEGIN_TEST(  MyFn(file_range)(pCtx, pRepo)  );
+	BEGIN_TEST(  MyFn(inline_round_trip)(pCtx, pRepo, pPathnameTempDir)  );
+	BEGIN_TEST(  MyFn(zlibdict)(pCtx, pPathnameTempDir)  );
+
 	//////////////////////////////////////////////////////////////////
 	// TODO delete repo directory and everything we created under it.
 	// TODO delete temp directory and everything we created under it.
@@ -519,3 +1324,8 @@ fail:
 
 #undef MyMaxFile
 #undef MyStepFile
+#undef MyBatchDistinct
+#undef MyBatchCount
+#undef MyRecordCount
+#undef MyInlineCount
+#undef MyDictCount
@@ -163,6 +163,333 @@ fail:
     SG_PATHNAME_NULLFREE(pCtx, pPath);
 }
 
+/* ---------------------------------------------------------------- */
+/* SG_repo__zip() on a changeset whose blobs are stored every which  */
+/* way.  A zlib blob's deflate stream is copied into the zip as-is;   */
+/* anything else is fetched full and deflated.  Entries whose         */
+/* deflated data could pass 8MB are streamed into the zip instead of  */
+/* being built in memory.                                             */
+/* ---------------------------------------------------------------- */
+
+#define U0052_WHO           "testing@sourcegear.com"
+#define U0052_NR_FILES      5
+#define U0052_BIG           (9 * 1024 * 1024)
+
+typedef struct
+{
+    const char *        pszPath;        // name in the zip
+    const char *        pszName;        // name in its treenode
+    SG_blob_encoding    encoding;       // how we store it (FULL would let the repo zlib it)
+    SG_byte *           pBuf;           // full contents
+    SG_uint32           len;
+    char *              pszHid;
+} u0052_file;
+
+static void u0052_zip__random_bytes(SG_byte * pBuf, SG_uint32 len, SG_uint32 seed)
+{
+    SG_uint32 k;
+
+    // deflate can't do anything with these
+    for (k=0; k<len; k++)
+    {
+        seed = seed * 1103515245 + 12345;
+        pBuf[k] = (SG_byte)(seed >> 16);
+    }
+}
+
+static void u0052_zip__text(SG_context * pCtx, const char * pszWhat, SG_uint32 nrLines, SG_uint32 every, SG_byte ** ppBuf, SG_uint32 * pLen)
+{
+    SG_string * pstr = NULL;
+    SG_uint32 k;
+
+    VERIFY_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &pstr)  );
+    for (k=0; k<nrLines; k++)
+    {
+        if (every && (k % every) == 0)
+            VERIFY_ERR_CHECK(  SG_string__append__format(pCtx, pstr, "line %d was changed in %s\n", k, pszWhat)  );
+        else
+            VERIFY_ERR_CHECK(  SG_string__append__format(pCtx, pstr, "line %d of the original text\n", k)  );
+    }
+
+    *pLen = SG_string__length_in_bytes(pstr);
+    VERIFY_ERR_CHECK(  SG_string__sizzle(pCtx, &pstr, ppBuf, NULL)  );
+
+fail:
+    SG_STRING_NULLFREE(pCtx, pstr);
+}
+
+static void u0052_zip__write_file(SG_context * pCtx, const SG_pathname * pPath, const SG_byte * pBuf, SG_uint32 len)
+{
+    SG_file * pFile = NULL;
+
+    VERIFY_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_WRONLY | SG_FILE_CREATE_NEW, 0644, &pFile)  );
+    VERIFY_ERR_CHECK(  SG_file__write(pCtx, pFile, len, pBuf, NULL)  );
+    VERIFY_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+
+fail:
+    SG_FILE_NULLCLOSE(pCtx, pFile);
+}
+
+/**
+ * Store a blob with the encoding we ask for, rather than letting the
+ * repo decide.  pPathEncoded holds the encoded data.
+ */
+static void u0052_zip__store(SG_context * pCtx, SG_committing * pCommitting,
+                             const u0052_file * pf, const char * pszHidRef,
+                             const SG_pathname * pPathEncoded)
+{
+    SG_file * pFile = NULL;
+    SG_uint64 lenEncoded = 0;
+
+    VERIFY_ERR_CHECK(  SG_fsobj__length__pathname(pCtx, pPathEncoded, &lenEncoded, NULL)  );
+    VERIFY_ERR_CHECK(  SG_file__open__pathname(pCtx, pPathEncoded, SG_FILE_RDONLY | SG_FILE_OPEN_EXISTING, SG_FSOBJ_PERMS__UNUSED, &pFile)  );
+    VERIFY_ERR_CHECK(  SG_committing__store_blob_from_file(pCtx, pCommitting, pf->pszHid, pf->encoding, pszHidRef,
+                                                           pFile, lenEncoded, pf->len)  );
+
+fail:
+    SG_FILE_NULLCLOSE(pCtx, pFile);
+}
+
+static void u0052_zip__add_entry(SG_context * pCtx, SG_treenode * pTreenode, SG_treenode_entry_type type,
+                                 const char * pszName, const char * pszHid)
+{
+    SG_treenode_entry * pEntry = NULL;
+    char buf_gid[SG_GID_BUFFER_LENGTH];
+
+    VERIFY_ERR_CHECK(  SG_treenode_entry__alloc(pCtx, &pEntry)  );
+    VERIFY_ERR_CHECK(  SG_treenode_entry__set_entry_type(pCtx, pEntry, type)  );
+    VERIFY_ERR_CHECK(  SG_treenode_entry__set_hid_blob(pCtx, pEntry, pszHid)  );
+    VERIFY_ERR_CHECK(  SG_treenode_entry__set_entry_name(pCtx, pEntry, pszName)  );
+    VERIFY_ERR_CHECK(  SG_treenode_entry__set_attribute_bits(pCtx, pEntry, 0)  );
+    VERIFY_ERR_CHECK(  SG_gid__generate(pCtx, buf_gid, sizeof(buf_gid))  );
+    VERIFY_ERR_CHECK(  SG_treenode__add_entry(pCtx, pTreenode, buf_gid, &pEntry)  );
+
+fail:
+    SG_TREENODE_ENTRY_NULLFREE(pCtx, pEntry);
+}
+
+static void u0052_zip__verify_zip(SG_context * pCtx, const SG_pathname * pPathZip, const u0052_file * aFiles)
+{
+    SG_unzip * punzip = NULL;
+    SG_byte * pBuf = NULL;
+    SG_uint32 count = 0;
+    SG_uint32 k;
+    SG_bool b = SG_FALSE;
+    SG_uint64 iLen = 0;
+
+    VERIFY_ERR_CHECK(  SG_unzip__open(pCtx, pPathZip, &punzip)  );
+
+    VERIFY_ERR_CHECK(  SG_unzip__goto_first_file(pCtx, punzip, &b, NULL, NULL)  );
+    while (b)
+    {
+        count++;
+        VERIFY_ERR_CHECK(  SG_unzip__goto_next_file(pCtx, punzip, &b, NULL, NULL)  );
+    }
+    VERIFYP_COND("count", (count == U0052_NR_FILES), ("count=%d", count));
+
+    for (k=0; k<U0052_NR_FILES; k++)
+    {
+        const u0052_file * pf = &aFiles[k];
+        SG_uint32 total = 0;
+        SG_uint32 got = 0;
+
+        VERIFY_ERR_CHECK(  SG_unzip__locate_file(pCtx, punzip, pf->pszPath, &b, &iLen)  );
+        VERIFYP_COND("locate", b, ("%s is missing", pf->pszPath));
+        if (!b)
+            continue;
+        VERIFYP_COND("len", (iLen == pf->len), ("%s: len=%d expected=%d", pf->pszPath, (SG_uint32)iLen, pf->len));
+
+        // Read it all (and then some, to be sure it ends where it should),
+        // so that closing it checks the CRC.
+        SG_NULLFREE(pCtx, pBuf);
+        VERIFY_ERR_CHECK(  SG_alloc(pCtx, pf->len + 1, 1, &pBuf)  );
+        VERIFY_ERR_CHECK(  SG_unzip__currentfile__open(pCtx, punzip)  );
+        do
+        {
+            VERIFY_ERR_CHECK(  SG_unzip__currentfile__read(pCtx, punzip, pBuf + total,
+                                                           SG_MIN(64 * 1024, pf->len + 1 - total), &got)  );
+            total += got;
+        } while (got > 0 && total <= pf->len);
+        VERIFY_ERR_CHECK(  SG_unzip__currentfile__close(pCtx, punzip)  );
+
+        VERIFYP_COND("read", (total == pf->len), ("%s: read=%d expected=%d", pf->pszPath, total, pf->len));
+        VERIFYP_COND("match", (total == pf->len && 0 == memcmp(pBuf, pf->pBuf, pf->len)), ("%s: contents differ", pf->pszPath));
+    }
+
+fail:
+    SG_ERR_IGNORE(  SG_unzip__nullclose(pCtx, &punzip)  );
+    SG_NULLFREE(pCtx, pBuf);
+}
+
+void u0052_zip__test_repo_zip(SG_context * pCtx)
+{
+    char buf_repo_name[SG_TID_MAX_BUFFER_LENGTH];
+    char buf_tid[SG_TID_MAX_BUFFER_LENGTH];
+    SG_repo * pRepo = NULL;
+    SG_committing * pCommitting = NULL;
+    SG_treenode * pTreenodeSub = NULL;
+    SG_treenode * pTreenodeTop = NULL;
+    SG_treenode * pTreenodeRoot = NULL;
+    SG_rbtree * prbLeaves = NULL;
+    SG_dagnode * pdn = NULL;
+    SG_audit q;
+    SG_pathname * pPathDir = NULL;
+    SG_pathname * pPathFull = NULL;
+    SG_pathname * pPathRef = NULL;
+    SG_pathname * pPathEncoded = NULL;
+    SG_pathname * pPathZip = NULL;
+    SG_byte * pEncoded = NULL;
+    SG_uint32 lenEncoded = 0;
+    char * pszHidSub = NULL;
+    char * pszHidTop = NULL;
+    char * pszHidRoot = NULL;
+    const char * pszParent = NULL;
+    const char * pszCsid = NULL;
+    SG_repo_fetch_blob_handle * pbh = NULL;
+    SG_blob_encoding encoding = 0;
+    SG_uint32 k;
+    u0052_file aFiles[U0052_NR_FILES] =
+    {
+        { "zlib.txt",       "zlib.txt",       SG_BLOBENCODING__ZLIB,           NULL, 0, NULL },
+        { "full.txt",       "full.txt",       SG_BLOBENCODING__KEEPFULLFORNOW, NULL, 0, NULL },
+        { "sub/vcdiff.txt", "vcdiff.txt",     SG_BLOBENCODING__VCDIFF,         NULL, 0, NULL },
+        { "big_zlib.bin",   "big_zlib.bin",   SG_BLOBENCODING__ZLIB,           NULL, 0, NULL },
+        { "big_full.bin",   "big_full.bin",   SG_BLOBENCODING__KEEPFULLFORNOW, NULL, 0, NULL },
+    };
+    u0052_file * pfZlib = &aFiles[0];
+    u0052_file * pfVcdiff = &aFiles[2];
+
+    VERIFY_ERR_CHECK(  SG_tid__generate2(pCtx, buf_repo_name, sizeof(buf_repo_name), 32)  );
+    VERIFY_ERR_CHECK(  SG_vv2__init_new_repo(pCtx, buf_repo_name, NULL, NULL, NULL, SG_TRUE, NULL, SG_FALSE, NULL, NULL)  );
+    VERIFY_ERR_CHECK(  SG_REPO__OPEN_REPO_INSTANCE(pCtx, buf_repo_name, &pRepo)  );
+    VERIFY_ERR_CHECK(  SG_user__create(pCtx, pRepo, U0052_WHO, NULL)  );
+    VERIFY_ERR_CHECK(  SG_user__set_user__repo(pCtx, pRepo, U0052_WHO)  );
+
+    VERIFY_ERR_CHECK(  SG_tid__generate2(pCtx, buf_tid, sizeof(buf_tid), 32)  );
+    VERIFY_ERR_CHECK(  SG_PATHNAME__ALLOC__SZ(pCtx, &pPathDir, buf_tid)  );
+    VERIFY_ERR_CHECK(  SG_fsobj__mkdir__pathname(pCtx, pPathDir)  );
+
+    // The contents.  The vcdiff one is every 37th line different from the
+    // zlib one.
+    VERIFY_ERR_CHECK(  u0052_zip__text(pCtx, NULL, 20000, 0, &pfZlib->pBuf, &pfZlib->len)  );
+    VERIFY_ERR_CHECK(  u0052_zip__text(pCtx, "full", 5, 2, &aFiles[1].pBuf, &aFiles[1].len)  );
+    VERIFY_ERR_CHECK(  u0052_zip__text(pCtx, "vcdiff", 20000, 37, &pfVcdiff->pBuf, &pfVcdiff->len)  );
+    for (k=3; k<U0052_NR_FILES; k++)
+    {
+        aFiles[k].len = U0052_BIG;
+        VERIFY_ERR_CHECK(  SG_alloc(pCtx, aFiles[k].len, 1, &aFiles[k].pBuf)  );
+        u0052_zip__random_bytes(aFiles[k].pBuf, aFiles[k].len, k);
+    }
+    for (k=0; k<U0052_NR_FILES; k++)
+        VERIFY_ERR_CHECK(  SG_repo__alloc_compute_hash__from_bytes(pCtx, pRepo, aFiles[k].len, aFiles[k].pBuf, &aFiles[k].pszHid)  );
+
+    VERIFY_ERR_CHECK(  SG_repo__fetch_dag_leaves(pCtx, pRepo, SG_DAGNUM__VERSION_CONTROL, &prbLeaves)  );
+    VERIFY_ERR_CHECK(  SG_rbtree__get_only_entry(pCtx, prbLeaves, &pszParent, NULL)  );
+
+    VERIFY_ERR_CHECK(  SG_audit__init(pCtx, &q, pRepo, SG_AUDIT__WHEN__NOW, SG_AUDIT__WHO__FROM_SETTINGS)  );
+    VERIFY_ERR_CHECK(  SG_committing__alloc(pCtx, &pCommitting, pRepo, SG_DAGNUM__VERSION_CONTROL, &q, SG_CSET_VERSION_1)  );
+    VERIFY_ERR_CHECK(  SG_committing__add_parent(pCtx, pCommitting, pszParent)  );
+
+    for (k=0; k<U0052_NR_FILES; k++)
+    {
+        u0052_file * pf = &aFiles[k];
+        const char * pszHidRef = NULL;
+        char buf_name[64];
+
+        SG_PATHNAME_NULLFREE(pCtx, pPathFull);
+        SG_PATHNAME_NULLFREE(pCtx, pPathEncoded);
+        VERIFY_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathFull, pPathDir, pf->pszName)  );
+        VERIFY_ERR_CHECK(  SG_sprintf(pCtx, buf_name, sizeof(buf_name), "%s.encoded", pf->pszName)  );
+        VERIFY_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathEncoded, pPathDir, buf_name)  );
+
+        if (pf->encoding == SG_BLOBENCODING__KEEPFULLFORNOW)
+        {
+            VERIFY_ERR_CHECK(  u0052_zip__write_file(pCtx, pPathEncoded, pf->pBuf, pf->len)  );
+        }
+        else if (pf->encoding == SG_BLOBENCODING__ZLIB)
+        {
+            SG_NULLFREE(pCtx, pEncoded);
+            VERIFY_ERR_CHECK(  SG_zlib__deflate__memory(pCtx, pf->pBuf, pf->len, &pEncoded, &lenEncoded)  );
+            VERIFY_ERR_CHECK(  u0052_zip__write_file(pCtx, pPathEncoded, pEncoded, lenEncoded)  );
+        }
+        else
+        {
+            VERIFY_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathRef, pPathDir, "reference")  );
+            VERIFY_ERR_CHECK(  u0052_zip__write_file(pCtx, pPathRef, pfZlib->pBuf, pfZlib->len)  );
+            VERIFY_ERR_CHECK(  u0052_zip__write_file(pCtx, pPathFull, pf->pBuf, pf->len)  );
+            VERIFY_ERR_CHECK(  SG_vcdiff__deltify__files(pCtx, pPathRef, pPathFull, pPathEncoded)  );
+            pszHidRef = pfZlib->pszHid;
+        }
+
+        VERIFY_ERR_CHECK(  u0052_zip__store(pCtx, pCommitting, pf, pszHidRef, pPathEncoded)  );
+    }
+
+    // The tree: a super-root with "@", which has everything but the
+    // vcdiff file, which is in "sub".
+    VERIFY_ERR_CHECK(  SG_treenode__alloc(pCtx, &pTreenodeSub)  );
+    VERIFY_ERR_CHECK(  SG_treenode__set_version(pCtx, pTreenodeSub, SG_TN_VERSION_1)  );
+    VERIFY_ERR_CHECK(  u0052_zip__add_entry(pCtx, pTreenodeSub, SG_TREENODEENTRY_TYPE_REGULAR_FILE, pfVcdiff->pszName, pfVcdiff->pszHid)  );
+    VERIFY_ERR_CHECK(  SG_committing__tree__add_treenode(pCtx, pCommitting, &pTreenodeSub, &pszHidSub)  );
+
+    VERIFY_ERR_CHECK(  SG_treenode__alloc(pCtx, &pTreenodeTop)  );
+    VERIFY_ERR_CHECK(  SG_treenode__set_version(pCtx, pTreenodeTop, SG_TN_VERSION_1)  );
+    for (k=0; k<U0052_NR_FILES; k++)
+        if (&aFiles[k] != pfVcdiff)
+            VERIFY_ERR_CHECK(  u0052_zip__add_entry(pCtx, pTreenodeTop, SG_TREENODEENTRY_TYPE_REGULAR_FILE, aFiles[k].pszName, aFiles[k].pszHid)  );
+    VERIFY_ERR_CHECK(  u0052_zip__add_entry(pCtx, pTreenodeTop, SG_TREENODEENTRY_TYPE_DIRECTORY, "sub", pszHidSub)  );
+    VERIFY_ERR_CHECK(  SG_committing__tree__add_treenode(pCtx, pCommitting, &pTreenodeTop, &pszHidTop)  );
+
+    VERIFY_ERR_CHECK(  SG_treenode__alloc(pCtx, &pTreenodeRoot)  );
+    VERIFY_ERR_CHECK(  SG_treenode__set_version(pCtx, pTreenodeRoot, SG_TN_VERSION_1)  );
+    VERIFY_ERR_CHECK(  u0052_zip__add_entry(pCtx, pTreenodeRoot, SG_TREENODEENTRY_TYPE_DIRECTORY, "@", pszHidTop)  );
+    VERIFY_ERR_CHECK(  SG_committing__tree__add_treenode(pCtx, pCommitting, &pTreenodeRoot, &pszHidRoot)  );
+    VERIFY_ERR_CHECK(  SG_committing__tree__set_root(pCtx, pCommitting, pszHidRoot)  );
+
+    VERIFY_ERR_CHECK(  SG_committing__end(pCtx, pCommitting, NULL, &pdn)  );
+    pCommitting = NULL;
+    VERIFY_ERR_CHECK(  SG_dagnode__get_id_ref(pCtx, pdn, &pszCsid)  );
+
+    // Make sure the repo kept each blob the way we stored it, or we
+    // aren't testing what we think we are.
+    for (k=0; k<U0052_NR_FILES; k++)
+    {
+        VERIFY_ERR_CHECK(  SG_repo__fetch_blob__begin(pCtx, pRepo, aFiles[k].pszHid, SG_FALSE, &encoding, NULL, NULL, NULL, &pbh)  );
+        VERIFY_ERR_CHECK(  SG_repo__fetch_blob__abort(pCtx, pRepo, &pbh)  );
+        VERIFYP_COND("encoding", (SG_IS_BLOBENCODING_FULL(encoding) ? SG_IS_BLOBENCODING_FULL(aFiles[k].encoding) : (encoding == aFiles[k].encoding)),
+                     ("%s: encoding=%d expected=%d", aFiles[k].pszPath, (int)encoding, (int)aFiles[k].encoding));
+    }
+
+    VERIFY_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPathZip, pPathDir, "out.zip")  );
+    VERIFY_ERR_CHECK(  SG_repo__zip(pCtx, pRepo, pszCsid, SG_pathname__sz(pPathZip))  );
+    VERIFY_ERR_CHECK(  u0052_zip__verify_zip(pCtx, pPathZip, aFiles)  );
+
+fail:
+    if (pCommitting)
+        SG_ERR_IGNORE(  SG_committing__abort(pCtx, pCommitting)  );
+    if (pbh)
+        SG_ERR_IGNORE(  SG_repo__fetch_blob__abort(pCtx, pRepo, &pbh)  );
+    for (k=0; k<U0052_NR_FILES; k++)
+    {
+        SG_NULLFREE(pCtx, aFiles[k].pBuf);
+        SG_NULLFREE(pCtx, aFiles[k].pszHid);
+    }
+    SG_NULLFREE(pCtx, pEncoded);
+    SG_NULLFREE(pCtx, pszHidSub);
+    SG_NULLFREE(pCtx, pszHidTop);
+    SG_NULLFREE(pCtx, pszHidRoot);
+    SG_TREENODE_NULLFREE(pCtx, pTreenodeSub);
+    SG_TREENODE_NULLFREE(pCtx, pTreenodeTop);
+    SG_TREENODE_NULLFREE(pCtx, pTreenodeRoot);
+    SG_DAGNODE_NULLFREE(pCtx, pdn);
+    SG_RBTREE_NULLFREE(pCtx, prbLeaves);
+    SG_PATHNAME_NULLFREE(pCtx, pPathFull);
+    SG_PATHNAME_NULLFREE(pCtx, pPathRef);
+    SG_PATHNAME_NULLFREE(pCtx, pPathEncoded);
+    SG_PATHNAME_NULLFREE(pCtx, pPathZip);
+    SG_PATHNAME_NULLFREE(pCtx, pPathDir);
+    SG_REPO_NULLFREE(pCtx, pRepo);
+}
+
 TEST_MAIN(u0052_zip)
 {
 	TEMPLATE_MAIN_START;
@@ -171,5 +498,7 @@ TEST_MAIN(u0052_zip)
 
 	BEGIN_TEST(  u0052_zip__test_2(pCtx)  );
 
+	BEGIN_TEST(  u0052_zip__test_repo_zip(pCtx)  );
+
 	TEMPLATE_MAIN_END;
 }
@@ -681,11 +681,11 @@ void MyFn(test__gen_hints__off_by_one__unknown_leaf_in_dest)(SG_context* pCtx)
 		SG_uint32 count;
 		VERIFY_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhStats, SG_SYNC_STATUS_KEY__DAGS, &pvhRefDags)  );
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhRefDags, SG_DAGNUM__TESTING__NOTHING_SZ, &count)  );
-		// The generation hint failed because of the unknown leaf. We had to walk all the way to root.
-		VERIFY_COND("dagnodes touched", count == 10); 
+		// The unknown leaf in dest doesn't matter: its have-set still has the common leaf.
+		VERIFY_COND("dagnodes touched", count == 6); 
 
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__ROUNDTRIPS, &count)  );
-		VERIFY_COND("roundtrips", count == MIN_PUSH_ROUNDTRIPS + 1);
+		VERIFY_COND("roundtrips", count == MIN_PUSH_ROUNDTRIPS);
 
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__BLOBS_REFERENCED, &count)  );
 		VERIFY_COND("blobs referenced", count == 5); // all the new nodes
@@ -743,12 +743,10 @@ void MyFn(test__gen_hints__negative__unknown_leaf_in_dest)(SG_context* pCtx)
 		SG_uint32 count;
 		VERIFY_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhStats, SG_SYNC_STATUS_KEY__DAGS, &pvhRefDags)  );
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhRefDags, SG_DAGNUM__TESTING__NOTHING_SZ, &count)  );
-		// The generation hint failed because of the unknown line. We had to walk all the way to root.
-		VERIFY_COND("dagnodes touched", count == 10); 
+		// The unknown line in dest doesn't matter: its have-set still has the common leaf.
+		VERIFY_COND("dagnodes touched", count == 6); 
 
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__ROUNDTRIPS, &count)  );
-		// The gen hint on first roundtrip was known to bad because it was negative, so the fallback 
-		// goes all the way to root and we get it done in one shot.
 		VERIFY_COND("roundtrips", count == MIN_PUSH_ROUNDTRIPS);
 
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__BLOBS_REFERENCED, &count)  );
@@ -882,13 +880,12 @@ void MyFn(test__gen_hints__uneven_leaves_and_off_by_two_gen_hint)(SG_context* pC
 		SG_uint32 count;
 		VERIFY_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhStats, SG_SYNC_STATUS_KEY__DAGS, &pvhRefDags)  );
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhRefDags, SG_DAGNUM__TESTING__NOTHING_SZ, &count)  );
-		// Slightly off gen hint means we'll walk all the way to root.
-		// This should be all the nodes in the src repo.
+		// All the new nodes plus the common leaf, which is also the root.
 		VERIFY_COND("dagnodes touched", count == 15); 
 
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__ROUNDTRIPS, &count)  );
-		// Slightly off gen hint means one extra roundtrip.
-		VERIFY_COND("roundtrips", count == MIN_PUSH_ROUNDTRIPS + 1); 
+		// The unknown leaf in dest no longer throws anything off.
+		VERIFY_COND("roundtrips", count == MIN_PUSH_ROUNDTRIPS); 
 
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__BLOBS_REFERENCED, &count)  );
 		VERIFY_COND("blobs referenced", count == 14); // all the new nodes
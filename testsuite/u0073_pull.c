@@ -29,7 +29,8 @@ limitations under the License.
 #define MyDcl(name)				u0073_pull__##name
 #define MyFn(name)				u0073_pull__##name
 
-#define MIN_PULL_ROUNDTRIPS 4
+/* repo info, dagnodes (connected in one go by the have-sets), blobs */
+#define MIN_PULL_ROUNDTRIPS 3
 
 void MyFn(create_file__numbers)(
 	SG_context* pCtx,
@@ -615,11 +616,11 @@ void MyFn(test__gen_hints__off_by_one__unknown_leaf_in_dest)(SG_context* pCtx)
 		SG_uint32 count;
 		VERIFY_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhStats, SG_SYNC_STATUS_KEY__DAGS, &pvhRefDags)  );
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhRefDags, SG_DAGNUM__TESTING__NOTHING_SZ, &count)  );
-		// The generation hint failed because of the unknown leaf. We had to walk all the way to root.
-		VERIFY_COND("dagnodes touched", count == 10); 
+		// The unknown leaf in dest doesn't matter: its have-set still has the common leaf.
+		VERIFY_COND("dagnodes touched", count == 6); 
 
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__ROUNDTRIPS, &count)  );
-		VERIFY_COND("roundtrips", count == MIN_PULL_ROUNDTRIPS + 1);
+		VERIFY_COND("roundtrips", count == MIN_PULL_ROUNDTRIPS);
 
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__BLOBS_REFERENCED, &count)  );
 		VERIFY_COND("blobs referenced", count == 5); // all the new nodes
@@ -679,12 +680,10 @@ void MyFn(test__gen_hints__negative__unknown_leaf_in_dest)(SG_context* pCtx)
 		SG_uint32 count;
 		VERIFY_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhStats, SG_SYNC_STATUS_KEY__DAGS, &pvhRefDags)  );
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhRefDags, SG_DAGNUM__TESTING__NOTHING_SZ, &count)  );
-		// The generation hint failed because of the unknown leaf. We had to walk all the way to root.
-		VERIFY_COND("dagnodes touched", count == 10); 
+		// The unknown leaf in dest doesn't matter: its have-set still has the common leaf.
+		VERIFY_COND("dagnodes touched", count == 6); 
 
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__ROUNDTRIPS, &count)  );
-		// The gen hint on first roundtrip was known to bad because it was negative, so the fallback 
-		// goes all the way to root and we get it done in one shot.
 		VERIFY_COND("roundtrips", count == MIN_PULL_ROUNDTRIPS); 
 
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__BLOBS_REFERENCED, &count)  );
@@ -826,13 +825,12 @@ void MyFn(test__gen_hints__uneven_leaves_and_off_by_two_gen_hint)(SG_context* pC
 		SG_uint32 count;
 		VERIFY_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhStats, SG_SYNC_STATUS_KEY__DAGS, &pvhRefDags)  );
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhRefDags, SG_DAGNUM__TESTING__NOTHING_SZ, &count)  );
-		// Slightly off gen hint means we'll walk all the way to root.
-		// This should be all the nodes in the src repo.
+		// All the new nodes plus the common leaf, which is also the root.
 		VERIFY_COND("dagnodes touched", count == 15); 
 
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__ROUNDTRIPS, &count)  );
-		// Slightly off gen hint means one extra roundtrip.
-		VERIFY_COND("roundtrips", count == MIN_PULL_ROUNDTRIPS + 1); 
+		// The unknown leaf in dest no longer throws anything off.
+		VERIFY_COND("roundtrips", count == MIN_PULL_ROUNDTRIPS); 
 
 		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__BLOBS_REFERENCED, &count)  );
 		VERIFY_COND("blobs referenced", count == 14); // all the new nodes
@@ -852,6 +850,253 @@ fail:
 		SG_ERR_IGNORE(  SG_pull__abort(pCtx, &pPull)  );
 }
 
+/* Deeper than the generations a have-set covers (see sg_sync.c). */
+#define HAVE_SET_DEPTH 1000
+
+void MyFn(test__have_set__diverged_below_floor)(SG_context* pCtx)
+{
+	SG_repo* pRepoSrc = NULL;
+	SG_repo* pRepoDest = NULL; 
+	char* pszHidCommonLeaf = NULL;
+	char* pszHidSrcLeaf = NULL;
+	char* pszHidDestLeaf = NULL;
+	SG_rbtree* prbLeaves = NULL;
+	SG_vhash* pvhStats = NULL;
+
+	const char* pszRefSrcName = NULL;
+
+	VERIFY_ERR_CHECK(  _create_new_repo(pCtx, &pRepoSrc)  );
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepoSrc, NULL, 1, &pszHidCommonLeaf)  );
+
+	VERIFY_ERR_CHECK(  _clone(pCtx, pRepoSrc, &pRepoDest)  );
+
+	// Dest goes on long enough that the common leaf is below the floor of
+	// its have-set, so the filter can't help src find it.
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepoDest, pszHidCommonLeaf, HAVE_SET_DEPTH + 10, &pszHidDestLeaf)  );
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepoSrc, pszHidCommonLeaf, 20, &pszHidSrcLeaf)  );
+
+	VERIFY_ERR_CHECK(  SG_repo__get_descriptor_name(pCtx, pRepoSrc, &pszRefSrcName)  );
+	VERIFY_ERR_CHECK(  SG_pull__all(pCtx, pRepoDest, pszRefSrcName, NULL, NULL, NULL, &pvhStats)  );
+
+#ifdef DEBUG
+	VERIFY_ERR_CHECK(  SG_vhash_debug__dump_to_console__named(pCtx, pvhStats, "pull stats")  );
+#endif
+
+	/* Verify stats */
+	{
+		SG_uint32 count;
+
+		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__ROUNDTRIPS, &count)  );
+		// Below the floor src falls back to a best guess, which reaches the
+		// common leaf in one go instead of a generation per roundtrip.
+		// Dest's filter is big enough to give the odd false positive, and
+		// each of those costs a roundtrip.
+		VERIFYP_COND("roundtrips", (count < MIN_PULL_ROUNDTRIPS + 4), ("roundtrips: %u", count)); 
+
+		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__BLOBS_REFERENCED, &count)  );
+		VERIFY_COND("blobs referenced", count == 20); // all the new nodes
+
+		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__BLOBS_PRESENT, &count)  );
+		VERIFY_COND("blobs present", count == 20); // all the new nodes
+	}
+
+	/* Dest should now have both lines. */
+	{
+		SG_uint32 count;
+		SG_bool b;
+
+		VERIFY_ERR_CHECK(  SG_repo__fetch_dag_leaves(pCtx, pRepoDest, SG_DAGNUM__TESTING__NOTHING, &prbLeaves)  );
+		VERIFY_ERR_CHECK(  SG_rbtree__count(pCtx, prbLeaves, &count)  );
+		VERIFY_COND("leaf count", count == 2);
+		VERIFY_ERR_CHECK(  SG_rbtree__find(pCtx, prbLeaves, pszHidSrcLeaf, &b, NULL)  );
+		VERIFY_COND("src leaf", b);
+		VERIFY_ERR_CHECK(  SG_rbtree__find(pCtx, prbLeaves, pszHidDestLeaf, &b, NULL)  );
+		VERIFY_COND("dest leaf", b);
+	}
+
+	/* Common cleanup */
+fail:
+	SG_REPO_NULLFREE(pCtx, pRepoSrc);
+	SG_REPO_NULLFREE(pCtx, pRepoDest);
+	SG_NULLFREE(pCtx, pszHidCommonLeaf);
+	SG_NULLFREE(pCtx, pszHidSrcLeaf);
+	SG_NULLFREE(pCtx, pszHidDestLeaf);
+	SG_RBTREE_NULLFREE(pCtx, prbLeaves);
+	SG_VHASH_NULLFREE(pCtx, pvhStats);
+}
+
+//////////////////////////////////////////////////////////////////
+
+/* Enough blobs that pull has to ask for them in several pipelined
+ * requests (it asks for 2500 at a time; see sg_pull.c). */
+#define PIPELINED_BLOBS 5100
+
+/* A parentless changeset with this content as its root has the HID
+ * DEBUG_PULL_FAILURE__HID in sg_pull.c.  Pull fails any blob request
+ * which asks for it. */
+#define DEBUG_PULL_FAILURE__CONTENT "u0073_pull: fail this blob request"
+#define DEBUG_PULL_FAILURE__HID     "73387ec539bc01cc0173e844a758580beaa955bc"
+
+static void MyFn(commit_dagnode__content)(
+	SG_context* pCtx,
+	SG_repo* pRepo,
+	const char* pszHidParent,
+	const char* pszContent,
+	char** ppszHid)
+{
+	SG_committing* pCommit = NULL;
+	SG_audit pq;
+	SG_dagnode* pdn = NULL;
+	char* pszHidBlob = NULL;
+	const char* pszRefHid = NULL;
+
+	VERIFY_ERR_CHECK(  SG_audit__init(pCtx, &pq, pRepo, SG_AUDIT__WHEN__NOW, WHO)  );
+	VERIFY_ERR_CHECK(  SG_committing__alloc(pCtx, &pCommit, pRepo, SG_DAGNUM__TESTING__NOTHING,
+		&pq, SG_CSET_VERSION__CURRENT)  );
+	if (pszHidParent)
+		VERIFY_ERR_CHECK(  SG_committing__add_parent(pCtx, pCommit, pszHidParent)  );
+	VERIFY_ERR_CHECK(  SG_committing__add_bytes__buflen(pCtx, pCommit,
+		(const SG_byte*)pszContent, SG_STRLEN(pszContent), SG_FALSE, &pszHidBlob)  );
+	VERIFY_ERR_CHECK(  SG_committing__tree__set_root(pCtx, pCommit, pszHidBlob)  );
+	VERIFY_ERR_CHECK(  SG_committing__end(pCtx, pCommit, NULL, &pdn)  );
+	pCommit = NULL;
+
+	VERIFY_ERR_CHECK(  SG_dagnode__get_id_ref(pCtx, pdn, &pszRefHid)  );
+	VERIFY_ERR_CHECK(  SG_STRDUP(pCtx, pszRefHid, ppszHid)  );
+
+fail:
+	SG_NULLFREE(pCtx, pszHidBlob);
+	SG_DAGNODE_NULLFREE(pCtx, pdn);
+	if (pCommit)
+		SG_ERR_IGNORE(  SG_committing__abort(pCtx, pCommit)  );
+}
+
+static void MyFn(verify_only_leaf)(
+	SG_context* pCtx,
+	SG_repo* pRepo,
+	const char* pszHidLeaf,
+	const char* pszLabel)
+{
+	SG_rbtree* prbLeaves = NULL;
+	SG_uint32 count = 0;
+	SG_bool bFound = SG_FALSE;
+
+	VERIFY_ERR_CHECK(  SG_repo__fetch_dag_leaves(pCtx, pRepo, SG_DAGNUM__TESTING__NOTHING, &prbLeaves)  );
+	VERIFY_ERR_CHECK(  SG_rbtree__count(pCtx, prbLeaves, &count)  );
+	VERIFY_ERR_CHECK(  SG_rbtree__find(pCtx, prbLeaves, pszHidLeaf, &bFound, NULL)  );
+	VERIFYP_COND(pszLabel, (count == 1 && bFound), ("%s: %d leaves, expected leaf %s", pszLabel, count, (bFound ? "found" : "not found")));
+
+fail:
+	SG_RBTREE_NULLFREE(pCtx, prbLeaves);
+}
+
+/* A log handler that cancels the pull as soon as it has finished
+ * slurping the first batch of blobs. */
+static void MyFn(cancel_blobs__operation)(
+	SG_context* pCtx,
+	void* pThis,
+	const SG_log__operation* pOperation,
+	SG_log__operation_change eChange,
+	SG_bool* pCancel)
+{
+	SG_uint32* pCountCancels = (SG_uint32*)pThis;
+	const char* pszDescription = NULL;
+
+	if (eChange != SG_LOG__OPERATION__STEPS_FINISHED)
+		return;
+
+	SG_ERR_CHECK_RETURN(  SG_log__operation__get_basic(pCtx, pOperation, &pszDescription, NULL, NULL)  );
+	if (pszDescription && (strcmp(pszDescription, "Downloading blobs") == 0))
+	{
+		*pCancel = SG_TRUE;
+		(*pCountCancels)++;
+	}
+}
+
+static SG_log__handler MyDcl(cancel_blobs_handler) =
+{
+	NULL,
+	MyFn(cancel_blobs__operation),
+	NULL,
+	NULL,
+	NULL
+};
+
+void MyFn(test__pipelined_blobs)(SG_context* pCtx)
+{
+	SG_repo* pRepoSrc = NULL;
+	SG_repo* pRepoDest = NULL;
+	char* pszHidBase = NULL;
+	char* pszHidLeaf = NULL;
+	SG_vhash* pvhStats = NULL;
+	const char* pszRefSrcName = NULL;
+	SG_uint32 countCancels = 0;
+	SG_bool bRegistered = SG_FALSE;
+#if defined(DEBUG)
+	char* pszHidFail = NULL;
+#endif
+
+	VERIFY_ERR_CHECK(  _create_new_repo(pCtx, &pRepoSrc)  );
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepoSrc, NULL, 1, &pszHidBase)  );
+	VERIFY_ERR_CHECK(  _clone(pCtx, pRepoSrc, &pRepoDest)  );
+
+	/* Each dagnode in the testing dag has its own blob. */
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepoSrc, pszHidBase, PIPELINED_BLOBS, &pszHidLeaf)  );
+	VERIFY_ERR_CHECK(  SG_repo__get_descriptor_name(pCtx, pRepoSrc, &pszRefSrcName)  );
+
+	/* Cancel after the first batch, while the others are still downloading.
+	 * Nothing should have been committed. */
+	VERIFY_ERR_CHECK(  SG_log__register_handler(pCtx, &MyDcl(cancel_blobs_handler), &countCancels, NULL, SG_LOG__FLAG__HANDLER_TYPE__ALL)  );
+	bRegistered = SG_TRUE;
+	VERIFY_ERR_CHECK_ERR_EQUALS_DISCARD(  SG_pull__all(pCtx, pRepoDest, pszRefSrcName, NULL, NULL, NULL, NULL), SG_ERR_CANCEL  );
+	VERIFY_ERR_CHECK(  SG_log__unregister_handler(pCtx, &MyDcl(cancel_blobs_handler), &countCancels)  );
+	bRegistered = SG_FALSE;
+	VERIFY_COND("cancelled once", (countCancels == 1));
+	VERIFY_ERR_CHECK(  MyFn(verify_only_leaf)(pCtx, pRepoDest, pszHidBase, "after cancel")  );
+
+	/* Now let it finish. */
+	VERIFY_ERR_CHECK(  SG_pull__all(pCtx, pRepoDest, pszRefSrcName, NULL, NULL, NULL, &pvhStats)  );
+	VERIFY_ERR_CHECK(  MyFn(verify_only_leaf)(pCtx, pRepoDest, pszHidLeaf, "after pull")  );
+	{
+		SG_uint32 count;
+
+		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__BLOBS_REFERENCED, &count)  );
+		VERIFY_COND("blobs referenced", count == PIPELINED_BLOBS);
+
+		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__BLOBS_PRESENT, &count)  );
+		VERIFY_COND("blobs present", count == PIPELINED_BLOBS);
+
+		// One extra roundtrip for each batch after the first.
+		VERIFY_ERR_CHECK(  SG_vhash__get__uint32(pCtx, pvhStats, SG_SYNC_STATUS_KEY__ROUNDTRIPS, &count)  );
+		VERIFY_COND("roundtrips", count >= MIN_PULL_ROUNDTRIPS + 2);
+	}
+
+#if defined(DEBUG)
+	/* Make one of the pipelined requests fail on its own thread.
+	 * The error should come back to us and nothing should be committed. */
+	VERIFY_ERR_CHECK(  MyFn(commit_dagnode__content)(pCtx, pRepoSrc, NULL, DEBUG_PULL_FAILURE__CONTENT, &pszHidFail)  );
+	VERIFYP_COND("failure changeset", (strcmp(pszHidFail, DEBUG_PULL_FAILURE__HID) == 0),
+		("HID of the failure changeset is %s; sg_pull.c expects %s", pszHidFail, DEBUG_PULL_FAILURE__HID));
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepoSrc, pszHidFail, PIPELINED_BLOBS, NULL)  );
+
+	VERIFY_ERR_CHECK_ERR_EQUALS_DISCARD(  SG_pull__all(pCtx, pRepoDest, pszRefSrcName, NULL, NULL, NULL, NULL), SG_ERR_DEBUG_1  );
+	VERIFY_ERR_CHECK(  MyFn(verify_only_leaf)(pCtx, pRepoDest, pszHidLeaf, "after failed pull")  );
+#endif
+
+	/* Common cleanup */
+fail:
+	if (bRegistered)
+		SG_ERR_IGNORE(  SG_log__unregister_handler(pCtx, &MyDcl(cancel_blobs_handler), &countCancels)  );
+	SG_REPO_NULLFREE(pCtx, pRepoSrc);
+	SG_REPO_NULLFREE(pCtx, pRepoDest);
+	SG_NULLFREE(pCtx, pszHidBase);
+	SG_NULLFREE(pCtx, pszHidLeaf);
+	SG_VHASH_NULLFREE(pCtx, pvhStats);
+#if defined(DEBUG)
+	SG_NULLFREE(pCtx, pszHidFail);
+#endif
+}
+
 MyMain()
 {
 	TEMPLATE_MAIN_START;
@@ -861,6 +1106,9 @@ MyMain()
 	VERIFY_ERR_CHECK(  MyFn(test__gen_hints__negative__unknown_leaf_in_dest)(pCtx)  );
 	VERIFY_ERR_CHECK(  MyFn(test__gen_hints__perfectly_even_leaves)(pCtx)  );
 	VERIFY_ERR_CHECK(  MyFn(test__gen_hints__uneven_leaves_and_off_by_two_gen_hint)(pCtx)  );
+	VERIFY_ERR_CHECK(  MyFn(test__have_set__diverged_below_floor)(pCtx)  );
+
+	VERIFY_ERR_CHECK(  MyFn(test__pipelined_blobs)(pCtx)  );
 
 	VERIFY_ERR_CHECK(  MyFn(test__vc__simple)(pCtx)  );
 
@@ -2465,6 +2465,546 @@ fail:
 }
 
 
+/*
+**
+** Worker Pool
+**
+*/
+
+/**
+ * Number of blobs in the generated stream.
+ * Enough to wrap the importer's job queue a couple of times.
+ */
+#define U0111__POOL__BLOBS 600u
+
+/**
+ * Blob that is too big to be queued, so it is stored while other blobs are still queued.
+ */
+#define U0111__POOL__BIG_BLOB 250u
+#define U0111__POOL__BIG_SIZE (17u * 1024u * 1024u)
+
+/**
+ * Mark numbers of the two commits in the generated stream.
+ */
+#define U0111__POOL__COMMIT_1 1001u
+#define U0111__POOL__COMMIT_2 1002u
+
+/**
+ * Builds the contents of one generated blob.
+ */
+static void u0111__pool__blob(
+	SG_context* pCtx,     //< [in] [out] Error and context info.
+	SG_uint32   uBlob,    //< [in] Which blob to build.
+	SG_uint32   uVersion, //< [in] Which version of the blob to build.
+	SG_string*  sContent  //< [in] [out] Receives the contents.
+	)
+{
+	SG_uint32 uLines = 0u;
+	SG_uint32 uLine  = 0u;
+
+	SG_ERR_CHECK(  SG_string__clear(pCtx, sContent)  );
+
+	if (uBlob == 0u)
+	{
+		// empty
+	}
+	else if (uBlob == U0111__POOL__BIG_BLOB)
+	{
+		while (SG_string__length_in_bytes(sContent) < U0111__POOL__BIG_SIZE)
+		{
+			SG_ERR_CHECK(  SG_string__append__format(pCtx, sContent, "big blob version %u line %u\n", uVersion, uLine++)  );
+		}
+	}
+	else if ((uBlob % 7u) == 3u && uVersion == 0u)
+	{
+		// lots of blobs with the same contents
+		SG_ERR_CHECK(  SG_string__append__sz(pCtx, sContent, "shared contents\n")  );
+	}
+	else
+	{
+		uLines = 1u + ((uBlob * 37u) % 2000u);
+		for (uLine = 0u; uLine < uLines; ++uLine)
+		{
+			SG_ERR_CHECK(  SG_string__append__format(pCtx, sContent, "blob %u version %u line %u\n", uBlob, uVersion, uLine)  );
+		}
+	}
+
+fail:
+	return;
+}
+
+/**
+ * Gets the version of a blob that a commit in the generated stream should contain.
+ */
+static SG_uint32 u0111__pool__version(
+	SG_uint32 uBlob,  //< [in] Which blob to check.
+	SG_uint32 uCommit //< [in] The mark of the commit to check.
+	)
+{
+	if (uCommit == U0111__POOL__COMMIT_2 && (uBlob % 10u) == 1u)
+	{
+		return 2u;
+	}
+	return 0u;
+}
+
+/**
+ * Writes one blob command to a fast-import stream.
+ */
+static void u0111__pool__write_blob(
+	SG_context* pCtx,     //< [in] [out] Error and context info.
+	SG_file*    pFile,    //< [in] The stream to write to.
+	SG_uint32   uMark,    //< [in] The mark to give the blob.
+	SG_uint32   uBlob,    //< [in] Which blob to write.
+	SG_uint32   uVersion, //< [in] Which version of the blob to write.
+	SG_string*  sContent  //< [in] Scratch space.
+	)
+{
+	char szHeader[64];
+
+	SG_ERR_CHECK(  u0111__pool__blob(pCtx, uBlob, uVersion, sContent)  );
+	SG_ERR_CHECK(  SG_sprintf(pCtx, szHeader, sizeof(szHeader), "blob\nmark :%u\ndata %u\n", uMark, SG_string__length_in_bytes(sContent))  );
+	SG_ERR_CHECK(  SG_file__write__sz(pCtx, pFile, szHeader)  );
+	SG_ERR_CHECK(  SG_file__write__string(pCtx, pFile, sContent)  );
+	SG_ERR_CHECK(  SG_file__write__sz(pCtx, pFile, "\n")  );
+
+fail:
+	return;
+}
+
+/**
+ * Writes a fast-import stream with lots of blobs, some of them duplicates,
+ * and one too big to be queued.
+ */
+static void u0111__pool__write_stream(
+	SG_context*        pCtx, //< [in] [out] Error and context info.
+	const SG_pathname* pPath //< [in] The file to write.
+	)
+{
+	SG_file*   pFile    = NULL;
+	SG_string* sContent = NULL;
+	SG_uint32  uBlob    = 0u;
+
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &sContent)  );
+	SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_WRONLY | SG_FILE_CREATE_NEW, 0644, &pFile)  );
+
+	for (uBlob = 0u; uBlob < U0111__POOL__BLOBS; ++uBlob)
+	{
+		SG_ERR_CHECK(  u0111__pool__write_blob(pCtx, pFile, uBlob + 1u, uBlob, 0u, sContent)  );
+	}
+
+	SG_ERR_CHECK(  SG_string__sprintf(pCtx, sContent, "commit refs/heads/master\nmark :%u\ncommitter <test@sourcegear.com> 1342803195 +0000\ndata 5\nfirst\n", U0111__POOL__COMMIT_1)  );
+	for (uBlob = 0u; uBlob < U0111__POOL__BLOBS; ++uBlob)
+	{
+		SG_ERR_CHECK(  SG_string__append__format(pCtx, sContent, "M 100644 :%u dir_%u/file_%u.txt\n", uBlob + 1u, uBlob % 8u, uBlob)  );
+	}
+	SG_ERR_CHECK(  SG_string__append__sz(pCtx, sContent, "\n")  );
+	SG_ERR_CHECK(  SG_file__write__string(pCtx, pFile, sContent)  );
+
+	for (uBlob = 1u; uBlob < U0111__POOL__BLOBS; uBlob += 10u)
+	{
+		SG_ERR_CHECK(  u0111__pool__write_blob(pCtx, pFile, 2001u + uBlob, uBlob, 2u, sContent)  );
+	}
+
+	SG_ERR_CHECK(  SG_string__sprintf(pCtx, sContent, "commit refs/heads/master\nmark :%u\ncommitter <test@sourcegear.com> 1342803267 +0000\ndata 6\nsecond\nfrom :%u\n", U0111__POOL__COMMIT_2, U0111__POOL__COMMIT_1)  );
+	for (uBlob = 1u; uBlob < U0111__POOL__BLOBS; uBlob += 10u)
+	{
+		SG_ERR_CHECK(  SG_string__append__format(pCtx, sContent, "M 100644 :%u dir_%u/file_%u.txt\n", 2001u + uBlob, uBlob % 8u, uBlob)  );
+	}
+	SG_ERR_CHECK(  SG_string__append__sz(pCtx, sContent, "\n")  );
+	SG_ERR_CHECK(  SG_file__write__string(pCtx, pFile, sContent)  );
+
+	SG_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+
+fail:
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+	SG_STRING_NULLFREE(pCtx, sContent);
+}
+
+/**
+ * Checks that every file in a commit from the generated stream has the blob it should.
+ */
+static void u0111__pool__verify_commit(
+	SG_context* pCtx,    //< [in] [out] Error and context info.
+	SG_repo*    pRepo,   //< [in] The imported repo.
+	const char* szHid,   //< [in] HID of the commit to check.
+	SG_uint32   uCommit, //< [in] Mark of the commit in the generated stream.
+	SG_varray*  pHids    //< [in] [out] The HID of each file's blob is appended to this.
+	)
+{
+	SG_changeset*      pChangeset = NULL;
+	SG_treenode*       pTreenode  = NULL;
+	SG_treenode_entry* pEntry     = NULL;
+	char*              szGid      = NULL;
+	char*              szExpected = NULL;
+	SG_string*         sContent   = NULL;
+	const char*        szRoot     = NULL;
+	SG_uint32          uBlob      = 0u;
+	SG_uint32          uBad       = 0u;
+
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &sContent)  );
+	SG_ERR_CHECK(  SG_changeset__load_from_repo(pCtx, pRepo, szHid, &pChangeset)  );
+	SG_ERR_CHECK(  SG_changeset__tree__get_root(pCtx, pChangeset, &szRoot)  );
+	SG_ERR_CHECK(  SG_treenode__load_from_repo(pCtx, pRepo, szRoot, &pTreenode)  );
+
+	for (uBlob = 0u; uBlob < U0111__POOL__BLOBS; ++uBlob)
+	{
+		char        szPath[64];
+		const char* szActual = NULL;
+
+		SG_ERR_CHECK(  SG_sprintf(pCtx, szPath, sizeof(szPath), "@/dir_%u/file_%u.txt", uBlob % 8u, uBlob)  );
+		SG_ERR_CHECK(  SG_treenode__find_treenodeentry_by_path(pCtx, pRepo, pTreenode, szPath, &szGid, &pEntry)  );
+		VERIFYP_COND("File missing from import.", pEntry != NULL, ("Commit(%u) Path(%s)", uCommit, szPath));
+		if (pEntry != NULL)
+		{
+			SG_ERR_CHECK(  u0111__pool__blob(pCtx, uBlob, u0111__pool__version(uBlob, uCommit), sContent)  );
+			SG_ERR_CHECK(  SG_repo__alloc_compute_hash__from_bytes(pCtx, pRepo, SG_string__length_in_bytes(sContent), (const SG_byte*)SG_string__sz(sContent), &szExpected)  );
+			SG_ERR_CHECK(  SG_treenode_entry__get_hid_blob(pCtx, pEntry, &szActual)  );
+			SG_ERR_CHECK(  SG_varray__append__string__sz(pCtx, pHids, szActual)  );
+			if (strcmp(szExpected, szActual) != 0)
+			{
+				VERIFYP_COND("File imported with the wrong blob.", SG_FALSE, ("Commit(%u) Path(%s) Expected(%s) Actual(%s)", uCommit, szPath, szExpected, szActual));
+				++uBad;
+			}
+			SG_NULLFREE(pCtx, szExpected);
+		}
+		SG_TREENODE_ENTRY_NULLFREE(pCtx, pEntry);
+		SG_NULLFREE(pCtx, szGid);
+	}
+	VERIFYP_COND("Files imported with the wrong blobs.", uBad == 0u, ("Commit(%u) Count(%u)", uCommit, uBad));
+
+fail:
+	SG_CHANGESET_NULLFREE(pCtx, pChangeset);
+	SG_TREENODE_NULLFREE(pCtx, pTreenode);
+	SG_TREENODE_ENTRY_NULLFREE(pCtx, pEntry);
+	SG_NULLFREE(pCtx, szGid);
+	SG_NULLFREE(pCtx, szExpected);
+	SG_STRING_NULLFREE(pCtx, sContent);
+}
+
+/**
+ * Gets the name of one of the repos that the worker pool test creates.
+ */
+static void u0111__pool__repo_name(
+	SG_context* pCtx,    //< [in] [out] Error and context info.
+	const char* szRunId, //< [in] Unique ID to put in the repo's name.
+	const char* szName,  //< [in] Which of the test's repos this is.
+	SG_string** ppName   //< [out] Name of the repo.
+	)
+{
+	SG_ERR_CHECK_RETURN(  SG_string__alloc__format(pCtx, ppName, "u0111_pool_%s_%s", szRunId, szName)  );
+}
+
+/**
+ * Imports a stream with the given number of worker threads
+ * and checks the blob behind every mark that the commits use.
+ */
+static void u0111__pool__import(
+	SG_context*        pCtx,      //< [in] [out] Error and context info.
+	const SG_pathname* pStream,   //< [in] The generated stream, or an export of it.
+	const char*        szRunId,   //< [in] Unique ID to put in the repo's name.
+	const char*        szName,    //< [in] Which of the test's repos to import into.
+	const char*        szThreads, //< [in] Value for the fast_import/threads setting.
+	SG_varray**        ppHids     //< [out] Blob HIDs of every file in the two commits, oldest commit first.
+	)
+{
+	SG_string*     sRepoName  = NULL;
+	SG_repo*       pRepo      = NULL;
+	SG_rbtree*     pLeaves    = NULL;
+	SG_changeset*  pChangeset = NULL;
+	SG_varray*     pParents   = NULL;
+	SG_varray*     pHids      = NULL;
+	const char*    szLeaf     = NULL;
+	const char*    szParent   = NULL;
+	SG_uint32      uCount     = 0u;
+	SG_bool        bSetting   = SG_FALSE;
+
+	SG_ERR_CHECK(  u0111__pool__repo_name(pCtx, szRunId, szName, &sRepoName)  );
+	SG_ERR_CHECK(  SG_VARRAY__ALLOC(pCtx, &pHids)  );
+
+	SG_ERR_CHECK(  SG_localsettings__update__sz(pCtx, SG_LOCALSETTING__FAST_IMPORT_THREADS, szThreads)  );
+	bSetting = SG_TRUE;
+	VERIFY_ERR_CHECK(  SG_fast_import__import(pCtx, SG_pathname__sz(pStream), SG_string__sz(sRepoName), NULL, NULL, NULL)  );
+	SG_ERR_CHECK(  SG_localsettings__reset(pCtx, SG_LOCALSETTING__FAST_IMPORT_THREADS)  );
+	bSetting = SG_FALSE;
+
+	SG_ERR_CHECK(  SG_REPO__OPEN_REPO_INSTANCE(pCtx, SG_string__sz(sRepoName), &pRepo)  );
+	SG_ERR_CHECK(  SG_repo__fetch_dag_leaves(pCtx, pRepo, SG_DAGNUM__VERSION_CONTROL, &pLeaves)  );
+	SG_ERR_CHECK(  SG_rbtree__count(pCtx, pLeaves, &uCount)  );
+	VERIFYP_COND_FAIL("Import should have one leaf.", uCount == 1u, ("Threads(%s) Leaves(%u)", szThreads, uCount));
+	SG_ERR_CHECK(  SG_rbtree__get_only_entry(pCtx, pLeaves, &szLeaf, NULL)  );
+
+	SG_ERR_CHECK(  SG_changeset__load_from_repo(pCtx, pRepo, szLeaf, &pChangeset)  );
+	SG_ERR_CHECK(  SG_changeset__get_parents(pCtx, pChangeset, &pParents)  );
+	VERIFY_COND_FAIL("Second commit should have a parent.", pParents != NULL);
+	SG_ERR_CHECK(  SG_varray__get__sz(pCtx, pParents, 0u, &szParent)  );
+
+	VERIFY_ERR_CHECK(  u0111__pool__verify_commit(pCtx, pRepo, szParent, U0111__POOL__COMMIT_1, pHids)  );
+	VERIFY_ERR_CHECK(  u0111__pool__verify_commit(pCtx, pRepo, szLeaf, U0111__POOL__COMMIT_2, pHids)  );
+
+	*ppHids = pHids;
+	pHids = NULL;
+
+fail:
+	if (bSetting != SG_FALSE)
+	{
+		SG_ERR_IGNORE(  SG_localsettings__reset(pCtx, SG_LOCALSETTING__FAST_IMPORT_THREADS)  );
+	}
+	SG_STRING_NULLFREE(pCtx, sRepoName);
+	SG_REPO_NULLFREE(pCtx, pRepo);
+	SG_RBTREE_NULLFREE(pCtx, pLeaves);
+	SG_CHANGESET_NULLFREE(pCtx, pChangeset);
+	SG_VARRAY_NULLFREE(pCtx, pParents);
+	SG_VARRAY_NULLFREE(pCtx, pHids);
+}
+
+/**
+ * Reads a whole file into memory.
+ */
+static void u0111__pool__read_file(
+	SG_context*        pCtx,  //< [in] [out] Error and context info.
+	const SG_pathname* pPath, //< [in] The file to read.
+	SG_byte**          ppBuf, //< [out] The file's contents.
+	SG_uint32*         pLen   //< [out] The file's length.
+	)
+{
+	SG_file*  pFile = NULL;
+	SG_byte*  pBuf  = NULL;
+	SG_uint64 uLen  = 0u;
+	SG_uint32 uRead = 0u;
+	SG_uint32 uGot  = 0u;
+
+	SG_ERR_CHECK(  SG_fsobj__length__pathname(pCtx, pPath, &uLen, NULL)  );
+	SG_ERR_CHECK(  SG_allocN(pCtx, (SG_uint32)uLen + 1u, pBuf)  );
+	SG_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_RDONLY | SG_FILE_OPEN_EXISTING, SG_FSOBJ_PERMS__UNUSED, &pFile)  );
+	while (uRead < (SG_uint32)uLen)
+	{
+		SG_ERR_CHECK(  SG_file__read(pCtx, pFile, (SG_uint32)uLen - uRead, pBuf + uRead, &uGot)  );
+		uRead += uGot;
+	}
+
+	*ppBuf = pBuf;
+	pBuf = NULL;
+	*pLen = (SG_uint32)uLen;
+
+fail:
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+	SG_NULLFREE(pCtx, pBuf);
+}
+
+/**
+ * Exports a repo with the given number of worker threads.
+ */
+static void u0111__pool__export(
+	SG_context*        pCtx,     //< [in] [out] Error and context info.
+	const char*        szRepo,   //< [in] The repo to export.
+	const SG_pathname* pPath,    //< [in] The file to export to.
+	const char*        szThreads //< [in] Value for the fast_export/threads setting.
+	)
+{
+	SG_bool bSetting = SG_FALSE;
+
+	SG_ERR_CHECK(  SG_localsettings__update__sz(pCtx, SG_LOCALSETTING__FAST_EXPORT_THREADS, szThreads)  );
+	bSetting = SG_TRUE;
+	VERIFY_ERR_CHECK(  SG_fast_export__export(pCtx, szRepo, SG_pathname__sz(pPath))  );
+
+fail:
+	if (bSetting != SG_FALSE)
+	{
+		SG_ERR_IGNORE(  SG_localsettings__reset(pCtx, SG_LOCALSETTING__FAST_EXPORT_THREADS)  );
+	}
+}
+
+/**
+ * Checks that an export of the generated stream has every blob that the
+ * stream's commits use, each of them exactly once, with the right contents.
+ */
+static void u0111__pool__verify_export(
+	SG_context*    pCtx,  //< [in] [out] Error and context info.
+	SG_repo*       pRepo, //< [in] The repo that was exported.
+	const SG_byte* pBuf,  //< [in] The exported stream.
+	SG_uint32      uLen   //< [in] Length of the exported stream.
+	)
+{
+	SG_vhash*   pExpected = NULL;
+	SG_vhash*   pExported = NULL;
+	SG_string*  sContent  = NULL;
+	char*       szHid     = NULL;
+	SG_uint32   uBlob     = 0u;
+	SG_uint32   uCommit   = 0u;
+	SG_uint32   uCount    = 0u;
+	SG_uint32   uBig      = 0u;
+	SG_uint32   uPos      = 0u;
+	SG_bool     bBlob     = SG_FALSE;
+	SG_bool     bHas      = SG_FALSE;
+
+	// the HID of every distinct blob that the commits use
+	SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pExpected)  );
+	SG_ERR_CHECK(  SG_VHASH__ALLOC(pCtx, &pExported)  );
+	SG_ERR_CHECK(  SG_STRING__ALLOC(pCtx, &sContent)  );
+	for (uCommit = U0111__POOL__COMMIT_1; uCommit <= U0111__POOL__COMMIT_2; ++uCommit)
+	{
+		for (uBlob = 0u; uBlob < U0111__POOL__BLOBS; ++uBlob)
+		{
+			SG_ERR_CHECK(  u0111__pool__blob(pCtx, uBlob, u0111__pool__version(uBlob, uCommit), sContent)  );
+			SG_ERR_CHECK(  SG_repo__alloc_compute_hash__from_bytes(pCtx, pRepo, SG_string__length_in_bytes(sContent), (const SG_byte*)SG_string__sz(sContent), &szHid)  );
+			SG_ERR_CHECK(  SG_vhash__update__null(pCtx, pExpected, szHid)  );
+			SG_NULLFREE(pCtx, szHid);
+		}
+	}
+
+	// walk the commands, looking at the data of each blob
+	while (uPos < uLen)
+	{
+		const SG_byte* pEOL  = (const SG_byte*)memchr(pBuf + uPos, '\n', uLen - uPos);
+		SG_uint32      uLine = 0u;
+
+		VERIFY_COND_FAIL("Export ends without a newline.", pEOL != NULL);
+		uLine = (SG_uint32)(pEOL - (pBuf + uPos));
+
+		if (uLine == 4u && memcmp(pBuf + uPos, "blob", 4u) == 0)
+		{
+			bBlob = SG_TRUE;
+		}
+		else if (uLine > 5u && memcmp(pBuf + uPos, "data ", 5u) == 0)
+		{
+			SG_uint32 uData = (SG_uint32)strtoul((const char*)pBuf + uPos + 5u, NULL, 10);
+
+			uPos += uLine + 1u;
+			VERIFY_COND_FAIL("Export ends in the middle of some data.", uData <= uLen - uPos);
+			if (bBlob != SG_FALSE)
+			{
+				SG_ERR_CHECK(  SG_repo__alloc_compute_hash__from_bytes(pCtx, pRepo, uData, pBuf + uPos, &szHid)  );
+				SG_ERR_CHECK(  SG_vhash__has(pCtx, pExpected, szHid, &bHas)  );
+				VERIFYP_COND("Exported blob isn't one the commits use.", bHas != SG_FALSE, ("Hid(%s) Length(%u)", szHid, uData));
+				SG_ERR_CHECK(  SG_vhash__has(pCtx, pExported, szHid, &bHas)  );
+				VERIFYP_COND("Blob exported more than once.", bHas == SG_FALSE, ("Hid(%s)", szHid));
+				SG_ERR_CHECK(  SG_vhash__update__null(pCtx, pExported, szHid)  );
+				SG_NULLFREE(pCtx, szHid);
+				if (uData > U0111__POOL__BIG_SIZE - 1024u)
+				{
+					++uBig;
+				}
+				bBlob = SG_FALSE;
+			}
+			uPos += uData;
+			continue;
+		}
+		else if (
+			   (uLine > 7u && memcmp(pBuf + uPos, "commit ", 7u) == 0)
+			|| (uLine > 6u && memcmp(pBuf + uPos, "reset ", 6u) == 0)
+			|| (uLine > 4u && memcmp(pBuf + uPos, "tag ", 4u) == 0)
+			)
+		{
+			// the data after this belongs to some other command
+			bBlob = SG_FALSE;
+		}
+
+		uPos += uLine + 1u;
+	}
+
+	SG_ERR_CHECK(  SG_vhash__count(pCtx, pExpected, &uCount)  );
+	SG_ERR_CHECK(  SG_vhash__count(pCtx, pExported, &uBlob)  );
+	VERIFYP_COND("Export is missing blobs.", uBlob == uCount, ("Expected(%u) Exported(%u)", uCount, uBlob));
+	VERIFYP_COND("Export should contain the big blob.", uBig == 1u, ("Count(%u)", uBig));
+
+fail:
+	SG_VHASH_NULLFREE(pCtx, pExpected);
+	SG_VHASH_NULLFREE(pCtx, pExported);
+	SG_STRING_NULLFREE(pCtx, sContent);
+	SG_NULLFREE(pCtx, szHid);
+}
+
+/**
+ * Exports the imported repo with and without worker threads, checks
+ * that the two streams are identical and contain the right blobs, then
+ * imports the stream again.
+ */
+static void u0111__pool__export_test(
+	SG_context*        pCtx,      //< [in] [out] Error and context info.
+	const SG_pathname* pTempPath, //< [in] Folder where tests can store temporary files.
+	const char*        szRunId,   //< [in] Unique ID to put in the repo names.
+	const SG_varray*   pHids      //< [in] Blob HIDs that the repo's files have.
+	)
+{
+	SG_string*   sRepoName    = NULL;
+	SG_repo*     pRepo        = NULL;
+	SG_pathname* pSerial      = NULL;
+	SG_pathname* pParallel    = NULL;
+	SG_byte*     pSerialBuf   = NULL;
+	SG_byte*     pParallelBuf = NULL;
+	SG_uint32    uSerial      = 0u;
+	SG_uint32    uParallel    = 0u;
+	SG_varray*   pRoundTrip   = NULL;
+	SG_bool      bEqual       = SG_FALSE;
+
+	SG_ERR_CHECK(  u0111__pool__repo_name(pCtx, szRunId, "serial", &sRepoName)  );
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pSerial, pTempPath, "pool_export_serial.gfi")  );
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pParallel, pTempPath, "pool_export_parallel.gfi")  );
+
+	VERIFY_ERR_CHECK(  u0111__pool__export(pCtx, SG_string__sz(sRepoName), pSerial, "0")  );
+	VERIFY_ERR_CHECK(  u0111__pool__export(pCtx, SG_string__sz(sRepoName), pParallel, "4")  );
+
+	SG_ERR_CHECK(  u0111__pool__read_file(pCtx, pSerial, &pSerialBuf, &uSerial)  );
+	SG_ERR_CHECK(  u0111__pool__read_file(pCtx, pParallel, &pParallelBuf, &uParallel)  );
+	VERIFYP_COND_FAIL("Exporting with worker threads should give the same stream as without.",
+		uSerial == uParallel && memcmp(pSerialBuf, pParallelBuf, uSerial) == 0,
+		("Serial(%u) Parallel(%u)", uSerial, uParallel));
+
+	SG_ERR_CHECK(  SG_REPO__OPEN_REPO_INSTANCE(pCtx, SG_string__sz(sRepoName), &pRepo)  );
+	VERIFY_ERR_CHECK(  u0111__pool__verify_export(pCtx, pRepo, pParallelBuf, uParallel)  );
+
+	// the marks in the export have to lead back to the same blobs
+	VERIFY_ERR_CHECK(  u0111__pool__import(pCtx, pParallel, szRunId, "roundtrip", "4", &pRoundTrip)  );
+	SG_ERR_CHECK(  SG_varray__equal(pCtx, pHids, pRoundTrip, &bEqual)  );
+	VERIFY_COND("Importing the export should give the same blobs as the original import.", bEqual != SG_FALSE);
+
+fail:
+	SG_STRING_NULLFREE(pCtx, sRepoName);
+	SG_REPO_NULLFREE(pCtx, pRepo);
+	SG_PATHNAME_NULLFREE(pCtx, pSerial);
+	SG_PATHNAME_NULLFREE(pCtx, pParallel);
+	SG_NULLFREE(pCtx, pSerialBuf);
+	SG_NULLFREE(pCtx, pParallelBuf);
+	SG_VARRAY_NULLFREE(pCtx, pRoundTrip);
+}
+
+/**
+ * Imports a stream big enough to keep fast-import's worker pool busy,
+ * once with the workers and once without, and checks that both give
+ * every file the same blob.  Then does the same for fast-export.
+ */
+static void u0111__run_pool_test(
+	SG_context*        pCtx,      //< [in] [out] Error and context info.
+	const SG_pathname* pTempPath, //< [in] Folder where tests can store temporary files.
+	const char*        szRunId    //< [in] Unique ID to put in the repo names.
+	)
+{
+	SG_pathname* pStream   = NULL;
+	SG_varray*   pSerial   = NULL;
+	SG_varray*   pParallel = NULL;
+	SG_bool      bEqual    = SG_FALSE;
+
+	VERIFY_ERR_CHECK(  _begin_test_label(__FILE__, __LINE__, "worker pool")  );
+
+	SG_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pStream, pTempPath, "pool.gfi")  );
+	VERIFY_ERR_CHECK(  u0111__pool__write_stream(pCtx, pStream)  );
+
+	VERIFY_ERR_CHECK(  u0111__pool__import(pCtx, pStream, szRunId, "serial", "0", &pSerial)  );
+	VERIFY_ERR_CHECK(  u0111__pool__import(pCtx, pStream, szRunId, "parallel", "4", &pParallel)  );
+
+	SG_ERR_CHECK(  SG_varray__equal(pCtx, pSerial, pParallel, &bEqual)  );
+	VERIFY_COND("Importing with worker threads should give the same blobs as without.", bEqual != SG_FALSE);
+
+	VERIFY_ERR_CHECK(  u0111__pool__export_test(pCtx, pTempPath, szRunId, pSerial)  );
+
+fail:
+	SG_PATHNAME_NULLFREE(pCtx, pStream);
+	SG_VARRAY_NULLFREE(pCtx, pSerial);
+	SG_VARRAY_NULLFREE(pCtx, pParallel);
+}
+
+
 /*
 **
 ** MAIN
@@ -2484,6 +3024,9 @@ TEST_MAIN(u0111_main)
 	SG_ERR_CHECK(  SG_pathname__append__from_sz(pCtx, pTempPath, szRunId)  );
 	SG_ERR_CHECK(  SG_fsobj__mkdir_recursive__pathname(pCtx, pTempPath)  );
 
+	// import a generated stream with and without worker threads
+	VERIFY_ERR_CHECK(  u0111__run_pool_test(pCtx, pTempPath, szRunId)  );
+
 	// find the folder with our test data and run every test file in it
 	SG_ERR_CHECK(  SG_pathname__append__from_sz(pCtx, pDataDir, "u0111_fast_import_data")  );
 	VERIFY_ERR_CHECK(  u0111__run_test_files(pCtx, pDataDir, pTempPath, SG_FALSE)  );
@@ -0,0 +1,190 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file u0112_perf.c
+ *
+ * @details tests for SG_perf
+ *
+ */
+
+//////////////////////////////////////////////////////////////////
+
+#include <sg.h>
+#include "unittests.h"
+
+//////////////////////////////////////////////////////////////////
+
+// a name which has to be escaped to be valid JSON
+#define u0112_NASTY_NAME		"say \"hi\"\\\n\tnow"
+
+static void _u0112__get_total(SG_context * pCtx, SG_vhash * pvhTotals, const char * pszName,
+							  SG_int64 * pCalls, SG_int64 * pUnits)
+{
+	SG_vhash * pvh = NULL;
+
+	VERIFY_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhTotals, pszName, &pvh)  );
+	VERIFY_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvh, "calls", pCalls)  );
+	VERIFY_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvh, "units", pUnits)  );
+
+fail:
+	return;
+}
+
+void u0112_perf__off(SG_context * pCtx)
+{
+	SG_vhash * pvhTotals = NULL;
+
+	// nobody asked, so nothing is collected
+
+	VERIFY_COND("start", (0 == SG_perf__start()));
+	SG_perf__stop(SG_PERF_CATEGORY__SQLITE, 0, 0);
+	SG_perf__count("nobody", 1);
+
+	VERIFY_ERR_CHECK(  SG_perf__get_totals(pCtx, &pvhTotals)  );
+	VERIFY_COND("totals", (NULL == pvhTotals));
+	VERIFY_ERR_CHECK(  SG_perf__get_named_totals(pCtx, &pvhTotals)  );
+	VERIFY_COND("named", (NULL == pvhTotals));
+
+fail:
+	SG_VHASH_NULLFREE(pCtx, pvhTotals);
+}
+
+void u0112_perf__trace(SG_context * pCtx)
+{
+	SG_pathname * pPath = NULL;
+	SG_vhash * pvhTotals = NULL;
+	SG_vhash * pvhTrace = NULL;
+	SG_varray * pvaEvents = NULL;
+	SG_int64 calls = 0;
+	SG_int64 units = 0;
+	SG_uint32 count = 0;
+	SG_uint32 nrSqlite = 0;
+	SG_uint32 nrNasty = 0;
+	SG_uint32 nrCounter = 0;
+	SG_int64 lastCounter = 0;
+	SG_int64 t;
+	SG_uint32 k;
+
+	VERIFY_ERR_CHECK(  SG_perf__global_init(pCtx, SG_TRUE)  );
+
+	for (k=0; k<3; k++)
+	{
+		t = SG_perf__start();
+		VERIFY_COND("start", (0 != t));
+		SG_perf__stop(SG_PERF_CATEGORY__SQLITE, t, 0);
+	}
+
+	t = SG_perf__start();
+	SG_perf__stop__named(SG_PERF_CATEGORY__HASH, u0112_NASTY_NAME, t, 100);
+	t = SG_perf__start();
+	SG_perf__stop__named(SG_PERF_CATEGORY__HASH, u0112_NASTY_NAME, t, 23);
+
+	SG_perf__count("widgets", 2);
+	SG_perf__count("widgets", 5);
+
+	// totals
+
+	VERIFY_ERR_CHECK(  SG_perf__get_totals(pCtx, &pvhTotals)  );
+	VERIFY_ERR_CHECK(  _u0112__get_total(pCtx, pvhTotals, "sqlite", &calls, &units)  );
+	VERIFY_COND("sqlite calls", (3 == calls));
+	VERIFY_ERR_CHECK(  _u0112__get_total(pCtx, pvhTotals, "hash", &calls, &units)  );
+	VERIFYP_COND("hash", ((2 == calls) && (123 == units)), ("calls %d units %d", (int)calls, (int)units));
+	SG_VHASH_NULLFREE(pCtx, pvhTotals);
+
+	VERIFY_ERR_CHECK(  SG_perf__get_named_totals(pCtx, &pvhTotals)  );
+	VERIFY_ERR_CHECK(  SG_vhash__count(pCtx, pvhTotals, &count)  );
+	VERIFYP_COND("named count", (2 == count), ("count %d", count));
+	VERIFY_ERR_CHECK(  _u0112__get_total(pCtx, pvhTotals, u0112_NASTY_NAME, &calls, &units)  );
+	VERIFYP_COND("named timer", ((2 == calls) && (123 == units)), ("calls %d units %d", (int)calls, (int)units));
+	VERIFY_ERR_CHECK(  _u0112__get_total(pCtx, pvhTotals, "widgets", &calls, &units)  );
+	VERIFYP_COND("named counter", ((2 == calls) && (7 == units)), ("calls %d units %d", (int)calls, (int)units));
+
+	// the trace has to parse as JSON and give the names back as they were
+
+	VERIFY_ERR_CHECK(  unittest__get_nonexistent_pathname(pCtx, &pPath)  );
+	VERIFY_ERR_CHECK(  SG_perf__write_trace(pCtx, pPath)  );
+	VERIFY_ERR_CHECK(  SG_vfile__slurp(pCtx, pPath, &pvhTrace)  );
+	VERIFY_COND("trace", (NULL != pvhTrace));
+	VERIFY_ERR_CHECK(  SG_vhash__get__varray(pCtx, pvhTrace, "traceEvents", &pvaEvents)  );
+	VERIFY_ERR_CHECK(  SG_varray__count(pCtx, pvaEvents, &count)  );
+	VERIFYP_COND("events", (7 == count), ("count %d", count));
+
+	for (k=0; k<count; k++)
+	{
+		SG_vhash * pvhEvent = NULL;
+		SG_vhash * pvhArgs = NULL;
+		const char * pszName = NULL;
+		const char * pszPh = NULL;
+		SG_int64 v = 0;
+
+		VERIFY_ERR_CHECK(  SG_varray__get__vhash(pCtx, pvaEvents, k, &pvhEvent)  );
+		VERIFY_ERR_CHECK(  SG_vhash__get__sz(pCtx, pvhEvent, "name", &pszName)  );
+		VERIFY_ERR_CHECK(  SG_vhash__get__sz(pCtx, pvhEvent, "ph", &pszPh)  );
+
+		if (0 == strcmp(pszName, "sqlite"))
+		{
+			VERIFY_COND("sqlite ph", (0 == strcmp(pszPh, "X")));
+			nrSqlite++;
+		}
+		else if (0 == strcmp(pszName, u0112_NASTY_NAME))
+		{
+			VERIFY_COND("nasty ph", (0 == strcmp(pszPh, "X")));
+			VERIFY_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhEvent, "args", &pvhArgs)  );
+			VERIFY_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvhArgs, "units", &v)  );
+			VERIFY_COND("nasty units", ((100 == v) || (23 == v)));
+			nrNasty++;
+		}
+		else if (0 == strcmp(pszName, "widgets"))
+		{
+			VERIFY_COND("counter ph", (0 == strcmp(pszPh, "C")));
+			VERIFY_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhEvent, "args", &pvhArgs)  );
+			VERIFY_ERR_CHECK(  SG_vhash__get__int64(pCtx, pvhArgs, "value", &lastCounter)  );
+			nrCounter++;
+		}
+		else
+		{
+			VERIFYP_COND("name", SG_FALSE, ("unexpected event [%s]", pszName));
+		}
+	}
+	VERIFY_COND("sqlite events", (3 == nrSqlite));
+	VERIFY_COND("named events", (2 == nrNasty));
+	VERIFY_COND("counter events", (2 == nrCounter));
+	VERIFYP_COND("counter value", (7 == lastCounter), ("value %d", (int)lastCounter));
+
+fail:
+	SG_perf__global_cleanup();
+	if (pPath)
+		SG_ERR_IGNORE(  SG_fsobj__remove__pathname(pCtx, pPath)  );
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+	SG_VHASH_NULLFREE(pCtx, pvhTotals);
+	SG_VHASH_NULLFREE(pCtx, pvhTrace);
+}
+
+//////////////////////////////////////////////////////////////////
+
+TEST_MAIN(u0112_perf)
+{
+	TEMPLATE_MAIN_START;
+
+	BEGIN_TEST(  u0112_perf__off(pCtx)  );
+	BEGIN_TEST(  u0112_perf__trace(pCtx)  );
+
+	TEMPLATE_MAIN_END;
+}
+
+#undef u0112_NASTY_NAME
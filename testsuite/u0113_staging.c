@@ -0,0 +1,386 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file u0113_staging.c
+ *
+ * @details tests for SG_staging's tracking of missing blobs
+ *
+ */
+
+//////////////////////////////////////////////////////////////////
+
+#include <sg.h>
+#include "unittests.h"
+#include "unittests_push_pull.h"
+
+//////////////////////////////////////////////////////////////////
+
+#define u0113_NR_NEW		(3)
+
+/**
+ * Write a fragball into the staging area holding the frag for the
+ * given dagnodes (if any) and the given blobs (if any).
+ */
+static void _u0113__write_fragball(SG_context * pCtx,
+								   SG_repo * pRepo,
+								   const char * pszTidStaging,
+								   const char * pszFilename,
+								   SG_rbtree * prbDagnodes,
+								   const char * const * aszBlobs,
+								   SG_uint32 countBlobs)
+{
+	SG_pathname * pPathStaging = NULL;
+	SG_pathname * pPath = NULL;
+	SG_fragball_writer * pfb = NULL;
+
+	VERIFY_ERR_CHECK(  SG_staging__get_pathname(pCtx, pszTidStaging, &pPathStaging)  );
+	VERIFY_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPath, pPathStaging, pszFilename)  );
+	VERIFY_ERR_CHECK(  SG_fragball_writer__alloc(pCtx, pRepo, pPath, SG_TRUE, 2, &pfb)  );
+	if (prbDagnodes)
+		VERIFY_ERR_CHECK(  SG_fragball__write__dagnodes(pCtx, pfb, SG_DAGNUM__TESTING__NOTHING, prbDagnodes)  );
+	if (countBlobs)
+		VERIFY_ERR_CHECK(  SG_fragball__write__blobs(pCtx, pfb, aszBlobs, countBlobs)  );
+	VERIFY_ERR_CHECK(  SG_fragball_writer__close(pCtx, pfb)  );
+
+fail:
+	SG_FRAGBALL_WRITER_NULLFREE(pCtx, pfb);
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+	SG_PATHNAME_NULLFREE(pCtx, pPathStaging);
+}
+
+/**
+ * Check the staging area's status reports exactly the expected blobs
+ * as missing and none of the ones we know are elsewhere.
+ */
+static void _u0113__verify_missing(SG_context * pCtx,
+								   SG_staging * pStaging,
+								   SG_repo * pRepo,
+								   const char * pszLabel,
+								   const char * const * aszMissing,
+								   SG_uint32 countMissing,
+								   const char * const * aszNotMissing,
+								   SG_uint32 countNotMissing)
+{
+	SG_vhash * pvhStatus = NULL;
+	SG_vhash * pvhRefBlobs = NULL;
+	SG_bool bHas = SG_FALSE;
+	SG_uint32 count = 0;
+	SG_uint32 k;
+
+	VERIFY_ERR_CHECK(  SG_staging__check_status(pCtx, pStaging, pRepo,
+		SG_TRUE, SG_FALSE, SG_TRUE, SG_TRUE, SG_FALSE, &pvhStatus)  );
+
+	VERIFY_ERR_CHECK(  SG_vhash__has(pCtx, pvhStatus, SG_SYNC_STATUS_KEY__BLOBS, &bHas)  );
+	if (bHas)
+	{
+		VERIFY_ERR_CHECK(  SG_vhash__get__vhash(pCtx, pvhStatus, SG_SYNC_STATUS_KEY__BLOBS, &pvhRefBlobs)  );
+		VERIFY_ERR_CHECK(  SG_vhash__count(pCtx, pvhRefBlobs, &count)  );
+	}
+	VERIFYP_COND(pszLabel, (count == countMissing), ("%s: %d missing, expected %d", pszLabel, count, countMissing));
+
+	for (k=0; k<countMissing; k++)
+	{
+		bHas = SG_FALSE;
+		if (pvhRefBlobs)
+			VERIFY_ERR_CHECK(  SG_vhash__has(pCtx, pvhRefBlobs, aszMissing[k], &bHas)  );
+		VERIFYP_COND(pszLabel, bHas, ("%s: %s should be missing", pszLabel, aszMissing[k]));
+	}
+	for (k=0; k<countNotMissing; k++)
+	{
+		bHas = SG_FALSE;
+		if (pvhRefBlobs)
+			VERIFY_ERR_CHECK(  SG_vhash__has(pCtx, pvhRefBlobs, aszNotMissing[k], &bHas)  );
+		VERIFYP_COND(pszLabel, !bHas, ("%s: %s should not be missing", pszLabel, aszNotMissing[k]));
+	}
+
+fail:
+	SG_VHASH_NULLFREE(pCtx, pvhStatus);
+}
+
+/**
+ * Make a source repo with a base changeset, clone it, and then add a
+ * line of new changesets to the source only.  Each changeset in the
+ * testing dag is its own blob and references no others.
+ */
+static void _u0113__setup(SG_context * pCtx,
+						  SG_repo ** ppRepoSrc,
+						  SG_repo ** ppRepoDest,
+						  char ** pszHidBase,
+						  char ** aszHidNew)
+{
+	const char * pszParent;
+	SG_uint32 k;
+
+	VERIFY_ERR_CHECK(  _create_new_repo(pCtx, ppRepoSrc)  );
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, *ppRepoSrc, NULL, 1, pszHidBase)  );
+	VERIFY_ERR_CHECK(  _clone(pCtx, *ppRepoSrc, ppRepoDest)  );
+
+	pszParent = *pszHidBase;
+	for (k=0; k<u0113_NR_NEW; k++)
+	{
+		VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, *ppRepoSrc, pszParent, 1, &aszHidNew[k])  );
+		pszParent = aszHidNew[k];
+	}
+
+fail:
+	return;
+}
+
+/**
+ * Copy one blob from one repo to the other, without its dagnode.
+ */
+static void _u0113__copy_blob(SG_context * pCtx, SG_repo * pRepoSrc, SG_repo * pRepoDest, const char * pszHid)
+{
+	SG_byte * pBuf = NULL;
+	SG_uint64 len = 0;
+	SG_repo_tx_handle * ptx = NULL;
+	char * pszHidStored = NULL;
+
+	VERIFY_ERR_CHECK(  SG_repo__fetch_blob_into_memory(pCtx, pRepoSrc, pszHid, &pBuf, &len)  );
+	VERIFY_ERR_CHECK(  SG_repo__begin_tx(pCtx, pRepoDest, &ptx)  );
+	VERIFY_ERR_CHECK(  SG_repo__store_blob_from_memory(pCtx, pRepoDest, ptx, SG_FALSE, pBuf, (SG_uint32)len, &pszHidStored)  );
+	VERIFY_ERR_CHECK(  SG_repo__commit_tx(pCtx, pRepoDest, &ptx)  );
+	VERIFY_COND("copied", (0 == strcmp(pszHid, pszHidStored)));
+
+fail:
+	if (ptx)
+		SG_ERR_IGNORE(  SG_repo__abort_tx(pCtx, pRepoDest, &ptx)  );
+	SG_NULLFREE(pCtx, pszHidStored);
+	SG_NULLFREE(pCtx, pBuf);
+}
+
+void u0113_staging__incremental(SG_context * pCtx)
+{
+	SG_repo * pRepoSrc = NULL;
+	SG_repo * pRepoDest = NULL;
+	char * pszHidBase = NULL;
+	char * aszHidNew[u0113_NR_NEW] = { NULL };
+	const char * aszFirst[2];
+	const char * aszLater[1];
+	const char * aszInRepo[1];
+	char * pszTidStaging = NULL;
+	SG_staging * pStaging = NULL;
+	SG_rbtree * prbDagnodes = NULL;
+	SG_rbtree * prbLeaves = NULL;
+	SG_bool bFound = SG_FALSE;
+	SG_uint32 k;
+
+	VERIFY_ERR_CHECK(  _u0113__setup(pCtx, &pRepoSrc, &pRepoDest, &pszHidBase, aszHidNew)  );
+
+	// The destination has the middle changeset's blob but not its
+	// dagnode, so the frag will reference a blob that's already there.
+
+	VERIFY_ERR_CHECK(  _u0113__copy_blob(pCtx, pRepoSrc, pRepoDest, aszHidNew[1])  );
+	aszFirst[0] = aszHidNew[0];
+	aszFirst[1] = aszHidNew[2];
+	aszLater[0] = aszHidNew[2];
+	aszInRepo[0] = aszHidNew[1];
+
+	VERIFY_ERR_CHECK(  SG_staging__create(pCtx, &pszTidStaging, &pStaging)  );
+
+	// The first fragball has the dagnodes and none of their blobs.
+
+	VERIFY_ERR_CHECK(  SG_RBTREE__ALLOC(pCtx, &prbDagnodes)  );
+	for (k=0; k<u0113_NR_NEW; k++)
+		VERIFY_ERR_CHECK(  SG_rbtree__add(pCtx, prbDagnodes, aszHidNew[k])  );
+
+	VERIFY_ERR_CHECK(  _u0113__write_fragball(pCtx, pRepoSrc, pszTidStaging, "fb1", prbDagnodes, NULL, 0)  );
+	VERIFY_ERR_CHECK(  SG_staging__slurp_fragball(pCtx, pStaging, "fb1")  );
+	VERIFY_ERR_CHECK(  _u0113__verify_missing(pCtx, pStaging, pRepoDest, "dagnodes only",
+		aszFirst, 2, aszInRepo, 1)  );
+
+	// Asking again without anything arriving changes nothing.
+
+	VERIFY_ERR_CHECK(  _u0113__verify_missing(pCtx, pStaging, pRepoDest, "asked twice",
+		aszFirst, 2, aszInRepo, 1)  );
+
+	// The second fragball supplies one of the blobs the first referenced.
+
+	VERIFY_ERR_CHECK(  _u0113__write_fragball(pCtx, pRepoSrc, pszTidStaging, "fb2", NULL, aszFirst, 1)  );
+	VERIFY_ERR_CHECK(  SG_staging__slurp_fragball(pCtx, pStaging, "fb2")  );
+	VERIFY_ERR_CHECK(  _u0113__verify_missing(pCtx, pStaging, pRepoDest, "some blobs",
+		aszLater, 1, aszFirst, 1)  );
+	VERIFY_ERR_CHECK(  _u0113__verify_missing(pCtx, pStaging, pRepoDest, "in repo after some blobs",
+		aszLater, 1, aszInRepo, 1)  );
+
+	// And the third supplies the rest.
+
+	VERIFY_ERR_CHECK(  _u0113__write_fragball(pCtx, pRepoSrc, pszTidStaging, "fb3", NULL, aszLater, 1)  );
+	VERIFY_ERR_CHECK(  SG_staging__slurp_fragball(pCtx, pStaging, "fb3")  );
+	VERIFY_ERR_CHECK(  _u0113__verify_missing(pCtx, pStaging, pRepoDest, "all blobs",
+		NULL, 0, (const char * const *)aszHidNew, u0113_NR_NEW)  );
+
+	// Nothing is missing, so it commits.
+
+	VERIFY_ERR_CHECK(  SG_staging__commit(pCtx, pStaging, pRepoDest)  );
+	VERIFY_ERR_CHECK(  SG_repo__fetch_dag_leaves(pCtx, pRepoDest, SG_DAGNUM__TESTING__NOTHING, &prbLeaves)  );
+	VERIFY_ERR_CHECK(  SG_rbtree__find(pCtx, prbLeaves, aszHidNew[u0113_NR_NEW - 1], &bFound, NULL)  );
+	VERIFY_COND("committed leaf", bFound);
+
+fail:
+	if (pStaging)
+		SG_ERR_IGNORE(  SG_staging__cleanup(pCtx, &pStaging)  );
+	SG_RBTREE_NULLFREE(pCtx, prbDagnodes);
+	SG_RBTREE_NULLFREE(pCtx, prbLeaves);
+	SG_NULLFREE(pCtx, pszTidStaging);
+	SG_NULLFREE(pCtx, pszHidBase);
+	for (k=0; k<u0113_NR_NEW; k++)
+		SG_NULLFREE(pCtx, aszHidNew[k]);
+	SG_REPO_NULLFREE(pCtx, pRepoSrc);
+	SG_REPO_NULLFREE(pCtx, pRepoDest);
+}
+
+/**
+ * Stamp the staging area's version file.
+ */
+static void _u0113__write_version(SG_context * pCtx, const SG_pathname * pPathStaging, SG_uint32 iVersion)
+{
+	SG_pathname * pPath = NULL;
+	SG_file * pFile = NULL;
+
+	VERIFY_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPath, pPathStaging, "__VER__")  );
+	VERIFY_ERR_CHECK(  SG_fsobj__remove__pathname(pCtx, pPath)  );
+	VERIFY_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_WRONLY|SG_FILE_CREATE_NEW, 0644, &pFile)  );
+	VERIFY_ERR_CHECK(  SG_file__write(pCtx, pFile, sizeof(iVersion), (SG_byte*)&iVersion, NULL)  );
+	VERIFY_ERR_CHECK(  SG_file__close(pCtx, &pFile)  );
+
+fail:
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+}
+
+static void _u0113__read_version(SG_context * pCtx, const SG_pathname * pPathStaging, SG_uint32 * piVersion)
+{
+	SG_pathname * pPath = NULL;
+	SG_file * pFile = NULL;
+
+	VERIFY_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPath, pPathStaging, "__VER__")  );
+	VERIFY_ERR_CHECK(  SG_file__open__pathname(pCtx, pPath, SG_FILE_RDONLY|SG_FILE_OPEN_EXISTING, SG_FSOBJ_PERMS__UNUSED, &pFile)  );
+	VERIFY_ERR_CHECK(  SG_file__read(pCtx, pFile, sizeof(*piVersion), (SG_byte*)piVersion, NULL)  );
+
+fail:
+	SG_FILE_NULLCLOSE(pCtx, pFile);
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+}
+
+/**
+ * Build a staging area the way version 1 did: its blobs_referenced
+ * table has no state column.
+ */
+static void _u0113__create_v1(SG_context * pCtx,
+							  const SG_pathname * pPathStaging,
+							  const char * const * aszReferenced,
+							  SG_uint32 countReferenced)
+{
+	SG_pathname * pPath = NULL;
+	sqlite3 * psql = NULL;
+	SG_uint32 k;
+
+	VERIFY_ERR_CHECK(  _u0113__write_version(pCtx, pPathStaging, 1)  );
+
+	VERIFY_ERR_CHECK(  SG_PATHNAME__ALLOC__PATHNAME_SZ(pCtx, &pPath, pPathStaging, "pending.db")  );
+	VERIFY_ERR_CHECK(  sg_sqlite__create__pathname(pCtx, pPath, SG_SQLITE__SYNC__OFF, &psql)  );
+	VERIFY_ERR_CHECK(  sg_sqlite__exec(pCtx, psql,
+		"CREATE TABLE audits (csid VARCHAR NOT NULL, dagnum INTEGER NOT NULL, userid VARCHAR NOT NULL, timestamp INTEGER NOT NULL)")  );
+	VERIFY_ERR_CHECK(  sg_sqlite__exec(pCtx, psql,
+		"CREATE TABLE frags (iDagnum VARCHAR UNIQUE NOT NULL, connected INTEGER NOT NULL, frag TEXT NOT NULL)")  );
+	VERIFY_ERR_CHECK(  sg_sqlite__exec(pCtx, psql,
+		("CREATE TABLE blobs_present (filename VARCHAR NOT NULL, offset INTEGER NOT NULL, encoding INTEGER NOT NULL,"
+		 " len_encoded INTEGER NOT NULL, len_full INTEGER NOT NULL, hid_vcdiff VARCHAR NULL, hid VARCHAR UNIQUE NOT NULL)"))  );
+	VERIFY_ERR_CHECK(  sg_sqlite__exec(pCtx, psql,
+		"CREATE TABLE blobs_referenced (hid VARCHAR UNIQUE NOT NULL, is_changeset INTEGER NOT NULL, data_blobs_known INTEGER NOT NULL)")  );
+	for (k=0; k<countReferenced; k++)
+		VERIFY_ERR_CHECK(  sg_sqlite__exec__va(pCtx, psql,
+			"INSERT INTO blobs_referenced (hid, is_changeset, data_blobs_known) VALUES ('%s', 1, 0)", aszReferenced[k])  );
+
+fail:
+	if (psql)
+		SG_ERR_IGNORE(  sg_sqlite__close(pCtx, psql)  );
+	SG_PATHNAME_NULLFREE(pCtx, pPath);
+}
+
+void u0113_staging__upgrade_v1(SG_context * pCtx)
+{
+	SG_repo * pRepoSrc = NULL;
+	SG_repo * pRepoDest = NULL;
+	char * pszHidBase = NULL;
+	char * aszHidNew[u0113_NR_NEW] = { NULL };
+	const char * aszReferenced[2];
+	char * pszTidStaging = NULL;
+	SG_pathname * pPathStaging = NULL;
+	SG_staging * pStaging = NULL;
+	SG_uint32 iVersion = 0;
+	SG_uint32 k;
+
+	VERIFY_ERR_CHECK(  _u0113__setup(pCtx, &pRepoSrc, &pRepoDest, &pszHidBase, aszHidNew)  );
+
+	aszReferenced[0] = pszHidBase;
+	aszReferenced[1] = aszHidNew[0];
+
+	VERIFY_ERR_CHECK(  SG_staging__create(pCtx, &pszTidStaging, NULL)  );
+	VERIFY_ERR_CHECK(  SG_staging__get_pathname(pCtx, pszTidStaging, &pPathStaging)  );
+	VERIFY_ERR_CHECK(  _u0113__create_v1(pCtx, pPathStaging, aszReferenced, 2)  );
+
+	// Opening it upgrades it in place, once.
+
+	VERIFY_ERR_CHECK(  SG_staging__open(pCtx, pszTidStaging, &pStaging)  );
+	VERIFY_ERR_CHECK(  _u0113__read_version(pCtx, pPathStaging, &iVersion)  );
+	VERIFYP_COND("upgraded", (2 == iVersion), ("version %d", iVersion));
+	SG_STAGING_NULLFREE(pCtx, pStaging);
+
+	VERIFY_ERR_CHECK(  SG_staging__open(pCtx, pszTidStaging, &pStaging)  );
+
+	// The rows from before the upgrade still get asked about, and the
+	// one the repo has isn't missing.
+
+	VERIFY_ERR_CHECK(  _u0113__verify_missing(pCtx, pStaging, pRepoDest, "upgraded",
+		(const char * const *)&aszHidNew[0], 1, (const char * const *)&pszHidBase, 1)  );
+	SG_STAGING_NULLFREE(pCtx, pStaging);
+
+	// Versions we don't know about are still refused.
+
+	VERIFY_ERR_CHECK(  _u0113__write_version(pCtx, pPathStaging, 3)  );
+	VERIFY_ERR_CHECK_ERR_EQUALS_DISCARD(  SG_staging__open(pCtx, pszTidStaging, &pStaging), SG_ERR_UNKNOWN_STAGING_VERSION  );
+	VERIFY_COND("refused", (NULL == pStaging));
+
+fail:
+	SG_STAGING_NULLFREE(pCtx, pStaging);
+	if (pszTidStaging)
+		SG_ERR_IGNORE(  SG_staging__cleanup__by_id(pCtx, pszTidStaging)  );
+	SG_PATHNAME_NULLFREE(pCtx, pPathStaging);
+	SG_NULLFREE(pCtx, pszTidStaging);
+	SG_NULLFREE(pCtx, pszHidBase);
+	for (k=0; k<u0113_NR_NEW; k++)
+		SG_NULLFREE(pCtx, aszHidNew[k]);
+	SG_REPO_NULLFREE(pCtx, pRepoSrc);
+	SG_REPO_NULLFREE(pCtx, pRepoDest);
+}
+
+//////////////////////////////////////////////////////////////////
+
+TEST_MAIN(u0113_staging)
+{
+	TEMPLATE_MAIN_START;
+
+	BEGIN_TEST(  u0113_staging__incremental(pCtx)  );
+	BEGIN_TEST(  u0113_staging__upgrade_v1(pCtx)  );
+
+	TEMPLATE_MAIN_END;
+}
+
+#undef u0113_NR_NEW
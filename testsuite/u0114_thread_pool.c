@@ -0,0 +1,274 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file u0114_thread_pool.c
+ *
+ * @details tests for SG_thread_pool and SG_thread_cond
+ *
+ */
+
+//////////////////////////////////////////////////////////////////
+
+#include <sg.h>
+#include "unittests.h"
+#include "unittests_push_pull.h"
+
+//////////////////////////////////////////////////////////////////
+
+#define u0114_NR_WORKERS		(4)
+
+typedef struct
+{
+	SG_mutex	mutex;
+	SG_uint32	nrCalls;
+	SG_uint32	nrWithRepo;
+	SG_repo *	pRepoCaller;
+	SG_bool		bSameRepo;
+	SG_bool		bFirstFailed;
+	SG_thread_cond	cond;
+	SG_uint32	nrWaiting;
+	SG_bool		bGo;
+} u0114_state;
+
+static SG_thread_pool__work _u0114__count;
+
+static void _u0114__count(SG_context * pCtx, SG_repo * pRepo, void * pVoidData)
+{
+	u0114_state * pState = (u0114_state *)pVoidData;
+
+	SG_ERR_CHECK_RETURN(  SG_mutex__lock(pCtx, &pState->mutex)  );
+	pState->nrCalls++;
+	if (pRepo)
+		pState->nrWithRepo++;
+	if (pRepo == pState->pRepoCaller)
+		pState->bSameRepo = SG_TRUE;
+	SG_ERR_CHECK_RETURN(  SG_mutex__unlock(pCtx, &pState->mutex)  );
+}
+
+static SG_thread_pool__work _u0114__fail;
+
+/**
+ * The first worker in fails straight away.  The others wait until it
+ * has, and then some, and fail with a different error.
+ */
+static void _u0114__fail(SG_context * pCtx, SG_repo * pRepo, void * pVoidData)
+{
+	u0114_state * pState = (u0114_state *)pVoidData;
+	SG_uint32 ticket;
+	SG_bool bFirstFailed = SG_FALSE;
+
+	SG_UNUSED(pRepo);
+
+	SG_ERR_CHECK_RETURN(  SG_mutex__lock(pCtx, &pState->mutex)  );
+	ticket = pState->nrCalls++;
+	SG_ERR_CHECK_RETURN(  SG_mutex__unlock(pCtx, &pState->mutex)  );
+
+	if (ticket == 0)
+	{
+		SG_ERR_IGNORE(  SG_mutex__lock(pCtx, &pState->mutex)  );
+		pState->bFirstFailed = SG_TRUE;
+		SG_ERR_IGNORE(  SG_mutex__unlock(pCtx, &pState->mutex)  );
+		SG_ERR_THROW2_RETURN(  SG_ERR_INVALIDARG, (pCtx, "first")  );
+	}
+
+	while (!bFirstFailed)
+	{
+		SG_sleep_ms(1);
+		SG_ERR_CHECK_RETURN(  SG_mutex__lock(pCtx, &pState->mutex)  );
+		bFirstFailed = pState->bFirstFailed;
+		SG_ERR_CHECK_RETURN(  SG_mutex__unlock(pCtx, &pState->mutex)  );
+	}
+	SG_sleep_ms(100);
+
+	SG_ERR_THROW2_RETURN(  SG_ERR_NOTIMPLEMENTED, (pCtx, "later")  );
+}
+
+static SG_thread_pool__work _u0114__wait;
+
+/**
+ * Check in, then sleep until the main thread says go.
+ */
+static void _u0114__wait(SG_context * pCtx, SG_repo * pRepo, void * pVoidData)
+{
+	u0114_state * pState = (u0114_state *)pVoidData;
+
+	SG_UNUSED(pRepo);
+
+	SG_ERR_CHECK_RETURN(  SG_mutex__lock(pCtx, &pState->mutex)  );
+	pState->nrWaiting++;
+	SG_ERR_CHECK_RETURN(  SG_thread_cond__broadcast(pCtx, &pState->cond)  );
+	while (!pState->bGo)
+		SG_ERR_CHECK_RETURN(  SG_thread_cond__wait(pCtx, &pState->cond, &pState->mutex)  );
+	pState->nrCalls++;
+	SG_ERR_CHECK_RETURN(  SG_mutex__unlock(pCtx, &pState->mutex)  );
+}
+
+void u0114_thread_pool__size(SG_context * pCtx)
+{
+	SG_uint32 nrProcessors = 0;
+	SG_uint32 nrWorkers = 99;
+
+	VERIFY_ERR_CHECK(  SG_thread__get_processor_count(pCtx, &nrProcessors)  );
+
+	VERIFY_ERR_CHECK(  SG_thread_pool__size_for_jobs(pCtx, 0, 16, 8, &nrWorkers)  );
+	VERIFY_COND("no jobs", (0 == nrWorkers));
+
+	VERIFY_ERR_CHECK(  SG_thread_pool__size_for_jobs(pCtx, 31, 16, 8, &nrWorkers)  );
+	VERIFY_COND("one thread's worth", (0 == nrWorkers));
+
+	VERIFY_ERR_CHECK(  SG_thread_pool__size_for_jobs(pCtx, 100000, 16, 1, &nrWorkers)  );
+	VERIFY_COND("max 1", (0 == nrWorkers));
+
+	VERIFY_ERR_CHECK(  SG_thread_pool__size_for_jobs(pCtx, 100000, 16, 8, &nrWorkers)  );
+	VERIFYP_COND("lots", (nrWorkers == (SG_MIN(nrProcessors, 8) - 1)), ("%d workers for %d processors", nrWorkers, nrProcessors));
+
+fail:
+	return;
+}
+
+void u0114_thread_pool__run(SG_context * pCtx)
+{
+	u0114_state state;
+	SG_bool bMutex = SG_FALSE;
+	SG_thread_pool * pPool = NULL;
+	SG_repo * pRepo = NULL;
+
+	memset(&state, 0, sizeof(state));
+	VERIFY_ERR_CHECK(  SG_mutex__init(pCtx, &state.mutex)  );
+	bMutex = SG_TRUE;
+
+	// without a repo
+
+	VERIFY_ERR_CHECK(  SG_thread_pool__alloc(pCtx, u0114_NR_WORKERS, NULL, _u0114__count, &state, &pPool)  );
+	VERIFY_COND("not started", (0 == state.nrCalls));
+	VERIFY_ERR_CHECK(  SG_thread_pool__start(pCtx, pPool)  );
+	VERIFY_ERR_CHECK(  SG_thread_pool__join(pCtx, pPool)  );
+	SG_THREAD_POOL_NULLFREE(pCtx, pPool);
+	VERIFY_COND("calls", (u0114_NR_WORKERS == state.nrCalls));
+	VERIFY_COND("no repo", (0 == state.nrWithRepo));
+
+	// each worker gets its own instance of the repo
+
+	VERIFY_ERR_CHECK(  _create_new_repo(pCtx, &pRepo)  );
+	state.nrCalls = 0;
+	state.nrWithRepo = 0;
+	state.bSameRepo = SG_FALSE;
+	state.pRepoCaller = pRepo;
+
+	VERIFY_ERR_CHECK(  SG_thread_pool__alloc(pCtx, u0114_NR_WORKERS, pRepo, _u0114__count, &state, &pPool)  );
+	VERIFY_ERR_CHECK(  SG_thread_pool__start(pCtx, pPool)  );
+	VERIFY_ERR_CHECK(  SG_thread_pool__join(pCtx, pPool)  );
+	SG_THREAD_POOL_NULLFREE(pCtx, pPool);
+	VERIFY_COND("calls with repo", (u0114_NR_WORKERS == state.nrCalls));
+	VERIFY_COND("repo", (u0114_NR_WORKERS == state.nrWithRepo));
+	VERIFY_COND("own repo", !state.bSameRepo);
+
+	// freeing a pool that was never started is fine
+
+	VERIFY_ERR_CHECK(  SG_thread_pool__alloc(pCtx, u0114_NR_WORKERS, pRepo, _u0114__count, &state, &pPool)  );
+	SG_THREAD_POOL_NULLFREE(pCtx, pPool);
+
+fail:
+	SG_THREAD_POOL_NULLFREE(pCtx, pPool);
+	SG_REPO_NULLFREE(pCtx, pRepo);
+	if (bMutex)
+		SG_mutex__destroy(&state.mutex);
+}
+
+void u0114_thread_pool__first_error(SG_context * pCtx)
+{
+	u0114_state state;
+	SG_bool bMutex = SG_FALSE;
+	SG_thread_pool * pPool = NULL;
+
+	memset(&state, 0, sizeof(state));
+	VERIFY_ERR_CHECK(  SG_mutex__init(pCtx, &state.mutex)  );
+	bMutex = SG_TRUE;
+
+	VERIFY_ERR_CHECK(  SG_thread_pool__alloc(pCtx, u0114_NR_WORKERS, NULL, _u0114__fail, &state, &pPool)  );
+	VERIFY_ERR_CHECK(  SG_thread_pool__start(pCtx, pPool)  );
+	VERIFY_ERR_CHECK_ERR_EQUALS_DISCARD(  SG_thread_pool__join(pCtx, pPool), SG_ERR_INVALIDARG  );
+	VERIFY_COND("calls", (u0114_NR_WORKERS == state.nrCalls));
+
+fail:
+	SG_THREAD_POOL_NULLFREE(pCtx, pPool);
+	if (bMutex)
+		SG_mutex__destroy(&state.mutex);
+}
+
+void u0114_thread_pool__cond(SG_context * pCtx)
+{
+	u0114_state state;
+	SG_bool bMutex = SG_FALSE;
+	SG_bool bCond = SG_FALSE;
+	SG_bool bLocked = SG_FALSE;
+	SG_thread_pool * pPool = NULL;
+
+	memset(&state, 0, sizeof(state));
+	VERIFY_ERR_CHECK(  SG_mutex__init(pCtx, &state.mutex)  );
+	bMutex = SG_TRUE;
+	VERIFY_ERR_CHECK(  SG_thread_cond__init(pCtx, &state.cond)  );
+	bCond = SG_TRUE;
+
+	VERIFY_ERR_CHECK(  SG_thread_pool__alloc(pCtx, u0114_NR_WORKERS, NULL, _u0114__wait, &state, &pPool)  );
+	VERIFY_ERR_CHECK(  SG_thread_pool__start(pCtx, pPool)  );
+
+	// wait for every worker to be waiting for us
+
+	VERIFY_ERR_CHECK(  SG_mutex__lock(pCtx, &state.mutex)  );
+	bLocked = SG_TRUE;
+	while (state.nrWaiting < u0114_NR_WORKERS)
+		VERIFY_ERR_CHECK(  SG_thread_cond__wait(pCtx, &state.cond, &state.mutex)  );
+	VERIFY_COND("nobody went early", (0 == state.nrCalls));
+	state.bGo = SG_TRUE;
+	VERIFY_ERR_CHECK(  SG_thread_cond__broadcast(pCtx, &state.cond)  );
+	bLocked = SG_FALSE;
+	VERIFY_ERR_CHECK(  SG_mutex__unlock(pCtx, &state.mutex)  );
+
+	VERIFY_ERR_CHECK(  SG_thread_pool__join(pCtx, pPool)  );
+	VERIFY_COND("everybody went", (u0114_NR_WORKERS == state.nrCalls));
+
+fail:
+	if (bLocked)
+	{
+		state.bGo = SG_TRUE;
+		(void)SG_thread_cond__broadcast__bare(&state.cond);
+		(void)SG_mutex__unlock__bare(&state.mutex);
+	}
+	SG_THREAD_POOL_NULLFREE(pCtx, pPool);
+	if (bCond)
+		SG_thread_cond__destroy(&state.cond);
+	if (bMutex)
+		SG_mutex__destroy(&state.mutex);
+}
+
+//////////////////////////////////////////////////////////////////
+
+TEST_MAIN(u0114_thread_pool)
+{
+	TEMPLATE_MAIN_START;
+
+	BEGIN_TEST(  u0114_thread_pool__size(pCtx)  );
+	BEGIN_TEST(  u0114_thread_pool__run(pCtx)  );
+	BEGIN_TEST(  u0114_thread_pool__first_error(pCtx)  );
+	BEGIN_TEST(  u0114_thread_pool__cond(pCtx)  );
+
+	TEMPLATE_MAIN_END;
+}
+
+#undef u0114_NR_WORKERS
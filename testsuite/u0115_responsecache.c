@@ -0,0 +1,290 @@
+/*
+Copyright 2010-2013 SourceGear, LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/**
+ *
+ * @file u0115_responsecache.c
+ *
+ * @details tests for SG_responsecache
+ *
+ */
+
+//////////////////////////////////////////////////////////////////
+
+#include <sg.h>
+#include "unittests.h"
+#include "unittests_push_pull.h"
+
+//////////////////////////////////////////////////////////////////
+
+#define u0115_KEY			"GET\n/repos/u0115/page\n"
+
+static const SG_uint64 u0115_aDags[] = { SG_DAGNUM__TESTING__NOTHING };
+
+static void _u0115__get_etag(SG_context * pCtx, SG_repo * pRepo, char ** ppszEtag)
+{
+	SG_ERR_CHECK_RETURN(  SG_responsecache__get_etag(pCtx, pRepo, u0115_aDags, SG_NrElements(u0115_aDags), u0115_KEY, ppszEtag)  );
+}
+
+/**
+ * Start the cache with the given settings (NULL for the default).
+ */
+static void _u0115__init(SG_context * pCtx, const char * pszMaxMb, const char * pszValidateSeconds)
+{
+	if (pszMaxMb)
+		SG_ERR_CHECK_RETURN(  SG_localsettings__update__sz(pCtx, SG_LOCALSETTING__SERVER_RESPONSE_CACHE_SIZE, pszMaxMb)  );
+	if (pszValidateSeconds)
+		SG_ERR_CHECK_RETURN(  SG_localsettings__update__sz(pCtx, SG_LOCALSETTING__SERVER_RESPONSE_CACHE_VALIDATE_SECONDS, pszValidateSeconds)  );
+
+	SG_ERR_CHECK_RETURN(  SG_responsecache__global_init(pCtx)  );
+}
+
+static void _u0115__cleanup(SG_context * pCtx)
+{
+	SG_responsecache__global_cleanup();
+
+	SG_ERR_IGNORE(  SG_localsettings__reset(pCtx, SG_LOCALSETTING__SERVER_RESPONSE_CACHE_SIZE)  );
+	SG_ERR_IGNORE(  SG_localsettings__reset(pCtx, SG_LOCALSETTING__SERVER_RESPONSE_CACHE_VALIDATE_SECONDS)  );
+}
+
+//////////////////////////////////////////////////////////////////
+
+void u0115_responsecache__commit(SG_context * pCtx)
+{
+	SG_repo * pRepo = NULL;
+	char * pszLeaf = NULL;
+	char * pszEtag1 = NULL;
+	char * pszEtag2 = NULL;
+	char * pszEtag3 = NULL;
+
+	VERIFY_ERR_CHECK(  _u0115__init(pCtx, NULL, NULL)  );
+
+	VERIFY_ERR_CHECK(  _create_new_repo(pCtx, &pRepo)  );
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepo, NULL, 1, &pszLeaf)  );
+
+	VERIFY_ERR_CHECK(  _u0115__get_etag(pCtx, pRepo, &pszEtag1)  );
+	VERIFY_ERR_CHECK(  _u0115__get_etag(pCtx, pRepo, &pszEtag2)  );
+	VERIFYP_COND("unchanged", (0 == strcmp(pszEtag1, pszEtag2)), ("%s vs %s", pszEtag1, pszEtag2));
+
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepo, pszLeaf, 1, NULL)  );
+	VERIFY_ERR_CHECK(  _u0115__get_etag(pCtx, pRepo, &pszEtag3)  );
+	VERIFYP_COND("commit", (0 != strcmp(pszEtag1, pszEtag3)), ("%s", pszEtag3));
+
+fail:
+	_u0115__cleanup(pCtx);
+	SG_REPO_NULLFREE(pCtx, pRepo);
+	SG_NULLFREE(pCtx, pszLeaf);
+	SG_NULLFREE(pCtx, pszEtag1);
+	SG_NULLFREE(pCtx, pszEtag2);
+	SG_NULLFREE(pCtx, pszEtag3);
+}
+
+void u0115_responsecache__push_pull(SG_context * pCtx)
+{
+	SG_repo * pRepoServed = NULL;
+	SG_repo * pRepoPusher = NULL;
+	SG_repo * pRepoOther = NULL;
+	const char * pszServedName = NULL;
+	const char * pszOtherName = NULL;
+	char * pszLeaf = NULL;
+	char * pszEtag1 = NULL;
+	char * pszEtag2 = NULL;
+	char * pszEtag3 = NULL;
+
+	VERIFY_ERR_CHECK(  _u0115__init(pCtx, NULL, NULL)  );
+
+	VERIFY_ERR_CHECK(  _create_new_repo(pCtx, &pRepoServed)  );
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepoServed, NULL, 1, &pszLeaf)  );
+	VERIFY_ERR_CHECK(  _clone(pCtx, pRepoServed, &pRepoPusher)  );
+	VERIFY_ERR_CHECK(  _clone(pCtx, pRepoServed, &pRepoOther)  );
+	VERIFY_ERR_CHECK(  SG_repo__get_descriptor_name(pCtx, pRepoServed, &pszServedName)  );
+	VERIFY_ERR_CHECK(  SG_repo__get_descriptor_name(pCtx, pRepoOther, &pszOtherName)  );
+
+	VERIFY_ERR_CHECK(  _u0115__get_etag(pCtx, pRepoServed, &pszEtag1)  );
+
+	// a push into the served repo
+
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepoPusher, pszLeaf, 1, NULL)  );
+	VERIFY_ERR_CHECK(  SG_push__all(pCtx, pRepoPusher, pszServedName, NULL, NULL, SG_TRUE, NULL, NULL)  );
+	VERIFY_ERR_CHECK(  _u0115__get_etag(pCtx, pRepoServed, &pszEtag2)  );
+	VERIFYP_COND("push", (0 != strcmp(pszEtag1, pszEtag2)), ("%s", pszEtag2));
+
+	// a pull into the served repo
+
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepoOther, pszLeaf, 1, NULL)  );
+	VERIFY_ERR_CHECK(  SG_pull__all(pCtx, pRepoServed, pszOtherName, NULL, NULL, NULL, NULL)  );
+	VERIFY_ERR_CHECK(  _u0115__get_etag(pCtx, pRepoServed, &pszEtag3)  );
+	VERIFYP_COND("pull", (0 != strcmp(pszEtag2, pszEtag3)), ("%s", pszEtag3));
+	VERIFYP_COND("pull vs first", (0 != strcmp(pszEtag1, pszEtag3)), ("%s", pszEtag3));
+
+fail:
+	_u0115__cleanup(pCtx);
+	SG_REPO_NULLFREE(pCtx, pRepoServed);
+	SG_REPO_NULLFREE(pCtx, pRepoPusher);
+	SG_REPO_NULLFREE(pCtx, pRepoOther);
+	SG_NULLFREE(pCtx, pszLeaf);
+	SG_NULLFREE(pCtx, pszEtag1);
+	SG_NULLFREE(pCtx, pszEtag2);
+	SG_NULLFREE(pCtx, pszEtag3);
+}
+
+/**
+ * With validate_seconds set, commits made in this process still change
+ * the ETag right away.
+ */
+void u0115_responsecache__validate_lag(SG_context * pCtx)
+{
+	SG_repo * pRepo = NULL;
+	char * pszLeaf = NULL;
+	char * pszEtag1 = NULL;
+	char * pszEtag2 = NULL;
+
+	VERIFY_ERR_CHECK(  _u0115__init(pCtx, NULL, "3600")  );
+
+	VERIFY_ERR_CHECK(  _create_new_repo(pCtx, &pRepo)  );
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepo, NULL, 1, &pszLeaf)  );
+
+	VERIFY_ERR_CHECK(  _u0115__get_etag(pCtx, pRepo, &pszEtag1)  );
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepo, pszLeaf, 1, NULL)  );
+	VERIFY_ERR_CHECK(  _u0115__get_etag(pCtx, pRepo, &pszEtag2)  );
+	VERIFYP_COND("commit", (0 != strcmp(pszEtag1, pszEtag2)), ("%s", pszEtag2));
+
+fail:
+	_u0115__cleanup(pCtx);
+	SG_REPO_NULLFREE(pCtx, pRepo);
+	SG_NULLFREE(pCtx, pszLeaf);
+	SG_NULLFREE(pCtx, pszEtag1);
+	SG_NULLFREE(pCtx, pszEtag2);
+}
+
+/**
+ * A clone has the same repo id and the same leaves, but it's a different
+ * repo, so it mustn't get the served repo's cached responses.
+ */
+void u0115_responsecache__instances(SG_context * pCtx)
+{
+	SG_repo * pRepo = NULL;
+	SG_repo * pRepoClone = NULL;
+	char * pszEtag = NULL;
+	char * pszEtagClone = NULL;
+	SG_string * pstrText = NULL;
+
+	VERIFY_ERR_CHECK(  _u0115__init(pCtx, NULL, NULL)  );
+
+	VERIFY_ERR_CHECK(  _create_new_repo(pCtx, &pRepo)  );
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepo, NULL, 1, NULL)  );
+	VERIFY_ERR_CHECK(  _clone(pCtx, pRepo, &pRepoClone)  );
+
+	VERIFY_ERR_CHECK(  _u0115__get_etag(pCtx, pRepo, &pszEtag)  );
+	VERIFY_ERR_CHECK(  _u0115__get_etag(pCtx, pRepoClone, &pszEtagClone)  );
+	VERIFYP_COND("etags", (0 != strcmp(pszEtag, pszEtagClone)), ("%s", pszEtag));
+
+	VERIFY_ERR_CHECK(  SG_responsecache__put(pCtx, pszEtag, u0115_KEY, "served")  );
+
+	VERIFY_ERR_CHECK(  SG_responsecache__get(pCtx, pszEtagClone, u0115_KEY, &pstrText)  );
+	VERIFY_COND("clone miss", (NULL == pstrText));
+
+	VERIFY_ERR_CHECK(  SG_responsecache__get(pCtx, pszEtag, u0115_KEY, &pstrText)  );
+	VERIFY_COND("hit", (pstrText && (0 == strcmp(SG_string__sz(pstrText), "served"))));
+
+fail:
+	_u0115__cleanup(pCtx);
+	SG_REPO_NULLFREE(pCtx, pRepo);
+	SG_REPO_NULLFREE(pCtx, pRepoClone);
+	SG_NULLFREE(pCtx, pszEtag);
+	SG_NULLFREE(pCtx, pszEtagClone);
+	SG_STRING_NULLFREE(pCtx, pstrText);
+}
+
+/**
+ * With a 1MB cache, the second of two 600KB entries pushes the first
+ * out to the spill directory, and asking for it again reads it back.
+ */
+void u0115_responsecache__spill(SG_context * pCtx)
+{
+	SG_repo * pRepo = NULL;
+	SG_repo * pRepoClone = NULL;
+	char * pszEtag = NULL;
+	char * pszEtagClone = NULL;
+	char * pszBig = NULL;
+	SG_string * pstrText = NULL;
+	SG_pathname * pPathSpill = NULL;
+	char bufName[17];
+	SG_bool bExists = SG_FALSE;
+	SG_uint32 lenBig = 600 * 1024;
+
+	VERIFY_ERR_CHECK(  _u0115__init(pCtx, "1", NULL)  );
+
+	VERIFY_ERR_CHECK(  _create_new_repo(pCtx, &pRepo)  );
+	VERIFY_ERR_CHECK(  _add_line_to_dag(pCtx, pRepo, NULL, 1, NULL)  );
+	VERIFY_ERR_CHECK(  _clone(pCtx, pRepo, &pRepoClone)  );
+	VERIFY_ERR_CHECK(  _u0115__get_etag(pCtx, pRepo, &pszEtag)  );
+	VERIFY_ERR_CHECK(  _u0115__get_etag(pCtx, pRepoClone, &pszEtagClone)  );
+
+	VERIFY_ERR_CHECK(  SG_allocN(pCtx, lenBig + 1, pszBig)  );
+	memset(pszBig, 'a', lenBig);
+	pszBig[lenBig] = 0;
+	VERIFY_ERR_CHECK(  SG_responsecache__put(pCtx, pszEtag, u0115_KEY, pszBig)  );
+	pszBig[0] = 'b';
+	VERIFY_ERR_CHECK(  SG_responsecache__put(pCtx, pszEtagClone, u0115_KEY, pszBig)  );
+
+	// the first one's spill file is named for its key hash
+
+	memcpy(bufName, pszEtag, 16);
+	bufName[16] = 0;
+	VERIFY_ERR_CHECK(  SG_closet__get_server_state_path(pCtx, &pPathSpill)  );
+	VERIFY_ERR_CHECK(  SG_pathname__append__from_sz(pCtx, pPathSpill, "vvcache")  );
+	VERIFY_ERR_CHECK(  SG_pathname__append__from_sz(pCtx, pPathSpill, bufName)  );
+	VERIFY_ERR_CHECK(  SG_fsobj__exists__pathname(pCtx, pPathSpill, &bExists, NULL, NULL)  );
+	VERIFYP_COND("spilled", bExists, ("%s", SG_pathname__sz(pPathSpill)));
+
+	VERIFY_ERR_CHECK(  SG_responsecache__get(pCtx, pszEtag, u0115_KEY, &pstrText)  );
+	VERIFY_COND("unspilled", (NULL != pstrText));
+	if (pstrText)
+	{
+		VERIFYP_COND("length", (lenBig == SG_string__length_in_bytes(pstrText)), ("%d", SG_string__length_in_bytes(pstrText)));
+		VERIFY_COND("text", (SG_string__sz(pstrText)[0] == 'a'));
+	}
+
+fail:
+	_u0115__cleanup(pCtx);
+	if (pPathSpill)
+		SG_ERR_IGNORE(  SG_fsobj__remove__pathname(pCtx, pPathSpill)  );
+	SG_PATHNAME_NULLFREE(pCtx, pPathSpill);
+	SG_REPO_NULLFREE(pCtx, pRepo);
+	SG_REPO_NULLFREE(pCtx, pRepoClone);
+	SG_NULLFREE(pCtx, pszEtag);
+	SG_NULLFREE(pCtx, pszEtagClone);
+	SG_NULLFREE(pCtx, pszBig);
+	SG_STRING_NULLFREE(pCtx, pstrText);
+}
+
+//////////////////////////////////////////////////////////////////
+
+TEST_MAIN(u0115_responsecache)
+{
+	TEMPLATE_MAIN_START;
+
+	BEGIN_TEST(  u0115_responsecache__commit(pCtx)  );
+	BEGIN_TEST(  u0115_responsecache__push_pull(pCtx)  );
+	BEGIN_TEST(  u0115_responsecache__validate_lag(pCtx)  );
+	BEGIN_TEST(  u0115_responsecache__instances(pCtx)  );
+	BEGIN_TEST(  u0115_responsecache__spill(pCtx)  );
+
+	TEMPLATE_MAIN_END;
+}
+
+#undef u0115_KEY